@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+// An I/O ring is a pair of queues in memory that's shared between a process and the kernel. The process puts
+// operations into the submission queue, tells the kernel how many there are with io_ring_enter(), and finds their
+// results in the completion queue. Many operations can be submitted with a single syscall, and results are read
+// without any syscall at all.
+//
+// The memory is mapped by calling mmap() on the file descriptor returned by io_ring_setup(), with MAP_SHARED and an
+// offset of 0. It starts with an IORingHeader, which says where the two queues are.
+//
+// Both queues are rings of a power-of-two size. The head and tail indices run freely and wrap around at 2^32, an
+// entry's position in the ring is its index modulo the ring size. The producer of a queue advances its tail, the
+// consumer advances its head:
+// - The process writes submissions and then advances submission_tail, the kernel advances submission_head.
+// - The kernel writes completions and then advances completion_tail, the process advances completion_head.
+// Indices have to be read with acquire and written with release semantics.
+
+static constexpr u32 IO_RING_MAX_ENTRIES = 4096;
+
+// Operations never wait for a file descriptor to become ready. If one would have to, it completes with EAGAIN instead,
+// and the process can wait with poll() before submitting it again.
+enum class IORingOperation : u8 {
+    Nop,
+    // Reads or writes `length` bytes at `address`. If `offset` is -1, the file's position is used and advanced,
+    // just like read() and write() do.
+    Read,
+    Write,
+    // `address` and `address2` point at a sockaddr and its socklen_t like the arguments of accept4(). Both may
+    // be null. The new file descriptor is the result. `flags` takes SOCK_NONBLOCK and SOCK_CLOEXEC.
+    Accept,
+    // `address` points at a sockaddr of `length` bytes. This behaves like connect() on a non-blocking socket, and
+    // fails with EAGAIN if the socket is blocking, as there would be no way to keep it from waiting for the connection.
+    Connect,
+    Fsync,
+};
+
+struct IORingSubmission {
+    IORingOperation operation;
+    u8 reserved[3];
+    i32 fd;
+    i64 offset;
+    u64 address;
+    u64 address2;
+    u32 length;
+    u32 flags;
+    // Passed through to the completion untouched, to tell completions apart.
+    u64 user_data;
+};
+
+struct IORingCompletion {
+    u64 user_data;
+    // What the corresponding syscall would have returned, or a negated errno.
+    i64 result;
+};
+
+struct IORingHeader {
+    u32 submission_head;
+    u32 submission_tail;
+    u32 completion_head;
+    u32 completion_tail;
+
+    u32 submission_entries;
+    u32 completion_entries;
+
+    // Offsets of the queues from the start of the mapping, in bytes.
+    u32 submissions_offset;
+    u32 completions_offset;
+
+    // The size of the whole mapping.
+    u32 size;
+};
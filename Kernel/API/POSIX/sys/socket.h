@@ -62,6 +62,7 @@ extern "C" {
 #define MSG_DONTWAIT 0x40
 #define MSG_NOSIGNAL 0x80
 #define MSG_EOR 0x100
+#define MSG_WAITFORONE 0x200
 
 typedef uint16_t sa_family_t;
 
@@ -81,6 +82,12 @@ struct msghdr {
     int msg_flags;
 };
 
+// For sendmmsg() and recvmmsg(), which move many messages with a single system call.
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
 // These three are non-POSIX, but common:
 #define CMSG_ALIGN(x) (((x) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
 #define CMSG_SPACE(x) (CMSG_ALIGN(sizeof(struct cmsghdr)) + CMSG_ALIGN(x))
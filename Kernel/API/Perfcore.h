@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+// A perfcore is a PerfcoreHeader followed by a stream of records, each of which starts with a PerfcoreRecordHeader.
+// Everything is stored in the byte order of the machine that recorded it. Readers should skip records they don't
+// know about, which is what the size in the record header is for.
+
+static constexpr char PERFCORE_MAGIC[8] = { 'P', 'E', 'R', 'F', 'C', 'O', 'R', 'E' };
+static constexpr u32 PERFCORE_VERSION = 1;
+
+struct [[gnu::packed]] PerfcoreHeader {
+    char magic[8];
+    u32 version;
+    u32 reserved;
+};
+
+enum class PerfcoreRecordType : u16 {
+    // Adds the next string to the string table, which signposts and filesystem events refer to by index.
+    String = 1,
+    Event = 2,
+    // Events were dropped because the buffer they were recorded into was full.
+    LostEvents = 3,
+};
+
+struct [[gnu::packed]] PerfcoreRecordHeader {
+    PerfcoreRecordType type;
+    u16 reserved;
+    u32 size; // Including this header
+};
+
+struct [[gnu::packed]] PerfcoreStringRecord {
+    PerfcoreRecordHeader header;
+    u32 index;
+    // Followed by the characters of the string, up to the end of the record.
+};
+
+struct [[gnu::packed]] PerfcoreLostEventsRecord {
+    PerfcoreRecordHeader header;
+    u64 count;
+};
+
+struct [[gnu::packed]] PerfcoreEventRecord {
+    PerfcoreRecordHeader header;
+    u32 type; // One of PERF_EVENT_*
+    u32 pid;
+    u32 tid;
+    u32 lost_samples;
+    u64 timestamp; // Nanoseconds since boot
+    u16 data_size;
+    u16 stack_size;
+    // Followed by data_size bytes of data that depend on the type, then stack_size u64 addresses (innermost first).
+};
+
+// The data of malloc, free, mmap, munmap, kmalloc and kfree events. An mmap event is followed by the name of the region.
+struct [[gnu::packed]] PerfcoreMemoryEventData {
+    u64 ptr;
+    u64 size;
+};
+
+// The data of process_create events, followed by the path of the executable. process_exec events only have the path.
+struct [[gnu::packed]] PerfcoreProcessCreateEventData {
+    u32 parent_pid;
+};
+
+struct [[gnu::packed]] PerfcoreThreadCreateEventData {
+    u32 parent_tid;
+};
+
+struct [[gnu::packed]] PerfcoreContextSwitchEventData {
+    u32 next_pid;
+    u32 next_tid;
+};
+
+struct [[gnu::packed]] PerfcoreSignpostEventData {
+    u64 arg1;
+    u64 arg2;
+};
+
+enum class PerfcoreFilesystemEventType : u8 {
+    Open,
+    Close,
+    Readv,
+    Read,
+    Pread,
+};
+
+struct [[gnu::packed]] PerfcoreFilesystemEventData {
+    u64 duration_ns;
+    PerfcoreFilesystemEventType type;
+    u8 reserved[3];
+    i32 fd; // The dirfd for open events
+    u32 filename_index;
+    i32 options;
+    u64 mode;
+    u64 buffer_ptr;
+    u64 size;
+    i64 offset;
+};
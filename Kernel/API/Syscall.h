@@ -18,9 +18,11 @@
 
 extern "C" {
 struct pollfd;
+struct epoll_event;
 struct timeval;
 struct timespec;
 struct sockaddr;
+struct mmsghdr;
 struct siginfo;
 struct stat;
 struct statvfs;
@@ -69,6 +71,9 @@ enum class NeedsBigProcessLock {
     S(disown, NeedsBigProcessLock::No)                     \
     S(dump_backtrace, NeedsBigProcessLock::No)             \
     S(dup2, NeedsBigProcessLock::No)                       \
+    S(epoll_create, NeedsBigProcessLock::No)               \
+    S(epoll_ctl, NeedsBigProcessLock::No)                  \
+    S(epoll_wait, NeedsBigProcessLock::No)                 \
     S(execve, NeedsBigProcessLock::Yes)                    \
     S(exit, NeedsBigProcessLock::Yes)                      \
     S(exit_thread, NeedsBigProcessLock::Yes)               \
@@ -112,6 +117,8 @@ enum class NeedsBigProcessLock {
     S(getuid, NeedsBigProcessLock::No)                     \
     S(inode_watcher_add_watch, NeedsBigProcessLock::No)    \
     S(inode_watcher_remove_watch, NeedsBigProcessLock::No) \
+    S(io_ring_enter, NeedsBigProcessLock::No)              \
+    S(io_ring_setup, NeedsBigProcessLock::No)              \
     S(ioctl, NeedsBigProcessLock::No)                      \
     S(join_thread, NeedsBigProcessLock::No)                \
     S(kill, NeedsBigProcessLock::No)                       \
@@ -135,7 +142,9 @@ enum class NeedsBigProcessLock {
     S(pipe, NeedsBigProcessLock::No)                       \
     S(pledge, NeedsBigProcessLock::No)                     \
     S(poll, NeedsBigProcessLock::No)                       \
+    S(posix_fadvise, NeedsBigProcessLock::No)              \
     S(posix_fallocate, NeedsBigProcessLock::No)            \
+    S(posix_spawn, NeedsBigProcessLock::No)                \
     S(prctl, NeedsBigProcessLock::No)                      \
     S(profiling_disable, NeedsBigProcessLock::Yes)         \
     S(profiling_enable, NeedsBigProcessLock::Yes)          \
@@ -148,13 +157,18 @@ enum class NeedsBigProcessLock {
     S(readv, NeedsBigProcessLock::Yes)                     \
     S(realpath, NeedsBigProcessLock::No)                   \
     S(recvfd, NeedsBigProcessLock::No)                     \
+    S(recvmmsg, NeedsBigProcessLock::No)                   \
     S(recvmsg, NeedsBigProcessLock::Yes)                   \
     S(rename, NeedsBigProcessLock::No)                     \
     S(remount, NeedsBigProcessLock::No)                    \
     S(rmdir, NeedsBigProcessLock::No)                      \
+    S(scheduler_get_affinity, NeedsBigProcessLock::No)     \
     S(scheduler_get_parameters, NeedsBigProcessLock::No)   \
+    S(scheduler_set_affinity, NeedsBigProcessLock::No)     \
     S(scheduler_set_parameters, NeedsBigProcessLock::No)   \
     S(sendfd, NeedsBigProcessLock::No)                     \
+    S(sendfile, NeedsBigProcessLock::Yes)                  \
+    S(sendmmsg, NeedsBigProcessLock::No)                   \
     S(sendmsg, NeedsBigProcessLock::Yes)                   \
     S(set_mmap_name, NeedsBigProcessLock::No)              \
     S(setegid, NeedsBigProcessLock::No)                    \
@@ -181,6 +195,7 @@ enum class NeedsBigProcessLock {
     S(sigtimedwait, NeedsBigProcessLock::No)               \
     S(socket, NeedsBigProcessLock::No)                     \
     S(socketpair, NeedsBigProcessLock::No)                 \
+    S(splice, NeedsBigProcessLock::Yes)                    \
     S(stat, NeedsBigProcessLock::No)                       \
     S(statvfs, NeedsBigProcessLock::No)                    \
     S(symlink, NeedsBigProcessLock::No)                    \
@@ -264,6 +279,23 @@ struct SC_poll_params {
     u32 const* sigmask;
 };
 
+struct SC_splice_params {
+    int in_fd;
+    off_t* in_offset;
+    int out_fd;
+    off_t* out_offset;
+    size_t length;
+    unsigned flags;
+};
+
+struct SC_epoll_wait_params {
+    int epoll_fd;
+    struct epoll_event* events;
+    int max_events;
+    const struct timespec* timeout;
+    u32 const* sigmask;
+};
+
 struct SC_clock_nanosleep_params {
     int clock_id;
     int flags;
@@ -283,6 +315,14 @@ struct SC_accept4_params {
     int flags;
 };
 
+struct SC_recvmmsg_params {
+    int sockfd;
+    struct mmsghdr* msgvec;
+    unsigned vlen;
+    int flags;
+    struct timespec* timeout;
+};
+
 struct SC_getsockopt_params {
     int sockfd;
     int level;
@@ -391,6 +431,36 @@ struct SC_execve_params {
     StringListArgument environment;
 };
 
+enum class PosixSpawnFileActionType : u32 {
+    Open,
+    Close,
+    Dup2,
+    Chdir,
+    Fchdir,
+};
+
+struct SC_posix_spawn_file_action {
+    PosixSpawnFileActionType type;
+    int fd;
+    int new_fd;          // Dup2 only
+    int options;         // Open only
+    u32 mode;            // Open only
+    StringArgument path; // Open and Chdir only
+};
+
+struct SC_posix_spawn_params {
+    StringArgument path;
+    StringListArgument arguments;
+    StringListArgument environment;
+    SC_posix_spawn_file_action const* file_actions;
+    size_t file_action_count;
+    bool reset_ids;
+    bool set_signal_defaults;
+    bool set_signal_mask;
+    u32 signal_defaults;
+    u32 signal_mask;
+};
+
 struct SC_readlink_params {
     StringArgument path;
     MutableBufferArgument<char, size_t> buffer;
@@ -550,6 +620,12 @@ struct SC_scheduler_parameters_params {
     struct sched_param parameters;
 };
 
+struct SC_scheduler_affinity_params {
+    pid_t pid_or_tid;
+    SchedulerParametersMode mode;
+    u64 affinity;
+};
+
 struct SC_faccessat_params {
     int dirfd;
     StringArgument pathname;
@@ -134,6 +134,13 @@ u32 ProcessorBase<T>::smp_wake_n_idle_processors(u32 wake_count)
     return 0;
 }
 
+template<typename T>
+bool ProcessorBase<T>::smp_wake_idle_processor(u32)
+{
+    // FIXME: Actually wake up other cores when SMP is supported for aarch64.
+    return false;
+}
+
 template<typename T>
 void ProcessorBase<T>::initialize_context_switching(Thread& initial_thread)
 {
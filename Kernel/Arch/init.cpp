@@ -30,6 +30,7 @@
 #include <Kernel/Devices/Generic/MemoryDevice.h>
 #include <Kernel/Devices/Generic/NullDevice.h>
 #include <Kernel/Devices/Generic/PCSpeakerDevice.h>
+#include <Kernel/Devices/Generic/PerfcoreDevice.h>
 #include <Kernel/Devices/Generic/RandomDevice.h>
 #include <Kernel/Devices/Generic/SelfTTYDevice.h>
 #include <Kernel/Devices/Generic/ZeroDevice.h>
@@ -372,6 +373,7 @@ void init_stage2(void*)
     (void)FullDevice::must_create().leak_ref();
     (void)FUSEDevice::must_create().leak_ref();
     (void)RandomDevice::must_create().leak_ref();
+    (void)PerfcoreDevice::must_create().leak_ref();
     (void)SelfTTYDevice::must_create().leak_ref();
     PTYMultiplexer::initialize();
 
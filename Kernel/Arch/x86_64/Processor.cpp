@@ -40,7 +40,7 @@ READONLY_AFTER_INIT static ProcessorContainer s_processors {};
 READONLY_AFTER_INIT static bool volatile s_smp_enabled;
 
 static Atomic<ProcessorMessage*> s_message_pool;
-Atomic<u32> Processor::s_idle_cpu_mask { 0 };
+Atomic<u64> Processor::s_idle_cpu_mask { 0 };
 
 extern "C" void enter_thread_context(Thread* from_thread, Thread* to_thread) __attribute__((used));
 extern "C" FlatPtr do_init_context(Thread* thread, u32 flags) __attribute__((used));
@@ -936,16 +936,16 @@ u32 ProcessorBase<T>::smp_wake_n_idle_processors(u32 wake_count)
     auto& apic = APIC::the();
     while (did_wake_count < wake_count) {
         // Try to get a set of idle CPUs and flip them to busy
-        u32 idle_mask = Processor::s_idle_cpu_mask.load(AK::MemoryOrder::memory_order_relaxed) & ~(1u << current_id);
+        u64 idle_mask = Processor::s_idle_cpu_mask.load(AK::MemoryOrder::memory_order_relaxed) & ~(1ull << current_id);
         u32 idle_count = popcount(idle_mask);
         if (idle_count == 0)
             break; // No (more) idle processor available
 
-        u32 found_mask = 0;
+        u64 found_mask = 0;
         for (u32 i = 0; i < idle_count; i++) {
             u32 cpu = bit_scan_forward(idle_mask) - 1;
-            idle_mask &= ~(1u << cpu);
-            found_mask |= 1u << cpu;
+            idle_mask &= ~(1ull << cpu);
+            found_mask |= 1ull << cpu;
         }
 
         idle_mask = Processor::s_idle_cpu_mask.fetch_and(~found_mask, AK::MemoryOrder::memory_order_acq_rel) & found_mask;
@@ -954,7 +954,7 @@ u32 ProcessorBase<T>::smp_wake_n_idle_processors(u32 wake_count)
         idle_count = popcount(idle_mask);
         for (u32 i = 0; i < idle_count; i++) {
             u32 cpu = bit_scan_forward(idle_mask) - 1;
-            idle_mask &= ~(1u << cpu);
+            idle_mask &= ~(1ull << cpu);
 
             // Send an IPI to that CPU to wake it up. There is a possibility
             // someone else woke it up as well, or that it woke up due to
@@ -966,6 +966,21 @@ u32 ProcessorBase<T>::smp_wake_n_idle_processors(u32 wake_count)
     return did_wake_count;
 }
 
+template<typename T>
+bool ProcessorBase<T>::smp_wake_idle_processor(u32 cpu)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    if (!s_smp_enabled || cpu == Processor::current_id())
+        return false;
+
+    // Flip the processor to busy first, so that only one of us sends it an IPI.
+    u64 cpu_mask = 1ull << cpu;
+    if (!(Processor::s_idle_cpu_mask.fetch_and(~cpu_mask, AK::MemoryOrder::memory_order_acq_rel) & cpu_mask))
+        return false;
+    APIC::the().send_ipi(cpu);
+    return true;
+}
+
 template<typename T>
 UNMAP_AFTER_INIT void ProcessorBase<T>::smp_enable()
 {
@@ -1605,13 +1620,13 @@ void Processor::set_fs_base(FlatPtr fs_base)
 template<typename T>
 void ProcessorBase<T>::idle_begin() const
 {
-    Processor::s_idle_cpu_mask.fetch_or(1u << m_cpu, AK::MemoryOrder::memory_order_relaxed);
+    Processor::s_idle_cpu_mask.fetch_or(1ull << m_cpu, AK::MemoryOrder::memory_order_relaxed);
 }
 
 template<typename T>
 void ProcessorBase<T>::idle_end() const
 {
-    Processor::s_idle_cpu_mask.fetch_and(~(1u << m_cpu), AK::MemoryOrder::memory_order_relaxed);
+    Processor::s_idle_cpu_mask.fetch_and(~(1ull << m_cpu), AK::MemoryOrder::memory_order_relaxed);
 }
 
 template<typename T>
@@ -521,6 +521,7 @@ public:
 
     void initialize();
     bool is_msix_capable() const { return m_msix_info.table_size > 0; }
+    u16 msix_table_size() const { return m_msix_info.table_size; }
     u8 get_msix_table_bar() const { return m_msix_info.table_bar; }
     u32 get_msix_table_offset() const { return m_msix_info.table_offset; }
 
@@ -13,8 +13,9 @@ namespace Kernel::VirtIO {
 ErrorOr<NonnullOwnPtr<Queue>> Queue::try_create(u16 queue_size, u16 notify_offset)
 {
     size_t size_of_descriptors = sizeof(QueueDescriptor) * queue_size;
-    size_t size_of_driver = sizeof(QueueDriver) + queue_size * sizeof(u16);
-    size_t size_of_device = sizeof(QueueDevice) + queue_size * sizeof(QueueDeviceItem);
+    // NOTE: The device area has to be 4-byte aligned.
+    size_t size_of_driver = align_up_to(sizeof(QueueDriver) + (queue_size + 1) * sizeof(u16), 4);
+    size_t size_of_device = sizeof(QueueDevice) + queue_size * sizeof(QueueDeviceItem) + sizeof(u16);
     auto queue_region_size = TRY(Memory::page_round_up(size_of_descriptors + size_of_driver + size_of_device));
     OwnPtr<Memory::Region> queue_region;
     if (queue_region_size <= PAGE_SIZE)
@@ -31,7 +32,7 @@ Queue::Queue(NonnullOwnPtr<Memory::Region> queue_region, u16 queue_size, u16 not
     , m_queue_region(move(queue_region))
 {
     size_t size_of_descriptors = sizeof(QueueDescriptor) * queue_size;
-    size_t size_of_driver = sizeof(QueueDriver) + queue_size * sizeof(u16);
+    size_t size_of_driver = align_up_to(sizeof(QueueDriver) + (queue_size + 1) * sizeof(u16), 4);
     // TODO: ensure alignment!!!
     u8* ptr = m_queue_region->vaddr().as_ptr();
     memset(ptr, 0, m_queue_region->size());
@@ -91,6 +92,13 @@ QueueChain Queue::pop_used_buffer_chain(size_t& used)
     // We are now done with this buffer chain
     m_used_tail++;
 
+    if (m_event_index_enabled) {
+        // Ask for an interrupt once the device uses the next buffer. It might have done so already,
+        // which the caller finds out about when it checks for new data again.
+        used_event() = m_used_tail;
+        full_memory_barrier();
+    }
+
     return QueueChain(*this, descriptor_index, last_index, length_of_chain);
 }
 
@@ -130,9 +138,18 @@ Optional<u16> Queue::take_free_slot()
     return {};
 }
 
-bool Queue::should_notify() const
+bool Queue::should_notify()
 {
     VERIFY(m_lock.is_locked());
+    if (m_event_index_enabled) {
+        // The device wants to be notified once the driver index moves past avail_event, so we check
+        // whether that happened since the last time we looked.
+        full_memory_barrier();
+        u16 new_index = m_driver_index_shadow;
+        u16 old_index = m_notified_driver_index;
+        m_notified_driver_index = new_index;
+        return static_cast<u16>(new_index - avail_event() - 1) < static_cast<u16>(new_index - old_index);
+    }
     auto device_flags = m_device->flags;
     return !(device_flags & VIRTQ_USED_F_NO_NOTIFY);
 }
@@ -172,6 +189,26 @@ bool QueueChain::add_buffer_to_chain(PhysicalAddress buffer_start, size_t buffer
     return true;
 }
 
+bool QueueChain::add_indirect_buffer_to_chain(PhysicalAddress table_start, size_t descriptor_count)
+{
+    VERIFY(m_queue.lock().is_locked());
+    // An indirect descriptor can't be chained to other descriptors.
+    VERIFY(is_empty());
+
+    auto descriptor_index = m_queue.take_free_slot();
+    if (!descriptor_index.has_value())
+        return false;
+
+    m_start_of_chain_index = m_end_of_chain_index = descriptor_index.value();
+    m_chain_length = 1;
+
+    m_queue.m_descriptors[descriptor_index.value()].address = static_cast<u64>(table_start.get());
+    m_queue.m_descriptors[descriptor_index.value()].flags = VIRTQ_DESC_F_INDIRECT;
+    m_queue.m_descriptors[descriptor_index.value()].length = static_cast<u32>(descriptor_count * sizeof(Queue::QueueDescriptor));
+
+    return true;
+}
+
 void QueueChain::submit_to_queue()
 {
     VERIFY(m_queue.lock().is_locked());
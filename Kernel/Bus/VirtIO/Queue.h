@@ -27,6 +27,13 @@ enum class BufferType {
 
 class Queue {
 public:
+    struct [[gnu::packed]] QueueDescriptor {
+        u64 address;
+        u32 length;
+        u16 flags;
+        u16 next;
+    };
+
     static ErrorOr<NonnullOwnPtr<Queue>> try_create(u16 queue_size, u16 notify_offset);
 
     ~Queue();
@@ -36,6 +43,10 @@ public:
     void enable_interrupts();
     void disable_interrupts();
 
+    // With VIRTIO_F_EVENT_IDX, the driver and the device tell each other which ring entry they want to hear about
+    // next, instead of turning notifications on and off.
+    void enable_event_index() { m_event_index_enabled = true; }
+
     PhysicalAddress descriptor_area() const { return to_physical(m_descriptors); }
     PhysicalAddress driver_area() const { return to_physical(m_driver); }
     PhysicalAddress device_area() const { return to_physical(m_device); }
@@ -48,7 +59,7 @@ public:
 
     Spinlock<LockRank::None>& lock() { return m_lock; }
 
-    bool should_notify() const;
+    bool should_notify();
 
     u16 size() const { return m_queue_size; }
 
@@ -62,17 +73,11 @@ private:
         auto offset = FlatPtr(ptr) - m_queue_region->vaddr().get();
         return m_queue_region->physical_page(0)->paddr().offset(offset);
     }
-    struct [[gnu::packed]] QueueDescriptor {
-        u64 address;
-        u32 length;
-        u16 flags;
-        u16 next;
-    };
 
     struct [[gnu::packed]] QueueDriver {
         u16 flags;
         u16 index;
-        u16 rings[];
+        u16 rings[]; // Followed by used_event
     };
 
     struct [[gnu::packed]] QueueDeviceItem {
@@ -83,15 +88,20 @@ private:
     struct [[gnu::packed]] QueueDevice {
         u16 flags;
         u16 index;
-        QueueDeviceItem rings[];
+        QueueDeviceItem rings[]; // Followed by avail_event
     };
 
+    u16 volatile& used_event() { return *reinterpret_cast<u16 volatile*>(&m_driver->rings[m_queue_size]); }
+    u16 volatile& avail_event() { return *reinterpret_cast<u16 volatile*>(&m_device->rings[m_queue_size]); }
+
     u16 const m_queue_size;
     u16 const m_notify_offset;
     u16 m_free_buffers;
     u16 m_free_head { 0 };
     u16 m_used_tail { 0 };
     u16 m_driver_index_shadow { 0 };
+    u16 m_notified_driver_index { 0 };
+    bool m_event_index_enabled { false };
 
     QueueDescriptor* m_descriptors { nullptr };
     QueueDriver* m_driver { nullptr };
@@ -154,6 +164,8 @@ public:
     [[nodiscard]] bool is_empty() const { return m_chain_length == 0; }
     [[nodiscard]] size_t length() const { return m_chain_length; }
     bool add_buffer_to_chain(PhysicalAddress buffer_start, size_t buffer_length, BufferType buffer_type);
+    // The table is made up of descriptor_count Queue::QueueDescriptors, and has to be the only buffer in the chain.
+    bool add_indirect_buffer_to_chain(PhysicalAddress table_start, size_t descriptor_count);
     void submit_to_queue();
     void release_buffer_slots_to_queue();
 
@@ -121,6 +121,17 @@ void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, AsyncDeviceR
 {
     SpinlockLocker lock(m_requests_lock);
     VERIFY(!m_requests.is_empty());
+    if (can_process_requests_concurrently()) {
+        // Requests may complete in any order, and all of them have been started already.
+        for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+            if (it->ptr() == &completed_request) {
+                m_requests.remove(it);
+                break;
+            }
+        }
+        evaluate_block_conditions();
+        return;
+    }
     VERIFY(m_requests.first().ptr() == &completed_request);
     m_requests.remove(m_requests.begin());
     if (!m_requests.is_empty()) {
@@ -52,6 +52,10 @@ public:
     virtual void will_be_destroyed() override;
     virtual ErrorOr<void> after_inserting();
     virtual bool is_openable_by_jailed_processes() const { return false; }
+
+    // Devices that can have more than one request in flight start every request right away,
+    // instead of only starting the next one once the current one has completed.
+    virtual bool can_process_requests_concurrently() const { return false; }
     void process_next_queued_request(Badge<AsyncDeviceRequest>, AsyncDeviceRequest const&);
 
     template<typename AsyncRequestType, typename... Args>
@@ -61,7 +65,7 @@ public:
         SpinlockLocker lock(m_requests_lock);
         bool was_empty = m_requests.is_empty();
         TRY(m_requests.try_append(request));
-        if (was_empty)
+        if (was_empty || can_process_requests_concurrently())
             request->do_start(move(lock));
         return request;
     }
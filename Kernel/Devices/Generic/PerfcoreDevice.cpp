@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/API/MajorNumberAllocation.h>
+#include <Kernel/API/POSIX/errno.h>
+#include <Kernel/Devices/Device.h>
+#include <Kernel/Devices/Generic/PerfcoreDevice.h>
+#include <Kernel/FileSystem/OpenFileDescription.h>
+#include <Kernel/Sections.h>
+#include <Kernel/Tasks/Process.h>
+
+namespace Kernel {
+
+UNMAP_AFTER_INIT NonnullRefPtr<PerfcoreDevice> PerfcoreDevice::must_create()
+{
+    return MUST(Device::try_create_device<PerfcoreDevice>());
+}
+
+UNMAP_AFTER_INIT PerfcoreDevice::PerfcoreDevice()
+    : CharacterDevice(MajorAllocation::CharacterDeviceFamily::Generic, 12)
+{
+}
+
+UNMAP_AFTER_INIT PerfcoreDevice::~PerfcoreDevice() = default;
+
+ErrorOr<void> PerfcoreDevice::attach(OpenFileDescription& description)
+{
+    MutexLocker locker(m_lock);
+    if (m_reader)
+        return EBUSY;
+    if (!m_bounce_buffer)
+        m_bounce_buffer = TRY(KBuffer::try_create_with_size("PerfcoreDevice: Bounce buffer"sv, bounce_buffer_size));
+    m_reader = &description;
+    // Every reader gets a perfcore of its own, starting with the header and all strings.
+    m_drain_state = {};
+    return CharacterDevice::attach(description);
+}
+
+void PerfcoreDevice::detach(OpenFileDescription& description)
+{
+    MutexLocker locker(m_lock);
+    // NOTE: We're also called for descriptions that failed to attach.
+    if (m_reader == &description)
+        m_reader = nullptr;
+    CharacterDevice::detach(description);
+}
+
+ErrorOr<size_t> PerfcoreDevice::drain(size_t size)
+{
+    VERIFY(m_lock.is_exclusively_locked_by_current_thread());
+    // NOTE: The profiling lock keeps the buffer from being freed under us.
+    SpinlockLocker lock(g_profiling_lock);
+    if (!g_global_perf_events)
+        return ENOENT;
+    return g_global_perf_events->drain(m_drain_state, m_bounce_buffer->bytes().trim(size));
+}
+
+ErrorOr<size_t> PerfcoreDevice::read(OpenFileDescription& description, u64, UserOrKernelBuffer& buffer, size_t size)
+{
+    if (size < PerformanceEventBuffer::max_record_size)
+        return EINVAL;
+
+    MutexLocker locker(m_lock);
+    VERIFY(m_reader == &description);
+    size = min(size, bounce_buffer_size);
+    while (true) {
+        auto nread = TRY(drain(size));
+        if (nread > 0) {
+            TRY(buffer.write(m_bounce_buffer->data(), nread));
+            return nread;
+        }
+        // Once profiling is disabled, everything that's left has been read.
+        if (!g_profiling_all_threads)
+            return 0;
+        if (!description.is_blocking())
+            return EAGAIN;
+        if (Thread::current()->sleep(poll_interval).was_interrupted())
+            return EINTR;
+    }
+}
+
+}
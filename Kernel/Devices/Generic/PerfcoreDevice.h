@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <Kernel/Devices/CharacterDevice.h>
+#include <Kernel/Library/KBuffer.h>
+#include <Kernel/Locking/Mutex.h>
+#include <Kernel/Tasks/PerformanceEventBuffer.h>
+
+namespace Kernel {
+
+// Streams the events of the system-wide profile (see profiling_enable(-1)) as a perfcore, taking them out of the
+// buffer as they're read. Only one reader may have the device open at a time.
+class PerfcoreDevice final : public CharacterDevice {
+    friend class Device;
+
+public:
+    static NonnullRefPtr<PerfcoreDevice> must_create();
+    virtual ~PerfcoreDevice() override;
+
+private:
+    PerfcoreDevice();
+
+    // How often a blocking reader checks for new events, if there weren't any.
+    static constexpr Duration poll_interval = Duration::from_milliseconds(50);
+    static constexpr size_t bounce_buffer_size = 64 * KiB;
+
+    // ^File
+    virtual ErrorOr<void> attach(OpenFileDescription&) override;
+    virtual void detach(OpenFileDescription&) override;
+
+    // ^CharacterDevice
+    virtual ErrorOr<size_t> read(OpenFileDescription&, u64, UserOrKernelBuffer&, size_t) override;
+    virtual ErrorOr<size_t> write(OpenFileDescription&, u64, UserOrKernelBuffer const&, size_t) override { return EINVAL; }
+    virtual bool can_read(OpenFileDescription const&, u64) const override { return true; }
+    virtual bool can_write(OpenFileDescription const&, u64) const override { return false; }
+    virtual StringView class_name() const override { return "PerfcoreDevice"sv; }
+
+    ErrorOr<size_t> drain(size_t size);
+
+    Mutex m_lock { "PerfcoreDevice"sv };
+    OpenFileDescription* m_reader { nullptr };
+    OwnPtr<KBuffer> m_bounce_buffer;
+    PerformanceEventBuffer::DrainState m_drain_state;
+};
+
+}
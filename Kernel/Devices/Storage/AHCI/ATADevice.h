@@ -17,6 +17,10 @@ class ATADevice : public StorageDevice {
 public:
     virtual ~ATADevice() override;
 
+    // ^Device
+    // NOTE: The port keeps track of outstanding requests itself, and queues up the ones it has no command slot for.
+    virtual bool can_process_requests_concurrently() const override { return true; }
+
     // ^BlockDevice
     virtual void start_request(AsyncBlockDeviceRequest&) override;
 
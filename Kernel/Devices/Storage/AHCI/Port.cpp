@@ -37,14 +37,18 @@ ErrorOr<void> AHCIPort::allocate_resources_and_initialize_ports()
 
     m_fis_receive_page = TRY(MM.allocate_physical_page());
 
-    for (size_t index = 0; index < 1; index++) {
+    // NOTE: We only know whether the device supports queued commands once it's identified, so we allocate
+    // resources for as many command slots as the HBA could possibly use.
+    size_t command_slot_count = m_hba_capabilities.native_command_queuing_supported ? min(m_hba_capabilities.max_command_list_entries_count, (size_t)AHCI::Limits::MaxCommands) : 1;
+    for (size_t index = 0; index < command_slot_count; index++) {
         auto dma_page = TRY(MM.allocate_physical_page());
-        m_dma_buffers.append(move(dma_page));
+        TRY(m_dma_buffers.try_append(move(dma_page)));
     }
-    for (size_t index = 0; index < 1; index++) {
+    for (size_t index = 0; index < command_slot_count; index++) {
         auto command_table_page = TRY(MM.allocate_physical_page());
-        m_command_table_pages.append(move(command_table_page));
+        TRY(m_command_table_pages.try_append(move(command_table_page)));
     }
+    m_command_table_region = TRY(MM.allocate_kernel_region_with_physical_pages(m_command_table_pages.span(), "AHCI Command Tables"sv, Memory::Region::Access::ReadWrite, Memory::MemoryType::IO));
 
     // FIXME: Synchronize DMA buffer accesses correctly and set the MemoryType to NonCacheable.
     m_command_list_region = TRY(MM.allocate_dma_buffer_page("AHCI Port Command List"sv, Memory::Region::Access::ReadWrite, m_command_list_page, Memory::MemoryType::IO));
@@ -52,6 +56,7 @@ ErrorOr<void> AHCIPort::allocate_resources_and_initialize_ports()
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command list page at {}", representative_port_index(), m_command_list_page->paddr());
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: FIS receive page at {}", representative_port_index(), m_fis_receive_page->paddr());
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command list region at {}", representative_port_index(), m_command_list_region->vaddr());
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command table region at {}, {} command slots", representative_port_index(), m_command_table_region->vaddr(), command_slot_count);
     return {};
 }
 
@@ -86,20 +91,14 @@ void AHCIPort::handle_interrupt()
             auto work_item_creation_result = g_io_work->try_queue([this]() {
                 m_connected_device.clear();
             });
-            if (work_item_creation_result.is_error()) {
-                auto current_request = m_current_request;
-                m_current_request.clear();
-                current_request->complete(AsyncDeviceRequest::OutOfMemory);
-            }
+            if (work_item_creation_result.is_error())
+                stop_command_engine_and_fail_requests(AsyncDeviceRequest::OutOfMemory);
         } else {
             auto work_item_creation_result = g_io_work->try_queue([this]() {
                 reset();
             });
-            if (work_item_creation_result.is_error()) {
-                auto current_request = m_current_request;
-                m_current_request.clear();
-                current_request->complete(AsyncDeviceRequest::OutOfMemory);
-            }
+            if (work_item_creation_result.is_error())
+                stop_command_engine_and_fail_requests(AsyncDeviceRequest::OutOfMemory);
         }
         return;
     }
@@ -112,59 +111,31 @@ void AHCIPort::handle_interrupt()
         auto work_item_creation_result = g_io_work->try_queue([this]() {
             reset();
         });
-        if (work_item_creation_result.is_error()) {
-            auto current_request = m_current_request;
-            m_current_request.clear();
-            current_request->complete(AsyncDeviceRequest::OutOfMemory);
-        }
+        if (work_item_creation_result.is_error())
+            stop_command_engine_and_fail_requests(AsyncDeviceRequest::OutOfMemory);
         return;
     }
     if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::IF) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::TFE) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::HBD) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::HBF)) {
         auto work_item_creation_result = g_io_work->try_queue([this]() {
             recover_from_fatal_error();
         });
-        if (work_item_creation_result.is_error()) {
-            auto current_request = m_current_request;
-            m_current_request.clear();
-            current_request->complete(AsyncDeviceRequest::OutOfMemory);
-        }
+        if (work_item_creation_result.is_error())
+            stop_command_engine_and_fail_requests(AsyncDeviceRequest::OutOfMemory);
         return;
     }
-    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::DHR) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::PS)) {
-        m_wait_for_completion = false;
-
-        // Now schedule reading/writing the buffer as soon as we leave the irq handler.
+    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::DHR) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::PS) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::SDB)) {
+        // Now schedule reading/writing the buffers as soon as we leave the irq handler.
         // This is important so that we can safely access the buffers, which could
-        // trigger page faults
-        if (!m_current_request) {
-            dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request handled, probably identify request", representative_port_index());
-        } else {
+        // trigger page faults.
+        // NOTE: Queued commands complete in any order, and one interrupt can stand for several of them,
+        // so a single work item looks at all command slots.
+        if (!m_completion_scheduled.exchange(true)) {
             auto work_item_creation_result = g_io_work->try_queue([this]() {
-                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request handled", representative_port_index());
-                MutexLocker locker(m_lock);
-                VERIFY(m_current_request);
-                VERIFY(m_current_scatter_list);
-                if (!m_connected_device) {
-                    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request success", representative_port_index());
-                    complete_current_request(AsyncDeviceRequest::Failure);
-                    return;
-                }
-                if (m_current_request->request_type() == AsyncBlockDeviceRequest::Read) {
-                    if (auto result = m_current_request->write_to_buffer(m_current_request->buffer(), m_current_scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * m_current_request->block_count()); result.is_error()) {
-                        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when reading in data.", representative_port_index());
-                        m_current_scatter_list = nullptr;
-                        complete_current_request(AsyncDeviceRequest::MemoryFault);
-                        return;
-                    }
-                }
-                m_current_scatter_list = nullptr;
-                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request success", representative_port_index());
-                complete_current_request(AsyncDeviceRequest::Success);
+                complete_finished_requests();
             });
             if (work_item_creation_result.is_error()) {
-                auto current_request = m_current_request;
-                m_current_request.clear();
-                current_request->complete(AsyncDeviceRequest::OutOfMemory);
+                m_completion_scheduled.store(false);
+                fail_finished_and_pending_requests(AsyncDeviceRequest::OutOfMemory);
             }
         }
     }
@@ -179,14 +150,27 @@ bool AHCIPort::is_interrupts_enabled() const
 
 void AHCIPort::recover_from_fatal_error()
 {
-    MutexLocker locker(m_lock);
-    SpinlockLocker lock(m_hard_lock);
+    bool did_stop = false;
+    {
+        MutexLocker locker(m_lock);
+        SpinlockLocker lock(m_hard_lock);
+
+        dmesgln("{}: AHCI Port {} fatal error, shutting down!", m_parent_controller->device_identifier().address(), representative_port_index());
+        dmesgln("{}: AHCI Port {} fatal error, SError {}", m_parent_controller->device_identifier().address(), representative_port_index(), (u32)m_port_registers.serr);
+        stop_command_list_processing();
+        stop_fis_receiving();
+        m_interrupt_enable.clear();
+        // NOTE: The HBA may still be transferring data for the outstanding commands until it says it's done.
+        did_stop = wait_for_command_engine_to_stop();
+    }
 
-    dmesgln("{}: AHCI Port {} fatal error, shutting down!", m_parent_controller->device_identifier().address(), representative_port_index());
-    dmesgln("{}: AHCI Port {} fatal error, SError {}", m_parent_controller->device_identifier().address(), representative_port_index(), (u32)m_port_registers.serr);
-    stop_command_list_processing();
-    stop_fis_receiving();
-    m_interrupt_enable.clear();
+    // The port doesn't process any commands anymore, so none of the outstanding requests will ever complete.
+    if (did_stop) {
+        fail_all_requests(AsyncDeviceRequest::Failure);
+        return;
+    }
+    dmesgln("{}: AHCI Port {} command list is still running, only failing finished requests", m_parent_controller->device_identifier().address(), representative_port_index());
+    fail_finished_and_pending_requests(AsyncDeviceRequest::Failure);
 }
 
 bool AHCIPort::reset()
@@ -274,7 +258,16 @@ bool AHCIPort::initialize()
             m_port_registers.cmd = m_port_registers.cmd | (1 << 24);
         }
 
+        // Word 76 bit 8 says whether the device supports Native Command Queuing, and word 75 how many commands it can queue.
+        m_native_command_queuing_enabled = m_hba_capabilities.native_command_queuing_supported && !is_atapi_attached() && (identify_block->serial_ata_capabilities & (1 << 8));
+        if (m_native_command_queuing_enabled)
+            m_command_slot_count = min(m_dma_buffers.size(), (size_t)(identify_block->queue_depth & 0x1f) + 1);
+        else
+            m_command_slot_count = 1;
+
         dmesgln("AHCI Port {}: Device found, Capacity={}, Bytes per logical sector={}, Bytes per physical sector={}", representative_port_index(), max_addressable_sector * logical_sector_size, logical_sector_size, physical_sector_size);
+        if (m_native_command_queuing_enabled)
+            dmesgln("AHCI Port {}: Native Command Queuing enabled, queue depth={}", representative_port_index(), m_command_slot_count);
 
         // FIXME: We don't support ATAPI devices yet, so for now we don't "create" them
         if (!is_atapi_attached()) {
@@ -405,28 +398,44 @@ size_t AHCIPort::calculate_descriptors_count(size_t block_count) const
 {
     VERIFY(m_connected_device);
     size_t needed_dma_regions_count = Memory::page_round_up((block_count * m_connected_device->block_size())).value() / PAGE_SIZE;
-    VERIFY(needed_dma_regions_count <= m_dma_buffers.size());
+    // NOTE: Every command slot has exactly one DMA buffer.
+    VERIFY(needed_dma_regions_count <= 1);
     return needed_dma_regions_count;
 }
 
-Optional<AsyncDeviceRequest::RequestResult> AHCIPort::prepare_and_set_scatter_list(AsyncBlockDeviceRequest& request)
+Optional<AsyncDeviceRequest::RequestResult> AHCIPort::prepare_and_set_scatter_list(u8 command_slot, AsyncBlockDeviceRequest& request)
 {
     VERIFY(m_lock.is_locked());
     VERIFY(request.block_count() > 0);
 
     Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> allocated_dma_regions;
     for (size_t index = 0; index < calculate_descriptors_count(request.block_count()); index++) {
-        allocated_dma_regions.append(m_dma_buffers.at(index));
+        allocated_dma_regions.append(m_dma_buffers.at(command_slot + index));
     }
 
-    m_current_scatter_list = Memory::ScatterGatherList::try_create(request, allocated_dma_regions.span(), m_connected_device->block_size(), "AHCI Scattered DMA"sv).release_value_but_fixme_should_propagate_errors();
-    if (!m_current_scatter_list)
+    auto scatter_list = Memory::ScatterGatherList::try_create(request, allocated_dma_regions.span(), m_connected_device->block_size(), "AHCI Scattered DMA"sv).release_value_but_fixme_should_propagate_errors();
+    if (!scatter_list)
         return AsyncDeviceRequest::Failure;
     if (request.request_type() == AsyncBlockDeviceRequest::Write) {
-        if (auto result = request.read_from_buffer(request.buffer(), m_current_scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count()); result.is_error()) {
+        if (auto result = request.read_from_buffer(request.buffer(), scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count()); result.is_error()) {
             return AsyncDeviceRequest::MemoryFault;
         }
     }
+    SpinlockLocker lock(m_hard_lock);
+    m_command_slots[command_slot].scatter_list = move(scatter_list);
+    return {};
+}
+
+Optional<u8> AHCIPort::try_to_claim_command_slot(AsyncBlockDeviceRequest& request)
+{
+    VERIFY(m_hard_lock.is_locked());
+    for (u8 command_slot = 0; command_slot < m_command_slot_count; command_slot++) {
+        if (m_active_command_slots & (1u << command_slot))
+            continue;
+        m_active_command_slots |= 1u << command_slot;
+        m_command_slots[command_slot].request = request;
+        return command_slot;
+    }
     return {};
 }
 
@@ -434,34 +443,196 @@ void AHCIPort::start_request(AsyncBlockDeviceRequest& request)
 {
     MutexLocker locker(m_lock);
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request start", representative_port_index());
-    VERIFY(!m_current_request);
-    VERIFY(!m_current_scatter_list);
 
-    m_current_request = request;
+    Optional<u8> command_slot;
+    {
+        SpinlockLocker lock(m_hard_lock);
+        command_slot = try_to_claim_command_slot(request);
+        if (!command_slot.has_value()) {
+            // All command slots are busy, so the request is started once one of them is free again.
+            if (!m_pending_requests.try_append(request).is_error())
+                return;
+        }
+    }
+    if (!command_slot.has_value()) {
+        request.complete(AsyncDeviceRequest::OutOfMemory);
+        return;
+    }
+    start_request_in_command_slot(command_slot.value());
+}
+
+void AHCIPort::start_request_in_command_slot(u8 command_slot)
+{
+    VERIFY(m_lock.is_locked());
+    auto& request = *m_command_slots[command_slot].request;
 
-    auto result = prepare_and_set_scatter_list(request);
+    auto result = prepare_and_set_scatter_list(command_slot, request);
     if (result.has_value()) {
         dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
-        locker.unlock();
-        complete_current_request(result.value());
+        complete_request_in_command_slot(command_slot, result.value());
         return;
     }
 
-    auto success = access_device(request.request_type(), request.block_index(), request.block_count());
+    auto success = access_device(command_slot, request.request_type(), request.block_index(), request.block_count());
     if (!success) {
         dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
-        locker.unlock();
-        complete_current_request(AsyncDeviceRequest::Failure);
+        complete_request_in_command_slot(command_slot, AsyncDeviceRequest::Failure);
+        return;
+    }
+}
+
+void AHCIPort::start_pending_requests()
+{
+    VERIFY(m_lock.is_locked());
+    while (true) {
+        Optional<u8> command_slot;
+        {
+            SpinlockLocker lock(m_hard_lock);
+            if (m_pending_requests.is_empty())
+                return;
+            command_slot = try_to_claim_command_slot(m_pending_requests.first());
+            if (!command_slot.has_value())
+                return;
+            m_pending_requests.take_first();
+        }
+        start_request_in_command_slot(command_slot.value());
+    }
+}
+
+void AHCIPort::complete_request_in_command_slot(u8 command_slot, AsyncDeviceRequest::RequestResult result)
+{
+    VERIFY(m_lock.is_locked());
+    LockRefPtr<AsyncBlockDeviceRequest> request;
+    LockRefPtr<Memory::ScatterGatherList> scatter_list;
+    {
+        SpinlockLocker lock(m_hard_lock);
+        if (!(m_active_command_slots & (1u << command_slot)))
+            return;
+        request = move(m_command_slots[command_slot].request);
+        scatter_list = move(m_command_slots[command_slot].scatter_list);
+        m_active_command_slots &= ~(1u << command_slot);
+    }
+    VERIFY(request);
+    request->complete(result);
+}
+
+void AHCIPort::complete_finished_requests()
+{
+    // NOTE: This has to happen before we look at the registers, so we don't miss an interrupt that arrives in the meantime.
+    m_completion_scheduled.store(false);
+
+    MutexLocker locker(m_lock);
+    u32 finished_command_slots = 0;
+    {
+        SpinlockLocker lock(m_hard_lock);
+        // A queued command is running for as long as its bit in PxSACT is set, any other command for as long as its bit in PxCI is.
+        finished_command_slots = m_active_command_slots & ~(m_port_registers.ci | m_port_registers.sact);
+    }
+    if (finished_command_slots == 0) {
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: No request handled, probably identify request", representative_port_index());
         return;
     }
+
+    // NOTE: Command slots are only reused while holding m_lock, so the DMA buffers stay ours until the requests are completed.
+    for (u8 command_slot = 0; command_slot < AHCI::Limits::MaxCommands; command_slot++) {
+        if (!(finished_command_slots & (1u << command_slot)))
+            continue;
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request in command slot {} handled", representative_port_index(), command_slot);
+        // NOTE: The request might have been failed from the irq handler in the meantime.
+        if (!m_command_slots[command_slot].request)
+            continue;
+        if (!m_connected_device) {
+            complete_request_in_command_slot(command_slot, AsyncDeviceRequest::Failure);
+            continue;
+        }
+        auto& request = *m_command_slots[command_slot].request;
+        auto& scatter_list = m_command_slots[command_slot].scatter_list;
+        VERIFY(scatter_list);
+        if (request.request_type() == AsyncBlockDeviceRequest::Read) {
+            if (auto result = request.write_to_buffer(request.buffer(), scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count()); result.is_error()) {
+                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when reading in data.", representative_port_index());
+                complete_request_in_command_slot(command_slot, AsyncDeviceRequest::MemoryFault);
+                continue;
+            }
+        }
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request success", representative_port_index());
+        complete_request_in_command_slot(command_slot, AsyncDeviceRequest::Success);
+    }
+
+    start_pending_requests();
 }
 
-void AHCIPort::complete_current_request(AsyncDeviceRequest::RequestResult result)
+void AHCIPort::fail_all_requests(AsyncDeviceRequest::RequestResult result)
 {
-    VERIFY(m_current_request);
-    auto current_request = m_current_request;
-    m_current_request.clear();
-    current_request->complete(result);
+    // NOTE: This might be called from the irq handler, so we can't take m_lock here. The scatter lists are
+    // left alone for the same reason, they're replaced once their command slots are used again.
+    Array<LockRefPtr<AsyncBlockDeviceRequest>, AHCI::Limits::MaxCommands> active_requests;
+    Vector<NonnullLockRefPtr<AsyncBlockDeviceRequest>> pending_requests;
+    {
+        SpinlockLocker lock(m_hard_lock);
+        for (size_t command_slot = 0; command_slot < m_command_slots.size(); command_slot++)
+            active_requests[command_slot] = move(m_command_slots[command_slot].request);
+        m_active_command_slots = 0;
+        swap(pending_requests, m_pending_requests);
+    }
+    for (auto& request : active_requests) {
+        if (request)
+            request->complete(result);
+    }
+    for (auto& request : pending_requests)
+        request->complete(result);
+}
+
+void AHCIPort::fail_finished_and_pending_requests(AsyncDeviceRequest::RequestResult result)
+{
+    // NOTE: The HBA may still be transferring data for the commands that are still running, so their command slots
+    // (and their DMA buffers) have to stay untouched. They're completed once the HBA is done with them.
+    Array<LockRefPtr<AsyncBlockDeviceRequest>, AHCI::Limits::MaxCommands> finished_requests;
+    Vector<NonnullLockRefPtr<AsyncBlockDeviceRequest>> pending_requests;
+    {
+        SpinlockLocker lock(m_hard_lock);
+        u32 finished_command_slots = m_active_command_slots & ~(m_port_registers.ci | m_port_registers.sact);
+        for (size_t command_slot = 0; command_slot < m_command_slots.size(); command_slot++) {
+            if (!(finished_command_slots & (1u << command_slot)))
+                continue;
+            finished_requests[command_slot] = move(m_command_slots[command_slot].request);
+            m_active_command_slots &= ~(1u << command_slot);
+        }
+        swap(pending_requests, m_pending_requests);
+    }
+    for (auto& request : finished_requests) {
+        if (request)
+            request->complete(result);
+    }
+    for (auto& request : pending_requests)
+        request->complete(result);
+}
+
+void AHCIPort::stop_command_engine_and_fail_requests(AsyncDeviceRequest::RequestResult result)
+{
+    bool did_stop = false;
+    {
+        SpinlockLocker lock(m_hard_lock);
+        // NOTE: We can't take m_lock from the irq handler, so we can't use stop_command_list_processing() here.
+        m_port_registers.cmd = m_port_registers.cmd & 0xfffffffe;
+        full_memory_barrier();
+        did_stop = wait_for_command_engine_to_stop();
+    }
+    // Once the command list isn't running anymore, the HBA has let go of all command slots.
+    if (did_stop)
+        fail_all_requests(result);
+    else
+        fail_finished_and_pending_requests(result);
+}
+
+bool AHCIPort::wait_for_command_engine_to_stop() const
+{
+    VERIFY(m_hard_lock.is_locked());
+    // The AHCI specification gives the HBA 500 milliseconds to clear Command List Running, which also clears PxCI and PxSACT.
+    wait_until_condition_met_or_timeout(100, 5000, [this]() -> bool {
+        return !(m_port_registers.cmd & (1 << 15));
+    });
+    return !(m_port_registers.cmd & (1 << 15));
 }
 
 bool AHCIPort::spin_until_ready() const
@@ -480,44 +651,44 @@ bool AHCIPort::spin_until_ready() const
     return true;
 }
 
-bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64 lba, u8 block_count)
+bool AHCIPort::access_device(u8 command_slot, AsyncBlockDeviceRequest::RequestType direction, u64 lba, u8 block_count)
 {
     VERIFY(m_connected_device);
     VERIFY(is_operable());
     VERIFY(m_lock.is_locked());
-    VERIFY(m_current_scatter_list);
     SpinlockLocker lock(m_hard_lock);
+    auto& scatter_list = m_command_slots[command_slot].scatter_list;
+    VERIFY(scatter_list);
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {}", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count);
-    if (!spin_until_ready())
+    // NOTE: The HBA takes care of waiting for the device before sending it the next queued command,
+    // so we only have to wait here if no other command is outstanding.
+    bool other_commands_outstanding = (m_active_command_slots & ~(1u << command_slot)) != 0;
+
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {}, command slot {}", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, command_slot);
+    if (!other_commands_outstanding && !spin_until_ready())
         return false;
 
-    auto unused_command_header = try_to_find_unused_command_header();
-    VERIFY(unused_command_header.has_value());
     auto* command_list_entries = (volatile AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr();
-    command_list_entries[unused_command_header.value()].ctba = m_command_table_pages[unused_command_header.value()]->paddr().get();
-    command_list_entries[unused_command_header.value()].ctbau = 0;
-    command_list_entries[unused_command_header.value()].prdbc = 0;
-    command_list_entries[unused_command_header.value()].prdtl = m_current_scatter_list->scatters_count();
+    command_list_entries[command_slot].ctba = m_command_table_pages[command_slot]->paddr().get();
+    command_list_entries[command_slot].ctbau = 0;
+    command_list_entries[command_slot].prdbc = 0;
+    command_list_entries[command_slot].prdtl = scatter_list->scatters_count();
 
     // Note: we must set the correct Dword count in this register. Real hardware
     // AHCI controllers do care about this field! QEMU doesn't care if we don't
     // set the correct CFL field in this register, real hardware will set an
     // handshake error bit in PxSERR register if CFL is incorrect.
-    command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | (is_atapi_attached() ? AHCI::CommandHeaderAttributes::A : 0) | (direction == AsyncBlockDeviceRequest::RequestType::Write ? AHCI::CommandHeaderAttributes::W : 0);
-
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: CLE: ctba={:#08x}, ctbau={:#08x}, prdbc={:#08x}, prdtl={:#04x}, attributes={:#04x}", representative_port_index(), (u32)command_list_entries[unused_command_header.value()].ctba, (u32)command_list_entries[unused_command_header.value()].ctbau, (u32)command_list_entries[unused_command_header.value()].prdbc, (u16)command_list_entries[unused_command_header.value()].prdtl, (u16)command_list_entries[unused_command_header.value()].attributes);
+    command_list_entries[command_slot].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | (is_atapi_attached() ? AHCI::CommandHeaderAttributes::A : 0) | (direction == AsyncBlockDeviceRequest::RequestType::Write ? AHCI::CommandHeaderAttributes::W : 0);
 
-    auto command_table_region = MM.allocate_kernel_region_with_physical_pages({ &m_command_table_pages[unused_command_header.value()], 1 }, "AHCI Command Table"sv, Memory::Region::Access::ReadWrite, Memory::MemoryType::IO).release_value();
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: CLE: ctba={:#08x}, ctbau={:#08x}, prdbc={:#08x}, prdtl={:#04x}, attributes={:#04x}", representative_port_index(), (u32)command_list_entries[command_slot].ctba, (u32)command_list_entries[command_slot].ctbau, (u32)command_list_entries[command_slot].prdbc, (u16)command_list_entries[command_slot].prdtl, (u16)command_list_entries[command_slot].attributes);
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Allocated command table at {}", representative_port_index(), command_table_region->vaddr());
+    auto& command_table = *(volatile AHCI::CommandTable*)m_command_table_region->vaddr().offset(command_slot * PAGE_SIZE).as_ptr();
 
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
 
     size_t scatter_entry_index = 0;
     size_t data_transfer_count = (block_count * m_connected_device->block_size());
-    for (auto scatter_page : m_current_scatter_list->vmobject().physical_pages()) {
+    for (auto scatter_page : scatter_list->vmobject().physical_pages()) {
         VERIFY(data_transfer_count != 0);
         VERIFY(scatter_page);
         dbgln_if(AHCI_DEBUG, "AHCI Port {}: Add a transfer scatter entry @ {}", representative_port_index(), scatter_page->paddr());
@@ -541,6 +712,11 @@ bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64
     if (is_atapi_attached()) {
         fis.command = ATA_CMD_PACKET;
         TODO();
+    } else if (m_native_command_queuing_enabled) {
+        if (direction == AsyncBlockDeviceRequest::RequestType::Write)
+            fis.command = ATA_CMD_WRITE_FPDMA_QUEUED;
+        else
+            fis.command = ATA_CMD_READ_FPDMA_QUEUED;
     } else {
         if (direction == AsyncBlockDeviceRequest::RequestType::Write)
             fis.command = ATA_CMD_WRITE_DMA_EXT;
@@ -559,17 +735,28 @@ bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64
     fis.lba_low[0] = lba & 0xff;
     fis.lba_low[1] = (lba >> 8) & 0xff;
     fis.lba_low[2] = (lba >> 16) & 0xff;
-    fis.count = (block_count);
+    if (m_native_command_queuing_enabled) {
+        // Queued commands take the block count in the features registers, and the tag (which is the
+        // command slot) in bits 7:3 of the count register.
+        fis.features_low = block_count;
+        fis.features_high = 0;
+        fis.count = command_slot << 3;
+    } else {
+        fis.count = (block_count);
+    }
 
     // The below loop waits until the port is no longer busy before issuing a new command
-    if (!spin_until_ready())
+    if (!other_commands_outstanding && !spin_until_ready())
         return false;
 
     full_memory_barrier();
-    mark_command_header_ready_to_process(unused_command_header.value());
+    // NOTE: The AHCI specification requires the PxSACT bit of a queued command to be set before its PxCI bit.
+    if (m_native_command_queuing_enabled)
+        m_port_registers.sact = 1u << command_slot;
+    mark_command_header_ready_to_process(command_slot);
     full_memory_barrier();
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} @ {}, ended", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, m_dma_buffers[0]->paddr());
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} @ {}, ended", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, m_dma_buffers[command_slot]->paddr());
     return true;
 }
 
@@ -592,8 +779,7 @@ bool AHCIPort::identify_device()
     // QEMU doesn't care if we don't set the correct CFL field in this register, real hardware will set an handshake error bit in PxSERR register.
     command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P;
 
-    auto command_table_region = MM.allocate_kernel_region_with_physical_pages({ &m_command_table_pages[unused_command_header.value()], 1 }, "AHCI Command Table"sv, Memory::Region::Access::ReadWrite, Memory::MemoryType::IO).release_value();
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    auto& command_table = *(volatile AHCI::CommandTable*)m_command_table_region->vaddr().offset(unused_command_header.value() * PAGE_SIZE).as_ptr();
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
     command_table.descriptors[0].base_high = 0;
     command_table.descriptors[0].base_low = m_identify_buffer_page->paddr().get();
@@ -695,8 +881,6 @@ void AHCIPort::mark_command_header_ready_to_process(u8 command_header_index) con
     VERIFY(m_lock.is_locked());
     VERIFY(m_hard_lock.is_locked());
     VERIFY(is_operable());
-    VERIFY(!m_wait_for_completion);
-    m_wait_for_completion = true;
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Marking command header at index {} as ready to process.", representative_port_index(), command_header_index);
     m_port_registers.ci = 1 << command_header_index;
 }
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <AK/Array.h>
+#include <AK/Atomic.h>
 #include <AK/OwnPtr.h>
 #include <AK/RefPtr.h>
 #include <Kernel/Devices/Device.h>
@@ -70,10 +72,18 @@ private:
     ALWAYS_INLINE void power_on() const;
 
     void start_request(AsyncBlockDeviceRequest&);
-    void complete_current_request(AsyncDeviceRequest::RequestResult);
-    bool access_device(AsyncBlockDeviceRequest::RequestType, u64 lba, u8 block_count);
+    void start_request_in_command_slot(u8 command_slot);
+    void start_pending_requests();
+    void complete_request_in_command_slot(u8 command_slot, AsyncDeviceRequest::RequestResult);
+    void complete_finished_requests();
+    void fail_all_requests(AsyncDeviceRequest::RequestResult);
+    // These may be called from the irq handler, and never fail requests that the HBA might still be working on.
+    void fail_finished_and_pending_requests(AsyncDeviceRequest::RequestResult);
+    void stop_command_engine_and_fail_requests(AsyncDeviceRequest::RequestResult);
+    bool wait_for_command_engine_to_stop() const;
+    bool access_device(u8 command_slot, AsyncBlockDeviceRequest::RequestType, u64 lba, u8 block_count);
     size_t calculate_descriptors_count(size_t block_count) const;
-    [[nodiscard]] Optional<AsyncDeviceRequest::RequestResult> prepare_and_set_scatter_list(AsyncBlockDeviceRequest& request);
+    [[nodiscard]] Optional<AsyncDeviceRequest::RequestResult> prepare_and_set_scatter_list(u8 command_slot, AsyncBlockDeviceRequest& request);
 
     ALWAYS_INLINE bool is_interrupts_enabled() const;
 
@@ -94,6 +104,7 @@ private:
     void set_interface_state(AHCI::DeviceDetectionInitialization);
 
     Optional<u8> try_to_find_unused_command_header();
+    Optional<u8> try_to_claim_command_slot(AsyncBlockDeviceRequest&);
 
     ALWAYS_INLINE bool is_interface_disabled() const { return (m_port_registers.ssts & 0xf) == 4; }
 
@@ -102,14 +113,26 @@ private:
     // Data members
 
     EntropySource m_entropy_source;
-    LockRefPtr<AsyncBlockDeviceRequest> m_current_request;
     Spinlock<LockRank::None> m_hard_lock {};
     Mutex m_lock { "AHCIPort"sv };
 
-    mutable bool m_wait_for_completion { false };
+    struct CommandSlot {
+        LockRefPtr<AsyncBlockDeviceRequest> request;
+        LockRefPtr<Memory::ScatterGatherList> scatter_list;
+    };
 
+    // NOTE: The command slots, the mask of active slots and the pending requests are protected by m_hard_lock.
+    Array<CommandSlot, AHCI::Limits::MaxCommands> m_command_slots;
+    u32 m_active_command_slots { 0 };
+    Vector<NonnullLockRefPtr<AsyncBlockDeviceRequest>> m_pending_requests;
+    size_t m_command_slot_count { 1 };
+    bool m_native_command_queuing_enabled { false };
+    Atomic<bool> m_completion_scheduled { false };
+
+    // Every command slot has a DMA buffer and a command table page of its own.
     Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> m_dma_buffers;
     Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> m_command_table_pages;
+    OwnPtr<Memory::Region> m_command_table_region;
     RefPtr<Memory::PhysicalRAMPage> m_command_list_page;
     OwnPtr<Memory::Region> m_command_list_region;
     RefPtr<Memory::PhysicalRAMPage> m_fis_receive_page;
@@ -131,7 +154,6 @@ private:
     AHCI::PortInterruptStatusBitField m_interrupt_status;
     AHCI::PortInterruptEnableBitField m_interrupt_enable;
 
-    LockRefPtr<Memory::ScatterGatherList> m_current_scatter_list;
     bool m_disabled_by_firmware { false };
 };
 }
@@ -36,8 +36,8 @@ UNMAP_AFTER_INIT NVMeController::NVMeController(const PCI::DeviceIdentifier& dev
 
 UNMAP_AFTER_INIT ErrorOr<void> NVMeController::initialize(bool is_queue_polled)
 {
-    // Nr of queues = one queue per core
-    auto nr_of_queues = Processor::count();
+    // Nr of queues = one queue per core, as far as the controller and its interrupt vectors allow
+    u32 nr_of_queues = Processor::count();
     auto queue_type = is_queue_polled ? QueueType::Polled : QueueType::IRQ;
 
     PCI::enable_memory_space(device_identifier());
@@ -55,6 +55,9 @@ UNMAP_AFTER_INIT ErrorOr<void> NVMeController::initialize(bool is_queue_polled)
 
     calculate_doorbell_stride();
     if (queue_type == QueueType::IRQ) {
+        // Every IO queue needs its own MSIx vector, next to the one for the admin queue.
+        if (is_msix_capable())
+            nr_of_queues = clamp(static_cast<u32>(device_identifier().msix_table_size()) - 1, 1u, nr_of_queues);
         // IO queues + 1 admin queue
         m_irq_type = TRY(reserve_irqs(nr_of_queues + 1, true));
     }
@@ -66,10 +69,13 @@ UNMAP_AFTER_INIT ErrorOr<void> NVMeController::initialize(bool is_queue_polled)
     dbgln_if(NVME_DEBUG, "NVMe: IO queue depth is: {}", IO_QUEUE_SIZE);
 
     TRY(identify_and_init_controller());
+    nr_of_queues = TRY(set_number_of_io_queues(nr_of_queues));
+    dbgln_if(NVME_DEBUG, "NVMe: Using {} IO queues for {} processors", nr_of_queues, Processor::count());
+
     // Create an IO queue per core
-    for (u32 cpuid = 0; cpuid < nr_of_queues; ++cpuid) {
+    for (u32 queue_index = 0; queue_index < nr_of_queues; ++queue_index) {
         // qid is zero is used for admin queue
-        TRY(create_io_queue(cpuid + 1, queue_type));
+        TRY(create_io_queue(queue_index + 1, queue_type));
     }
     TRY(identify_and_init_namespaces());
     return {};
@@ -280,6 +286,28 @@ ErrorOr<void> NVMeController::identify_and_init_controller()
     return {};
 }
 
+UNMAP_AFTER_INIT ErrorOr<u32> NVMeController::set_number_of_io_queues(u32 requested_queue_count)
+{
+    VERIFY(requested_queue_count > 0);
+    NVMeSubmission sub {};
+    sub.op = OP_ADMIN_SET_FEATURES;
+    sub.generic.cdw10 = FEATURE_NUMBER_OF_QUEUES;
+    // The number of submission and completion queues are both 0 based
+    u32 requested = (requested_queue_count - 1) & NUMBER_OF_QUEUES_MASK;
+    sub.generic.cdw11 = requested | (requested << NUMBER_OF_CQS_SHIFT);
+
+    u32 allocated = 0;
+    if (auto status = m_admin_queue->submit_sync_sqe(sub, &allocated); status) {
+        dmesgln_pci(*this, "Failed to set the number of IO queues");
+        return EFAULT;
+    }
+
+    // The controller may allocate more or fewer queues than we asked for.
+    u32 allocated_submission_queues = (allocated & NUMBER_OF_QUEUES_MASK) + 1;
+    u32 allocated_completion_queues = (allocated >> NUMBER_OF_CQS_SHIFT) + 1;
+    return min(requested_queue_count, min(allocated_submission_queues, allocated_completion_queues));
+}
+
 UNMAP_AFTER_INIT NVMeController::NSFeatures NVMeController::get_ns_features(IdentifyNamespace& identify_data_struct)
 {
     auto flbas = identify_data_struct.flbas & FLBA_SIZE_MASK;
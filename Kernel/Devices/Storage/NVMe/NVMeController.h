@@ -63,6 +63,7 @@ private:
     ErrorOr<void> identify_and_init_namespaces();
     ErrorOr<void> identify_and_init_controller();
     NSFeatures get_ns_features(IdentifyNamespace& identify_data_struct);
+    ErrorOr<u32> set_number_of_io_queues(u32 requested_queue_count);
     ErrorOr<void> create_admin_queue(QueueType queue_type);
     ErrorOr<void> create_io_queue(u8 qid, QueueType queue_type);
     void calculate_doorbell_stride()
@@ -100,6 +100,8 @@ static constexpr u16 CQ_STATUS_FIELD(u16 x)
 
 static constexpr u16 ADMIN_QUEUE_SIZE = 2;
 static constexpr u16 IO_QUEUE_SIZE = 64; // TODO:Need to be configurable
+// Number of adjacent block requests that may be coalesced into a single IO command
+static constexpr size_t IO_MAX_COALESCED_REQUESTS = 8;
 
 // IDENTIFY
 static constexpr u16 NVMe_IDENTIFY_SIZE = 4096;
@@ -117,6 +119,7 @@ enum AdminCommandOpCode {
     OP_ADMIN_CREATE_COMPLETION_QUEUE = 0x5,
     OP_ADMIN_CREATE_SUBMISSION_QUEUE = 0x1,
     OP_ADMIN_IDENTIFY = 0x6,
+    OP_ADMIN_SET_FEATURES = 0x9,
     OP_ADMIN_DBBUF_CONFIG = 0x7C,
 };
 
@@ -126,6 +129,11 @@ enum IOCommandOpcode {
     OP_NVME_READ = 0x2
 };
 
+// FEATURES
+static constexpr u8 FEATURE_NUMBER_OF_QUEUES = 0x7;
+static constexpr u32 NUMBER_OF_QUEUES_MASK = 0xffff;
+static constexpr u8 NUMBER_OF_CQS_SHIFT = 16;
+
 // FLAGS
 static constexpr u8 QUEUE_PHY_CONTIGUOUS = (1 << 0);
 static constexpr u8 QUEUE_IRQ_ENABLED = (1 << 1);
@@ -10,28 +10,30 @@
 #include <Kernel/Devices/Storage/NVMe/NVMePollQueue.h>
 #include <Kernel/Devices/Storage/NVMe/NVMeQueue.h>
 #include <Kernel/Library/StdLib.h>
+#include <Kernel/Tasks/WorkQueue.h>
 
 namespace Kernel {
 ErrorOr<NonnullLockRefPtr<NVMeQueue>> NVMeQueue::try_create(NVMeController& device, u16 qid, Optional<u8> irq, u32 q_depth, OwnPtr<Memory::Region> cq_dma_region, OwnPtr<Memory::Region> sq_dma_region, Doorbell db_regs, QueueType queue_type)
 {
-    // Note: Allocate DMA region for RW operation. For now the requests don't exceed more than 4096 bytes (Storage device takes care of it)
-    RefPtr<Memory::PhysicalRAMPage> rw_dma_page;
+    // Note: Allocate one page of DMA memory per command identifier, so every command that can be in flight has its own buffer.
+    //       For now the requests don't exceed more than 4096 bytes (Storage device takes care of it)
+    Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> rw_dma_pages;
     // FIXME: Synchronize DMA buffer accesses correctly and set the MemoryType to NonCacheable.
-    auto rw_dma_region = TRY(MM.allocate_dma_buffer_page("NVMe Queue Read/Write DMA"sv, Memory::Region::Access::ReadWrite, rw_dma_page, Memory::MemoryType::IO));
+    auto rw_dma_region = TRY(MM.allocate_dma_buffer_pages(q_depth * PAGE_SIZE, "NVMe Queue Read/Write DMA"sv, Memory::Region::Access::ReadWrite, rw_dma_pages, Memory::MemoryType::IO));
 
-    if (rw_dma_page.is_null())
+    if (rw_dma_pages.size() != q_depth)
         return ENOMEM;
 
     if (queue_type == QueueType::Polled) {
-        auto queue = NVMePollQueue::try_create(move(rw_dma_region), rw_dma_page.release_nonnull(), qid, q_depth, move(cq_dma_region), move(sq_dma_region), move(db_regs));
+        auto queue = NVMePollQueue::try_create(move(rw_dma_region), move(rw_dma_pages), qid, q_depth, move(cq_dma_region), move(sq_dma_region), move(db_regs));
         return queue;
     }
 
-    auto queue = NVMeInterruptQueue::try_create(device, move(rw_dma_region), rw_dma_page.release_nonnull(), qid, irq.release_value(), q_depth, move(cq_dma_region), move(sq_dma_region), move(db_regs));
+    auto queue = NVMeInterruptQueue::try_create(device, move(rw_dma_region), move(rw_dma_pages), qid, irq.release_value(), q_depth, move(cq_dma_region), move(sq_dma_region), move(db_regs));
     return queue;
 }
 
-UNMAP_AFTER_INIT NVMeQueue::NVMeQueue(NonnullOwnPtr<Memory::Region> rw_dma_region, Memory::PhysicalRAMPage const& rw_dma_page, u16 qid, u32 q_depth, OwnPtr<Memory::Region> cq_dma_region, OwnPtr<Memory::Region> sq_dma_region, Doorbell db_regs)
+UNMAP_AFTER_INIT NVMeQueue::NVMeQueue(NonnullOwnPtr<Memory::Region> rw_dma_region, Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> rw_dma_pages, u16 qid, u32 q_depth, OwnPtr<Memory::Region> cq_dma_region, OwnPtr<Memory::Region> sq_dma_region, Doorbell db_regs)
     : m_rw_dma_region(move(rw_dma_region))
     , m_qid(qid)
     , m_admin_queue(qid == 0)
@@ -39,7 +41,7 @@ UNMAP_AFTER_INIT NVMeQueue::NVMeQueue(NonnullOwnPtr<Memory::Region> rw_dma_regio
     , m_cq_dma_region(move(cq_dma_region))
     , m_sq_dma_region(move(sq_dma_region))
     , m_db_regs(move(db_regs))
-    , m_rw_dma_page(rw_dma_page)
+    , m_rw_dma_pages(move(rw_dma_pages))
 
 {
     m_requests.with([q_depth](auto& requests) {
@@ -73,141 +75,211 @@ u32 NVMeQueue::process_cq()
         while (cqe_available()) {
             u16 status;
             u16 cmdid;
+            u32 command_specific;
             ++nr_of_processed_cqes;
             status = CQ_STATUS_FIELD(m_cqe_array[m_cq_head].status);
             cmdid = m_cqe_array[m_cq_head].command_id;
+            command_specific = m_cqe_array[m_cq_head].cmd_spec;
             dbgln_if(NVME_DEBUG, "NVMe: Completion with status {:x} and command identifier {}. CQ_HEAD: {}", status, cmdid, m_cq_head);
 
             if (!requests.contains(cmdid)) {
                 dmesgln("Bogus cmd id: {}", cmdid);
                 VERIFY_NOT_REACHED();
             }
-            complete_current_request_impl(cmdid, status, requests);
+            complete_current_request_impl(cmdid, status, command_specific, requests);
             update_cqe_head();
         }
     });
     if (nr_of_processed_cqes) {
+        m_submitted_commands.fetch_sub(nr_of_processed_cqes, AK::memory_order_release);
         update_cq_doorbell();
+
+        // Now that there is room in the submission queue again, pass on the requests that were waiting for it.
+        if (m_pending_requests.with([](auto& pending_requests) { return !pending_requests.is_empty(); }))
+            schedule_pending_requests_submission();
     }
     return nr_of_processed_cqes;
 }
 
-void NVMeQueue::submit_sqe(NVMeSubmission& sub)
+void NVMeQueue::submit_sqes(Span<NVMeSubmission> submissions)
 {
     SpinlockLocker lock(m_sq_lock);
 
-    memcpy(&m_sqe_array[m_sq_tail], &sub, sizeof(NVMeSubmission));
-    {
-        u32 temp_sq_tail = m_sq_tail + 1;
-        if (temp_sq_tail == m_qdepth)
-            m_sq_tail = 0;
-        else
-            m_sq_tail = temp_sq_tail;
+    for (auto& sub : submissions) {
+        memcpy(&m_sqe_array[m_sq_tail], &sub, sizeof(NVMeSubmission));
+        {
+            u32 temp_sq_tail = m_sq_tail + 1;
+            if (temp_sq_tail == m_qdepth)
+                m_sq_tail = 0;
+            else
+                m_sq_tail = temp_sq_tail;
+        }
+        dbgln_if(NVME_DEBUG, "NVMe: Submission with command identifier {}. SQ_TAIL: {}", sub.cmdid, m_sq_tail);
     }
 
-    dbgln_if(NVME_DEBUG, "NVMe: Submission with command identifier {}. SQ_TAIL: {}", sub.cmdid, m_sq_tail);
+    m_submitted_commands.fetch_add(submissions.size(), AK::memory_order_acq_rel);
+    // Ring the doorbell only once for the whole batch.
     update_sq_doorbell();
 }
 
-void NVMeQueue::complete_current_request_impl(u16 cmdid, u16 status, HashMap<u16, NVMeIO>& requests)
+void NVMeQueue::complete_current_request_impl(u16 cmdid, u16 status, u32 command_specific, HashMap<u16, NVMeIO>& requests)
 {
-    auto& request_pdu = requests.get(cmdid).release_value();
-    auto current_request = request_pdu.request;
-    AsyncDeviceRequest::RequestResult req_result = AsyncDeviceRequest::Success;
-
-    ScopeGuard guard = [&req_result, status, &request_pdu] {
-        if (request_pdu.request)
-            request_pdu.request->complete(req_result);
-        if (request_pdu.end_io_handler)
-            request_pdu.end_io_handler(status);
-        request_pdu.clear();
-    };
+    auto request_pdu = requests.take(cmdid).release_value();
 
     // There can be submission without any request associated with it such as with
-    // admin queue commands during init. If there is no request, we are done
-    if (!current_request)
-        return;
-
-    if (status) {
-        req_result = AsyncBlockDeviceRequest::Failure;
-        return;
-    }
-
-    if (current_request->request_type() == AsyncBlockDeviceRequest::RequestType::Read) {
-        if (auto result = current_request->write_to_buffer(current_request->buffer(), m_rw_dma_region->vaddr().as_ptr(), current_request->buffer_size()); result.is_error()) {
-            req_result = AsyncBlockDeviceRequest::MemoryFault;
-            return;
+    // admin queue commands during init.
+    size_t offset_in_dma_buffer = 0;
+    for (auto& request : request_pdu.requests) {
+        AsyncDeviceRequest::RequestResult req_result = AsyncBlockDeviceRequest::Success;
+        if (status) {
+            req_result = AsyncBlockDeviceRequest::Failure;
+        } else if (request->request_type() == AsyncBlockDeviceRequest::RequestType::Read) {
+            if (auto result = request->write_to_buffer(request->buffer(), dma_buffer_for_cid(cmdid) + offset_in_dma_buffer, request->buffer_size()); result.is_error())
+                req_result = AsyncBlockDeviceRequest::MemoryFault;
         }
+        offset_in_dma_buffer += request->buffer_size();
+        request->complete(req_result);
     }
+
+    if (request_pdu.end_io_handler)
+        request_pdu.end_io_handler(status, command_specific);
 }
 
 void NVMeQueue::complete_current_request(u16 cmdid, u16 status)
 {
     m_requests.with([this, cmdid, status](auto& requests) {
-        complete_current_request_impl(cmdid, status, requests);
+        complete_current_request_impl(cmdid, status, 0, requests);
     });
 }
 
-u16 NVMeQueue::submit_sync_sqe(NVMeSubmission& sub)
+u16 NVMeQueue::submit_sync_sqe(NVMeSubmission& sub, u32* command_specific)
 {
-    // For now let's use sq tail as a unique command id.
     u16 cmd_status;
-    u16 cid = get_request_cid();
-    sub.cmdid = cid;
+    u32 cmd_command_specific;
 
-    m_requests.with([this, &sub, &cmd_status](auto& requests) {
-        requests.set(sub.cmdid, { nullptr, [this, &cmd_status](u16 status) mutable { cmd_status = status; m_sync_wait_queue.wake_all(); } });
+    m_requests.with([this, &sub, &cmd_status, &cmd_command_specific](auto& requests) {
+        // NOTE: Sync submissions are only used during initialization, so there is always a free command identifier.
+        sub.cmdid = allocate_request_cid(requests).release_value();
+        requests.set(sub.cmdid, { {}, [this, &cmd_status, &cmd_command_specific](u16 status, u32 command_specific) mutable { cmd_status = status; cmd_command_specific = command_specific; m_sync_wait_queue.wake_all(); } });
     });
     submit_sqe(sub);
 
     // FIXME: Only sync submissions (usually used for admin commands) use a WaitQueue based IO. Eventually we need to
     //  move this logic into the block layer instead of sprinkling them in the driver code.
     m_sync_wait_queue.wait_forever("NVMe sync submit"sv);
+    if (command_specific)
+        *command_specific = cmd_command_specific;
     return cmd_status;
 }
 
-void NVMeQueue::read(AsyncBlockDeviceRequest& request, u16 nsid, u64 index, u32 count)
+void NVMeQueue::submit_request(AsyncBlockDeviceRequest& request, u16 nsid)
 {
-    NVMeSubmission sub {};
-    sub.op = OP_NVME_READ;
-    sub.rw.nsid = nsid;
-    sub.rw.slba = AK::convert_between_host_and_little_endian(index);
-    // No. of lbas is 0 based
-    sub.rw.length = AK::convert_between_host_and_little_endian((count - 1) & 0xFFFF);
-    sub.rw.data_ptr.prp1 = reinterpret_cast<u64>(AK::convert_between_host_and_little_endian(m_rw_dma_page->paddr().as_ptr()));
-    sub.cmdid = get_request_cid();
-
-    m_requests.with([&sub, &request](auto& requests) {
-        requests.set(sub.cmdid, { request, nullptr });
+    auto result = m_pending_requests.with([&](auto& pending_requests) {
+        return pending_requests.try_append({ request, nsid });
     });
-
-    full_memory_barrier();
-    submit_sqe(sub);
+    if (result.is_error()) {
+        request.complete(AsyncDeviceRequest::Failure);
+        return;
+    }
+    submit_pending_requests();
 }
 
-void NVMeQueue::write(AsyncBlockDeviceRequest& request, u16 nsid, u64 index, u32 count)
+void NVMeQueue::submit_pending_requests()
 {
-    NVMeSubmission sub {};
-
-    sub.op = OP_NVME_WRITE;
-    sub.rw.nsid = nsid;
-    sub.rw.slba = AK::convert_between_host_and_little_endian(index);
-    // No. of lbas is 0 based
-    sub.rw.length = AK::convert_between_host_and_little_endian((count - 1) & 0xFFFF);
-    sub.rw.data_ptr.prp1 = reinterpret_cast<u64>(AK::convert_between_host_and_little_endian(m_rw_dma_page->paddr().as_ptr()));
-    sub.cmdid = get_request_cid();
-
-    m_requests.with([&sub, &request](auto& requests) {
-        requests.set(sub.cmdid, { request, nullptr });
-    });
+    static constexpr size_t max_batch_size = 16;
+    Vector<NVMeSubmission, max_batch_size> batch;
+
+    for (;;) {
+        NVMeSubmission sub {};
+        NVMeIO io;
+
+        // Take as many adjacent requests as fit into a single command's DMA buffer.
+        bool has_command = m_pending_requests.with([&](auto& pending_requests) {
+            if (pending_requests.is_empty())
+                return false;
+            return m_requests.with([&](auto& requests) {
+                auto cid = allocate_request_cid(requests);
+                if (!cid.has_value())
+                    return false;
+
+                auto const& first = pending_requests.first();
+                auto request_type = first.request->request_type();
+                u64 next_block_index = first.request->block_index();
+                u32 block_count = 0;
+                size_t byte_count = 0;
+                for (auto const& pending_request : pending_requests) {
+                    auto& request = *pending_request.request;
+                    if (io.requests.size() == IO_MAX_COALESCED_REQUESTS
+                        || pending_request.nsid != first.nsid
+                        || request.request_type() != request_type
+                        || request.block_index() != next_block_index
+                        || byte_count + request.buffer_size() > PAGE_SIZE)
+                        break;
+                    io.requests.unchecked_append(request);
+                    next_block_index += request.block_count();
+                    block_count += request.block_count();
+                    byte_count += request.buffer_size();
+                }
+                pending_requests.remove(0, io.requests.size());
+
+                sub.op = request_type == AsyncBlockDeviceRequest::Read ? OP_NVME_READ : OP_NVME_WRITE;
+                sub.rw.nsid = first.nsid;
+                sub.rw.slba = AK::convert_between_host_and_little_endian(io.requests.first()->block_index());
+                // No. of lbas is 0 based
+                sub.rw.length = AK::convert_between_host_and_little_endian((block_count - 1) & 0xFFFF);
+                sub.rw.data_ptr.prp1 = reinterpret_cast<u64>(AK::convert_between_host_and_little_endian(m_rw_dma_pages[cid.value()]->paddr().as_ptr()));
+                sub.cmdid = cid.value();
+                requests.set(sub.cmdid, { io.requests, nullptr });
+                return true;
+            });
+        });
+        if (!has_command)
+            break;
+
+        if (sub.op == OP_NVME_WRITE) {
+            size_t offset_in_dma_buffer = 0;
+            bool faulted = false;
+            for (auto& request : io.requests) {
+                if (auto result = request->read_from_buffer(request->buffer(), dma_buffer_for_cid(sub.cmdid) + offset_in_dma_buffer, request->buffer_size()); result.is_error()) {
+                    faulted = true;
+                    break;
+                }
+                offset_in_dma_buffer += request->buffer_size();
+            }
+            if (faulted) {
+                complete_current_request(sub.cmdid, AsyncDeviceRequest::MemoryFault);
+                continue;
+            }
+        }
 
-    if (auto result = request.read_from_buffer(request.buffer(), m_rw_dma_region->vaddr().as_ptr(), request.buffer_size()); result.is_error()) {
-        complete_current_request(sub.cmdid, AsyncDeviceRequest::MemoryFault);
-        return;
+        batch.unchecked_append(sub);
+        if (batch.size() == max_batch_size) {
+            full_memory_barrier();
+            submit_sqes(batch.span());
+            batch.clear_with_capacity();
+        }
     }
 
-    full_memory_barrier();
-    submit_sqe(sub);
+    if (!batch.is_empty()) {
+        full_memory_barrier();
+        submit_sqes(batch.span());
+    }
+}
+
+void NVMeQueue::schedule_pending_requests_submission()
+{
+    if (m_pending_submission_scheduled.exchange(true))
+        return;
+
+    // NOTE: This has to happen in a thread, as writes copy their data from the requester's buffer.
+    auto result = g_io_work->try_queue([this] {
+        m_pending_submission_scheduled.store(false);
+        submit_pending_requests();
+    });
+    if (result.is_error()) {
+        // The next request or completion will try again.
+        m_pending_submission_scheduled.store(false);
+    }
 }
 
 UNMAP_AFTER_INIT NVMeQueue::~NVMeQueue() = default;
@@ -40,13 +40,14 @@ enum class QueueType {
 class AsyncBlockDeviceRequest;
 
 struct NVMeIO {
-    void clear()
-    {
-        request = nullptr;
-        end_io_handler = nullptr;
-    }
-    RefPtr<AsyncBlockDeviceRequest> request;
-    Function<void(u16 status)> end_io_handler;
+    // Adjacent block requests are coalesced, so a single command may complete more than one request.
+    Vector<NonnullRefPtr<AsyncBlockDeviceRequest>, IO_MAX_COALESCED_REQUESTS> requests;
+    Function<void(u16 status, u32 command_specific)> end_io_handler;
+};
+
+struct NVMePendingRequest {
+    NonnullRefPtr<AsyncBlockDeviceRequest> request;
+    u16 nsid { 0 };
 };
 
 class NVMeController;
@@ -54,14 +55,15 @@ class NVMeQueue : public AtomicRefCounted<NVMeQueue> {
 public:
     static ErrorOr<NonnullLockRefPtr<NVMeQueue>> try_create(NVMeController& device, u16 qid, Optional<u8> irq, u32 q_depth, OwnPtr<Memory::Region> cq_dma_region, OwnPtr<Memory::Region> sq_dma_region, Doorbell db_regs, QueueType queue_type);
     bool is_admin_queue() { return m_admin_queue; }
-    u16 submit_sync_sqe(NVMeSubmission&);
-    void read(AsyncBlockDeviceRequest& request, u16 nsid, u64 index, u32 count);
-    void write(AsyncBlockDeviceRequest& request, u16 nsid, u64 index, u32 count);
-    virtual void submit_sqe(NVMeSubmission&);
+    u16 submit_sync_sqe(NVMeSubmission&, u32* command_specific = nullptr);
+    void submit_request(AsyncBlockDeviceRequest& request, u16 nsid);
+    void submit_sqe(NVMeSubmission& submission) { submit_sqes({ &submission, 1 }); }
+    virtual void submit_sqes(Span<NVMeSubmission>);
     virtual ~NVMeQueue();
 
 protected:
     u32 process_cq();
+    bool has_submitted_commands() const { return m_submitted_commands.load(AK::memory_order_acquire) > 0; }
 
     // Updates the shadow buffer and returns if mmio is needed
     bool update_shadow_buf(u16 new_value, u32* dbbuf, u32* ei)
@@ -83,25 +85,29 @@ protected:
             m_db_regs.mmio_reg->sq_tail = m_sq_tail;
     }
 
-    NVMeQueue(NonnullOwnPtr<Memory::Region> rw_dma_region, Memory::PhysicalRAMPage const& rw_dma_page, u16 qid, u32 q_depth, OwnPtr<Memory::Region> cq_dma_region, OwnPtr<Memory::Region> sq_dma_region, Doorbell db_regs);
+    NVMeQueue(NonnullOwnPtr<Memory::Region> rw_dma_region, Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> rw_dma_pages, u16 qid, u32 q_depth, OwnPtr<Memory::Region> cq_dma_region, OwnPtr<Memory::Region> sq_dma_region, Doorbell db_regs);
 
-    [[nodiscard]] u32 get_request_cid()
+    // Every command identifier owns one page of the read/write DMA region.
+    [[nodiscard]] Optional<u16> allocate_request_cid(HashMap<u16, NVMeIO> const& requests)
     {
-        u32 expected_tag = m_tag.load(AK::memory_order_acquire);
+        // One entry always stays free, as a full submission queue would look exactly like an empty one.
+        if (requests.size() >= m_qdepth - 1)
+            return {};
 
         for (;;) {
-            u32 cid = expected_tag + 1;
-            if (cid == m_qdepth)
-                cid = 0;
-            if (m_tag.compare_exchange_strong(expected_tag, cid, AK::memory_order_acquire))
-                return cid;
+            m_tag = (m_tag + 1) % m_qdepth;
+            if (!requests.contains(m_tag))
+                return m_tag;
         }
     }
 
     virtual void complete_current_request(u16 cmdid, u16 status);
 
 private:
-    void complete_current_request_impl(u16 cmdid, u16 status, HashMap<u16, NVMeIO>& requests);
+    void submit_pending_requests();
+    void schedule_pending_requests_submission();
+    u8* dma_buffer_for_cid(u16 cmdid) { return m_rw_dma_region->vaddr().offset(cmdid * PAGE_SIZE).as_ptr(); }
+    void complete_current_request_impl(u16 cmdid, u16 status, u32 command_specific, HashMap<u16, NVMeIO>& requests);
     bool cqe_available();
     void update_cqe_head();
     void update_cq_doorbell()
@@ -114,6 +120,8 @@ private:
 
 protected:
     SpinlockProtected<HashMap<u16, NVMeIO>, LockRank::None> m_requests;
+    // Requests that didn't fit into the submission queue yet, in the order they were started.
+    SpinlockProtected<Vector<NVMePendingRequest>, LockRank::None> m_pending_requests;
     NonnullOwnPtr<Memory::Region> m_rw_dma_region;
 
 private:
@@ -123,7 +131,9 @@ private:
     u16 m_cq_head {};
     bool m_admin_queue { false };
     u32 m_qdepth {};
-    Atomic<u32> m_tag { 0 }; // used for the cid in a submission queue entry
+    u16 m_tag { 0 }; // used for the cid in a submission queue entry, protected by m_requests
+    Atomic<u32> m_submitted_commands { 0 };
+    Atomic<bool> m_pending_submission_scheduled { false };
     Spinlock<LockRank::Interrupts> m_sq_lock {};
     OwnPtr<Memory::Region> m_cq_dma_region;
     Span<NVMeSubmission> m_sqe_array;
@@ -131,6 +141,6 @@ private:
     Span<NVMeCompletion> m_cqe_array;
     WaitQueue m_sync_wait_queue;
     Doorbell m_db_regs;
-    NonnullRefPtr<Memory::PhysicalRAMPage const> const m_rw_dma_page;
+    Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> const m_rw_dma_pages;
 };
 }
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <Kernel/Arch/Processor.h>
 #include <Kernel/Devices/Storage/VirtIO/VirtIOBlockDevice.h>
 #include <Kernel/Memory/MemoryManager.h>
 #include <Kernel/Tasks/WorkQueue.h>
@@ -25,6 +26,7 @@ static constexpr u64 VIRTIO_BLK_F_SCSI = 1ull << 7;          // Device supports
 static constexpr u64 VIRTIO_BLK_F_FLUSH = 1ull << 9;         // Cache flush command support.
 static constexpr u64 VIRTIO_BLK_F_TOPOLOGY = 1ull << 10;     // Device exports information on optimal I/O alignment.
 static constexpr u64 VIRTIO_BLK_F_CONFIG_WCE = 1ull << 11;   // Device can toggle its cache between writeback and writethrough modes.
+static constexpr u64 VIRTIO_BLK_F_MQ = 1ull << 12;           // Device supports multiqueue.
 static constexpr u64 VIRTIO_BLK_F_DISCARD = 1ull << 13;      // Device can support discard command, maximum discard sectors size in max_discard_sectors and maximum discard segment number in max_discard_seg.
 static constexpr u64 VIRTIO_BLK_F_WRITE_ZEROES = 1ull << 14; // Device can support write zeroes command, maximum write zeroes sectors size in max_write_zeroes_sectors and maximum write zeroes segment number in max_write_zeroes_seg.
 
@@ -62,7 +64,8 @@ struct [[gnu::packed]] VirtIOBlkConfig {
         LittleEndian<u32> opt_io_size;
     } topology;
     u8 writeback;
-    u8 unused0[3];
+    u8 unused0;
+    LittleEndian<u16> num_queues;
     LittleEndian<u32> max_discard_sectors;
     LittleEndian<u32> max_discard_seg;
     LittleEndian<u32> discard_sector_alignment;
@@ -91,10 +94,16 @@ struct [[gnu::packed]] VirtIOBlkReq {
 
 using namespace VirtIO;
 
-static constexpr u16 REQUESTQ = 0;
 static constexpr u64 SECTOR_SIZE = 512;
 static constexpr u64 INFLIGHT_BUFFER_SIZE = PAGE_SIZE * 16; // 128 blocks
 static constexpr u64 MAX_ADDRESSABLE_BLOCK = 1ull << 32;    // FIXME: Supply effective device size.
+static constexpr size_t DATA_PAGES_PER_REQUEST = INFLIGHT_BUFFER_SIZE / PAGE_SIZE;
+
+// The request page of a slot starts with the VirtIOBlkReq, followed by the indirect descriptor table.
+static constexpr size_t INDIRECT_TABLE_OFFSET = 32;
+static constexpr size_t MAX_DESCRIPTORS_PER_REQUEST = DATA_PAGES_PER_REQUEST + 2; // Header, data and status
+static_assert(sizeof(VirtIOBlkReq) <= INDIRECT_TABLE_OFFSET);
+static_assert(INDIRECT_TABLE_OFFSET + MAX_DESCRIPTORS_PER_REQUEST * sizeof(Queue::QueueDescriptor) <= PAGE_SIZE);
 
 UNMAP_AFTER_INIT VirtIOBlockDevice::VirtIOBlockDevice(
     NonnullOwnPtr<VirtIO::TransportEntity> transport,
@@ -109,65 +118,126 @@ UNMAP_AFTER_INIT ErrorOr<void> VirtIOBlockDevice::initialize_virtio_resources()
 {
     dbgln_if(VIRTIO_DEBUG, "VirtIOBlockDevice::initialize_virtio_resources");
     TRY(VirtIO::Device::initialize_virtio_resources());
+    m_device_config = TRY(transport_entity().get_config(VirtIO::ConfigurationType::Device));
+
+    TRY(negotiate_features([&](u64 supported_features) {
+        u64 negotiated = 0;
+        if (is_feature_set(supported_features, VIRTIO_BLK_F_MQ))
+            negotiated |= VIRTIO_BLK_F_MQ;
+        if (is_feature_set(supported_features, VIRTIO_F_INDIRECT_DESC))
+            negotiated |= VIRTIO_F_INDIRECT_DESC;
+        if (is_feature_set(supported_features, VIRTIO_F_EVENT_IDX))
+            negotiated |= VIRTIO_F_EVENT_IDX;
+        return negotiated;
+    }));
 
-    m_header_buf = TRY(MM.allocate_contiguous_kernel_region(
-        PAGE_SIZE, "VirtIOBlockDevice header_buf"sv, Memory::Region::Access::Read | Memory::Region::Access::Write));
-    m_data_buf = TRY(MM.allocate_contiguous_kernel_region(
-        INFLIGHT_BUFFER_SIZE, "VirtIOBlockDevice data_buf"sv, Memory::Region::Access::Read | Memory::Region::Access::Write));
+    // One request queue per processor, as far as the device allows.
+    u16 queue_count = 1;
+    if (is_feature_accepted(VIRTIO_BLK_F_MQ)) {
+        u16 device_queue_count = transport_entity().config_read16(*m_device_config, offsetof(VirtIOBlkConfig, num_queues));
+        queue_count = clamp<u32>(Processor::count(), 1, max<u16>(device_queue_count, 1));
+    }
+    TRY(setup_queues(queue_count));
+
+    for (u16 queue_index = 0; queue_index < queue_count; queue_index++)
+        TRY(m_request_queues.try_append(TRY(create_request_queue(queue_index))));
+    dbgln_if(VIRTIO_DEBUG, "VirtIOBlockDevice: Using {} request queues for {} processors", queue_count, Processor::count());
 
-    TRY(negotiate_features([&](u64) {
-        return 0; // We rely on the basic feature set.
-    }));
-    TRY(setup_queues(1)); // REQUESTQ
     finish_init();
     return {};
 }
 
+UNMAP_AFTER_INIT ErrorOr<NonnullOwnPtr<VirtIOBlockDevice::RequestQueue>> VirtIOBlockDevice::create_request_queue(u16 queue_index)
+{
+    auto request_queue = TRY(adopt_nonnull_own_or_enomem(new (nothrow) RequestQueue));
+    request_queue->queue_index = queue_index;
+
+    // Without indirect descriptors, every buffer of a request takes up a descriptor in the queue itself.
+    size_t slot_count = MAX_REQUESTS_PER_QUEUE;
+    if (!is_feature_accepted(VIRTIO_F_INDIRECT_DESC))
+        slot_count = clamp<size_t>(get_queue(queue_index).size() / MAX_DESCRIPTORS_PER_REQUEST, 1, MAX_REQUESTS_PER_QUEUE);
+
+    request_queue->request_pages = TRY(MM.allocate_contiguous_kernel_region(
+        slot_count * PAGE_SIZE, "VirtIOBlockDevice requests"sv, Memory::Region::Access::Read | Memory::Region::Access::Write));
+    TRY(request_queue->data_pages.try_ensure_capacity(slot_count * DATA_PAGES_PER_REQUEST));
+    for (size_t i = 0; i < slot_count * DATA_PAGES_PER_REQUEST; i++)
+        request_queue->data_pages.unchecked_append(TRY(MM.allocate_physical_page()));
+    TRY(request_queue->slots.try_resize(slot_count));
+    return request_queue;
+}
+
 ErrorOr<void> VirtIOBlockDevice::handle_device_config_change()
 {
     dbgln_if(VIRTIO_DEBUG, "VirtIOBlockDevice::handle_device_config_change");
     return {};
 }
 
+Optional<size_t> VirtIOBlockDevice::try_to_claim_slot(RequestQueue& request_queue, AsyncBlockDeviceRequest& request)
+{
+    VERIFY(get_queue(request_queue.queue_index).lock().is_locked());
+    for (size_t slot_index = 0; slot_index < request_queue.slots.size(); slot_index++) {
+        auto& slot = request_queue.slots[slot_index];
+        if (slot.request)
+            continue;
+        slot.request = request;
+        return slot_index;
+    }
+    return {};
+}
+
 void VirtIOBlockDevice::start_request(AsyncBlockDeviceRequest& request)
 {
     dbgln_if(VIRTIO_DEBUG, "VirtIOBlockDevice::start_request type={}", (int)request.request_type());
 
-    m_current_request.with([&](auto& current_request) {
-        VERIFY(current_request.is_null());
-        current_request = request;
-    });
-
-    if (maybe_start_request(request).is_error()) {
-        m_current_request.with([&](auto& current_request) {
-            VERIFY(current_request == request);
-            current_request.clear();
-        });
-        request.complete(AsyncDeviceRequest::Failure);
+    auto& request_queue = *m_request_queues[Processor::current_id() % m_request_queues.size()];
+    Optional<size_t> slot_index;
+    {
+        SpinlockLocker queue_lock(get_queue(request_queue.queue_index).lock());
+        slot_index = try_to_claim_slot(request_queue, request);
+        if (!slot_index.has_value()) {
+            // All slots are in use, the request is started once one of them is free again.
+            if (!request_queue.pending_requests.try_append(request).is_error())
+                return;
+        }
+    }
+    if (!slot_index.has_value()) {
+        request.complete(AsyncDeviceRequest::OutOfMemory);
+        return;
     }
+    start_request_in_slot(request_queue, slot_index.value());
 }
 
-ErrorOr<void> VirtIOBlockDevice::maybe_start_request(AsyncBlockDeviceRequest& request)
+void VirtIOBlockDevice::start_request_in_slot(RequestQueue& request_queue, size_t slot_index)
 {
-    auto& queue = get_queue(REQUESTQ);
-    SpinlockLocker queue_lock(queue.lock());
-    VirtIO::QueueChain chain(queue);
+    if (maybe_start_request_in_slot(request_queue, slot_index).is_error())
+        complete_request_in_slot(request_queue, slot_index, AsyncDeviceRequest::Failure);
+}
+
+ErrorOr<void> VirtIOBlockDevice::maybe_start_request_in_slot(RequestQueue& request_queue, size_t slot_index)
+{
+    auto& slot = request_queue.slots[slot_index];
+    auto& request = *slot.request;
 
     u64 data_size = block_size() * request.block_count();
     if (request.buffer_size() < data_size) {
         dmesgln("VirtIOBlockDevice: not enough space in the request buffer.");
         return Error::from_errno(EINVAL);
     }
-    if (m_data_buf->size() < data_size + sizeof(VirtIOBlkReqTrailer)) {
+    if (data_size == 0 || data_size > INFLIGHT_BUFFER_SIZE) {
         // TODO: Supply the provider buffer instead to avoid copies.
         dmesgln("VirtIOBlockDevice: not enough space in the internal buffer.");
         return Error::from_errno(ENOMEM);
     }
 
-    // m_header_buf contains VirtIOBlkReqHeader and VirtIOBlkReqTrailer contingously
-    // When adding to chain we insert the parts of m_header_buf (as device-readable)
-    // and the data buffer in between (as device-writable if needed).
-    VirtIOBlkReq* device_req = (VirtIOBlkReq*)m_header_buf->vaddr().as_ptr();
+    // NOTE: Nobody else touches the slot's buffers until the request is completed, so we fill them in without holding the queue lock.
+    auto data_pages = request_queue.data_pages.span().slice(slot_index * DATA_PAGES_PER_REQUEST, TRY(Memory::page_round_up(data_size)) / PAGE_SIZE);
+    slot.scatter_list = TRY(Memory::ScatterGatherList::try_create(request, data_pages, block_size(), "VirtIOBlockDevice data"sv));
+    if (!slot.scatter_list)
+        return Error::from_errno(ENOMEM);
+
+    auto* request_page = request_queue.request_pages->vaddr().offset(slot_index * PAGE_SIZE).as_ptr();
+    auto request_page_address = request_queue.request_pages->physical_page(0)->paddr().offset(slot_index * PAGE_SIZE);
+    auto* device_req = reinterpret_cast<VirtIOBlkReq*>(request_page);
 
     device_req->header.reserved = 0;
     device_req->header.sector = request.block_index();
@@ -179,74 +249,181 @@ ErrorOr<void> VirtIOBlockDevice::maybe_start_request(AsyncBlockDeviceRequest& re
     } else if (request.request_type() == AsyncBlockDeviceRequest::Write) {
         device_req->header.type = VIRTIO_BLK_T_OUT;
         buffer_type = BufferType::DeviceReadable;
-        TRY(request.read_from_buffer(request.buffer(), m_data_buf->vaddr().as_ptr(), data_size));
+        TRY(request.read_from_buffer(request.buffer(), slot.scatter_list->dma_region().as_ptr(), data_size));
     } else {
         return Error::from_errno(EINVAL);
     }
 
-    chain.add_buffer_to_chain(m_header_buf->physical_page(0)->paddr(), sizeof(VirtIOBlkReqHeader), BufferType::DeviceReadable);
-    chain.add_buffer_to_chain(m_data_buf->physical_page(0)->paddr(), data_size, buffer_type);
-    chain.add_buffer_to_chain(m_header_buf->physical_page(0)->paddr().offset(sizeof(VirtIOBlkReqHeader)), sizeof(VirtIOBlkReqTrailer), BufferType::DeviceWritable);
-    supply_chain_and_notify(REQUESTQ, chain);
+    // The request consists of the header (device-readable), the data pages (device-writable if needed),
+    // and the status (device-writable).
+    Vector<Queue::QueueDescriptor, MAX_DESCRIPTORS_PER_REQUEST> descriptors;
+    auto add_descriptor = [&](PhysicalAddress address, size_t length, BufferType type) {
+        descriptors.unchecked_append({ address.get(), static_cast<u32>(length), static_cast<u16>(type), 0 });
+    };
+    add_descriptor(request_page_address, sizeof(VirtIOBlkReqHeader), BufferType::DeviceReadable);
+    size_t remaining_data_size = data_size;
+    for (auto const& page : slot.scatter_list->vmobject().physical_pages()) {
+        auto length = min<size_t>(remaining_data_size, PAGE_SIZE);
+        add_descriptor(page->paddr(), length, buffer_type);
+        remaining_data_size -= length;
+    }
+    add_descriptor(request_page_address.offset(sizeof(VirtIOBlkReqHeader)), sizeof(VirtIOBlkReqTrailer), BufferType::DeviceWritable);
+
+    auto& queue = get_queue(request_queue.queue_index);
+    SpinlockLocker queue_lock(queue.lock());
+    VirtIO::QueueChain chain(queue);
+    if (is_feature_accepted(VIRTIO_F_INDIRECT_DESC)) {
+        // The whole request takes up a single descriptor in the queue, and the device follows it to the table in the request page.
+        auto* table = reinterpret_cast<Queue::QueueDescriptor*>(request_page + INDIRECT_TABLE_OFFSET);
+        for (size_t i = 0; i < descriptors.size(); i++) {
+            table[i] = descriptors[i];
+            if (i + 1 < descriptors.size()) {
+                table[i].flags |= VIRTQ_DESC_F_NEXT;
+                table[i].next = i + 1;
+            }
+        }
+        VERIFY(chain.add_indirect_buffer_to_chain(request_page_address.offset(INDIRECT_TABLE_OFFSET), descriptors.size()));
+    } else {
+        // NOTE: The slot count is chosen so that the queue has enough descriptors for all of them.
+        for (auto const& descriptor : descriptors)
+            VERIFY(chain.add_buffer_to_chain(PhysicalAddress(descriptor.address), descriptor.length, static_cast<BufferType>(descriptor.flags)));
+    }
+    supply_chain_and_notify(request_queue.queue_index, chain);
     return {};
 }
 
+void VirtIOBlockDevice::complete_request_in_slot(RequestQueue& request_queue, size_t slot_index, AsyncDeviceRequest::RequestResult result)
+{
+    RefPtr<AsyncBlockDeviceRequest> request;
+    LockRefPtr<Memory::ScatterGatherList> scatter_list;
+    {
+        SpinlockLocker queue_lock(get_queue(request_queue.queue_index).lock());
+        auto& slot = request_queue.slots[slot_index];
+        request = move(slot.request);
+        scatter_list = move(slot.scatter_list);
+        slot.completed = false;
+    }
+    VERIFY(request);
+    request->complete(result);
+}
+
 void VirtIOBlockDevice::handle_queue_update(u16 queue_index)
 {
     dbgln_if(VIRTIO_DEBUG, "VirtIOBlockDevice::handle_queue_update {}", queue_index);
 
-    if (queue_index == REQUESTQ) {
-        auto& queue = get_queue(REQUESTQ);
-        SpinlockLocker queue_lock(queue.lock());
+    if (queue_index >= m_request_queues.size()) {
+        dmesgln("VirtIOBlockDevice::handle_queue_update unexpected update for queue {}", queue_index);
+        return;
+    }
 
+    auto& request_queue = *m_request_queues[queue_index];
+    auto& queue = get_queue(queue_index);
+    {
+        SpinlockLocker queue_lock(queue.lock());
+        auto request_pages_address = request_queue.request_pages->physical_page(0)->paddr();
         size_t used;
-        VirtIO::QueueChain popped_chain = queue.pop_used_buffer_chain(used);
-        // Exactly one request is completed.
-        VERIFY(popped_chain.length() == 3);
-        VERIFY(!queue.new_data_available());
-
-        auto work_res = g_io_work->try_queue([this]() {
-            respond();
-        });
-        if (work_res.is_error()) {
-            dmesgln("VirtIOBlockDevice::handle_queue_update error starting response: {}", work_res.error());
+        for (auto popped_chain = queue.pop_used_buffer_chain(used); !popped_chain.is_empty(); popped_chain = queue.pop_used_buffer_chain(used)) {
+            // The first buffer of every request (the request header, or the indirect descriptor table) lives in the request page of its slot.
+            Optional<PhysicalAddress> first_buffer;
+            popped_chain.for_each([&](PhysicalAddress address, size_t) {
+                if (!first_buffer.has_value())
+                    first_buffer = address;
+            });
+            VERIFY(first_buffer.has_value());
+            auto slot_index = (first_buffer->get() - request_pages_address.get()) / PAGE_SIZE;
+            VERIFY(slot_index < request_queue.slots.size());
+            VERIFY(request_queue.slots[slot_index].request);
+            request_queue.slots[slot_index].completed = true;
+            popped_chain.release_buffer_slots_to_queue();
         }
-        popped_chain.release_buffer_slots_to_queue();
-    } else {
-        dmesgln("VirtIOBlockDevice::handle_queue_update unexpected update for queue {}", queue_index);
+    }
+
+    // Requests complete in any order, and one interrupt can stand for several of them, so a single work item takes care of all of them.
+    if (request_queue.completion_scheduled.exchange(true))
+        return;
+    auto work_res = g_io_work->try_queue([this, &request_queue]() {
+        respond(request_queue);
+    });
+    if (work_res.is_error()) {
+        request_queue.completion_scheduled.store(false);
+        dmesgln("VirtIOBlockDevice::handle_queue_update error starting response: {}", work_res.error());
+        fail_completed_and_pending_requests(request_queue);
     }
 }
 
-void VirtIOBlockDevice::respond()
+Vector<size_t, VirtIOBlockDevice::MAX_REQUESTS_PER_QUEUE> VirtIOBlockDevice::take_completed_slots(RequestQueue& request_queue)
 {
-    RefPtr<AsyncBlockDeviceRequest> request;
+    Vector<size_t, MAX_REQUESTS_PER_QUEUE> completed_slots;
+    SpinlockLocker queue_lock(get_queue(request_queue.queue_index).lock());
+    for (size_t slot_index = 0; slot_index < request_queue.slots.size(); slot_index++) {
+        auto& slot = request_queue.slots[slot_index];
+        if (!slot.completed)
+            continue;
+        // NOTE: The slot stays claimed until its request is completed, but nobody else may pick it up in the meantime.
+        slot.completed = false;
+        completed_slots.unchecked_append(slot_index);
+    }
+    return completed_slots;
+}
 
-    m_current_request.with([&](auto& current_request) {
-        VERIFY(current_request);
-        request = current_request;
-    });
+void VirtIOBlockDevice::fail_completed_and_pending_requests(RequestQueue& request_queue)
+{
+    // Without a work item, we can't copy out the data of finished reads (or start anything new) from here,
+    // but we can at least make sure that nobody waits forever.
+    for (auto slot_index : take_completed_slots(request_queue))
+        complete_request_in_slot(request_queue, slot_index, AsyncDeviceRequest::OutOfMemory);
+
+    Vector<NonnullRefPtr<AsyncBlockDeviceRequest>> pending_requests;
+    {
+        SpinlockLocker queue_lock(get_queue(request_queue.queue_index).lock());
+        swap(pending_requests, request_queue.pending_requests);
+    }
+    for (auto& request : pending_requests)
+        request->complete(AsyncDeviceRequest::OutOfMemory);
+}
 
-    u64 data_size = block_size() * request->block_count();
-    VirtIOBlkReq* device_req = (VirtIOBlkReq*)(m_header_buf->vaddr().as_ptr());
+void VirtIOBlockDevice::respond(RequestQueue& request_queue)
+{
+    // NOTE: This has to happen before we look at the slots, so we don't miss completions that arrive in the meantime.
+    request_queue.completion_scheduled.store(false);
 
-    // The order is important:
-    // * first we finish reading up the data buf;
-    // * then we unblock new requests by clearing m_current_request (thus new requests will be free to use the data buf)
-    // * then unblock the caller (who may immediately come with another request and need m_current_request cleared).
+    auto completed_slots = take_completed_slots(request_queue);
 
-    if (device_req->trailer.status == VIRTIO_BLK_S_OK && request->request_type() == AsyncBlockDeviceRequest::Read) {
-        if (auto res = request->write_to_buffer(request->buffer(), m_data_buf->vaddr().as_ptr(), data_size); res.is_error()) {
-            dmesgln("VirtIOBlockDevice::respond failed to read buffer: {}", res.error());
+    // The order is important:
+    // * first we finish reading up the data buffer;
+    // * then we free the slot (thus new requests will be free to use its buffers);
+    // * then unblock the caller.
+    for (auto slot_index : completed_slots) {
+        auto& slot = request_queue.slots[slot_index];
+        auto& request = *slot.request;
+        auto const* device_req = reinterpret_cast<VirtIOBlkReq const*>(request_queue.request_pages->vaddr().offset(slot_index * PAGE_SIZE).as_ptr());
+        auto result = device_req->trailer.status == VIRTIO_BLK_S_OK ? AsyncDeviceRequest::Success : AsyncDeviceRequest::Failure;
+
+        if (result == AsyncDeviceRequest::Success && request.request_type() == AsyncBlockDeviceRequest::Read) {
+            u64 data_size = block_size() * request.block_count();
+            if (auto res = request.write_to_buffer(request.buffer(), slot.scatter_list->dma_region().as_ptr(), data_size); res.is_error()) {
+                dmesgln("VirtIOBlockDevice::respond failed to read buffer: {}", res.error());
+                result = AsyncDeviceRequest::MemoryFault;
+            }
         }
-    }
 
-    m_current_request.with([&](auto& current_request) {
-        current_request.clear();
-    });
+        complete_request_in_slot(request_queue, slot_index, result);
+    }
 
-    request->complete(device_req->trailer.status == VIRTIO_BLK_S_OK
-            ? AsyncDeviceRequest::Success
-            : AsyncDeviceRequest::Failure);
+    // Start the requests that were waiting for a free slot.
+    while (true) {
+        Optional<size_t> slot_index;
+        {
+            SpinlockLocker queue_lock(get_queue(request_queue.queue_index).lock());
+            if (request_queue.pending_requests.is_empty())
+                return;
+            slot_index = try_to_claim_slot(request_queue, request_queue.pending_requests.first());
+            if (!slot_index.has_value())
+                return;
+            request_queue.pending_requests.take_first();
+        }
+        start_request_in_slot(request_queue, slot_index.value());
+    }
 }
 
 }
@@ -6,12 +6,14 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <AK/Function.h>
 #include <AK/Result.h>
 #include <AK/Types.h>
 #include <Kernel/Bus/VirtIO/Device.h>
 #include <Kernel/Devices/Storage/StorageDevice.h>
 #include <Kernel/Locking/Mutex.h>
+#include <Kernel/Memory/ScatterGatherList.h>
 
 namespace Kernel {
 
@@ -24,6 +26,9 @@ public:
     // ^BlockDevice
     virtual void start_request(AsyncBlockDeviceRequest&) override;
 
+    // ^Device
+    virtual bool can_process_requests_concurrently() const override { return true; }
+
 protected:
     // ^VirtIO::Device
     virtual ErrorOr<void> initialize_virtio_resources() override;
@@ -36,14 +41,38 @@ private:
         StorageDevice::LUNAddress lun,
         u32 hardware_relative_controller_id);
 
-    ErrorOr<void> maybe_start_request(AsyncBlockDeviceRequest&);
-    void respond();
+    static constexpr size_t MAX_REQUESTS_PER_QUEUE = 8;
 
-private:
-    OwnPtr<Memory::Region> m_header_buf;
-    OwnPtr<Memory::Region> m_data_buf;
+    struct RequestSlot {
+        RefPtr<AsyncBlockDeviceRequest> request;
+        LockRefPtr<Memory::ScatterGatherList> scatter_list;
+        bool completed { false };
+    };
+
+    // Every request queue can have a number of requests in flight, each of which uses a slot with its own buffers.
+    // NOTE: The slots and the pending requests are protected by the lock of the VirtIO queue.
+    struct RequestQueue {
+        u16 queue_index { 0 };
+        // A page per slot, holding the request header, its status and the indirect descriptor table.
+        OwnPtr<Memory::Region> request_pages;
+        Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> data_pages;
+        Vector<RequestSlot> slots;
+        Vector<NonnullRefPtr<AsyncBlockDeviceRequest>> pending_requests;
+        Atomic<bool> completion_scheduled { false };
+    };
 
-    SpinlockProtected<RefPtr<AsyncBlockDeviceRequest>, LockRank::None> m_current_request {};
+    ErrorOr<NonnullOwnPtr<RequestQueue>> create_request_queue(u16 queue_index);
+    Optional<size_t> try_to_claim_slot(RequestQueue&, AsyncBlockDeviceRequest&);
+    void start_request_in_slot(RequestQueue&, size_t slot_index);
+    ErrorOr<void> maybe_start_request_in_slot(RequestQueue&, size_t slot_index);
+    void complete_request_in_slot(RequestQueue&, size_t slot_index, AsyncDeviceRequest::RequestResult);
+    Vector<size_t, MAX_REQUESTS_PER_QUEUE> take_completed_slots(RequestQueue&);
+    void fail_completed_and_pending_requests(RequestQueue&);
+    void respond(RequestQueue&);
+
+private:
+    VirtIO::Configuration const* m_device_config { nullptr };
+    Vector<NonnullOwnPtr<RequestQueue>> m_request_queues;
 };
 
 }
@@ -4,51 +4,181 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/AnyOf.h>
+#include <AK/Atomic.h>
 #include <AK/IntrusiveList.h>
+#include <AK/QuickSort.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
+#include <Kernel/Memory/MemoryManager.h>
 #include <Kernel/Tasks/Process.h>
+#include <Kernel/Tasks/SyncTask.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
+static constexpr StringView disk_cache_minimum_blocks_flag = "disk_cache_min_blocks"sv;
+static constexpr StringView disk_cache_maximum_blocks_flag = "disk_cache_max_blocks"sv;
+
+// Blocks that have been dirty for this long are written back by the sync task, no matter how few there are.
+static constexpr Duration dirty_expire_interval = Duration::from_seconds(5);
+
+// At most this many blocks are written back with a single request.
+static constexpr size_t max_blocks_per_writeback_request = 32;
+
+// Writers that are over the dirty limit write back this many blocks at a time, so that each of their writes
+// is delayed by a bit, instead of a few of them by a lot.
+static constexpr size_t max_blocks_written_back_by_throttled_writer = 8 * max_blocks_per_writeback_request;
+
+// These are shared by all file systems, and only used for statistics.
+static Atomic<u64> s_dirty_bytes;
+static Atomic<u64> s_writeback_bytes;
+static Atomic<u64> s_throttled_write_count;
+
+// Set by MemoryManager when it runs low on memory, so that it only wakes up the sync task once per round.
+static Atomic<bool> s_disk_cache_release_requested;
+
 struct CacheEntry {
     IntrusiveListNode<CacheEntry> list_node;
     BlockBasedFileSystem::BlockIndex block_index { 0 };
     u8* data { nullptr };
     bool has_data { false };
+    bool is_dirty { false };
+    bool is_in_use { false };
+    // Pinned entries are dirty as well, but they stay in memory until whoever pinned them says otherwise.
+    bool is_pinned { false };
+    Optional<MonotonicTime> dirtied_at;
 };
 
-class DiskCache {
+// The cache grows and shrinks in chunks of entries, each of which owns the memory for its blocks.
+class DiskCacheChunk {
 public:
-    static constexpr size_t EntryCount = 10000;
-    explicit DiskCache(BlockBasedFileSystem& fs, NonnullOwnPtr<KBuffer> cached_block_data, NonnullOwnPtr<KBuffer> entries_buffer)
-        : m_cached_block_data(move(cached_block_data))
-        , m_entries(move(entries_buffer))
+    static constexpr size_t EntryCount = 256;
+
+    static ErrorOr<NonnullOwnPtr<DiskCacheChunk>> try_create(size_t block_size)
+    {
+        auto block_data = TRY(KBuffer::try_create_with_size("BlockBasedFS: Cache blocks"sv, EntryCount * block_size, Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow));
+        auto entries = TRY(KBuffer::try_create_with_size("BlockBasedFS: Cache entries"sv, EntryCount * sizeof(CacheEntry), Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow));
+        return adopt_nonnull_own_or_enomem(new (nothrow) DiskCacheChunk(block_size, move(block_data), move(entries)));
+    }
+
+    Span<CacheEntry> entries() { return { (CacheEntry*)m_entries->data(), EntryCount }; }
+
+private:
+    DiskCacheChunk(size_t block_size, NonnullOwnPtr<KBuffer> block_data, NonnullOwnPtr<KBuffer> entries)
+        : m_block_data(move(block_data))
+        , m_entries(move(entries))
     {
         for (size_t i = 0; i < EntryCount; ++i) {
-            entries()[i].data = m_cached_block_data->data() + i * fs.logical_block_size();
-            m_clean_list.append(entries()[i]);
+            auto* entry = new (&this->entries()[i]) CacheEntry;
+            entry->data = m_block_data->data() + i * block_size;
         }
     }
 
-    ~DiskCache() = default;
+    NonnullOwnPtr<KBuffer> m_block_data;
+    NonnullOwnPtr<KBuffer> m_entries;
+};
+
+class DiskCache {
+public:
+    static ErrorOr<NonnullOwnPtr<DiskCache>> try_create(BlockBasedFileSystem& fs, size_t minimum_entry_count, size_t maximum_entry_count)
+    {
+        VERIFY(minimum_entry_count <= maximum_entry_count);
+        auto cache = TRY(adopt_nonnull_own_or_enomem(new (nothrow) DiskCache(fs, minimum_entry_count, maximum_entry_count)));
+        while (cache->capacity() < minimum_entry_count)
+            TRY(cache->grow());
+        return cache;
+    }
+
+    ~DiskCache()
+    {
+        // Whatever is still dirty at this point is gone for good.
+        s_dirty_bytes -= m_dirty_count * m_block_size;
+    }
+
+    size_t capacity() const { return m_chunks.size() * DiskCacheChunk::EntryCount; }
+    size_t minimum_capacity() const { return m_minimum_entry_count; }
+    size_t maximum_capacity() const { return m_maximum_entry_count; }
 
-    bool is_dirty() const { return !m_dirty_list.is_empty(); }
-    bool entry_is_dirty(CacheEntry const& entry) const { return m_dirty_list.contains(entry); }
+    bool is_dirty() const { return m_dirty_count != 0; }
+    bool entry_is_dirty(CacheEntry const& entry) const { return entry.is_dirty; }
+    size_t dirty_count() const { return m_dirty_count; }
+
+    // Past this many dirty blocks, the sync task starts writing back blocks before they expire.
+    size_t background_dirty_threshold() const { return m_maximum_entry_count / 8; }
+    // Past this many dirty blocks, writers have to write back blocks themselves before they may continue.
+    size_t dirty_limit() const { return m_maximum_entry_count / 4; }
 
     void mark_all_clean()
     {
         while (auto* entry = m_dirty_list.first())
-            m_clean_list.prepend(*entry);
+            mark_clean(*entry);
     }
 
     void mark_dirty(CacheEntry& entry)
     {
-        m_dirty_list.prepend(entry);
+        if (entry.is_dirty)
+            return;
+        entry.is_dirty = true;
+        entry.dirtied_at = TimeManagement::the().monotonic_time();
+        // NOTE: Keeping the oldest entry at the front lets us stop at the first entry that hasn't expired yet.
+        m_dirty_list.append(entry);
+        ++m_dirty_count;
+        s_dirty_bytes += m_block_size;
+    }
+
+    void mark_pinned(CacheEntry& entry)
+    {
+        if (entry.is_pinned)
+            return;
+        if (entry.is_dirty) {
+            --m_dirty_count;
+            s_dirty_bytes -= m_block_size;
+        }
+        // NOTE: Pinned entries count as dirty, so that they are never evicted, but they are kept off the dirty list
+        //       so that they aren't written back either.
+        entry.is_dirty = true;
+        entry.is_pinned = true;
+        entry.dirtied_at.clear();
+        m_pinned_list.append(entry);
+        ++m_pinned_count;
+    }
+
+    void unpin(CacheEntry& entry)
+    {
+        VERIFY(entry.is_pinned);
+        entry.is_pinned = false;
+        --m_pinned_count;
+        entry.is_dirty = false;
+        mark_dirty(entry);
+    }
+
+    void discard(CacheEntry& entry)
+    {
+        if (entry.is_pinned) {
+            entry.is_pinned = false;
+            --m_pinned_count;
+        } else if (entry.is_dirty) {
+            --m_dirty_count;
+            s_dirty_bytes -= m_block_size;
+        }
+        entry.is_dirty = false;
+        entry.dirtied_at.clear();
+        entry.has_data = false;
+        entry.is_in_use = false;
+        m_hash.remove(entry.block_index);
+        m_unused_list.prepend(entry);
     }
 
     void mark_clean(CacheEntry& entry)
     {
+        did_write_to_disk();
+        if (entry.is_dirty) {
+            --m_dirty_count;
+            s_dirty_bytes -= m_block_size;
+        }
+        entry.is_dirty = false;
+        entry.dirtied_at.clear();
         m_clean_list.prepend(entry);
     }
 
@@ -68,75 +198,244 @@ public:
 
     ErrorOr<CacheEntry*> ensure(BlockBasedFileSystem::BlockIndex block_index, BlockBasedFileSystem& fs) const
     {
-        if (auto* entry = get(block_index))
+        if (auto* entry = get(block_index)) {
+            ++m_hits;
             return entry;
-
-        if (m_clean_list.is_empty()) {
-            // Not a single clean entry! Flush writes and try again.
-            // NOTE: We want to make sure we only call FileBackedFileSystem flush here,
-            //       not some FileBackedFileSystem subclass flush!
-            fs.flush_writes_impl();
-            return ensure(block_index, fs);
         }
+        ++m_misses;
+        return ensure_new_entry(block_index, fs);
+    }
 
-        VERIFY(m_clean_list.last());
-        auto& new_entry = *m_clean_list.last();
-        m_clean_list.prepend(new_entry);
-
-        m_hash.remove(new_entry.block_index);
-        TRY(m_hash.try_set(block_index, &new_entry));
+    bool contains(BlockBasedFileSystem::BlockIndex block_index) const { return m_hash.contains(block_index); }
 
-        new_entry.block_index = block_index;
-        new_entry.has_data = false;
+    // Read-ahead reads from the device without holding the cache lock, so it uses this to detect
+    // whether the blocks it read might have been overwritten in the meantime.
+    u64 disk_write_generation() const { return m_disk_write_generation; }
+    void did_write_to_disk() { ++m_disk_write_generation; }
 
-        return &new_entry;
+    ErrorOr<CacheEntry*> ensure_for_read_ahead(BlockBasedFileSystem::BlockIndex block_index, BlockBasedFileSystem& fs) const
+    {
+        VERIFY(!contains(block_index));
+        ++m_read_ahead_blocks;
+        return ensure_new_entry(block_index, fs);
     }
 
-    CacheEntry const* entries() const { return (CacheEntry const*)m_entries->data(); }
-    CacheEntry* entries() { return (CacheEntry*)m_entries->data(); }
+    // Gives back the memory of unused chunks until the cache is down to the given number of entries,
+    // but never below its minimum capacity. Chunks that still contain dirty entries are kept.
+    size_t shrink(size_t target_entry_count)
+    {
+        target_entry_count = max(target_entry_count, m_minimum_entry_count);
+        size_t released_entry_count = 0;
+        while (capacity() > target_entry_count && capacity() - DiskCacheChunk::EntryCount >= target_entry_count) {
+            auto& chunk = *m_chunks.last();
+            if (any_of(chunk.entries(), [](auto const& entry) { return entry.is_dirty; }))
+                break;
+            for (auto& entry : chunk.entries()) {
+                if (entry.is_in_use)
+                    m_hash.remove(entry.block_index);
+                entry.list_node.remove();
+            }
+            m_chunks.take_last();
+            released_entry_count += DiskCacheChunk::EntryCount;
+        }
+        return released_entry_count;
+    }
 
+    // Visits the dirty entries in the order they became dirty.
     template<typename Callback>
     void for_each_dirty_entry(Callback callback)
     {
-        for (auto& entry : m_dirty_list)
-            callback(entry);
+        for (auto& entry : m_dirty_list) {
+            if (callback(entry) == IterationDecision::Break)
+                break;
+        }
+    }
+
+    BlockBasedFileSystem::DiskCacheStatistics statistics() const
+    {
+        return {
+            .hits = m_hits,
+            .misses = m_misses,
+            .evictions = m_evictions,
+            .read_ahead_blocks = m_read_ahead_blocks,
+            .cached_blocks = m_hash.size(),
+            .dirty_blocks = m_dirty_count,
+            .pinned_blocks = m_pinned_count,
+            .capacity_blocks = capacity(),
+            .minimum_blocks = m_minimum_entry_count,
+            .maximum_blocks = m_maximum_entry_count,
+        };
     }
 
 private:
-    NonnullOwnPtr<KBuffer> m_cached_block_data;
+    DiskCache(BlockBasedFileSystem& fs, size_t minimum_entry_count, size_t maximum_entry_count)
+        : m_block_size(fs.logical_block_size())
+        , m_minimum_entry_count(minimum_entry_count)
+        , m_maximum_entry_count(maximum_entry_count)
+    {
+    }
 
-    // NOTE: m_entries must be declared before m_dirty_list and m_clean_list because their entries are allocated from it.
-    // We need to ensure that the destructors of m_dirty_list and m_clean_list are called before m_entries is destroyed.
-    NonnullOwnPtr<KBuffer> m_entries;
+    ErrorOr<void> grow() const
+    {
+        auto chunk = TRY(DiskCacheChunk::try_create(m_block_size));
+        // NOTE: The entries may only be linked once nothing can fail anymore, as the lists would point into a freed chunk otherwise.
+        TRY(m_chunks.try_ensure_capacity(m_chunks.size() + 1));
+        for (auto& entry : chunk->entries())
+            m_unused_list.append(entry);
+        m_chunks.unchecked_append(move(chunk));
+        return {};
+    }
+
+    bool should_grow() const
+    {
+        if (capacity() >= m_maximum_entry_count)
+            return false;
+        // Don't compete with the rest of the system for memory, we rather evict our own blocks.
+        return capacity() < m_minimum_entry_count || !MM.is_under_memory_pressure();
+    }
+
+    ErrorOr<CacheEntry*> ensure_new_entry(BlockBasedFileSystem::BlockIndex block_index, BlockBasedFileSystem& fs) const
+    {
+        if (m_unused_list.is_empty() && should_grow()) {
+            if (auto result = grow(); result.is_error())
+                dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem: Failed to grow disk cache beyond {} blocks: {}", capacity(), result.error());
+        }
+
+        CacheEntry* new_entry = nullptr;
+        if (!m_unused_list.is_empty()) {
+            new_entry = m_unused_list.first();
+        } else if (!m_clean_list.is_empty()) {
+            new_entry = m_clean_list.last();
+            VERIFY(new_entry->is_in_use);
+            m_hash.remove(new_entry->block_index);
+            ++m_evictions;
+        } else {
+            // Not a single clean entry! Flush writes and try again.
+            // NOTE: We want to make sure we only call FileBackedFileSystem flush here,
+            //       not some FileBackedFileSystem subclass flush!
+            fs.flush_writes_impl();
+            // Pinned entries can't be written back, so there may be nothing we can do about it.
+            if (m_clean_list.is_empty())
+                return ENOMEM;
+            return ensure_new_entry(block_index, fs);
+        }
+
+        m_clean_list.prepend(*new_entry);
+        new_entry->block_index = block_index;
+        new_entry->has_data = false;
+        new_entry->is_in_use = true;
+        if (auto result = m_hash.try_set(block_index, new_entry); result.is_error()) {
+            new_entry->is_in_use = false;
+            m_unused_list.prepend(*new_entry);
+            return result.release_error();
+        }
+
+        return new_entry;
+    }
+
+    size_t const m_block_size { 0 };
+    size_t const m_minimum_entry_count { 0 };
+    size_t const m_maximum_entry_count { 0 };
+
+    // NOTE: m_chunks must be declared before the entry lists because their entries are allocated from it.
+    // We need to ensure that the destructors of the entry lists are called before the chunks are destroyed.
+    mutable Vector<NonnullOwnPtr<DiskCacheChunk>> m_chunks;
+    mutable IntrusiveList<&CacheEntry::list_node> m_unused_list;
     mutable IntrusiveList<&CacheEntry::list_node> m_dirty_list;
     mutable IntrusiveList<&CacheEntry::list_node> m_clean_list;
+    mutable IntrusiveList<&CacheEntry::list_node> m_pinned_list;
     mutable HashMap<BlockBasedFileSystem::BlockIndex, CacheEntry*> m_hash;
+
+    size_t m_dirty_count { 0 };
+    size_t m_pinned_count { 0 };
+
+    mutable u64 m_hits { 0 };
+    mutable u64 m_misses { 0 };
+    mutable u64 m_evictions { 0 };
+    mutable u64 m_read_ahead_blocks { 0 };
+    u64 m_disk_write_generation { 0 };
 };
 
-BlockBasedFileSystem::BlockBasedFileSystem(OpenFileDescription& file_description)
+BlockBasedFileSystem::BlockBasedFileSystem(OpenFileDescription& file_description, FileSystemSpecificOptions const& filesystem_specific_options)
     : FileBackedFileSystem(file_description)
+    , m_requested_disk_cache_minimum_blocks(parse_unsigned_filesystem_specific_option(filesystem_specific_options, disk_cache_minimum_blocks_flag))
+    , m_requested_disk_cache_maximum_blocks(parse_unsigned_filesystem_specific_option(filesystem_specific_options, disk_cache_maximum_blocks_flag))
 {
     VERIFY(file_description.file().is_seekable());
 }
 
 BlockBasedFileSystem::~BlockBasedFileSystem() = default;
 
+ErrorOr<void> BlockBasedFileSystem::validate_mount_unsigned_integer_flag(StringView key, u64)
+{
+    if (key == disk_cache_minimum_blocks_flag)
+        return {};
+    if (key == disk_cache_maximum_blocks_flag)
+        return {};
+    return EINVAL;
+}
+
 ErrorOr<void> BlockBasedFileSystem::initialize_while_locked()
 {
     VERIFY(m_lock.is_locked());
     VERIFY(!is_initialized_while_locked());
     VERIFY(logical_block_size() != 0);
-    auto cached_block_data = TRY(KBuffer::try_create_with_size("BlockBasedFS: Cache blocks"sv, DiskCache::EntryCount * logical_block_size(), Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow));
-    auto entries_data = TRY(KBuffer::try_create_with_size("BlockBasedFS: Cache entries"sv, DiskCache::EntryCount * sizeof(CacheEntry), Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow));
-    auto disk_cache = TRY(adopt_nonnull_own_or_enomem(new (nothrow) DiskCache(*this, move(cached_block_data), move(entries_data))));
 
+    // Unless told otherwise, start out small and allow the cache to take up to 1/32 of physical memory.
+    static constexpr size_t default_minimum_entry_count = DiskCacheChunk::EntryCount;
+    static constexpr size_t default_maximum_entry_count_cap = 256 * 1024;
+    auto physical_memory_size = MM.get_system_memory_info().physical_pages * PAGE_SIZE;
+    auto default_maximum_entry_count = clamp(physical_memory_size / 32 / logical_block_size(), default_minimum_entry_count, default_maximum_entry_count_cap);
+
+    size_t minimum_entry_count = m_requested_disk_cache_minimum_blocks.value_or(default_minimum_entry_count);
+    size_t maximum_entry_count = m_requested_disk_cache_maximum_blocks.value_or(max(default_maximum_entry_count, minimum_entry_count));
+    if (minimum_entry_count == 0 || minimum_entry_count > maximum_entry_count)
+        return EINVAL;
+
+    auto disk_cache = TRY(DiskCache::try_create(*this, minimum_entry_count, maximum_entry_count));
     m_cache.with_exclusive([&](auto& cache) {
         cache = move(disk_cache);
     });
     return {};
 }
 
+BlockBasedFileSystem::DiskCacheStatistics BlockBasedFileSystem::disk_cache_statistics() const
+{
+    return m_cache.with_exclusive([&](auto& cache) -> DiskCacheStatistics {
+        if (!cache)
+            return {};
+        return cache->statistics();
+    });
+}
+
 ErrorOr<void> BlockBasedFileSystem::write_block(BlockIndex index, UserOrKernelBuffer const& data, size_t count, u64 offset, bool allow_cache)
+{
+    return write_block_impl(index, data, count, offset, allow_cache ? WriteMode::Cached : WriteMode::Uncached);
+}
+
+ErrorOr<void> BlockBasedFileSystem::write_pinned_block(BlockIndex index, UserOrKernelBuffer const& data, size_t count, u64 offset)
+{
+    return write_block_impl(index, data, count, offset, WriteMode::Pinned);
+}
+
+void BlockBasedFileSystem::unpin_block(BlockIndex index)
+{
+    m_cache.with_exclusive([&](auto& cache) {
+        auto* entry = cache->get(index);
+        if (entry && entry->is_pinned)
+            cache->unpin(*entry);
+    });
+}
+
+void BlockBasedFileSystem::discard_block(BlockIndex index)
+{
+    m_cache.with_exclusive([&](auto& cache) {
+        if (auto* entry = cache->get(index))
+            cache->discard(*entry);
+    });
+}
+
+ErrorOr<void> BlockBasedFileSystem::write_block_impl(BlockIndex index, UserOrKernelBuffer const& data, size_t count, u64 offset, WriteMode mode)
 {
     VERIFY(m_device_block_size);
     VERIFY(offset + count <= logical_block_size());
@@ -150,8 +449,9 @@ ErrorOr<void> BlockBasedFileSystem::write_block(BlockIndex index, UserOrKernelBu
     TRY(data.read(buffered_data.bytes()));
 
     return m_cache.with_exclusive([&](auto& cache) -> ErrorOr<void> {
-        if (!allow_cache) {
+        if (mode == WriteMode::Uncached) {
             flush_specific_block_if_needed(index);
+            cache->did_write_to_disk();
             u64 base_offset = index.value() * logical_block_size() + offset;
             auto nwritten = TRY(file_description().write(base_offset, data, count));
             VERIFY(nwritten == count);
@@ -164,9 +464,25 @@ ErrorOr<void> BlockBasedFileSystem::write_block(BlockIndex index, UserOrKernelBu
             TRY(read_block(index, nullptr, logical_block_size()));
         }
         memcpy(entry->data + offset, buffered_data.data(), count);
+        entry->has_data = true;
+
+        // Pinned blocks don't count towards the dirty limit, whoever pinned them is responsible for keeping them in check.
+        if (mode == WriteMode::Pinned) {
+            cache->mark_pinned(*entry);
+            return {};
+        }
 
         cache->mark_dirty(*entry);
-        entry->has_data = true;
+
+        if (cache->dirty_count() > cache->background_dirty_threshold())
+            SyncTask::wake_up();
+
+        // Whoever dirties blocks faster than the sync task can write them back has to help out,
+        // which slows them down to the speed of the disk instead of letting them fill up the cache.
+        if (cache->dirty_count() > cache->dirty_limit()) {
+            ++s_throttled_write_count;
+            write_back_dirty_blocks(*cache, min(cache->dirty_count() - cache->background_dirty_threshold(), max_blocks_written_back_by_throttled_writer));
+        }
         return {};
     });
 }
@@ -211,6 +527,24 @@ ErrorOr<void> BlockBasedFileSystem::write_blocks(BlockIndex index, unsigned coun
 {
     VERIFY(m_device_block_size);
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::write_blocks {}, count={}", index, count);
+    if (!allow_cache && count > 1) {
+        // Bypassing the cache, we can hand the whole range to the device with a single request.
+        for (unsigned i = 0; i < count; ++i)
+            flush_specific_block_if_needed(BlockIndex { index.value() + i });
+        return m_cache.with_exclusive([&](auto& cache) -> ErrorOr<void> {
+            cache->did_write_to_disk();
+            // NOTE: Storage devices may write less than we asked for, as they are limited by their DMA buffers.
+            auto base_offset = index.value() * logical_block_size();
+            size_t size = count * logical_block_size();
+            for (size_t nwritten = 0; nwritten < size;) {
+                auto nwritten_now = TRY(file_description().write(base_offset + nwritten, data.offset(nwritten), size - nwritten));
+                if (nwritten_now == 0)
+                    return EIO;
+                nwritten += nwritten_now;
+            }
+            return {};
+        });
+    }
     for (unsigned i = 0; i < count; ++i) {
         TRY(write_block(BlockIndex { index.value() + i }, data.offset(i * logical_block_size()), logical_block_size(), 0, allow_cache));
     }
@@ -246,6 +580,108 @@ ErrorOr<void> BlockBasedFileSystem::read_block(BlockIndex index, UserOrKernelBuf
     });
 }
 
+ErrorOr<void> BlockBasedFileSystem::read_ahead_blocks(Span<BlockIndex const> blocks) const
+{
+    // Only bother with blocks that aren't cached yet.
+    Vector<BlockIndex> missing_blocks;
+    TRY(missing_blocks.try_ensure_capacity(blocks.size()));
+    u64 disk_write_generation = 0;
+    m_cache.with_exclusive([&](auto& cache) {
+        disk_write_generation = cache->disk_write_generation();
+        for (auto block : blocks) {
+            if (!cache->contains(block))
+                missing_blocks.unchecked_append(block);
+        }
+    });
+    if (missing_blocks.is_empty())
+        return {};
+
+    // Read physically contiguous runs of blocks with a single request each, without holding the cache lock.
+    static constexpr size_t max_blocks_per_request = 32;
+    auto run_buffer = TRY(KBuffer::try_create_with_size("BlockBasedFS: Read-ahead"sv, min(missing_blocks.size(), max_blocks_per_request) * logical_block_size(), Memory::Region::Access::ReadWrite));
+
+    for (size_t run_start = 0; run_start < missing_blocks.size();) {
+        size_t run_length = 1;
+        while (run_start + run_length < missing_blocks.size()
+            && run_length < max_blocks_per_request
+            && missing_blocks[run_start + run_length].value() == missing_blocks[run_start].value() + run_length)
+            ++run_length;
+
+        // NOTE: Storage devices may return less than we asked for, as they are limited by their DMA buffers.
+        auto base_offset = missing_blocks[run_start].value() * logical_block_size();
+        auto run_size = run_length * logical_block_size();
+        for (size_t nread = 0; nread < run_size;) {
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(run_buffer->data() + nread);
+            auto nread_now = TRY(file_description().read(buffer, base_offset + nread, run_size - nread));
+            if (nread_now == 0)
+                return EIO;
+            nread += nread_now;
+        }
+
+        auto still_valid = TRY(m_cache.with_exclusive([&](auto& cache) -> ErrorOr<bool> {
+            if (cache->disk_write_generation() != disk_write_generation)
+                return false;
+            for (size_t i = 0; i < run_length; ++i) {
+                auto block = missing_blocks[run_start + i];
+                // Someone may have read (or written!) this block while we weren't looking.
+                if (cache->contains(block))
+                    continue;
+                auto* entry = TRY(cache->ensure_for_read_ahead(block, const_cast<BlockBasedFileSystem&>(*this)));
+                memcpy(entry->data, run_buffer->data() + i * logical_block_size(), logical_block_size());
+                entry->has_data = true;
+            }
+            return true;
+        }));
+        if (!still_valid)
+            return {};
+
+        run_start += run_length;
+    }
+    return {};
+}
+
+ErrorOr<void> BlockBasedFileSystem::read_blocks_uncached(Span<BlockIndex const> blocks, UserOrKernelBuffer& buffer) const
+{
+    // Blocks that are cached may not have hit the disk yet, so we take them from the cache.
+    Vector<size_t> missing_block_positions;
+    TRY(missing_block_positions.try_ensure_capacity(blocks.size()));
+    TRY(m_cache.with_exclusive([&](auto& cache) -> ErrorOr<void> {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            auto* entry = cache->get(blocks[i]);
+            if (!entry || !entry->has_data) {
+                missing_block_positions.unchecked_append(i);
+                continue;
+            }
+            TRY(buffer.write(entry->data, i * logical_block_size(), logical_block_size()));
+        }
+        return {};
+    }));
+
+    // Everything else is read with a single request for each physically contiguous run of blocks.
+    for (size_t run_start = 0; run_start < missing_block_positions.size();) {
+        auto first_position = missing_block_positions[run_start];
+        size_t run_length = 1;
+        while (run_start + run_length < missing_block_positions.size()
+            && missing_block_positions[run_start + run_length] == first_position + run_length
+            && blocks[first_position + run_length].value() == blocks[first_position].value() + run_length)
+            ++run_length;
+
+        // NOTE: Storage devices may return less than we asked for, as they are limited by their DMA buffers.
+        auto base_offset = blocks[first_position].value() * logical_block_size();
+        auto run_size = run_length * logical_block_size();
+        for (size_t nread = 0; nread < run_size;) {
+            auto run_buffer = buffer.offset(first_position * logical_block_size() + nread);
+            auto nread_now = TRY(file_description().read(run_buffer, base_offset + nread, run_size - nread));
+            if (nread_now == 0)
+                return EIO;
+            nread += nread_now;
+        }
+
+        run_start += run_length;
+    }
+    return {};
+}
+
 ErrorOr<void> BlockBasedFileSystem::read_blocks(BlockIndex index, unsigned count, UserOrKernelBuffer& buffer, bool allow_cache) const
 {
     VERIFY(m_device_block_size);
@@ -270,34 +706,180 @@ void BlockBasedFileSystem::flush_specific_block_if_needed(BlockIndex index)
         auto* entry = cache->get(index);
         if (!entry)
             return;
-        if (!cache->entry_is_dirty(*entry))
+        // Pinned blocks must not hit the disk, as far as the disk is concerned they haven't changed yet.
+        if (!cache->entry_is_dirty(*entry) || entry->is_pinned)
             return;
         size_t base_offset = entry->block_index.value() * logical_block_size();
         auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry->data);
+        cache->did_write_to_disk();
         (void)file_description().write(base_offset, entry_data_buffer, logical_block_size());
     });
 }
 
-void BlockBasedFileSystem::flush_writes_impl()
+size_t BlockBasedFileSystem::write_back_dirty_blocks(DiskCache& cache, size_t max_block_count, Optional<MonotonicTime> dirtied_before)
 {
+    Vector<CacheEntry*> entries;
+    bool is_out_of_memory = false;
+    cache.for_each_dirty_entry([&](CacheEntry& entry) {
+        if (entries.size() >= max_block_count)
+            return IterationDecision::Break;
+        if (dirtied_before.has_value() && entry.dirtied_at.value() >= dirtied_before.value())
+            return IterationDecision::Break;
+        if (entries.try_append(&entry).is_error()) {
+            is_out_of_memory = true;
+            return IterationDecision::Break;
+        }
+        return IterationDecision::Continue;
+    });
+
+    // NOTE: Storage devices may write less than we asked for, as they are limited by their DMA buffers.
+    //       Returns how many bytes made it to the disk before the device gave up.
+    auto write_fully = [&](u64 base_offset, UserOrKernelBuffer const& buffer, size_t size) -> size_t {
+        size_t nwritten = 0;
+        while (nwritten < size) {
+            auto nwritten_now_or_error = file_description().write(base_offset + nwritten, buffer.offset(nwritten), size - nwritten);
+            if (nwritten_now_or_error.is_error()) {
+                dbgln("{}: Failed to write back block at offset {}: {}", class_name(), base_offset + nwritten, nwritten_now_or_error.error());
+                break;
+            }
+            if (nwritten_now_or_error.value() == 0)
+                break;
+            nwritten += nwritten_now_or_error.value();
+        }
+        return nwritten;
+    };
+
+    // NOTE: If we can't even keep track of the blocks, we write them back one by one, like in the good old days.
+    //       Writing a block back takes it off the dirty list, so we always look at the first one.
+    if (is_out_of_memory) {
+        size_t count = 0;
+        while (count < max_block_count) {
+            CacheEntry* entry = nullptr;
+            cache.for_each_dirty_entry([&](CacheEntry& first_entry) {
+                entry = &first_entry;
+                return IterationDecision::Break;
+            });
+            if (!entry)
+                break;
+            auto base_offset = entry->block_index.value() * logical_block_size();
+            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry->data);
+            // A block that couldn't be written stays dirty, and so does everything behind it.
+            if (write_fully(base_offset, entry_data_buffer, logical_block_size()) != logical_block_size())
+                break;
+            cache.mark_clean(*entry);
+            ++count;
+        }
+        return count;
+    }
+
+    quick_sort(entries, [](auto const* a, auto const* b) { return a->block_index < b->block_index; });
+
+    // Physically contiguous blocks are copied into a bounce buffer, so they can be written with a single request.
+    auto run_buffer_or_error = KBuffer::try_create_with_size("BlockBasedFS: Writeback"sv, min(entries.size(), max_blocks_per_writeback_request) * logical_block_size(), Memory::Region::Access::ReadWrite);
+    size_t max_run_length = run_buffer_or_error.is_error() ? 1 : max_blocks_per_writeback_request;
+
     size_t count = 0;
+    for (size_t run_start = 0; run_start < entries.size();) {
+        size_t run_length = 1;
+        while (run_start + run_length < entries.size()
+            && run_length < max_run_length
+            && entries[run_start + run_length]->block_index.value() == entries[run_start]->block_index.value() + run_length)
+            ++run_length;
+
+        auto base_offset = entries[run_start]->block_index.value() * logical_block_size();
+        auto run_size = run_length * logical_block_size();
+        size_t nwritten = 0;
+        s_writeback_bytes += run_size;
+        if (run_length == 1) {
+            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entries[run_start]->data);
+            nwritten = write_fully(base_offset, entry_data_buffer, logical_block_size());
+        } else {
+            auto& run_buffer = run_buffer_or_error.value();
+            for (size_t i = 0; i < run_length; ++i)
+                memcpy(run_buffer->data() + i * logical_block_size(), entries[run_start + i]->data, logical_block_size());
+            auto run_data_buffer = UserOrKernelBuffer::for_kernel_buffer(run_buffer->data());
+            nwritten = write_fully(base_offset, run_data_buffer, run_size);
+        }
+        s_writeback_bytes -= run_size;
+
+        // Only the blocks that actually made it to the disk are clean now, the rest stays dirty for the next round.
+        size_t written_block_count = nwritten / logical_block_size();
+        for (size_t i = 0; i < written_block_count; ++i)
+            cache.mark_clean(*entries[run_start + i]);
+        count += written_block_count;
+        run_start += run_length;
+    }
+    return count;
+}
+
+void BlockBasedFileSystem::flush_writes_impl()
+{
     m_cache.with_exclusive([&](auto& cache) {
         if (!cache->is_dirty())
             return;
-        cache->for_each_dirty_entry([&](CacheEntry& entry) {
-            auto base_offset = entry.block_index.value() * logical_block_size();
-            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-            [[maybe_unused]] auto rc = file_description().write(base_offset, entry_data_buffer, logical_block_size());
-            ++count;
-        });
-        cache->mark_all_clean();
+        auto count = write_back_dirty_blocks(*cache, NumericLimits<size_t>::max());
         dbgln("{}: Flushed {} blocks to disk", class_name(), count);
     });
 }
 
+ErrorOr<void> BlockBasedFileSystem::write_back_dirty_data()
+{
+    auto expired_before = TimeManagement::the().monotonic_time() - dirty_expire_interval;
+    m_cache.with_exclusive([&](auto& cache) {
+        if (!cache || !cache->is_dirty())
+            return;
+        auto count = write_back_dirty_blocks(*cache, NumericLimits<size_t>::max(), expired_before);
+        // Once there's more dirty data than we'd like to keep around, younger blocks have to go as well.
+        if (cache->dirty_count() > cache->background_dirty_threshold())
+            count += write_back_dirty_blocks(*cache, cache->dirty_count() - cache->background_dirty_threshold());
+        dbgln_if(BBFS_DEBUG, "{}: Wrote back {} blocks, {} are still dirty", class_name(), count, cache->dirty_count());
+    });
+
+    if (MM.is_under_memory_pressure())
+        release_disk_cache_memory();
+    // NOTE: This is only cleared afterwards, so that our own allocations don't keep waking up the sync task.
+    s_disk_cache_release_requested.store(false, AK::MemoryOrder::memory_order_relaxed);
+    return {};
+}
+
+void BlockBasedFileSystem::release_disk_cache_memory()
+{
+    m_cache.with_exclusive([&](auto& cache) {
+        if (!cache)
+            return;
+        // Only chunks without any dirty blocks can be given back, so everything has to be written back first.
+        if (cache->is_dirty())
+            write_back_dirty_blocks(*cache, NumericLimits<size_t>::max());
+        if (auto released_block_count = cache->shrink(0))
+            dbgln_if(BBFS_DEBUG, "{}: Released {} disk cache blocks due to memory pressure", class_name(), released_block_count);
+    });
+}
+
+void BlockBasedFileSystem::request_disk_cache_memory_release()
+{
+    // NOTE: This is called by MemoryManager while it allocates pages, so we can't take the cache lock (or allocate
+    //       anything) here. The sync task does the actual work.
+    if (s_disk_cache_release_requested.exchange(true, AK::MemoryOrder::memory_order_relaxed))
+        return;
+    SyncTask::wake_up();
+}
+
+BlockBasedFileSystem::WritebackStatistics BlockBasedFileSystem::writeback_statistics()
+{
+    return {
+        .dirty_bytes = s_dirty_bytes.load(),
+        .writeback_bytes = s_writeback_bytes.load(),
+        .throttled_write_count = s_throttled_write_count.load(),
+    };
+}
+
 ErrorOr<void> BlockBasedFileSystem::flush_writes()
 {
     flush_writes_impl();
+
+    // Everything is clean right after flushing, so this is the best time to give memory back.
+    if (MM.is_under_memory_pressure())
+        release_disk_cache_memory();
     return {};
 }
 
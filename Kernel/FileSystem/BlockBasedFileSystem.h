@@ -7,6 +7,7 @@
 #pragma once
 
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
+#include <Kernel/FileSystem/FileSystemSpecificOption.h>
 #include <Kernel/Locking/MutexProtected.h>
 
 namespace Kernel {
@@ -20,15 +21,46 @@ public:
     u64 device_block_size() const { return m_device_block_size; }
 
     virtual ErrorOr<void> flush_writes() override;
+    virtual ErrorOr<void> write_back_dirty_data() override;
     void flush_writes_impl();
 
+    struct DiskCacheStatistics {
+        u64 hits { 0 };
+        u64 misses { 0 };
+        u64 evictions { 0 };
+        u64 read_ahead_blocks { 0 };
+        size_t cached_blocks { 0 };
+        size_t dirty_blocks { 0 };
+        size_t pinned_blocks { 0 };
+        size_t capacity_blocks { 0 };
+        size_t minimum_blocks { 0 };
+        size_t maximum_blocks { 0 };
+    };
+    DiskCacheStatistics disk_cache_statistics() const;
+
+    // Summed up over all file systems.
+    struct WritebackStatistics {
+        u64 dirty_bytes { 0 };
+        u64 writeback_bytes { 0 };
+        u64 throttled_write_count { 0 };
+    };
+    static WritebackStatistics writeback_statistics();
+
+    // Makes the sync task give back as much disk cache memory of all file systems as it can.
+    static void request_disk_cache_memory_release();
+
+    static ErrorOr<void> validate_mount_unsigned_integer_flag(StringView key, u64);
+
 protected:
-    explicit BlockBasedFileSystem(OpenFileDescription&);
+    BlockBasedFileSystem(OpenFileDescription&, FileSystemSpecificOptions const&);
 
     virtual ErrorOr<void> initialize_while_locked() override;
 
     ErrorOr<void> read_block(BlockIndex, UserOrKernelBuffer*, size_t count, u64 offset = 0, bool allow_cache = true) const;
     ErrorOr<void> read_blocks(BlockIndex, unsigned count, UserOrKernelBuffer&, bool allow_cache = true) const;
+    ErrorOr<void> read_ahead_blocks(Span<BlockIndex const>) const;
+    // Reads each of the given blocks into the next logical_block_size() bytes of the buffer, without adding them to the cache.
+    ErrorOr<void> read_blocks_uncached(Span<BlockIndex const>, UserOrKernelBuffer&) const;
 
     ErrorOr<void> raw_read(BlockIndex, UserOrKernelBuffer&);
     ErrorOr<void> raw_write(BlockIndex, UserOrKernelBuffer const&);
@@ -39,11 +71,34 @@ protected:
     ErrorOr<void> write_block(BlockIndex, UserOrKernelBuffer const&, size_t count, u64 offset = 0, bool allow_cache = true);
     ErrorOr<void> write_blocks(BlockIndex, unsigned count, UserOrKernelBuffer const&, bool allow_cache = true);
 
+    // Pinned blocks stay in the cache and aren't written back until they're unpinned, which turns them into
+    // ordinary dirty blocks. This lets file systems decide when (and where else) changes may hit the disk.
+    ErrorOr<void> write_pinned_block(BlockIndex, UserOrKernelBuffer const&, size_t count, u64 offset = 0);
+    void unpin_block(BlockIndex);
+
+    // Drops the block from the cache without writing it back, for blocks whose contents don't matter anymore.
+    void discard_block(BlockIndex);
+
     u64 m_device_block_size { 512 };
 
 private:
+    virtual bool is_block_based() const override final { return true; }
+
     void flush_specific_block_if_needed(BlockIndex index);
+    void release_disk_cache_memory();
+
+    enum class WriteMode {
+        Cached,
+        Uncached,
+        Pinned,
+    };
+    ErrorOr<void> write_block_impl(BlockIndex, UserOrKernelBuffer const&, size_t count, u64 offset, WriteMode);
+
+    // Writes back up to the given number of dirty blocks, oldest first. Returns the number of blocks that were written.
+    size_t write_back_dirty_blocks(DiskCache&, size_t max_block_count, Optional<MonotonicTime> dirtied_before = {});
 
+    Optional<u64> m_requested_disk_cache_minimum_blocks;
+    Optional<u64> m_requested_disk_cache_maximum_blocks;
     mutable MutexProtected<OwnPtr<DiskCache>> m_cache;
 };
 
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/FileSystem/EventPoll.h>
+#include <Kernel/FileSystem/OpenFileDescription.h>
+#include <Kernel/Locking/Spinlock.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+// Serializes adding and removing interests against the destruction of the descriptions
+// they refer to. Readiness notifications and waiting never take this lock.
+static Spinlock<LockRank::None> s_interest_lock {};
+
+static BlockFlags block_flags_for_events(u32 events)
+{
+    BlockFlags block_flags = BlockFlags::WriteError | BlockFlags::WriteHangUp; // EPOLLERR and EPOLLHUP are always reported
+    if (events & EPOLLIN)
+        block_flags |= BlockFlags::Read;
+    if (events & EPOLLOUT)
+        block_flags |= BlockFlags::Write;
+    if (events & EPOLLPRI)
+        block_flags |= BlockFlags::ReadPriority;
+    if (events & EPOLLWRBAND)
+        block_flags |= BlockFlags::WritePriority;
+    if (events & EPOLLRDHUP)
+        block_flags |= BlockFlags::ReadHangUp;
+    return block_flags;
+}
+
+static u32 events_for_block_flags(BlockFlags block_flags)
+{
+    u32 events = 0;
+    if (has_flag(block_flags, BlockFlags::WriteHangUp))
+        events |= EPOLLHUP;
+    if (has_flag(block_flags, BlockFlags::WriteError))
+        events |= EPOLLERR;
+    if (has_flag(block_flags, BlockFlags::Read))
+        events |= EPOLLIN;
+    if (has_flag(block_flags, BlockFlags::ReadPriority))
+        events |= EPOLLPRI;
+    if (!has_flag(block_flags, BlockFlags::WriteHangUp) && has_flag(block_flags, BlockFlags::Write))
+        events |= EPOLLOUT;
+    if (has_flag(block_flags, BlockFlags::WritePriority))
+        events |= EPOLLWRBAND;
+    if (has_flag(block_flags, BlockFlags::ReadHangUp))
+        events |= EPOLLRDHUP;
+    return events;
+}
+
+EventPoll::Interest::Interest(EventPoll& event_poll, int fd, OpenFileDescription& description, u32 events, u64 data)
+    : m_event_poll(event_poll)
+    , m_description(description)
+    , m_fd(fd)
+    , m_events(events)
+    , m_data(data)
+{
+}
+
+void EventPoll::Interest::file_readiness_may_have_changed()
+{
+    m_event_poll.update_readiness(*this);
+}
+
+ErrorOr<NonnullRefPtr<EventPoll>> EventPoll::try_create()
+{
+    return adopt_nonnull_ref_or_enomem(new (nothrow) EventPoll);
+}
+
+EventPoll::~EventPoll()
+{
+    InterestList removed_interests;
+    {
+        SpinlockLocker locker(s_interest_lock);
+        while (!m_interests.is_empty())
+            remove_interest_locked(*m_interests.first(), removed_interests);
+    }
+    free_interests(removed_interests);
+}
+
+bool EventPoll::can_read(OpenFileDescription const&, u64) const
+{
+    return m_ready_list.with([](auto& ready_list) { return !ready_list.is_empty(); });
+}
+
+ErrorOr<NonnullOwnPtr<KString>> EventPoll::pseudo_path(OpenFileDescription const&) const
+{
+    size_t interest_count = 0;
+    {
+        SpinlockLocker locker(s_interest_lock);
+        interest_count = m_interests.size_slow();
+    }
+    return KString::formatted("EventPoll:({})", interest_count);
+}
+
+EventPoll::Interest* EventPoll::find_interest(int fd, OpenFileDescription& description)
+{
+    VERIFY(s_interest_lock.is_locked());
+    // A description is rarely watched by more than a couple of event polls, so this is cheaper than a lookup table,
+    // and doesn't need to allocate anything while holding the lock.
+    for (auto& interest : description.event_poll_interests({})) {
+        if (&interest.m_event_poll == this && interest.fd() == fd)
+            return &interest;
+    }
+    return nullptr;
+}
+
+ErrorOr<void> EventPoll::add_interest(int fd, OpenFileDescription& description, u32 events, u64 data)
+{
+    // FIXME: Allow nesting event polls. This needs loop detection, as notifying
+    //        an event poll that (indirectly) watches itself would never end.
+    if (description.file().is_event_poll())
+        return EINVAL;
+
+    // This is freed after letting go of the lock if it turns out we don't need it.
+    auto new_interest = TRY(adopt_nonnull_own_or_enomem(new (nothrow) Interest(*this, fd, description, events, data)));
+
+    SpinlockLocker locker(s_interest_lock);
+    if (find_interest(fd, description))
+        return EEXIST;
+
+    // From now on, the interest is owned by the list of interests.
+    auto& interest = *new_interest.leak_ptr();
+    m_interests.append(interest);
+    description.event_poll_interests({}).append(interest);
+    description.blocker_set().add_readiness_listener(interest);
+
+    // Pick up the current state, the description might be ready already.
+    update_readiness(interest);
+    return {};
+}
+
+ErrorOr<void> EventPoll::modify_interest(int fd, OpenFileDescription& description, u32 events, u64 data)
+{
+    SpinlockLocker locker(s_interest_lock);
+    auto* interest = find_interest(fd, description);
+    if (!interest)
+        return ENOENT;
+
+    m_ready_list.with([&](auto&) {
+        interest->m_events = events;
+        interest->m_data = data;
+        interest->m_disabled = false;
+        interest->m_reported_flags = BlockFlags::None;
+    });
+    update_readiness(*interest);
+    return {};
+}
+
+ErrorOr<void> EventPoll::remove_interest(int fd, OpenFileDescription& description)
+{
+    InterestList removed_interests;
+    {
+        SpinlockLocker locker(s_interest_lock);
+        auto* interest = find_interest(fd, description);
+        if (!interest)
+            return ENOENT;
+        remove_interest_locked(*interest, removed_interests);
+    }
+    free_interests(removed_interests);
+    return {};
+}
+
+void EventPoll::remove_interest_locked(Interest& interest, InterestList& removed_interests)
+{
+    VERIFY(s_interest_lock.is_locked());
+
+    // Stop the notifications first, they could otherwise put the interest back on the ready list.
+    interest.m_description.blocker_set().remove_readiness_listener(interest);
+    interest.m_description_list_node.remove();
+    m_ready_list.with([&](auto& ready_list) {
+        if (interest.m_ready_list_node.is_in_list())
+            ready_list.remove(interest);
+    });
+
+    removed_interests.append(interest);
+}
+
+void EventPoll::free_interests(InterestList& interests)
+{
+    while (auto* interest = interests.take_first())
+        delete interest;
+}
+
+void EventPoll::update_readiness(Interest& interest)
+{
+    bool did_become_ready = m_ready_list.with([&](auto& ready_list) {
+        auto ready_flags = interest.m_disabled ? BlockFlags::None : interest.m_description.should_unblock(block_flags_for_events(interest.m_events));
+        bool is_ready = ready_flags != BlockFlags::None;
+        if (interest.m_events & EPOLLET) {
+            // Readiness that has gone away will be reported again once it comes back.
+            interest.m_reported_flags &= ready_flags;
+            is_ready = (ready_flags & ~interest.m_reported_flags) != BlockFlags::None;
+        }
+        if (!is_ready) {
+            // Interests stay on the ready list until they're collected, so drop the ones that have nothing to report anymore.
+            if (interest.m_ready_list_node.is_in_list())
+                ready_list.remove(interest);
+            return false;
+        }
+        if (interest.m_ready_list_node.is_in_list())
+            return false;
+        ready_list.append(interest);
+        return true;
+    });
+
+    if (did_become_ready)
+        evaluate_block_conditions();
+}
+
+size_t EventPoll::collect_ready_events(Span<epoll_event> events)
+{
+    return m_ready_list.with([&](auto& ready_list) {
+        size_t count = 0;
+        IntrusiveList<&Interest::m_ready_list_node> still_ready;
+
+        while (count < events.size() && !ready_list.is_empty()) {
+            auto& interest = *ready_list.take_first();
+            auto unblock_flags = interest.m_description.should_unblock(block_flags_for_events(interest.m_events));
+            if (unblock_flags == BlockFlags::None)
+                continue;
+            if (interest.m_events & EPOLLET) {
+                // Only report what became ready since the last time.
+                if ((unblock_flags & ~interest.m_reported_flags) == BlockFlags::None)
+                    continue;
+                interest.m_reported_flags = unblock_flags;
+            }
+
+            auto& event = events[count++];
+            event.events = events_for_block_flags(unblock_flags);
+            event.data.u64 = interest.m_data;
+
+            if (interest.m_events & EPOLLONESHOT)
+                interest.m_disabled = true;
+            else if (!(interest.m_events & EPOLLET))
+                still_ready.append(interest);
+        }
+
+        // Level-triggered interests go to the back, so a busy description can't starve the others.
+        while (!still_ready.is_empty())
+            ready_list.append(*still_ready.take_first());
+        return count;
+    });
+}
+
+void EventPoll::description_will_be_destroyed(Badge<OpenFileDescription>, DescriptionInterestList& interests)
+{
+    InterestList removed_interests;
+    {
+        SpinlockLocker locker(s_interest_lock);
+        while (!interests.is_empty()) {
+            auto& interest = *interests.first();
+            interest.m_event_poll.remove_interest_locked(interest, removed_interests);
+        }
+    }
+    free_interests(removed_interests);
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Badge.h>
+#include <AK/IntrusiveList.h>
+#include <AK/NonnullOwnPtr.h>
+#include <Kernel/API/POSIX/sys/epoll.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Forward.h>
+#include <Kernel/Locking/SpinlockProtected.h>
+
+namespace Kernel {
+
+// An EventPoll keeps a persistent set of descriptions its owner is interested in.
+// Each interest listens to the readiness of its File and puts itself on a ready list,
+// so waiting only has to look at the interests that actually became ready.
+// Like on Linux, an interest belongs to the pair of fd and description it was added with.
+// Closing the fd doesn't remove it, only the destruction of the description does.
+class EventPoll final : public File {
+public:
+    class Interest final : public FileReadinessListener {
+    public:
+        Interest(EventPoll&, int fd, OpenFileDescription&, u32 events, u64 data);
+
+        virtual void file_readiness_may_have_changed() override;
+
+        int fd() const { return m_fd; }
+        OpenFileDescription& description() const { return m_description; }
+
+    private:
+        friend class EventPoll;
+
+        EventPoll& m_event_poll;
+        OpenFileDescription& m_description;
+        int const m_fd { -1 };
+
+        // These are protected by the ready list lock of the EventPoll.
+        u32 m_events { 0 };
+        u64 m_data { 0 };
+        bool m_disabled { false };
+        // What an edge-triggered interest was last reported as ready for, so it only fires again on a transition.
+        Thread::FileBlocker::BlockFlags m_reported_flags { Thread::FileBlocker::BlockFlags::None };
+        IntrusiveListNode<Interest> m_ready_list_node;
+
+        // Links all interests in the EventPoll, protected by the global interest lock.
+        IntrusiveListNode<Interest> m_event_poll_list_node;
+
+    public:
+        // Links all interests in a description, protected by the global interest lock.
+        IntrusiveListNode<Interest> m_description_list_node;
+    };
+
+    using DescriptionInterestList = IntrusiveList<&Interest::m_description_list_node>;
+
+    static ErrorOr<NonnullRefPtr<EventPoll>> try_create();
+    virtual ~EventPoll() override;
+
+    virtual bool can_read(OpenFileDescription const&, u64) const override;
+    // Events can only be collected through epoll_wait().
+    virtual ErrorOr<size_t> read(OpenFileDescription&, u64, UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual bool can_write(OpenFileDescription const&, u64) const override { return false; }
+    virtual ErrorOr<size_t> write(OpenFileDescription&, u64, UserOrKernelBuffer const&, size_t) override { return EINVAL; }
+
+    virtual ErrorOr<NonnullOwnPtr<KString>> pseudo_path(OpenFileDescription const&) const override;
+    virtual StringView class_name() const override { return "EventPoll"sv; }
+    virtual bool is_event_poll() const override { return true; }
+
+    ErrorOr<void> add_interest(int fd, OpenFileDescription&, u32 events, u64 data);
+    ErrorOr<void> modify_interest(int fd, OpenFileDescription&, u32 events, u64 data);
+    ErrorOr<void> remove_interest(int fd, OpenFileDescription&);
+
+    // Reports up to events.size() ready interests without blocking.
+    size_t collect_ready_events(Span<epoll_event> events);
+
+    static void description_will_be_destroyed(Badge<OpenFileDescription>, DescriptionInterestList&);
+
+private:
+    EventPoll() = default;
+
+    using InterestList = IntrusiveList<&Interest::m_event_poll_list_node>;
+
+    Interest* find_interest(int fd, OpenFileDescription&);
+    // Detaches the interest and moves it onto the given list, so it can be freed after letting go of the global lock.
+    void remove_interest_locked(Interest&, InterestList& removed_interests);
+    static void free_interests(InterestList&);
+    void update_readiness(Interest&);
+
+    // Owns the interests, protected by the global interest lock.
+    InterestList m_interests;
+
+    SpinlockProtected<IntrusiveList<&Interest::m_ready_list_node>, LockRank::None> m_ready_list {};
+};
+
+}
@@ -23,7 +23,15 @@ ErrorOr<void> Ext2FSBlockView::ensure_block(BlockBasedFileSystem::BlockIndex blo
     BlockBasedFileSystem::BlockIndex new_first_block = (block.value() / max_blocks_in_view) * max_blocks_in_view;
     BlockBasedFileSystem::BlockIndex new_last_block = new_first_block.value() + max_blocks_in_view - 1;
 
-    m_block_list = TRY(m_inode.compute_block_list(new_first_block, new_last_block));
+    if (m_inode.uses_extents()) {
+        // Logical block numbers of extents are only 32 bits wide, there can't be anything beyond that.
+        if (new_first_block > NumericLimits<u32>::max())
+            m_extents.clear();
+        else
+            m_extents = TRY(Ext2FSExtentTree { m_inode }.collect_extents(new_first_block.value(), min(new_last_block.value(), static_cast<u64>(NumericLimits<u32>::max()))));
+    } else {
+        m_block_list = TRY(m_inode.compute_block_list(new_first_block, new_last_block));
+    }
 
     m_first_block = new_first_block;
     m_last_block = new_last_block;
@@ -33,11 +41,36 @@ ErrorOr<void> Ext2FSBlockView::ensure_block(BlockBasedFileSystem::BlockIndex blo
     return {};
 }
 
+Ext2FSExtentTree::Extent const* Ext2FSBlockView::find_extent(BlockBasedFileSystem::BlockIndex block) const
+{
+    // Find the last extent that starts at or before the block.
+    size_t low = 0;
+    size_t high = m_extents.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (m_extents[middle].logical_block <= block.value())
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0 || !m_extents[low - 1].contains(block.value()))
+        return nullptr;
+    return &m_extents[low - 1];
+}
+
 ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSBlockView::get_block(BlockBasedFileSystem::BlockIndex block)
 {
     MutexLocker block_list_locker(m_block_list_lock);
     TRY(ensure_block(block));
 
+    if (m_inode.uses_extents()) {
+        auto const* extent = find_extent(block);
+        // Unwritten extents read as zeroes, just like holes.
+        if (!extent || extent->is_unwritten)
+            return BlockBasedFileSystem::BlockIndex { 0 };
+        return BlockBasedFileSystem::BlockIndex { extent->physical_block + (block.value() - extent->logical_block) };
+    }
+
     auto it = m_block_list.find(block);
     if (it == m_block_list.end())
         return BlockBasedFileSystem::BlockIndex { 0 };
@@ -47,11 +80,51 @@ ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSBlockView::get_block(BlockBasedF
     return on_disk_block;
 }
 
+ErrorOr<bool> Ext2FSBlockView::has_block(BlockBasedFileSystem::BlockIndex block)
+{
+    MutexLocker block_list_locker(m_block_list_lock);
+    TRY(ensure_block(block));
+
+    if (m_inode.uses_extents())
+        return find_extent(block) != nullptr;
+    return m_block_list.contains(block);
+}
+
+BlockBasedFileSystem::BlockIndex Ext2FSBlockView::allocation_goal_for(BlockBasedFileSystem::BlockIndex block) const
+{
+    VERIFY(m_block_list_lock.is_locked());
+    // We only look at the previous block if it's in the current view, it's just a hint after all.
+    if (block == m_first_block)
+        return 0;
+
+    BlockBasedFileSystem::BlockIndex previous_block = block.value() - 1;
+    if (m_inode.uses_extents()) {
+        if (auto const* extent = find_extent(previous_block))
+            return extent->physical_block + (previous_block.value() - extent->logical_block) + 1;
+        return 0;
+    }
+
+    if (auto on_disk_block = m_block_list.get(previous_block); on_disk_block.has_value())
+        return on_disk_block.value().value() + 1;
+    return 0;
+}
+
 ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSBlockView::get_or_allocate_block(BlockBasedFileSystem::BlockIndex block, bool zero_newly_allocated_block, bool allow_cache)
 {
     MutexLocker block_list_locker(m_block_list_lock);
     TRY(ensure_block(block));
 
+    if (m_inode.uses_extents()) {
+        if (auto const* extent = find_extent(block)) {
+            BlockBasedFileSystem::BlockIndex on_disk_block = extent->physical_block + (block.value() - extent->logical_block);
+            // Blocks of unwritten extents are already allocated, but their contents are garbage until we write to them.
+            if (extent->is_unwritten && zero_newly_allocated_block)
+                TRY(m_inode.zero_block(on_disk_block, allow_cache));
+            return on_disk_block;
+        }
+        return m_inode.allocate_block(block, allocation_goal_for(block), zero_newly_allocated_block, allow_cache);
+    }
+
     auto it = m_block_list.find(block);
     if (it != m_block_list.end()) {
         auto on_disk_block = (*it).value;
@@ -59,7 +132,7 @@ ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSBlockView::get_or_allocate_block
         return on_disk_block;
     }
 
-    auto on_disk_block = TRY(m_inode.allocate_block(block, zero_newly_allocated_block, allow_cache));
+    auto on_disk_block = TRY(m_inode.allocate_block(block, allocation_goal_for(block), zero_newly_allocated_block, allow_cache));
     TRY(m_block_list.try_set(block, on_disk_block));
 
     return on_disk_block;
@@ -69,6 +142,17 @@ ErrorOr<void> Ext2FSBlockView::write_block_pointer(BlockBasedFileSystem::BlockIn
 {
     MutexLocker block_list_locker(m_block_list_lock);
 
+    if (m_inode.uses_extents()) {
+        VERIFY(on_disk_index != 0);
+        TRY(ensure_block(logical_block_index));
+        if (auto const* extent = find_extent(logical_block_index); extent && !extent->is_unwritten && extent->physical_block + (logical_block_index.value() - extent->logical_block) == on_disk_index.value())
+            return {};
+
+        TRY(m_inode.write_block_pointer(logical_block_index, on_disk_index));
+        TRY(Ext2FSExtentTree::map_block_in_list(m_extents, logical_block_index.value(), on_disk_index.value()));
+        return {};
+    }
+
     TRY(m_inode.write_block_pointer(logical_block_index, on_disk_index));
 
     if (on_disk_index == 0)
@@ -79,4 +163,25 @@ ErrorOr<void> Ext2FSBlockView::write_block_pointer(BlockBasedFileSystem::BlockIn
     return {};
 }
 
+ErrorOr<void> Ext2FSBlockView::truncate_extents(BlockBasedFileSystem::BlockIndex first_block_to_remove)
+{
+    MutexLocker block_list_locker(m_block_list_lock);
+    VERIFY(m_inode.uses_extents());
+
+    if (first_block_to_remove > NumericLimits<u32>::max())
+        return {};
+
+    TRY(Ext2FSExtentTree { m_inode }.truncate(first_block_to_remove.value()));
+
+    while (!m_extents.is_empty() && m_extents.last().end() > first_block_to_remove.value()) {
+        auto& extent = m_extents.last();
+        if (extent.logical_block < first_block_to_remove.value()) {
+            extent.length = first_block_to_remove.value() - extent.logical_block;
+            break;
+        }
+        m_extents.take_last();
+    }
+    return {};
+}
+
 }
@@ -8,6 +8,7 @@
 
 #include <AK/SetOnce.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
+#include <Kernel/FileSystem/Ext2FS/ExtentTree.h>
 #include <Kernel/FileSystem/Ext2FS/FileSystem.h>
 
 namespace Kernel {
@@ -18,14 +19,24 @@ class Ext2FSBlockView {
 public:
     Ext2FSBlockView(Ext2FSInode&);
     ErrorOr<BlockBasedFileSystem::BlockIndex> get_block(BlockBasedFileSystem::BlockIndex);
+    // Unlike get_block(), this also counts blocks of unwritten extents, which are allocated but read as zeroes.
+    ErrorOr<bool> has_block(BlockBasedFileSystem::BlockIndex);
     ErrorOr<BlockBasedFileSystem::BlockIndex> get_or_allocate_block(BlockBasedFileSystem::BlockIndex, bool zero_newly_allocated_block, bool allow_cache);
     ErrorOr<void> write_block_pointer(BlockBasedFileSystem::BlockIndex logical_block_index, BlockBasedFileSystem::BlockIndex on_disk_index);
 
+    // Only for inodes that use extents, the others free their blocks one by one via write_block_pointer().
+    ErrorOr<void> truncate_extents(BlockBasedFileSystem::BlockIndex first_block_to_remove);
+
 private:
     ErrorOr<void> ensure_block(BlockBasedFileSystem::BlockIndex);
+    Ext2FSExtentTree::Extent const* find_extent(BlockBasedFileSystem::BlockIndex) const;
+    BlockBasedFileSystem::BlockIndex allocation_goal_for(BlockBasedFileSystem::BlockIndex) const;
 
     Ext2FSInode& m_inode;
+
+    // Inodes with an extent tree keep their mapping as a list of extents, all others as one entry per block.
     Ext2FS::BlockList m_block_list;
+    Vector<Ext2FSExtentTree::Extent> m_extents;
     BlockBasedFileSystem::BlockIndex m_first_block = 0;
     BlockBasedFileSystem::BlockIndex m_last_block = 0;
     SetOnce m_block_list_initialized;
@@ -713,6 +713,57 @@ struct ext2_dir_entry_2 {
 #define EXT2_DIR_ROUND (EXT2_DIR_PAD - 1)
 #define EXT2_DIR_REC_LEN(name_len) (((name_len) + 8 + EXT2_DIR_ROUND) & ~EXT2_DIR_ROUND)
 
+/*
+ * ext4 extent tree of inodes with EXT4_EXTENTS_FL. The root lives in
+ * i_block, every other node occupies a whole block. Each node starts
+ * with a header and is followed by either index entries (interior
+ * nodes) or extents (leaves).
+ */
+struct ext3_extent_header {
+    __u16 eh_magic;      /* probably will support different formats */
+    __u16 eh_entries;    /* number of valid entries */
+    __u16 eh_max;        /* capacity of store in entries */
+    __u16 eh_depth;      /* has tree real underlying blocks? */
+    __u32 eh_generation; /* generation of the tree */
+};
+
+/*
+ * this is extent on-disk structure
+ * it's used at the bottom of the tree
+ */
+struct ext3_extent {
+    __u32 ee_block;    /* first logical block extent covers */
+    __u16 ee_len;      /* number of blocks covered by extent */
+    __u16 ee_start_hi; /* high 16 bits of physical block */
+    __u32 ee_start;    /* low 32 bits of physical block */
+};
+
+/*
+ * this is index on-disk structure
+ * it's used at all the levels, but the bottom
+ */
+struct ext3_extent_idx {
+    __u32 ei_block;   /* index covers logical blocks from 'block' */
+    __u32 ei_leaf;    /* pointer to the physical block of the next *
+                       * level. leaf or next index could bet here */
+    __u16 ei_leaf_hi; /* high 16 bits of physical block */
+    __u16 ei_unused;
+};
+
+#define EXT3_EXT_MAGIC 0xf30a
+
+/*
+ * EXT_INIT_MAX_LEN is the maximum number of blocks we can have in an
+ * initialized extent. This is 2^15 and not (2^16 - 1), since we use the
+ * MSB of ee_len field in the extent datastructure to signify if this
+ * particular extent is an initialized extent or an uninitialized (i.e.
+ * preallocated).
+ * EXT_UNINIT_MAX_LEN is the maximum number of blocks we can have in an
+ * uninitialized extent.
+ */
+#define EXT_INIT_MAX_LEN (1UL << 15)
+#define EXT_UNINIT_MAX_LEN (EXT_INIT_MAX_LEN - 1)
+
 /*
  * This structure will be used for multiple mount protection. It will be
  * written into the block number saved in the s_mmp_block field in the
@@ -0,0 +1,743 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/IntegralMath.h>
+#include <AK/IterationDecision.h>
+#include <AK/QuickSort.h>
+#include <Kernel/API/POSIX/errno.h>
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/Ext2FS/DirectoryIndex.h>
+#include <Kernel/FileSystem/Ext2FS/FileSystem.h>
+#include <Kernel/FileSystem/Ext2FS/Inode.h>
+
+namespace Kernel {
+
+// The root block starts with the "." and ".." entries, and the index root follows right after them.
+static constexpr size_t root_info_offset = EXT2_DIR_REC_LEN(1) + EXT2_DIR_REC_LEN(2);
+
+// Index nodes start with an unused directory entry that spans the whole block.
+static constexpr size_t node_entries_offset = 8;
+
+// Only the lower 28 bits of the block number in an index entry are used.
+static constexpr u32 index_entry_block_mask = 0x0fffffff;
+
+static constexpr u32 hash_eof = 0x7fffffff;
+
+// Walks the entries of a block of directory entries, making sure that they stay within it.
+template<typename Callback>
+static ErrorOr<void> for_each_entry_in_block(Bytes block, Callback callback)
+{
+    size_t offset = 0;
+    Optional<size_t> previous_offset;
+    while (offset < block.size()) {
+        if (block.size() - offset < 8)
+            return EIO;
+        auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+        if (entry.rec_len < 8 || entry.rec_len % EXT2_DIR_PAD != 0 || entry.rec_len > block.size() - offset || entry.name_len + 8u > entry.rec_len)
+            return EIO;
+        if (callback(entry, offset, previous_offset) == IterationDecision::Break)
+            return {};
+        previous_offset = offset;
+        offset += entry.rec_len;
+    }
+    return {};
+}
+
+// The hash functions below have to match the ones used by Linux and e2fsprogs bit for bit.
+
+static void name_to_hash_buffer(StringView name, u32* buffer, size_t count, bool is_unsigned)
+{
+    u32 padding = static_cast<u32>(name.length()) | (static_cast<u32>(name.length()) << 8);
+    padding |= padding << 16;
+
+    u32 value = padding;
+    size_t length = min(name.length(), count * 4);
+    for (size_t i = 0; i < length; ++i) {
+        i32 character = is_unsigned ? static_cast<i32>(static_cast<u8>(name[i])) : static_cast<i32>(static_cast<i8>(name[i]));
+        value = static_cast<u32>(character) + (value << 8);
+        if (i % 4 == 3) {
+            *buffer++ = value;
+            value = padding;
+            --count;
+        }
+    }
+    if (count > 0) {
+        *buffer++ = value;
+        --count;
+    }
+    while (count > 0) {
+        *buffer++ = padding;
+        --count;
+    }
+}
+
+static u32 legacy_hash(StringView name, bool is_unsigned)
+{
+    u32 hash0 = 0x12a3fe2d;
+    u32 hash1 = 0x37abe8f9;
+    for (auto ch : name) {
+        i32 character = is_unsigned ? static_cast<i32>(static_cast<u8>(ch)) : static_cast<i32>(static_cast<i8>(ch));
+        u32 hash = hash1 + (hash0 ^ static_cast<u32>(character * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+static void half_md4_transform(u32 buffer[4], u32 const input[8])
+{
+    auto f = [](u32 x, u32 y, u32 z) { return z ^ (x & (y ^ z)); };
+    auto g = [](u32 x, u32 y, u32 z) { return (x & y) + ((x ^ y) & z); };
+    auto h = [](u32 x, u32 y, u32 z) { return x ^ y ^ z; };
+    auto round = [](auto function, u32& a, u32 b, u32 c, u32 d, u32 x, u32 s) {
+        a += function(b, c, d) + x;
+        a = (a << s) | (a >> (32 - s));
+    };
+
+    constexpr u32 k1 = 0;
+    constexpr u32 k2 = 0x5a827999;
+    constexpr u32 k3 = 0x6ed9eba1;
+
+    u32 a = buffer[0];
+    u32 b = buffer[1];
+    u32 c = buffer[2];
+    u32 d = buffer[3];
+
+    round(f, a, b, c, d, input[0] + k1, 3);
+    round(f, d, a, b, c, input[1] + k1, 7);
+    round(f, c, d, a, b, input[2] + k1, 11);
+    round(f, b, c, d, a, input[3] + k1, 19);
+    round(f, a, b, c, d, input[4] + k1, 3);
+    round(f, d, a, b, c, input[5] + k1, 7);
+    round(f, c, d, a, b, input[6] + k1, 11);
+    round(f, b, c, d, a, input[7] + k1, 19);
+
+    round(g, a, b, c, d, input[1] + k2, 3);
+    round(g, d, a, b, c, input[3] + k2, 5);
+    round(g, c, d, a, b, input[5] + k2, 9);
+    round(g, b, c, d, a, input[7] + k2, 13);
+    round(g, a, b, c, d, input[0] + k2, 3);
+    round(g, d, a, b, c, input[2] + k2, 5);
+    round(g, c, d, a, b, input[4] + k2, 9);
+    round(g, b, c, d, a, input[6] + k2, 13);
+
+    round(h, a, b, c, d, input[3] + k3, 3);
+    round(h, d, a, b, c, input[7] + k3, 9);
+    round(h, c, d, a, b, input[2] + k3, 11);
+    round(h, b, c, d, a, input[6] + k3, 15);
+    round(h, a, b, c, d, input[1] + k3, 3);
+    round(h, d, a, b, c, input[5] + k3, 9);
+    round(h, c, d, a, b, input[0] + k3, 11);
+    round(h, b, c, d, a, input[4] + k3, 15);
+
+    buffer[0] += a;
+    buffer[1] += b;
+    buffer[2] += c;
+    buffer[3] += d;
+}
+
+static void tea_transform(u32 buffer[4], u32 const input[4])
+{
+    constexpr u32 delta = 0x9e3779b9;
+    u32 sum = 0;
+    u32 b0 = buffer[0];
+    u32 b1 = buffer[1];
+    for (size_t i = 0; i < 16; ++i) {
+        sum += delta;
+        b0 += ((b1 << 4) + input[0]) ^ (b1 + sum) ^ ((b1 >> 5) + input[1]);
+        b1 += ((b0 << 4) + input[2]) ^ (b0 + sum) ^ ((b0 >> 5) + input[3]);
+    }
+    buffer[0] += b0;
+    buffer[1] += b1;
+}
+
+u8 Ext2FSDirectoryIndex::default_hash_version(Ext2FSInode const& inode)
+{
+    auto hash_version = inode.fs().super_block().s_def_hash_version;
+    if (hash_version == EXT2_HASH_LEGACY || hash_version == EXT2_HASH_HALF_MD4 || hash_version == EXT2_HASH_TEA)
+        return hash_version;
+    return EXT2_HASH_HALF_MD4;
+}
+
+u8 Ext2FSDirectoryIndex::effective_hash_version(Ext2FSInode const& inode, u8 hash_version)
+{
+    // The on-disk hash version doesn't say whether names are hashed as signed or unsigned characters,
+    // that is a property of the whole filesystem.
+    if (hash_version <= EXT2_HASH_TEA && (inode.fs().super_block().s_flags & EXT2_FLAGS_UNSIGNED_HASH))
+        return hash_version + 3;
+    return hash_version;
+}
+
+u32 Ext2FSDirectoryIndex::hash_name(Ext2FSInode const& inode, StringView name, u8 hash_version)
+{
+    u32 buffer[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    auto const& seed = inode.fs().super_block().s_hash_seed;
+    if (seed[0] || seed[1] || seed[2] || seed[3])
+        memcpy(buffer, seed, sizeof(buffer));
+
+    u32 hash = 0;
+    switch (auto version = effective_hash_version(inode, hash_version)) {
+    case EXT2_HASH_LEGACY:
+    case EXT2_HASH_LEGACY_UNSIGNED:
+        hash = legacy_hash(name, version == EXT2_HASH_LEGACY_UNSIGNED);
+        break;
+    case EXT2_HASH_HALF_MD4:
+    case EXT2_HASH_HALF_MD4_UNSIGNED:
+        for (size_t offset = 0; offset < name.length(); offset += 32) {
+            u32 input[8];
+            name_to_hash_buffer(name.substring_view(offset), input, 8, version == EXT2_HASH_HALF_MD4_UNSIGNED);
+            half_md4_transform(buffer, input);
+        }
+        hash = buffer[1];
+        break;
+    case EXT2_HASH_TEA:
+    case EXT2_HASH_TEA_UNSIGNED:
+        for (size_t offset = 0; offset < name.length(); offset += 16) {
+            u32 input[4];
+            name_to_hash_buffer(name.substring_view(offset), input, 4, version == EXT2_HASH_TEA_UNSIGNED);
+            tea_transform(buffer, input);
+        }
+        hash = buffer[0];
+        break;
+    default:
+        VERIFY_NOT_REACHED();
+    }
+
+    // The lowest bit is used to mark hash collisions that continue in the next block, and the largest hash is reserved.
+    hash &= ~1u;
+    if (hash == (hash_eof << 1))
+        hash = (hash_eof - 1) << 1;
+    return hash;
+}
+
+u32 Ext2FSDirectoryIndex::Frame::block_at_position()
+{
+    return entries()[position].block & index_entry_block_mask;
+}
+
+Ext2FSDirectoryIndex::Ext2FSDirectoryIndex(Ext2FSInode& inode, u8 hash_version, u8 indirect_levels, size_t root_entries_offset)
+    : m_inode(inode)
+    , m_hash_version(hash_version)
+    , m_indirect_levels(indirect_levels)
+    , m_root_entries_offset(root_entries_offset)
+{
+}
+
+ErrorOr<Optional<Ext2FSDirectoryIndex>> Ext2FSDirectoryIndex::try_open(Ext2FSInode& inode)
+{
+    VERIFY(inode.m_inode_lock.is_exclusively_locked_by_current_thread());
+    if (!inode.is_directory() || !(inode.m_raw_inode.i_flags & EXT2_INDEX_FL))
+        return OptionalNone {};
+
+    auto block_size = inode.fs().logical_block_size();
+    if (inode.size() < 2 * block_size)
+        return OptionalNone {};
+
+    Ext2FSDirectoryIndex index { inode, 0, 0, 0 };
+    ByteBuffer root;
+    TRY(index.read_block(0, root));
+
+    auto const& info = *reinterpret_cast<ext2_dx_root_info const*>(root.data() + root_info_offset);
+    auto entries_offset = root_info_offset + info.info_length;
+    if (info.reserved_zero != 0 || info.hash_version > EXT2_HASH_TEA_UNSIGNED || info.info_length < sizeof(ext2_dx_root_info) || info.info_length % 4 != 0
+        || info.indirect_levels > maximum_indirect_levels || entries_offset + sizeof(ext2_dx_entry) > block_size) {
+        dbgln_if(EXT2_DEBUG, "Ext2FSDirectoryIndex: Ignoring unsupported index of directory {} (hash version {}, {} indirect levels)", inode.identifier(), info.hash_version, info.indirect_levels);
+        return OptionalNone {};
+    }
+
+    auto const& countlimit = *reinterpret_cast<ext2_dx_countlimit const*>(root.data() + entries_offset);
+    if (countlimit.limit == 0 || countlimit.limit > (block_size - entries_offset) / sizeof(ext2_dx_entry) || countlimit.count == 0 || countlimit.count > countlimit.limit) {
+        dbgln_if(EXT2_DEBUG, "Ext2FSDirectoryIndex: Ignoring corrupt index root of directory {}", inode.identifier());
+        return OptionalNone {};
+    }
+
+    return Ext2FSDirectoryIndex { inode, info.hash_version, info.indirect_levels, entries_offset };
+}
+
+ErrorOr<void> Ext2FSDirectoryIndex::read_block(u32 logical_block, ByteBuffer& buffer) const
+{
+    auto block_size = m_inode.fs().logical_block_size();
+    if (buffer.size() != block_size)
+        buffer = TRY(ByteBuffer::create_uninitialized(block_size));
+    auto buffer_view = UserOrKernelBuffer::for_kernel_buffer(buffer.data());
+    auto nread = TRY(m_inode.read_bytes_locked(static_cast<off_t>(logical_block) * block_size, block_size, buffer_view, nullptr));
+    if (nread != block_size)
+        return EIO;
+    return {};
+}
+
+ErrorOr<void> Ext2FSDirectoryIndex::write_block(u32 logical_block, ReadonlyBytes data)
+{
+    auto block_size = m_inode.fs().logical_block_size();
+    VERIFY(data.size() == block_size);
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(data.data()));
+    auto nwritten = TRY(m_inode.write_bytes_locked(static_cast<off_t>(logical_block) * block_size, block_size, buffer, nullptr));
+    if (nwritten != block_size)
+        return EIO;
+    return {};
+}
+
+ErrorOr<u32> Ext2FSDirectoryIndex::append_block(ReadonlyBytes data)
+{
+    u32 logical_block = m_inode.size() / m_inode.fs().logical_block_size();
+    TRY(write_block(logical_block, data));
+    return logical_block;
+}
+
+void Ext2FSDirectoryIndex::write_entry(Bytes block, size_t offset, u16 record_length, InodeIndex inode_index, u8 file_type, StringView name)
+{
+    VERIFY(offset + record_length <= block.size());
+    VERIFY(EXT2_DIR_REC_LEN(name.length()) <= record_length);
+    auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+    entry.inode = inode_index.value();
+    entry.rec_len = record_length;
+    entry.name_len = name.length();
+    entry.file_type = file_type;
+    memcpy(entry.name, name.characters_without_null_termination(), name.length());
+    memset(entry.name + name.length(), 0, EXT2_DIR_REC_LEN(name.length()) - 8 - name.length());
+}
+
+ErrorOr<bool> Ext2FSDirectoryIndex::try_insert_into_block(Bytes block, StringView name, InodeIndex inode_index, u8 file_type)
+{
+    auto needed_length = EXT2_DIR_REC_LEN(name.length());
+    bool inserted = false;
+    TRY(for_each_entry_in_block(block, [&](auto& entry, size_t offset, auto) {
+        size_t used_length = entry.inode != 0 ? EXT2_DIR_REC_LEN(entry.name_len) : 0;
+        if (entry.rec_len - used_length < needed_length)
+            return IterationDecision::Continue;
+        if (used_length == 0) {
+            write_entry(block, offset, entry.rec_len, inode_index, file_type, name);
+        } else {
+            u16 remaining_length = entry.rec_len - used_length;
+            entry.rec_len = used_length;
+            write_entry(block, offset + used_length, remaining_length, inode_index, file_type, name);
+        }
+        inserted = true;
+        return IterationDecision::Break;
+    }));
+    return inserted;
+}
+
+ErrorOr<Ext2FSDirectoryIndex::Frame> Ext2FSDirectoryIndex::read_frame(u32 logical_block, size_t entries_offset) const
+{
+    Frame frame;
+    frame.logical_block = logical_block;
+    frame.entries_offset = entries_offset;
+    TRY(read_block(logical_block, frame.buffer));
+
+    auto maximum_limit = (frame.buffer.size() - entries_offset) / sizeof(ext2_dx_entry);
+    if (frame.limit() == 0 || frame.limit() > maximum_limit || frame.count() == 0 || frame.count() > frame.limit()) {
+        dbgln("Ext2FSDirectoryIndex: Corrupt index block {} in directory {}", logical_block, m_inode.identifier());
+        return EIO;
+    }
+    return frame;
+}
+
+ErrorOr<Ext2FSDirectoryIndex::Path> Ext2FSDirectoryIndex::probe(u32 hash) const
+{
+    Path path;
+    TRY(path.try_append(TRY(read_frame(0, m_root_entries_offset))));
+
+    for (size_t level = 0;; ++level) {
+        auto& frame = path.last();
+
+        // Find the last entry whose hash isn't larger than ours. The first entry doesn't have a hash,
+        // it covers everything below the second one.
+        auto* entries = frame.entries();
+        size_t low = 1;
+        size_t high = frame.count();
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (entries[middle].hash > hash)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        frame.position = low - 1;
+
+        if (level == m_indirect_levels)
+            return path;
+
+        auto node = TRY(read_frame(frame.block_at_position(), node_entries_offset));
+        TRY(path.try_append(move(node)));
+    }
+}
+
+ErrorOr<bool> Ext2FSDirectoryIndex::advance_to_next_leaf(Path& path, u32 hash) const
+{
+    // Entries with the same hash can spill over into the following leaves, which is marked by the lowest bit
+    // of the hash under which those leaves are indexed.
+    size_t level = path.size() - 1;
+    while (path[level].position + 1 >= path[level].count()) {
+        if (level == 0)
+            return false;
+        --level;
+    }
+    auto& frame = path[level];
+    ++frame.position;
+
+    u32 next_hash = frame.entries()[frame.position].hash;
+    if (!(next_hash & 1) || (next_hash & ~1u) != hash)
+        return false;
+
+    for (++level; level < path.size(); ++level) {
+        path[level] = TRY(read_frame(path[level - 1].block_at_position(), node_entries_offset));
+        path[level].position = 0;
+    }
+    return true;
+}
+
+ErrorOr<Optional<Ext2FSDirectoryIndex::EntryLocation>> Ext2FSDirectoryIndex::find_entry(StringView name, ByteBuffer& block)
+{
+    auto find_in_block = [&](u32 logical_block) -> ErrorOr<Optional<EntryLocation>> {
+        TRY(read_block(logical_block, block));
+        Optional<EntryLocation> location;
+        TRY(for_each_entry_in_block(block.bytes(), [&](auto& entry, size_t offset, Optional<size_t> previous_offset) {
+            if (entry.inode == 0 || StringView { entry.name, entry.name_len } != name)
+                return IterationDecision::Continue;
+            location = EntryLocation { logical_block, offset, previous_offset };
+            return IterationDecision::Break;
+        }));
+        return location;
+    };
+
+    // "." and ".." are never part of the index, they always live at the start of the root block.
+    if (name == "."sv || name == ".."sv)
+        return find_in_block(0);
+
+    auto hash = hash_name(name);
+    auto path = TRY(probe(hash));
+    while (true) {
+        if (auto location = TRY(find_in_block(path.last().block_at_position())); location.has_value())
+            return location;
+        if (!TRY(advance_to_next_leaf(path, hash)))
+            return OptionalNone {};
+    }
+}
+
+ErrorOr<Optional<InodeIndex>> Ext2FSDirectoryIndex::lookup(StringView name)
+{
+    ByteBuffer block;
+    auto location = TRY(find_entry(name, block));
+    if (!location.has_value())
+        return OptionalNone {};
+    auto const& entry = *reinterpret_cast<ext2_dir_entry_2 const*>(block.data() + location->offset);
+    return InodeIndex { entry.inode };
+}
+
+ErrorOr<void> Ext2FSDirectoryIndex::remove_entry(StringView name)
+{
+    ByteBuffer block;
+    auto location = TRY(find_entry(name, block));
+    if (!location.has_value())
+        return ENOENT;
+
+    // Like everyone else, we never shrink the index. The space is reused by later insertions into the same leaf.
+    auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + location->offset);
+    if (location->previous_offset.has_value()) {
+        auto& previous_entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + *location->previous_offset);
+        previous_entry.rec_len += entry.rec_len;
+    } else {
+        entry.inode = 0;
+    }
+    return write_block(location->logical_block, block);
+}
+
+void Ext2FSDirectoryIndex::insert_index_entry(Frame& frame, size_t position, u32 hash, u32 logical_block)
+{
+    auto count = frame.count();
+    VERIFY(count < frame.limit());
+    VERIFY(position >= 1 && position <= count);
+    auto* entries = frame.entries();
+    memmove(&entries[position + 1], &entries[position], (count - position) * sizeof(ext2_dx_entry));
+    entries[position].hash = hash;
+    entries[position].block = logical_block;
+    frame.countlimit().count = count + 1;
+}
+
+static ErrorOr<ByteBuffer> create_index_node_buffer(size_t block_size)
+{
+    auto buffer = TRY(ByteBuffer::create_zeroed(block_size));
+    auto& fake_entry = *reinterpret_cast<ext2_dir_entry_2*>(buffer.data());
+    fake_entry.inode = 0;
+    fake_entry.rec_len = block_size;
+    return buffer;
+}
+
+ErrorOr<void> Ext2FSDirectoryIndex::make_room_in_index(Path& path)
+{
+    if (path.last().count() < path.last().limit())
+        return {};
+
+    auto block_size = m_inode.fs().logical_block_size();
+    u16 node_limit = (block_size - node_entries_offset) / sizeof(ext2_dx_entry);
+    auto& root = path[0];
+
+    if (path.size() == 1) {
+        VERIFY(m_indirect_levels == 0);
+
+        // The root is full, so we grow the tree by a level: All of the root's entries move into a new index node,
+        // which then becomes the only child of the root.
+        Frame node;
+        node.buffer = TRY(create_index_node_buffer(block_size));
+        node.entries_offset = node_entries_offset;
+        node.position = root.position;
+        memcpy(node.entries(), root.entries(), root.count() * sizeof(ext2_dx_entry));
+        node.countlimit().limit = node_limit;
+        node.countlimit().count = root.count();
+        node.logical_block = TRY(append_block(node.buffer));
+
+        root.countlimit().count = 1;
+        root.entries()[0].block = node.logical_block;
+        root.position = 0;
+        reinterpret_cast<ext2_dx_root_info*>(root.buffer.data() + root_info_offset)->indirect_levels = 1;
+        TRY(write_block(0, root.buffer));
+        m_indirect_levels = 1;
+
+        TRY(path.try_append(move(node)));
+        return {};
+    }
+
+    // The index node is full, so half of its entries move to a new node, which needs a slot in the root.
+    if (root.count() >= root.limit()) {
+        dbgln("Ext2FSDirectoryIndex: Index of directory {} is full", m_inode.identifier());
+        return ENOSPC;
+    }
+
+    auto& node = path[1];
+    size_t count = node.count();
+    size_t keep = count / 2;
+    u32 split_hash = node.entries()[keep].hash;
+
+    Frame new_node;
+    new_node.buffer = TRY(create_index_node_buffer(block_size));
+    new_node.entries_offset = node_entries_offset;
+    memcpy(new_node.entries(), &node.entries()[keep], (count - keep) * sizeof(ext2_dx_entry));
+    new_node.countlimit().limit = node_limit;
+    new_node.countlimit().count = count - keep;
+    new_node.logical_block = TRY(append_block(new_node.buffer));
+
+    node.countlimit().count = keep;
+    TRY(write_block(node.logical_block, node.buffer));
+
+    insert_index_entry(root, root.position + 1, split_hash, new_node.logical_block);
+    TRY(write_block(0, root.buffer));
+
+    if (node.position >= keep) {
+        new_node.position = node.position - keep;
+        root.position += 1;
+        path[1] = move(new_node);
+    }
+    return {};
+}
+
+ErrorOr<void> Ext2FSDirectoryIndex::add_entry(StringView name, InodeIndex inode_index, u8 file_type)
+{
+    auto block_size = m_inode.fs().logical_block_size();
+    auto hash = hash_name(name);
+    auto path = TRY(probe(hash));
+
+    auto leaf_block = path.last().block_at_position();
+    ByteBuffer leaf;
+    TRY(read_block(leaf_block, leaf));
+    if (TRY(try_insert_into_block(leaf.bytes(), name, inode_index, file_type)))
+        return write_block(leaf_block, leaf);
+
+    // The leaf is full, so we split it in two halves by hash. The upper half goes into a new leaf, which needs a slot in the index.
+    TRY(make_room_in_index(path));
+
+    struct HashedEntry {
+        u32 hash { 0 };
+        size_t offset { 0 };
+        size_t length { 0 };
+    };
+    Vector<HashedEntry> entries;
+    TRY(entries.try_ensure_capacity(block_size / EXT2_DIR_REC_LEN(1)));
+    TRY(for_each_entry_in_block(leaf.bytes(), [&](auto& entry, size_t offset, auto) {
+        if (entry.inode != 0)
+            entries.unchecked_append({ hash_name(StringView { entry.name, entry.name_len }), offset, EXT2_DIR_REC_LEN(entry.name_len) });
+        return IterationDecision::Continue;
+    }));
+    if (entries.size() < 2)
+        return ENOSPC;
+    quick_sort(entries, [](auto const& a, auto const& b) { return a.hash < b.hash; });
+
+    size_t split = entries.size();
+    size_t moved_length = 0;
+    while (split > 1 && moved_length + entries[split - 1].length / 2 <= block_size / 2) {
+        moved_length += entries[split - 1].length;
+        --split;
+    }
+    if (split == entries.size())
+        --split;
+
+    // If entries with the same hash end up on both sides of the split, the new leaf is marked as a continuation.
+    u32 split_hash = entries[split].hash;
+    if (split_hash == entries[split - 1].hash)
+        split_hash |= 1;
+
+    auto pack_entries = [&](Span<HashedEntry const> entries_to_pack) -> ErrorOr<ByteBuffer> {
+        auto buffer = TRY(ByteBuffer::create_zeroed(block_size));
+        size_t offset = 0;
+        for (auto const& entry : entries_to_pack) {
+            memcpy(buffer.data() + offset, leaf.data() + entry.offset, entry.length);
+            reinterpret_cast<ext2_dir_entry_2*>(buffer.data() + offset)->rec_len = entry.length;
+            offset += entry.length;
+        }
+        auto& last_entry = *reinterpret_cast<ext2_dir_entry_2*>(buffer.data() + offset - entries_to_pack.last().length);
+        last_entry.rec_len += block_size - offset;
+        return buffer;
+    };
+    auto lower = TRY(pack_entries(entries.span().slice(0, split)));
+    auto upper = TRY(pack_entries(entries.span().slice(split)));
+
+    auto& target = hash >= split_hash ? upper : lower;
+    if (!TRY(try_insert_into_block(target.bytes(), name, inode_index, file_type)))
+        return ENOSPC;
+
+    auto new_leaf_block = TRY(append_block(upper));
+    TRY(write_block(leaf_block, lower));
+
+    auto& parent = path.last();
+    insert_index_entry(parent, parent.position + 1, split_hash, new_leaf_block);
+    return write_block(parent.logical_block, parent.buffer);
+}
+
+ErrorOr<void> Ext2FSDirectoryIndex::build(Ext2FSInode& inode, Vector<Ext2FSDirectoryEntry> const& entries)
+{
+    VERIFY(inode.m_inode_lock.is_exclusively_locked_by_current_thread());
+    auto block_size = inode.fs().logical_block_size();
+    auto hash_version = default_hash_version(inode);
+
+    Optional<size_t> dot_index;
+    Optional<size_t> dot_dot_index;
+    struct HashedEntry {
+        u32 hash { 0 };
+        size_t index { 0 };
+    };
+    Vector<HashedEntry> hashed_entries;
+    TRY(hashed_entries.try_ensure_capacity(entries.size()));
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto name = entries[i].name->view();
+        if (name == "."sv)
+            dot_index = i;
+        else if (name == ".."sv)
+            dot_dot_index = i;
+        else
+            hashed_entries.unchecked_append({ hash_name(inode, name, hash_version), i });
+    }
+    if (!dot_index.has_value() || !dot_dot_index.has_value())
+        return EINVAL;
+    quick_sort(hashed_entries, [](auto const& a, auto const& b) { return a.hash < b.hash; });
+
+    // Decide where each leaf starts first, so that we can bail out before touching the directory if the index can't hold them.
+    // Leaves are only filled up to three quarters, so that the following insertions don't have to split them right away.
+    struct Leaf {
+        u32 hash { 0 };
+        size_t first_entry { 0 };
+    };
+    Vector<Leaf> leaves;
+    TRY(leaves.try_append({ 0, 0 }));
+    size_t const fill_limit = block_size * 3 / 4;
+    size_t offset = 0;
+    for (size_t i = 0; i < hashed_entries.size(); ++i) {
+        auto length = EXT2_DIR_REC_LEN(entries[hashed_entries[i].index].name->length());
+        if (offset > 0 && offset + length > fill_limit) {
+            u32 hash = hashed_entries[i].hash;
+            if (hash == hashed_entries[i - 1].hash)
+                hash |= 1;
+            TRY(leaves.try_append({ hash, i }));
+            offset = 0;
+        }
+        offset += length;
+    }
+
+    size_t const root_entries_offset = root_info_offset + sizeof(ext2_dx_root_info);
+    u16 const root_limit = (block_size - root_entries_offset) / sizeof(ext2_dx_entry);
+    u16 const node_limit = (block_size - node_entries_offset) / sizeof(ext2_dx_entry);
+    size_t node_count = leaves.size() > root_limit ? ceil_div(leaves.size(), static_cast<size_t>(node_limit)) : 0;
+    if (node_count > root_limit)
+        return EOVERFLOW;
+
+    dbgln_if(EXT2_DEBUG, "Ext2FSDirectoryIndex: Building index for directory {} with {} entries in {} leaves", inode.identifier(), entries.size(), leaves.size());
+
+    Ext2FSDirectoryIndex index { inode, hash_version, static_cast<u8>(node_count > 0 ? 1 : 0), root_entries_offset };
+
+    // Keep the first block around for the root, and write everything else after it.
+    TRY(inode.resize(block_size));
+
+    auto block = TRY(ByteBuffer::create_zeroed(block_size));
+    for (size_t leaf_index = 0; leaf_index < leaves.size(); ++leaf_index) {
+        block.zero_fill();
+        auto first_entry = leaves[leaf_index].first_entry;
+        auto end_entry = leaf_index + 1 < leaves.size() ? leaves[leaf_index + 1].first_entry : hashed_entries.size();
+        if (first_entry == end_entry) {
+            write_entry(block.bytes(), 0, block_size, 0, 0, ""sv);
+        } else {
+            size_t offset = 0;
+            for (size_t i = first_entry; i < end_entry; ++i) {
+                auto const& entry = entries[hashed_entries[i].index];
+                auto length = EXT2_DIR_REC_LEN(entry.name->length());
+                auto record_length = i + 1 == end_entry ? block_size - offset : length;
+                write_entry(block.bytes(), offset, record_length, entry.inode_index, entry.file_type, entry.name->view());
+                offset += length;
+            }
+        }
+        TRY(index.write_block(1 + leaf_index, block));
+    }
+
+    auto write_index_entries = [](Frame& frame, Span<Leaf const> children, u32 first_child_block) {
+        frame.countlimit().count = children.size();
+        frame.entries()[0].block = first_child_block;
+        for (size_t i = 1; i < children.size(); ++i) {
+            frame.entries()[i].hash = children[i].hash;
+            frame.entries()[i].block = first_child_block + i;
+        }
+    };
+
+    Frame root;
+    root.buffer = TRY(ByteBuffer::create_zeroed(block_size));
+    root.entries_offset = root_entries_offset;
+    auto const& dot = entries[*dot_index];
+    auto const& dot_dot = entries[*dot_dot_index];
+    write_entry(root.buffer.bytes(), 0, EXT2_DIR_REC_LEN(1), dot.inode_index, dot.file_type, "."sv);
+    write_entry(root.buffer.bytes(), EXT2_DIR_REC_LEN(1), block_size - EXT2_DIR_REC_LEN(1), dot_dot.inode_index, dot_dot.file_type, ".."sv);
+    auto& info = *reinterpret_cast<ext2_dx_root_info*>(root.buffer.data() + root_info_offset);
+    info.hash_version = hash_version;
+    info.info_length = sizeof(ext2_dx_root_info);
+    info.indirect_levels = index.m_indirect_levels;
+    root.countlimit().limit = root_limit;
+
+    if (node_count == 0) {
+        write_index_entries(root, leaves.span(), 1);
+    } else {
+        Vector<Leaf> nodes;
+        TRY(nodes.try_ensure_capacity(node_count));
+        u32 first_node_block = 1 + leaves.size();
+        for (size_t node_index = 0; node_index < node_count; ++node_index) {
+            auto first_leaf = node_index * node_limit;
+            auto children = leaves.span().slice(first_leaf, min(static_cast<size_t>(node_limit), leaves.size() - first_leaf));
+            Frame node;
+            node.buffer = TRY(create_index_node_buffer(block_size));
+            node.entries_offset = node_entries_offset;
+            node.countlimit().limit = node_limit;
+            write_index_entries(node, children, 1 + first_leaf);
+            TRY(index.write_block(first_node_block + node_index, node.buffer));
+            nodes.unchecked_append({ children[0].hash, 0 });
+        }
+        write_index_entries(root, nodes.span(), first_node_block);
+    }
+
+    TRY(index.write_block(0, root.buffer));
+
+    inode.m_raw_inode.i_flags |= EXT2_INDEX_FL;
+    inode.set_metadata_dirty(true);
+    return {};
+}
+
+}
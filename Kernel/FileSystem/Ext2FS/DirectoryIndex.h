@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Error.h>
+#include <AK/Optional.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/Ext2FS/Definitions.h>
+#include <Kernel/FileSystem/Ext2FS/DirectoryEntry.h>
+#include <Kernel/FileSystem/Inode.h>
+
+namespace Kernel {
+
+class Ext2FSInode;
+
+// The hashed directory index ("htree") of the dir_index feature.
+//
+// The first block of an indexed directory holds the "." and ".." entries, followed by the root of a
+// shallow B-tree that is keyed by a hash of the entry names. Every other block is either an interior
+// index node or an ordinary block of directory entries (a "leaf"). Index blocks look like blocks that
+// only contain unused entries, so they can still be walked linearly by code that doesn't know about them.
+class Ext2FSDirectoryIndex {
+public:
+    // Returns an empty Optional if the directory isn't indexed, or the index is in a format we don't understand.
+    // In that case the directory is still a valid linear directory.
+    static ErrorOr<Optional<Ext2FSDirectoryIndex>> try_open(Ext2FSInode&);
+
+    // Writes out the given entries as a freshly indexed directory, replacing the previous contents.
+    static ErrorOr<void> build(Ext2FSInode&, Vector<Ext2FSDirectoryEntry> const&);
+
+    ErrorOr<Optional<InodeIndex>> lookup(StringView name);
+    ErrorOr<void> add_entry(StringView name, InodeIndex, u8 file_type);
+    ErrorOr<void> remove_entry(StringView name);
+
+private:
+    // Without the large_dir feature, the tree has at most one level of index nodes below the root.
+    static constexpr u8 maximum_indirect_levels = 1;
+
+    struct Frame {
+        u32 logical_block { 0 };
+        ByteBuffer buffer;
+        size_t entries_offset { 0 };
+        size_t position { 0 };
+
+        ext2_dx_countlimit& countlimit() { return *reinterpret_cast<ext2_dx_countlimit*>(buffer.data() + entries_offset); }
+        ext2_dx_entry* entries() { return reinterpret_cast<ext2_dx_entry*>(buffer.data() + entries_offset); }
+        u16 count() { return countlimit().count; }
+        u16 limit() { return countlimit().limit; }
+        u32 block_at_position();
+    };
+
+    using Path = Vector<Frame, maximum_indirect_levels + 1>;
+
+    struct EntryLocation {
+        u32 logical_block { 0 };
+        size_t offset { 0 };
+        Optional<size_t> previous_offset;
+    };
+
+    Ext2FSDirectoryIndex(Ext2FSInode&, u8 hash_version, u8 indirect_levels, size_t root_entries_offset);
+
+    static u8 default_hash_version(Ext2FSInode const&);
+    static u8 effective_hash_version(Ext2FSInode const&, u8 hash_version);
+    static u32 hash_name(Ext2FSInode const&, StringView name, u8 hash_version);
+
+    static void write_entry(Bytes block, size_t offset, u16 record_length, InodeIndex, u8 file_type, StringView name);
+    static ErrorOr<bool> try_insert_into_block(Bytes block, StringView name, InodeIndex, u8 file_type);
+
+    u32 hash_name(StringView name) const { return hash_name(m_inode, name, m_hash_version); }
+
+    ErrorOr<void> read_block(u32 logical_block, ByteBuffer&) const;
+    ErrorOr<void> write_block(u32 logical_block, ReadonlyBytes);
+    ErrorOr<u32> append_block(ReadonlyBytes);
+
+    ErrorOr<Frame> read_frame(u32 logical_block, size_t entries_offset) const;
+    ErrorOr<Path> probe(u32 hash) const;
+    ErrorOr<bool> advance_to_next_leaf(Path&, u32 hash) const;
+    ErrorOr<Optional<EntryLocation>> find_entry(StringView name, ByteBuffer& block);
+
+    ErrorOr<void> make_room_in_index(Path&);
+    static void insert_index_entry(Frame&, size_t position, u32 hash, u32 logical_block);
+
+    Ext2FSInode& m_inode;
+    u8 m_hash_version { 0 };
+    u8 m_indirect_levels { 0 };
+    size_t m_root_entries_offset { 0 };
+};
+
+}
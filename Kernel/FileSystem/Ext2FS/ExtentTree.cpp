@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/API/POSIX/errno.h>
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/Ext2FS/ExtentTree.h>
+#include <Kernel/FileSystem/Ext2FS/FileSystem.h>
+#include <Kernel/FileSystem/Ext2FS/Inode.h>
+
+namespace Kernel {
+
+static u32 maximum_extent_length(bool is_unwritten)
+{
+    return is_unwritten ? EXT_UNINIT_MAX_LEN : EXT_INIT_MAX_LEN;
+}
+
+static bool can_merge(Ext2FSExtentTree::Extent const& first, Ext2FSExtentTree::Extent const& second)
+{
+    return first.end() == second.logical_block
+        && first.physical_block + first.length == second.physical_block
+        && first.is_unwritten == second.is_unwritten
+        && first.length + second.length <= maximum_extent_length(first.is_unwritten);
+}
+
+Ext2FSExtentTree::Ext2FSExtentTree(Ext2FSInode& inode)
+    : m_inode(inode)
+{
+}
+
+void Ext2FSExtentTree::initialize_empty_root(ext2_inode_large& raw_inode)
+{
+    memset(raw_inode.i_block, 0, sizeof(raw_inode.i_block));
+    auto& header = *reinterpret_cast<ext3_extent_header*>(raw_inode.i_block);
+    header.eh_magic = EXT3_EXT_MAGIC;
+    header.eh_entries = 0;
+    header.eh_max = root_capacity;
+    header.eh_depth = 0;
+    raw_inode.i_flags |= EXT4_EXTENTS_FL;
+}
+
+u16 Ext2FSExtentTree::block_capacity() const
+{
+    return (m_inode.fs().logical_block_size() - sizeof(ext3_extent_header)) / sizeof(ext3_extent);
+}
+
+ErrorOr<Vector<Ext2FSExtentTree::Extent>> Ext2FSExtentTree::entries_of(Node& node)
+{
+    auto const& header = node.header();
+    Vector<Extent> entries;
+    TRY(entries.try_ensure_capacity(header.eh_entries));
+
+    if (header.eh_depth == 0) {
+        auto const* extents = reinterpret_cast<ext3_extent const*>(node.buffer.data() + sizeof(ext3_extent_header));
+        for (size_t i = 0; i < header.eh_entries; ++i) {
+            auto const& extent = extents[i];
+            bool is_unwritten = extent.ee_len > EXT_INIT_MAX_LEN;
+            u32 length = is_unwritten ? extent.ee_len - EXT_INIT_MAX_LEN : extent.ee_len;
+            u64 physical_block = static_cast<u64>(extent.ee_start_hi) << 32 | extent.ee_start;
+            if (length == 0 || physical_block == 0 || (!entries.is_empty() && entries.last().end() > extent.ee_block))
+                return EIO;
+            entries.unchecked_append({ extent.ee_block, length, physical_block, is_unwritten });
+        }
+    } else {
+        auto const* indices = reinterpret_cast<ext3_extent_idx const*>(node.buffer.data() + sizeof(ext3_extent_header));
+        for (size_t i = 0; i < header.eh_entries; ++i) {
+            auto const& index = indices[i];
+            u64 physical_block = static_cast<u64>(index.ei_leaf_hi) << 32 | index.ei_leaf;
+            if (physical_block == 0 || (!entries.is_empty() && entries.last().logical_block >= index.ei_block))
+                return EIO;
+            entries.unchecked_append({ index.ei_block, 0, physical_block, false });
+        }
+    }
+    return entries;
+}
+
+void Ext2FSExtentTree::set_entries(Node& node, ReadonlySpan<Extent> entries)
+{
+    auto& header = node.header();
+    VERIFY(entries.size() <= header.eh_max);
+    header.eh_entries = entries.size();
+
+    auto* entries_start = node.buffer.data() + sizeof(ext3_extent_header);
+    memset(entries_start, 0, header.eh_max * sizeof(ext3_extent));
+
+    if (header.eh_depth == 0) {
+        auto* extents = reinterpret_cast<ext3_extent*>(entries_start);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto const& entry = entries[i];
+            VERIFY(entry.length > 0 && entry.length <= maximum_extent_length(entry.is_unwritten));
+            extents[i].ee_block = entry.logical_block;
+            extents[i].ee_len = entry.is_unwritten ? entry.length + EXT_INIT_MAX_LEN : entry.length;
+            extents[i].ee_start_hi = entry.physical_block >> 32;
+            extents[i].ee_start = entry.physical_block & 0xffffffff;
+        }
+    } else {
+        auto* indices = reinterpret_cast<ext3_extent_idx*>(entries_start);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            indices[i].ei_block = entries[i].logical_block;
+            indices[i].ei_leaf = entries[i].physical_block & 0xffffffff;
+            indices[i].ei_leaf_hi = entries[i].physical_block >> 32;
+        }
+    }
+}
+
+ErrorOr<Ext2FSExtentTree::Node> Ext2FSExtentTree::read_root() const
+{
+    Node root;
+    root.buffer = TRY(ByteBuffer::copy(m_inode.m_raw_inode.i_block, sizeof(m_inode.m_raw_inode.i_block)));
+
+    auto const& header = root.header();
+    if (header.eh_magic != EXT3_EXT_MAGIC || header.eh_max > root_capacity || header.eh_entries > header.eh_max || header.eh_depth > maximum_depth) {
+        dbgln("Ext2FSExtentTree: Corrupt extent tree root in inode {}", m_inode.identifier());
+        return EIO;
+    }
+    return root;
+}
+
+ErrorOr<Ext2FSExtentTree::Node> Ext2FSExtentTree::read_node(u64 physical_block, u16 expected_depth) const
+{
+    auto block_size = m_inode.fs().logical_block_size();
+    Node node;
+    node.physical_block = physical_block;
+    node.buffer = TRY(ByteBuffer::create_uninitialized(block_size));
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(node.buffer.data());
+    TRY(m_inode.fs().read_block(physical_block, &buffer, block_size));
+
+    // Interior nodes without any entries are never written, so those are just as broken as a bad header.
+    auto const& header = node.header();
+    if (header.eh_magic != EXT3_EXT_MAGIC || header.eh_max > block_capacity() || header.eh_entries > header.eh_max || header.eh_depth != expected_depth
+        || (header.eh_depth > 0 && header.eh_entries == 0)) {
+        dbgln("Ext2FSExtentTree: Corrupt extent tree node at block {} in inode {}", physical_block, m_inode.identifier());
+        return EIO;
+    }
+    return node;
+}
+
+ErrorOr<Ext2FSExtentTree::Node> Ext2FSExtentTree::create_node(u16 depth)
+{
+    Node node;
+    node.buffer = TRY(ByteBuffer::create_zeroed(m_inode.fs().logical_block_size()));
+    node.physical_block = TRY(m_inode.allocate_and_zero_block());
+    auto& header = node.header();
+    header.eh_magic = EXT3_EXT_MAGIC;
+    header.eh_max = block_capacity();
+    header.eh_depth = depth;
+    return node;
+}
+
+ErrorOr<void> Ext2FSExtentTree::write_node(Node& node)
+{
+    if (node.is_root()) {
+        memcpy(m_inode.m_raw_inode.i_block, node.buffer.data(), sizeof(m_inode.m_raw_inode.i_block));
+        m_inode.set_metadata_dirty(true);
+        return {};
+    }
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(node.buffer.data());
+    return m_inode.fs().write_metadata_block(node.physical_block, buffer, node.buffer.size());
+}
+
+ErrorOr<void> Ext2FSExtentTree::free_blocks(u64 first_physical_block, u32 count)
+{
+    for (u64 block = first_physical_block; block < first_physical_block + count; ++block) {
+        TRY(m_inode.fs().set_block_allocation_state(block, false));
+        m_inode.m_raw_inode.i_blocks -= m_inode.fs().i_blocks_increment();
+    }
+    m_inode.set_metadata_dirty(true);
+    return {};
+}
+
+ErrorOr<Ext2FSExtentTree::Path> Ext2FSExtentTree::find_path(u32 logical_block) const
+{
+    Path path;
+    TRY(path.try_append(TRY(read_root())));
+
+    while (path.last().depth() > 0) {
+        auto& node = path.last();
+        auto entries = TRY(entries_of(node));
+        if (entries.is_empty())
+            return EIO;
+
+        // Find the last entry that starts at or before our block. The first one also covers everything below it.
+        size_t low = 1;
+        size_t high = entries.size();
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (entries[middle].logical_block > logical_block)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        node.position = low - 1;
+
+        auto child = TRY(read_node(entries[node.position].physical_block, node.depth() - 1));
+        TRY(path.try_append(move(child)));
+    }
+    return path;
+}
+
+ErrorOr<void> Ext2FSExtentTree::update_parent_keys(Path& path, size_t level)
+{
+    // Index entries carry the first logical block of their subtree, which may have moved down with an insertion.
+    for (; level > 0; --level) {
+        auto& node = path[level];
+        if (node.header().eh_entries == 0)
+            return {};
+        auto first_logical_block = TRY(entries_of(node)).first().logical_block;
+
+        auto& parent = path[level - 1];
+        auto& index = reinterpret_cast<ext3_extent_idx*>(parent.buffer.data() + sizeof(ext3_extent_header))[parent.position];
+        if (index.ei_block == first_logical_block)
+            return {};
+        index.ei_block = first_logical_block;
+        TRY(write_node(parent));
+        if (parent.position != 0)
+            return {};
+    }
+    return {};
+}
+
+ErrorOr<void> Ext2FSExtentTree::store_entries(Path& path, size_t level, Vector<Extent>& entries)
+{
+    auto& node = path[level];
+    if (entries.size() <= node.header().eh_max) {
+        set_entries(node, entries);
+        TRY(write_node(node));
+        return update_parent_keys(path, level);
+    }
+
+    if (node.is_root()) {
+        // The root is full, so its contents move into a new block, and the tree grows by one level.
+        auto child = TRY(create_node(node.depth()));
+        dbgln_if(EXT2_DEBUG, "Ext2FSExtentTree: Growing extent tree of inode {} to depth {} (new node at block {})", m_inode.identifier(), node.depth() + 1, child.physical_block);
+
+        Extent root_entry { entries.first().logical_block, 0, child.physical_block, false };
+        child.position = node.position;
+        node.header().eh_depth += 1;
+        node.position = 0;
+        set_entries(node, { &root_entry, 1 });
+        TRY(write_node(node));
+
+        TRY(path.try_insert(level + 1, move(child)));
+        return store_entries(path, level + 1, entries);
+    }
+
+    // Otherwise, the upper half of the entries moves into a new sibling, which then needs an entry in the parent.
+    auto sibling = TRY(create_node(node.depth()));
+    size_t split = entries.size() / 2;
+    set_entries(sibling, entries.span().slice(split));
+    TRY(write_node(sibling));
+
+    Extent sibling_entry { entries[split].logical_block, 0, sibling.physical_block, false };
+    entries.shrink(split);
+    set_entries(node, entries);
+    TRY(write_node(node));
+    TRY(update_parent_keys(path, level));
+
+    auto& parent = path[level - 1];
+    auto parent_entries = TRY(entries_of(parent));
+    TRY(parent_entries.try_insert(parent.position + 1, sibling_entry));
+    return store_entries(path, level - 1, parent_entries);
+}
+
+ErrorOr<bool> Ext2FSExtentTree::map_block_in_list(Vector<Extent>& extents, u32 logical_block, u64 physical_block)
+{
+    VERIFY(physical_block != 0);
+
+    // Find the first extent that ends after our block.
+    size_t index = 0;
+    size_t high = extents.size();
+    while (index < high) {
+        size_t middle = (index + high) / 2;
+        if (extents[middle].end() <= logical_block)
+            index = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (index < extents.size() && extents[index].contains(logical_block)) {
+        auto existing = extents[index];
+        u32 offset = logical_block - existing.logical_block;
+        if (!existing.is_unwritten && existing.physical_block + offset == physical_block)
+            return false;
+
+        // Cut our block out of the existing extent, keeping whatever is left of it on either side.
+        extents.remove(index);
+        if (offset + 1 < existing.length)
+            TRY(extents.try_insert(index, { logical_block + 1, existing.length - offset - 1, existing.physical_block + offset + 1, existing.is_unwritten }));
+        if (offset > 0) {
+            TRY(extents.try_insert(index, { existing.logical_block, offset, existing.physical_block, existing.is_unwritten }));
+            ++index;
+        }
+    }
+
+    TRY(extents.try_insert(index, { logical_block, 1, physical_block, false }));
+
+    if (index + 1 < extents.size() && can_merge(extents[index], extents[index + 1])) {
+        extents[index].length += extents[index + 1].length;
+        extents.remove(index + 1);
+    }
+    if (index > 0 && can_merge(extents[index - 1], extents[index])) {
+        extents[index - 1].length += extents[index].length;
+        extents.remove(index);
+    }
+    return true;
+}
+
+ErrorOr<void> Ext2FSExtentTree::map_block(u32 logical_block, u64 physical_block)
+{
+    VERIFY(m_inode.m_inode_lock.is_locked());
+    auto path = TRY(find_path(logical_block));
+    auto extents = TRY(entries_of(path.last()));
+    if (!TRY(map_block_in_list(extents, logical_block, physical_block)))
+        return {};
+    return store_entries(path, path.size() - 1, extents);
+}
+
+ErrorOr<void> Ext2FSExtentTree::collect_extents_in_node(Node& node, u32 first_block, u32 last_block, Vector<Extent>& extents) const
+{
+    auto entries = TRY(entries_of(node));
+
+    if (node.depth() == 0) {
+        for (auto const& extent : entries) {
+            if (extent.logical_block > last_block)
+                break;
+            if (extent.end() > first_block)
+                TRY(extents.try_append(extent));
+        }
+        return {};
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        // Every child covers the blocks up to where the next one starts.
+        if (i + 1 < entries.size() && entries[i + 1].logical_block <= first_block)
+            continue;
+        if (i > 0 && entries[i].logical_block > last_block)
+            break;
+        auto child = TRY(read_node(entries[i].physical_block, node.depth() - 1));
+        TRY(collect_extents_in_node(child, first_block, last_block, extents));
+    }
+    return {};
+}
+
+ErrorOr<Vector<Ext2FSExtentTree::Extent>> Ext2FSExtentTree::collect_extents(u32 first_block, u32 last_block) const
+{
+    VERIFY(m_inode.m_inode_lock.is_locked());
+    Vector<Extent> extents;
+    auto root = TRY(read_root());
+    TRY(collect_extents_in_node(root, first_block, last_block, extents));
+    return extents;
+}
+
+ErrorOr<bool> Ext2FSExtentTree::truncate_node(Node& node, u32 first_block_to_remove)
+{
+    auto entries = TRY(entries_of(node));
+    bool was_modified = false;
+
+    if (node.depth() == 0) {
+        while (!entries.is_empty()) {
+            auto& extent = entries.last();
+            if (extent.end() <= first_block_to_remove)
+                break;
+            u32 blocks_to_keep = extent.logical_block >= first_block_to_remove ? 0 : first_block_to_remove - extent.logical_block;
+            TRY(free_blocks(extent.physical_block + blocks_to_keep, extent.length - blocks_to_keep));
+            was_modified = true;
+            if (blocks_to_keep > 0) {
+                extent.length = blocks_to_keep;
+                break;
+            }
+            entries.take_last();
+        }
+    } else {
+        while (!entries.is_empty()) {
+            auto const& entry = entries.last();
+            auto child = TRY(read_node(entry.physical_block, node.depth() - 1));
+            if (!TRY(truncate_node(child, first_block_to_remove)))
+                break;
+            TRY(free_blocks(entry.physical_block, 1));
+            entries.take_last();
+            was_modified = true;
+        }
+    }
+
+    if (was_modified && !entries.is_empty()) {
+        set_entries(node, entries);
+        TRY(write_node(node));
+    }
+    return entries.is_empty();
+}
+
+ErrorOr<void> Ext2FSExtentTree::truncate(u32 first_block_to_remove)
+{
+    VERIFY(m_inode.m_inode_lock.is_locked());
+    auto root = TRY(read_root());
+    if (!TRY(truncate_node(root, first_block_to_remove)))
+        return {};
+
+    // Nothing is left, so we're back to an empty root leaf.
+    root.header().eh_depth = 0;
+    root.header().eh_max = root_capacity;
+    set_entries(root, {});
+    return write_node(root);
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/Error.h>
+#include <AK/Span.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/Ext2FS/Definitions.h>
+
+namespace Kernel {
+
+class Ext2FSInode;
+
+// The extent tree of inodes with EXT4_EXTENTS_FL.
+//
+// Instead of a pointer for every block, the blocks of such an inode are described by extents, i.e. runs of
+// logical blocks that are backed by physically contiguous blocks. The root of the tree lives in the i_block
+// array of the inode and has room for four entries. Once that isn't enough, its contents are pushed down
+// into a block of their own, and the root turns into an index node that points to it.
+class Ext2FSExtentTree {
+public:
+    struct Extent {
+        u32 logical_block { 0 };
+        u32 length { 0 };
+        u64 physical_block { 0 };
+
+        // Unwritten extents have their blocks allocated already, but read back as zeroes.
+        bool is_unwritten { false };
+
+        u64 end() const { return static_cast<u64>(logical_block) + length; }
+        bool contains(u64 block) const { return block >= logical_block && block < end(); }
+    };
+
+    explicit Ext2FSExtentTree(Ext2FSInode&);
+
+    static void initialize_empty_root(ext2_inode_large&);
+
+    // Returns all extents that overlap the given range of logical blocks, sorted by their first logical block.
+    ErrorOr<Vector<Extent>> collect_extents(u32 first_block, u32 last_block) const;
+
+    // Maps a single logical block to the given physical block. Neighboring extents are merged where possible.
+    // If the logical block was part of an unwritten extent, it is turned into written data.
+    ErrorOr<void> map_block(u32 logical_block, u64 physical_block);
+
+    // Frees all data blocks from the given logical block onwards, as well as tree nodes that end up empty.
+    ErrorOr<void> truncate(u32 first_block_to_remove);
+
+    // Applies the same change as map_block() to a sorted list of extents. Returns whether the list changed.
+    static ErrorOr<bool> map_block_in_list(Vector<Extent>&, u32 logical_block, u64 physical_block);
+
+private:
+    // The same limit as everyone else uses, which keeps us from recursing forever on corrupted trees.
+    static constexpr u16 maximum_depth = 5;
+
+    // A node of the tree, along with the position of the entry that we descended through.
+    // Interior nodes also use Extent for their entries, only leaving the length and is_unwritten unused.
+    struct Node {
+        u64 physical_block { 0 };
+        ByteBuffer buffer;
+        size_t position { 0 };
+
+        bool is_root() const { return physical_block == 0; }
+        ext3_extent_header& header() { return *reinterpret_cast<ext3_extent_header*>(buffer.data()); }
+        u16 depth() { return header().eh_depth; }
+    };
+
+    using Path = Vector<Node, maximum_depth + 1>;
+
+    static constexpr u16 root_capacity = (sizeof(ext2_inode::i_block) - sizeof(ext3_extent_header)) / sizeof(ext3_extent);
+    u16 block_capacity() const;
+
+    static ErrorOr<Vector<Extent>> entries_of(Node&);
+    static void set_entries(Node&, ReadonlySpan<Extent>);
+
+    ErrorOr<Node> read_root() const;
+    ErrorOr<Node> read_node(u64 physical_block, u16 expected_depth) const;
+    ErrorOr<Node> create_node(u16 depth);
+    ErrorOr<void> write_node(Node&);
+    ErrorOr<void> free_blocks(u64 first_physical_block, u32 count);
+
+    ErrorOr<Path> find_path(u32 logical_block) const;
+    ErrorOr<void> store_entries(Path&, size_t level, Vector<Extent>& entries);
+    ErrorOr<void> update_parent_keys(Path&, size_t level);
+
+    ErrorOr<void> collect_extents_in_node(Node&, u32 first_block, u32 last_block, Vector<Extent>&) const;
+    ErrorOr<bool> truncate_node(Node&, u32 first_block_to_remove);
+
+    Ext2FSInode& m_inode;
+};
+
+}
@@ -9,18 +9,19 @@
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/Ext2FS/FileSystem.h>
 #include <Kernel/FileSystem/Ext2FS/Inode.h>
+#include <Kernel/FileSystem/Ext2FS/Journal.h>
 #include <Kernel/Tasks/Process.h>
 #include <Kernel/UnixTypes.h>
 
 namespace Kernel {
 
-ErrorOr<NonnullRefPtr<FileSystem>> Ext2FS::try_create(OpenFileDescription& file_description, FileSystemSpecificOptions const&)
+ErrorOr<NonnullRefPtr<FileSystem>> Ext2FS::try_create(OpenFileDescription& file_description, FileSystemSpecificOptions const& filesystem_specific_options)
 {
-    return TRY(adopt_nonnull_ref_or_enomem(new (nothrow) Ext2FS(file_description)));
+    return TRY(adopt_nonnull_ref_or_enomem(new (nothrow) Ext2FS(file_description, filesystem_specific_options)));
 }
 
-Ext2FS::Ext2FS(OpenFileDescription& file_description)
-    : BlockBasedFileSystem(file_description)
+Ext2FS::Ext2FS(OpenFileDescription& file_description, FileSystemSpecificOptions const& filesystem_specific_options)
+    : BlockBasedFileSystem(file_description, filesystem_specific_options)
 {
 }
 
@@ -28,6 +29,7 @@ Ext2FS::~Ext2FS() = default;
 
 ErrorOr<void> Ext2FS::rename(Inode& old_parent_inode, StringView old_basename, Inode& new_parent_inode, StringView new_basename)
 {
+    Ext2FSJournalHandle handle { *this };
     MutexLocker locker(m_lock);
 
     if (auto maybe_inode_to_be_replaced = new_parent_inode.lookup(new_basename); !maybe_inode_to_be_replaced.is_error()) {
@@ -195,16 +197,80 @@ ErrorOr<void> Ext2FS::initialize_while_locked()
         }
     }
 
-    m_root_inode = TRY(build_root_inode());
+    if (has_flag(get_features_optional(), FeaturesOptional::HasJournal))
+        TRY(load_journal());
+
+    m_root_inode = TRY(build_inode(EXT2_ROOT_INO));
 
     // Set filesystem to "error" state until we unmount cleanly.
     dmesgln("Ext2FS: Mount successful, setting superblock to error state.");
     m_super_block.s_state = EXT2_ERROR_FS;
+    // Until then, the journal may have to be replayed as well.
+    if (m_journal)
+        m_super_block.s_feature_incompat |= EXT3_FEATURE_INCOMPAT_RECOVER;
     TRY(flush_super_block());
 
     return {};
 }
 
+ErrorOr<void> Ext2FS::load_journal()
+{
+    VERIFY(m_lock.is_locked());
+
+    bool needs_recovery = has_flag(get_features_incompatible(), FeaturesIncompatible::NeedsRecovery);
+    auto journal_or_error = [&]() -> ErrorOr<NonnullOwnPtr<Ext2FSJournal>> {
+        if (has_flag(get_features_incompatible(), FeaturesIncompatible::JournalDevice) || m_super_block.s_journal_inum == 0 || m_super_block.s_journal_dev != 0) {
+            dmesgln("Ext2FS: External journals are not supported");
+            return ENOTSUP;
+        }
+
+        auto journal_inode = TRY(build_inode(m_super_block.s_journal_inum));
+        auto block_count = journal_inode->size() / logical_block_size();
+        Vector<BlockIndex> block_map;
+        TRY(block_map.try_ensure_capacity(block_count));
+        for (u64 i = 0; i < block_count; ++i) {
+            auto block = TRY(journal_inode->m_block_view.get_block(i));
+            if (block == 0) {
+                dmesgln("Ext2FS: Journal inode has a hole at block {}", i);
+                return EINVAL;
+            }
+            block_map.unchecked_append(block);
+        }
+        return Ext2FSJournal::try_create(*this, move(block_map));
+    }();
+
+    if (journal_or_error.is_error()) {
+        // Without replaying the log, the file system is in no shape to be used.
+        if (needs_recovery)
+            return journal_or_error.release_error();
+        dmesgln("Ext2FS: Can't use the journal ({}), continuing without journaling", journal_or_error.error());
+        return {};
+    }
+
+    auto journal = journal_or_error.release_value();
+    if (journal->needs_recovery()) {
+        dmesgln("Ext2FS: Recovering from the journal");
+        TRY(journal->recover());
+
+        // The block group descriptors we read earlier may have been outdated.
+        auto blocks_to_read = ceil_div(m_block_group_count * sizeof(ext2_group_desc), logical_block_size());
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(m_cached_group_descriptor_table->data());
+        TRY(read_blocks(first_block_of_block_group_descriptors(), blocks_to_read, buffer));
+    }
+    m_journal = move(journal);
+
+    // The counters in the superblock aren't journaled, so we bring them up to date with the block groups.
+    u32 free_blocks_count = 0;
+    u32 free_inodes_count = 0;
+    for (unsigned i = 1; i <= m_block_group_count; ++i) {
+        free_blocks_count += group_descriptor(i).bg_free_blocks_count;
+        free_inodes_count += group_descriptor(i).bg_free_inodes_count;
+    }
+    m_super_block.s_free_blocks_count = free_blocks_count;
+    m_super_block.s_free_inodes_count = free_inodes_count;
+    return {};
+}
+
 Inode& Ext2FS::root_inode()
 {
     return *m_root_inode;
@@ -214,7 +280,8 @@ bool Ext2FS::find_block_containing_inode(InodeIndex inode, BlockIndex& block_ind
 {
     auto const& super_block = this->super_block();
 
-    if (inode != EXT2_ROOT_INO && inode < EXT2_FIRST_INO(&super_block))
+    bool is_journal_inode = has_flag(get_features_optional(), FeaturesOptional::HasJournal) && inode == super_block.s_journal_inum;
+    if (inode != EXT2_ROOT_INO && !is_journal_inode && inode < EXT2_FIRST_INO(&super_block))
         return false;
 
     if (inode > super_block.s_inodes_count)
@@ -265,6 +332,13 @@ Ext2FS::FeaturesReadOnly Ext2FS::get_features_readonly() const
     return Ext2FS::FeaturesReadOnly::None;
 }
 
+Ext2FS::FeaturesIncompatible Ext2FS::get_features_incompatible() const
+{
+    if (m_super_block.s_rev_level > 0)
+        return static_cast<Ext2FS::FeaturesIncompatible>(m_super_block.s_feature_incompat);
+    return Ext2FS::FeaturesIncompatible::None;
+}
+
 u64 Ext2FS::inodes_per_block() const
 {
     return EXT2_INODES_PER_BLOCK(&super_block());
@@ -301,12 +375,19 @@ ErrorOr<void> Ext2FS::write_ext2_inode(InodeIndex inode, ext2_inode_large const&
     memcpy(inode_storage.data(), &e2inode, min(used_inode_size, sizeof(ext2_inode_large)));
 
     auto buffer = UserOrKernelBuffer::for_kernel_buffer(inode_storage.data());
-    return write_block(block_index, buffer, inode_size(), offset);
+    return write_metadata_block(block_index, buffer, inode_size(), offset);
+}
+
+ErrorOr<void> Ext2FS::write_metadata_block(BlockIndex block_index, UserOrKernelBuffer const& data, size_t count, u64 offset)
+{
+    if (m_journal)
+        return m_journal->journal_block(block_index, data, count, offset);
+    return write_block(block_index, data, count, offset);
 }
 
-auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) -> ErrorOr<Vector<BlockIndex>>
+auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count, BlockIndex goal, UseReservedBlocks use_reserved_blocks) -> ErrorOr<Vector<BlockIndex>>
 {
-    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks(preferred group: {}, count {})", preferred_group_index, count);
+    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks(preferred group: {}, count {}, goal {})", preferred_group_index, count, goal);
     if (count == 0)
         return Vector<BlockIndex> {};
 
@@ -315,16 +396,26 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
 
     MutexLocker locker(m_lock);
 
+    // Blocks that have been promised to delayed allocations are off-limits, unless we're allocating them right now.
+    size_t blocks_needed = count;
+    if (use_reserved_blocks == UseReservedBlocks::Yes)
+        VERIFY(m_reserved_block_count >= count);
+    else
+        blocks_needed += m_reserved_block_count;
+
     size_t free_blocks = 0;
     for (GroupIndex i = 1; i <= m_block_group_count; i = GroupIndex { i.value() + 1 }) {
         free_blocks += group_descriptor(i).bg_free_blocks_count;
-        if (free_blocks >= count)
+        if (free_blocks >= blocks_needed)
             break;
     }
 
-    if (free_blocks < count)
+    if (free_blocks < blocks_needed)
         return Error::from_errno(ENOSPC);
 
+    if (goal < first_block_index() || goal >= super_block().s_blocks_count)
+        goal = 0;
+
     auto group_index = preferred_group_index;
 
     if (!group_descriptor(preferred_group_index).bg_free_blocks_count) {
@@ -332,6 +423,15 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
     }
 
     while (blocks.size() < count) {
+        auto remaining_count = count - blocks.size();
+
+        // Try to continue right where the goal points, so that the new blocks extend an existing run.
+        Optional<size_t> goal_bit_index;
+        if (goal != 0 && group_descriptor(group_index_from_block_index(goal)).bg_free_blocks_count) {
+            group_index = group_index_from_block_index(goal);
+            goal_bit_index = goal.value() - first_block_of_group(group_index).value();
+        }
+
         bool found_a_group = false;
         if (group_descriptor(group_index).bg_free_blocks_count) {
             found_a_group = true;
@@ -356,7 +456,20 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
 
         BlockIndex first_block_in_group = first_block_of_group(group_index);
         size_t free_region_size = 0;
-        auto first_unset_bit_index = block_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
+        Optional<size_t> first_unset_bit_index;
+        if (goal_bit_index.has_value() && goal_bit_index.value() < block_bitmap.size()) {
+            // Take whatever is free at the goal itself, otherwise the first region behind it that fits everything.
+            size_t start = goal_bit_index.value();
+            auto length = block_bitmap.get(start)
+                ? block_bitmap.find_next_range_of_unset_bits(start, remaining_count, remaining_count)
+                : block_bitmap.find_next_range_of_unset_bits(start, 1, remaining_count);
+            if (length.has_value()) {
+                first_unset_bit_index = start;
+                free_region_size = length.value();
+            }
+        }
+        if (!first_unset_bit_index.has_value())
+            first_unset_bit_index = block_bitmap.find_longest_range_of_unset_bits(remaining_count, free_region_size);
         VERIFY(first_unset_bit_index.has_value());
         dbgln_if(EXT2_DEBUG, "Ext2FS: allocating free region of size: {} [{}]", free_region_size, group_index);
         for (size_t i = 0; i < free_region_size; ++i) {
@@ -365,12 +478,42 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
             blocks.unchecked_append(block_index);
             dbgln_if(EXT2_DEBUG, "  allocated > {}", block_index);
         }
+
+        // Whatever is still missing should follow the region we just took.
+        goal = blocks.last().value() + 1;
+        if (goal >= super_block().s_blocks_count)
+            goal = 0;
     }
 
+    if (use_reserved_blocks == UseReservedBlocks::Yes)
+        m_reserved_block_count -= count;
+
     VERIFY(blocks.size() == count);
     return blocks;
 }
 
+ErrorOr<void> Ext2FS::reserve_blocks(size_t count)
+{
+    MutexLocker locker(m_lock);
+    if (super_block().s_free_blocks_count < m_reserved_block_count + count)
+        return ENOSPC;
+    m_reserved_block_count += count;
+    return {};
+}
+
+void Ext2FS::release_reserved_blocks(size_t count)
+{
+    MutexLocker locker(m_lock);
+    VERIFY(m_reserved_block_count >= count);
+    m_reserved_block_count -= count;
+}
+
+size_t Ext2FS::reserved_block_count() const
+{
+    MutexLocker locker(m_lock);
+    return m_reserved_block_count;
+}
+
 ErrorOr<InodeIndex> Ext2FS::allocate_inode(GroupIndex preferred_group)
 {
     dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_inode(preferred_group: {})", preferred_group);
@@ -530,6 +673,17 @@ ErrorOr<void> Ext2FS::set_block_allocation_state(BlockIndex block_index, bool ne
     VERIFY(block_index != 0);
     MutexLocker locker(m_lock);
 
+    if (!new_state && m_journal) {
+        TRY(m_journal->did_free_block(block_index));
+        return m_blocks_freed_in_transaction.try_append(block_index);
+    }
+    return update_block_allocation_state(block_index, new_state);
+}
+
+ErrorOr<void> Ext2FS::update_block_allocation_state(BlockIndex block_index, bool new_state)
+{
+    VERIFY(m_lock.is_locked());
+
     auto group_index = group_index_from_block_index(block_index);
     unsigned index_in_group = (block_index.value() - first_block_index().value()) - ((group_index.value() - 1) * blocks_per_group());
     unsigned bit_index = index_in_group % blocks_per_group();
@@ -594,6 +748,10 @@ ErrorOr<NonnullRefPtr<Inode>> Ext2FS::create_inode(Ext2FSInode& parent_inode, St
     e2inode.i_dtime = 0;
     e2inode.i_flags = 0;
 
+    // Device numbers and the targets of short symlinks live in i_block, so only regular files and directories get an extent tree.
+    if (has_flag(get_features_incompatible(), FeaturesIncompatible::Extents) && (is_regular_file(mode) || is_directory(mode)))
+        Ext2FSExtentTree::initialize_empty_root(e2inode);
+
     if (inode_size() > EXT2_GOOD_OLD_INODE_SIZE)
         e2inode.i_extra_isize = min(inode_size(), sizeof(ext2_inode_large)) - EXT2_GOOD_OLD_INODE_SIZE;
 
@@ -632,7 +790,7 @@ unsigned Ext2FS::total_block_count() const
 unsigned Ext2FS::free_block_count() const
 {
     MutexLocker locker(m_lock);
-    return super_block().s_free_blocks_count;
+    return super_block().s_free_blocks_count - m_reserved_block_count;
 }
 
 unsigned Ext2FS::total_inode_count() const
@@ -649,30 +807,44 @@ unsigned Ext2FS::free_inode_count() const
 
 ErrorOr<void> Ext2FS::prepare_to_clear_last_mount(Inode& mount_guest_inode)
 {
-    MutexLocker locker(m_lock);
-    bool any_inode_busy = false;
-    for (auto& it : m_inode_cache) {
-        // We hold the last reference to the root inode, and the VFS Mount object holds the last reference to the mount_guest_inode,
-        // so they are allowed to have one more reference.
-        if ((it.value == m_root_inode || it.value->identifier() == mount_guest_inode.identifier()) && it.value->ref_count() > 2) {
-            dbgln_if(EXT2_DEBUG, "Ext2FS: Ignoring root or mount point inode's last reference");
-            continue;
-        }
-        // The Inode::all_instances list always holds one reference to all inodes, which we disregard.
-        if (it.value->ref_count() > 1) {
-            dbgln_if(EXT2_DEBUG, "Ext2FS: Busy inode {} ({} refs)", it.value->index(), it.value->ref_count());
-            any_inode_busy = true;
+    // Inodes with delayed blocks are kept alive until those are allocated, which would make them look busy.
+    TRY(flush_delayed_blocks());
+
+    {
+        Ext2FSJournalHandle handle { *this };
+        MutexLocker locker(m_lock);
+        bool any_inode_busy = false;
+        for (auto& it : m_inode_cache) {
+            // We hold the last reference to the root inode, and the VFS Mount object holds the last reference to the mount_guest_inode,
+            // so they are allowed to have one more reference.
+            if ((it.value == m_root_inode || it.value->identifier() == mount_guest_inode.identifier()) && it.value->ref_count() > 2) {
+                dbgln_if(EXT2_DEBUG, "Ext2FS: Ignoring root or mount point inode's last reference");
+                continue;
+            }
+            // The Inode::all_instances list always holds one reference to all inodes, which we disregard.
+            if (it.value->ref_count() > 1) {
+                dbgln_if(EXT2_DEBUG, "Ext2FS: Busy inode {} ({} refs)", it.value->index(), it.value->ref_count());
+                any_inode_busy = true;
+            }
         }
+        if (any_inode_busy)
+            return EBUSY;
+
+        m_inode_cache.clear();
+        m_root_inode = nullptr;
     }
-    if (any_inode_busy)
-        return EBUSY;
 
-    m_inode_cache.clear();
-    m_root_inode = nullptr;
+    if (m_journal) {
+        // Everything has to be back home before we can leave the log empty for good.
+        TRY(flush_metadata_to_disk_cache());
+        TRY(m_journal->checkpoint());
+    }
 
+    MutexLocker locker(m_lock);
     // Mark filesystem as valid before unmount.
     dmesgln("Ext2FS: Clean unmount, setting superblock to valid state");
     m_super_block.s_state = EXT2_VALID_FS;
+    m_super_block.s_feature_incompat &= ~EXT3_FEATURE_INCOMPAT_RECOVER;
     TRY(flush_super_block());
 
     return {};
@@ -716,7 +888,12 @@ void Ext2FS::flush_block_group_descriptor_table()
             dbgln("Ext2FS[{}]::flush_block_group_descriptor_table(): Failed to write blocks: {}", fsid(), result.error());
     };
 
-    write_bgdt_to_block(first_block_of_bgdt);
+    // Only the primary copy is journaled, the backups are merely there for fsck to fall back on.
+    for (size_t i = 0; i < blocks_to_write; ++i) {
+        auto block_buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)block_group_descriptors() + i * logical_block_size());
+        if (auto result = write_metadata_block(first_block_of_bgdt.value() + i, block_buffer, logical_block_size()); result.is_error())
+            dbgln("Ext2FS[{}]::flush_block_group_descriptor_table(): Failed to write blocks: {}", fsid(), result.error());
+    }
 
     auto is_sparse = has_flag(get_features_readonly(), FeaturesReadOnly::SparseSuperblock);
 
@@ -731,32 +908,47 @@ void Ext2FS::flush_block_group_descriptor_table()
     }
 }
 
-ErrorOr<void> Ext2FS::flush_writes()
+ErrorOr<void> Ext2FS::flush_delayed_blocks()
 {
+    Vector<NonnullRefPtr<Ext2FSInode>> inodes;
     {
+        MutexLocker locker(m_lock);
+        TRY(inodes.try_ensure_capacity(m_inodes_with_delayed_blocks.size()));
+        for (auto& it : m_inodes_with_delayed_blocks)
+            inodes.unchecked_append(it.value);
+    }
+
+    // NOTE: Inodes take the filesystem lock while holding their own, so we must not hold it here.
+    for (auto& inode : inodes) {
+        Ext2FSJournalHandle handle { *this };
+        MutexLocker inode_locker(inode->m_inode_lock);
+        // The data stays around if this fails, so we can try again with the next flush.
+        if (auto result = inode->flush_delayed_blocks(); result.is_error()) {
+            dbgln("Ext2FS[{}]::flush_delayed_blocks(): Failed to flush inode {}: {}", fsid(), inode->index(), result.error());
+            continue;
+        }
+        // The allocations changed the block pointers, which have to hit the disk along with the data.
+        TRY(inode->flush_metadata());
+    }
+    return {};
+}
+
+ErrorOr<void> Ext2FS::flush_metadata_to_disk_cache()
+{
+    TRY(flush_delayed_blocks());
+
+    {
+        Ext2FSJournalHandle handle { *this };
         MutexLocker locker(m_lock);
         if (m_super_block_dirty) {
             auto result = flush_super_block();
             if (result.is_error()) {
-                dbgln("Ext2FS[{}]::flush_writes(): Failed to write superblock: {}", fsid(), result.error());
+                dbgln("Ext2FS[{}]::flush_metadata_to_disk_cache(): Failed to write superblock: {}", fsid(), result.error());
                 return result.release_error();
             }
             m_super_block_dirty = false;
         }
-        if (m_block_group_descriptors_dirty) {
-            flush_block_group_descriptor_table();
-            m_block_group_descriptors_dirty = false;
-        }
-        for (auto& cached_bitmap : m_cached_bitmaps) {
-            if (cached_bitmap->dirty) {
-                auto buffer = UserOrKernelBuffer::for_kernel_buffer(cached_bitmap->buffer->data());
-                if (auto result = write_block(cached_bitmap->bitmap_block_index, buffer, logical_block_size()); result.is_error()) {
-                    dbgln("Ext2FS[{}]::flush_writes(): Failed to write blocks: {}", fsid(), result.error());
-                }
-                cached_bitmap->dirty = false;
-                dbgln_if(EXT2_DEBUG, "Ext2FS[{}]::flush_writes(): Flushed bitmap block {}", fsid(), cached_bitmap->bitmap_block_index);
-            }
-        }
+        flush_allocation_metadata();
 
         // Uncache Inodes that are only kept alive by the index-to-inode lookup cache.
         // We don't uncache Inodes that are being watched by at least one InodeWatcher.
@@ -776,6 +968,63 @@ ErrorOr<void> Ext2FS::flush_writes()
         });
     }
 
+    return {};
+}
+
+void Ext2FS::flush_allocation_metadata()
+{
+    VERIFY(m_lock.is_locked());
+    if (m_block_group_descriptors_dirty) {
+        flush_block_group_descriptor_table();
+        m_block_group_descriptors_dirty = false;
+    }
+    for (auto& cached_bitmap : m_cached_bitmaps) {
+        if (cached_bitmap->dirty) {
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(cached_bitmap->buffer->data());
+            if (auto result = write_metadata_block(cached_bitmap->bitmap_block_index, buffer, logical_block_size()); result.is_error()) {
+                dbgln("Ext2FS[{}]::flush_allocation_metadata(): Failed to write blocks: {}", fsid(), result.error());
+            }
+            cached_bitmap->dirty = false;
+            dbgln_if(EXT2_DEBUG, "Ext2FS[{}]::flush_allocation_metadata(): Flushed bitmap block {}", fsid(), cached_bitmap->bitmap_block_index);
+        }
+    }
+}
+
+ErrorOr<void> Ext2FS::flush_metadata_for_commit()
+{
+    MutexLocker locker(m_lock);
+
+    // Nothing can be using the blocks that were freed in this transaction anymore once it's committed.
+    for (auto block_index : m_blocks_freed_in_transaction) {
+        if (auto result = update_block_allocation_state(block_index, false); result.is_error())
+            dbgln("Ext2FS[{}]::flush_metadata_for_commit(): Failed to free block {}: {}", fsid(), block_index, result.error());
+    }
+    m_blocks_freed_in_transaction.clear();
+
+    // NOTE: We can't take the inode locks here, as whoever holds them may be waiting for the commit to finish.
+    //       No handles are running though, so nobody is in the middle of changing an inode either.
+    auto write_inode_if_dirty = [&](Ext2FSInode& inode) -> ErrorOr<void> {
+        if (!inode.is_metadata_dirty())
+            return {};
+        return write_ext2_inode(inode.index(), inode.m_raw_inode);
+    };
+    if (m_root_inode)
+        TRY(write_inode_if_dirty(*m_root_inode));
+    for (auto& it : m_inode_cache) {
+        if (it.value)
+            TRY(write_inode_if_dirty(*it.value));
+    }
+
+    flush_allocation_metadata();
+    return {};
+}
+
+ErrorOr<void> Ext2FS::flush_writes()
+{
+    TRY(flush_metadata_to_disk_cache());
+    if (m_journal)
+        TRY(m_journal->commit());
+
     auto result = BlockBasedFileSystem::flush_writes();
     if (result.is_error()) {
         dbgln("Ext2FS[{}]::flush_writes(): Failed to flush writes: {}", BlockBasedFileSystem::fsid(), result.error());
@@ -785,15 +1034,23 @@ ErrorOr<void> Ext2FS::flush_writes()
     return {};
 }
 
-ErrorOr<NonnullRefPtr<Ext2FSInode>> Ext2FS::build_root_inode() const
+ErrorOr<void> Ext2FS::write_back_dirty_data()
+{
+    TRY(flush_metadata_to_disk_cache());
+    if (m_journal && m_journal->should_commit())
+        TRY(m_journal->commit());
+    return BlockBasedFileSystem::write_back_dirty_data();
+}
+
+ErrorOr<NonnullRefPtr<Ext2FSInode>> Ext2FS::build_inode(InodeIndex index) const
 {
     MutexLocker locker(m_lock);
     BlockIndex block_index;
     unsigned offset;
-    if (!find_block_containing_inode(EXT2_ROOT_INO, block_index, offset))
+    if (!find_block_containing_inode(index, block_index, offset))
         return EINVAL;
 
-    auto inode = TRY(adopt_nonnull_ref_or_enomem(new (nothrow) Ext2FSInode(const_cast<Ext2FS&>(*this), EXT2_ROOT_INO)));
+    auto inode = TRY(adopt_nonnull_ref_or_enomem(new (nothrow) Ext2FSInode(const_cast<Ext2FS&>(*this), index)));
 
     auto buffer = UserOrKernelBuffer::for_kernel_buffer(reinterpret_cast<u8*>(&inode->m_raw_inode));
 
@@ -18,15 +18,22 @@
 namespace Kernel {
 
 class Ext2FSInode;
+class Ext2FSJournal;
 
 class Ext2FS final : public BlockBasedFileSystem {
     friend class Ext2FSInode;
+    friend class Ext2FSDirectoryIndex;
+    friend class Ext2FSExtentTree;
+    friend class Ext2FSJournal;
+    friend class Ext2FSJournalHandle;
 
 public:
     // s_feature_compat
     enum class FeaturesOptional : u32 {
         None = 0,
+        HasJournal = EXT3_FEATURE_COMPAT_HAS_JOURNAL,
         ExtendedAttributes = EXT2_FEATURE_COMPAT_EXT_ATTR,
+        DirectoryIndex = EXT2_FEATURE_COMPAT_DIR_INDEX,
     };
     AK_ENUM_BITWISE_FRIEND_OPERATORS(FeaturesOptional);
 
@@ -38,6 +45,15 @@ public:
     };
     AK_ENUM_BITWISE_FRIEND_OPERATORS(FeaturesReadOnly);
 
+    // s_feature_incompat
+    enum class FeaturesIncompatible : u32 {
+        None = 0,
+        NeedsRecovery = EXT3_FEATURE_INCOMPAT_RECOVER,
+        JournalDevice = EXT3_FEATURE_INCOMPAT_JOURNAL_DEV,
+        Extents = EXT3_FEATURE_INCOMPAT_EXTENTS,
+    };
+    AK_ENUM_BITWISE_FRIEND_OPERATORS(FeaturesIncompatible);
+
     static ErrorOr<NonnullRefPtr<FileSystem>> try_create(OpenFileDescription&, FileSystemSpecificOptions const&);
 
     virtual ~Ext2FS() override;
@@ -56,8 +72,9 @@ public:
 
     FeaturesOptional get_features_optional() const;
     FeaturesReadOnly get_features_readonly() const;
+    FeaturesIncompatible get_features_incompatible() const;
 
-    u32 i_blocks_increment() { return m_i_blocks_increment; }
+    u32 i_blocks_increment() const { return m_i_blocks_increment; }
 
     virtual StringView class_name() const override { return "Ext2FS"sv; }
     virtual Inode& root_inode() override;
@@ -67,7 +84,7 @@ public:
 private:
     AK_TYPEDEF_DISTINCT_ORDERED_ID(unsigned, GroupIndex);
 
-    explicit Ext2FS(OpenFileDescription&);
+    Ext2FS(OpenFileDescription&, FileSystemSpecificOptions const&);
 
     ext2_super_block const& super_block() const { return m_super_block; }
     ext2_group_desc const& group_descriptor(GroupIndex) const;
@@ -79,12 +96,15 @@ private:
     u64 blocks_per_group() const;
     u64 inode_size() const;
 
-    ErrorOr<NonnullRefPtr<Ext2FSInode>> build_root_inode() const;
+    ErrorOr<NonnullRefPtr<Ext2FSInode>> build_inode(InodeIndex) const;
 
     // NOTE: The large Ext2 inode structure is strictly superset of the classic 128-byte inode structure,
     // so the this function simply ignores all the extra data if the filesystem doesn't support large inodes.
     ErrorOr<void> write_ext2_inode(InodeIndex, ext2_inode_large const&);
 
+    // Metadata blocks go through the journal (if there is one), everything else is written as usual.
+    ErrorOr<void> write_metadata_block(BlockIndex, UserOrKernelBuffer const&, size_t count, u64 offset = 0);
+
     bool find_block_containing_inode(InodeIndex, BlockIndex& block_index, unsigned& offset) const;
 
     ErrorOr<void> flush_super_block();
@@ -97,11 +117,33 @@ private:
     ErrorOr<NonnullRefPtr<Inode>> create_inode(Ext2FSInode& parent_inode, StringView name, mode_t, dev_t, UserID, GroupID);
     ErrorOr<NonnullRefPtr<Inode>> create_directory(Ext2FSInode& parent_inode, StringView name, mode_t, UserID, GroupID);
     virtual ErrorOr<void> flush_writes() override;
+    virtual ErrorOr<void> write_back_dirty_data() override;
+    // Hands everything we keep in memory ourselves to the disk cache, which will write it back eventually.
+    ErrorOr<void> flush_metadata_to_disk_cache();
+    void flush_allocation_metadata();
+
+    ErrorOr<void> load_journal();
+    // Hands everything that belongs into the running transaction to the journal, right before it's committed.
+    ErrorOr<void> flush_metadata_for_commit();
 
     BlockIndex first_block_index() const;
     BlockIndex first_block_of_block_group_descriptors() const;
     ErrorOr<InodeIndex> allocate_inode(GroupIndex preferred_group = 0);
-    ErrorOr<Vector<BlockIndex>> allocate_blocks(GroupIndex preferred_group_index, size_t count);
+
+    enum class UseReservedBlocks {
+        No,
+        Yes,
+    };
+
+    // Prefers to allocate the blocks right at the goal block, so that they extend the run that ends in front of it.
+    ErrorOr<Vector<BlockIndex>> allocate_blocks(GroupIndex preferred_group_index, size_t count, BlockIndex goal = 0, UseReservedBlocks = UseReservedBlocks::No);
+
+    // Delayed allocation reserves blocks when the data is written, and only allocates them once it's flushed.
+    ErrorOr<void> reserve_blocks(size_t count);
+    void release_reserved_blocks(size_t count);
+    size_t reserved_block_count() const;
+    ErrorOr<void> flush_delayed_blocks();
+
     GroupIndex group_index_from_inode(InodeIndex) const;
     GroupIndex group_index_from_block_index(BlockIndex) const;
     BlockIndex first_block_of_group(GroupIndex) const;
@@ -109,6 +151,7 @@ private:
     ErrorOr<bool> get_inode_allocation_state(InodeIndex) const;
     ErrorOr<void> set_inode_allocation_state(InodeIndex, bool);
     ErrorOr<void> set_block_allocation_state(BlockIndex, bool);
+    ErrorOr<void> update_block_allocation_state(BlockIndex, bool);
 
     void uncache_inode(InodeIndex);
     ErrorOr<void> free_inode(Ext2FSInode&);
@@ -121,6 +164,9 @@ private:
 
     mutable HashMap<InodeIndex, RefPtr<Ext2FSInode>> m_inode_cache;
 
+    u32 m_reserved_block_count { 0 };
+    HashMap<InodeIndex, NonnullRefPtr<Ext2FSInode>> m_inodes_with_delayed_blocks;
+
     bool m_super_block_dirty { false };
     bool m_block_group_descriptors_dirty { false };
 
@@ -141,6 +187,11 @@ private:
 
     Vector<OwnPtr<CachedBitmap>> m_cached_bitmaps;
     RefPtr<Ext2FSInode> m_root_inode;
+
+    OwnPtr<Ext2FSJournal> m_journal;
+    // With a journal, freed blocks are only given back once the transaction that freed them is committed,
+    // as the last committed transaction might still be using them.
+    Vector<BlockIndex> m_blocks_freed_in_transaction;
 };
 
 }
@@ -8,10 +8,13 @@
 #include <AK/IntegralMath.h>
 #include <AK/IterationDecision.h>
 #include <AK/MemoryStream.h>
+#include <AK/QuickSort.h>
+#include <AK/ScopeGuard.h>
 #include <Kernel/API/POSIX/errno.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/Ext2FS/FileSystem.h>
 #include <Kernel/FileSystem/Ext2FS/Inode.h>
+#include <Kernel/FileSystem/Ext2FS/Journal.h>
 #include <Kernel/FileSystem/InodeMetadata.h>
 #include <Kernel/UnixTypes.h>
 
@@ -67,7 +70,7 @@ ErrorOr<void> Ext2FSInode::write_singly_indirect_block_pointer(BlockBasedFileSys
     TRY(fs().read_block(m_raw_inode.i_block[EXT2_IND_BLOCK], &singly_indirect_block_buffer, block_size, 0));
 
     singly_indirect_block_contents[offset_in_block] = on_disk_index.value();
-    TRY(fs().write_block(m_raw_inode.i_block[EXT2_IND_BLOCK], singly_indirect_block_buffer, block_size));
+    TRY(fs().write_metadata_block(m_raw_inode.i_block[EXT2_IND_BLOCK], singly_indirect_block_buffer, block_size));
 
     if (on_disk_index != 0)
         return {};
@@ -109,13 +112,13 @@ ErrorOr<void> Ext2FSInode::write_doubly_indirect_block_pointer(BlockBasedFileSys
 
     if (doubly_indirect_block_contents[offset_in_doubly_indirect_block] == 0) [[unlikely]] {
         doubly_indirect_block_contents[offset_in_doubly_indirect_block] = TRY(allocate_and_zero_block());
-        TRY(fs().write_block(m_raw_inode.i_block[EXT2_DIND_BLOCK], doubly_indirect_block_buffer, block_size));
+        TRY(fs().write_metadata_block(m_raw_inode.i_block[EXT2_DIND_BLOCK], doubly_indirect_block_buffer, block_size));
     }
 
     TRY(fs().read_block(doubly_indirect_block_contents[offset_in_doubly_indirect_block], &singly_indirect_block_buffer, block_size, 0));
 
     singly_indirect_block_contents[offset_in_singly_indirect_block] = on_disk_index.value();
-    TRY(fs().write_block(doubly_indirect_block_contents[offset_in_doubly_indirect_block], singly_indirect_block_buffer, block_size));
+    TRY(fs().write_metadata_block(doubly_indirect_block_contents[offset_in_doubly_indirect_block], singly_indirect_block_buffer, block_size));
 
     if (on_disk_index != 0)
         return {};
@@ -126,7 +129,7 @@ ErrorOr<void> Ext2FSInode::write_doubly_indirect_block_pointer(BlockBasedFileSys
     TRY(fs().set_block_allocation_state(doubly_indirect_block_contents[offset_in_doubly_indirect_block], false));
     doubly_indirect_block_contents[offset_in_doubly_indirect_block] = 0;
     m_raw_inode.i_blocks -= fs().i_blocks_increment();
-    TRY(fs().write_block(m_raw_inode.i_block[EXT2_DIND_BLOCK], doubly_indirect_block_buffer, block_size));
+    TRY(fs().write_metadata_block(m_raw_inode.i_block[EXT2_DIND_BLOCK], doubly_indirect_block_buffer, block_size));
 
     if (!doubly_indirect_block_contents.filled_with(0))
         return {};
@@ -171,20 +174,20 @@ ErrorOr<void> Ext2FSInode::write_triply_indirect_block_pointer(BlockBasedFileSys
 
     if (triply_indirect_block_contents[offset_in_triply_indirect_block] == 0) [[unlikely]] {
         triply_indirect_block_contents[offset_in_triply_indirect_block] = TRY(allocate_and_zero_block());
-        TRY(fs().write_block(m_raw_inode.i_block[EXT2_TIND_BLOCK], triply_indirect_block_buffer, block_size));
+        TRY(fs().write_metadata_block(m_raw_inode.i_block[EXT2_TIND_BLOCK], triply_indirect_block_buffer, block_size));
     }
 
     TRY(fs().read_block(triply_indirect_block_contents[offset_in_triply_indirect_block], &doubly_indirect_block_buffer, block_size, 0));
 
     if (doubly_indirect_block_contents[offset_in_doubly_indirect_block] == 0) [[unlikely]] {
         doubly_indirect_block_contents[offset_in_doubly_indirect_block] = TRY(allocate_and_zero_block());
-        TRY(fs().write_block(triply_indirect_block_contents[offset_in_triply_indirect_block], doubly_indirect_block_buffer, block_size));
+        TRY(fs().write_metadata_block(triply_indirect_block_contents[offset_in_triply_indirect_block], doubly_indirect_block_buffer, block_size));
     }
 
     TRY(fs().read_block(doubly_indirect_block_contents[offset_in_doubly_indirect_block], &singly_indirect_block_buffer, block_size, 0));
 
     singly_indirect_block_contents[offset_in_singly_indirect_block] = on_disk_index.value();
-    TRY(fs().write_block(doubly_indirect_block_contents[offset_in_doubly_indirect_block], singly_indirect_block_buffer, block_size));
+    TRY(fs().write_metadata_block(doubly_indirect_block_contents[offset_in_doubly_indirect_block], singly_indirect_block_buffer, block_size));
 
     if (on_disk_index != 0)
         return {};
@@ -195,7 +198,7 @@ ErrorOr<void> Ext2FSInode::write_triply_indirect_block_pointer(BlockBasedFileSys
     TRY(fs().set_block_allocation_state(doubly_indirect_block_contents[offset_in_doubly_indirect_block], false));
     doubly_indirect_block_contents[offset_in_doubly_indirect_block] = 0;
     m_raw_inode.i_blocks -= fs().i_blocks_increment();
-    TRY(fs().write_block(triply_indirect_block_contents[offset_in_triply_indirect_block], doubly_indirect_block_buffer, block_size));
+    TRY(fs().write_metadata_block(triply_indirect_block_contents[offset_in_triply_indirect_block], doubly_indirect_block_buffer, block_size));
 
     if (!doubly_indirect_block_contents.filled_with(0))
         return {};
@@ -203,7 +206,7 @@ ErrorOr<void> Ext2FSInode::write_triply_indirect_block_pointer(BlockBasedFileSys
     TRY(fs().set_block_allocation_state(triply_indirect_block_contents[offset_in_triply_indirect_block], false));
     triply_indirect_block_contents[offset_in_triply_indirect_block] = 0;
     m_raw_inode.i_blocks -= fs().i_blocks_increment();
-    TRY(fs().write_block(m_raw_inode.i_block[EXT2_TIND_BLOCK], triply_indirect_block_buffer, block_size));
+    TRY(fs().write_metadata_block(m_raw_inode.i_block[EXT2_TIND_BLOCK], triply_indirect_block_buffer, block_size));
 
     if (!triply_indirect_block_contents.filled_with(0))
         return {};
@@ -220,12 +223,16 @@ ErrorOr<u32> Ext2FSInode::allocate_and_zero_block()
 {
     auto const block_size = fs().logical_block_size();
 
-    auto blocks = TRY(fs().allocate_blocks(fs().group_index_from_inode(index()), 1));
+    // Metadata needed to map delayed blocks was reserved along with them.
+    auto use_reserved_blocks = m_reserved_metadata_block_count > 0 ? Ext2FS::UseReservedBlocks::Yes : Ext2FS::UseReservedBlocks::No;
+    auto blocks = TRY(fs().allocate_blocks(fs().group_index_from_inode(index()), 1, 0, use_reserved_blocks));
+    if (use_reserved_blocks == Ext2FS::UseReservedBlocks::Yes)
+        --m_reserved_metadata_block_count;
     m_raw_inode.i_blocks += fs().i_blocks_increment();
     auto block = blocks.first();
 
     auto buffer_content = TRY(ByteBuffer::create_zeroed(block_size));
-    TRY(fs().write_block(block, UserOrKernelBuffer::for_kernel_buffer(buffer_content.data()), block_size));
+    TRY(fs().write_metadata_block(block, UserOrKernelBuffer::for_kernel_buffer(buffer_content.data()), block_size));
     return block.value();
 }
 
@@ -233,6 +240,14 @@ ErrorOr<void> Ext2FSInode::write_block_pointer(BlockBasedFileSystem::BlockIndex
 {
     VERIFY(m_inode_lock.is_locked());
 
+    if (uses_extents()) {
+        // Blocks of inodes with extents are only ever removed by truncating the tree.
+        VERIFY(on_disk_index != 0);
+        if (logical_block_index > NumericLimits<u32>::max())
+            return EFBIG;
+        return Ext2FSExtentTree { *this }.map_block(logical_block_index.value(), on_disk_index.value());
+    }
+
     if (logical_block_index < EXT2_NDIR_BLOCKS) {
         if (m_raw_inode.i_block[logical_block_index.value()] != on_disk_index) {
             m_raw_inode.i_block[logical_block_index.value()] = on_disk_index.value();
@@ -256,6 +271,7 @@ ErrorOr<void> Ext2FSInode::write_block_pointer(BlockBasedFileSystem::BlockIndex
 ErrorOr<Ext2FS::BlockList> Ext2FSInode::compute_block_list(BlockBasedFileSystem::BlockIndex first_block, BlockBasedFileSystem::BlockIndex last_block) const
 {
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::block_list_for_inode(): i_size={}, i_blocks={}", identifier(), m_raw_inode.i_size, m_raw_inode.i_blocks);
+    VERIFY(!uses_extents());
     Ext2FS::BlockList list {};
 
     // If we are handling a symbolic link, the path is stored in the 60 bytes in
@@ -335,9 +351,14 @@ ErrorOr<void> Ext2FSInode::free_all_blocks()
 
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::free_all_blocks(): i_size={}, i_blocks={}", identifier(), m_raw_inode.i_size, m_raw_inode.i_blocks);
 
+    discard_delayed_blocks(0);
+
     if (Kernel::is_symlink(m_raw_inode.i_mode) && m_raw_inode.i_blocks == 0)
         return {};
 
+    if (uses_extents())
+        return Ext2FSExtentTree { *this }.truncate(0);
+
     unsigned const block_size = fs().logical_block_size();
     unsigned const entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
 
@@ -405,6 +426,8 @@ Ext2FSInode::Ext2FSInode(Ext2FS& fs, InodeIndex index)
 Ext2FSInode::~Ext2FSInode()
 {
     if (m_raw_inode.i_links_count == 0) {
+        // NOTE: The last reference may be dropped while someone holds an inode lock, so we can't wait for a commit here.
+        Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
         // Alas, we have nowhere to propagate any errors that occur here.
         (void)fs().free_inode(*this);
     }
@@ -457,7 +480,8 @@ InodeMetadata Ext2FSInode::metadata() const
     }
 
     metadata.block_size = fs().logical_block_size();
-    metadata.block_count = m_raw_inode.i_blocks;
+    // Delayed blocks don't have a place on the disk yet, but they already take up space.
+    metadata.block_count = m_raw_inode.i_blocks + m_delayed_blocks.size() * fs().i_blocks_increment();
 
     if (Kernel::is_character_device(m_raw_inode.i_mode) || Kernel::is_block_device(m_raw_inode.i_mode)) {
         unsigned dev = m_raw_inode.i_block[0];
@@ -471,6 +495,7 @@ InodeMetadata Ext2FSInode::metadata() const
 
 ErrorOr<void> Ext2FSInode::flush_metadata()
 {
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     MutexLocker locker(m_inode_lock);
     if (!is_metadata_dirty())
         return {};
@@ -489,6 +514,11 @@ ErrorOr<void> Ext2FSInode::flush_metadata()
 }
 
 ErrorOr<size_t> Ext2FSInode::read_bytes_locked(off_t offset, size_t count, UserOrKernelBuffer& buffer, OpenFileDescription* description) const
+{
+    return read_bytes_impl(offset, count, buffer, !description || !description->is_direct());
+}
+
+ErrorOr<size_t> Ext2FSInode::read_bytes_impl(off_t offset, size_t count, UserOrKernelBuffer& buffer, bool allow_cache) const
 {
     VERIFY(m_inode_lock.is_locked());
     VERIFY(offset >= 0);
@@ -507,8 +537,6 @@ ErrorOr<size_t> Ext2FSInode::read_bytes_locked(off_t offset, size_t count, UserO
         return nread;
     }
 
-    bool allow_cache = !description || !description->is_direct();
-
     int const block_size = fs().logical_block_size();
 
     BlockBasedFileSystem::BlockIndex first_block_logical_index = offset / block_size;
@@ -522,10 +550,19 @@ ErrorOr<size_t> Ext2FSInode::read_bytes_locked(off_t offset, size_t count, UserO
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FSInode[{}]::read_bytes(): Reading up to {} bytes, {} bytes into inode to {}", identifier(), count, offset, buffer.user_or_kernel_ptr());
 
     while (remaining_count) {
-        auto block_index = TRY(m_block_view.get_block(current_block_logical_index));
         size_t offset_into_block = (current_block_logical_index == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min((size_t)block_size - offset_into_block, (size_t)remaining_count);
         auto buffer_offset = buffer.offset(nread);
+        if (auto delayed_block = m_delayed_blocks.find(current_block_logical_index); delayed_block != m_delayed_blocks.end()) {
+            // This block hasn't been allocated yet, so its only copy is in memory.
+            TRY(buffer_offset.write(delayed_block->value.offset_pointer(offset_into_block), num_bytes_to_copy));
+            current_block_logical_index = current_block_logical_index.value() + 1;
+            remaining_count -= num_bytes_to_copy;
+            nread += num_bytes_to_copy;
+            continue;
+        }
+
+        auto block_index = TRY(m_block_view.get_block(current_block_logical_index));
         if (block_index.value() == 0) {
             // This is a hole, act as if it's filled with zeroes.
             TRY(buffer_offset.memset(0, num_bytes_to_copy));
@@ -543,6 +580,88 @@ ErrorOr<size_t> Ext2FSInode::read_bytes_locked(off_t offset, size_t count, UserO
     return nread;
 }
 
+bool Ext2FSInode::can_use_page_cache() const
+{
+    return Kernel::is_regular_file(m_raw_inode.i_mode);
+}
+
+ErrorOr<size_t> Ext2FSInode::read_bytes_for_page_cache_locked(off_t offset, size_t count, UserOrKernelBuffer& buffer) const
+{
+    VERIFY(m_inode_lock.is_locked());
+    VERIFY(offset >= 0);
+    VERIFY(offset % PAGE_SIZE == 0 && count % PAGE_SIZE == 0);
+    if (static_cast<u64>(offset) >= size())
+        return 0;
+
+    // Blocks that are larger than a page would only be read partially, the regular path knows how to do that.
+    auto const block_size = fs().logical_block_size();
+    if (block_size > PAGE_SIZE)
+        return read_bytes_impl(offset, count, buffer, false);
+
+    auto nread = min(static_cast<u64>(count), size() - offset);
+    u64 first_block_logical_index = offset / block_size;
+    u64 end_block_logical_index = ceil_div(offset + nread, static_cast<u64>(block_size));
+
+    // Runs of blocks that are on disk are read in one go, but holes and blocks that only exist in memory break them up.
+    Vector<BlockBasedFileSystem::BlockIndex> run_blocks;
+    TRY(run_blocks.try_ensure_capacity(end_block_logical_index - first_block_logical_index));
+    size_t run_buffer_offset = 0;
+    auto read_run = [&]() -> ErrorOr<void> {
+        if (run_blocks.is_empty())
+            return {};
+        auto run_buffer = buffer.offset(run_buffer_offset);
+        TRY(fs().read_blocks_uncached(run_blocks, run_buffer));
+        run_blocks.clear_with_capacity();
+        return {};
+    };
+
+    for (auto logical_index = first_block_logical_index; logical_index < end_block_logical_index; ++logical_index) {
+        size_t buffer_offset = (logical_index - first_block_logical_index) * block_size;
+        if (auto delayed_block = m_delayed_blocks.find(logical_index); delayed_block != m_delayed_blocks.end()) {
+            TRY(read_run());
+            TRY(buffer.write(delayed_block->value.data(), buffer_offset, block_size));
+            continue;
+        }
+        auto block_index = TRY(m_block_view.get_block(logical_index));
+        if (block_index.value() == 0) {
+            TRY(read_run());
+            TRY(buffer.offset(buffer_offset).memset(0, block_size));
+            continue;
+        }
+        if (run_blocks.is_empty())
+            run_buffer_offset = buffer_offset;
+        run_blocks.unchecked_append(block_index);
+    }
+    TRY(read_run());
+    return nread;
+}
+
+ErrorOr<void> Ext2FSInode::read_ahead_locked(off_t offset, size_t count) const
+{
+    VERIFY(m_inode_lock.is_locked());
+    VERIFY(offset >= 0);
+    if (static_cast<u64>(offset) >= size())
+        return {};
+    if (is_symlink() && size() < max_inline_symlink_length)
+        return {};
+
+    auto const block_size = fs().logical_block_size();
+    auto end = min(static_cast<u64>(offset) + count, size());
+    u64 first_block_logical_index = offset / block_size;
+    u64 end_block_logical_index = ceil_div(end, static_cast<u64>(block_size));
+
+    Vector<BlockBasedFileSystem::BlockIndex> blocks;
+    TRY(blocks.try_ensure_capacity(end_block_logical_index - first_block_logical_index));
+    for (auto logical_index = first_block_logical_index; logical_index < end_block_logical_index; ++logical_index) {
+        auto block_index = TRY(m_block_view.get_block(logical_index));
+        // Holes read as zeroes, there's nothing to fetch for them.
+        if (block_index.value() != 0)
+            blocks.unchecked_append(block_index);
+    }
+
+    return fs().read_ahead_blocks(blocks);
+}
+
 ErrorOr<void> Ext2FSInode::resize(u64 new_size)
 {
     VERIFY(m_inode_lock.is_locked());
@@ -557,18 +676,27 @@ ErrorOr<void> Ext2FSInode::resize(u64 new_size)
         BlockBasedFileSystem::BlockIndex first_block_logical_index = ceil_div(new_size, block_size);
         BlockBasedFileSystem::BlockIndex last_block_logical_index = size() / block_size;
 
-        for (auto bi = first_block_logical_index; bi <= last_block_logical_index; bi = bi.value() + 1) {
-            auto block = TRY(m_block_view.get_block(bi));
-            if (block == 0) {
-                // This is a hole, skip it.
-                continue;
-            }
-            if (auto result = fs().set_block_allocation_state(block, false); result.is_error()) {
-                dbgln("Ext2FSInode[{}]::resize(): Failed to free block {}: {}", identifier(), block, result.error());
-                return result;
+        discard_delayed_blocks(first_block_logical_index);
+        // Bytes past the end of the file have to read back as zeroes should it grow again.
+        if (auto partial_block = m_delayed_blocks.find(new_size / block_size); partial_block != m_delayed_blocks.end())
+            partial_block->value.bytes().slice(new_size % block_size).fill(0);
+
+        if (uses_extents()) {
+            TRY(m_block_view.truncate_extents(first_block_logical_index));
+        } else {
+            for (auto bi = first_block_logical_index; bi <= last_block_logical_index; bi = bi.value() + 1) {
+                auto block = TRY(m_block_view.get_block(bi));
+                if (block == 0) {
+                    // This is a hole, skip it.
+                    continue;
+                }
+                if (auto result = fs().set_block_allocation_state(block, false); result.is_error()) {
+                    dbgln("Ext2FSInode[{}]::resize(): Failed to free block {}: {}", identifier(), block, result.error());
+                    return result;
+                }
+                m_raw_inode.i_blocks -= fs().i_blocks_increment();
+                TRY(m_block_view.write_block_pointer(bi, 0));
             }
-            m_raw_inode.i_blocks -= fs().i_blocks_increment();
-            TRY(m_block_view.write_block_pointer(bi, 0));
         }
     }
 
@@ -588,6 +716,8 @@ ErrorOr<size_t> Ext2FSInode::write_bytes_locked(off_t offset, size_t count, User
     if (count == 0)
         return 0;
 
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
+
     if (is_symlink()) {
         VERIFY(offset == 0);
         if (max((size_t)(offset + count), (size_t)m_raw_inode.i_size) < max_inline_symlink_length) {
@@ -601,6 +731,10 @@ ErrorOr<size_t> Ext2FSInode::write_bytes_locked(off_t offset, size_t count, User
     }
 
     bool allow_cache = !description || !description->is_direct();
+    // Direct writes are expected to hit the disk right away, so we only hold back data that goes through the cache anyway.
+    bool delay_allocation = allow_cache && Kernel::is_regular_file(m_raw_inode.i_mode);
+    if (!allow_cache)
+        TRY(flush_delayed_blocks());
 
     auto const block_size = fs().logical_block_size();
     auto new_size = max(static_cast<u64>(offset) + count, size());
@@ -620,11 +754,22 @@ ErrorOr<size_t> Ext2FSInode::write_bytes_locked(off_t offset, size_t count, User
     while (remaining_count) {
         size_t offset_into_block = (current_block_logical_index == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min((size_t)block_size - offset_into_block, (size_t)remaining_count);
+        ByteBuffer* delayed_block = nullptr;
+        if (delay_allocation)
+            delayed_block = TRY(delayed_block_for_write(current_block_logical_index));
+        if (delayed_block) {
+            TRY(data.read(delayed_block->offset_pointer(offset_into_block), nwritten, num_bytes_to_copy));
+            current_block_logical_index = current_block_logical_index.value() + 1;
+            remaining_count -= num_bytes_to_copy;
+            nwritten += num_bytes_to_copy;
+            continue;
+        }
+
         auto block_index = TRY(m_block_view.get_or_allocate_block(current_block_logical_index, num_bytes_to_copy != block_size, allow_cache));
         TRY(m_block_view.write_block_pointer(current_block_logical_index, block_index));
 
         dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes_locked(): Writing block {} (offset_into_block: {})", identifier(), block_index, offset_into_block);
-        if (auto result = fs().write_block(block_index, data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache); result.is_error()) {
+        if (auto result = write_contents_block(block_index, data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache); result.is_error()) {
             dbgln("Ext2FSInode[{}]::write_bytes_locked(): Failed to write block {} (index {})", identifier(), block_index, current_block_logical_index);
             return result.release_error();
         }
@@ -678,6 +823,24 @@ ErrorOr<void> Ext2FSInode::write_directory(Vector<Ext2FSDirectoryEntry>& entries
     MutexLocker locker(m_inode_lock);
     auto block_size = fs().logical_block_size();
 
+    // Directories that don't fit into a single block get a hashed index, so that lookups don't have to read all of them.
+    if (has_flag(fs().get_features_optional(), Ext2FS::FeaturesOptional::DirectoryIndex)) {
+        size_t total_length = 0;
+        for (auto const& entry : entries)
+            total_length += EXT2_DIR_REC_LEN(entry.name->length());
+        if (total_length > block_size) {
+            auto result = Ext2FSDirectoryIndex::build(*this, entries);
+            if (!result.is_error()) {
+                m_lookup_cache.clear();
+                return {};
+            }
+            // The index can't hold this many entries, so we keep the directory linear instead.
+            if (result.error().code() != EOVERFLOW)
+                return result.release_error();
+        }
+    }
+    m_raw_inode.i_flags &= ~EXT2_INDEX_FL;
+
     // Calculate directory size and record length of entries so that
     // the following constraints are met:
     // - All used blocks must be entirely filled.
@@ -732,18 +895,16 @@ ErrorOr<void> Ext2FSInode::write_directory(Vector<Ext2FSDirectoryEntry>& entries
     return {};
 }
 
-ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSInode::allocate_block(BlockBasedFileSystem::BlockIndex block_index, bool zero_newly_allocated_block, bool allow_cache)
+ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSInode::allocate_block(BlockBasedFileSystem::BlockIndex block_index, BlockBasedFileSystem::BlockIndex goal, bool zero_newly_allocated_block, bool allow_cache)
 {
-    // FIXME: Preallocate some extra blocks here.
-    auto blocks = TRY(fs().allocate_blocks(fs().group_index_from_inode(index()), 1));
+    auto blocks = TRY(fs().allocate_blocks(fs().group_index_from_inode(index()), 1, goal));
     m_raw_inode.i_blocks += fs().i_blocks_increment();
 
     VERIFY(blocks.size() == 1);
     auto block = blocks.first();
 
     if (zero_newly_allocated_block) {
-        u8 zero_buffer[PAGE_SIZE] {};
-        if (auto result = fs().write_block(block, UserOrKernelBuffer::for_kernel_buffer(zero_buffer), fs().logical_block_size(), 0, allow_cache); result.is_error()) {
+        if (auto result = zero_block(block, allow_cache); result.is_error()) {
             dbgln("Ext2FSInode[{}]::allocate_block(): Failed to zero block {} (index {})", identifier(), block, block_index);
             return result.release_error();
         }
@@ -752,8 +913,181 @@ ErrorOr<BlockBasedFileSystem::BlockIndex> Ext2FSInode::allocate_block(BlockBased
     return block;
 }
 
+ErrorOr<void> Ext2FSInode::zero_block(BlockBasedFileSystem::BlockIndex block, bool allow_cache)
+{
+    u8 zero_buffer[PAGE_SIZE] {};
+    return write_contents_block(block, UserOrKernelBuffer::for_kernel_buffer(zero_buffer), fs().logical_block_size(), 0, allow_cache);
+}
+
+ErrorOr<void> Ext2FSInode::write_contents_block(BlockBasedFileSystem::BlockIndex block, UserOrKernelBuffer const& data, size_t count, u64 offset, bool allow_cache)
+{
+    // The contents of directories (and symlinks) are metadata as well, regular files are journaled in ordered mode.
+    if (!Kernel::is_regular_file(m_raw_inode.i_mode))
+        return fs().write_metadata_block(block, data, count, offset);
+    return fs().write_block(block, data, count, offset, allow_cache);
+}
+
+// Past this many reserved blocks, writers have to allocate their delayed blocks before they may delay any more.
+static constexpr size_t max_delayed_bytes = 16 * MiB;
+
+ErrorOr<ByteBuffer*> Ext2FSInode::delayed_block_for_write(BlockBasedFileSystem::BlockIndex block_index)
+{
+    VERIFY(m_inode_lock.is_locked());
+    if (auto delayed_block = m_delayed_blocks.find(block_index); delayed_block != m_delayed_blocks.end())
+        return &delayed_block->value;
+
+    // Blocks that are already on the disk are simply overwritten in place.
+    if (TRY(m_block_view.has_block(block_index)))
+        return nullptr;
+
+    auto const block_size = fs().logical_block_size();
+    if (fs().reserved_block_count() >= max_delayed_bytes / block_size) {
+        TRY(flush_delayed_blocks());
+        // Other inodes are holding the rest of the reservations, so we don't hold back any more data for now.
+        if (fs().reserved_block_count() >= max_delayed_bytes / block_size)
+            return nullptr;
+    }
+
+    // The metadata reservation is a worst-case guess. If we can't make it, allocating what we're holding back gives
+    // back the part of it that isn't needed, and this block is written right away instead.
+    auto metadata_block_count = max_metadata_block_count_for_mapping(block_index);
+    if (fs().reserve_blocks(1 + metadata_block_count).is_error()) {
+        TRY(flush_delayed_blocks());
+        return nullptr;
+    }
+    m_reserved_metadata_block_count += metadata_block_count;
+    ArmedScopeGuard release_reservation = [&] {
+        m_reserved_metadata_block_count -= metadata_block_count;
+        fs().release_reserved_blocks(1 + metadata_block_count);
+    };
+
+    auto buffer = TRY(ByteBuffer::create_zeroed(block_size));
+    if (m_delayed_blocks.is_empty()) {
+        MutexLocker locker(fs().m_lock);
+        TRY(fs().m_inodes_with_delayed_blocks.try_set(index(), *this));
+    }
+    TRY(m_delayed_blocks.try_set(block_index, move(buffer)));
+    release_reservation.disarm();
+
+    return &m_delayed_blocks.find(block_index)->value;
+}
+
+ErrorOr<void> Ext2FSInode::flush_delayed_blocks()
+{
+    VERIFY(m_inode_lock.is_locked());
+    if (m_delayed_blocks.is_empty())
+        return {};
+
+    Vector<BlockBasedFileSystem::BlockIndex> block_indices;
+    TRY(block_indices.try_ensure_capacity(m_delayed_blocks.size()));
+    for (auto& it : m_delayed_blocks)
+        block_indices.unchecked_append(it.key);
+    quick_sort(block_indices);
+
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::flush_delayed_blocks(): Allocating {} blocks", identifier(), block_indices.size());
+
+    auto const block_size = fs().logical_block_size();
+    for (size_t run_start = 0; run_start < block_indices.size();) {
+        auto first_block_index = block_indices[run_start];
+        size_t run_length = 1;
+        while (run_start + run_length < block_indices.size() && block_indices[run_start + run_length] == first_block_index.value() + run_length)
+            ++run_length;
+
+        // Allocate every run of consecutive blocks in one go, preferably right behind the block that precedes it.
+        BlockBasedFileSystem::BlockIndex goal = 0;
+        if (first_block_index != 0) {
+            if (auto previous_block = TRY(m_block_view.get_block(first_block_index.value() - 1)); previous_block != 0)
+                goal = previous_block.value() + 1;
+        }
+        auto blocks = TRY(fs().allocate_blocks(fs().group_index_from_inode(index()), run_length, goal, Ext2FS::UseReservedBlocks::Yes));
+
+        // Blocks that didn't make it into the block map are freed again. Their data is still delayed, so they go back
+        // to being reserved for the next try.
+        size_t mapped_block_count = 0;
+        ArmedScopeGuard give_back_unmapped_blocks = [&] {
+            set_metadata_dirty(true);
+            for (size_t i = mapped_block_count; i < run_length; ++i) {
+                if (auto result = fs().set_block_allocation_state(blocks[i], false); result.is_error())
+                    dbgln("Ext2FSInode[{}]::flush_delayed_blocks(): Failed to free block {}: {}", identifier(), blocks[i], result.error());
+            }
+            if (auto result = fs().reserve_blocks(run_length - mapped_block_count); result.is_error())
+                dbgln("Ext2FSInode[{}]::flush_delayed_blocks(): Failed to reserve {} blocks again: {}", identifier(), run_length - mapped_block_count, result.error());
+        };
+
+        for (; mapped_block_count < run_length; ++mapped_block_count) {
+            auto block_index = block_indices[run_start + mapped_block_count];
+            auto block = blocks[mapped_block_count];
+
+            // The data goes out before the block is mapped, so that nothing ever maps a block with stale contents.
+            auto& data = m_delayed_blocks.find(block_index)->value;
+            TRY(fs().write_block(block, UserOrKernelBuffer::for_kernel_buffer(data.data()), block_size, 0, true));
+            TRY(m_block_view.write_block_pointer(block_index, block));
+            m_raw_inode.i_blocks += fs().i_blocks_increment();
+            m_delayed_blocks.remove(block_index);
+        }
+        give_back_unmapped_blocks.disarm();
+        run_start += run_length;
+    }
+    set_metadata_dirty(true);
+
+    // Whatever metadata we didn't end up needing is free for everyone else again.
+    fs().release_reserved_blocks(m_reserved_metadata_block_count);
+    m_reserved_metadata_block_count = 0;
+
+    MutexLocker locker(fs().m_lock);
+    fs().m_inodes_with_delayed_blocks.remove(index());
+    return {};
+}
+
+void Ext2FSInode::discard_delayed_blocks(BlockBasedFileSystem::BlockIndex first_block_to_discard)
+{
+    VERIFY(m_inode_lock.is_locked());
+    if (m_delayed_blocks.is_empty())
+        return;
+
+    size_t discarded_block_count = 0;
+    m_delayed_blocks.remove_all_matching([&](auto block_index, auto&) {
+        if (block_index < first_block_to_discard)
+            return false;
+        ++discarded_block_count;
+        return true;
+    });
+    fs().release_reserved_blocks(discarded_block_count);
+
+    // Only keep as much of the metadata reservation around as the remaining blocks may need.
+    size_t needed_metadata_block_count = 0;
+    for (auto& it : m_delayed_blocks)
+        needed_metadata_block_count += max_metadata_block_count_for_mapping(it.key);
+    if (m_reserved_metadata_block_count > needed_metadata_block_count) {
+        fs().release_reserved_blocks(m_reserved_metadata_block_count - needed_metadata_block_count);
+        m_reserved_metadata_block_count = needed_metadata_block_count;
+    }
+
+    if (m_delayed_blocks.is_empty()) {
+        MutexLocker locker(fs().m_lock);
+        fs().m_inodes_with_delayed_blocks.remove(index());
+    }
+}
+
+size_t Ext2FSInode::max_metadata_block_count_for_mapping(BlockBasedFileSystem::BlockIndex block_index) const
+{
+    if (uses_extents()) {
+        // Adding an extent may split every node on the way down to its leaf, and then the root has to grow as well.
+        auto const& root_header = *reinterpret_cast<ext3_extent_header const*>(m_raw_inode.i_block);
+        return root_header.eh_depth + 1;
+    }
+    if (block_index.value() < EXT2_NDIR_BLOCKS)
+        return 0;
+    if (block_index.value() < singly_indirect_block_capacity())
+        return 1;
+    if (block_index.value() < doubly_indirect_block_capacity())
+        return 2;
+    return 3;
+}
+
 ErrorOr<NonnullRefPtr<Inode>> Ext2FSInode::create_child(StringView name, mode_t mode, dev_t dev, UserID uid, GroupID gid)
 {
+    Ext2FSJournalHandle handle { fs() };
     if (Kernel::is_directory(mode))
         return fs().create_directory(*this, name, mode, uid, gid);
     return fs().create_inode(*this, name, mode, dev, uid, gid);
@@ -761,6 +1095,7 @@ ErrorOr<NonnullRefPtr<Inode>> Ext2FSInode::create_child(StringView name, mode_t
 
 ErrorOr<void> Ext2FSInode::add_child(Inode& child, StringView name, mode_t mode)
 {
+    Ext2FSJournalHandle handle { fs() };
     MutexLocker locker(m_inode_lock);
     VERIFY(is_directory());
 
@@ -770,6 +1105,18 @@ ErrorOr<void> Ext2FSInode::add_child(Inode& child, StringView name, mode_t mode)
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::add_child(): Adding inode {} with name '{}' and mode {:o} to directory {}", identifier(), child.index(), name, mode, index());
     bool has_file_type_attribute = has_flag(fs().get_features_optional(), Ext2FS::FeaturesOptional::ExtendedAttributes);
 
+    if (auto directory_index = TRY(this->directory_index()); directory_index.has_value()) {
+        if (TRY(directory_index->lookup(name)).has_value())
+            return EEXIST;
+        TRY(child.increment_link_count());
+        if (auto result = directory_index->add_entry(name, child.index(), has_file_type_attribute ? to_ext2_file_type(mode) : (u8)EXT2_FT_UNKNOWN); result.is_error()) {
+            (void)child.decrement_link_count();
+            return result.release_error();
+        }
+        did_add_child(child.identifier(), name);
+        return {};
+    }
+
     Vector<Ext2FSDirectoryEntry> entries;
     TRY(traverse_as_directory([&](auto& entry) -> ErrorOr<void> {
         if (name == entry.name)
@@ -785,10 +1132,13 @@ ErrorOr<void> Ext2FSInode::add_child(Inode& child, StringView name, mode_t mode)
     TRY(entries.try_empend(move(entry_name), child.index(), has_file_type_attribute ? to_ext2_file_type(mode) : (u8)EXT2_FT_UNKNOWN));
 
     TRY(write_directory(entries));
-    TRY(populate_lookup_cache());
 
-    auto cache_entry_name = TRY(KString::try_create(name));
-    TRY(m_lookup_cache.try_set(move(cache_entry_name), child.index()));
+    // Once the directory has grown an index, lookups go through that instead of the cache.
+    if (!(m_raw_inode.i_flags & EXT2_INDEX_FL)) {
+        TRY(populate_lookup_cache());
+        auto cache_entry_name = TRY(KString::try_create(name));
+        TRY(m_lookup_cache.try_set(move(cache_entry_name), child.index()));
+    }
     did_add_child(child.identifier(), name);
     return {};
 }
@@ -798,12 +1148,20 @@ ErrorOr<void> Ext2FSInode::remove_child_impl(StringView name, RemoveDotEntries r
     MutexLocker locker(m_inode_lock);
     VERIFY(is_directory());
 
-    TRY(populate_lookup_cache());
-
-    auto it = m_lookup_cache.find(name);
-    if (it == m_lookup_cache.end())
-        return ENOENT;
-    auto child_inode_index = (*it).value;
+    auto directory_index = TRY(this->directory_index());
+    InodeIndex child_inode_index;
+    if (directory_index.has_value()) {
+        auto maybe_child_inode_index = TRY(directory_index->lookup(name));
+        if (!maybe_child_inode_index.has_value())
+            return ENOENT;
+        child_inode_index = *maybe_child_inode_index;
+    } else {
+        TRY(populate_lookup_cache());
+        auto it = m_lookup_cache.find(name);
+        if (it == m_lookup_cache.end())
+            return ENOENT;
+        child_inode_index = it->value;
+    }
 
     InodeIdentifier child_id { fsid(), child_inode_index };
     auto child_inode = TRY(fs().get_inode(child_id));
@@ -812,20 +1170,25 @@ ErrorOr<void> Ext2FSInode::remove_child_impl(StringView name, RemoveDotEntries r
         TRY(static_cast<Ext2FSInode&>(*child_inode).remove_child_impl(".."sv, RemoveDotEntries::No));
     }
 
-    bool has_file_type_attribute = has_flag(fs().get_features_optional(), Ext2FS::FeaturesOptional::ExtendedAttributes);
+    if (directory_index.has_value()) {
+        TRY(directory_index->remove_entry(name));
+    } else {
+        bool has_file_type_attribute = has_flag(fs().get_features_optional(), Ext2FS::FeaturesOptional::ExtendedAttributes);
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    TRY(traverse_as_directory([&](auto& entry) -> ErrorOr<void> {
-        if (name != entry.name) {
-            auto entry_name = TRY(KString::try_create(entry.name));
-            TRY(entries.try_append({ move(entry_name), entry.inode.index(), has_file_type_attribute ? entry.file_type : (u8)EXT2_FT_UNKNOWN }));
-        }
-        return {};
-    }));
+        Vector<Ext2FSDirectoryEntry> entries;
+        TRY(traverse_as_directory([&](auto& entry) -> ErrorOr<void> {
+            if (name != entry.name) {
+                auto entry_name = TRY(KString::try_create(entry.name));
+                TRY(entries.try_append({ move(entry_name), entry.inode.index(), has_file_type_attribute ? entry.file_type : (u8)EXT2_FT_UNKNOWN }));
+            }
+            return {};
+        }));
 
-    TRY(write_directory(entries));
+        TRY(write_directory(entries));
 
-    m_lookup_cache.remove(it);
+        if (auto it = m_lookup_cache.find(name); it != m_lookup_cache.end())
+            m_lookup_cache.remove(it);
+    }
 
     TRY(child_inode->decrement_link_count());
 
@@ -837,9 +1200,18 @@ ErrorOr<void> Ext2FSInode::remove_child(StringView name)
 {
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::remove_child(): Removing '{}'", identifier(), name);
     // TODO: Implement something like remove_directory so we can get rid of remove_child_impl.
+    Ext2FSJournalHandle handle { fs() };
     return remove_child_impl(name, RemoveDotEntries::Yes);
 }
 
+ErrorOr<Optional<Ext2FSDirectoryIndex>> Ext2FSInode::directory_index()
+{
+    VERIFY(m_inode_lock.is_exclusively_locked_by_current_thread());
+    if (!has_flag(fs().get_features_optional(), Ext2FS::FeaturesOptional::DirectoryIndex))
+        return OptionalNone {};
+    return Ext2FSDirectoryIndex::try_open(*this);
+}
+
 ErrorOr<void> Ext2FSInode::populate_lookup_cache()
 {
     VERIFY(m_inode_lock.is_exclusively_locked_by_current_thread());
@@ -866,13 +1238,22 @@ ErrorOr<NonnullRefPtr<Inode>> Ext2FSInode::lookup(StringView name)
     InodeIndex inode_index;
     {
         MutexLocker locker(m_inode_lock);
-        TRY(populate_lookup_cache());
-        auto it = m_lookup_cache.find(name);
-        if (it == m_lookup_cache.end()) {
-            dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): '{}' not found", identifier(), name);
-            return ENOENT;
+        if (auto directory_index = TRY(this->directory_index()); directory_index.has_value()) {
+            auto maybe_inode_index = TRY(directory_index->lookup(name));
+            if (!maybe_inode_index.has_value()) {
+                dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): '{}' not found in index", identifier(), name);
+                return ENOENT;
+            }
+            inode_index = *maybe_inode_index;
+        } else {
+            TRY(populate_lookup_cache());
+            auto it = m_lookup_cache.find(name);
+            if (it == m_lookup_cache.end()) {
+                dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): '{}' not found", identifier(), name);
+                return ENOENT;
+            }
+            inode_index = it->value;
         }
-        inode_index = it->value;
     }
 
     return fs().get_inode({ fsid(), inode_index });
@@ -880,6 +1261,7 @@ ErrorOr<NonnullRefPtr<Inode>> Ext2FSInode::lookup(StringView name)
 
 ErrorOr<void> Ext2FSInode::update_timestamps(Optional<UnixDateTime> atime, Optional<UnixDateTime> ctime, Optional<UnixDateTime> mtime)
 {
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     MutexLocker locker(m_inode_lock);
     if (fs().is_readonly())
         return EROFS;
@@ -910,6 +1292,7 @@ ErrorOr<void> Ext2FSInode::update_timestamps(Optional<UnixDateTime> atime, Optio
 
 ErrorOr<void> Ext2FSInode::increment_link_count()
 {
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     MutexLocker locker(m_inode_lock);
     if (fs().is_readonly())
         return EROFS;
@@ -923,6 +1306,7 @@ ErrorOr<void> Ext2FSInode::increment_link_count()
 
 ErrorOr<void> Ext2FSInode::decrement_link_count()
 {
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     MutexLocker locker(m_inode_lock);
     if (fs().is_readonly())
         return EROFS;
@@ -941,6 +1325,7 @@ ErrorOr<void> Ext2FSInode::decrement_link_count()
 
 ErrorOr<void> Ext2FSInode::chmod(mode_t mode)
 {
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     MutexLocker locker(m_inode_lock);
     if (m_raw_inode.i_mode == mode)
         return {};
@@ -951,6 +1336,7 @@ ErrorOr<void> Ext2FSInode::chmod(mode_t mode)
 
 ErrorOr<void> Ext2FSInode::chown(UserID uid, GroupID gid)
 {
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     MutexLocker locker(m_inode_lock);
     if (inode_uid(m_raw_inode) == uid && inode_gid(m_raw_inode) == gid)
         return {};
@@ -965,6 +1351,7 @@ ErrorOr<void> Ext2FSInode::chown(UserID uid, GroupID gid)
 ErrorOr<void> Ext2FSInode::truncate_locked(u64 size)
 {
     VERIFY(m_inode_lock.is_locked());
+    Ext2FSJournalHandle handle { fs(), Ext2FSJournalHandle::WaitForCommit::No };
     if (static_cast<u64>(m_raw_inode.i_size) == size)
         return {};
     TRY(resize(size));
@@ -975,11 +1362,16 @@ ErrorOr<void> Ext2FSInode::truncate_locked(u64 size)
 
 ErrorOr<int> Ext2FSInode::get_block_address(int index)
 {
+    Ext2FSJournalHandle handle { fs() };
     MutexLocker locker(m_inode_lock);
 
     if (index < 0)
         return 0;
 
+    // Delayed blocks don't have an address until they're allocated.
+    if (m_delayed_blocks.contains(index))
+        TRY(flush_delayed_blocks());
+
     return TRY(m_block_view.get_block(index)).value();
 }
 
@@ -10,6 +10,8 @@
 #include <Kernel/FileSystem/Ext2FS/BlockView.h>
 #include <Kernel/FileSystem/Ext2FS/Definitions.h>
 #include <Kernel/FileSystem/Ext2FS/DirectoryEntry.h>
+#include <Kernel/FileSystem/Ext2FS/DirectoryIndex.h>
+#include <Kernel/FileSystem/Ext2FS/ExtentTree.h>
 #include <Kernel/FileSystem/Ext2FS/FileSystem.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/UnixTypes.h>
@@ -19,6 +21,8 @@ namespace Kernel {
 class Ext2FSInode final : public Inode {
     friend class Ext2FS;
     friend class Ext2FSBlockView;
+    friend class Ext2FSDirectoryIndex;
+    friend class Ext2FSExtentTree;
 
 public:
     virtual ~Ext2FSInode() override;
@@ -26,10 +30,14 @@ public:
     u64 size() const;
     bool is_symlink() const { return Kernel::is_symlink(m_raw_inode.i_mode); }
     bool is_directory() const { return Kernel::is_directory(m_raw_inode.i_mode); }
+    bool uses_extents() const { return m_raw_inode.i_flags & EXT4_EXTENTS_FL; }
 
 private:
     // ^Inode
     virtual ErrorOr<size_t> read_bytes_locked(off_t, size_t, UserOrKernelBuffer& buffer, OpenFileDescription*) const override;
+    virtual ErrorOr<void> read_ahead_locked(off_t, size_t) const override;
+    virtual bool can_use_page_cache() const override;
+    virtual ErrorOr<size_t> read_bytes_for_page_cache_locked(off_t, size_t, UserOrKernelBuffer& buffer) const override;
     virtual InodeMetadata metadata() const override;
     virtual ErrorOr<void> traverse_as_directory(Function<ErrorOr<void>(FileSystem::DirectoryEntryView const&)>) const override;
     virtual ErrorOr<NonnullRefPtr<Inode>> lookup(StringView name) override;
@@ -46,6 +54,8 @@ private:
     virtual ErrorOr<void> truncate_locked(u64) override;
     virtual ErrorOr<int> get_block_address(int) override;
 
+    ErrorOr<size_t> read_bytes_impl(off_t, size_t, UserOrKernelBuffer& buffer, bool allow_cache) const;
+
     bool is_within_inode_bounds(FlatPtr base, FlatPtr value_offset, size_t value_size) const;
 
     static u8 to_ext2_file_type(mode_t mode);
@@ -54,8 +64,10 @@ private:
     static u32 decode_nanoseconds_from_extra(u32 extra) { return (extra & EXT4_NSEC_MASK) >> EXT4_EPOCH_BITS; }
     static u32 encode_time_to_extra(time_t seconds, u32 nanoseconds) { return (((static_cast<time_t>(seconds) - static_cast<i32>(seconds)) >> 32) & EXT4_EPOCH_MASK) | (nanoseconds << EXT4_EPOCH_BITS); }
 
-    ErrorOr<BlockBasedFileSystem::BlockIndex> allocate_block(BlockBasedFileSystem::BlockIndex, bool zero_newly_allocated_block, bool allow_cache);
+    ErrorOr<BlockBasedFileSystem::BlockIndex> allocate_block(BlockBasedFileSystem::BlockIndex, BlockBasedFileSystem::BlockIndex goal, bool zero_newly_allocated_block, bool allow_cache);
     ErrorOr<u32> allocate_and_zero_block();
+    ErrorOr<void> zero_block(BlockBasedFileSystem::BlockIndex, bool allow_cache);
+    ErrorOr<void> write_contents_block(BlockBasedFileSystem::BlockIndex, UserOrKernelBuffer const&, size_t count, u64 offset, bool allow_cache);
 
     enum class RemoveDotEntries {
         Yes,
@@ -64,6 +76,7 @@ private:
 
     ErrorOr<void> remove_child_impl(StringView name, RemoveDotEntries);
     ErrorOr<void> write_directory(Vector<Ext2FSDirectoryEntry>&);
+    ErrorOr<Optional<Ext2FSDirectoryIndex>> directory_index();
     ErrorOr<void> populate_lookup_cache();
     ErrorOr<void> resize(u64);
     ErrorOr<void> write_singly_indirect_block_pointer(BlockBasedFileSystem::BlockIndex logical_block_index, BlockBasedFileSystem::BlockIndex on_disk_index);
@@ -75,6 +88,14 @@ private:
 
     ErrorOr<void> free_all_blocks();
 
+    // Returns the buffer that holds the data of the given block until it gets allocated, or nullptr if the block
+    // should be written to the disk right away.
+    ErrorOr<ByteBuffer*> delayed_block_for_write(BlockBasedFileSystem::BlockIndex);
+    ErrorOr<void> flush_delayed_blocks();
+    void discard_delayed_blocks(BlockBasedFileSystem::BlockIndex first_block_to_discard);
+    // Mapping a block may need new indirect blocks or extent tree nodes. This is how many of them it may take at most.
+    size_t max_metadata_block_count_for_mapping(BlockBasedFileSystem::BlockIndex) const;
+
     u64 singly_indirect_block_capacity() const
     {
         auto const entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
@@ -98,6 +119,9 @@ private:
     Ext2FSInode(Ext2FS&, InodeIndex);
 
     mutable Ext2FSBlockView m_block_view;
+    HashMap<BlockBasedFileSystem::BlockIndex, ByteBuffer> m_delayed_blocks;
+    // Blocks reserved for the metadata that mapping the delayed blocks may need.
+    size_t m_reserved_metadata_block_count { 0 };
     HashMap<NonnullOwnPtr<KString>, InodeIndex> m_lookup_cache;
     ext2_inode_large m_raw_inode {};
 };
@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/QuickSort.h>
+#include <AK/ScopeGuard.h>
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/Ext2FS/FileSystem.h>
+#include <Kernel/FileSystem/Ext2FS/Journal.h>
+#include <Kernel/Tasks/Process.h>
+#include <Kernel/Tasks/Thread.h>
+
+namespace Kernel {
+
+Ext2FSJournalHandle::Ext2FSJournalHandle(Ext2FS& fs, WaitForCommit wait_for_commit)
+{
+    if (fs.m_journal)
+        fs.m_journal->start_handle(*this, wait_for_commit == WaitForCommit::Yes);
+}
+
+Ext2FSJournalHandle::~Ext2FSJournalHandle()
+{
+    if (m_journal)
+        m_journal->stop_handle(*this);
+}
+
+ErrorOr<NonnullOwnPtr<Ext2FSJournal>> Ext2FSJournal::try_create(Ext2FS& fs, Vector<BlockIndex> block_map)
+{
+    auto block_size = fs.logical_block_size();
+    if (block_map.is_empty())
+        return EINVAL;
+
+    auto superblock_buffer = TRY(ByteBuffer::create_zeroed(block_size));
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(superblock_buffer.data());
+    TRY(fs.read_block(block_map[0], &buffer, block_size, 0, false));
+
+    auto const& superblock = *reinterpret_cast<jbd2_journal_superblock const*>(superblock_buffer.data());
+    u32 block_type = superblock.s_header.h_blocktype;
+    if (superblock.s_header.h_magic != JBD2_MAGIC_NUMBER || (block_type != to_underlying(JBD2BlockType::SuperBlockV1) && block_type != to_underlying(JBD2BlockType::SuperBlockV2))) {
+        dmesgln("Ext2FSJournal: Journal superblock is invalid");
+        return EINVAL;
+    }
+
+    if (superblock.s_blocksize != block_size || superblock.s_maxlen > block_map.size() || superblock.s_first == 0 || superblock.s_first >= superblock.s_maxlen) {
+        dmesgln("Ext2FSJournal: Journal geometry is invalid (block size {}, {} blocks, log starts at {})", superblock.s_blocksize, superblock.s_maxlen, superblock.s_first);
+        return EINVAL;
+    }
+
+    if (block_type == to_underlying(JBD2BlockType::SuperBlockV2)) {
+        u32 unknown_features = superblock.s_feature_incompat & ~JBD2_KNOWN_INCOMPAT_FEATURES;
+        if (unknown_features != 0) {
+            dmesgln("Ext2FSJournal: Journal uses unsupported features {:#x}", unknown_features);
+            return ENOTSUP;
+        }
+    }
+
+    return adopt_nonnull_own_or_enomem(new (nothrow) Ext2FSJournal(fs, move(block_map), move(superblock_buffer)));
+}
+
+Ext2FSJournal::Ext2FSJournal(Ext2FS& fs, Vector<BlockIndex> block_map, ByteBuffer superblock_buffer)
+    : m_fs(fs)
+    , m_block_size(fs.logical_block_size())
+    , m_block_map(move(block_map))
+    , m_superblock_buffer(move(superblock_buffer))
+    , m_first(superblock().s_first)
+    , m_last(superblock().s_maxlen)
+    , m_start(superblock().s_start)
+    // A transaction should leave room in the log for the one before it, and it mustn't take over the disk cache.
+    , m_max_transaction_blocks(max<size_t>(min(log_capacity(), fs.disk_cache_statistics().maximum_blocks) / 4, 1))
+    , m_running({ .sequence = superblock().s_sequence })
+    , m_head(m_first)
+{
+}
+
+bool Ext2FSJournal::has_incompat_feature(u32 feature) const
+{
+    if (superblock().s_header.h_blocktype != to_underlying(JBD2BlockType::SuperBlockV2))
+        return false;
+    return (superblock().s_feature_incompat & feature) != 0;
+}
+
+size_t Ext2FSJournal::tag_size() const
+{
+    // Without checksums, the tags don't include the high bits of the block number unless they're needed.
+    if (has_incompat_feature(JBD2_FEATURE_INCOMPAT_64BIT))
+        return sizeof(jbd2_journal_block_tag);
+    return sizeof(jbd2_journal_block_tag) - sizeof(u32);
+}
+
+size_t Ext2FSJournal::revoke_record_size() const
+{
+    return has_incompat_feature(JBD2_FEATURE_INCOMPAT_64BIT) ? sizeof(u64) : sizeof(u32);
+}
+
+u32 Ext2FSJournal::advance(u32 position, size_t count) const
+{
+    VERIFY(position >= m_first && position < m_last);
+    return m_first + (position - m_first + count) % log_capacity();
+}
+
+ErrorOr<void> Ext2FSJournal::read_log_block(u32 position, Bytes bytes)
+{
+    VERIFY(bytes.size() == m_block_size);
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(bytes.data());
+    return m_fs.read_block(m_block_map[position], &buffer, m_block_size, 0, false);
+}
+
+ErrorOr<void> Ext2FSJournal::write_log_blocks(u32 position, ReadonlyBytes bytes)
+{
+    VERIFY(bytes.size() % m_block_size == 0);
+    size_t count = bytes.size() / m_block_size;
+    size_t written = 0;
+    while (written < count) {
+        // Write runs of blocks that are contiguous on the disk as well as in the log with a single request.
+        auto first_block = m_block_map[position];
+        size_t run_length = 1;
+        while (written + run_length < count && position + run_length < m_last && m_block_map[position + run_length].value() == first_block.value() + run_length)
+            ++run_length;
+
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(bytes.offset_pointer(written * m_block_size)));
+        TRY(m_fs.write_blocks(first_block, run_length, buffer, false));
+
+        written += run_length;
+        position = advance(position, run_length);
+    }
+    return {};
+}
+
+ErrorOr<void> Ext2FSJournal::write_superblock(u32 sequence, u32 start)
+{
+    superblock().s_sequence = sequence;
+    superblock().s_start = start;
+    m_start = start;
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(m_superblock_buffer.data());
+    return m_fs.write_block(m_block_map[0], buffer, m_block_size, 0, false);
+}
+
+ErrorOr<Vector<Ext2FSJournal::Tag>> Ext2FSJournal::parse_descriptor(ReadonlyBytes block) const
+{
+    Vector<Tag> tags;
+    size_t offset = sizeof(jbd2_journal_header);
+    while (offset + tag_size() <= block.size()) {
+        auto const& tag = *reinterpret_cast<jbd2_journal_block_tag const*>(block.offset_pointer(offset));
+        u16 flags = tag.t_flags;
+        u64 block_index = tag.t_blocknr;
+        if (has_incompat_feature(JBD2_FEATURE_INCOMPAT_64BIT))
+            block_index |= static_cast<u64>(tag.t_blocknr_high) << 32;
+        TRY(tags.try_append({ block_index, (flags & JBD2_FLAG_ESCAPE) != 0 }));
+
+        offset += tag_size();
+        if (!(flags & JBD2_FLAG_SAME_UUID))
+            offset += sizeof(jbd2_journal_superblock::s_uuid);
+        if (flags & JBD2_FLAG_LAST_TAG)
+            break;
+    }
+    return tags;
+}
+
+ErrorOr<void> Ext2FSJournal::parse_revoke_block(ReadonlyBytes block, Function<ErrorOr<void>(u64)> callback) const
+{
+    auto const& header = *reinterpret_cast<jbd2_journal_revoke_header const*>(block.data());
+    size_t used_bytes = min<size_t>(header.r_count, block.size());
+    for (size_t offset = sizeof(jbd2_journal_revoke_header); offset + revoke_record_size() <= used_bytes; offset += revoke_record_size()) {
+        if (revoke_record_size() == sizeof(u64))
+            TRY(callback(*reinterpret_cast<BigEndian<u64> const*>(block.offset_pointer(offset))));
+        else
+            TRY(callback(*reinterpret_cast<BigEndian<u32> const*>(block.offset_pointer(offset))));
+    }
+    return {};
+}
+
+// Like Linux, we go over the log three times: The first pass finds the end of the log, the second one collects
+// revoked blocks, and the last one writes back all the blocks that weren't revoked by a later transaction.
+ErrorOr<void> Ext2FSJournal::do_recovery_pass(RecoveryPass pass, RecoveryInfo& info)
+{
+    auto block_storage = TRY(ByteBuffer::create_uninitialized(m_block_size));
+    auto data_storage = TRY(ByteBuffer::create_uninitialized(m_block_size));
+
+    // Sequence numbers wrap around, so they have to be compared by their distance.
+    auto is_after = [](u32 a, u32 b) { return static_cast<i32>(a - b) > 0; };
+
+    u32 position = m_start;
+    u32 sequence = superblock().s_sequence;
+    size_t blocks_seen = 0;
+    while (blocks_seen < log_capacity()) {
+        if (pass != RecoveryPass::Scan && !is_after(info.end_sequence, sequence))
+            break;
+
+        TRY(read_log_block(position, block_storage.bytes()));
+        auto const& header = *reinterpret_cast<jbd2_journal_header const*>(block_storage.data());
+        if (header.h_magic != JBD2_MAGIC_NUMBER || header.h_sequence != sequence)
+            break;
+
+        position = advance(position, 1);
+        ++blocks_seen;
+
+        u32 block_type = header.h_blocktype;
+        if (block_type == to_underlying(JBD2BlockType::Descriptor)) {
+            auto tags = TRY(parse_descriptor(block_storage.bytes()));
+            for (auto const& tag : tags) {
+                if (pass == RecoveryPass::Replay) {
+                    auto revoked_sequence = info.revoked_blocks.get(tag.block);
+                    bool is_revoked = revoked_sequence.has_value() && !is_after(sequence, revoked_sequence.value());
+                    if (!is_revoked) {
+                        if (tag.block >= m_fs.super_block().s_blocks_count) {
+                            dmesgln("Ext2FSJournal: Log refers to block {}, which is out of range", tag.block);
+                            return EIO;
+                        }
+                        TRY(read_log_block(position, data_storage.bytes()));
+                        if (tag.is_escaped)
+                            *reinterpret_cast<BigEndian<u32>*>(data_storage.data()) = JBD2_MAGIC_NUMBER;
+                        auto buffer = UserOrKernelBuffer::for_kernel_buffer(data_storage.data());
+                        TRY(m_fs.write_block(tag.block, buffer, m_block_size));
+                        ++info.replayed_block_count;
+                    }
+                }
+                position = advance(position, 1);
+            }
+            blocks_seen += tags.size();
+            continue;
+        }
+
+        if (block_type == to_underlying(JBD2BlockType::Commit)) {
+            ++sequence;
+            continue;
+        }
+
+        if (block_type == to_underlying(JBD2BlockType::Revoke)) {
+            if (pass != RecoveryPass::Revoke)
+                continue;
+            TRY(parse_revoke_block(block_storage.bytes(), [&](u64 block) -> ErrorOr<void> {
+                auto revoked_sequence = info.revoked_blocks.get(block);
+                if (!revoked_sequence.has_value() || is_after(sequence, revoked_sequence.value()))
+                    TRY(info.revoked_blocks.try_set(block, sequence));
+                return {};
+            }));
+            continue;
+        }
+
+        dbgln_if(EXT2_DEBUG, "Ext2FSJournal: Unexpected block type {} at log position {}", block_type, position);
+        break;
+    }
+
+    // A transaction that isn't followed by its commit block never happened.
+    if (pass == RecoveryPass::Scan)
+        info.end_sequence = sequence;
+    return {};
+}
+
+ErrorOr<void> Ext2FSJournal::recover()
+{
+    VERIFY(needs_recovery());
+    if (m_start < m_first || m_start >= m_last) {
+        dmesgln("Ext2FSJournal: Log start {} is out of range", m_start);
+        return EINVAL;
+    }
+
+    RecoveryInfo info;
+    TRY(do_recovery_pass(RecoveryPass::Scan, info));
+    TRY(do_recovery_pass(RecoveryPass::Revoke, info));
+    TRY(do_recovery_pass(RecoveryPass::Replay, info));
+
+    // Everything has to be back home before the log can be reused.
+    m_fs.flush_writes_impl();
+
+    dmesgln("Ext2FSJournal: Replayed {} transactions ({} blocks, {} revoked)", info.end_sequence - superblock().s_sequence, info.replayed_block_count, info.revoked_blocks.size());
+
+    m_running = Transaction { .sequence = info.end_sequence };
+    m_head = m_first;
+    return write_superblock(info.end_sequence, 0);
+}
+
+bool Ext2FSJournal::is_handle_owner(Thread const* thread) const
+{
+    return m_handles.with([&](auto& handles) {
+        for (auto& handle : handles) {
+            if (handle.m_thread == thread)
+                return true;
+        }
+        return false;
+    });
+}
+
+bool Ext2FSJournal::is_transaction_full() const
+{
+    MutexLocker locker(m_lock);
+    return m_running.blocks.size() >= m_max_transaction_blocks;
+}
+
+void Ext2FSJournal::start_handle(Ext2FSJournalHandle& handle, bool wait_for_commit)
+{
+    auto* current_thread = Thread::current();
+    if (m_committing_thread == current_thread || is_handle_owner(current_thread))
+        return;
+
+    // Whoever holds the file system lock could be holding up the commit that we're about to wait for.
+    VERIFY(!m_fs.m_lock.is_exclusively_locked_by_current_thread());
+
+    if (wait_for_commit) {
+        // Writers that fill up the transaction have to commit it themselves, which keeps the number of pinned blocks in check.
+        if (is_transaction_full()) {
+            if (auto result = commit(); result.is_error())
+                dbgln("Ext2FSJournal: Failed to commit full transaction: {}", result.error());
+        }
+        // Don't start anything new while a commit is waiting for the running handles to finish.
+        MutexLocker gate(m_commit_lock);
+    }
+
+    m_transaction_lock.lock(Mutex::Mode::Shared);
+    handle.m_journal = this;
+    handle.m_thread = current_thread;
+    m_handles.with([&](auto& handles) { handles.append(handle); });
+}
+
+void Ext2FSJournal::stop_handle(Ext2FSJournalHandle& handle)
+{
+    VERIFY(handle.m_journal == this);
+    m_handles.with([&](auto& handles) { handles.remove(handle); });
+    m_transaction_lock.unlock();
+}
+
+ErrorOr<void> Ext2FSJournal::journal_block(BlockIndex block, UserOrKernelBuffer const& data, size_t count, u64 offset)
+{
+    auto* current_thread = Thread::current();
+    VERIFY(m_committing_thread == current_thread || is_handle_owner(current_thread));
+
+    {
+        MutexLocker locker(m_lock);
+        TRY(m_running.blocks.try_set(block));
+        // The block is part of this transaction again, so its copy in the log will be replaced anyway.
+        m_running.revoked_blocks.remove(block);
+        if (!m_running.started_at.has_value())
+            m_running.started_at = TimeManagement::the().monotonic_time();
+    }
+    return m_fs.write_pinned_block(block, data, count, offset);
+}
+
+ErrorOr<void> Ext2FSJournal::did_free_block(BlockIndex block)
+{
+    MutexLocker locker(m_lock);
+    // Whatever the running transaction did to the block must never hit the disk, as the block is still in use
+    // until the transaction is committed.
+    if (m_running.blocks.remove(block))
+        m_fs.discard_block(block);
+
+    if (m_logged_blocks.contains(block)) {
+        TRY(m_running.revoked_blocks.try_set(block));
+        if (!m_running.started_at.has_value())
+            m_running.started_at = TimeManagement::the().monotonic_time();
+    }
+    return {};
+}
+
+bool Ext2FSJournal::should_commit() const
+{
+    MutexLocker locker(m_lock);
+    if (m_running.is_empty())
+        return false;
+    if (m_running.blocks.size() >= m_max_transaction_blocks / 2)
+        return true;
+    return m_running.started_at.has_value() && TimeManagement::the().monotonic_time() - m_running.started_at.value() >= commit_interval;
+}
+
+ErrorOr<void> Ext2FSJournal::with_handles_locked_out(Function<ErrorOr<void>()> callback)
+{
+    auto* current_thread = Thread::current();
+    VERIFY(!is_handle_owner(current_thread));
+    VERIFY(!m_fs.m_lock.is_exclusively_locked_by_current_thread());
+
+    // Holding the gate keeps new handles from starting, while we wait for the running ones to finish.
+    MutexLocker commit_locker(m_commit_lock);
+    MutexLocker transaction_locker(m_transaction_lock);
+
+    m_committing_thread = current_thread;
+    ScopeGuard clear_committing_thread = [&] { m_committing_thread = nullptr; };
+    return callback();
+}
+
+ErrorOr<void> Ext2FSJournal::commit()
+{
+    return with_handles_locked_out([&] { return commit_while_locked(); });
+}
+
+ErrorOr<void> Ext2FSJournal::checkpoint()
+{
+    return with_handles_locked_out([&]() -> ErrorOr<void> {
+        TRY(commit_while_locked());
+        MutexLocker locker(m_lock);
+        m_fs.flush_writes_impl();
+        return checkpoint_log();
+    });
+}
+
+ErrorOr<void> Ext2FSJournal::checkpoint_log()
+{
+    VERIFY(m_lock.is_locked());
+
+    // Blocks that weren't touched again since the last commit have already been written back by now. The others
+    // are pinned with newer changes, or were freed and thrown out of the cache, so we write back their committed
+    // state from the log. Freed blocks can't have been reused yet, they're only given back once we're done.
+    auto block_storage = TRY(ByteBuffer::create_uninitialized(m_block_size));
+    for (auto const& it : m_logged_blocks) {
+        if (!m_running.blocks.contains(it.key) && !m_running.revoked_blocks.contains(it.key))
+            continue;
+        TRY(read_log_block(it.value.position, block_storage.bytes()));
+        if (it.value.is_escaped)
+            *reinterpret_cast<BigEndian<u32>*>(block_storage.data()) = JBD2_MAGIC_NUMBER;
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(block_storage.data());
+        TRY(m_fs.write_block(it.key, buffer, m_block_size, 0, false));
+    }
+
+    TRY(write_superblock(m_running.sequence, 0));
+    m_head = m_first;
+    m_live_block_count = 0;
+    m_logged_blocks.clear();
+    // There's nothing left in the log that could be replayed over these.
+    m_running.revoked_blocks.clear();
+    return {};
+}
+
+ErrorOr<void> Ext2FSJournal::commit_while_locked()
+{
+    VERIFY(m_committing_thread == Thread::current());
+
+    // Inodes and allocation metadata are kept in memory until they're flushed, so we have to pick up whatever
+    // changed since. No handles are running, so the metadata is consistent right now.
+    TRY(m_fs.flush_metadata_for_commit());
+
+    MutexLocker locker(m_lock);
+    if (m_running.is_empty())
+        return {};
+
+    Vector<BlockIndex> blocks;
+    TRY(blocks.try_ensure_capacity(m_running.blocks.size()));
+    for (auto block : m_running.blocks)
+        blocks.unchecked_append(block);
+    quick_sort(blocks);
+
+    Vector<BlockIndex> revoked_blocks;
+    TRY(revoked_blocks.try_ensure_capacity(m_running.revoked_blocks.size()));
+    for (auto block : m_running.revoked_blocks)
+        revoked_blocks.unchecked_append(block);
+    quick_sort(revoked_blocks);
+
+    // A transaction that doesn't fit into the log is committed in several parts, each of which fills the log at
+    // most. Every part is atomic on its own, but a crash in between leaves only the parts committed so far on the disk.
+    size_t revoke_block_count = ceil_div(revoked_blocks.size(), records_per_revoke_block());
+    if (log_block_count(blocks.size(), revoked_blocks.size()) > log_capacity())
+        dmesgln("Ext2FSJournal: Transaction {} with {} blocks doesn't fit into the log, committing it in parts", m_running.sequence, blocks.size());
+
+    size_t committed_block_count = 0;
+    do {
+        // The revoke records go into the first part, after which nothing they refer to is left in the log.
+        size_t available_block_count = log_capacity() - min(log_capacity(), revoke_block_count + 1);
+        size_t part_size = min(blocks.size() - committed_block_count, available_block_count - ceil_div(available_block_count, tags_per_descriptor() + 1));
+        if (part_size == 0 && committed_block_count < blocks.size()) {
+            dmesgln("Ext2FSJournal: The log is too small to hold even a single block");
+            return ENOSPC;
+        }
+
+        // This is ordered mode: File data has to be on the disk before the metadata that refers to it is committed.
+        // This also writes back the blocks of the previous transaction (or part), as they're not pinned anymore.
+        m_fs.flush_writes_impl();
+
+        TRY(commit_blocks_while_locked(blocks.span().slice(committed_block_count, part_size), revoked_blocks));
+        committed_block_count += part_size;
+        revoked_blocks.clear();
+        revoke_block_count = 0;
+    } while (committed_block_count < blocks.size());
+
+    m_running = Transaction { .sequence = m_running.sequence };
+    return {};
+}
+
+size_t Ext2FSJournal::tags_per_descriptor() const
+{
+    // The first tag of each descriptor is followed by the UUID of the journal.
+    return (m_block_size - sizeof(jbd2_journal_header) - sizeof(jbd2_journal_superblock::s_uuid)) / tag_size();
+}
+
+size_t Ext2FSJournal::records_per_revoke_block() const
+{
+    return (m_block_size - sizeof(jbd2_journal_revoke_header)) / revoke_record_size();
+}
+
+size_t Ext2FSJournal::log_block_count(size_t block_count, size_t revoked_block_count) const
+{
+    return ceil_div(revoked_block_count, records_per_revoke_block()) + ceil_div(block_count, tags_per_descriptor()) + block_count + 1;
+}
+
+ErrorOr<void> Ext2FSJournal::commit_blocks_while_locked(ReadonlySpan<BlockIndex> blocks, Vector<BlockIndex>& revoked_blocks)
+{
+    VERIFY(m_lock.is_locked());
+
+    size_t log_block_count = this->log_block_count(blocks.size(), revoked_blocks.size());
+    VERIFY(log_block_count <= log_capacity());
+    if (log_block_count > log_capacity() - m_live_block_count)
+        TRY(checkpoint_log());
+    // Checkpointing may have made the revoke records unnecessary.
+    if (m_running.revoked_blocks.is_empty() && !revoked_blocks.is_empty()) {
+        log_block_count -= ceil_div(revoked_blocks.size(), records_per_revoke_block());
+        revoked_blocks.clear();
+    }
+
+    auto log = TRY(ByteBuffer::create_zeroed(log_block_count * m_block_size));
+    HashMap<BlockIndex, LoggedBlock> logged_blocks;
+    TRY(logged_blocks.try_ensure_capacity(blocks.size()));
+    u32 start = m_head;
+    size_t next_block = 0;
+
+    auto take_log_block = [&](JBD2BlockType type) {
+        auto bytes = log.bytes().slice(next_block * m_block_size, m_block_size);
+        ++next_block;
+        auto& header = *reinterpret_cast<jbd2_journal_header*>(bytes.data());
+        header.h_magic = JBD2_MAGIC_NUMBER;
+        header.h_blocktype = to_underlying(type);
+        header.h_sequence = m_running.sequence;
+        return bytes;
+    };
+
+    for (size_t i = 0; i < revoked_blocks.size(); i += records_per_revoke_block()) {
+        auto revoke_block = take_log_block(JBD2BlockType::Revoke);
+        size_t record_count = min(records_per_revoke_block(), revoked_blocks.size() - i);
+        reinterpret_cast<jbd2_journal_revoke_header*>(revoke_block.data())->r_count = sizeof(jbd2_journal_revoke_header) + record_count * revoke_record_size();
+        for (size_t j = 0; j < record_count; ++j) {
+            auto* record = revoke_block.offset_pointer(sizeof(jbd2_journal_revoke_header) + j * revoke_record_size());
+            if (revoke_record_size() == sizeof(u64))
+                *reinterpret_cast<BigEndian<u64>*>(record) = revoked_blocks[i + j].value();
+            else
+                *reinterpret_cast<BigEndian<u32>*>(record) = static_cast<u32>(revoked_blocks[i + j].value());
+        }
+    }
+
+    for (size_t i = 0; i < blocks.size(); i += tags_per_descriptor()) {
+        auto descriptor = take_log_block(JBD2BlockType::Descriptor);
+        size_t tag_count = min(tags_per_descriptor(), blocks.size() - i);
+        size_t tag_offset = sizeof(jbd2_journal_header);
+        for (size_t j = 0; j < tag_count; ++j) {
+            auto block = blocks[i + j];
+            u32 position = advance(start, next_block);
+            auto data = log.bytes().slice(next_block * m_block_size, m_block_size);
+            ++next_block;
+
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(data.data());
+            TRY(m_fs.read_block(block, &buffer, m_block_size));
+            // A block that starts with the magic number could be mistaken for one of our own, so we hide it.
+            bool is_escaped = *reinterpret_cast<BigEndian<u32> const*>(data.data()) == JBD2_MAGIC_NUMBER;
+            if (is_escaped)
+                memset(data.data(), 0, sizeof(u32));
+
+            u16 flags = 0;
+            if (is_escaped)
+                flags |= JBD2_FLAG_ESCAPE;
+            if (j != 0)
+                flags |= JBD2_FLAG_SAME_UUID;
+            if (j == tag_count - 1)
+                flags |= JBD2_FLAG_LAST_TAG;
+
+            auto& tag = *reinterpret_cast<jbd2_journal_block_tag*>(descriptor.offset_pointer(tag_offset));
+            tag.t_blocknr = static_cast<u32>(block.value());
+            tag.t_flags = flags;
+            if (has_incompat_feature(JBD2_FEATURE_INCOMPAT_64BIT))
+                tag.t_blocknr_high = static_cast<u32>(block.value() >> 32);
+            tag_offset += tag_size();
+            if (j == 0) {
+                memcpy(descriptor.offset_pointer(tag_offset), superblock().s_uuid, sizeof(superblock().s_uuid));
+                tag_offset += sizeof(superblock().s_uuid);
+            }
+
+            logged_blocks.set(block, { position, is_escaped });
+        }
+    }
+
+    auto commit_block = take_log_block(JBD2BlockType::Commit);
+    auto now = kgettimeofday().to_timespec();
+    auto& commit_header = *reinterpret_cast<jbd2_commit_header*>(commit_block.data());
+    commit_header.h_commit_sec = now.tv_sec;
+    commit_header.h_commit_nsec = now.tv_nsec;
+    VERIFY(next_block == log_block_count);
+
+    // The commit block goes last, so that a transaction that was cut short never looks complete.
+    TRY(write_log_blocks(start, log.bytes().trim(log.size() - m_block_size)));
+    TRY(write_log_blocks(advance(start, log_block_count - 1), commit_block));
+
+    // From here on, the transaction survives a crash, and the previous one isn't needed anymore.
+    TRY(write_superblock(m_running.sequence, start));
+    m_head = advance(start, log_block_count);
+    m_live_block_count = log_block_count;
+    m_logged_blocks = move(logged_blocks);
+
+    for (auto block : blocks) {
+        m_fs.unpin_block(block);
+        m_running.blocks.remove(block);
+    }
+    m_running.revoked_blocks.clear();
+
+    dbgln_if(EXT2_DEBUG, "Ext2FSJournal: Committed transaction {} with {} blocks ({} revoked) at log position {}", m_running.sequence, blocks.size(), revoked_blocks.size(), start);
+    ++m_running.sequence;
+    return {};
+}
+
+}
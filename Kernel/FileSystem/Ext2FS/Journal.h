@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Endian.h>
+#include <AK/Error.h>
+#include <AK/Function.h>
+#include <AK/HashMap.h>
+#include <AK/HashTable.h>
+#include <AK/IntrusiveList.h>
+#include <AK/Optional.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
+#include <Kernel/Locking/Mutex.h>
+#include <Kernel/Locking/SpinlockProtected.h>
+#include <Kernel/Time/TimeManagement.h>
+
+namespace Kernel {
+
+class Ext2FS;
+class Ext2FSJournal;
+
+// The on-disk format of the journal (JBD2). Unlike the rest of the file system, it's big-endian.
+static constexpr u32 JBD2_MAGIC_NUMBER = 0xc03b3998;
+
+enum class JBD2BlockType : u32 {
+    Descriptor = 1,
+    Commit = 2,
+    SuperBlockV1 = 3,
+    SuperBlockV2 = 4,
+    Revoke = 5,
+};
+
+static constexpr u32 JBD2_FEATURE_COMPAT_CHECKSUM = 0x00000001;
+
+static constexpr u32 JBD2_FEATURE_INCOMPAT_REVOKE = 0x00000001;
+static constexpr u32 JBD2_FEATURE_INCOMPAT_64BIT = 0x00000002;
+static constexpr u32 JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT = 0x00000004;
+static constexpr u32 JBD2_FEATURE_INCOMPAT_CSUM_V2 = 0x00000008;
+static constexpr u32 JBD2_FEATURE_INCOMPAT_CSUM_V3 = 0x00000010;
+static constexpr u32 JBD2_FEATURE_INCOMPAT_FAST_COMMIT = 0x00000020;
+
+// We don't know how to checksum anything, so journals that expect checksums are off-limits.
+static constexpr u32 JBD2_KNOWN_INCOMPAT_FEATURES = JBD2_FEATURE_INCOMPAT_REVOKE | JBD2_FEATURE_INCOMPAT_64BIT;
+
+static constexpr u16 JBD2_FLAG_ESCAPE = 1;    // The first four bytes of the block were the magic number
+static constexpr u16 JBD2_FLAG_SAME_UUID = 2; // The tag isn't followed by a UUID
+static constexpr u16 JBD2_FLAG_DELETED = 4;   // Unused
+static constexpr u16 JBD2_FLAG_LAST_TAG = 8;  // The last tag in this descriptor block
+
+struct [[gnu::packed]] jbd2_journal_header {
+    BigEndian<u32> h_magic;
+    BigEndian<u32> h_blocktype;
+    BigEndian<u32> h_sequence;
+};
+
+struct [[gnu::packed]] jbd2_journal_superblock {
+    jbd2_journal_header s_header;
+
+    // Static information describing the journal
+    BigEndian<u32> s_blocksize; // Journal device block size
+    BigEndian<u32> s_maxlen;    // Total blocks in journal file
+    BigEndian<u32> s_first;     // First block of log information
+
+    // Dynamic information describing the current state of the log
+    BigEndian<u32> s_sequence; // First commit ID expected in log
+    BigEndian<u32> s_start;    // Block number of the start of log, 0 if the log is empty
+    BigEndian<u32> s_errno;    // Error value, as set by jbd2_journal_abort()
+
+    // The remaining fields are only valid in a version 2 superblock
+    BigEndian<u32> s_feature_compat;
+    BigEndian<u32> s_feature_incompat;
+    BigEndian<u32> s_feature_ro_compat;
+    u8 s_uuid[16];
+    BigEndian<u32> s_nr_users;
+    BigEndian<u32> s_dynsuper;
+    BigEndian<u32> s_max_transaction;
+    BigEndian<u32> s_max_trans_data;
+};
+
+struct [[gnu::packed]] jbd2_journal_block_tag {
+    BigEndian<u32> t_blocknr;
+    BigEndian<u16> t_checksum;
+    BigEndian<u16> t_flags;
+    BigEndian<u32> t_blocknr_high; // Only present with JBD2_FEATURE_INCOMPAT_64BIT
+};
+
+struct [[gnu::packed]] jbd2_journal_revoke_header {
+    jbd2_journal_header r_header;
+    BigEndian<u32> r_count; // Number of bytes used in the block, including this header
+};
+
+struct [[gnu::packed]] jbd2_commit_header {
+    jbd2_journal_header h_header;
+    u8 h_chksum_type;
+    u8 h_chksum_size;
+    u8 h_padding[2];
+    BigEndian<u32> h_chksum[8];
+    BigEndian<u64> h_commit_sec;
+    BigEndian<u32> h_commit_nsec;
+};
+
+// Every operation that modifies metadata runs within a handle, which ties its changes to the running
+// transaction. The outermost handle of a thread does the work, nested ones don't do anything.
+class Ext2FSJournalHandle {
+    AK_MAKE_NONCOPYABLE(Ext2FSJournalHandle);
+    AK_MAKE_NONMOVABLE(Ext2FSJournalHandle);
+
+public:
+    // Handles that may be started while holding an inode lock must not wait for a commit that's about to begin,
+    // as one of the handles that it's waiting for might be waiting for that very lock.
+    enum class WaitForCommit {
+        Yes,
+        No,
+    };
+
+    explicit Ext2FSJournalHandle(Ext2FS&, WaitForCommit = WaitForCommit::Yes);
+    ~Ext2FSJournalHandle();
+
+private:
+    friend class Ext2FSJournal;
+
+    Ext2FSJournal* m_journal { nullptr };
+    Thread* m_thread { nullptr };
+    IntrusiveListNode<Ext2FSJournalHandle> m_list_node;
+};
+
+// The journal of an ext3/ext4 file system, which lives in an inode of its own.
+//
+// Changes to metadata are grouped into transactions. While a transaction is running, the blocks that it
+// touched are pinned in the disk cache, so that none of its changes can hit their home location early.
+// Committing a transaction first writes back all file data (so that the metadata never points at garbage),
+// then copies the blocks into the log, followed by a commit block. Only after that are the blocks released
+// to be written back to their home location as usual. After a crash, replaying the committed transactions
+// from the log brings the metadata back into a consistent state, without having to look at the rest of the disk.
+class Ext2FSJournal {
+    AK_MAKE_NONCOPYABLE(Ext2FSJournal);
+    AK_MAKE_NONMOVABLE(Ext2FSJournal);
+
+public:
+    using BlockIndex = BlockBasedFileSystem::BlockIndex;
+
+    // The block map translates blocks of the journal inode to blocks of the file system.
+    static ErrorOr<NonnullOwnPtr<Ext2FSJournal>> try_create(Ext2FS&, Vector<BlockIndex> block_map);
+
+    bool needs_recovery() const { return m_start != 0; }
+
+    // Replays all committed transactions in the log and leaves the log empty. This has to happen before anyone
+    // reads anything from the file system, as the blocks on the disk may be outdated.
+    ErrorOr<void> recover();
+
+    // Adds the block to the running transaction, and writes the data into the (pinned) cached block.
+    ErrorOr<void> journal_block(BlockIndex, UserOrKernelBuffer const&, size_t count, u64 offset);
+
+    // Drops the changes that the running transaction made to the block, and makes sure that older copies of it
+    // in the log aren't replayed over whatever it's used for next.
+    ErrorOr<void> did_free_block(BlockIndex);
+
+    // Whether the running transaction is old (or large) enough that it should be committed.
+    bool should_commit() const;
+
+    // Commits the running transaction, waiting for all handles that are part of it to finish first.
+    ErrorOr<void> commit();
+
+    // Commits the running transaction and writes everything back, which leaves the log empty.
+    ErrorOr<void> checkpoint();
+
+private:
+    friend class Ext2FSJournalHandle;
+
+    // Transactions are committed after this long at the latest, which is how much we can lose in a crash.
+    static constexpr Duration commit_interval = Duration::from_seconds(5);
+
+    struct Transaction {
+        u32 sequence { 0 };
+        HashTable<BlockIndex> blocks;
+        HashTable<BlockIndex> revoked_blocks;
+        Optional<MonotonicTime> started_at;
+
+        bool is_empty() const { return blocks.is_empty() && revoked_blocks.is_empty(); }
+    };
+
+    // Where the most recently committed copy of a block lives in the log.
+    struct LoggedBlock {
+        u32 position { 0 };
+        bool is_escaped { false };
+    };
+
+    struct Tag {
+        u64 block { 0 };
+        bool is_escaped { false };
+    };
+
+    Ext2FSJournal(Ext2FS&, Vector<BlockIndex> block_map, ByteBuffer superblock_buffer);
+
+    jbd2_journal_superblock& superblock() { return *reinterpret_cast<jbd2_journal_superblock*>(m_superblock_buffer.data()); }
+    jbd2_journal_superblock const& superblock() const { return *reinterpret_cast<jbd2_journal_superblock const*>(m_superblock_buffer.data()); }
+    bool has_incompat_feature(u32 feature) const;
+
+    size_t tag_size() const;
+    size_t revoke_record_size() const;
+    size_t tags_per_descriptor() const;
+    size_t records_per_revoke_block() const;
+    size_t log_block_count(size_t block_count, size_t revoked_block_count) const;
+    size_t log_capacity() const { return m_last - m_first; }
+    u32 advance(u32 position, size_t count) const;
+
+    ErrorOr<void> read_log_block(u32 position, Bytes);
+    ErrorOr<void> write_log_blocks(u32 position, ReadonlyBytes);
+    ErrorOr<void> write_superblock(u32 sequence, u32 start);
+
+    ErrorOr<Vector<Tag>> parse_descriptor(ReadonlyBytes) const;
+    ErrorOr<void> parse_revoke_block(ReadonlyBytes, Function<ErrorOr<void>(u64)>) const;
+
+    enum class RecoveryPass {
+        Scan,
+        Revoke,
+        Replay,
+    };
+    struct RecoveryInfo {
+        u32 end_sequence { 0 };
+        HashMap<u64, u32> revoked_blocks;
+        size_t replayed_block_count { 0 };
+    };
+    ErrorOr<void> do_recovery_pass(RecoveryPass, RecoveryInfo&);
+
+    bool is_handle_owner(Thread const*) const;
+    void start_handle(Ext2FSJournalHandle&, bool wait_for_commit);
+    void stop_handle(Ext2FSJournalHandle&);
+    bool is_transaction_full() const;
+
+    ErrorOr<void> with_handles_locked_out(Function<ErrorOr<void>()>);
+    ErrorOr<void> commit_while_locked();
+    ErrorOr<void> checkpoint_log();
+    ErrorOr<void> commit_blocks_while_locked(ReadonlySpan<BlockIndex> blocks, Vector<BlockIndex>& revoked_blocks);
+
+    Ext2FS& m_fs;
+    size_t const m_block_size { 0 };
+
+    Vector<BlockIndex> const m_block_map;
+    ByteBuffer m_superblock_buffer;
+
+    u32 const m_first { 0 };
+    u32 const m_last { 0 };
+    u32 m_start { 0 };
+    size_t const m_max_transaction_blocks { 0 };
+
+    // Handles start through this gate, which lets a pending commit hold off new ones.
+    Mutex m_commit_lock { "Ext2FSJournal: Commit"sv };
+    // Handles hold this shared, commits hold it exclusively.
+    Mutex m_transaction_lock { "Ext2FSJournal: Transaction"sv };
+    Atomic<Thread*> m_committing_thread { nullptr };
+
+    // Protects everything below.
+    mutable Mutex m_lock { "Ext2FSJournal"sv };
+
+    Transaction m_running;
+
+    // The log holds at most the most recently committed transaction, which starts at m_start.
+    // Its blocks may not have been written back to their home location yet.
+    u32 m_head { 0 };
+    size_t m_live_block_count { 0 };
+    HashMap<BlockIndex, LoggedBlock> m_logged_blocks;
+
+    SpinlockProtected<IntrusiveList<&Ext2FSJournalHandle::m_list_node>, LockRank::None> m_handles {};
+};
+
+}
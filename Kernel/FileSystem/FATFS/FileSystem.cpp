@@ -91,13 +91,13 @@ u8 DOSBIOSParameterBlock::signature() const
         return m_dos7_block->signature;
 }
 
-ErrorOr<NonnullRefPtr<FileSystem>> FATFS::try_create(OpenFileDescription& file_description, FileSystemSpecificOptions const&)
+ErrorOr<NonnullRefPtr<FileSystem>> FATFS::try_create(OpenFileDescription& file_description, FileSystemSpecificOptions const& filesystem_specific_options)
 {
-    return TRY(adopt_nonnull_ref_or_enomem(new (nothrow) FATFS(file_description)));
+    return TRY(adopt_nonnull_ref_or_enomem(new (nothrow) FATFS(file_description, filesystem_specific_options)));
 }
 
-FATFS::FATFS(OpenFileDescription& file_description)
-    : BlockBasedFileSystem(file_description)
+FATFS::FATFS(OpenFileDescription& file_description, FileSystemSpecificOptions const& filesystem_specific_options)
+    : BlockBasedFileSystem(file_description, filesystem_specific_options)
 {
 }
 
@@ -75,7 +75,7 @@ private:
     // but for now we simply have no other way to properly do it.
     virtual ErrorOr<void> prepare_to_clear_last_mount(Inode&) override { return {}; }
 
-    FATFS(OpenFileDescription&);
+    FATFS(OpenFileDescription&, FileSystemSpecificOptions const&);
 
     static constexpr u8 signature_1 = 0x28;
     static constexpr u8 signature_2 = 0x29;
@@ -115,6 +115,17 @@ ErrorOr<size_t> FIFO::read(OpenFileDescription& fd, u64, UserOrKernelBuffer& buf
     return m_buffer->read(buffer, size);
 }
 
+ErrorOr<size_t> FIFO::read_with(OpenFileDescription& fd, size_t size, Function<ErrorOr<size_t>(UserOrKernelBuffer const&, size_t)> const& callback)
+{
+    if (m_buffer->is_empty()) {
+        if (!m_writers)
+            return 0;
+        if (!fd.is_blocking())
+            return EAGAIN;
+    }
+    return m_buffer->read_with(callback, size);
+}
+
 ErrorOr<size_t> FIFO::write(OpenFileDescription& fd, u64, UserOrKernelBuffer const& buffer, size_t size)
 {
     if (!m_readers)
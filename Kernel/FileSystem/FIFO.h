@@ -32,6 +32,10 @@ public:
     ErrorOr<NonnullRefPtr<OpenFileDescription>> open_direction(Direction);
     ErrorOr<NonnullRefPtr<OpenFileDescription>> open_direction_blocking(Direction);
 
+    // Hands the buffered data to the callback without copying it out of the pipe. Whatever the callback doesn't take stays in the pipe.
+    ErrorOr<size_t> read_with(OpenFileDescription&, size_t, Function<ErrorOr<size_t>(UserOrKernelBuffer const&, size_t)> const&);
+    size_t space_for_writing() const { return m_buffer->space_for_writing(); }
+
 private:
     // ^File
     virtual ErrorOr<size_t> write(OpenFileDescription&, u64, UserOrKernelBuffer const&, size_t) override;
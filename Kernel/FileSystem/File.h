@@ -8,6 +8,7 @@
 
 #include <AK/AtomicRefCounted.h>
 #include <AK/Error.h>
+#include <AK/IntrusiveList.h>
 #include <AK/StringView.h>
 #include <AK/Types.h>
 #include <Kernel/Forward.h>
@@ -21,10 +22,43 @@ namespace Kernel {
 
 class File;
 
+// Observes the readiness of a File without blocking a thread on it.
+// This is what lets an EventPoll keep a persistent interest set instead of
+// registering a blocker with every file on each wait.
+class FileReadinessListener {
+public:
+    virtual ~FileReadinessListener() = default;
+
+    // Called with the FileBlockerSet lock held whenever the block conditions of the File may have changed.
+    // Implementations must not block.
+    virtual void file_readiness_may_have_changed() = 0;
+
+private:
+    friend class FileBlockerSet;
+    IntrusiveListNode<FileReadinessListener> m_blocker_set_list_node;
+};
+
 class FileBlockerSet final : public Thread::BlockerSet {
 public:
     FileBlockerSet() { }
 
+    ~FileBlockerSet()
+    {
+        VERIFY(m_readiness_listeners.is_empty());
+    }
+
+    void add_readiness_listener(FileReadinessListener& listener)
+    {
+        SpinlockLocker lock(m_lock);
+        m_readiness_listeners.append(listener);
+    }
+
+    void remove_readiness_listener(FileReadinessListener& listener)
+    {
+        SpinlockLocker lock(m_lock);
+        m_readiness_listeners.remove(listener);
+    }
+
     virtual bool should_add_blocker(Thread::Blocker& b, void* data) override
     {
         VERIFY(b.blocker_type() == Thread::Blocker::Type::File);
@@ -40,7 +74,12 @@ public:
             auto& blocker = static_cast<Thread::FileBlocker&>(b);
             return blocker.unblock_if_conditions_are_met(false, data);
         });
+        for (auto& listener : m_readiness_listeners)
+            listener.file_readiness_may_have_changed();
     }
+
+private:
+    IntrusiveList<&FileReadinessListener::m_blocker_set_list_node> m_readiness_listeners;
 };
 
 // File is the base class for anything that can be referenced by a OpenFileDescription.
@@ -119,6 +158,8 @@ public:
     virtual bool is_character_device() const { return false; }
     virtual bool is_socket() const { return false; }
     virtual bool is_inode_watcher() const { return false; }
+    virtual bool is_event_poll() const { return false; }
+    virtual bool is_io_ring() const { return false; }
     virtual bool is_mount_file() const { return false; }
     virtual bool is_loop_device() const { return false; }
 
@@ -50,4 +50,10 @@ void FileSystem::sync()
     VirtualFileSystem::sync_filesystems();
 }
 
+void FileSystem::write_back_dirty_data_of_all_file_systems()
+{
+    Inode::sync_all();
+    VirtualFileSystem::write_back_filesystems();
+}
+
 }
@@ -26,6 +26,7 @@ public:
 
     FileSystemID fsid() const { return m_fsid; }
     static void sync();
+    static void write_back_dirty_data_of_all_file_systems();
 
     virtual ErrorOr<void> initialize() = 0;
     virtual StringView class_name() const = 0;
@@ -57,11 +58,15 @@ public:
     };
 
     virtual ErrorOr<void> flush_writes() { return {}; }
+    // Called periodically by the sync task. Unlike flush_writes(), this only has to write back the data that
+    // has been dirty for a while, or that the file system doesn't want to keep around any longer.
+    virtual ErrorOr<void> write_back_dirty_data() { return flush_writes(); }
 
     u64 logical_block_size() const { return m_logical_block_size; }
     size_t fragment_size() const { return m_fragment_size; }
 
     virtual bool is_file_backed() const { return false; }
+    virtual bool is_block_based() const { return false; }
 
     // Converts file types that are used internally by the filesystem to DT_* types
     virtual u8 internal_file_type_to_directory_entry_type(DirectoryEntryView const& entry) const { return entry.file_type; }
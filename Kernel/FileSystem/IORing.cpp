@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <Kernel/FileSystem/IORing.h>
+#include <Kernel/Memory/MemoryManager.h>
+#include <Kernel/Tasks/Process.h>
+
+namespace Kernel {
+
+// The header gets a cache line of its own.
+static constexpr size_t submissions_offset = 64;
+static_assert(sizeof(IORingHeader) <= submissions_offset);
+
+static size_t completions_offset(u32 submission_entries)
+{
+    return submissions_offset + submission_entries * sizeof(IORingSubmission);
+}
+
+ErrorOr<NonnullRefPtr<IORing>> IORing::try_create(u32 submission_entries)
+{
+    VERIFY(is_power_of_two(submission_entries) && submission_entries <= IO_RING_MAX_ENTRIES);
+    // Leave room for the completions of one full submission queue while the process is still busy with another.
+    u32 completion_entries = submission_entries * 2;
+    size_t size = TRY(Memory::page_round_up(completions_offset(submission_entries) + completion_entries * sizeof(IORingCompletion)));
+
+    auto vmobject = TRY(Memory::AnonymousVMObject::try_create_with_size(size, AllocationStrategy::AllocateNow));
+    auto region = TRY(MM.allocate_kernel_region_with_vmobject(*vmobject, size, "IORing"sv, Memory::Region::Access::ReadWrite));
+
+    auto& header = *reinterpret_cast<IORingHeader*>(region->vaddr().as_ptr());
+    header.submission_entries = submission_entries;
+    header.completion_entries = completion_entries;
+    header.submissions_offset = submissions_offset;
+    header.completions_offset = completions_offset(submission_entries);
+    header.size = size;
+
+    return adopt_nonnull_ref_or_enomem(new (nothrow) IORing(move(vmobject), move(region), submission_entries, completion_entries));
+}
+
+IORing::IORing(NonnullLockRefPtr<Memory::AnonymousVMObject> vmobject, NonnullOwnPtr<Memory::Region> region, u32 submission_entries, u32 completion_entries)
+    : m_vmobject(move(vmobject))
+    , m_region(move(region))
+    , m_submission_entries(submission_entries)
+    , m_completion_entries(completion_entries)
+{
+}
+
+IORing::~IORing() = default;
+
+IORingSubmission* IORing::submissions()
+{
+    return reinterpret_cast<IORingSubmission*>(m_region->vaddr().offset(submissions_offset).as_ptr());
+}
+
+IORingCompletion* IORing::completions()
+{
+    return reinterpret_cast<IORingCompletion*>(m_region->vaddr().offset(completions_offset(m_submission_entries)).as_ptr());
+}
+
+ErrorOr<size_t> IORing::submit(size_t max_count, Executor const& execute)
+{
+    MutexLocker locker(m_lock);
+    auto& header = this->header();
+
+    u32 submission_tail = AK::atomic_load(&header.submission_tail, AK::MemoryOrder::memory_order_acquire);
+    if (submission_tail - m_submission_head > m_submission_entries)
+        return EINVAL;
+
+    size_t count = 0;
+    while (count < max_count && m_submission_head != submission_tail) {
+        u32 completion_head = AK::atomic_load(&header.completion_head, AK::MemoryOrder::memory_order_acquire);
+        if (m_completion_tail - completion_head >= m_completion_entries)
+            break;
+
+        // NOTE: We copy the submission out first, so that the process can't change it while we're looking at it.
+        IORingSubmission submission;
+        memcpy(&submission, &submissions()[m_submission_head & (m_submission_entries - 1)], sizeof(submission));
+        ++m_submission_head;
+        AK::atomic_store(&header.submission_head, m_submission_head, AK::MemoryOrder::memory_order_release);
+
+        auto result = execute(submission);
+
+        IORingCompletion completion {
+            .user_data = submission.user_data,
+            .result = result.is_error() ? -static_cast<i64>(result.error().code()) : static_cast<i64>(result.value()),
+        };
+        memcpy(&completions()[m_completion_tail & (m_completion_entries - 1)], &completion, sizeof(completion));
+        ++m_completion_tail;
+        AK::atomic_store(&header.completion_tail, m_completion_tail, AK::MemoryOrder::memory_order_release);
+        ++count;
+    }
+
+    if (count == 0 && max_count > 0 && m_submission_head != submission_tail)
+        return EBUSY;
+    return count;
+}
+
+ErrorOr<File::VMObjectAndMemoryType> IORing::vmobject_and_memory_type_for_mmap(Process&, Memory::VirtualRange const& range, u64& offset, bool shared)
+{
+    // A private mapping would be a copy that the kernel never looks at.
+    if (!shared || offset != 0 || range.size() > m_vmobject->size())
+        return EINVAL;
+
+    return VMObjectAndMemoryType {
+        .vmobject = m_vmobject,
+        .memory_type = Memory::MemoryType::Normal,
+    };
+}
+
+ErrorOr<NonnullOwnPtr<KString>> IORing::pseudo_path(OpenFileDescription const&) const
+{
+    return KString::try_create(":io-ring:"sv);
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Function.h>
+#include <Kernel/API/IORing.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Locking/Mutex.h>
+#include <Kernel/Memory/AnonymousVMObject.h>
+#include <Kernel/Memory/Region.h>
+
+namespace Kernel {
+
+// The kernel side of an I/O ring (see Kernel/API/IORing.h). The ring lives in memory that's mapped into both the
+// kernel and the process, so everything that's read from it has to be treated like any other user-provided data.
+class IORing final : public File {
+public:
+    static ErrorOr<NonnullRefPtr<IORing>> try_create(u32 submission_entries);
+    virtual ~IORing() override;
+
+    using Executor = Function<ErrorOr<FlatPtr>(IORingSubmission const&)>;
+
+    // Carries out up to max_count submissions in order, for as long as there's room for their completions.
+    // Returns how many submissions were consumed, or EBUSY if none could be because the completion queue is full.
+    ErrorOr<size_t> submit(size_t max_count, Executor const&);
+
+    virtual ErrorOr<VMObjectAndMemoryType> vmobject_and_memory_type_for_mmap(Process&, Memory::VirtualRange const&, u64& offset, bool shared) override;
+
+private:
+    IORing(NonnullLockRefPtr<Memory::AnonymousVMObject>, NonnullOwnPtr<Memory::Region>, u32 submission_entries, u32 completion_entries);
+
+    virtual StringView class_name() const override { return "IORing"sv; }
+    virtual bool is_io_ring() const override { return true; }
+    virtual ErrorOr<NonnullOwnPtr<KString>> pseudo_path(OpenFileDescription const&) const override;
+    virtual bool can_read(OpenFileDescription const&, u64) const override { return false; }
+    virtual bool can_write(OpenFileDescription const&, u64) const override { return false; }
+    virtual ErrorOr<size_t> read(OpenFileDescription&, u64, UserOrKernelBuffer&, size_t) override { return ENOTSUP; }
+    virtual ErrorOr<size_t> write(OpenFileDescription&, u64, UserOrKernelBuffer const&, size_t) override { return ENOTSUP; }
+
+    IORingHeader& header() { return *reinterpret_cast<IORingHeader*>(m_region->vaddr().as_ptr()); }
+    IORingSubmission* submissions();
+    IORingCompletion* completions();
+
+    NonnullLockRefPtr<Memory::AnonymousVMObject> m_vmobject;
+    NonnullOwnPtr<Memory::Region> m_region;
+
+    // NOTE: The process can change anything in the shared header, so we only trust our own copies of these.
+    u32 const m_submission_entries { 0 };
+    u32 const m_completion_entries { 0 };
+
+    // Serializes submitters, and protects everything below.
+    Mutex m_lock { "IORing"sv };
+    u32 m_submission_head { 0 };
+    u32 m_completion_tail { 0 };
+};
+
+}
@@ -16,13 +16,13 @@ constexpr u32 first_data_area_block = 16;
 constexpr u32 logical_sector_size = 2048;
 constexpr u32 max_cached_directory_entries = 128;
 
-ErrorOr<NonnullRefPtr<FileSystem>> ISO9660FS::try_create(OpenFileDescription& description, FileSystemSpecificOptions const&)
+ErrorOr<NonnullRefPtr<FileSystem>> ISO9660FS::try_create(OpenFileDescription& description, FileSystemSpecificOptions const& filesystem_specific_options)
 {
-    return TRY(adopt_nonnull_ref_or_enomem(new (nothrow) ISO9660FS(description)));
+    return TRY(adopt_nonnull_ref_or_enomem(new (nothrow) ISO9660FS(description, filesystem_specific_options)));
 }
 
-ISO9660FS::ISO9660FS(OpenFileDescription& description)
-    : BlockBasedFileSystem(description)
+ISO9660FS::ISO9660FS(OpenFileDescription& description, FileSystemSpecificOptions const& filesystem_specific_options)
+    : BlockBasedFileSystem(description, filesystem_specific_options)
 {
     set_logical_block_size(logical_sector_size);
     m_device_block_size = logical_sector_size;
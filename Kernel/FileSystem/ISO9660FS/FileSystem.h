@@ -46,7 +46,7 @@ public:
     ErrorOr<NonnullLockRefPtr<ISO9660FSDirectoryEntry>> directory_entry_for_record(Badge<ISO9660DirectoryIterator>, ISO::DirectoryRecordHeader const* record);
 
 private:
-    ISO9660FS(OpenFileDescription&);
+    ISO9660FS(OpenFileDescription&, FileSystemSpecificOptions const&);
 
     virtual ErrorOr<void> prepare_to_clear_last_mount(Inode&) override;
 
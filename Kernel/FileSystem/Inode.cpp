@@ -16,6 +16,8 @@
 #include <Kernel/FileSystem/VFSRootContext.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/Library/KBufferBuilder.h>
+#include <Kernel/Memory/MemoryManager.h>
+#include <Kernel/Memory/PageCache.h>
 #include <Kernel/Memory/SharedInodeVMObject.h>
 #include <Kernel/Net/LocalSocket.h>
 #include <Kernel/Tasks/Process.h>
@@ -24,6 +26,9 @@ namespace Kernel {
 
 static Singleton<SpinlockProtected<Inode::AllInstancesList, LockRank::None>> s_all_instances;
 
+// How many pages are read from the file system at once when filling the page cache.
+static constexpr size_t page_cache_batch_page_count = 16;
+
 SpinlockProtected<Inode::AllInstancesList, LockRank::None>& Inode::all_instances()
 {
     return s_all_instances;
@@ -80,6 +85,9 @@ Inode::~Inode()
     m_watchers.for_each([&](auto& watcher) {
         watcher->unregister_by_inode({}, identifier());
     });
+
+    if (Memory::PageCache::has_pages())
+        Memory::PageCache::the().remove_pages(*this);
 }
 
 void Inode::will_be_destroyed()
@@ -92,7 +100,11 @@ void Inode::will_be_destroyed()
 ErrorOr<void> Inode::truncate(u64 size)
 {
     MutexLocker locker(m_inode_lock);
-    return truncate_locked(size);
+    auto result = truncate_locked(size);
+    // The page that the file ends in now may still have data past the new end, so that one has to go as well.
+    if (can_use_page_cache())
+        Memory::PageCache::the().remove_pages(*this, size / PAGE_SIZE);
+    return result;
 }
 
 ErrorOr<size_t> Inode::write_bytes(off_t offset, size_t length, UserOrKernelBuffer const& target_buffer, OpenFileDescription* open_description)
@@ -105,15 +117,209 @@ ErrorOr<size_t> Inode::prepare_and_write_bytes_locked(off_t offset, size_t lengt
 {
     VERIFY(m_inode_lock.is_locked());
     TRY(prepare_to_write_data());
-    return write_bytes_locked(offset, length, target_buffer, open_description);
+    auto nwritten = TRY(write_bytes_locked(offset, length, target_buffer, open_description));
+    if (can_use_page_cache())
+        update_page_cache_locked(offset, nwritten, target_buffer);
+    return nwritten;
 }
 
 ErrorOr<size_t> Inode::read_bytes(off_t offset, size_t length, UserOrKernelBuffer& buffer, OpenFileDescription* open_description) const
 {
     MutexLocker locker(m_inode_lock, Mutex::Mode::Shared);
+    // Direct reads are meant to bypass all caches.
+    if (can_use_page_cache() && !(open_description && open_description->is_direct()))
+        return read_bytes_through_page_cache_locked(offset, length, buffer);
     return read_bytes_locked(offset, length, buffer, open_description);
 }
 
+ErrorOr<void> Inode::read_ahead(off_t offset, size_t length) const
+{
+    MutexLocker locker(m_inode_lock, Mutex::Mode::Shared);
+    if (can_use_page_cache())
+        return populate_page_cache_locked(offset, length);
+    return read_ahead_locked(offset, length);
+}
+
+ErrorOr<RefPtr<Memory::PhysicalRAMPage>> Inode::cached_page(u64 page_index) const
+{
+    VERIFY(can_use_page_cache());
+    MutexLocker locker(m_inode_lock, Mutex::Mode::Shared);
+    if (page_index * PAGE_SIZE >= size())
+        return nullptr;
+    auto page = TRY(page_cache_page_locked(page_index));
+    Memory::PageCache::the().did_map_page(*this, page_index);
+    return page;
+}
+
+ErrorOr<size_t> Inode::cached_pages(off_t offset, size_t length, Vector<NonnullRefPtr<Memory::PhysicalRAMPage>>& pages) const
+{
+    VERIFY(can_use_page_cache());
+    MutexLocker locker(m_inode_lock, Mutex::Mode::Shared);
+    auto file_size = size();
+    if (static_cast<u64>(offset) >= file_size)
+        return 0;
+    length = min(length, static_cast<size_t>(file_size - offset));
+
+    auto& page_cache = Memory::PageCache::the();
+    u64 first_page_index = offset / PAGE_SIZE;
+    auto page_count = ceil_div((offset % PAGE_SIZE) + length, static_cast<size_t>(PAGE_SIZE));
+    TRY(pages.try_ensure_capacity(pages.size() + page_count));
+    for (size_t i = 0; i < page_count; ++i) {
+        auto page_index = first_page_index + i;
+        auto page = page_cache.find_page(*this, page_index);
+        if (!page) {
+            TRY(populate_page_cache_locked(page_index * PAGE_SIZE, (page_count - i) * PAGE_SIZE));
+            page = TRY(page_cache_page_locked(page_index));
+        }
+        pages.unchecked_append(page.release_nonnull());
+    }
+    return length;
+}
+
+void Inode::drop_cached_pages(u64 first_page_index, u64 end_page_index) const
+{
+    // NOTE: Pages are only dropped when nobody holds a reference to them, so there's no need to keep readers and writers out.
+    if (!can_use_page_cache() || !Memory::PageCache::has_pages())
+        return;
+    Memory::PageCache::the().remove_unused_pages(*this, first_page_index, end_page_index);
+}
+
+ErrorOr<NonnullRefPtr<Memory::PhysicalRAMPage>> Inode::page_cache_page_locked(u64 page_index) const
+{
+    VERIFY(m_inode_lock.is_locked());
+    auto& page_cache = Memory::PageCache::the();
+    if (auto page = page_cache.find_page(*this, page_index))
+        return page.release_nonnull();
+    return read_pages_into_page_cache_locked(page_index, 1);
+}
+
+// Reads a run of pages from the file system straight into new pages and puts them into the page cache.
+// Returns the cached first page of the run.
+ErrorOr<NonnullRefPtr<Memory::PhysicalRAMPage>> Inode::read_pages_into_page_cache_locked(u64 first_page_index, size_t page_count) const
+{
+    VERIFY(m_inode_lock.is_locked());
+    VERIFY(page_count > 0 && page_count <= page_cache_batch_page_count);
+
+    Vector<NonnullRefPtr<Memory::PhysicalRAMPage>, page_cache_batch_page_count> pages;
+    for (size_t i = 0; i < page_count; ++i)
+        pages.unchecked_append(TRY(MM.allocate_physical_page(Memory::MemoryManager::ShouldZeroFill::No)));
+
+    size_t read_page_count = 0;
+    {
+        auto region = TRY(MM.allocate_kernel_region_with_physical_pages(pages, "Page Cache Fill"sv, Memory::Region::Access::ReadWrite));
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(region->vaddr().as_ptr());
+        auto nread = TRY(read_bytes_for_page_cache_locked(first_page_index * PAGE_SIZE, page_count * PAGE_SIZE, buffer));
+        // The rest of the last page is past the end of the file, which reads as zeroes when it's mapped.
+        read_page_count = max(ceil_div(nread, static_cast<size_t>(PAGE_SIZE)), static_cast<size_t>(1));
+        memset(region->vaddr().as_ptr() + nread, 0, read_page_count * PAGE_SIZE - nread);
+        // The pages may end up being mapped executable, and not all architectures keep their instruction caches coherent with memory.
+        Processor::flush_instruction_cache(region->vaddr(), read_page_count * PAGE_SIZE);
+    }
+
+    auto& page_cache = Memory::PageCache::the();
+    auto first_page = TRY(page_cache.add_page(*this, first_page_index, move(pages[0])));
+    for (size_t i = 1; i < read_page_count; ++i)
+        TRY(page_cache.add_page(*this, first_page_index + i, move(pages[i])));
+    return first_page;
+}
+
+ErrorOr<void> Inode::populate_page_cache_locked(off_t offset, size_t length) const
+{
+    VERIFY(m_inode_lock.is_locked());
+
+    auto file_size = size();
+    if (static_cast<u64>(offset) >= file_size)
+        return {};
+    u64 page_index = offset / PAGE_SIZE;
+    u64 end_page_index = ceil_div(min(static_cast<u64>(offset) + length, static_cast<u64>(file_size)), static_cast<u64>(PAGE_SIZE));
+
+    auto& page_cache = Memory::PageCache::the();
+    while (page_index < end_page_index) {
+        // Find the next run of pages that aren't cached yet, so we can read all of them from the file system at once.
+        while (page_index < end_page_index && page_cache.contains_page(*this, page_index))
+            ++page_index;
+        size_t run_page_count = 0;
+        while (page_index + run_page_count < end_page_index && run_page_count < page_cache_batch_page_count && !page_cache.contains_page(*this, page_index + run_page_count))
+            ++run_page_count;
+        if (run_page_count == 0)
+            break;
+
+        TRY(read_pages_into_page_cache_locked(page_index, run_page_count));
+        page_index += run_page_count;
+    }
+    return {};
+}
+
+ErrorOr<size_t> Inode::read_bytes_through_page_cache_locked(off_t offset, size_t length, UserOrKernelBuffer& buffer) const
+{
+    VERIFY(m_inode_lock.is_locked());
+    auto file_size = size();
+    if (static_cast<u64>(offset) >= file_size)
+        return 0;
+    length = min(length, static_cast<size_t>(file_size - offset));
+
+    auto& page_cache = Memory::PageCache::the();
+    size_t nread = 0;
+    while (nread < length) {
+        auto position = offset + nread;
+        auto first_page_index = position / PAGE_SIZE;
+        auto offset_in_first_page = position % PAGE_SIZE;
+        auto run_size = min(length - nread, page_cache_batch_page_count * PAGE_SIZE - offset_in_first_page);
+        auto run_page_count = ceil_div(offset_in_first_page + run_size, static_cast<size_t>(PAGE_SIZE));
+
+        Vector<NonnullRefPtr<Memory::PhysicalRAMPage>, page_cache_batch_page_count> pages;
+        for (size_t i = 0; i < run_page_count; ++i) {
+            auto page_index = first_page_index + i;
+            auto page = page_cache.find_page(*this, page_index);
+            if (!page) {
+                // Pull in the pages we're about to copy from with as few requests as possible.
+                TRY(populate_page_cache_locked(page_index * PAGE_SIZE, (run_page_count - i) * PAGE_SIZE));
+                page = TRY(page_cache_page_locked(page_index));
+            }
+            pages.unchecked_append(page.release_nonnull());
+        }
+
+        TRY(Memory::PageCache::read_from_pages(pages, offset_in_first_page, buffer.offset(nread), run_size));
+        nread += run_size;
+    }
+    return nread;
+}
+
+void Inode::update_page_cache_locked(off_t offset, size_t length, UserOrKernelBuffer const& data)
+{
+    VERIFY(m_inode_lock.is_exclusively_locked_by_current_thread());
+    auto& page_cache = Memory::PageCache::the();
+    size_t nupdated = 0;
+    while (nupdated < length) {
+        auto position = offset + nupdated;
+        auto first_page_index = position / PAGE_SIZE;
+        auto offset_in_first_page = position % PAGE_SIZE;
+        auto max_run_size = min(length - nupdated, page_cache_batch_page_count * PAGE_SIZE - offset_in_first_page);
+        auto max_run_page_count = ceil_div(offset_in_first_page + max_run_size, static_cast<size_t>(PAGE_SIZE));
+
+        // Only the pages that are cached need to be updated, so we copy into runs of them at once.
+        Vector<NonnullRefPtr<Memory::PhysicalRAMPage>, page_cache_batch_page_count> pages;
+        while (pages.size() < max_run_page_count) {
+            auto page = page_cache.find_page(*this, first_page_index + pages.size());
+            if (!page)
+                break;
+            pages.unchecked_append(page.release_nonnull());
+        }
+        if (pages.is_empty()) {
+            nupdated += min(length - nupdated, PAGE_SIZE - offset_in_first_page);
+            continue;
+        }
+
+        auto run_size = min(max_run_size, pages.size() * PAGE_SIZE - offset_in_first_page);
+        if (Memory::PageCache::write_to_pages(pages, offset_in_first_page, data.offset(nupdated), run_size).is_error()) {
+            // The file system has the new data, so what we have cached from here on can't be trusted anymore.
+            page_cache.remove_pages(*this, first_page_index);
+            return;
+        }
+        nupdated += run_size;
+    }
+}
+
 ErrorOr<size_t> Inode::read_until_filled_or_end(off_t offset, size_t length, UserOrKernelBuffer buffer, OpenFileDescription* open_description) const
 {
     auto remaining_length = length;
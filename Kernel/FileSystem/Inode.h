@@ -56,8 +56,19 @@ public:
     ErrorOr<size_t> write_bytes(off_t, size_t, UserOrKernelBuffer const& data, OpenFileDescription*);
     ErrorOr<size_t> read_bytes(off_t, size_t, UserOrKernelBuffer& buffer, OpenFileDescription*) const;
     ErrorOr<size_t> read_until_filled_or_end(off_t, size_t, UserOrKernelBuffer buffer, OpenFileDescription*) const;
+    ErrorOr<void> read_ahead(off_t, size_t) const;
     ErrorOr<void> truncate(u64);
 
+    // Regular file data goes through the page cache, which read() and write() share with file mappings.
+    virtual bool can_use_page_cache() const { return false; }
+    // Returns the page cache page at the given index, reading it from the file system if needed. Past the end of the file, there's no page.
+    ErrorOr<RefPtr<Memory::PhysicalRAMPage>> cached_page(u64 page_index) const;
+    // Collects the page cache pages that hold the given range, so their data can be handed elsewhere without being copied
+    // out first. Returns how many bytes of the range they hold, which is less than asked for at the end of the file.
+    ErrorOr<size_t> cached_pages(off_t, size_t, Vector<NonnullRefPtr<Memory::PhysicalRAMPage>>&) const;
+    // Drops the cached pages in [first_page_index, end_page_index) that nothing is using, so their memory can go elsewhere.
+    void drop_cached_pages(u64 first_page_index, u64 end_page_index) const;
+
     virtual ErrorOr<void> attach(OpenFileDescription&) { return {}; }
     virtual void detach(OpenFileDescription&) { }
     virtual void did_seek(OpenFileDescription&, off_t) { }
@@ -122,6 +133,10 @@ protected:
 
     virtual ErrorOr<size_t> write_bytes_locked(off_t, size_t, UserOrKernelBuffer const& data, OpenFileDescription*) = 0;
     virtual ErrorOr<size_t> read_bytes_locked(off_t, size_t, UserOrKernelBuffer& buffer, OpenFileDescription*) const = 0;
+    // NOTE: This is only a hint for the file system to pull the given range into its caches.
+    virtual ErrorOr<void> read_ahead_locked(off_t, size_t) const { return {}; }
+    // Reads whole pages that are about to be put into the page cache, so file systems should keep them out of their own caches.
+    virtual ErrorOr<size_t> read_bytes_for_page_cache_locked(off_t offset, size_t count, UserOrKernelBuffer& buffer) const { return read_bytes_locked(offset, count, buffer, nullptr); }
     virtual ErrorOr<void> truncate_locked(u64) { return {}; }
 
 private:
@@ -134,6 +149,12 @@ private:
     };
 
     bool can_apply_flock_impl(flock const&, Optional<OpenFileDescription const&>, Vector<Flock> const& flocks) const;
+
+    ErrorOr<size_t> read_bytes_through_page_cache_locked(off_t, size_t, UserOrKernelBuffer& buffer) const;
+    ErrorOr<NonnullRefPtr<Memory::PhysicalRAMPage>> page_cache_page_locked(u64 page_index) const;
+    ErrorOr<NonnullRefPtr<Memory::PhysicalRAMPage>> read_pages_into_page_cache_locked(u64 first_page_index, size_t page_count) const;
+    ErrorOr<void> populate_page_cache_locked(off_t, size_t) const;
+    void update_page_cache_locked(off_t, size_t, UserOrKernelBuffer const& data);
     ErrorOr<bool> try_apply_flock(Process const&, OpenFileDescription const&, flock const&);
 
     FileSystem& m_file_system;
@@ -5,6 +5,7 @@
  */
 
 #include <AK/StringView.h>
+#include <Kernel/Debug.h>
 #include <Kernel/API/Ioctl.h>
 #include <Kernel/API/POSIX/errno.h>
 #include <Kernel/FileSystem/Inode.h>
@@ -12,9 +13,11 @@
 #include <Kernel/FileSystem/OpenFileDescription.h>
 #include <Kernel/FileSystem/VFSRootContext.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
+#include <Kernel/Memory/MemoryManager.h>
 #include <Kernel/Memory/PrivateInodeVMObject.h>
 #include <Kernel/Memory/SharedInodeVMObject.h>
 #include <Kernel/Tasks/Process.h>
+#include <Kernel/Tasks/WorkQueue.h>
 
 namespace Kernel {
 
@@ -34,10 +37,68 @@ ErrorOr<size_t> InodeFile::read(OpenFileDescription& description, u64 offset, Us
     if (nread > 0) {
         Thread::current()->did_file_read(nread);
         evaluate_block_conditions();
+        if (!description.is_direct()) {
+            if (auto range = description.did_read(offset, nread); range.has_value())
+                schedule_read_ahead(range->offset, range->length);
+            // The page that the read ended in is kept, since the next read most likely picks up from there.
+            if (description.data_is_read_once())
+                m_inode->drop_cached_pages(offset / PAGE_SIZE, (offset + nread) / PAGE_SIZE);
+        }
     }
     return nread;
 }
 
+void InodeFile::schedule_read_ahead(u64 offset, size_t length)
+{
+    if (length == 0 || Checked<off_t>::addition_would_overflow(offset, length))
+        return;
+
+    // NOTE: Read-ahead is only an optimization, so if we can't queue it we simply don't do it.
+    auto result = g_io_work->try_queue([inode = m_inode, offset, length] {
+        if (auto result = inode->read_ahead(offset, length); result.is_error())
+            dbgln_if(READ_AHEAD_DEBUG, "InodeFile: Read-ahead of {} bytes at offset {} of inode {} failed: {}", length, offset, inode->identifier(), result.error());
+    });
+    if (result.is_error())
+        dbgln_if(READ_AHEAD_DEBUG, "InodeFile: Couldn't queue read-ahead for inode {}", m_inode->identifier());
+}
+
+bool InodeFile::can_read_through_page_cache(OpenFileDescription const& description) const
+{
+    return m_inode->can_use_page_cache() && !description.is_direct();
+}
+
+ErrorOr<size_t> InodeFile::read_through_page_cache(OpenFileDescription& description, u64 offset, size_t count, Function<ErrorOr<size_t>(UserOrKernelBuffer const&, size_t)> const& callback)
+{
+    VERIFY(can_read_through_page_cache(description));
+    if (Checked<off_t>::addition_would_overflow(offset, count))
+        return EOVERFLOW;
+
+    Vector<NonnullRefPtr<Memory::PhysicalRAMPage>> pages;
+    auto nread = TRY(m_inode->cached_pages(offset, count, pages));
+    if (nread == 0)
+        return 0;
+
+    size_t ntaken = 0;
+    {
+        // NOTE: We only hold on to the pages, not to the inode lock, so the callback is free to write to this very inode.
+        auto region = TRY(MM.allocate_kernel_region_with_physical_pages(pages, "InodeFile Page Cache Read"sv, Memory::Region::Access::Read));
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(region->vaddr().offset(offset % PAGE_SIZE).as_ptr());
+        ntaken = TRY(callback(buffer, nread));
+    }
+    // Pages that are still referenced by us can't be dropped below.
+    pages.clear();
+
+    if (ntaken > 0) {
+        Thread::current()->did_file_read(ntaken);
+        evaluate_block_conditions();
+        if (auto range = description.did_read(offset, ntaken); range.has_value())
+            schedule_read_ahead(range->offset, range->length);
+        if (description.data_is_read_once())
+            m_inode->drop_cached_pages(offset / PAGE_SIZE, (offset + ntaken) / PAGE_SIZE);
+    }
+    return ntaken;
+}
+
 ErrorOr<size_t> InodeFile::write(OpenFileDescription& description, u64 offset, UserOrKernelBuffer const& data, size_t count)
 {
     if (Checked<off_t>::addition_would_overflow(offset, count))
@@ -48,6 +48,13 @@ public:
     virtual bool is_seekable() const override { return true; }
     virtual bool is_inode() const override { return true; }
 
+    void schedule_read_ahead(u64 offset, size_t length);
+
+    bool can_read_through_page_cache(OpenFileDescription const&) const;
+    // Hands the file data at the given offset to the callback straight from the page cache pages that hold it, without
+    // copying it into a buffer first. Returns how much of it the callback took.
+    ErrorOr<size_t> read_through_page_cache(OpenFileDescription&, u64 offset, size_t count, Function<ErrorOr<size_t>(UserOrKernelBuffer const&, size_t)> const&);
+
 private:
     virtual bool is_regular_file() const override;
 
@@ -24,6 +24,9 @@
 
 namespace Kernel {
 
+static constexpr size_t minimum_read_ahead_window = 16 * KiB;
+static constexpr size_t maximum_read_ahead_window = 512 * KiB;
+
 ErrorOr<NonnullRefPtr<OpenFileDescription>> OpenFileDescription::try_create(Custody& custody)
 {
     auto inode_file = TRY(InodeFile::create(custody.inode()));
@@ -53,6 +56,9 @@ OpenFileDescription::OpenFileDescription(File& file)
 
 OpenFileDescription::~OpenFileDescription()
 {
+    // NOTE: Nobody can add a new interest once the last reference is gone, so this check doesn't need the lock.
+    if (!m_event_poll_interests.is_empty())
+        EventPoll::description_will_be_destroyed({}, m_event_poll_interests);
     m_file->detach(*this);
     // FIXME: Should this error path be observed somehow?
     (void)m_file->close();
@@ -498,6 +504,62 @@ bool OpenFileDescription::is_direct() const
     return m_state.with([](auto& state) { return state.direct; });
 }
 
+OpenFileDescription::AccessPattern OpenFileDescription::access_pattern() const
+{
+    return m_state.with([](auto& state) { return state.access_pattern; });
+}
+
+void OpenFileDescription::set_access_pattern(AccessPattern access_pattern)
+{
+    m_state.with([&](auto& state) {
+        state.access_pattern = access_pattern;
+        state.read_ahead_window = access_pattern == AccessPattern::Sequential ? maximum_read_ahead_window : 0;
+    });
+}
+
+bool OpenFileDescription::data_is_read_once() const
+{
+    return m_state.with([](auto& state) { return state.data_is_read_once; });
+}
+
+void OpenFileDescription::set_data_is_read_once(bool data_is_read_once)
+{
+    m_state.with([&](auto& state) { state.data_is_read_once = data_is_read_once; });
+}
+
+Optional<OpenFileDescription::ReadAheadRange> OpenFileDescription::did_read(u64 offset, size_t count)
+{
+    return m_state.with([&](auto& state) -> Optional<ReadAheadRange> {
+        if (state.access_pattern == AccessPattern::Random)
+            return {};
+
+        auto end = offset + count;
+        bool is_sequential = offset == state.read_ahead_next_offset;
+        state.read_ahead_next_offset = end;
+
+        if (!is_sequential) {
+            // Start over after a seek. Unless we've been told that access is sequential,
+            // wait for the next read to prove it before reading anything ahead.
+            state.read_ahead_end = end;
+            state.read_ahead_window = state.access_pattern == AccessPattern::Sequential ? maximum_read_ahead_window : 0;
+            return {};
+        }
+
+        if (state.read_ahead_window == 0)
+            state.read_ahead_window = minimum_read_ahead_window;
+
+        // Keep at least half a window ahead of the reader so it never catches up with the disk.
+        if (state.read_ahead_end >= end + state.read_ahead_window / 2)
+            return {};
+
+        auto range_start = max(state.read_ahead_end, end);
+        auto range_end = end + state.read_ahead_window;
+        state.read_ahead_end = range_end;
+        state.read_ahead_window = min(state.read_ahead_window * 2, maximum_read_ahead_window);
+        return ReadAheadRange { range_start, static_cast<size_t>(range_end - range_start) };
+    });
+}
+
 bool OpenFileDescription::is_directory() const
 {
     return m_state.with([](auto& state) { return state.is_directory; });
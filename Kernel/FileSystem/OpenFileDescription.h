@@ -10,6 +10,7 @@
 #include <AK/Badge.h>
 #include <AK/RefPtr.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/EventPoll.h>
 #include <Kernel/FileSystem/FIFO.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/InodeMetadata.h>
@@ -63,6 +64,25 @@ public:
 
     bool is_direct() const;
 
+    enum class AccessPattern : u8 {
+        Normal,
+        Sequential,
+        Random,
+    };
+    AccessPattern access_pattern() const;
+    void set_access_pattern(AccessPattern);
+
+    // NOTE: Data that is read only once isn't worth keeping in the page cache after it's been read.
+    bool data_is_read_once() const;
+    void set_data_is_read_once(bool);
+
+    struct ReadAheadRange {
+        u64 offset { 0 };
+        size_t length { 0 };
+    };
+    // NOTE: Files call this after a successful read to learn which range (if any) is worth reading ahead.
+    Optional<ReadAheadRange> did_read(u64 offset, size_t count);
+
     bool is_directory() const;
 
     File& file() { return *m_file; }
@@ -132,6 +152,8 @@ public:
     ErrorOr<void> apply_flock(Process const&, Userspace<flock const*>, ShouldBlock);
     ErrorOr<void> get_flock(Userspace<flock*>) const;
 
+    EventPoll::DescriptionInterestList& event_poll_interests(Badge<EventPoll>) { return m_event_poll_interests; }
+
 private:
     explicit OpenFileDescription(File&);
 
@@ -157,8 +179,16 @@ private:
         bool should_append : 1 { false };
         bool direct : 1 { false };
         FIFO::Direction fifo_direction : 2 { FIFO::Direction::Neither };
+        AccessPattern access_pattern : 2 { AccessPattern::Normal };
+        bool data_is_read_once : 1 { false };
+        u64 read_ahead_next_offset { 0 };
+        u64 read_ahead_end { 0 };
+        size_t read_ahead_window { 0 };
     };
 
     SpinlockProtected<State, LockRank::None> m_state {};
+
+    // The event polls watching this description, protected by the EventPoll interest lock.
+    EventPoll::DescriptionInterestList m_event_poll_interests;
 };
 }
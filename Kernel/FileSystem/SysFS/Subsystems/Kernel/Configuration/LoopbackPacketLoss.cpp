@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/FileSystem/SysFS/Subsystems/Kernel/Configuration/LoopbackPacketLoss.h>
+#include <Kernel/Net/LoopbackAdapter.h>
+#include <Kernel/Sections.h>
+
+namespace Kernel {
+
+UNMAP_AFTER_INIT SysFSLoopbackPacketLoss::SysFSLoopbackPacketLoss(SysFSDirectory const& parent_directory)
+    : SysFSSystemStringVariable(parent_directory)
+{
+}
+
+UNMAP_AFTER_INIT NonnullRefPtr<SysFSLoopbackPacketLoss> SysFSLoopbackPacketLoss::must_create(SysFSDirectory const& parent_directory)
+{
+    return adopt_ref_if_nonnull(new (nothrow) SysFSLoopbackPacketLoss(parent_directory)).release_nonnull();
+}
+
+ErrorOr<NonnullOwnPtr<KString>> SysFSLoopbackPacketLoss::value() const
+{
+    return KString::formatted("{}", LoopbackAdapter::packet_loss_percentage());
+}
+
+void SysFSLoopbackPacketLoss::set_value(NonnullOwnPtr<KString> new_value)
+{
+    // NOTE: Anything that isn't a percentage is ignored, just like writing garbage to the other variables.
+    auto percentage = new_value->view().to_number<u8>();
+    if (!percentage.has_value() || *percentage > 100)
+        return;
+    LoopbackAdapter::set_packet_loss_percentage(*percentage);
+}
+
+mode_t SysFSLoopbackPacketLoss::permissions() const
+{
+    // NOTE: Dropping packets affects every connection on the loopback interface, so only root may change this.
+    return S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+}
+
+}
@@ -7,6 +7,7 @@
 #include <AK/JsonObjectSerializer.h>
 #include <Kernel/API/POSIX/unistd.h>
 #include <Kernel/Devices/Loop/LoopDevice.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/SysFS/Subsystems/Kernel/DiskUsage.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
@@ -42,6 +43,22 @@ ErrorOr<void> SysFSDiskUsage::try_generate(KBufferBuilder& builder)
         TRY(fs_object.add("readonly"sv, fs.is_readonly()));
         TRY(fs_object.add("mount_flags"sv, mount.flags()));
 
+        if (fs.is_block_based()) {
+            auto statistics = static_cast<BlockBasedFileSystem const&>(fs).disk_cache_statistics();
+            auto disk_cache_object = TRY(fs_object.add_object("disk_cache"sv));
+            TRY(disk_cache_object.add("hits"sv, statistics.hits));
+            TRY(disk_cache_object.add("misses"sv, statistics.misses));
+            TRY(disk_cache_object.add("evictions"sv, statistics.evictions));
+            TRY(disk_cache_object.add("read_ahead_blocks"sv, statistics.read_ahead_blocks));
+            TRY(disk_cache_object.add("cached_blocks"sv, statistics.cached_blocks));
+            TRY(disk_cache_object.add("dirty_blocks"sv, statistics.dirty_blocks));
+            TRY(disk_cache_object.add("pinned_blocks"sv, statistics.pinned_blocks));
+            TRY(disk_cache_object.add("capacity_blocks"sv, statistics.capacity_blocks));
+            TRY(disk_cache_object.add("minimum_blocks"sv, statistics.minimum_blocks));
+            TRY(disk_cache_object.add("maximum_blocks"sv, statistics.maximum_blocks));
+            TRY(disk_cache_object.finish());
+        }
+
         if (mount.flags() & MS_SRCHIDDEN) {
             TRY(fs_object.add("source"sv, "unknown"));
         } else {
@@ -5,8 +5,10 @@
  */
 
 #include <AK/JsonObjectSerializer.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/SysFS/Subsystems/Kernel/MemoryStatus.h>
 #include <Kernel/Memory/MemoryManager.h>
+#include <Kernel/Memory/PageCache.h>
 #include <Kernel/Sections.h>
 
 namespace Kernel {
@@ -27,6 +29,8 @@ ErrorOr<void> SysFSMemoryStatus::try_generate(KBufferBuilder& builder)
     get_kmalloc_stats(stats);
 
     auto system_memory = MM.get_system_memory_info();
+    auto writeback = BlockBasedFileSystem::writeback_statistics();
+    auto page_cache = Memory::PageCache::the().statistics();
 
     auto json = TRY(JsonObjectSerializer<>::try_create(builder));
     TRY(json.add("kmalloc_allocated"sv, stats.bytes_allocated));
@@ -35,8 +39,29 @@ ErrorOr<void> SysFSMemoryStatus::try_generate(KBufferBuilder& builder)
     TRY(json.add("physical_available"sv, system_memory.physical_pages - system_memory.physical_pages_used));
     TRY(json.add("physical_committed"sv, system_memory.physical_pages_committed));
     TRY(json.add("physical_uncommitted"sv, system_memory.physical_pages_uncommitted));
+    TRY(json.add("huge_pages_mapped"sv, system_memory.huge_pages_mapped));
+    TRY(json.add("huge_page_allocations"sv, system_memory.huge_page_allocations));
+    TRY(json.add("page_cache_cached"sv, page_cache.cached_pages));
+    TRY(json.add("page_cache_mapped"sv, page_cache.mapped_pages));
+    TRY(json.add("dirty_bytes"sv, writeback.dirty_bytes));
+    TRY(json.add("writeback_bytes"sv, writeback.writeback_bytes));
+    TRY(json.add("throttled_write_count"sv, writeback.throttled_write_count));
     TRY(json.add("kmalloc_call_count"sv, stats.kmalloc_call_count));
     TRY(json.add("kfree_call_count"sv, stats.kfree_call_count));
+    {
+        auto slab_caches = TRY(json.add_array("kmalloc_slab_caches"sv));
+        for (auto const& cache_stats : stats.slab_caches) {
+            auto obj = TRY(slab_caches.add_object());
+            TRY(obj.add("slab_size"sv, cache_stats.slab_size));
+            TRY(obj.add("cached_slabs"sv, cache_stats.cached_slabs));
+            TRY(obj.add("allocation_hits"sv, cache_stats.allocation_hits));
+            TRY(obj.add("allocation_misses"sv, cache_stats.allocation_misses));
+            TRY(obj.add("free_hits"sv, cache_stats.free_hits));
+            TRY(obj.add("free_misses"sv, cache_stats.free_misses));
+            TRY(obj.finish());
+        }
+        TRY(slab_caches.finish());
+    }
     TRY(json.finish());
     return {};
 }
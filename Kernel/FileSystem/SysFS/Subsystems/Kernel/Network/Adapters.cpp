@@ -6,8 +6,10 @@
 
 #include <AK/JsonObjectSerializer.h>
 #include <Kernel/FileSystem/SysFS/Subsystems/Kernel/Network/Adapters.h>
+#include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Net/NetworkingManagement.h>
 #include <Kernel/Sections.h>
+#include <Kernel/Tasks/Thread.h>
 
 namespace Kernel {
 
@@ -51,6 +53,20 @@ ErrorOr<void> SysFSNetworkAdaptersStats::try_generate(KBufferBuilder& builder)
         TRY(obj.add("link_full_duplex"sv, adapter.link_full_duplex()));
         TRY(obj.add("mtu"sv, adapter.mtu()));
         TRY(obj.add("packets_dropped"sv, adapter.packets_dropped()));
+        auto receive_queues = TRY(obj.add_array("receive_queues"sv));
+        TRY(NetworkTask::try_for_each_worker([&](auto const& worker_adapter, size_t queue_index, auto const& thread) -> ErrorOr<void> {
+            if (&worker_adapter != &adapter)
+                return {};
+            auto statistics = adapter.receive_queue_statistics(queue_index);
+            auto queue_object = TRY(receive_queues.add_object());
+            TRY(queue_object.add("index"sv, queue_index));
+            TRY(queue_object.add("worker_tid"sv, thread.tid().value()));
+            TRY(queue_object.add("packets_in"sv, statistics.packets_in));
+            TRY(queue_object.add("packets_dropped"sv, statistics.packets_dropped));
+            TRY(queue_object.finish());
+            return {};
+        }));
+        TRY(receive_queues.finish());
         TRY(obj.finish());
         return {};
     }));
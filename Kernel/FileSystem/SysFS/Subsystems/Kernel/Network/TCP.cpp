@@ -41,6 +41,15 @@ ErrorOr<void> SysFSNetworkTCPStats::try_generate(KBufferBuilder& builder)
         TRY(obj.add("bytes_in"sv, socket.bytes_in()));
         TRY(obj.add("packets_out"sv, socket.packets_out()));
         TRY(obj.add("bytes_out"sv, socket.bytes_out()));
+        TRY(obj.add("congestion_control"sv, socket.congestion_control_name()));
+        TRY(obj.add("congestion_window"sv, socket.congestion_window()));
+        TRY(obj.add("slow_start_threshold"sv, socket.slow_start_threshold()));
+        if (auto smoothed_round_trip_time = socket.smoothed_round_trip_time(); smoothed_round_trip_time.has_value())
+            TRY(obj.add("smoothed_rtt_us"sv, smoothed_round_trip_time->to_microseconds()));
+        TRY(obj.add("retransmit_timeout_ms"sv, socket.retransmit_timeout().to_milliseconds()));
+        TRY(obj.add("retransmits"sv, socket.retransmits()));
+        TRY(obj.add("fast_retransmits"sv, socket.fast_retransmits()));
+        TRY(obj.add("sack_permitted"sv, socket.is_sack_permitted()));
         auto current_process_credentials = Process::current().credentials();
         if (current_process_credentials->is_superuser() || current_process_credentials->uid() == socket.origin_uid()) {
             TRY(obj.add("origin_pid"sv, socket.origin_pid().value()));
@@ -34,6 +34,9 @@ ErrorOr<void> SysFSSystemStatistics::try_generate(KBufferBuilder& builder)
         idle_time += processor.time_spent_idle();
     });
     TRY(json.add("idle_time"sv, idle_time));
+    auto scheduler_statistics = Scheduler::get_statistics();
+    TRY(json.add("scheduler_steals"sv, scheduler_statistics.steals));
+    TRY(json.add("scheduler_migrations"sv, scheduler_statistics.migrations));
     TRY(json.finish());
     return {};
 }
@@ -94,6 +94,7 @@ ErrorOr<NonnullRefPtr<Custody>> resolve_path(Process const&, VFSRootContext cons
 ErrorOr<NonnullRefPtr<Custody>> resolve_path_without_veil(VFSRootContext const&, Credentials const&, StringView path, NonnullRefPtr<Custody> base, RefPtr<Custody>* out_parent = nullptr, int options = 0, int symlink_recursion_level = 0);
 
 void sync_filesystems();
+void write_back_filesystems();
 
 };
 
@@ -27,9 +27,11 @@ class File;
 class FATInode;
 class OpenFileDescription;
 class DisplayConnector;
+class EventPoll;
 class FileSystem;
 class FutexQueue;
 class HostnameContext;
+class IORing;
 class IPv4Socket;
 class Inode;
 class InodeIdentifier;
@@ -10,6 +10,7 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Heap/Heap.h>
 #include <Kernel/Heap/kmalloc.h>
+#include <Kernel/Interrupts/InterruptDisabler.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Library/Panic.h>
 #include <Kernel/Library/StdLib.h>
@@ -29,6 +30,11 @@ static_assert(is_power_of_two(CHUNK_SIZE));
 static constexpr size_t INITIAL_KMALLOC_MEMORY_SIZE = 16 * MiB;
 static constexpr size_t KMALLOC_DEFAULT_ALIGNMENT = 16;
 
+// Number of free slabs each processor keeps around per slabheap, and how many of
+// them are moved from/to the shared slabheap at once when the cache runs empty/full.
+static constexpr size_t KMALLOC_SLAB_CACHE_CAPACITY = 32;
+static constexpr size_t KMALLOC_SLAB_CACHE_BATCH_SIZE = KMALLOC_SLAB_CACHE_CAPACITY / 2;
+
 enum class CallerHasAcquiredLock {
     No,
     Yes,
@@ -108,6 +114,8 @@ public:
         return m_freelist == nullptr;
     }
 
+    size_t slab_size() const { return m_slab_size; }
+
     size_t allocated_bytes() const
     {
         return m_allocated_slabs * m_slab_size;
@@ -233,6 +241,57 @@ private:
     KmallocSlabBlock::List m_full_blocks;
 };
 
+// A small per-processor stack of free slabs belonging to a single slabheap. It is only
+// ever touched by its owning processor with interrupts disabled, which lets most
+// kmalloc() and kfree() calls for small sizes avoid taking s_lock altogether.
+struct KmallocSlabCache {
+    void* slabs[KMALLOC_SLAB_CACHE_CAPACITY] {};
+    size_t count { 0 };
+
+    size_t allocation_hits { 0 };
+    size_t allocation_misses { 0 };
+    size_t free_hits { 0 };
+    size_t free_misses { 0 };
+
+    bool is_empty() const { return count == 0; }
+    bool is_full() const { return count == KMALLOC_SLAB_CACHE_CAPACITY; }
+
+    void refill(KmallocSlabheap& slabheap)
+    {
+        VERIFY(s_lock.is_locked());
+        for (size_t i = 0; i < KMALLOC_SLAB_CACHE_BATCH_SIZE && !is_full(); ++i) {
+            // NOTE: Slabs are scrubbed when they are handed out of the cache.
+            auto* ptr = slabheap.allocate(slabheap.slab_size(), CallerWillInitializeMemory::Yes);
+            if (!ptr)
+                break;
+            slabs[count++] = ptr;
+        }
+    }
+
+    void drain(KmallocSlabheap& slabheap, size_t slab_count)
+    {
+        VERIFY(s_lock.is_locked());
+        for (size_t i = 0; i < slab_count && !is_empty(); ++i)
+            slabheap.deallocate(slabs[--count]);
+    }
+};
+
+struct KmallocProcessorSlabCaches {
+    KmallocSlabCache caches[KMALLOC_SLABHEAP_COUNT];
+};
+
+static constinit KmallocProcessorSlabCaches s_processor_slab_caches[MAX_CPU_COUNT] {};
+
+static bool slab_caches_available()
+{
+#ifdef HAS_ADDRESS_SANITIZER
+    // Cached slabs would bypass the shadow memory bookkeeping done by KmallocSlabBlock.
+    return false;
+#else
+    return Processor::is_initialized();
+#endif
+}
+
 struct KmallocGlobalData {
     static constexpr size_t minimum_subheap_size = 1 * MiB;
 
@@ -268,6 +327,13 @@ struct KmallocGlobalData {
         if (size <= KmallocSlabBlock::block_size * 2 + sizeof(ptrdiff_t) + sizeof(size_t)) {
             // FIXME: We should propagate a freed pointer, to find the specific subheap it belonged to
             //        This would save us iterating over them in the next step and remove a recursion
+            // Slabs sitting in this processor's caches keep their blocks from being purged, so hand them back first.
+            if (slab_caches_available()) {
+                auto& processor_caches = s_processor_slab_caches[Processor::current_id()];
+                for (size_t i = 0; i < KMALLOC_SLABHEAP_COUNT; ++i)
+                    processor_caches.caches[i].drain(slabheaps[i], KMALLOC_SLAB_CACHE_CAPACITY);
+            }
+
             bool did_purge = false;
             for (auto& slabheap : slabheaps) {
                 if (slabheap.try_purge()) {
@@ -423,7 +489,7 @@ struct KmallocGlobalData {
 
     KmallocSubheap::List subheaps;
 
-    KmallocSlabheap slabheaps[6] = { 16, 32, 64, 128, 256, 512 };
+    KmallocSlabheap slabheaps[KMALLOC_SLABHEAP_COUNT] = { 16, 32, 64, 128, 256, 512 };
 
     bool expansion_in_progress { false };
 };
@@ -450,6 +516,91 @@ UNMAP_AFTER_INIT void kmalloc_init()
     s_lock.initialize();
 }
 
+static Optional<size_t> slabheap_index_for_allocation(size_t size, size_t alignment)
+{
+    for (size_t i = 0; i < KMALLOC_SLABHEAP_COUNT; ++i) {
+        auto slab_size = g_kmalloc_global->slabheaps[i].slab_size();
+        if (size <= slab_size && alignment <= slab_size)
+            return i;
+    }
+    return {};
+}
+
+static Optional<size_t> slabheap_index_for_slab(void* ptr, size_t size)
+{
+    if (size > g_kmalloc_global->slabheaps[KMALLOC_SLABHEAP_COUNT - 1].slab_size())
+        return {};
+
+    // NOTE: The slab may have been allocated with a larger alignment than its size, so ask the
+    //       block it lives in rather than going by the size alone.
+    auto* block = (KmallocSlabBlock*)((FlatPtr)ptr & KmallocSlabBlock::block_mask);
+    for (size_t i = 0; i < KMALLOC_SLABHEAP_COUNT; ++i) {
+        if (g_kmalloc_global->slabheaps[i].slab_size() == block->slab_size())
+            return i;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+static void* allocate_from_slab_cache(size_t size, size_t alignment, CallerWillInitializeMemory caller_will_initialize_memory)
+{
+    if (!slab_caches_available())
+        return nullptr;
+
+    auto slabheap_index = slabheap_index_for_allocation(size, alignment);
+    if (!slabheap_index.has_value())
+        return nullptr;
+
+    InterruptDisabler disabler;
+    auto& slabheap = g_kmalloc_global->slabheaps[*slabheap_index];
+    auto& cache = s_processor_slab_caches[Processor::current_id()].caches[*slabheap_index];
+
+    if (cache.is_empty()) {
+        SpinlockLocker lock(s_lock);
+        cache.refill(slabheap);
+        // NOTE: The caller falls back to the slabheap, which counts this call then.
+        if (cache.is_empty())
+            return nullptr;
+        ++cache.allocation_misses;
+    } else {
+        ++cache.allocation_hits;
+    }
+
+    auto* ptr = cache.slabs[--cache.count];
+    if (caller_will_initialize_memory == CallerWillInitializeMemory::No)
+        memset(ptr, KMALLOC_SCRUB_BYTE, slabheap.slab_size());
+    return ptr;
+}
+
+static bool deallocate_to_slab_cache(void* ptr, size_t size)
+{
+    if (!slab_caches_available())
+        return false;
+
+    VERIFY(g_kmalloc_global->is_valid_kmalloc_address(VirtualAddress { ptr }));
+    auto slabheap_index = slabheap_index_for_slab(ptr, size);
+    if (!slabheap_index.has_value())
+        return false;
+
+    InterruptDisabler disabler;
+    auto& slabheap = g_kmalloc_global->slabheaps[*slabheap_index];
+    auto& cache = s_processor_slab_caches[Processor::current_id()].caches[*slabheap_index];
+
+    if (cache.is_full()) {
+        ++cache.free_misses;
+        SpinlockLocker lock(s_lock);
+        // Draining may give whole slab blocks back, which are freed as part of this call, just like in kfree_sized_impl().
+        ++g_nested_kfree_calls;
+        cache.drain(slabheap, KMALLOC_SLAB_CACHE_BATCH_SIZE);
+        --g_nested_kfree_calls;
+    } else {
+        ++cache.free_hits;
+    }
+
+    memset(ptr, KFREE_SCRUB_BYTE, slabheap.slab_size());
+    cache.slabs[cache.count++] = ptr;
+    return true;
+}
+
 static void* kmalloc_impl(size_t size, size_t alignment, CallerWillInitializeMemory caller_will_initialize_memory, CallerHasAcquiredLock caller_has_acquired_lock)
 {
     // Catch bad callers allocating under spinlock.
@@ -460,18 +611,23 @@ static void* kmalloc_impl(size_t size, size_t alignment, CallerWillInitializeMem
     // Alignment must be a power of two.
     VERIFY(is_power_of_two(alignment));
 
-    Optional<SpinlockLocker<Spinlock<Kernel::LockRank::None>>> maybe_lock = {};
-    if (caller_has_acquired_lock == CallerHasAcquiredLock::No)
-        maybe_lock = SpinlockLocker(s_lock);
-
-    ++g_kmalloc_call_count;
-
     if (g_dump_kmalloc_stacks && Kernel::g_kernel_symbols_available.was_set()) {
         dbgln("kmalloc({})", size);
         Kernel::dump_backtrace();
     }
 
-    void* ptr = g_kmalloc_global->allocate(size, alignment, caller_will_initialize_memory);
+    void* ptr = nullptr;
+    if (caller_has_acquired_lock == CallerHasAcquiredLock::No)
+        ptr = allocate_from_slab_cache(size, alignment, caller_will_initialize_memory);
+
+    if (!ptr) {
+        Optional<SpinlockLocker<Spinlock<Kernel::LockRank::None>>> maybe_lock = {};
+        if (caller_has_acquired_lock == CallerHasAcquiredLock::No)
+            maybe_lock = SpinlockLocker(s_lock);
+
+        ++g_kmalloc_call_count;
+        ptr = g_kmalloc_global->allocate(size, alignment, caller_will_initialize_memory);
+    }
 
     Thread* current_thread = Thread::current();
     if (!current_thread)
@@ -502,6 +658,17 @@ void* kcalloc(size_t count, size_t size)
     return ptr;
 }
 
+static void add_kfree_perf_event(void* ptr)
+{
+    Thread* current_thread = Thread::current();
+    if (!current_thread)
+        current_thread = Processor::idle_thread();
+    if (current_thread) {
+        VERIFY(current_thread->is_allocation_enabled());
+        PerformanceManager::add_kfree_perf_event(*current_thread, 0, (FlatPtr)ptr);
+    }
+}
+
 void kfree_sized_impl(void* ptr, size_t size)
 {
     VERIFY(s_lock.is_locked());
@@ -513,15 +680,8 @@ void kfree_sized_impl(void* ptr, size_t size)
     ++g_kfree_call_count;
     ++g_nested_kfree_calls;
 
-    if (g_nested_kfree_calls == 1) {
-        Thread* current_thread = Thread::current();
-        if (!current_thread)
-            current_thread = Processor::idle_thread();
-        if (current_thread) {
-            VERIFY(current_thread->is_allocation_enabled());
-            PerformanceManager::add_kfree_perf_event(*current_thread, 0, (FlatPtr)ptr);
-        }
-    }
+    if (g_nested_kfree_calls == 1)
+        add_kfree_perf_event(ptr);
 
     g_kmalloc_global->deallocate(ptr, size);
     --g_nested_kfree_calls;
@@ -534,6 +694,12 @@ void kfree_sized(void* ptr, size_t size)
         Processor::verify_no_spinlocks_held();
     }
 
+    // NOTE: This is never nested in another kfree(), so the call is always reported.
+    if (ptr && deallocate_to_slab_cache(ptr, size)) {
+        add_kfree_perf_event(ptr);
+        return;
+    }
+
     SpinlockLocker lock(s_lock);
     kfree_sized_impl(ptr, size);
 }
@@ -624,4 +790,25 @@ void get_kmalloc_stats(kmalloc_stats& stats)
     stats.bytes_free = g_kmalloc_global->free_bytes();
     stats.kmalloc_call_count = g_kmalloc_call_count;
     stats.kfree_call_count = g_kfree_call_count;
+
+    for (size_t i = 0; i < KMALLOC_SLABHEAP_COUNT; ++i) {
+        auto& cache_stats = stats.slab_caches[i];
+        cache_stats = {};
+        cache_stats.slab_size = g_kmalloc_global->slabheaps[i].slab_size();
+        for (auto const& processor_caches : s_processor_slab_caches) {
+            auto const& cache = processor_caches.caches[i];
+            cache_stats.cached_slabs += cache.count;
+            cache_stats.allocation_hits += cache.allocation_hits;
+            cache_stats.allocation_misses += cache.allocation_misses;
+            cache_stats.free_hits += cache.free_hits;
+            cache_stats.free_misses += cache.free_misses;
+        }
+
+        // Cached slabs are allocated as far as the slabheaps are concerned, but are free to be handed out.
+        auto cached_bytes = cache_stats.cached_slabs * cache_stats.slab_size;
+        stats.bytes_allocated -= cached_bytes;
+        stats.bytes_free += cached_bytes;
+        stats.kmalloc_call_count += cache_stats.allocation_hits + cache_stats.allocation_misses;
+        stats.kfree_call_count += cache_stats.free_hits + cache_stats.free_misses;
+    }
 }
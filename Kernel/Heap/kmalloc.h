@@ -47,11 +47,23 @@ void kmalloc_init();
 
 void kfree_sized(void*, size_t);
 
+constexpr size_t KMALLOC_SLABHEAP_COUNT = 6;
+
+struct kmalloc_slab_cache_stats {
+    size_t slab_size;
+    size_t cached_slabs;
+    size_t allocation_hits;
+    size_t allocation_misses;
+    size_t free_hits;
+    size_t free_misses;
+};
+
 struct kmalloc_stats {
     size_t bytes_allocated;
     size_t bytes_free;
     size_t kmalloc_call_count;
     size_t kfree_call_count;
+    kmalloc_slab_cache_stats slab_caches[KMALLOC_SLABHEAP_COUNT];
 };
 void get_kmalloc_stats(kmalloc_stats&);
 
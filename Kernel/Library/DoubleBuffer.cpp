@@ -84,6 +84,25 @@ ErrorOr<size_t> DoubleBuffer::read(UserOrKernelBuffer& data, size_t size)
     return read_impl(data, size, locker, true);
 }
 
+ErrorOr<size_t> DoubleBuffer::read_with(Function<ErrorOr<size_t>(UserOrKernelBuffer const&, size_t)> const& callback, size_t size)
+{
+    if (size == 0)
+        return 0;
+    MutexLocker locker(m_lock);
+    if (m_read_buffer_index >= m_read_buffer->size && m_write_buffer->size != 0)
+        flip();
+    if (m_read_buffer_index >= m_read_buffer->size)
+        return 0;
+    size_t readable = min(m_read_buffer->size - m_read_buffer_index, size);
+    auto nread = TRY(callback(UserOrKernelBuffer::for_kernel_buffer(m_read_buffer->data + m_read_buffer_index), readable));
+    VERIFY(nread <= readable);
+    m_read_buffer_index += nread;
+    compute_lockfree_metadata();
+    if (m_unblock_callback && m_space_for_writing > 0)
+        m_unblock_callback();
+    return nread;
+}
+
 ErrorOr<size_t> DoubleBuffer::peek(UserOrKernelBuffer& data, size_t size)
 {
     MutexLocker locker(m_lock);
@@ -35,6 +35,10 @@ public:
         return peek(buffer, size);
     }
 
+    // Hands the readable data to the callback where it is, instead of copying it out first. Only as much as the callback
+    // took is consumed, the rest stays in the buffer.
+    ErrorOr<size_t> read_with(Function<ErrorOr<size_t>(UserOrKernelBuffer const&, size_t)> const&, size_t);
+
     bool is_empty() const { return m_empty; }
 
     size_t space_for_writing() const { return m_space_for_writing; }
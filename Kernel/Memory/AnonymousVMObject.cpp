@@ -138,9 +138,20 @@ AnonymousVMObject::AnonymousVMObject(FixedArray<RefPtr<PhysicalRAMPage>>&& new_p
     , m_unused_committed_pages(move(committed_pages))
 {
     if (strategy == AllocationStrategy::AllocateNow) {
-        // Allocate all pages right now. We know we can get all because we committed the amount needed
-        for (size_t i = 0; i < page_count(); ++i)
-            physical_pages()[i] = m_unused_committed_pages->take_one();
+        // Allocate all pages right now. We know we can get all because we committed the amount needed.
+        // Whole chunks are taken as huge pages for as long as we can find them, so they can be mapped by a single page directory entry.
+        bool should_try_huge_pages = true;
+        size_t i = 0;
+        while (i < page_count()) {
+            if (should_try_huge_pages && i + PAGES_PER_HUGE_PAGE <= page_count()) {
+                if (m_unused_committed_pages->try_take_huge_page(physical_pages().slice(i, PAGES_PER_HUGE_PAGE))) {
+                    i += PAGES_PER_HUGE_PAGE;
+                    continue;
+                }
+                should_try_huge_pages = false;
+            }
+            physical_pages()[i++] = m_unused_committed_pages->take_one();
+        }
     } else {
         auto& initial_page = (strategy == AllocationStrategy::Reserve) ? MM.lazy_committed_page() : MM.shared_zero_page();
         for (size_t i = 0; i < page_count(); ++i)
@@ -267,6 +278,50 @@ NonnullRefPtr<PhysicalRAMPage> AnonymousVMObject::allocate_committed_page(Badge<
     return m_unused_committed_pages->take_one();
 }
 
+bool AnonymousVMObject::try_allocate_huge_page(Badge<Region>, size_t first_page_index)
+{
+    if (is_purgeable() || first_page_index + PAGES_PER_HUGE_PAGE > page_count())
+        return false;
+
+    // Only chunks that are fully committed but haven't been touched yet are replaced, so we never
+    // consume memory that wasn't accounted for, and never have to copy anything.
+    auto is_untouched = [&] {
+        for (size_t i = 0; i < PAGES_PER_HUGE_PAGE; ++i) {
+            if (!m_physical_pages[first_page_index + i]->is_lazy_committed_page())
+                return false;
+        }
+        return true;
+    };
+
+    {
+        SpinlockLocker locker(m_lock);
+        if (!is_untouched())
+            return false;
+    }
+
+    auto pages_or_error = FixedArray<RefPtr<PhysicalRAMPage>>::create(PAGES_PER_HUGE_PAGE);
+    if (pages_or_error.is_error())
+        return false;
+    auto pages = pages_or_error.release_value();
+    if (MM.allocate_huge_page(pages.span()).is_error())
+        return false;
+
+    SpinlockLocker locker(m_lock);
+
+    // Someone else may have faulted in one of these pages while we were clearing the huge page.
+    if (!is_untouched())
+        return false;
+
+    for (size_t i = 0; i < PAGES_PER_HUGE_PAGE; ++i) {
+        // The huge page came out of the uncommitted pool, so give back the commitment of each lazy page it replaces.
+        m_unused_committed_pages->uncommit_one();
+        m_physical_pages[first_page_index + i] = move(pages[i]);
+        if (!m_cow_map.is_null())
+            m_cow_map.set(first_page_index + i, false);
+    }
+    return true;
+}
+
 void AnonymousVMObject::reset_cow_map()
 {
     for (size_t i = 0; i < page_count(); ++i) {
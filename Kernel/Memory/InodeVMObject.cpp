@@ -70,13 +70,17 @@ int InodeVMObject::try_release_clean_pages(int page_amount)
     SpinlockLocker locker(m_lock);
 
     int count = 0;
+    bool released_any_page = false;
     for (size_t i = 0; i < page_count() && count < page_amount; ++i) {
         if (!m_dirty_pages.get(i) && m_physical_pages[i]) {
+            // Pages that are still in the page cache don't give any memory back when we let go of them.
+            if (m_physical_pages[i]->ref_count() == 1)
+                ++count;
             m_physical_pages[i] = nullptr;
-            ++count;
+            released_any_page = true;
         }
     }
-    if (count)
+    if (released_any_page)
         remap_regions_locked();
     return count;
 }
@@ -14,6 +14,7 @@
 #include <Kernel/Arch/RegisterState.h>
 #include <Kernel/Boot/BootInfo.h>
 #include <Kernel/Boot/Multiboot.h>
+#include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/Firmware/DeviceTree/DeviceTree.h>
 #include <Kernel/Heap/kmalloc.h>
@@ -24,6 +25,7 @@
 #include <Kernel/Memory/AnonymousVMObject.h>
 #include <Kernel/Memory/MMIOVMObject.h>
 #include <Kernel/Memory/MemoryManager.h>
+#include <Kernel/Memory/PageCache.h>
 #include <Kernel/Memory/PhysicalRegion.h>
 #include <Kernel/Memory/SharedInodeVMObject.h>
 #include <Kernel/Prekernel/Prekernel.h>
@@ -950,6 +952,17 @@ PhysicalAddress MemoryManager::get_physical_address(PhysicalRAMPage const& physi
     return PhysicalAddress((PhysicalPtr)physical_page_entry_index * PAGE_SIZE);
 }
 
+static bool is_huge_page_directory_entry(PageDirectoryEntry const& pde)
+{
+#if ARCH(X86_64)
+    return pde.is_present() && pde.is_huge();
+#else
+    // FIXME: Support huge page mappings on other architectures.
+    (void)pde;
+    return false;
+#endif
+}
+
 PageTableEntry* MemoryManager::pte(PageDirectory& page_directory, VirtualAddress vaddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
@@ -962,6 +975,8 @@ PageTableEntry* MemoryManager::pte(PageDirectory& page_directory, VirtualAddress
     PageDirectoryEntry const& pde = pd[page_directory_index];
     if (!pde.is_present())
         return nullptr;
+    if (is_huge_page_directory_entry(pde))
+        return nullptr;
 
     return &quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()))[page_table_index];
 }
@@ -976,6 +991,13 @@ PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, Virtual
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
     auto& pde = pd[page_directory_index];
+    if (is_huge_page_directory_entry(pde)) {
+        // Someone wants to change an individual page inside a huge page, so break it up into a regular page table first.
+        if (!split_huge_pde(page_directory, vaddr))
+            return nullptr;
+        pd = quickmap_pd(page_directory, page_directory_table_index);
+        VERIFY(!is_huge_page_directory_entry(pd[page_directory_index]));
+    }
     if (pde.is_present())
         return &quickmap_pt(PhysicalAddress(pde.page_table_base()))[page_table_index];
 
@@ -1017,6 +1039,8 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
     PageDirectoryEntry& pde = pd[page_directory_index];
+    // NOTE: Huge pages only ever cover a whole 2 MiB range owned by a single region, which releases them through release_huge_pde().
+    VERIFY(!is_huge_page_directory_entry(pde));
     if (pde.is_present()) {
         auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
         auto& pte = page_table[page_table_index];
@@ -1040,6 +1064,120 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
     }
 }
 
+PageDirectoryEntry* MemoryManager::ensure_huge_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(page_directory.get_lock().is_locked_by_current_processor());
+    VERIFY(vaddr.get() % HUGE_PAGE_SIZE == 0);
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x1ff;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    auto& pde = pd[page_directory_index];
+    if (is_huge_page_directory_entry(pde))
+        return &pde;
+
+    if (pde.is_present()) {
+        // Page tables of the kernel page directory may have been set up during boot instead of by ensure_pte(),
+        // so we can't tell whether they're ours to free.
+        if (&page_directory == m_kernel_page_directory.ptr())
+            return nullptr;
+
+        // The caller owns the entire 2 MiB range, so anything left in this page table belongs to it and is about to be replaced.
+        // NOTE: Other processors may still be walking the page table, so it may only be freed once all of them have forgotten about it.
+        auto page_table_paddr = PhysicalAddress { pde.page_table_base() };
+        pde.clear();
+        flush_tlb(&page_directory, vaddr, PAGES_PER_HUGE_PAGE);
+        // NOTE: This matches the leaked ref in MemoryManager::ensure_pte(), just like the unref in MemoryManager::release_pte().
+        get_physical_page_entry(page_table_paddr).allocated.physical_page.unref();
+    }
+
+    m_global_data.with([&](auto& global_data) {
+        ++global_data.system_memory_info.huge_pages_mapped;
+    });
+    return &pde;
+}
+
+bool MemoryManager::release_huge_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(page_directory.get_lock().is_locked_by_current_processor());
+    VERIFY(vaddr.get() % HUGE_PAGE_SIZE == 0);
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x1ff;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    auto& pde = pd[page_directory_index];
+    if (!is_huge_page_directory_entry(pde))
+        return false;
+
+    pde.clear();
+    m_global_data.with([&](auto& global_data) {
+        VERIFY(global_data.system_memory_info.huge_pages_mapped > 0);
+        --global_data.system_memory_info.huge_pages_mapped;
+    });
+    return true;
+}
+
+bool MemoryManager::split_huge_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+#if ARCH(X86_64)
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(page_directory.get_lock().is_locked_by_current_processor());
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x1ff;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+    auto huge_page_vaddr = VirtualAddress { vaddr.get() & ~(HUGE_PAGE_SIZE - 1) };
+
+    bool did_purge = false;
+    auto page_table_or_error = allocate_physical_page(ShouldZeroFill::No, &did_purge);
+    if (page_table_or_error.is_error()) {
+        dbgln("MM: Unable to allocate page table to split huge page at {}", huge_page_vaddr);
+        return false;
+    }
+    auto page_table = page_table_or_error.release_value();
+
+    // NOTE: If any memory had to be purged, the pd may have been quickmapped again in the meantime.
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    auto& pde = pd[page_directory_index];
+    VERIFY(is_huge_page_directory_entry(pde));
+
+    auto* ptes = quickmap_pt(page_table->paddr());
+    for (size_t i = 0; i < PAGES_PER_HUGE_PAGE; ++i) {
+        auto& pte = ptes[i];
+        pte.clear();
+        pte.set_physical_page_base(pde.page_table_base() + i * PAGE_SIZE);
+        pte.set_writable(pde.is_writable());
+        pte.set_user_allowed(pde.is_user_allowed());
+        if (Processor::current().has_nx())
+            pte.set_execute_disabled(pde.is_execute_disabled());
+        pte.set_present(true);
+    }
+
+    pde.clear();
+    pde.set_page_table_base(page_table->paddr().get());
+    pde.set_user_allowed(true);
+    pde.set_present(true);
+    pde.set_writable(true);
+    pde.set_global(&page_directory == m_kernel_page_directory.ptr());
+
+    // NOTE: This leaked ref is matched by the unref in MemoryManager::release_pte()
+    (void)page_table.leak_ref();
+
+    m_global_data.with([&](auto& global_data) {
+        VERIFY(global_data.system_memory_info.huge_pages_mapped > 0);
+        --global_data.system_memory_info.huge_pages_mapped;
+    });
+
+    // The translations didn't change, but the processor must not keep using the old 2 MiB TLB entry alongside the new 4 KiB ones.
+    flush_tlb(&page_directory, huge_page_vaddr, PAGES_PER_HUGE_PAGE);
+    return true;
+#else
+    (void)page_directory;
+    (void)vaddr;
+    VERIFY_NOT_REACHED();
+#endif
+}
+
 UNMAP_AFTER_INIT void MemoryManager::initialize(u32 cpu)
 {
     ProcessorSpecific<MemoryManagerData>::initialize();
@@ -1168,6 +1306,33 @@ PageFaultResponse MemoryManager::handle_page_fault(PageFault const& fault)
     return response;
 }
 
+ErrorOr<void> MemoryManager::prefault_user_range(Process& process, VirtualRange const& range)
+{
+    VERIFY(range.base().is_page_aligned());
+    VERIFY(range.size() % PAGE_SIZE == 0);
+
+    auto vaddr = range.base();
+    while (vaddr < range.end()) {
+        // NOTE: Populating a region may block on inode reads, so we pin it the same way handle_page_fault() does.
+        auto* region = process.address_space().with([&](auto& space) -> Region* {
+            auto* region = find_user_region_from_vaddr(*space, vaddr);
+            if (!region)
+                return nullptr;
+            region->start_handling_page_fault({});
+            return region;
+        });
+        if (!region)
+            return ENOMEM;
+
+        auto end = min(range.end(), region->range().end());
+        auto result = region->prefault(region->page_index_from_address(vaddr), (end - vaddr).get() / PAGE_SIZE);
+        region->finish_handling_page_fault({});
+        TRY(result);
+        vaddr = end;
+    }
+    return {};
+}
+
 ErrorOr<NonnullOwnPtr<Region>> MemoryManager::allocate_contiguous_kernel_region(size_t size, StringView name, Region::Access access, MemoryType memory_type)
 {
     VERIFY(!(size % PAGE_SIZE));
@@ -1220,7 +1385,9 @@ ErrorOr<NonnullOwnPtr<Region>> MemoryManager::allocate_kernel_region(size_t size
         name_kstring = TRY(KString::try_create(name));
     auto vmobject = TRY(AnonymousVMObject::try_create_with_size(size, strategy));
     auto region = TRY(Region::create_unplaced(move(vmobject), 0, move(name_kstring), access, memory_type));
-    TRY(m_global_data.with([&](auto& global_data) { return global_data.region_tree.place_anywhere(*region, RandomizeVirtualAddress::No, size); }));
+    // Large eagerly allocated regions are likely backed by huge pages, which can only be mapped at huge page aligned addresses.
+    auto alignment = (strategy == AllocationStrategy::AllocateNow && size >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    TRY(m_global_data.with([&](auto& global_data) { return global_data.region_tree.place_anywhere(*region, RandomizeVirtualAddress::No, size, alignment); }));
     TRY(region->map(kernel_page_directory()));
     return region;
 }
@@ -1267,38 +1434,49 @@ ErrorOr<NonnullOwnPtr<Region>> MemoryManager::allocate_kernel_region_with_vmobje
 ErrorOr<CommittedPhysicalPageSet> MemoryManager::commit_physical_pages(size_t page_count)
 {
     VERIFY(page_count > 0);
-    auto result = m_global_data.with([&](auto& global_data) -> ErrorOr<CommittedPhysicalPageSet> {
-        if (global_data.system_memory_info.physical_pages_uncommitted < page_count) {
-            dbgln("MM: Unable to commit {} pages, have only {}", page_count, global_data.system_memory_info.physical_pages_uncommitted);
-            return ENOMEM;
-        }
-
-        global_data.system_memory_info.physical_pages_uncommitted -= page_count;
-        global_data.system_memory_info.physical_pages_committed += page_count;
-        return CommittedPhysicalPageSet { {}, page_count };
-    });
-    if (result.is_error()) {
-        Process::for_each_ignoring_process_lists([&](Process const& process) {
-            size_t amount_resident = 0;
-            size_t amount_shared = 0;
-            size_t amount_virtual = 0;
-            process.address_space().with([&](auto& space) {
-                amount_resident = space->amount_resident();
-                amount_shared = space->amount_shared();
-                amount_virtual = space->amount_virtual();
-            });
-            process.name().with([&](auto& process_name) {
-                dbgln("{}({}) resident:{}, shared:{}, virtual:{}",
-                    process_name.representable_view(),
-                    process.pid(),
-                    amount_resident / PAGE_SIZE,
-                    amount_shared / PAGE_SIZE,
-                    amount_virtual / PAGE_SIZE);
-            });
-            return IterationDecision::Continue;
+    size_t uncommitted_page_count = 0;
+    auto try_to_commit = [&] {
+        return m_global_data.with([&](auto& global_data) -> ErrorOr<CommittedPhysicalPageSet> {
+            uncommitted_page_count = global_data.system_memory_info.physical_pages_uncommitted;
+            if (uncommitted_page_count < page_count)
+                return ENOMEM;
+
+            global_data.system_memory_info.physical_pages_uncommitted -= page_count;
+            global_data.system_memory_info.physical_pages_committed += page_count;
+            return CommittedPhysicalPageSet { {}, page_count };
         });
+    };
+    if (auto result = try_to_commit(); !result.is_error())
+        return result;
+
+    // Cached file data can always be read again, so we give back as much of it as we're short before failing.
+    // NOTE: This has to happen without holding the lock, as dropping a page returns it to us.
+    if (PageCache::has_pages() && PageCache::the().reclaim(page_count - uncommitted_page_count) > 0) {
+        if (auto result = try_to_commit(); !result.is_error())
+            return result;
     }
-    return result;
+
+    dbgln("MM: Unable to commit {} pages, have only {}", page_count, uncommitted_page_count);
+    Process::for_each_ignoring_process_lists([&](Process const& process) {
+        size_t amount_resident = 0;
+        size_t amount_shared = 0;
+        size_t amount_virtual = 0;
+        process.address_space().with([&](auto& space) {
+            amount_resident = space->amount_resident();
+            amount_shared = space->amount_shared();
+            amount_virtual = space->amount_virtual();
+        });
+        process.name().with([&](auto& process_name) {
+            dbgln("{}({}) resident:{}, shared:{}, virtual:{}",
+                process_name.representable_view(),
+                process.pid(),
+                amount_resident / PAGE_SIZE,
+                amount_shared / PAGE_SIZE,
+                amount_virtual / PAGE_SIZE);
+        });
+        return IterationDecision::Continue;
+    });
+    return ENOMEM;
 }
 
 void MemoryManager::uncommit_physical_pages(Badge<CommittedPhysicalPageSet>, size_t page_count)
@@ -1363,6 +1541,68 @@ RefPtr<PhysicalRAMPage> MemoryManager::find_free_physical_page(bool committed, G
     return page;
 }
 
+Optional<PhysicalAddress> MemoryManager::find_free_huge_page(bool committed, GlobalData& global_data)
+{
+    if (committed) {
+        VERIFY(global_data.system_memory_info.physical_pages_committed >= PAGES_PER_HUGE_PAGE);
+    } else if (global_data.system_memory_info.physical_pages_uncommitted < PAGES_PER_HUGE_PAGE) {
+        return {};
+    }
+
+    for (auto& region : global_data.physical_regions) {
+        auto base = region->take_aligned_free_block(PAGES_PER_HUGE_PAGE);
+        if (!base.has_value())
+            continue;
+        if (committed)
+            global_data.system_memory_info.physical_pages_committed -= PAGES_PER_HUGE_PAGE;
+        else
+            global_data.system_memory_info.physical_pages_uncommitted -= PAGES_PER_HUGE_PAGE;
+        global_data.system_memory_info.physical_pages_used += PAGES_PER_HUGE_PAGE;
+        ++global_data.system_memory_info.huge_page_allocations;
+        return base;
+    }
+
+    // Not finding a free huge page is expected once physical memory gets fragmented, callers fall back to regular pages.
+    return {};
+}
+
+void MemoryManager::initialize_huge_page(PhysicalAddress base, Span<RefPtr<PhysicalRAMPage>> pages)
+{
+    VERIFY(pages.size() == PAGES_PER_HUGE_PAGE);
+    VERIFY(base.get() % HUGE_PAGE_SIZE == 0);
+
+    // NOTE: The pages of a huge page are reference counted individually, and go back to the buddy allocator one by one.
+    for (size_t i = 0; i < PAGES_PER_HUGE_PAGE; ++i) {
+        pages[i] = PhysicalRAMPage::create(base.offset(i * PAGE_SIZE));
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(*pages[i]);
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
+}
+
+bool MemoryManager::allocate_committed_huge_page(Badge<CommittedPhysicalPageSet>, Span<RefPtr<PhysicalRAMPage>> pages)
+{
+    auto base = m_global_data.with([&](auto& global_data) {
+        return find_free_huge_page(true, global_data);
+    });
+    if (!base.has_value())
+        return false;
+    initialize_huge_page(base.value(), pages);
+    return true;
+}
+
+ErrorOr<void> MemoryManager::allocate_huge_page(Span<RefPtr<PhysicalRAMPage>> pages)
+{
+    auto base = m_global_data.with([&](auto& global_data) {
+        return find_free_huge_page(false, global_data);
+    });
+    if (!base.has_value())
+        return ENOMEM;
+    initialize_huge_page(base.value(), pages);
+    return {};
+}
+
 NonnullRefPtr<PhysicalRAMPage> MemoryManager::allocate_committed_physical_page(Badge<CommittedPhysicalPageSet>, ShouldZeroFill should_zero_fill)
 {
     auto page = m_global_data.with([&](auto& global_data) {
@@ -1382,6 +1622,16 @@ NonnullRefPtr<PhysicalRAMPage> MemoryManager::allocate_committed_physical_page(B
 
 ErrorOr<NonnullRefPtr<PhysicalRAMPage>> MemoryManager::allocate_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge, MemoryType memory_type_for_zero_fill)
 {
+    // Cached file data can always be read again, so we start giving it back well before we run out of pages.
+    // NOTE: This has to happen before we take the lock, as dropping a page returns it to us.
+    static constexpr size_t page_cache_reclaim_page_count = 32;
+    if (is_under_memory_pressure()) {
+        if (PageCache::has_pages())
+            PageCache::the().reclaim(page_cache_reclaim_page_count);
+        // The disk cache can only be shrunk from a context that may block, so the sync task takes care of that.
+        BlockBasedFileSystem::request_disk_cache_memory_release();
+    }
+
     return m_global_data.with([&](auto& global_data) -> ErrorOr<NonnullRefPtr<PhysicalRAMPage>> {
         auto page = find_free_physical_page(false, global_data);
         bool purged_pages = false;
@@ -1633,6 +1883,16 @@ NonnullRefPtr<PhysicalRAMPage> CommittedPhysicalPageSet::take_one()
     return MM.allocate_committed_physical_page({}, MemoryManager::ShouldZeroFill::Yes);
 }
 
+bool CommittedPhysicalPageSet::try_take_huge_page(Span<RefPtr<PhysicalRAMPage>> pages)
+{
+    if (m_page_count < PAGES_PER_HUGE_PAGE)
+        return false;
+    if (!MM.allocate_committed_huge_page({}, pages))
+        return false;
+    m_page_count -= PAGES_PER_HUGE_PAGE;
+    return true;
+}
+
 void CommittedPhysicalPageSet::uncommit_one()
 {
     VERIFY(m_page_count > 0);
@@ -1672,4 +1932,11 @@ MemoryManager::SystemMemoryInfo MemoryManager::get_system_memory_info()
         return global_data.system_memory_info;
     });
 }
+
+bool MemoryManager::is_under_memory_pressure()
+{
+    // Consider memory to be tight once less than 1/16 of all physical pages are left to be handed out.
+    auto info = get_system_memory_info();
+    return info.physical_pages_uncommitted < info.physical_pages / 16;
+}
 }
@@ -34,6 +34,11 @@ constexpr FlatPtr page_round_down(FlatPtr x)
     return x & ~(PAGE_SIZE - 1);
 }
 
+// A huge page is mapped by a single page directory entry instead of a full page table.
+// It has to be backed by a physically contiguous block that is aligned to its own size.
+static constexpr size_t HUGE_PAGE_SIZE = 2 * MiB;
+static constexpr size_t PAGES_PER_HUGE_PAGE = HUGE_PAGE_SIZE / PAGE_SIZE;
+
 inline FlatPtr virtual_to_low_physical(FlatPtr virtual_)
 {
     return virtual_ - g_boot_info.physical_to_virtual_offset;
@@ -116,6 +121,7 @@ public:
     size_t page_count() const { return m_page_count; }
 
     [[nodiscard]] NonnullRefPtr<PhysicalRAMPage> take_one();
+    [[nodiscard]] bool try_take_huge_page(Span<RefPtr<PhysicalRAMPage>>);
     void uncommit_one();
 
     void operator=(CommittedPhysicalPageSet&&) = delete;
@@ -126,6 +132,7 @@ private:
 
 class MemoryManager {
     friend class PageDirectory;
+    friend class PageCache;
     friend class AnonymousVMObject;
     friend class Region;
     friend class RegionTree;
@@ -144,6 +151,7 @@ public:
     }
 
     PageFaultResponse handle_page_fault(PageFault const&);
+    ErrorOr<void> prefault_user_range(Process&, VirtualRange const&);
 
     void set_page_writable_direct(VirtualAddress, bool);
 
@@ -166,8 +174,10 @@ public:
     void uncommit_physical_pages(Badge<CommittedPhysicalPageSet>, size_t page_count);
 
     NonnullRefPtr<PhysicalRAMPage> allocate_committed_physical_page(Badge<CommittedPhysicalPageSet>, ShouldZeroFill = ShouldZeroFill::Yes);
+    [[nodiscard]] bool allocate_committed_huge_page(Badge<CommittedPhysicalPageSet>, Span<RefPtr<PhysicalRAMPage>>);
     ErrorOr<NonnullRefPtr<PhysicalRAMPage>> allocate_physical_page(ShouldZeroFill = ShouldZeroFill::Yes, bool* did_purge = nullptr, MemoryType memory_type_for_zero_fill = MemoryType::Normal);
     ErrorOr<Vector<NonnullRefPtr<PhysicalRAMPage>>> allocate_contiguous_physical_pages(size_t size, MemoryType memory_type_for_zero_fill);
+    ErrorOr<void> allocate_huge_page(Span<RefPtr<PhysicalRAMPage>>);
     void deallocate_physical_page(PhysicalAddress);
 
     ErrorOr<NonnullOwnPtr<Region>> allocate_contiguous_kernel_region(size_t, StringView name, Region::Access access, MemoryType = MemoryType::Normal);
@@ -187,9 +197,12 @@ public:
         PhysicalSize physical_pages_used { 0 };
         PhysicalSize physical_pages_committed { 0 };
         PhysicalSize physical_pages_uncommitted { 0 };
+        size_t huge_pages_mapped { 0 };
+        size_t huge_page_allocations { 0 };
     };
 
     SystemMemoryInfo get_system_memory_info();
+    bool is_under_memory_pressure();
 
     template<IteratorFunction<VMObject&> Callback>
     static void for_each_vmobject(Callback callback)
@@ -268,6 +281,8 @@ private:
     static void flush_tlb(PageDirectory const*, VirtualAddress, size_t page_count = 1);
 
     RefPtr<PhysicalRAMPage> find_free_physical_page(bool, GlobalData&);
+    Optional<PhysicalAddress> find_free_huge_page(bool, GlobalData&);
+    void initialize_huge_page(PhysicalAddress, Span<RefPtr<PhysicalRAMPage>>);
 
     ALWAYS_INLINE u8* quickmap_page(PhysicalRAMPage& page, MemoryType memory_type = Memory::MemoryType::Normal)
     {
@@ -287,6 +302,11 @@ private:
     };
     void release_pte(PageDirectory&, VirtualAddress, IsLastPTERelease);
 
+    // Returns nullptr if a page table that can't be freed is in the way.
+    PageDirectoryEntry* ensure_huge_pde(PageDirectory&, VirtualAddress);
+    bool release_huge_pde(PageDirectory&, VirtualAddress);
+    bool split_huge_pde(PageDirectory&, VirtualAddress);
+
     // NOTE: These are outside of GlobalData as they are only assigned on startup,
     //       and then never change. Atomic ref-counting covers that case without
     //       the need for additional synchronization.
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/Interrupts/InterruptDisabler.h>
+#include <Kernel/Library/StdLib.h>
+#include <Kernel/Library/UserOrKernelBuffer.h>
+#include <Kernel/Memory/MemoryManager.h>
+#include <Kernel/Memory/PageCache.h>
+
+namespace Kernel::Memory {
+
+static Singleton<PageCache> s_the;
+
+PageCache& PageCache::the()
+{
+    return s_the;
+}
+
+bool PageCache::has_pages()
+{
+    return s_the.is_initialized() && s_the->m_page_count.load(AK::MemoryOrder::memory_order_relaxed) != 0;
+}
+
+RefPtr<PhysicalRAMPage> PageCache::find_page(Inode const& inode, u64 page_index)
+{
+    SpinlockLocker locker(m_lock);
+    auto inode_pages = m_inodes.get(&inode);
+    if (!inode_pages.has_value())
+        return nullptr;
+    auto cached_page = inode_pages.value()->get(page_index);
+    if (!cached_page.has_value())
+        return nullptr;
+    m_lru_list.append(*cached_page.value());
+    return cached_page.value()->page;
+}
+
+bool PageCache::contains_page(Inode const& inode, u64 page_index) const
+{
+    SpinlockLocker locker(m_lock);
+    auto inode_pages = m_inodes.get(&inode);
+    return inode_pages.has_value() && inode_pages.value()->contains(page_index);
+}
+
+ErrorOr<NonnullRefPtr<PhysicalRAMPage>> PageCache::add_page(Inode const& inode, u64 page_index, NonnullRefPtr<PhysicalRAMPage> new_page)
+{
+    auto cached_page = TRY(adopt_nonnull_own_or_enomem(new (nothrow) CachedPage { inode, page_index, new_page, false, {} }));
+
+    SpinlockLocker locker(m_lock);
+    auto inode_pages = m_inodes.get(&inode);
+    if (!inode_pages.has_value()) {
+        auto new_inode_pages = TRY(adopt_nonnull_own_or_enomem(new (nothrow) InodePages));
+        TRY(m_inodes.try_set(&inode, move(new_inode_pages)));
+        inode_pages = m_inodes.get(&inode);
+    }
+    if (auto existing_page = inode_pages.value()->get(page_index); existing_page.has_value()) {
+        m_lru_list.append(*existing_page.value());
+        return existing_page.value()->page;
+    }
+
+    auto& cached_page_ref = *cached_page;
+    TRY(inode_pages.value()->try_set(page_index, move(cached_page)));
+    m_lru_list.append(cached_page_ref);
+    m_page_count.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+    return new_page;
+}
+
+void PageCache::did_map_page(Inode const& inode, u64 page_index)
+{
+    SpinlockLocker locker(m_lock);
+    auto inode_pages = m_inodes.get(&inode);
+    if (!inode_pages.has_value())
+        return;
+    auto cached_page = inode_pages.value()->get(page_index);
+    if (!cached_page.has_value() || cached_page.value()->mapped)
+        return;
+    cached_page.value()->mapped = true;
+    m_mapped_page_count.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+}
+
+void PageCache::remove_page_locked(CachedPage& cached_page)
+{
+    VERIFY(m_lock.is_locked_by_current_processor());
+    m_lru_list.remove(cached_page);
+    auto const* inode = &cached_page.inode;
+    auto& inode_pages = *m_inodes.get(inode).value();
+    inode_pages.remove(cached_page.index);
+    if (inode_pages.is_empty())
+        m_inodes.remove(inode);
+    if (cached_page.mapped)
+        m_mapped_page_count.fetch_sub(1, AK::MemoryOrder::memory_order_relaxed);
+    m_page_count.fetch_sub(1, AK::MemoryOrder::memory_order_relaxed);
+}
+
+void PageCache::remove_pages(Inode const& inode, u64 first_page_index)
+{
+    SpinlockLocker locker(m_lock);
+    auto inode_pages = m_inodes.get(&inode);
+    if (!inode_pages.has_value())
+        return;
+    inode_pages.value()->remove_all_matching([&](auto page_index, auto& cached_page) {
+        if (page_index < first_page_index)
+            return false;
+        m_lru_list.remove(*cached_page);
+        if (cached_page->mapped)
+            m_mapped_page_count.fetch_sub(1, AK::MemoryOrder::memory_order_relaxed);
+        m_page_count.fetch_sub(1, AK::MemoryOrder::memory_order_relaxed);
+        return true;
+    });
+    if (inode_pages.value()->is_empty())
+        m_inodes.remove(&inode);
+}
+
+size_t PageCache::remove_unused_pages(Inode const& inode, u64 first_page_index, u64 end_page_index)
+{
+    SpinlockLocker locker(m_lock);
+    auto inode_pages = m_inodes.get(&inode);
+    if (!inode_pages.has_value() || first_page_index >= end_page_index)
+        return 0;
+
+    // Dropping a page that someone else holds on to wouldn't give any memory back, and they may still be using it.
+    auto is_unused = [](CachedPage const& cached_page) { return cached_page.page->ref_count() == 1; };
+
+    size_t removed_page_count = 0;
+    if (end_page_index - first_page_index < inode_pages.value()->size()) {
+        // Looking up each page in a small range is cheaper than going through all the pages of a large file.
+        for (auto page_index = first_page_index; page_index < end_page_index; ++page_index) {
+            // Removing the last page of the inode takes its page map along with it.
+            inode_pages = m_inodes.get(&inode);
+            if (!inode_pages.has_value())
+                break;
+            auto cached_page = inode_pages.value()->get(page_index);
+            if (!cached_page.has_value() || !is_unused(*cached_page.value()))
+                continue;
+            remove_page_locked(*cached_page.value());
+            ++removed_page_count;
+        }
+    } else {
+        inode_pages.value()->remove_all_matching([&](auto page_index, auto& cached_page) {
+            if (page_index < first_page_index || page_index >= end_page_index || !is_unused(*cached_page))
+                return false;
+            m_lru_list.remove(*cached_page);
+            if (cached_page->mapped)
+                m_mapped_page_count.fetch_sub(1, AK::MemoryOrder::memory_order_relaxed);
+            m_page_count.fetch_sub(1, AK::MemoryOrder::memory_order_relaxed);
+            ++removed_page_count;
+            return true;
+        });
+        if (inode_pages.value()->is_empty())
+            m_inodes.remove(&inode);
+    }
+    dbgln_if(PAGE_CACHE_DEBUG, "PageCache: Removed {} unused pages of inode {}", removed_page_count, inode.identifier());
+    return removed_page_count;
+}
+
+size_t PageCache::reclaim(size_t page_count)
+{
+    // We might be allocating memory for the cache itself right now, so we can't touch it.
+    if (m_lock.is_locked_by_current_processor())
+        return 0;
+
+    SpinlockLocker locker(m_lock);
+    size_t reclaimed_page_count = 0;
+    // Every page is looked at once at most, so pages that are mapped somewhere don't keep us busy forever.
+    auto remaining_page_count = m_page_count.load(AK::MemoryOrder::memory_order_relaxed);
+    while (reclaimed_page_count < page_count && remaining_page_count-- > 0) {
+        auto* cached_page = m_lru_list.first();
+        if (!cached_page)
+            break;
+        // Dropping a page that someone else holds on to wouldn't give any memory back.
+        if (cached_page->page->ref_count() > 1) {
+            m_lru_list.append(*cached_page);
+            continue;
+        }
+        remove_page_locked(*cached_page);
+        ++reclaimed_page_count;
+    }
+    dbgln_if(PAGE_CACHE_DEBUG, "PageCache: Reclaimed {} of {} requested pages", reclaimed_page_count, page_count);
+    return reclaimed_page_count;
+}
+
+PageCache::Statistics PageCache::statistics() const
+{
+    return {
+        .cached_pages = m_page_count.load(AK::MemoryOrder::memory_order_relaxed),
+        .mapped_pages = m_mapped_page_count.load(AK::MemoryOrder::memory_order_relaxed),
+    };
+}
+
+ErrorOr<void> PageCache::read_from_pages(Span<NonnullRefPtr<PhysicalRAMPage>> pages, size_t offset_in_first_page, UserOrKernelBuffer buffer, size_t length)
+{
+    VERIFY(offset_in_first_page + length <= pages.size() * PAGE_SIZE);
+    if (!buffer.is_kernel_buffer()) {
+        auto region = TRY(MM.allocate_kernel_region_with_physical_pages(pages, "Page Cache Read"sv, Region::Access::Read));
+        return buffer.write(region->vaddr().offset(offset_in_first_page).as_ptr(), length);
+    }
+
+    size_t ncopied = 0;
+    for (size_t i = 0; ncopied < length; ++i) {
+        auto offset_in_page = i == 0 ? offset_in_first_page : 0;
+        auto chunk_size = min(length - ncopied, PAGE_SIZE - offset_in_page);
+        InterruptDisabler disabler;
+        auto* page_ptr = MM.quickmap_page(*pages[i]);
+        auto result = buffer.write(page_ptr + offset_in_page, ncopied, chunk_size);
+        MM.unquickmap_page();
+        TRY(result);
+        ncopied += chunk_size;
+    }
+    return {};
+}
+
+ErrorOr<void> PageCache::write_to_pages(Span<NonnullRefPtr<PhysicalRAMPage>> pages, size_t offset_in_first_page, UserOrKernelBuffer const& buffer, size_t length)
+{
+    VERIFY(offset_in_first_page + length <= pages.size() * PAGE_SIZE);
+    if (!buffer.is_kernel_buffer()) {
+        auto region = TRY(MM.allocate_kernel_region_with_physical_pages(pages, "Page Cache Write"sv, Region::Access::ReadWrite));
+        return buffer.read(region->vaddr().offset(offset_in_first_page).as_ptr(), length);
+    }
+
+    size_t ncopied = 0;
+    for (size_t i = 0; ncopied < length; ++i) {
+        auto offset_in_page = i == 0 ? offset_in_first_page : 0;
+        auto chunk_size = min(length - ncopied, PAGE_SIZE - offset_in_page);
+        InterruptDisabler disabler;
+        auto* page_ptr = MM.quickmap_page(*pages[i]);
+        auto result = buffer.read(page_ptr + offset_in_page, ncopied, chunk_size);
+        MM.unquickmap_page();
+        TRY(result);
+        ncopied += chunk_size;
+    }
+    return {};
+}
+
+}
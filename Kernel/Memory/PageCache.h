@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <Kernel/Forward.h>
+#include <Kernel/Locking/Spinlock.h>
+#include <Kernel/Memory/PhysicalRAMPage.h>
+
+namespace Kernel::Memory {
+
+// The page cache holds file data by inode and page index. read() and write() go through it, and file mappings map
+// its pages directly, so a file that is both read and mapped only takes up memory once.
+// Pages that aren't mapped anywhere are kept in least recently used order, and MemoryManager takes them back from the
+// front of that list once memory gets tight.
+class PageCache {
+    AK_MAKE_NONCOPYABLE(PageCache);
+    AK_MAKE_NONMOVABLE(PageCache);
+
+public:
+    static PageCache& the();
+
+    PageCache() = default;
+
+    RefPtr<PhysicalRAMPage> find_page(Inode const&, u64 page_index);
+    bool contains_page(Inode const&, u64 page_index) const;
+
+    // Puts the given page into the cache. If someone else was faster, their page is returned instead.
+    ErrorOr<NonnullRefPtr<PhysicalRAMPage>> add_page(Inode const&, u64 page_index, NonnullRefPtr<PhysicalRAMPage>);
+
+    // Called when a page has been handed to a mapping, so it shows up in the statistics.
+    void did_map_page(Inode const&, u64 page_index);
+
+    // Removes the pages starting at the given index. Mappings that use them keep them, but they won't be handed out again.
+    void remove_pages(Inode const&, u64 first_page_index = 0);
+
+    // Removes the pages in [first_page_index, end_page_index) that nobody else holds on to, just like reclaim() would.
+    // Returns the number of pages that were removed.
+    size_t remove_unused_pages(Inode const&, u64 first_page_index, u64 end_page_index);
+
+    // Returns the number of pages that were given back to MemoryManager.
+    size_t reclaim(size_t page_count);
+
+    // NOTE: We don't hear about mappings going away, so pages stay counted as mapped until they leave the cache.
+    struct Statistics {
+        size_t cached_pages { 0 };
+        size_t mapped_pages { 0 };
+    };
+    Statistics statistics() const;
+
+    // NOTE: This doesn't bring the page cache into existence, so MemoryManager can ask before anyone has used it.
+    static bool has_pages();
+
+    // These copy directly between the pages and the buffer. User buffers may fault, so they are copied to and from
+    // through a temporary kernel mapping of the pages instead of a quickmap.
+    static ErrorOr<void> read_from_pages(Span<NonnullRefPtr<PhysicalRAMPage>>, size_t offset_in_first_page, UserOrKernelBuffer, size_t length);
+    static ErrorOr<void> write_to_pages(Span<NonnullRefPtr<PhysicalRAMPage>>, size_t offset_in_first_page, UserOrKernelBuffer const&, size_t length);
+
+private:
+    struct CachedPage {
+        Inode const& inode;
+        u64 index { 0 };
+        NonnullRefPtr<PhysicalRAMPage> page;
+        bool mapped { false };
+        IntrusiveListNode<CachedPage> lru_list_node;
+    };
+
+    using InodePages = HashMap<u64, NonnullOwnPtr<CachedPage>>;
+
+    void remove_page_locked(CachedPage&);
+
+    // NOTE: Adding a page may allocate memory, which may want to reclaim pages. That's why we have to be able to tell
+    //       whether we're holding the lock already.
+    mutable RecursiveSpinlock<LockRank::None> m_lock {};
+    HashMap<Inode const*, NonnullOwnPtr<InodePages>> m_inodes;
+    // Least recently used first.
+    IntrusiveList<&CachedPage::lru_list_node> m_lru_list;
+    Atomic<size_t> m_page_count { 0 };
+    Atomic<size_t> m_mapped_page_count { 0 };
+};
+
+}
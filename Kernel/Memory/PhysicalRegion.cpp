@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/BinarySearch.h>
 #include <AK/BuiltinWrappers.h>
 #include <Kernel/Library/Assertions.h>
 #include <Kernel/Memory/MemoryManager.h>
@@ -55,8 +56,25 @@ void PhysicalRegion::initialize_zones()
         return zone_count;
     };
 
+    // Carve the space in front of the first huge page boundary into smaller zones, so that all following
+    // zones (and therefore all of their buddy blocks) are naturally aligned and can hand out huge pages.
+    size_t alignment_zone_count = 0;
+    auto first_alignment_address = base_address;
+    while (remaining_pages > 0 && base_address.get() % HUGE_PAGE_SIZE != 0) {
+        size_t pages_per_zone = (base_address.get() & -base_address.get()) / PAGE_SIZE;
+        while (pages_per_zone > remaining_pages)
+            pages_per_zone /= 2;
+        m_zones.append(adopt_nonnull_own_or_enomem(new (nothrow) PhysicalZone(base_address, pages_per_zone)).release_value_but_fixme_should_propagate_errors());
+        base_address = base_address.offset(pages_per_zone * PAGE_SIZE);
+        m_usable_zones.append(*m_zones.last());
+        remaining_pages -= pages_per_zone;
+        ++alignment_zone_count;
+    }
+    if (alignment_zone_count)
+        dmesgln(" * {}x PhysicalZone (alignment) @ {:016x}-{:016x}", alignment_zone_count, first_alignment_address.get(), base_address.get() - 1);
+
     // First make 16 MiB zones (with 4096 pages each)
-    m_large_zones = make_zones(large_zone_size);
+    make_zones(large_zone_size);
 
     // Then divide any remaining space into 1 MiB zones (with 256 pages each)
     make_zones(small_zone_size);
@@ -102,6 +120,28 @@ Vector<NonnullRefPtr<PhysicalRAMPage>> PhysicalRegion::take_contiguous_free_page
     return physical_pages;
 }
 
+Optional<PhysicalAddress> PhysicalRegion::take_aligned_free_block(size_t page_count)
+{
+    VERIFY(is_power_of_two(page_count));
+    auto order = count_trailing_zeroes(page_count);
+
+    // Buddy blocks are aligned to their own size relative to the base of their zone,
+    // so only zones with a suitably aligned base can produce physically aligned blocks.
+    for (auto& zone : m_usable_zones) {
+        if (zone.base().get() % (page_count * PAGE_SIZE) != 0)
+            continue;
+        auto block_base = zone.allocate_block(order);
+        if (!block_base.has_value())
+            continue;
+        if (zone.is_empty()) {
+            // We've exhausted this zone, move it to the full zones list.
+            m_full_zones.append(zone);
+        }
+        return block_base;
+    }
+    return {};
+}
+
 RefPtr<PhysicalRAMPage> PhysicalRegion::take_free_page()
 {
     if (m_usable_zones.is_empty())
@@ -121,16 +161,15 @@ RefPtr<PhysicalRAMPage> PhysicalRegion::take_free_page()
 
 void PhysicalRegion::return_page(PhysicalAddress paddr)
 {
-    auto large_zone_base = lower().get();
-    auto small_zone_base = lower().get() + (m_large_zones * large_zone_size);
-
-    size_t zone_index;
-    if (paddr.get() < small_zone_base)
-        zone_index = (paddr.get() - large_zone_base) / large_zone_size;
-    else
-        zone_index = m_large_zones + (paddr.get() - small_zone_base) / small_zone_size;
-
-    auto& zone = m_zones[zone_index];
+    // Zones are created in ascending address order and don't overlap, so we can find the right one with a binary search.
+    auto* zone_slot = binary_search(m_zones, paddr, nullptr, [](PhysicalAddress needle, NonnullOwnPtr<PhysicalZone> const& zone) -> int {
+        if (zone->contains(needle))
+            return 0;
+        return needle < zone->base() ? -1 : 1;
+    });
+    VERIFY(zone_slot);
+
+    auto& zone = *zone_slot;
     VERIFY(zone->contains(paddr));
     zone->deallocate_block(paddr, 0);
     if (m_full_zones.contains(*zone))
@@ -36,6 +36,7 @@ public:
 
     RefPtr<PhysicalRAMPage> take_free_page();
     Vector<NonnullRefPtr<PhysicalRAMPage>> take_contiguous_free_pages(size_t count);
+    Optional<PhysicalAddress> take_aligned_free_block(size_t page_count);
     void return_page(PhysicalAddress);
 
 private:
@@ -46,8 +47,6 @@ private:
 
     Vector<NonnullOwnPtr<PhysicalZone>> m_zones;
 
-    size_t m_large_zones { 0 };
-
     PhysicalZone::List m_usable_zones;
     PhysicalZone::List m_full_zones;
 
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/ByteBuffer.h>
 #include <AK/StringView.h>
 #include <Kernel/Arch/PageDirectory.h>
 #include <Kernel/Arch/PageFault.h>
@@ -22,6 +23,12 @@
 
 namespace Kernel::Memory {
 
+// When an inode fault is resolved, already loaded pages in the surrounding aligned window are mapped along with it.
+static constexpr size_t fault_around_page_count = 16;
+
+// The maximum number of pages read from an inode at once when prefaulting.
+static constexpr size_t prefault_batch_page_count = 16;
+
 Region::Region()
     : m_range(VirtualRange({}, 0))
 {
@@ -266,6 +273,107 @@ bool Region::map_individual_page_impl(size_t page_index, PhysicalAddress paddr,
     return true;
 }
 
+Optional<PhysicalAddress> Region::huge_page_base_for(size_t page_index, ShouldLockVMObject should_lock_vmobject) const
+{
+#if ARCH(X86_64)
+    // A huge page maps a naturally aligned 2 MiB range with a single set of permissions, so that range has to belong
+    // entirely to this region, and has to be backed by one aligned physical block that is mapped the same way throughout.
+    if (vaddr_from_page_index(page_index).get() % HUGE_PAGE_SIZE != 0 || page_index + PAGES_PER_HUGE_PAGE > page_count())
+        return {};
+    if (!vmobject().is_anonymous() || m_memory_type != MemoryType::Normal || !is_readable())
+        return {};
+    if (static_cast<AnonymousVMObject const&>(vmobject()).is_purgeable())
+        return {};
+
+    auto find_base = [&]() -> Optional<PhysicalAddress> {
+        auto first_page = physical_page_locked(page_index);
+        if (!first_page || first_page->paddr().get() % HUGE_PAGE_SIZE != 0)
+            return {};
+        auto base = first_page->paddr();
+        for (size_t i = 0; i < PAGES_PER_HUGE_PAGE; ++i) {
+            auto page = physical_page_locked(page_index + i);
+            if (!page || page->is_shared_zero_page() || page->is_lazy_committed_page())
+                return {};
+            if (page->paddr() != base.offset(i * PAGE_SIZE) || should_cow(page_index + i))
+                return {};
+        }
+        return base;
+    };
+
+    if (should_lock_vmobject == ShouldLockVMObject::Yes) {
+        SpinlockLocker locker(vmobject().m_lock);
+        return find_base();
+    }
+    return find_base();
+#else
+    // FIXME: Support huge page mappings on other architectures.
+    (void)page_index;
+    (void)should_lock_vmobject;
+    return {};
+#endif
+}
+
+bool Region::map_huge_page_impl(size_t page_index, PhysicalAddress paddr)
+{
+#if ARCH(X86_64)
+    VERIFY(m_page_directory->get_lock().is_locked_by_current_processor());
+
+    auto huge_page_vaddr = vaddr_from_page_index(page_index);
+
+    bool user_allowed = huge_page_vaddr.get() >= USER_RANGE_BASE && is_user_address(huge_page_vaddr);
+    if (is_mmap() && !user_allowed) {
+        PANIC("About to map mmap'ed page at a kernel address");
+    }
+
+    auto* pde = MM.ensure_huge_pde(*m_page_directory, huge_page_vaddr);
+    if (!pde)
+        return false;
+    pde->set_page_table_base(paddr.get());
+    pde->set_huge(true);
+    pde->set_memory_type(m_memory_type);
+    pde->set_writable(is_writable());
+    if (Processor::current().has_nx())
+        pde->set_execute_disabled(!is_executable());
+    pde->set_user_allowed(user_allowed);
+    pde->set_present(true);
+    return true;
+#else
+    (void)page_index;
+    (void)paddr;
+    VERIFY_NOT_REACHED();
+#endif
+}
+
+bool Region::try_promote_to_huge_page(size_t page_index)
+{
+#if ARCH(X86_64)
+    // NOTE: ensure_huge_pde() won't replace page tables of the kernel page directory, so we'd be stuck with the huge page.
+    if (!is_user() || m_shared || !is_readable() || !is_writable() || m_memory_type != MemoryType::Normal)
+        return false;
+
+    auto huge_page_vaddr = VirtualAddress { vaddr_from_page_index(page_index).get() & ~(HUGE_PAGE_SIZE - 1) };
+    if (huge_page_vaddr < vaddr() || huge_page_vaddr.offset(HUGE_PAGE_SIZE) > range().end())
+        return false;
+
+    auto first_page_index = page_index_from_address(huge_page_vaddr);
+    auto& anonymous_vmobject = static_cast<AnonymousVMObject&>(vmobject());
+    if (!anonymous_vmobject.try_allocate_huge_page({}, translate_to_vmobject_page(first_page_index)))
+        return false;
+
+    SpinlockLocker page_lock(m_page_directory->get_lock());
+    // NOTE: The chunk is now backed by a fresh, private huge page, so there's nothing that could keep us from mapping it as one.
+    auto base = huge_page_base_for(first_page_index, ShouldLockVMObject::Yes);
+    VERIFY(base.has_value());
+    bool did_map = map_huge_page_impl(first_page_index, base.value());
+    VERIFY(did_map);
+    MemoryManager::flush_tlb(m_page_directory, huge_page_vaddr, PAGES_PER_HUGE_PAGE);
+    return true;
+#else
+    (void)page_index;
+    return false;
+#endif
+}
+
 bool Region::map_individual_page_impl(size_t page_index, ShouldLockVMObject should_lock_vmobject)
 {
     RefPtr<PhysicalRAMPage> page = nullptr;
@@ -302,9 +410,14 @@ void Region::unmap_with_locks_held(ShouldFlushTLB should_flush_tlb, SpinlockLock
     if (!m_page_directory)
         return;
     size_t count = page_count();
-    for (size_t i = 0; i < count; ++i) {
+    for (size_t i = 0; i < count;) {
         auto vaddr = vaddr_from_page_index(i);
+        if (vaddr.get() % HUGE_PAGE_SIZE == 0 && i + PAGES_PER_HUGE_PAGE <= count && MM.release_huge_pde(*m_page_directory, vaddr)) {
+            i += PAGES_PER_HUGE_PAGE;
+            continue;
+        }
         MM.release_pte(*m_page_directory, vaddr, i == count - 1 ? MemoryManager::IsLastPTERelease::Yes : MemoryManager::IsLastPTERelease::No);
+        ++i;
     }
     if (should_flush_tlb == ShouldFlushTLB::Yes)
         MemoryManager::flush_tlb(m_page_directory, vaddr(), page_count());
@@ -327,12 +440,7 @@ ErrorOr<void> Region::map_impl(PageDirectory& page_directory, ShouldLockVMObject
     }
 
     set_page_directory(page_directory);
-    size_t page_index = 0;
-    while (page_index < page_count()) {
-        if (!map_individual_page_impl(page_index, should_lock_vmobject))
-            break;
-        ++page_index;
-    }
+    size_t page_index = map_pages_impl(0, page_count(), should_lock_vmobject);
     if (page_index > 0) {
         if (should_flush_tlb == ShouldFlushTLB::Yes)
             MemoryManager::flush_tlb(m_page_directory, vaddr(), page_index);
@@ -342,6 +450,48 @@ ErrorOr<void> Region::map_impl(PageDirectory& page_directory, ShouldLockVMObject
     return ENOMEM;
 }
 
+size_t Region::map_pages_impl(size_t first_page_index, size_t end_page_index, ShouldLockVMObject should_lock_vmobject)
+{
+    VERIFY(m_page_directory->get_lock().is_locked_by_current_processor());
+    VERIFY(end_page_index <= page_count());
+
+    size_t page_index = first_page_index;
+    while (page_index < end_page_index) {
+        if (auto huge_page_base = huge_page_base_for(page_index, should_lock_vmobject); huge_page_base.has_value()) {
+            if (map_huge_page_impl(page_index, huge_page_base.value())) {
+                page_index += PAGES_PER_HUGE_PAGE;
+                continue;
+            }
+        }
+        if (!map_individual_page_impl(page_index, should_lock_vmobject))
+            break;
+        ++page_index;
+    }
+    return page_index;
+}
+
+ErrorOr<void> Region::remap_page_range(size_t first_page_index, size_t count)
+{
+    VERIFY(m_page_directory);
+    size_t end_page_index = first_page_index + count;
+
+    // Widen the range to whole huge pages where we can, so that they get mapped as such instead of being split up.
+    auto huge_page_start = VirtualAddress { vaddr_from_page_index(first_page_index).get() & ~(HUGE_PAGE_SIZE - 1) };
+    if (huge_page_start >= vaddr())
+        first_page_index = page_index_from_address(huge_page_start);
+    auto huge_page_end = VirtualAddress { align_up_to(vaddr_from_page_index(end_page_index).get(), HUGE_PAGE_SIZE) };
+    if (huge_page_end <= range().end())
+        end_page_index = (huge_page_end - vaddr()).get() / PAGE_SIZE;
+
+    SpinlockLocker page_lock(m_page_directory->get_lock());
+    auto page_index = map_pages_impl(first_page_index, end_page_index, ShouldLockVMObject::Yes);
+    if (page_index > first_page_index)
+        MemoryManager::flush_tlb(m_page_directory, vaddr_from_page_index(first_page_index), page_index - first_page_index);
+    if (page_index != end_page_index)
+        return ENOMEM;
+    return {};
+}
+
 ErrorOr<void> Region::map(PageDirectory& page_directory, ShouldFlushTLB should_flush_tlb)
 {
     return map_impl(page_directory, ShouldLockVMObject::Yes, should_flush_tlb);
@@ -528,6 +678,12 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region, Physica
     if (current_thread != nullptr)
         current_thread->did_zero_fault();
 
+    // If the surrounding 2 MiB are committed but untouched, fault them all in at once as a single huge page.
+    if (page_in_slot_at_time_of_fault.is_lazy_committed_page() && try_promote_to_huge_page(page_index_in_region)) {
+        dbgln_if(PAGE_FAULT_DEBUG, "      >> PROMOTED TO HUGE PAGE");
+        return PageFaultResponse::Continue;
+    }
+
     RefPtr<PhysicalRAMPage> new_physical_page;
 
     if (page_in_slot_at_time_of_fault.is_lazy_committed_page()) {
@@ -607,6 +763,7 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, bool m
                 inode_vmobject.set_page_dirty(page_index_in_vmobject, true);
             if (!remap_vmobject_page(page_index_in_vmobject, *physical_page_slot, ShouldLockVMObject::No))
                 return PageFaultResponse::OutOfMemory;
+            fault_around_locked(page_index_in_region);
             return PageFaultResponse::Continue;
         }
     }
@@ -617,48 +774,46 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, bool m
     if (current_thread)
         current_thread->did_inode_fault();
 
-    u8 page_buffer[PAGE_SIZE];
     auto& inode = inode_vmobject.inode();
+    RefPtr<PhysicalRAMPage> new_physical_page;
+    if (inode.can_use_page_cache()) {
+        // The page is shared with the page cache. Private mappings get their own copy once they write to it.
+        auto result = inode.cached_page(page_index_in_vmobject);
+        if (result.is_error()) {
+            dmesgln("handle_inode_fault: Error ({}) while getting a page from the page cache", result.error());
+            return result.error().code() == ENOMEM ? PageFaultResponse::OutOfMemory : PageFaultResponse::ShouldCrash;
+        }
+        // Note: There's no page at the end of the file or after it, which means we should return bus error.
+        if (!result.value())
+            return PageFaultResponse::BusError;
+        new_physical_page = result.release_value();
+    } else {
+        u8 page_buffer[PAGE_SIZE];
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer);
+        auto result = inode.read_bytes(page_index_in_vmobject * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
 
-    auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer);
-    auto result = inode.read_bytes(page_index_in_vmobject * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
-
-    if (result.is_error()) {
-        dmesgln("handle_inode_fault: Error ({}) while reading from inode", result.error());
-        return PageFaultResponse::ShouldCrash;
-    }
+        if (result.is_error()) {
+            dmesgln("handle_inode_fault: Error ({}) while reading from inode", result.error());
+            return PageFaultResponse::ShouldCrash;
+        }
 
-    auto nread = result.value();
-    // Note: If we received 0, it means we are at the end of file or after it,
-    // which means we should return bus error.
-    if (nread == 0)
-        return PageFaultResponse::BusError;
+        auto nread = result.value();
+        // Note: If we received 0, it means we are at the end of file or after it,
+        // which means we should return bus error.
+        if (nread == 0)
+            return PageFaultResponse::BusError;
 
-    // If we read less than a page, zero out the rest to avoid leaking uninitialized data.
-    if (nread < PAGE_SIZE)
-        memset(page_buffer + nread, 0, PAGE_SIZE - nread);
+        // If we read less than a page, zero out the rest to avoid leaking uninitialized data.
+        if (nread < PAGE_SIZE)
+            memset(page_buffer + nread, 0, PAGE_SIZE - nread);
 
-    // Allocate a new physical page, and copy the read inode contents into it.
-    auto new_physical_page_or_error = MM.allocate_physical_page(MemoryManager::ShouldZeroFill::No);
-    if (new_physical_page_or_error.is_error()) {
-        dmesgln("MM: handle_inode_fault was unable to allocate a physical page");
-        return PageFaultResponse::OutOfMemory;
-    }
-    auto new_physical_page = new_physical_page_or_error.release_value();
-    {
-        InterruptDisabler disabler;
-        u8* dest_ptr = MM.quickmap_page(*new_physical_page);
-        memcpy(dest_ptr, page_buffer, PAGE_SIZE);
-
-        if (is_executable()) {
-            // Some architectures require an explicit synchronization operation after writing to memory that will be executed.
-            // This is required even if no instructions were previously fetched from that (physical) memory location,
-            // because some systems have an I-cache that is not coherent with the D-cache,
-            // resulting in the I-cache being filled with old values if the contents of the D-cache aren't written back yet.
-            Processor::flush_instruction_cache(VirtualAddress { dest_ptr }, PAGE_SIZE);
+        // Allocate a new physical page, and copy the read inode contents into it.
+        auto new_physical_page_or_error = allocate_page_with_contents({ page_buffer, PAGE_SIZE });
+        if (new_physical_page_or_error.is_error()) {
+            dmesgln("MM: handle_inode_fault was unable to allocate a physical page");
+            return PageFaultResponse::OutOfMemory;
         }
-
-        MM.unquickmap_page();
+        new_physical_page = new_physical_page_or_error.release_value();
     }
 
     {
@@ -677,14 +832,240 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, bool m
             inode_vmobject.set_page_dirty(page_index_in_vmobject, true);
         if (!remap_vmobject_page(page_index_in_vmobject, *physical_page_slot, ShouldLockVMObject::No))
             return PageFaultResponse::OutOfMemory;
+        fault_around_locked(page_index_in_region);
         return PageFaultResponse::Continue;
     }
 }
 
+ErrorOr<NonnullRefPtr<PhysicalRAMPage>> Region::allocate_page_with_contents(ReadonlyBytes contents)
+{
+    VERIFY(contents.size() == PAGE_SIZE);
+    auto new_physical_page = TRY(MM.allocate_physical_page(MemoryManager::ShouldZeroFill::No));
+
+    InterruptDisabler disabler;
+    u8* dest_ptr = MM.quickmap_page(*new_physical_page);
+    memcpy(dest_ptr, contents.data(), PAGE_SIZE);
+
+    if (is_executable()) {
+        // Some architectures require an explicit synchronization operation after writing to memory that will be executed.
+        // This is required even if no instructions were previously fetched from that (physical) memory location,
+        // because some systems have an I-cache that is not coherent with the D-cache,
+        // resulting in the I-cache being filled with old values if the contents of the D-cache aren't written back yet.
+        Processor::flush_instruction_cache(VirtualAddress { dest_ptr }, PAGE_SIZE);
+    }
+
+    MM.unquickmap_page();
+    return new_physical_page;
+}
+
+void Region::fault_around_locked(size_t page_index)
+{
+    VERIFY(vmobject().m_lock.is_locked());
+
+    auto window_start = page_index & ~(fault_around_page_count - 1);
+    auto window_end = min(window_start + fault_around_page_count, page_count());
+
+    SpinlockLocker page_lock(m_page_directory->get_lock());
+    size_t mapped_page_count = 0;
+    for (size_t i = window_start; i < window_end; ++i) {
+        if (i == page_index)
+            continue;
+        auto page = physical_page_locked(i);
+        if (!page)
+            continue;
+        auto* pte = MM.pte(*m_page_directory, vaddr_from_page_index(i));
+        if (pte && pte->is_present())
+            continue;
+        if (!map_individual_page_impl(i, page, ShouldLockVMObject::No))
+            break;
+        ++mapped_page_count;
+    }
+    if (mapped_page_count > 0)
+        MemoryManager::flush_tlb(m_page_directory, vaddr_from_page_index(window_start), window_end - window_start);
+}
+
+ErrorOr<void> Region::prefault(size_t first_page_index, size_t count)
+{
+    VERIFY(first_page_index + count <= page_count());
+    if (count == 0 || !m_page_directory)
+        return {};
+
+    // Nothing can ever be faulted into an inaccessible region, so there's no point in reading anything in for it.
+    if (!is_readable() && !is_writable() && !is_executable())
+        return {};
+
+    auto end_page_index = first_page_index + count;
+    if (vmobject().is_anonymous())
+        TRY(prefault_anonymous_pages(first_page_index, end_page_index));
+    else if (vmobject().is_inode())
+        TRY(prefault_inode_pages(first_page_index, end_page_index));
+    else
+        return {};
+
+    return remap_page_range(first_page_index, count);
+}
+
+ErrorOr<void> Region::prefault_anonymous_pages(size_t first_page_index, size_t end_page_index)
+{
+    // Read-only anonymous memory can't be anything but zeroes, so it stays backed by the shared zero page.
+    if (!is_writable())
+        return {};
+
+    auto& anonymous_vmobject = static_cast<AnonymousVMObject&>(vmobject());
+    for (size_t page_index = first_page_index; page_index < end_page_index; ++page_index) {
+        auto page_in_slot = physical_page(page_index);
+        if (!page_in_slot || !(page_in_slot->is_shared_zero_page() || page_in_slot->is_lazy_committed_page()))
+            continue;
+
+        // NOTE: This maps the whole surrounding huge page right away, so the remaining pages in it are skipped above.
+        if (page_in_slot->is_lazy_committed_page() && try_promote_to_huge_page(page_index))
+            continue;
+
+        RefPtr<PhysicalRAMPage> new_physical_page;
+        if (page_in_slot->is_lazy_committed_page())
+            new_physical_page = anonymous_vmobject.allocate_committed_page({});
+        else
+            new_physical_page = TRY(MM.allocate_physical_page(MemoryManager::ShouldZeroFill::Yes));
+
+        SpinlockLocker locker(anonymous_vmobject.m_lock);
+        auto& page_slot = physical_page_slot(page_index);
+        if (page_slot->is_shared_zero_page() || page_slot->is_lazy_committed_page())
+            page_slot = move(new_physical_page);
+    }
+    return {};
+}
+
+ErrorOr<void> Region::prefault_inode_pages(size_t first_page_index, size_t end_page_index)
+{
+    auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
+    auto& inode = inode_vmobject.inode();
+    if (inode.can_use_page_cache())
+        return prefault_page_cache_pages(first_page_index, end_page_index);
+
+    auto buffer = TRY(ByteBuffer::create_uninitialized(prefault_batch_page_count * PAGE_SIZE));
+
+    size_t page_index = first_page_index;
+    while (page_index < end_page_index) {
+        // Find the next run of pages that aren't loaded yet, so we can read all of them from the inode at once.
+        size_t run_page_count = 0;
+        {
+            SpinlockLocker locker(inode_vmobject.m_lock);
+            while (page_index < end_page_index && !physical_page_slot(page_index).is_null())
+                ++page_index;
+            while (page_index + run_page_count < end_page_index && run_page_count < prefault_batch_page_count && physical_page_slot(page_index + run_page_count).is_null())
+                ++run_page_count;
+        }
+        if (run_page_count == 0)
+            break;
+
+        auto user_or_kernel_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer.data());
+        auto nread = TRY(inode.read_bytes(translate_to_vmobject_page(page_index) * PAGE_SIZE, run_page_count * PAGE_SIZE, user_or_kernel_buffer, nullptr));
+
+        // NOTE: Pages past the end of the file are left alone, touching them will still raise a bus error.
+        if (nread == 0)
+            break;
+
+        auto read_page_count = ceil_div(nread, static_cast<size_t>(PAGE_SIZE));
+        if (nread % PAGE_SIZE != 0)
+            memset(buffer.data() + nread, 0, read_page_count * PAGE_SIZE - nread);
+
+        for (size_t i = 0; i < read_page_count; ++i) {
+            auto new_physical_page = TRY(allocate_page_with_contents(buffer.span().slice(i * PAGE_SIZE, PAGE_SIZE)));
+
+            SpinlockLocker locker(inode_vmobject.m_lock);
+            // Someone else may have faulted the page in while we were reading it.
+            auto& page_slot = physical_page_slot(page_index + i);
+            if (page_slot.is_null())
+                page_slot = move(new_physical_page);
+        }
+
+        if (read_page_count < run_page_count)
+            break;
+        page_index += run_page_count;
+    }
+    return {};
+}
+
+ErrorOr<void> Region::prefault_page_cache_pages(size_t first_page_index, size_t end_page_index)
+{
+    auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
+    auto& inode = inode_vmobject.inode();
+    auto first_page_index_in_vmobject = translate_to_vmobject_page(first_page_index);
+    TRY(inode.read_ahead(first_page_index_in_vmobject * PAGE_SIZE, (end_page_index - first_page_index) * PAGE_SIZE));
+
+    for (size_t page_index = first_page_index; page_index < end_page_index; ++page_index) {
+        {
+            SpinlockLocker locker(inode_vmobject.m_lock);
+            if (!physical_page_slot(page_index).is_null())
+                continue;
+        }
+
+        // NOTE: Pages past the end of the file are left alone, touching them will still raise a bus error.
+        auto page = TRY(inode.cached_page(translate_to_vmobject_page(page_index)));
+        if (!page)
+            break;
+
+        SpinlockLocker locker(inode_vmobject.m_lock);
+        auto& page_slot = physical_page_slot(page_index);
+        if (page_slot.is_null())
+            page_slot = move(page);
+    }
+    return {};
+}
+
+PageFaultResponse Region::handle_private_page_cache_write_fault(size_t page_index_in_region)
+{
+    auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
+    auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
+    auto& physical_page_slot = inode_vmobject.physical_pages()[page_index_in_vmobject];
+
+    RefPtr<PhysicalRAMPage> shared_page;
+    {
+        SpinlockLocker locker(inode_vmobject.m_lock);
+        if (!physical_page_slot.is_null() && inode_vmobject.is_page_dirty(page_index_in_vmobject)) {
+            dbgln_if(PAGE_FAULT_DEBUG, "handle_private_page_cache_write_fault: Page was copied by someone else, remapping.");
+            if (!remap_vmobject_page(page_index_in_vmobject, *physical_page_slot, ShouldLockVMObject::No))
+                return PageFaultResponse::OutOfMemory;
+            return PageFaultResponse::Continue;
+        }
+        shared_page = physical_page_slot;
+    }
+
+    // The page has to come in first. It's mapped read-only, so writing to it will bring us back here.
+    if (!shared_page)
+        return handle_inode_fault(page_index_in_region);
+
+    dbgln_if(PAGE_FAULT_DEBUG, "handle_private_page_cache_write_fault: Copying page cache page for a private mapping.");
+    u8 page_buffer[PAGE_SIZE];
+    MM.copy_physical_page(*shared_page, page_buffer);
+    auto private_page_or_error = allocate_page_with_contents({ page_buffer, PAGE_SIZE });
+    if (private_page_or_error.is_error()) {
+        dmesgln("MM: handle_private_page_cache_write_fault was unable to allocate a physical page");
+        return PageFaultResponse::OutOfMemory;
+    }
+
+    SpinlockLocker locker(inode_vmobject.m_lock);
+    // Someone else may have copied the page already, or the clean page may have been released in the meantime.
+    if (physical_page_slot.is_null() || physical_page_slot == shared_page) {
+        physical_page_slot = private_page_or_error.release_value();
+        inode_vmobject.set_page_dirty(page_index_in_vmobject, true);
+    } else if (!inode_vmobject.is_page_dirty(page_index_in_vmobject)) {
+        // A different clean page was faulted in, so the write will fault again and copy that one.
+        return PageFaultResponse::Continue;
+    }
+    if (!remap_vmobject_page(page_index_in_vmobject, *physical_page_slot, ShouldLockVMObject::No))
+        return PageFaultResponse::OutOfMemory;
+    return PageFaultResponse::Continue;
+}
+
 PageFaultResponse Region::handle_dirty_on_write_fault(size_t page_index_in_region)
 {
     VERIFY(vmobject().is_inode());
     auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
+    // Pages of private mappings may be shared with the page cache, which must not see what we write.
+    if (inode_vmobject.is_private_inode() && inode_vmobject.inode().can_use_page_cache())
+        return handle_private_page_cache_write_fault(page_index_in_region);
+
     auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
     auto& physical_page_slot = inode_vmobject.physical_pages()[page_index_in_vmobject];
 
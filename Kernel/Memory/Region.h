@@ -210,6 +210,9 @@ public:
     void remap_with_locked_vmobject();
     void remap();
 
+    // Populates and maps the given pages up front, so that touching them later doesn't cause one page fault per page.
+    ErrorOr<void> prefault(size_t first_page_index, size_t count);
+
     [[nodiscard]] bool is_mapped() const { return m_page_directory != nullptr; }
 
     void clear_to_zero();
@@ -238,6 +241,14 @@ private:
     [[nodiscard]] bool should_dirty_on_write(size_t page_index, ShouldLockVMObject should_lock_vmobject) const;
 
     ErrorOr<void> map_impl(PageDirectory&, ShouldLockVMObject, ShouldFlushTLB);
+    size_t map_pages_impl(size_t first_page_index, size_t end_page_index, ShouldLockVMObject);
+    ErrorOr<void> remap_page_range(size_t first_page_index, size_t count);
+    void fault_around_locked(size_t page_index);
+
+    ErrorOr<void> prefault_anonymous_pages(size_t first_page_index, size_t end_page_index);
+    ErrorOr<void> prefault_inode_pages(size_t first_page_index, size_t end_page_index);
+    ErrorOr<void> prefault_page_cache_pages(size_t first_page_index, size_t end_page_index);
+    ErrorOr<NonnullRefPtr<PhysicalRAMPage>> allocate_page_with_contents(ReadonlyBytes);
 
     void set_access_bit(Access access, bool b)
     {
@@ -253,12 +264,17 @@ private:
     [[nodiscard]] PageFaultResponse handle_inode_fault(size_t page_index, bool mark_page_dirty = false);
     [[nodiscard]] PageFaultResponse handle_zero_fault(size_t page_index, PhysicalRAMPage& page_in_slot_at_time_of_fault);
     [[nodiscard]] PageFaultResponse handle_dirty_on_write_fault(size_t page_index);
+    [[nodiscard]] PageFaultResponse handle_private_page_cache_write_fault(size_t page_index);
 
     [[nodiscard]] bool map_individual_page_impl(size_t page_index, ShouldLockVMObject);
     [[nodiscard]] bool map_individual_page_impl(size_t page_index, RefPtr<PhysicalRAMPage>, ShouldLockVMObject);
     [[nodiscard]] bool map_individual_page_impl(size_t page_index, PhysicalAddress);
     [[nodiscard]] bool map_individual_page_impl(size_t page_index, PhysicalAddress, bool readable, bool writeable, ShouldLockVMObject);
 
+    [[nodiscard]] Optional<PhysicalAddress> huge_page_base_for(size_t page_index, ShouldLockVMObject) const;
+    [[nodiscard]] bool map_huge_page_impl(size_t page_index, PhysicalAddress);
+    [[nodiscard]] bool try_promote_to_huge_page(size_t page_index);
+
     void remap_impl(ShouldLockVMObject should_lock_vmobject);
 
     LockRefPtr<PageDirectory> m_page_directory;
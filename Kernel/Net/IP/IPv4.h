@@ -102,4 +102,22 @@ private:
 
 static_assert(AssertSize<IPv4Packet, 20>());
 
+// The sum over the pseudo header that TCP and UDP checksums start out with. It's folded but not inverted, which is
+// what adapters that complete the checksum on their own expect to find in the checksum field.
+inline NetworkOrdered<u16> ipv4_pseudo_header_checksum(IPv4Address const& source, IPv4Address const& destination, TransportProtocol protocol, u16 length)
+{
+    struct [[gnu::packed]] {
+        IPv4Address source;
+        IPv4Address destination;
+        u8 zero;
+        u8 protocol;
+        NetworkOrdered<u16> length;
+    } pseudo_header { source, destination, 0, to_underlying(protocol), length };
+    static_assert(sizeof(pseudo_header) == 12);
+
+    InternetChecksum checksum;
+    checksum.add({ &pseudo_header, sizeof(pseudo_header) });
+    return static_cast<u16>(~static_cast<u16>(checksum.finish()));
+}
+
 }
@@ -189,9 +189,34 @@ bool IPv4Socket::can_write(OpenFileDescription const&, u64) const
     return true;
 }
 
-ErrorOr<size_t> IPv4Socket::sendto(OpenFileDescription&, UserOrKernelBuffer const& data, size_t data_length, [[maybe_unused]] int flags, Userspace<sockaddr const*> addr, socklen_t addr_length)
+ErrorOr<size_t> IPv4Socket::sendto(OpenFileDescription&, UserOrKernelBuffer const& data, size_t data_length, int flags, Userspace<sockaddr const*> addr, socklen_t addr_length)
 {
     MutexLocker locker(mutex());
+    return send_while_locked(data, data_length, flags, addr, addr_length);
+}
+
+ErrorOr<size_t> IPv4Socket::sendto_batch(OpenFileDescription& description, Span<BatchedSend> sends, int flags)
+{
+    if (type() == SOCK_STREAM)
+        return Socket::sendto_batch(description, sends, flags);
+
+    MutexLocker locker(mutex());
+    for (size_t i = 0; i < sends.size(); ++i) {
+        auto& send = sends[i];
+        auto nsent_or_error = send_while_locked(send.data, send.data_length, flags, send.address, send.address_length);
+        if (nsent_or_error.is_error()) {
+            if (i == 0)
+                return nsent_or_error.release_error();
+            return i;
+        }
+        send.nsent = nsent_or_error.value();
+    }
+    return sends.size();
+}
+
+ErrorOr<size_t> IPv4Socket::send_while_locked(UserOrKernelBuffer const& data, size_t data_length, [[maybe_unused]] int flags, Userspace<sockaddr const*> addr, socklen_t addr_length)
+{
+    VERIFY(mutex().is_exclusively_locked_by_current_thread());
 
     if (addr && addr_length != sizeof(sockaddr_in))
         return set_so_error(EINVAL);
@@ -360,13 +385,17 @@ ErrorOr<size_t> IPv4Socket::receive_packet_buffered(OpenFileDescription& descrip
     VERIFY(packet->data);
 
     packet_timestamp = packet->timestamp;
+    return deliver_packet(*packet, buffer, buffer_length, flags, addr, addr_length);
+}
 
+ErrorOr<size_t> IPv4Socket::deliver_packet(ReceivedPacket const& packet, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*> addr, Userspace<socklen_t*> addr_length)
+{
     if (addr) {
-        dbgln_if(IPV4_SOCKET_DEBUG, "Incoming packet is from: {}:{}", packet->peer_address, packet->peer_port);
+        dbgln_if(IPV4_SOCKET_DEBUG, "Incoming packet is from: {}:{}", packet.peer_address, packet.peer_port);
 
         sockaddr_in out_addr {};
-        memcpy(&out_addr.sin_addr, &packet->peer_address, sizeof(IPv4Address));
-        out_addr.sin_port = htons(packet->peer_port);
+        memcpy(&out_addr.sin_addr, &packet.peer_address, sizeof(IPv4Address));
+        out_addr.sin_port = htons(packet.peer_port);
         out_addr.sin_family = AF_INET;
         Userspace<sockaddr_in*> dest_addr = addr.ptr();
         SOCKET_TRY(copy_to_user(dest_addr, &out_addr));
@@ -377,15 +406,15 @@ ErrorOr<size_t> IPv4Socket::receive_packet_buffered(OpenFileDescription& descrip
     }
 
     if (type() == SOCK_RAW) {
-        size_t bytes_written = min(packet->data->size(), buffer_length);
-        SOCKET_TRY(buffer.write(packet->data->data(), bytes_written));
+        size_t bytes_written = min(packet.data->size(), buffer_length);
+        SOCKET_TRY(buffer.write(packet.data->data(), bytes_written));
         return bytes_written;
     }
 
-    return protocol_receive(packet->data->bytes(), buffer, buffer_length, flags);
+    return protocol_receive(packet.data->bytes(), buffer, buffer_length, flags);
 }
 
-ErrorOr<size_t> IPv4Socket::recvfrom(OpenFileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*> user_addr, Userspace<socklen_t*> user_addr_length, UnixDateTime& packet_timestamp, bool blocking)
+ErrorOr<void> IPv4Socket::check_address_length(Userspace<socklen_t*> user_addr_length)
 {
     if (user_addr_length) {
         socklen_t addr_length;
@@ -393,6 +422,12 @@ ErrorOr<size_t> IPv4Socket::recvfrom(OpenFileDescription& description, UserOrKer
         if (addr_length < sizeof(sockaddr_in))
             return set_so_error(EINVAL);
     }
+    return {};
+}
+
+ErrorOr<size_t> IPv4Socket::recvfrom(OpenFileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*> user_addr, Userspace<socklen_t*> user_addr_length, UnixDateTime& packet_timestamp, bool blocking)
+{
+    TRY(check_address_length(user_addr_length));
 
     dbgln_if(IPV4_SOCKET_DEBUG, "recvfrom: type={}, local_port={}", type(), local_port());
 
@@ -418,6 +453,62 @@ ErrorOr<size_t> IPv4Socket::recvfrom(OpenFileDescription& description, UserOrKer
     return total_nreceived;
 }
 
+ErrorOr<size_t> IPv4Socket::recvfrom_batch(OpenFileDescription& description, Span<BatchedReceive> receives, int flags, bool blocking)
+{
+    if (buffer_mode() == BufferMode::Bytes || (flags & (MSG_PEEK | MSG_WAITALL)))
+        return Socket::recvfrom_batch(description, receives, flags, blocking);
+
+    for (auto& receive : receives)
+        TRY(check_address_length(receive.address_length));
+
+    MutexLocker locker(mutex());
+    while (m_receive_queue.is_empty()) {
+        if (protocol_is_disconnected())
+            return 0;
+        if (!blocking)
+            return set_so_error(EAGAIN);
+
+        locker.unlock();
+        auto unblocked_flags = BlockFlags::None;
+        auto res = Thread::current()->block<Thread::ReadBlocker>({}, description, unblocked_flags);
+        locker.lock();
+
+        if (!has_flag(unblocked_flags, BlockFlags::Read)) {
+            if (res.was_interrupted())
+                return set_so_error(EINTR);
+
+            // Unblocked due to timeout.
+            return set_so_error(EAGAIN);
+        }
+    }
+
+    // Everything that is already queued is taken in one go, without letting go of the lock in between.
+    size_t count = 0;
+    size_t total_nreceived = 0;
+    ErrorOr<void> result {};
+    while (count < receives.size() && !m_receive_queue.is_empty()) {
+        auto packet = m_receive_queue.take_first();
+        auto& receive = receives[count];
+        receive.timestamp = packet.timestamp;
+        auto nreceived_or_error = deliver_packet(packet, receive.buffer, receive.buffer_length, flags, receive.address, receive.address_length);
+        if (nreceived_or_error.is_error()) {
+            result = nreceived_or_error.release_error();
+            break;
+        }
+        receive.nreceived = nreceived_or_error.value();
+        total_nreceived += receive.nreceived;
+        ++count;
+    }
+    set_can_read(!m_receive_queue.is_empty());
+
+    dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): recvfrom_batch took {} packets, packets in queue: {}", this, count, m_receive_queue.size());
+
+    if (count == 0 && result.is_error())
+        return result.release_error();
+    Thread::current()->did_ipv4_socket_read(total_nreceived);
+    return count;
+}
+
 bool IPv4Socket::did_receive(IPv4Address const& source_address, u16 source_port, ReadonlyBytes packet, UnixDateTime const& packet_timestamp)
 {
     MutexLocker locker(mutex());
@@ -37,6 +37,8 @@ public:
     virtual bool can_write(OpenFileDescription const&, u64) const override;
     virtual ErrorOr<size_t> sendto(OpenFileDescription&, UserOrKernelBuffer const&, size_t, int, Userspace<sockaddr const*>, socklen_t) override;
     virtual ErrorOr<size_t> recvfrom(OpenFileDescription&, UserOrKernelBuffer&, size_t, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>, UnixDateTime&, bool blocking) override;
+    virtual ErrorOr<size_t> sendto_batch(OpenFileDescription&, Span<BatchedSend>, int flags) override;
+    virtual ErrorOr<size_t> recvfrom_batch(OpenFileDescription&, Span<BatchedReceive>, int flags, bool blocking) override;
     virtual ErrorOr<void> setsockopt(int level, int option, Userspace<void const*>, socklen_t) override;
     virtual ErrorOr<void> getsockopt(OpenFileDescription&, int level, int option, Userspace<void*>, Userspace<socklen_t*>) override;
 
@@ -100,6 +102,8 @@ private:
 
     ErrorOr<size_t> receive_byte_buffered(OpenFileDescription&, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>, bool blocking);
     ErrorOr<size_t> receive_packet_buffered(OpenFileDescription&, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>, UnixDateTime&, bool blocking);
+    ErrorOr<size_t> send_while_locked(UserOrKernelBuffer const&, size_t, int flags, Userspace<sockaddr const*>, socklen_t);
+    ErrorOr<void> check_address_length(Userspace<socklen_t*>);
 
     void set_can_read(bool);
 
@@ -117,6 +121,8 @@ private:
         OwnPtr<KBuffer> data;
     };
 
+    ErrorOr<size_t> deliver_packet(ReceivedPacket const&, UserOrKernelBuffer&, size_t buffer_length, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>);
+
     SinglyLinkedList<ReceivedPacket, CountingSizeCalculationPolicy> m_receive_queue;
 
     OwnPtr<DoubleBuffer> m_receive_buffer;
@@ -228,6 +228,7 @@ UNMAP_AFTER_INIT ErrorOr<void> E1000ENetworkAdapter::initialize(Badge<Networking
 
     initialize_rx_descriptors();
     initialize_tx_descriptors();
+    set_offloads(NetworkOffload::TCPChecksum | NetworkOffload::TCPSegmentation);
 
     setup_link();
     setup_interrupts();
@@ -10,6 +10,7 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Net/Intel/E1000NetworkAdapter.h>
 #include <Kernel/Net/NetworkingManagement.h>
+#include <Kernel/Net/TCP.h>
 #include <Kernel/Sections.h>
 
 namespace Kernel {
@@ -81,6 +82,20 @@ namespace Kernel {
 #define CMD_VLE (1 << 6)  // VLAN Packet Enable
 #define CMD_IDE (1 << 7)  // Interrupt Delay Enable
 
+// Extended Transmit Descriptors
+
+#define TXD_DTYP_CONTEXT (0 << 20)
+#define TXD_DTYP_DATA (1 << 20)
+#define TXD_CMD_EOP (1 << 24)  // End of Packet
+#define TXD_CMD_IFCS (1 << 25) // Insert FCS
+#define TXD_CMD_TSE (1 << 26)  // TCP Segmentation Enable
+#define TXD_CMD_RS (1 << 27)   // Report Status
+#define TXD_CMD_DEXT (1 << 29) // Descriptor Extension
+#define TXD_TUCMD_TCP (1 << 24)
+#define TXD_TUCMD_IP (1 << 25) // IPv4 (as opposed to IPv6)
+#define TXD_POPTS_IXSM (1 << 0) // Insert IP Checksum
+#define TXD_POPTS_TXSM (1 << 1) // Insert TCP/UDP Checksum
+
 // TCTL Register
 
 #define TCTL_EN (1 << 1)      // Transmit Enable
@@ -203,6 +218,7 @@ UNMAP_AFTER_INIT ErrorOr<void> E1000NetworkAdapter::initialize(Badge<NetworkingM
 
     initialize_rx_descriptors();
     initialize_tx_descriptors();
+    set_offloads(NetworkOffload::TCPChecksum | NetworkOffload::TCPSegmentation);
 
     setup_link();
     setup_interrupts();
@@ -344,14 +360,18 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_rx_descriptors()
     out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_8192);
 }
 
-UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_tx_descriptors()
+PhysicalPtr E1000NetworkAdapter::tx_buffer_physical_address(size_t index) const
 {
     constexpr auto tx_buffer_page_count = tx_buffer_size / PAGE_SIZE;
+    return m_tx_buffer_region->physical_page(tx_buffer_page_count * index)->paddr().get();
+}
 
+UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_tx_descriptors()
+{
     for (size_t i = 0; i < number_of_tx_descriptors; ++i) {
         auto& descriptor = m_tx_descriptors[i];
         m_tx_buffers[i] = m_tx_buffer_region->vaddr().as_ptr() + tx_buffer_size * i;
-        descriptor.addr = m_tx_buffer_region->physical_page(tx_buffer_page_count * i)->paddr().get();
+        descriptor.addr = tx_buffer_physical_address(i);
         descriptor.cmd = 0;
     }
 
@@ -410,6 +430,8 @@ void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
     VERIFY(payload.size() <= 8192);
     auto* vptr = (void*)m_tx_buffers[tx_current];
     memcpy(vptr, payload.data(), payload.size());
+    // NOTE: The descriptor may have been used as a context descriptor before, which doesn't point at a buffer.
+    descriptor.addr = tx_buffer_physical_address(tx_current);
     descriptor.length = payload.size();
     descriptor.status = 0;
     descriptor.cmd = CMD_EOP | CMD_IFCS | CMD_RS;
@@ -428,6 +450,78 @@ void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
     dbgln_if(E1000_DEBUG, "E1000: Sent packet, status is now {:#02x}!", (u8)descriptor.status);
 }
 
+void E1000NetworkAdapter::send_raw_with_offload(ReadonlyBytes payload, PacketOffload const& offload)
+{
+    VERIFY(offload.needs_checksum);
+    bool const is_segmented = offload.segment_size != 0;
+    // One context descriptor, followed by as many data descriptors as it takes to hold the packet.
+    VERIFY(ceil_div(payload.size(), tx_buffer_size) < number_of_tx_descriptors);
+
+    disable_irq();
+    size_t tx_current = in32(REG_TXDESCTAIL) % number_of_tx_descriptors;
+    dbgln_if(E1000_DEBUG, "E1000: Sending packet with offload ({} bytes, segment size {})", payload.size(), offload.segment_size);
+
+    auto& context = *reinterpret_cast<TxContextDescriptor volatile*>(&m_tx_descriptors[tx_current]);
+    context.ipcss = layer3_payload_offset();
+    context.ipcso = layer3_payload_offset() + 10; // The IPv4 header checksum
+    context.ipcse = ipv4_payload_offset() - 1;
+    context.tucss = offload.checksum_start;
+    context.tucso = offload.checksum_start + offload.checksum_offset;
+    context.tucse = 0; // Up to the end of the packet
+    u32 context_command = TXD_CMD_DEXT | TXD_DTYP_CONTEXT | TXD_TUCMD_IP | TXD_TUCMD_TCP;
+    if (is_segmented)
+        context_command |= TXD_CMD_TSE | (payload.size() - offload.header_size);
+    context.paylen_and_command = context_command;
+    context.status = 0;
+    context.hdrlen = is_segmented ? offload.header_size : 0;
+    context.mss = offload.segment_size;
+    tx_current = (tx_current + 1) % number_of_tx_descriptors;
+
+    TxDataDescriptor volatile* last_descriptor = nullptr;
+    for (size_t offset = 0; offset < payload.size(); offset += tx_buffer_size) {
+        auto chunk = payload.slice(offset, min(tx_buffer_size, payload.size() - offset));
+        auto* buffer = static_cast<u8*>(m_tx_buffers[tx_current]);
+        memcpy(buffer, chunk.data(), chunk.size());
+
+        if (is_segmented && offset == 0) {
+            // The adapter fills in the lengths and checksums of each segment, and expects the headers to be prepared
+            // for that: The IPv4 total length and checksum are zero, and the TCP checksum field holds the sum of the
+            // pseudo header without the length.
+            auto& ipv4 = *reinterpret_cast<IPv4Packet*>(buffer + layer3_payload_offset());
+            ipv4.set_length(0);
+            ipv4.set_checksum(0);
+            auto& tcp = *reinterpret_cast<TCPPacket*>(buffer + offload.checksum_start);
+            tcp.set_checksum(ipv4_pseudo_header_checksum(ipv4.source(), ipv4.destination(), TransportProtocol::TCP, 0));
+        }
+
+        auto& descriptor = *reinterpret_cast<TxDataDescriptor volatile*>(&m_tx_descriptors[tx_current]);
+        descriptor.addr = tx_buffer_physical_address(tx_current);
+        u32 command = TXD_CMD_DEXT | TXD_DTYP_DATA | TXD_CMD_IFCS | chunk.size();
+        if (is_segmented)
+            command |= TXD_CMD_TSE;
+        if (offset + chunk.size() == payload.size())
+            command |= TXD_CMD_EOP | TXD_CMD_RS;
+        descriptor.length_and_command = command;
+        descriptor.status = 0;
+        descriptor.popts = TXD_POPTS_TXSM | (is_segmented ? TXD_POPTS_IXSM : 0);
+        last_descriptor = &descriptor;
+        tx_current = (tx_current + 1) % number_of_tx_descriptors;
+    }
+    VERIFY(last_descriptor);
+
+    Processor::disable_interrupts();
+    enable_irq();
+    out32(REG_TXDESCTAIL, tx_current);
+    for (;;) {
+        if (last_descriptor->status) {
+            Processor::enable_interrupts();
+            break;
+        }
+        m_wait_queue.wait_forever("E1000NetworkAdapter"sv);
+    }
+    dbgln_if(E1000_DEBUG, "E1000: Sent packet with offload, status is now {:#02x}!", (u8)last_descriptor->status);
+}
+
 void E1000NetworkAdapter::receive()
 {
     u32 rx_current;
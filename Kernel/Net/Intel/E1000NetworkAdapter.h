@@ -28,6 +28,7 @@ public:
     virtual ~E1000NetworkAdapter() override;
 
     virtual void send_raw(ReadonlyBytes) override;
+    virtual void send_raw_with_offload(ReadonlyBytes, PacketOffload const&) override;
     virtual bool link_up() override { return m_link_up; }
     virtual i32 link_speed() override;
     virtual bool link_full_duplex() override;
@@ -61,6 +62,31 @@ protected:
     };
     static_assert(AssertSize<TxDescriptor, 16>());
 
+    // Offloading checksums and segmentation takes a context descriptor that describes the headers, followed by
+    // extended data descriptors. Both take the place of a TxDescriptor in the ring.
+    struct TxContextDescriptor {
+        uint8_t ipcss { 0 };  // IP checksum start
+        uint8_t ipcso { 0 };  // IP checksum offset
+        uint16_t ipcse { 0 }; // IP checksum end
+        uint8_t tucss { 0 };  // TCP/UDP checksum start
+        uint8_t tucso { 0 };  // TCP/UDP checksum offset
+        uint16_t tucse { 0 }; // TCP/UDP checksum end
+        uint32_t paylen_and_command { 0 };
+        uint8_t status { 0 };
+        uint8_t hdrlen { 0 };
+        uint16_t mss { 0 };
+    };
+    static_assert(AssertSize<TxContextDescriptor, 16>());
+
+    struct TxDataDescriptor {
+        uint64_t addr { 0 };
+        uint32_t length_and_command { 0 };
+        uint8_t status { 0 };
+        uint8_t popts { 0 };
+        uint16_t special { 0 };
+    };
+    static_assert(AssertSize<TxDataDescriptor, 16>());
+
     void setup_interrupts();
     void setup_link();
 
@@ -79,6 +105,7 @@ protected:
 
     void initialize_rx_descriptors();
     void initialize_tx_descriptors();
+    PhysicalPtr tx_buffer_physical_address(size_t index) const;
 
     void out8(u16 address, u8);
     void out16(u16 address, u16);
@@ -6,6 +6,7 @@
 
 #include <AK/Singleton.h>
 #include <Kernel/Net/LoopbackAdapter.h>
+#include <Kernel/Security/Random.h>
 
 namespace Kernel {
 
@@ -26,12 +27,22 @@ LoopbackAdapter::LoopbackAdapter(StringView interface_name)
     // by the data-link (Ethernet in this case) or physical layers, we need to subtract it from the MTU.
     set_mtu(65536 - sizeof(EthernetFrameHeader));
     set_mac_address({ 19, 85, 2, 9, 0x55, 0xaa });
+    // Packets never leave the machine, so there's no point in checksumming them.
+    set_offloads(NetworkOffload::TCPChecksum);
 }
 
 LoopbackAdapter::~LoopbackAdapter() = default;
 
+Atomic<u8> LoopbackAdapter::s_packet_loss_percentage { 0 };
+
 void LoopbackAdapter::send_raw(ReadonlyBytes payload)
 {
+    auto packet_loss_percentage = LoopbackAdapter::packet_loss_percentage();
+    if (packet_loss_percentage > 0 && get_fast_random<u8>() % 100 < packet_loss_percentage) {
+        dbgln_if(LOOPBACK_DEBUG, "LoopbackAdapter: Dropping {} byte(s) on purpose.", payload.size());
+        return;
+    }
+
     dbgln_if(LOOPBACK_DEBUG, "LoopbackAdapter: Sending {} byte(s) to myself.", payload.size());
     did_receive(payload);
 }
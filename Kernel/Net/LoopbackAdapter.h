@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <Kernel/Net/NetworkAdapter.h>
 
 namespace Kernel {
@@ -26,6 +27,13 @@ public:
     virtual bool link_up() override { return true; }
     virtual bool link_full_duplex() override { return true; }
     virtual int link_speed() override { return 1000; }
+
+    // Drops the given percentage of outgoing packets, for exercising loss recovery in the network stack.
+    static u8 packet_loss_percentage() { return s_packet_loss_percentage.load(AK::MemoryOrder::memory_order_relaxed); }
+    static void set_packet_loss_percentage(u8 percentage) { s_packet_loss_percentage.store(percentage, AK::MemoryOrder::memory_order_relaxed); }
+
+private:
+    static Atomic<u8> s_packet_loss_percentage;
 };
 
 }
@@ -10,6 +10,7 @@
 #include <Kernel/Net/EtherType.h>
 #include <Kernel/Net/NetworkAdapter.h>
 #include <Kernel/Net/NetworkingManagement.h>
+#include <Kernel/Net/TCP.h>
 #include <Kernel/Tasks/Process.h>
 
 namespace Kernel {
@@ -23,9 +24,99 @@ NetworkAdapter::~NetworkAdapter() = default;
 
 void NetworkAdapter::send_packet(ReadonlyBytes packet)
 {
+    send_packet(packet, {});
+}
+
+void NetworkAdapter::send_packet(ReadonlyBytes packet, PacketOffload const& offload)
+{
+    // Whatever the adapter can't do on its own is done here, as late as possible.
+    if (offload.segment_size != 0 && !supports(NetworkOffload::TCPSegmentation))
+        return send_segmented(packet, offload);
+    if (offload.needs_checksum && !supports(NetworkOffload::TCPChecksum))
+        return send_with_checksum(packet, offload);
+
     m_packets_out++;
     m_bytes_out += packet.size();
-    send_raw(packet);
+    if (offload.segment_size != 0 || offload.needs_checksum)
+        send_raw_with_offload(packet, offload);
+    else
+        send_raw(packet);
+}
+
+static void complete_checksum(Bytes frame, PacketOffload const& offload)
+{
+    VERIFY(offload.checksum_start + offload.checksum_offset + sizeof(u16) <= frame.size());
+    // The checksum field already holds the sum of the pseudo header, so it's simply summed up along with the rest.
+    InternetChecksum checksum;
+    checksum.add(frame.slice(offload.checksum_start));
+    auto result = checksum.finish();
+    memcpy(frame.offset_pointer(offload.checksum_start + offload.checksum_offset), &result, sizeof(result));
+}
+
+void NetworkAdapter::send_with_checksum(ReadonlyBytes packet, PacketOffload const& offload)
+{
+    // NOTE: Packets are kept around for retransmission, possibly through another adapter, so we finish a copy.
+    auto copy = acquire_packet_buffer(packet.size());
+    if (!copy) {
+        dbgln("NetworkAdapter: Dropping outbound packet as there is not enough memory to buffer it");
+        return;
+    }
+    auto bytes = copy->buffer->bytes();
+    packet.copy_to(bytes);
+    complete_checksum(bytes, offload);
+    send_packet(bytes);
+    release_packet_buffer(*copy);
+}
+
+void NetworkAdapter::send_segmented(ReadonlyBytes packet, PacketOffload const& offload)
+{
+    // This is segmentation offload in software: Every segment gets a copy of the headers, which are then fixed up
+    // to describe just the part of the payload that it carries.
+    VERIFY(offload.header_size >= ipv4_payload_offset() + sizeof(TCPPacket));
+    VERIFY(offload.header_size <= packet.size());
+    auto headers = packet.trim(offload.header_size);
+    auto payload = packet.slice(offload.header_size);
+    auto const& original_tcp = *bit_cast<TCPPacket const*>(headers.offset_pointer(ipv4_payload_offset()));
+    size_t const tcp_header_size = offload.header_size - ipv4_payload_offset();
+
+    for (size_t offset = 0; offset < payload.size(); offset += offload.segment_size) {
+        auto segment_payload = payload.slice(offset, min<size_t>(offload.segment_size, payload.size() - offset));
+        bool const is_last_segment = offset + segment_payload.size() == payload.size();
+
+        auto segment = acquire_packet_buffer(headers.size() + segment_payload.size());
+        if (!segment) {
+            // The remaining segments are lost, which TCP recovers from like from any other loss.
+            dbgln("NetworkAdapter: Dropping outbound segments as there is not enough memory to buffer them");
+            return;
+        }
+        auto bytes = segment->buffer->bytes();
+        headers.copy_to(bytes);
+        segment_payload.copy_to(bytes.slice(headers.size()));
+
+        auto& ipv4 = *bit_cast<IPv4Packet*>(bytes.offset_pointer(layer3_payload_offset()));
+        ipv4.set_length(sizeof(IPv4Packet) + tcp_header_size + segment_payload.size());
+        ipv4.set_checksum(0);
+        ipv4.set_checksum(ipv4.compute_checksum());
+
+        auto& tcp = *bit_cast<TCPPacket*>(bytes.offset_pointer(ipv4_payload_offset()));
+        tcp.set_sequence_number(original_tcp.sequence_number() + offset);
+        if (!is_last_segment)
+            tcp.set_flags(tcp.flags() & ~(TCPFlags::FIN | TCPFlags::PSH));
+        tcp.set_checksum(ipv4_pseudo_header_checksum(ipv4.source(), ipv4.destination(), TransportProtocol::TCP, tcp_header_size + segment_payload.size()));
+
+        PacketOffload segment_offload {
+            .needs_checksum = true,
+            .checksum_start = offload.checksum_start,
+            .checksum_offset = offload.checksum_offset,
+        };
+        // We own this copy, so there's no need for send_packet() to make another one.
+        if (!supports(NetworkOffload::TCPChecksum)) {
+            complete_checksum(bytes, segment_offload);
+            segment_offload = {};
+        }
+        send_packet(bytes, segment_offload);
+        release_packet_buffer(*segment);
+    }
 }
 
 void NetworkAdapter::send(MACAddress const& destination, ARPPacket const& packet)
@@ -47,7 +138,8 @@ void NetworkAdapter::send(MACAddress const& destination, ARPPacket const& packet
 void NetworkAdapter::fill_in_ipv4_header(PacketWithTimestamp& packet, IPv4Address const& source_ipv4, MACAddress const& destination_mac, IPv4Address const& destination_ipv4, TransportProtocol protocol, size_t payload_size, u8 type_of_service, u8 ttl)
 {
     size_t ipv4_packet_size = sizeof(IPv4Packet) + payload_size;
-    VERIFY(ipv4_packet_size <= mtu());
+    // Packets that are going to be segmented before they hit the wire only have to fit into the IPv4 length field.
+    VERIFY(ipv4_packet_size <= (packet.offload.segment_size != 0 ? max_segmentation_size : mtu()));
 
     size_t ethernet_frame_size = ipv4_payload_offset() + payload_size;
     VERIFY(packet.buffer->size() == ethernet_frame_size);
@@ -103,13 +195,56 @@ void NetworkAdapter::fill_in_ipv6_header(PacketWithTimestamp& packet, IPv6Addres
     ipv6.set_hop_limit(hop_limit);
 }
 
+void NetworkAdapter::set_receive_queue_count(size_t count)
+{
+    VERIFY(count > 0 && count <= max_receive_queues);
+    m_receive_queue_count.store(count);
+}
+
+size_t NetworkAdapter::receive_queue_for(ReadonlyBytes frame) const
+{
+    auto queue_count = receive_queue_count();
+    if (queue_count == 1)
+        return 0;
+
+    // Everything that isn't IPv4 is rare enough to go to the first queue.
+    if (frame.size() < sizeof(EthernetFrameHeader) + sizeof(IPv4Packet))
+        return 0;
+    auto& eth = *reinterpret_cast<EthernetFrameHeader const*>(frame.data());
+    if (eth.ether_type() != EtherType::IPv4)
+        return 0;
+    auto& ipv4_packet = *static_cast<IPv4Packet const*>(eth.payload());
+
+    // Both directions of a connection have to end up in the same queue, so the hash mustn't depend on which
+    // side is the source. Fragments don't all carry the ports, so only their addresses count.
+    u32 source = ipv4_packet.source().to_u32();
+    u32 destination = ipv4_packet.destination().to_u32();
+    auto protocol = static_cast<TransportProtocol>(ipv4_packet.protocol());
+    if ((protocol == TransportProtocol::TCP || protocol == TransportProtocol::UDP) && !ipv4_packet.is_a_fragment()
+        && frame.size() >= sizeof(EthernetFrameHeader) + sizeof(IPv4Packet) + 2 * sizeof(u16)) {
+        auto const* ports = static_cast<u8 const*>(ipv4_packet.payload());
+        source = pair_int_hash(source, (ports[0] << 8) | ports[1]);
+        destination = pair_int_hash(destination, (ports[2] << 8) | ports[3]);
+    }
+    return pair_int_hash(min(source, destination), max(source, destination)) % queue_count;
+}
+
 void NetworkAdapter::did_receive(ReadonlyBytes payload)
 {
     InterruptDisabler disabler;
     m_packets_in++;
     m_bytes_in += payload.size();
 
-    if (m_packet_queue_size == max_packet_buffers) {
+    auto queue_index = receive_queue_for(payload);
+    auto& receive_queue = m_receive_queues[queue_index];
+    bool is_full = receive_queue.with([&](auto& queue) {
+        ++queue.statistics.packets_in;
+        if (queue.size < max_packet_buffers)
+            return false;
+        ++queue.statistics.packets_dropped;
+        return true;
+    });
+    if (is_full) {
         m_packets_dropped++;
         return;
     }
@@ -122,20 +257,26 @@ void NetworkAdapter::did_receive(ReadonlyBytes payload)
 
     memcpy(packet->buffer->data(), payload.data(), payload.size());
 
-    m_packet_queue.append(*packet);
-    m_packet_queue_size++;
+    receive_queue.with([&](auto& queue) {
+        queue.packets.append(*packet);
+        queue.size++;
+    });
 
     if (on_receive)
-        on_receive();
+        on_receive(queue_index);
 }
 
-size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, UnixDateTime& packet_timestamp)
+size_t NetworkAdapter::dequeue_packet(size_t queue_index, u8* buffer, size_t buffer_size, UnixDateTime& packet_timestamp)
 {
-    InterruptDisabler disabler;
-    if (m_packet_queue.is_empty())
+    auto packet_with_timestamp = m_receive_queues[queue_index].with([](auto& queue) -> RefPtr<PacketWithTimestamp> {
+        if (queue.packets.is_empty())
+            return nullptr;
+        queue.size--;
+        return queue.packets.take_first();
+    });
+    if (!packet_with_timestamp)
         return 0;
-    auto packet_with_timestamp = m_packet_queue.take_first();
-    m_packet_queue_size--;
+
     packet_timestamp = packet_with_timestamp->timestamp;
     auto& packet_buffer = packet_with_timestamp->buffer;
     size_t packet_size = packet_buffer->size();
@@ -145,6 +286,20 @@ size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, UnixDateTi
     return packet_size;
 }
 
+bool NetworkAdapter::has_queued_packets(size_t queue_index) const
+{
+    return m_receive_queues[queue_index].with([](auto const& queue) {
+        return !queue.packets.is_empty();
+    });
+}
+
+NetworkAdapter::ReceiveQueueStatistics NetworkAdapter::receive_queue_statistics(size_t queue_index) const
+{
+    return m_receive_queues[queue_index].with([](auto const& queue) {
+        return queue.statistics;
+    });
+}
+
 RefPtr<PacketWithTimestamp> NetworkAdapter::acquire_packet_buffer(size_t size)
 {
     auto packet = m_unused_packets.with([size](auto& unused_packets) -> RefPtr<PacketWithTimestamp> {
@@ -162,6 +317,7 @@ RefPtr<PacketWithTimestamp> NetworkAdapter::acquire_packet_buffer(size_t size)
 
     if (packet) {
         packet->timestamp = kgettimeofday();
+        packet->offload = {};
         packet->buffer->set_size(size);
         return packet;
     }
@@ -6,8 +6,11 @@
 
 #pragma once
 
+#include <AK/Array.h>
+#include <AK/Atomic.h>
 #include <AK/AtomicRefCounted.h>
 #include <AK/ByteBuffer.h>
+#include <AK/EnumBits.h>
 #include <AK/Function.h>
 #include <AK/IPv6Address.h>
 #include <AK/IntrusiveList.h>
@@ -18,6 +21,7 @@
 #include <Kernel/Library/LockWeakPtr.h>
 #include <Kernel/Library/LockWeakable.h>
 #include <Kernel/Library/UserOrKernelBuffer.h>
+#include <Kernel/Locking/SpinlockProtected.h>
 #include <Kernel/Net/EthernetFrameHeader.h>
 #include <Kernel/Net/ICMP.h>
 #include <Kernel/Net/IP/ARP.h>
@@ -31,6 +35,26 @@ class NetworkAdapter;
 
 using NetworkByteBuffer = AK::Detail::ByteBuffer<1500>;
 
+// Work that an adapter can do on behalf of the network stack when sending packets.
+enum class NetworkOffload : u8 {
+    None = 0,
+    TCPChecksum = 1 << 0,
+    TCPSegmentation = 1 << 1,
+};
+AK_ENUM_BITWISE_OPERATORS(NetworkOffload);
+
+// Describes what is left to do before a packet can go out on the wire. If the checksum is still needed, its field
+// holds the checksum of the pseudo header, and the rest of the checksum covers everything from checksum_start onwards.
+// If a segment size is given, the packet is a single TCP segment that is larger than the MTU and has to be cut into
+// segments of that size, each with a copy of the first header_size bytes of the frame.
+struct PacketOffload {
+    bool needs_checksum { false };
+    u16 checksum_start { 0 };
+    u16 checksum_offset { 0 };
+    u16 segment_size { 0 };
+    u16 header_size { 0 };
+};
+
 struct PacketWithTimestamp final : public AtomicRefCounted<PacketWithTimestamp> {
     PacketWithTimestamp(NonnullOwnPtr<KBuffer> buffer, UnixDateTime timestamp)
         : buffer(move(buffer))
@@ -42,6 +66,7 @@ struct PacketWithTimestamp final : public AtomicRefCounted<PacketWithTimestamp>
 
     NonnullOwnPtr<KBuffer> buffer;
     UnixDateTime timestamp;
+    PacketOffload offload;
     IntrusiveListNode<PacketWithTimestamp, RefPtr<PacketWithTimestamp>> packet_node;
 };
 
@@ -57,6 +82,9 @@ public:
 
     static constexpr i32 LINKSPEED_INVALID = -1;
 
+    // The largest IPv4 packet that may be handed to send_packet() when it's going to be segmented anyway.
+    static constexpr size_t max_segmentation_size = NumericLimits<u16>::max();
+
     virtual ~NetworkAdapter();
 
     virtual StringView class_name() const = 0;
@@ -92,9 +120,25 @@ public:
     void fill_in_ipv4_header(PacketWithTimestamp&, IPv4Address const&, MACAddress const&, IPv4Address const&, TransportProtocol, size_t, u8 type_of_service, u8 ttl);
     void fill_in_ipv6_header(PacketWithTimestamp&, IPv6Address const&, MACAddress const&, IPv6Address const&, TransportProtocol, size_t, u8 hop_limit);
 
-    size_t dequeue_packet(u8* buffer, size_t buffer_size, UnixDateTime& packet_timestamp);
+    // Received packets are spread across several queues by the flow they belong to, so that each queue can be
+    // processed by a thread of its own, while the packets of a single connection are still processed in order.
+    static constexpr size_t max_receive_queues = 8;
 
-    bool has_queued_packets() const { return !m_packet_queue.is_empty(); }
+    size_t receive_queue_count() const { return m_receive_queue_count.load(); }
+    void set_receive_queue_count(size_t);
+
+    size_t dequeue_packet(size_t queue_index, u8* buffer, size_t buffer_size, UnixDateTime& packet_timestamp);
+
+    bool has_queued_packets(size_t queue_index) const;
+
+    struct ReceiveQueueStatistics {
+        u64 packets_in { 0 };
+        u64 packets_dropped { 0 };
+    };
+    ReceiveQueueStatistics receive_queue_statistics(size_t queue_index) const;
+
+    NetworkOffload offloads() const { return m_offloads; }
+    bool supports(NetworkOffload offload) const { return has_flag(m_offloads, offload); }
 
     u32 mtu() const { return m_mtu; }
     void set_mtu(u32 mtu) { m_mtu = mtu; }
@@ -112,18 +156,25 @@ public:
     constexpr size_t ipv4_payload_offset() const { return layer3_payload_offset() + sizeof(IPv4Packet); }
     constexpr size_t ipv6_payload_offset() const { return layer3_payload_offset() + sizeof(IPv6PacketHeader); }
 
-    Function<void()> on_receive;
+    Function<void(size_t queue_index)> on_receive;
 
     void send_packet(ReadonlyBytes);
+    void send_packet(ReadonlyBytes, PacketOffload const&);
 
 protected:
     NetworkAdapter(StringView);
     void set_mac_address(MACAddress const& mac_address) { m_mac_address = mac_address; }
     void did_receive(ReadonlyBytes);
     virtual void send_raw(ReadonlyBytes) = 0;
+    // Only called with the work that the adapter claims to support in offloads().
+    virtual void send_raw_with_offload(ReadonlyBytes packet, PacketOffload const&) { send_raw(packet); }
+    void set_offloads(NetworkOffload offloads) { m_offloads = offloads; }
     void autoconfigure_link_local_ipv6();
 
 private:
+    void send_segmented(ReadonlyBytes, PacketOffload const&);
+    void send_with_checksum(ReadonlyBytes, PacketOffload const&);
+
     MACAddress m_mac_address;
     // FIXME: Allow for more than one IPv4/IPv6 address each.
     IPv4Address m_ipv4_address;
@@ -136,8 +187,16 @@ private:
 
     using PacketList = IntrusiveList<&PacketWithTimestamp::packet_node>;
 
-    PacketList m_packet_queue;
-    size_t m_packet_queue_size { 0 };
+    struct ReceiveQueue {
+        PacketList packets;
+        size_t size { 0 };
+        ReceiveQueueStatistics statistics;
+    };
+
+    size_t receive_queue_for(ReadonlyBytes frame) const;
+
+    Array<SpinlockProtected<ReceiveQueue, LockRank::None>, max_receive_queues> m_receive_queues {};
+    Atomic<size_t> m_receive_queue_count { 1 };
     SpinlockProtected<PacketList, LockRank::None> m_unused_packets {};
     FixedStringBuffer<IFNAMSIZ> m_name;
     u32 m_packets_in { 0 };
@@ -145,6 +204,7 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
     u32 m_mtu { 1500 };
+    NetworkOffload m_offloads { NetworkOffload::None };
     u32 m_packets_dropped { 0 };
 };
 
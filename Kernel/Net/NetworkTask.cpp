@@ -39,31 +39,66 @@ static void handle_udp(IPv4Packet const&, UnixDateTime const& packet_timestamp);
 static void handle_tcp(IPv4Packet const&, UnixDateTime const& packet_timestamp, RefPtr<NetworkAdapter> adapter);
 static void send_delayed_tcp_ack(TCPSocket& socket);
 static void send_tcp_rst(IPv4Packet const& ipv4_packet, TCPPacket const& tcp_packet, RefPtr<NetworkAdapter> adapter);
-static void flush_delayed_tcp_acks();
 static void retransmit_tcp_packets();
 
-static Thread* network_task = nullptr;
-static HashTable<NonnullRefPtr<TCPSocket>>* delayed_ack_sockets;
+// Every receive queue of every adapter gets a worker thread of its own. Since adapters keep all packets of a flow
+// in the same queue, a connection is only ever processed by one worker at a time.
+struct NetworkWorker {
+    NonnullRefPtr<NetworkAdapter> adapter;
+    size_t queue_index { 0 };
+    Thread* thread { nullptr };
+    WaitQueue packet_wait_queue;
+    HashTable<NonnullRefPtr<TCPSocket>> delayed_ack_sockets;
+};
+
+static Process* network_task = nullptr;
+static Vector<NonnullOwnPtr<NetworkWorker>>* workers;
+static Atomic<bool> is_retransmitting;
+
+static NetworkWorker& current_worker();
+[[noreturn]] static void process_packets(NetworkWorker&);
+static void flush_delayed_tcp_acks(NetworkWorker&);
 
 [[noreturn]] static void NetworkTask_main(void*);
 
 void NetworkTask::spawn()
 {
-    auto [_, first_thread] = MUST(Process::create_kernel_process("Network Task"sv, NetworkTask_main, nullptr));
-    network_task = first_thread;
+    auto [process, _] = MUST(Process::create_kernel_process("Network Task"sv, NetworkTask_main, nullptr));
+    network_task = process.ptr();
 }
 
 bool NetworkTask::is_current()
 {
-    return Thread::current() == network_task;
+    return &Process::current() == network_task;
+}
+
+ErrorOr<void> NetworkTask::try_for_each_worker(Function<ErrorOr<void>(NetworkAdapter const&, size_t queue_index, Thread const&)> callback)
+{
+    // The workers are set up once when the task starts, and never go away.
+    if (!workers)
+        return {};
+    for (auto& worker : *workers) {
+        if (worker->thread)
+            TRY(callback(*worker->adapter, worker->queue_index, *worker->thread));
+    }
+    return {};
+}
+
+NetworkWorker& current_worker()
+{
+    auto* thread = Thread::current();
+    for (auto& worker : *workers) {
+        if (worker->thread == thread)
+            return *worker;
+    }
+    VERIFY_NOT_REACHED();
 }
 
 void NetworkTask_main(void*)
 {
-    delayed_ack_sockets = new HashTable<NonnullRefPtr<TCPSocket>>;
+    workers = new Vector<NonnullOwnPtr<NetworkWorker>>;
 
-    WaitQueue packet_wait_queue;
-    int pending_packets = 0;
+    auto queue_count = min<size_t>(Processor::count(), NetworkAdapter::max_receive_queues);
     NetworkingManagement::the().for_each([&](auto& adapter) {
         dmesgln("NetworkTask: {} network adapter found: hw={}", adapter.class_name(), adapter.mac_address().to_string());
 
@@ -72,12 +107,37 @@ void NetworkTask_main(void*)
             adapter.set_ipv4_netmask({ 255, 0, 0, 0 });
         }
 
-        adapter.on_receive = [&]() {
-            pending_packets++;
-            packet_wait_queue.wake_all();
+        adapter.set_receive_queue_count(queue_count);
+        for (size_t queue_index = 0; queue_index < queue_count; ++queue_index)
+            workers->append(MUST(try_make<NetworkWorker>(adapter, queue_index)));
+    });
+
+    // The first worker runs on this thread, all others get one of their own.
+    auto& main_worker = *workers->first();
+    main_worker.thread = Thread::current();
+    for (size_t i = 1; i < workers->size(); ++i) {
+        auto& worker = *workers->at(i);
+        auto name = MUST(KString::formatted("Network Task: {} queue {}", worker.adapter->name(), worker.queue_index));
+        auto thread = MUST(Process::current().create_kernel_thread(name->view(), [&worker] { process_packets(worker); }));
+        worker.thread = thread.ptr();
+    }
+
+    NetworkingManagement::the().for_each([&](auto& adapter) {
+        adapter.on_receive = [&adapter](size_t queue_index) {
+            for (auto& worker : *workers) {
+                if (worker->adapter.ptr() == &adapter && worker->queue_index == queue_index) {
+                    worker->packet_wait_queue.wake_all();
+                    return;
+                }
+            }
         };
     });
 
+    process_packets(main_worker);
+}
+
+void process_packets(NetworkWorker& worker)
+{
     size_t buffer_size = 64 * KiB;
     auto region_or_error = MM.allocate_kernel_region(buffer_size, "Kernel Packet Buffer"sv, Memory::Region::Access::ReadWrite);
     if (region_or_error.is_error())
@@ -91,27 +151,20 @@ void NetworkTask_main(void*)
     } meta;
 
     meta.buffer = (u8*)buffer_region->vaddr().get();
+    meta.adapter = worker.adapter;
 
     while (!Process::current().is_dying()) {
-        flush_delayed_tcp_acks();
+        flush_delayed_tcp_acks(worker);
         retransmit_tcp_packets();
-        size_t packet_size = 0;
-        if (!pending_packets) {
+        size_t packet_size = worker.adapter->dequeue_packet(worker.queue_index, meta.buffer, buffer_size, meta.packet_timestamp);
+        if (!packet_size) {
             auto timeout_time = Duration::from_milliseconds(500);
             auto timeout = Thread::BlockTimeout { false, &timeout_time };
-            [[maybe_unused]] auto result = packet_wait_queue.wait_on(timeout, "NetworkTask"sv);
+            [[maybe_unused]] auto result = worker.packet_wait_queue.wait_on(timeout, "NetworkTask"sv);
             continue;
-        } else {
-            NetworkingManagement::the().for_each([&](auto& adapter) {
-                if (packet_size || !adapter.has_queued_packets()) {
-                    return;
-                }
-                packet_size = adapter.dequeue_packet(meta.buffer, buffer_size, meta.packet_timestamp);
-                pending_packets--;
-                dbgln_if(NETWORK_TASK_DEBUG, "NetworkTask: Dequeued packet from {} ({} bytes)", adapter.name(), packet_size);
-                meta.adapter = adapter;
-            });
         }
+        dbgln_if(NETWORK_TASK_DEBUG, "NetworkTask: Dequeued packet from {} queue {} ({} bytes)", worker.adapter->name(), worker.queue_index, packet_size);
+
         if (packet_size < sizeof(EthernetFrameHeader)) {
             dbgln("NetworkTask: Packet is too small to be an Ethernet packet! ({})", packet_size);
             continue;
@@ -476,13 +529,13 @@ void send_delayed_tcp_ack(TCPSocket& socket)
         return;
     }
 
-    delayed_ack_sockets->set(move(socket));
+    current_worker().delayed_ack_sockets.set(move(socket));
 }
 
-void flush_delayed_tcp_acks()
+void flush_delayed_tcp_acks(NetworkWorker& worker)
 {
     Vector<NonnullRefPtr<TCPSocket>, 32> remaining_sockets;
-    for (auto& socket : *delayed_ack_sockets) {
+    for (auto& socket : worker.delayed_ack_sockets) {
         MutexLocker locker(socket->mutex());
         if (socket->should_delay_next_ack()) {
             MUST(remaining_sockets.try_append(*socket));
@@ -491,12 +544,12 @@ void flush_delayed_tcp_acks()
         [[maybe_unused]] auto result = socket->send_ack();
     }
 
-    if (remaining_sockets.size() != delayed_ack_sockets->size()) {
-        delayed_ack_sockets->clear();
+    if (remaining_sockets.size() != worker.delayed_ack_sockets.size()) {
+        worker.delayed_ack_sockets.clear();
         if (remaining_sockets.size() > 0)
             dbgln("flush_delayed_tcp_acks: {} sockets remaining", remaining_sockets.size());
         for (auto&& socket : remaining_sockets)
-            delayed_ack_sockets->set(move(socket));
+            worker.delayed_ack_sockets.set(move(socket));
     }
 }
 
@@ -593,18 +646,48 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
 
     socket->receive_tcp_packet(tcp_packet, ipv4_packet.payload_size());
     Optional<u8> send_window_scale;
+    Optional<u16> peer_maximum_segment_size;
+    bool sack_permitted = false;
     if (tcp_packet.has_syn()) {
-        tcp_packet.for_each_option([&send_window_scale](auto const& option) {
-            if (option.kind() != TCPOptionKind::WindowScale)
+        tcp_packet.for_each_option([&](auto const& option) {
+            switch (option.kind()) {
+            case TCPOptionKind::WindowScale: {
+                if (option.length() != sizeof(TCPOptionWindowScale))
+                    return;
+                auto scale = static_cast<TCPOptionWindowScale const&>(option).value();
+                if (scale > 14)
+                    return; // Maximum allowed as per RFC7323
+                send_window_scale = scale;
+                return;
+            }
+            case TCPOptionKind::MSS: {
+                if (option.length() != sizeof(TCPOptionMSS))
+                    return;
+                auto value = static_cast<TCPOptionMSS const&>(option).value();
+                if (value == 0)
+                    return;
+                peer_maximum_segment_size = value;
                 return;
-            if (option.length() != sizeof(TCPOptionWindowScale))
+            }
+            case TCPOptionKind::SACKPermitted:
+                if (option.length() != sizeof(TCPOptionSACKPermitted))
+                    return;
+                sack_permitted = true;
+                return;
+            default:
                 return;
-            auto scale = static_cast<TCPOptionWindowScale const&>(option).value();
-            if (scale > 14)
-                return; // Maximum allowed as per RFC7323
-            send_window_scale = scale;
+            }
         });
     }
+    auto apply_syn_options = [&](TCPSocket& socket) {
+        if (send_window_scale.has_value())
+            socket.set_send_window_scale(*send_window_scale);
+        if (peer_maximum_segment_size.has_value())
+            socket.set_peer_maximum_segment_size(*peer_maximum_segment_size);
+        // We always offer SACK ourselves, so it's enabled as soon as the peer offers it too.
+        if (sack_permitted)
+            socket.set_sack_permitted();
+    };
 
     switch (socket->state()) {
     case TCPSocket::State::Closed:
@@ -639,8 +722,7 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
             client->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             [[maybe_unused]] auto rc2 = client->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
             client->set_state(TCPSocket::State::SynReceived);
-            if (send_window_scale.has_value())
-                client->set_send_window_scale(*send_window_scale);
+            apply_syn_options(*client);
             return;
         }
         default:
@@ -654,8 +736,7 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             (void)socket->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
             socket->set_state(TCPSocket::State::SynReceived);
-            if (send_window_scale.has_value())
-                socket->set_send_window_scale(*send_window_scale);
+            apply_syn_options(*socket);
             return;
         case TCPFlags::ACK | TCPFlags::SYN:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
@@ -663,8 +744,7 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
             socket->set_state(TCPSocket::State::Established);
             socket->set_setup_state(Socket::SetupState::Completed);
             socket->set_connected(true);
-            if (send_window_scale.has_value())
-                socket->set_send_window_scale(*send_window_scale);
+            apply_syn_options(*socket);
             return;
         case TCPFlags::ACK | TCPFlags::FIN:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
@@ -816,8 +896,12 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
         }
 
         if (tcp_packet.sequence_number() != socket->ack_number()) {
-            dbgln_if(TCP_DEBUG, "Discarding out of order packet: seq {} vs. ack {}", tcp_packet.sequence_number(), socket->ack_number());
-            if (socket->duplicate_acks() < TCPSocket::maximum_duplicate_acks) {
+            bool queued = false;
+            if (!tcp_packet.has_fin())
+                queued = socket->queue_out_of_order_segment(tcp_packet, { &ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size() }, payload_size, packet_timestamp);
+            dbgln_if(TCP_DEBUG, "{} out of order packet: seq {} vs. ack {}", queued ? "Queueing" : "Discarding", tcp_packet.sequence_number(), socket->ack_number());
+            // Every segment that we hold on to has to be reported, since the SACK blocks tell the peer what to resend.
+            if (queued || socket->duplicate_acks() < TCPSocket::maximum_duplicate_acks) {
                 dbgln_if(TCP_DEBUG, "Sending ACK with same ack number to trigger fast retransmission");
                 socket->set_duplicate_acks(socket->duplicate_acks() + 1);
                 [[maybe_unused]] auto result = socket->send_ack(true);
@@ -843,7 +927,13 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
                 socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
                 dbgln_if(TCP_DEBUG, "Got packet with ack_no={}, seq_no={}, payload_size={}, acking it with new ack_no={}, seq_no={}",
                     tcp_packet.ack_number(), tcp_packet.sequence_number(), payload_size, socket->ack_number(), socket->sequence_number());
-                send_delayed_tcp_ack(*socket);
+                // RFC 5681, section 4.2: An ACK should be sent immediately when a segment fills in a gap.
+                if (socket->has_out_of_order_segments()) {
+                    socket->deliver_out_of_order_segments();
+                    [[maybe_unused]] auto result = socket->send_ack(true);
+                } else {
+                    send_delayed_tcp_ack(*socket);
+                }
             }
         }
     }
@@ -851,6 +941,11 @@ void handle_tcp(IPv4Packet const& ipv4_packet, UnixDateTime const& packet_timest
 
 void retransmit_tcp_packets()
 {
+    // Any worker can do this, but there's no point in several of them doing it at once.
+    if (is_retransmitting.exchange(true))
+        return;
+    ScopeGuard done_retransmitting = [] { is_retransmitting.store(false); };
+
     // We must keep the sockets alive until after we've unlocked the hash table
     // in case retransmit_packets() realizes that it wants to close the socket.
     Vector<NonnullRefPtr<TCPSocket>, 16> sockets;
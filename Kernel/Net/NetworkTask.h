@@ -6,10 +6,19 @@
 
 #pragma once
 
+#include <AK/Error.h>
+#include <AK/Function.h>
+
 namespace Kernel {
+
+class NetworkAdapter;
+class Thread;
+
 class NetworkTask {
 public:
     static void spawn();
     static bool is_current();
+
+    static ErrorOr<void> try_for_each_worker(Function<ErrorOr<void>(NetworkAdapter const&, size_t queue_index, Thread const&)>);
 };
 }
@@ -278,6 +278,41 @@ ErrorOr<size_t> Socket::write(OpenFileDescription& description, u64, UserOrKerne
     return sendto(description, data, size, 0, {}, 0);
 }
 
+ErrorOr<size_t> Socket::sendto_batch(OpenFileDescription& description, Span<BatchedSend> sends, int flags)
+{
+    for (size_t i = 0; i < sends.size(); ++i) {
+        auto& send = sends[i];
+        auto nsent_or_error = sendto(description, send.data, send.data_length, flags, send.address, send.address_length);
+        if (nsent_or_error.is_error()) {
+            if (i == 0)
+                return nsent_or_error.release_error();
+            return i;
+        }
+        send.nsent = nsent_or_error.value();
+        if (send.nsent < send.data_length)
+            return i + 1;
+    }
+    return sends.size();
+}
+
+ErrorOr<size_t> Socket::recvfrom_batch(OpenFileDescription& description, Span<BatchedReceive> receives, int flags, bool blocking)
+{
+    for (size_t i = 0; i < receives.size(); ++i) {
+        auto& receive = receives[i];
+        auto nreceived_or_error = recvfrom(description, receive.buffer, receive.buffer_length, flags, receive.address, receive.address_length, receive.timestamp, blocking && i == 0);
+        if (nreceived_or_error.is_error()) {
+            if (i == 0)
+                return nreceived_or_error.release_error();
+            return i;
+        }
+        receive.nreceived = nreceived_or_error.value();
+        // There's nothing more to come after the end of a stream.
+        if (receive.nreceived == 0 && type() == SOCK_STREAM)
+            return i + 1;
+    }
+    return receives.size();
+}
+
 ErrorOr<void> Socket::shutdown(int how)
 {
     MutexLocker locker(mutex());
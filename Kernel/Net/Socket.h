@@ -81,6 +81,31 @@ public:
     virtual ErrorOr<size_t> sendto(OpenFileDescription&, UserOrKernelBuffer const&, size_t, int flags, Userspace<sockaddr const*>, socklen_t) = 0;
     virtual ErrorOr<size_t> recvfrom(OpenFileDescription&, UserOrKernelBuffer&, size_t, int flags, Userspace<sockaddr*>, Userspace<socklen_t*>, UnixDateTime&, bool blocking) = 0;
 
+    // One message of a sendmmsg() call.
+    struct BatchedSend {
+        UserOrKernelBuffer data;
+        size_t data_length { 0 };
+        Userspace<sockaddr const*> address;
+        socklen_t address_length { 0 };
+        size_t nsent { 0 };
+    };
+
+    // One message of a recvmmsg() call.
+    struct BatchedReceive {
+        UserOrKernelBuffer buffer;
+        size_t buffer_length { 0 };
+        Userspace<sockaddr*> address;
+        Userspace<socklen_t*> address_length;
+        size_t nreceived { 0 };
+        UnixDateTime timestamp {};
+    };
+
+    // These move as many of the messages as they can without blocking (except for the first one), and return how many
+    // that was. By default, they go through sendto() and recvfrom() for each message, but sockets that queue datagrams
+    // can hold on to their lock for the whole batch instead.
+    virtual ErrorOr<size_t> sendto_batch(OpenFileDescription&, Span<BatchedSend>, int flags);
+    virtual ErrorOr<size_t> recvfrom_batch(OpenFileDescription&, Span<BatchedReceive>, int flags, bool blocking);
+
     virtual ErrorOr<void> setsockopt(int level, int option, Userspace<void const*>, socklen_t);
     virtual ErrorOr<void> getsockopt(OpenFileDescription&, int level, int option, Userspace<void*>, Userspace<socklen_t*>);
 
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/Noncopyable.h>
+#include <AK/Optional.h>
+#include <AK/RefPtr.h>
+#include <AK/Traits.h>
+#include <Kernel/Locking/Mutex.h>
+#include <Kernel/Tasks/Scheduler.h>
+
+namespace Kernel {
+
+template<typename Key, typename T, auto member, size_t bucket_count>
+class SocketTable;
+
+template<typename Key, typename T>
+class SocketTableNode {
+    template<typename, typename, auto, size_t>
+    friend class SocketTable;
+
+public:
+    bool is_in_table() const { return m_socket != nullptr; }
+
+private:
+    Optional<Key> m_key;
+    T* m_socket { nullptr };
+    Atomic<SocketTableNode*> m_next { nullptr };
+};
+
+// Sockets are looked up for every incoming packet, but they're only added and removed when connections are set up
+// and torn down. So lookups don't take any locks at all: The buckets are linked lists that writers change with single
+// atomic stores, and a socket that is removed is only let go once all lookups that might still see it have finished.
+// This is the same idea as RCU, except that readers announce themselves in one of two counters, which lets writers
+// wait for a grace period without any help from the scheduler.
+template<typename Key, typename T, auto member, size_t bucket_count = 1024>
+class SocketTable {
+    AK_MAKE_NONCOPYABLE(SocketTable);
+    AK_MAKE_NONMOVABLE(SocketTable);
+
+public:
+    using Node = SocketTableNode<Key, T>;
+
+    SocketTable() = default;
+
+    // Returns the socket with the given key, unless there's no such socket or it's about to be destroyed.
+    RefPtr<T> get(Key const& key) const
+    {
+        ReadSideGuard guard { *this };
+        for (auto* node = bucket_for(key).load(AK::MemoryOrder::memory_order_acquire); node; node = node->m_next.load(AK::MemoryOrder::memory_order_acquire)) {
+            if (*node->m_key != key)
+                continue;
+            // The socket stays in the table until it's destroyed, which may have started already.
+            if (!node->m_socket->try_ref())
+                return {};
+            return adopt_ref(*node->m_socket);
+        }
+        return {};
+    }
+
+    // Everything that changes the table, or has to see a consistent view of it, goes through here.
+    template<typename Callback>
+    decltype(auto) with_exclusive(Callback callback)
+    {
+        MutexLocker locker(m_write_lock);
+        return callback(*this);
+    }
+
+    template<typename Callback>
+    void for_each(Callback callback)
+    {
+        with_exclusive([&](auto& table) {
+            for (auto const& bucket : table.m_buckets) {
+                for (auto* node = bucket.load(AK::MemoryOrder::memory_order_relaxed); node; node = node->m_next.load(AK::MemoryOrder::memory_order_relaxed))
+                    callback(*node->m_socket);
+            }
+        });
+    }
+
+    template<typename Callback>
+    ErrorOr<void> try_for_each(Callback callback)
+    {
+        return with_exclusive([&](auto& table) -> ErrorOr<void> {
+            for (auto const& bucket : table.m_buckets) {
+                for (auto* node = bucket.load(AK::MemoryOrder::memory_order_relaxed); node; node = node->m_next.load(AK::MemoryOrder::memory_order_relaxed))
+                    TRY(callback(*node->m_socket));
+            }
+            return {};
+        });
+    }
+
+    // The following may only be called from within with_exclusive().
+
+    bool contains(Key const& key) const
+    {
+        VERIFY(m_write_lock.is_exclusively_locked_by_current_thread());
+        for (auto* node = bucket_for(key).load(AK::MemoryOrder::memory_order_relaxed); node; node = node->m_next.load(AK::MemoryOrder::memory_order_relaxed)) {
+            if (*node->m_key == key)
+                return true;
+        }
+        return false;
+    }
+
+    void add(Key const& key, T& socket)
+    {
+        VERIFY(m_write_lock.is_exclusively_locked_by_current_thread());
+        auto& node = socket.*member;
+        VERIFY(!node.is_in_table());
+        VERIFY(!contains(key));
+
+        node.m_key = key;
+        node.m_socket = &socket;
+        auto& bucket = bucket_for(key);
+        node.m_next.store(bucket.load(AK::MemoryOrder::memory_order_relaxed), AK::MemoryOrder::memory_order_relaxed);
+        // Readers that see the node also see everything that was written to it before.
+        bucket.store(&node, AK::MemoryOrder::memory_order_release);
+    }
+
+    // Returns false if the socket wasn't in the table. Otherwise, it's guaranteed that no lookup will find the socket anymore.
+    bool remove(T& socket)
+    {
+        VERIFY(m_write_lock.is_exclusively_locked_by_current_thread());
+        auto& node = socket.*member;
+        if (!node.is_in_table())
+            return false;
+
+        auto* link = &bucket_for(*node.m_key);
+        while (link->load(AK::MemoryOrder::memory_order_relaxed) != &node)
+            link = &link->load(AK::MemoryOrder::memory_order_relaxed)->m_next;
+        // NOTE: We leave the node's own link alone, so that readers that are looking at it right now can move on.
+        link->store(node.m_next.load(AK::MemoryOrder::memory_order_relaxed), AK::MemoryOrder::memory_order_release);
+
+        wait_for_readers();
+        node.m_key.clear();
+        node.m_socket = nullptr;
+        node.m_next.store(nullptr, AK::MemoryOrder::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    class ReadSideGuard {
+    public:
+        explicit ReadSideGuard(SocketTable const& table)
+            : m_table(table)
+        {
+            // If a writer switched the counters in between, it might not be waiting for the one we picked.
+            while (true) {
+                m_epoch = m_table.m_epoch.load();
+                m_table.m_reader_counts[m_epoch].fetch_add(1);
+                if (m_table.m_epoch.load() == m_epoch)
+                    break;
+                m_table.m_reader_counts[m_epoch].fetch_sub(1);
+            }
+        }
+
+        ~ReadSideGuard()
+        {
+            m_table.m_reader_counts[m_epoch].fetch_sub(1);
+        }
+
+    private:
+        SocketTable const& m_table;
+        u32 m_epoch { 0 };
+    };
+
+    Atomic<Node*>& bucket_for(Key const& key) const
+    {
+        return m_buckets[Traits<Key>::hash(key) % bucket_count];
+    }
+
+    void wait_for_readers()
+    {
+        // Lookups that start from now on can't find anything we unlinked, so we only have to wait for the ones
+        // that announced themselves in the old counter.
+        u32 old_epoch = m_epoch.load();
+        m_epoch.store(old_epoch ^ 1);
+        while (m_reader_counts[old_epoch].load() != 0)
+            Scheduler::yield();
+    }
+
+    mutable Atomic<Node*> m_buckets[bucket_count] {};
+    Atomic<u32> m_epoch { 0 };
+    mutable Atomic<u32> m_reader_counts[2] {};
+    mutable Mutex m_write_lock { "SocketTable"sv };
+};
+
+}
@@ -74,7 +74,49 @@ private:
     NetworkOrdered<u8> m_value;
 };
 
+class [[gnu::packed]] TCPOptionSACKPermitted : public TCPOption {
+public:
+    TCPOptionSACKPermitted()
+        : TCPOption(TCPOptionKind::SACKPermitted, sizeof(TCPOptionSACKPermitted))
+    {
+    }
+};
+
+struct [[gnu::packed]] TCPSACKBlock {
+    NetworkOrdered<u32> left_edge;
+    NetworkOrdered<u32> right_edge;
+};
+
+class [[gnu::packed]] TCPOptionSACK : public TCPOption {
+public:
+    // Without the timestamp option there is room for 4 blocks, but we leave space for it like everyone else does.
+    static constexpr size_t maximum_block_count = 3;
+
+    static constexpr size_t size_for_block_count(size_t block_count) { return sizeof(TCPOption) + block_count * sizeof(TCPSACKBlock); }
+
+    explicit TCPOptionSACK(size_t block_count)
+        : TCPOption(TCPOptionKind::SACK, size_for_block_count(block_count))
+    {
+    }
+
+    size_t block_count() const { return (length() - sizeof(TCPOption)) / sizeof(TCPSACKBlock); }
+
+    TCPSACKBlock block(size_t index) const
+    {
+        VERIFY(index < block_count());
+        TCPSACKBlock block;
+        memcpy(&block, reinterpret_cast<u8 const*>(this) + sizeof(TCPOption) + index * sizeof(TCPSACKBlock), sizeof(block));
+        return block;
+    }
+};
+
 static_assert(AssertSize<TCPOptionMSS, 4>());
+static_assert(AssertSize<TCPOptionSACKPermitted, 2>());
+static_assert(AssertSize<TCPSACKBlock, 8>());
+
+// Sequence numbers wrap around, so they can only be compared relative to each other (RFC 9293, section 3.4).
+constexpr bool sequence_number_less_than(u32 a, u32 b) { return static_cast<i32>(a - b) < 0; }
+constexpr bool sequence_number_less_than_or_equal(u32 a, u32 b) { return static_cast<i32>(a - b) <= 0; }
 
 class [[gnu::packed]] TCPPacket {
 public:
@@ -109,6 +151,7 @@ public:
     u16 window_size() const { return m_window_size; }
     void set_window_size(u16 window_size) { m_window_size = window_size; }
 
+    static constexpr size_t checksum_offset = 16;
     u16 checksum() const { return m_checksum; }
     void set_checksum(u16 checksum) { m_checksum = checksum; }
 
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <Kernel/Net/TCPCongestionControl.h>
+
+namespace Kernel {
+
+// RFC 6928, section 2
+static u32 initial_window_for(u32 maximum_segment_size)
+{
+    return min(10 * maximum_segment_size, max(2 * maximum_segment_size, 14600u));
+}
+
+TCPCongestionControl::TCPCongestionControl(u32 maximum_segment_size)
+    : m_maximum_segment_size(maximum_segment_size)
+    , m_congestion_window(initial_window_for(maximum_segment_size))
+{
+}
+
+void TCPCongestionControl::set_maximum_segment_size(u32 maximum_segment_size)
+{
+    // If nothing has been sent yet, the initial window has to be based on the segment size that we'll actually use.
+    if (m_congestion_window == initial_window_for(m_maximum_segment_size))
+        m_congestion_window = initial_window_for(maximum_segment_size);
+    m_maximum_segment_size = maximum_segment_size;
+}
+
+void TCPCongestionControl::slow_start(u32 bytes_acked)
+{
+    // RFC 5681, section 3.1: Increase the window by at most one segment per ACK, even if the ACK covers more than that.
+    m_congestion_window += min(bytes_acked, m_maximum_segment_size);
+}
+
+void TCPCongestionControl::on_retransmit_timeout(u32 bytes_in_flight, MonotonicTime now)
+{
+    // RFC 5681, section 3.1: The threshold is lowered the same way as for any other loss,
+    // but after a timeout we don't know what's left in the network, so we start over with the loss window.
+    on_congestion_event(bytes_in_flight, now);
+    m_congestion_window = m_maximum_segment_size;
+}
+
+// RFC 5681 and RFC 6582
+class NewRenoCongestionControl final : public TCPCongestionControl {
+public:
+    explicit NewRenoCongestionControl(u32 maximum_segment_size)
+        : TCPCongestionControl(maximum_segment_size)
+    {
+    }
+
+    virtual Algorithm algorithm() const override { return Algorithm::NewReno; }
+    virtual StringView name() const override { return "newreno"sv; }
+
+    virtual void on_ack(u32 bytes_acked, MonotonicTime, Duration) override
+    {
+        if (is_in_slow_start()) {
+            slow_start(bytes_acked);
+            return;
+        }
+
+        // Congestion avoidance: Grow by roughly one segment per round trip.
+        u64 increase = static_cast<u64>(m_maximum_segment_size) * bytes_acked / m_congestion_window;
+        m_congestion_window += max(static_cast<u32>(increase), 1u);
+    }
+
+    virtual void on_congestion_event(u32 bytes_in_flight, MonotonicTime) override
+    {
+        m_slow_start_threshold = max(bytes_in_flight / 2, 2 * m_maximum_segment_size);
+        m_congestion_window = m_slow_start_threshold;
+    }
+};
+
+// RFC 9438
+class CUBICCongestionControl final : public TCPCongestionControl {
+public:
+    explicit CUBICCongestionControl(u32 maximum_segment_size)
+        : TCPCongestionControl(maximum_segment_size)
+    {
+    }
+
+    virtual Algorithm algorithm() const override { return Algorithm::CUBIC; }
+    virtual StringView name() const override { return "cubic"sv; }
+
+    virtual void on_ack(u32 bytes_acked, MonotonicTime now, Duration smoothed_round_trip_time) override
+    {
+        if (is_in_slow_start()) {
+            slow_start(bytes_acked);
+            return;
+        }
+
+        if (!m_epoch_start.has_value()) {
+            m_epoch_start = now;
+            m_reno_window_estimate = m_congestion_window;
+            if (m_congestion_window < m_maximum_window) {
+                // K = cbrt((W_max - cwnd) / C), in milliseconds.
+                u64 window_difference = m_maximum_window - m_congestion_window;
+                m_time_to_maximum_window_ms = cube_root(window_difference * 2'500'000'000ull / m_maximum_segment_size);
+            } else {
+                m_maximum_window = m_congestion_window;
+                m_time_to_maximum_window_ms = 0;
+            }
+        }
+
+        // We aim for where the cubic function will be one round trip from now.
+        i64 t = (now - *m_epoch_start).to_milliseconds() + smoothed_round_trip_time.to_milliseconds();
+        i64 target = cubic_window_at(t);
+        target = clamp(target, static_cast<i64>(m_congestion_window), static_cast<i64>(m_congestion_window) * 3 / 2);
+
+        // Make sure that we're never slower than standard TCP would be in the same situation (section 4.3).
+        m_reno_window_estimate += static_cast<u64>(m_maximum_segment_size) * reno_alpha_numerator * bytes_acked / (reno_alpha_denominator * m_congestion_window);
+        if (m_reno_window_estimate > static_cast<u64>(target))
+            target = static_cast<i64>(min(m_reno_window_estimate, static_cast<u64>(NumericLimits<u32>::max())));
+
+        u64 increase = static_cast<u64>(target - m_congestion_window) * bytes_acked / m_congestion_window;
+        m_congestion_window = static_cast<u32>(min(static_cast<u64>(m_congestion_window) + increase, static_cast<u64>(NumericLimits<u32>::max())));
+    }
+
+    virtual void on_congestion_event(u32, MonotonicTime) override
+    {
+        m_epoch_start.clear();
+
+        // Fast convergence (section 4.7): If we didn't even get back to the previous maximum, release some bandwidth for other flows.
+        if (m_congestion_window < m_maximum_window)
+            m_maximum_window = static_cast<u64>(m_congestion_window) * (beta_denominator + beta_numerator) / (2 * beta_denominator);
+        else
+            m_maximum_window = m_congestion_window;
+
+        m_slow_start_threshold = max(static_cast<u32>(static_cast<u64>(m_congestion_window) * beta_numerator / beta_denominator), 2 * m_maximum_segment_size);
+        m_congestion_window = m_slow_start_threshold;
+    }
+
+private:
+    // C = 0.4, beta = 0.7, and alpha = 3 * (1 - beta) / (1 + beta) for the Reno-friendly region.
+    static constexpr u64 beta_numerator = 7;
+    static constexpr u64 beta_denominator = 10;
+    static constexpr u64 reno_alpha_numerator = 9;
+    static constexpr u64 reno_alpha_denominator = 17;
+
+    static u64 cube_root(u64 value)
+    {
+        u64 low = 0;
+        u64 high = 2'642'245; // cbrt(2^64)
+        while (low < high) {
+            u64 middle = (low + high + 1) / 2;
+            if (middle * middle * middle <= value)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+        return low;
+    }
+
+    // W_cubic(t) = C * (t - K)^3 + W_max, in bytes with t in milliseconds.
+    i64 cubic_window_at(i64 t) const
+    {
+        // Keep the cube from overflowing, the result gets clamped to 1.5 * cwnd anyway.
+        i64 offset = clamp(t - static_cast<i64>(m_time_to_maximum_window_ms), -100'000ll, 100'000ll);
+        i64 delta = 4 * offset * offset * offset / 1'000'000 * m_maximum_segment_size / 10'000;
+        return max(static_cast<i64>(m_maximum_window) + delta, static_cast<i64>(m_maximum_segment_size));
+    }
+
+    Optional<MonotonicTime> m_epoch_start;
+    u64 m_maximum_window { 0 };
+    u64 m_time_to_maximum_window_ms { 0 };
+    u64 m_reno_window_estimate { 0 };
+};
+
+ErrorOr<NonnullOwnPtr<TCPCongestionControl>> TCPCongestionControl::try_create(Algorithm algorithm, u32 maximum_segment_size)
+{
+    switch (algorithm) {
+    case Algorithm::NewReno:
+        return TRY(adopt_nonnull_own_or_enomem(new (nothrow) NewRenoCongestionControl(maximum_segment_size)));
+    case Algorithm::CUBIC:
+        return TRY(adopt_nonnull_own_or_enomem(new (nothrow) CUBICCongestionControl(maximum_segment_size)));
+    }
+    VERIFY_NOT_REACHED();
+}
+
+Optional<TCPCongestionControl::Algorithm> TCPCongestionControl::algorithm_from_name(StringView name)
+{
+    if (name == "newreno"sv || name == "reno"sv)
+        return Algorithm::NewReno;
+    if (name == "cubic"sv)
+        return Algorithm::CUBIC;
+    return {};
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Error.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Optional.h>
+#include <AK/StringView.h>
+#include <AK/Time.h>
+#include <AK/Types.h>
+
+namespace Kernel {
+
+// The sender side congestion window management of a TCP connection, see RFC 5681.
+// Loss detection and recovery is handled by TCPSocket, which reports the outcome to this.
+class TCPCongestionControl {
+public:
+    enum class Algorithm {
+        NewReno,
+        CUBIC,
+    };
+
+    static constexpr Algorithm default_algorithm = Algorithm::CUBIC;
+
+    static ErrorOr<NonnullOwnPtr<TCPCongestionControl>> try_create(Algorithm, u32 maximum_segment_size);
+    static Optional<Algorithm> algorithm_from_name(StringView);
+
+    virtual ~TCPCongestionControl() = default;
+
+    virtual Algorithm algorithm() const = 0;
+    virtual StringView name() const = 0;
+
+    u32 congestion_window() const { return m_congestion_window; }
+    u32 slow_start_threshold() const { return m_slow_start_threshold; }
+    bool is_in_slow_start() const { return m_congestion_window < m_slow_start_threshold; }
+
+    void set_maximum_segment_size(u32);
+
+    // Called for every ACK that acknowledges new data while we're not recovering from a loss.
+    virtual void on_ack(u32 bytes_acked, MonotonicTime now, Duration smoothed_round_trip_time) = 0;
+
+    // Called once when a loss was detected through duplicate ACKs or SACK information and fast recovery starts.
+    virtual void on_congestion_event(u32 bytes_in_flight, MonotonicTime now) = 0;
+
+    // Called when the retransmission timer expires, after which we start over with a single segment.
+    void on_retransmit_timeout(u32 bytes_in_flight, MonotonicTime now);
+
+protected:
+    explicit TCPCongestionControl(u32 maximum_segment_size);
+
+    void slow_start(u32 bytes_acked);
+
+    u32 m_maximum_segment_size { 0 };
+    u32 m_congestion_window { 0 };
+    u32 m_slow_start_threshold { NumericLimits<u32>::max() };
+};
+
+}
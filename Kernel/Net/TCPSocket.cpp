@@ -16,7 +16,9 @@
 #include <Kernel/Net/NetworkAdapter.h>
 #include <Kernel/Net/NetworkingManagement.h>
 #include <Kernel/Net/Routing.h>
+#include <Kernel/API/POSIX/netinet/tcp.h>
 #include <Kernel/Net/TCP.h>
+#include <Kernel/Net/TCPCongestionControl.h>
 #include <Kernel/Net/TCPSocket.h>
 #include <Kernel/Security/Random.h>
 #include <Kernel/Tasks/Process.h>
@@ -26,34 +28,31 @@ namespace Kernel {
 
 void TCPSocket::for_each(Function<void(TCPSocket const&)> callback)
 {
-    sockets_by_tuple().for_each_shared([&](auto const& it) {
-        callback(*it.value);
+    sockets_by_tuple().for_each([&](auto const& socket) {
+        callback(socket);
     });
 }
 
 ErrorOr<void> TCPSocket::try_for_each(Function<ErrorOr<void>(TCPSocket const&)> callback)
 {
-    return sockets_by_tuple().with_shared([&](auto const& sockets) -> ErrorOr<void> {
-        for (auto& it : sockets)
-            TRY(callback(*it.value));
-        return {};
+    return sockets_by_tuple().try_for_each([&](auto const& socket) -> ErrorOr<void> {
+        return callback(socket);
     });
 }
 
 bool TCPSocket::unref() const
 {
-    bool did_hit_zero = sockets_by_tuple().with_exclusive([&](auto& table) {
-        if (deref_base())
-            return false;
-        table.remove(tuple());
-        const_cast<TCPSocket&>(*this).revoke_weak_ptrs();
-        return true;
+    if (deref_base())
+        return false;
+    // Lookups that are still looking at us won't be able to take a reference anymore, and once we're out
+    // of the table, there can't be any of them left.
+    sockets_by_tuple().with_exclusive([&](auto& table) {
+        table.remove(const_cast<TCPSocket&>(*this));
     });
-    if (did_hit_zero) {
-        const_cast<TCPSocket&>(*this).will_be_destroyed();
-        delete this;
-    }
-    return did_hit_zero;
+    const_cast<TCPSocket&>(*this).revoke_weak_ptrs();
+    const_cast<TCPSocket&>(*this).will_be_destroyed();
+    delete this;
+    return true;
 }
 
 void TCPSocket::set_state(State new_state)
@@ -116,33 +115,27 @@ MutexProtected<HashMap<IPv4SocketTuple, RefPtr<TCPSocket>>>& TCPSocket::closing_
     return *s_socket_closing;
 }
 
-static Singleton<MutexProtected<HashMap<IPv4SocketTuple, TCPSocket*>>> s_socket_tuples;
+static Singleton<TCPSocket::TupleTable> s_socket_tuples;
 
-MutexProtected<HashMap<IPv4SocketTuple, TCPSocket*>>& TCPSocket::sockets_by_tuple()
+TCPSocket::TupleTable& TCPSocket::sockets_by_tuple()
 {
     return *s_socket_tuples;
 }
 
 RefPtr<TCPSocket> TCPSocket::from_tuple(IPv4SocketTuple const& tuple)
 {
-    return sockets_by_tuple().with_shared([&](auto const& table) -> RefPtr<TCPSocket> {
-        auto exact_match = table.get(tuple);
-        if (exact_match.has_value())
-            return { *exact_match.value() };
+    auto& table = sockets_by_tuple();
+    if (auto exact_match = table.get(tuple))
+        return exact_match;
 
-        auto address_tuple = IPv4SocketTuple(tuple.local_address(), tuple.local_port(), IPv4Address(), 0);
-        auto address_match = table.get(address_tuple);
-        if (address_match.has_value())
-            return { *address_match.value() };
+    auto address_tuple = IPv4SocketTuple(tuple.local_address(), tuple.local_port(), IPv4Address(), 0);
+    if (auto address_match = table.get(address_tuple))
+        return address_match;
 
-        auto wildcard_tuple = IPv4SocketTuple(IPv4Address(), tuple.local_port(), IPv4Address(), 0);
-        auto wildcard_match = table.get(wildcard_tuple);
-        if (wildcard_match.has_value())
-            return { *wildcard_match.value() };
-
-        return {};
-    });
+    auto wildcard_tuple = IPv4SocketTuple(IPv4Address(), tuple.local_port(), IPv4Address(), 0);
+    return table.get(wildcard_tuple);
 }
+
 ErrorOr<NonnullRefPtr<TCPSocket>> TCPSocket::try_create_client(IPv4Address const& new_local_address, u16 new_local_port, IPv4Address const& new_peer_address, u16 new_peer_port)
 {
     auto tuple = IPv4SocketTuple(new_local_address, new_local_port, new_peer_address, new_peer_port);
@@ -151,7 +144,7 @@ ErrorOr<NonnullRefPtr<TCPSocket>> TCPSocket::try_create_client(IPv4Address const
             return EEXIST;
 
         auto receive_buffer = TRY(try_create_receive_buffer());
-        auto client = TRY(TCPSocket::try_create(protocol(), move(receive_buffer)));
+        auto client = TRY(TCPSocket::try_create(protocol(), move(receive_buffer), m_congestion_control->algorithm()));
 
         client->set_setup_state(SetupState::InProgress);
         client->set_local_address(new_local_address);
@@ -164,7 +157,7 @@ ErrorOr<NonnullRefPtr<TCPSocket>> TCPSocket::try_create_client(IPv4Address const
 
         m_pending_release_for_accept.set(tuple, client);
         client->m_registered_socket_tuple = tuple;
-        table.set(tuple, client);
+        table.add(tuple, *client);
 
         return { move(client) };
     });
@@ -185,10 +178,11 @@ void TCPSocket::release_for_accept(NonnullRefPtr<TCPSocket> socket)
     [[maybe_unused]] auto rc = queue_connection_from(move(socket));
 }
 
-TCPSocket::TCPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer, NonnullOwnPtr<KBuffer> scratch_buffer, NonnullRefPtr<Timer> timer)
+TCPSocket::TCPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer, NonnullOwnPtr<KBuffer> scratch_buffer, NonnullRefPtr<Timer> timer, NonnullOwnPtr<TCPCongestionControl> congestion_control)
     : IPv4Socket(SOCK_STREAM, protocol, move(receive_buffer), move(scratch_buffer))
     , m_last_ack_sent_time(TimeManagement::the().monotonic_time())
-    , m_last_retransmit_time(TimeManagement::the().monotonic_time())
+    , m_congestion_control(move(congestion_control))
+    , m_retransmit_timer_start(TimeManagement::the().monotonic_time())
     , m_timer(timer)
 {
 }
@@ -200,12 +194,24 @@ TCPSocket::~TCPSocket()
     dbgln_if(TCP_SOCKET_DEBUG, "~TCPSocket in state {}", to_string(state()));
 }
 
-ErrorOr<NonnullRefPtr<TCPSocket>> TCPSocket::try_create(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer)
+ErrorOr<NonnullRefPtr<TCPSocket>> TCPSocket::try_create(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer, TCPCongestionControl::Algorithm congestion_control_algorithm)
 {
     // Note: Scratch buffer is only used for SOCK_STREAM sockets.
     auto scratch_buffer = TRY(KBuffer::try_create_with_size("TCPSocket: Scratch buffer"sv, 65536));
     auto timer = TRY(adopt_nonnull_ref_or_enomem(new (nothrow) Timer));
-    return adopt_nonnull_ref_or_enomem(new (nothrow) TCPSocket(protocol, move(receive_buffer), move(scratch_buffer), timer));
+    auto congestion_control = TRY(TCPCongestionControl::try_create(congestion_control_algorithm, default_maximum_segment_size));
+    return adopt_nonnull_ref_or_enomem(new (nothrow) TCPSocket(protocol, move(receive_buffer), move(scratch_buffer), timer, move(congestion_control)));
+}
+
+void TCPSocket::set_peer_maximum_segment_size(u16 peer_maximum_segment_size)
+{
+    u32 maximum_segment_size = peer_maximum_segment_size;
+    auto adapter = bound_interface().with([](auto& bound_device) -> RefPtr<NetworkAdapter> { return bound_device; });
+    auto routing_decision = route_to(peer_address(), local_address(), adapter);
+    if (!routing_decision.is_zero())
+        maximum_segment_size = min(maximum_segment_size, static_cast<u32>(routing_decision.adapter->mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket)));
+    m_maximum_segment_size = maximum_segment_size;
+    m_congestion_control->set_maximum_segment_size(maximum_segment_size);
 }
 
 ErrorOr<size_t> TCPSocket::protocol_size(ReadonlyBytes raw_ipv4_packet)
@@ -232,9 +238,16 @@ ErrorOr<size_t> TCPSocket::protocol_send(UserOrKernelBuffer const& data, size_t
     RoutingDecision routing_decision = route_to(peer_address(), local_address(), adapter);
     if (routing_decision.is_zero())
         return set_so_error(EHOSTUNREACH);
-    size_t mss = routing_decision.adapter->mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket);
-
-    data_length = min(data_length, mss);
+    size_t mss = maximum_segment_size_for(*routing_decision.adapter);
+
+    // Larger writes go out as a single large segment, which is only cut into MSS-sized ones on its way to the wire.
+    size_t const max_send_size = (NetworkAdapter::max_segmentation_size - sizeof(IPv4Packet) - sizeof(TCPPacket)) / mss * mss;
+    data_length = min(data_length, max(mss, max_send_size));
+    // NOTE: can_write() makes sure there's room in the send window, but we may still have raced with another writer.
+    //       In that case we overshoot by a segment, rather than reporting that nothing could be written.
+    auto usable_window = m_unacked_packets.with_shared([&](auto& unacked_packets) { return usable_send_window(unacked_packets); });
+    if (usable_window > 0)
+        data_length = min(data_length, usable_window);
     TRY(send_tcp_packet(TCPFlags::PSH | TCPFlags::ACK, &data, data_length, &routing_decision));
     return data_length;
 }
@@ -257,12 +270,37 @@ ErrorOr<void> TCPSocket::send_tcp_packet(u16 flags, UserOrKernelBuffer const* pa
 
     bool const has_mss_option = flags & TCPFlags::SYN;
     bool const has_window_scale_option = flags & TCPFlags::SYN;
-    size_t const options_size = (has_mss_option ? sizeof(TCPOptionMSS) : 0) + (has_window_scale_option ? sizeof(TCPOptionWindowScale) : 0);
+    bool const has_sack_permitted_option = flags & TCPFlags::SYN;
+
+    // NOTE: SACK blocks are only sent along with pure ACKs, so that data segments always fit into the MSS.
+    Vector<SequenceRange, TCPOptionSACK::maximum_block_count> sack_ranges;
+    if (m_sack_permitted && (flags & TCPFlags::ACK) && !(flags & TCPFlags::SYN) && payload_size == 0)
+        sack_ranges = this->sack_ranges();
+    // The SACK option is preceded by two NOPs to keep the blocks 32-bit aligned.
+    size_t const sack_option_size = sack_ranges.is_empty() ? 0 : 2 + TCPOptionSACK::size_for_block_count(sack_ranges.size());
+
+    size_t const options_size = (has_mss_option ? sizeof(TCPOptionMSS) : 0) + (has_window_scale_option ? sizeof(TCPOptionWindowScale) : 0)
+        + (has_sack_permitted_option ? sizeof(TCPOptionSACKPermitted) : 0) + sack_option_size;
     size_t const tcp_header_size = sizeof(TCPPacket) + align_up_to(options_size, 4);
     size_t const buffer_size = ipv4_payload_offset + tcp_header_size + payload_size;
     auto packet = routing_decision.adapter->acquire_packet_buffer(buffer_size);
     if (!packet)
         return set_so_error(ENOMEM);
+
+    // Checksums are left to the adapter whenever it can do them, and so is cutting up segments that are larger than
+    // the MSS. If the adapter can't, they're done in software right before the packet is handed to it.
+    size_t const mss = maximum_segment_size_for(*routing_decision.adapter);
+    if (payload_size > mss) {
+        VERIFY(options_size == 0);
+        packet->offload.segment_size = mss;
+        packet->offload.header_size = ipv4_payload_offset + tcp_header_size;
+    }
+    if (packet->offload.segment_size != 0 || routing_decision.adapter->supports(NetworkOffload::TCPChecksum)) {
+        packet->offload.needs_checksum = true;
+        packet->offload.checksum_start = ipv4_payload_offset;
+        packet->offload.checksum_offset = TCPPacket::checksum_offset;
+    }
+
     routing_decision.adapter->fill_in_ipv4_header(*packet, local_address(),
         routing_decision.next_hop, peer_address(), TransportProtocol::TCP,
         buffer_size - ipv4_payload_offset, type_of_service(), ttl());
@@ -292,8 +330,10 @@ ErrorOr<void> TCPSocket::send_tcp_packet(u16 flags, UserOrKernelBuffer const* pa
         tcp_packet.set_ack_number(m_ack_number);
     }
 
+    auto const sequence_number = m_sequence_number;
     if (flags & TCPFlags::SYN) {
         ++m_sequence_number;
+        m_recovery_point = m_sequence_number;
     } else {
         m_sequence_number += payload_size;
     }
@@ -310,16 +350,49 @@ ErrorOr<void> TCPSocket::send_tcp_packet(u16 flags, UserOrKernelBuffer const* pa
         memcpy(next_option, &window_scale_option, sizeof(window_scale_option));
         next_option += sizeof(window_scale_option);
     }
+    if (has_sack_permitted_option) {
+        TCPOptionSACKPermitted sack_permitted_option;
+        memcpy(next_option, &sack_permitted_option, sizeof(sack_permitted_option));
+        next_option += sizeof(sack_permitted_option);
+    }
+    if (!sack_ranges.is_empty()) {
+        *next_option++ = to_underlying(TCPOptionKind::Nop);
+        *next_option++ = to_underlying(TCPOptionKind::Nop);
+        TCPOptionSACK sack_option { sack_ranges.size() };
+        memcpy(next_option, &sack_option, sizeof(sack_option));
+        next_option += sizeof(sack_option);
+        for (auto const& range : sack_ranges) {
+            TCPSACKBlock block { range.start, range.end };
+            memcpy(next_option, &block, sizeof(block));
+            next_option += sizeof(block);
+        }
+    }
     if ((options_size % 4) != 0)
         *next_option = to_underlying(TCPOptionKind::End);
 
-    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
+    if (packet->offload.needs_checksum)
+        tcp_packet.set_checksum(ipv4_pseudo_header_checksum(local_address(), peer_address(), TransportProtocol::TCP, tcp_header_size + payload_size));
+    else
+        tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
 
     bool expect_ack { tcp_packet.has_syn() || payload_size > 0 };
     if (expect_ack) {
         bool append_failed { false };
         m_unacked_packets.with_exclusive([&](auto& unacked_packets) {
-            auto result = unacked_packets.packets.try_append({ m_sequence_number, packet, ipv4_payload_offset, *routing_decision.adapter });
+            auto now = TimeManagement::the().monotonic_time();
+            // RFC 6298, section 5.1: Start the retransmission timer if it isn't already running.
+            if (unacked_packets.packets.is_empty())
+                m_retransmit_timer_start = now;
+            OutgoingPacket outgoing_packet {
+                .sequence_number = sequence_number,
+                .ack_number = m_sequence_number,
+                .buffer = packet,
+                .ipv4_payload_offset = ipv4_payload_offset,
+                .payload_size = payload_size,
+                .adapter = *routing_decision.adapter,
+                .last_transmit_time = now,
+            };
+            auto result = unacked_packets.packets.try_append(move(outgoing_packet));
             if (result.is_error()) {
                 dbgln("TCPSocket: Dropped outbound packet because try_append() failed");
                 append_failed = true;
@@ -334,7 +407,7 @@ ErrorOr<void> TCPSocket::send_tcp_packet(u16 flags, UserOrKernelBuffer const* pa
 
     m_packets_out++;
     m_bytes_out += buffer_size;
-    routing_decision.adapter->send_packet(packet->bytes());
+    routing_decision.adapter->send_packet(packet->bytes(), packet->offload);
     if (!expect_ack)
         routing_decision.adapter->release_packet_buffer(*packet);
 
@@ -345,34 +418,76 @@ void TCPSocket::receive_tcp_packet(TCPPacket const& packet, u16 size)
 {
     if (packet.has_ack()) {
         u32 ack_number = packet.ack_number();
+        size_t payload_size = size - packet.header_size();
+        auto now = TimeManagement::the().monotonic_time();
 
         dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", ack_number);
 
+        // The window field of a SYN segment is never scaled (RFC 7323, section 2.2).
+        if (packet.has_syn())
+            m_send_window_size = packet.window_size();
+        else
+            m_send_window_size = packet.window_size() << m_send_window_scale;
+
         int removed = 0;
         m_unacked_packets.with_exclusive([&](auto& unacked_packets) {
+            u32 bytes_acked = 0;
+            Optional<Duration> round_trip_time_sample;
             while (!unacked_packets.packets.is_empty()) {
-                auto& packet = unacked_packets.packets.first();
+                auto& unacked_packet = unacked_packets.packets.first();
+
+                dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", unacked_packet.ack_number);
+
+                if (!sequence_number_less_than_or_equal(unacked_packet.ack_number, ack_number))
+                    break;
 
-                dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
+                auto old_adapter = unacked_packet.adapter.strong_ref();
+                if (old_adapter)
+                    old_adapter->release_packet_buffer(*unacked_packet.buffer);
+                // Karn's algorithm: The round trip time of a retransmitted segment is ambiguous, so we don't sample it.
+                if (unacked_packet.tx_counter == 0)
+                    round_trip_time_sample = now - unacked_packet.last_transmit_time;
+                bytes_acked += unacked_packet.ack_number - unacked_packet.sequence_number;
+                unacked_packets.size -= unacked_packet.payload_size;
+                unacked_packets.packets.take_first();
+                removed++;
+            }
+
+            if (m_sack_permitted)
+                process_sack_blocks(packet, unacked_packets);
 
-                if (packet.ack_number <= ack_number) {
-                    auto old_adapter = packet.adapter.strong_ref();
-                    if (old_adapter)
-                        old_adapter->release_packet_buffer(*packet.buffer);
-                    TCPPacket& tcp_packet = *(TCPPacket*)(packet.buffer->buffer->data() + packet.ipv4_payload_offset);
-                    if (m_send_window_size != tcp_packet.window_size()) {
-                        m_send_window_size = tcp_packet.window_size() << m_send_window_scale;
+            if (bytes_acked > 0) {
+                m_duplicate_acks_received = 0;
+                m_retransmit_attempts = 0;
+                // RFC 6298, section 5.3: Restart the retransmission timer whenever new data is acknowledged.
+                m_retransmit_timer_start = now;
+                if (round_trip_time_sample.has_value())
+                    update_round_trip_time(*round_trip_time_sample);
+
+                if (m_in_recovery) {
+                    if (sequence_number_less_than(ack_number, m_recovery_point)) {
+                        // RFC 6582, section 3.2: A partial ACK tells us that the segment after it was lost as well.
+                        // With SACK, the scoreboard below already knows which ones are missing.
+                        if (!m_sack_permitted)
+                            retransmit_first_unacked_packet(unacked_packets);
+                    } else {
+                        m_in_recovery = false;
                     }
-                    auto payload_size = packet.buffer->buffer->data() + packet.buffer->buffer->size() - (u8*)tcp_packet.payload();
-                    unacked_packets.size -= payload_size;
-                    evaluate_block_conditions();
-                    unacked_packets.packets.take_first();
-                    removed++;
                 } else {
-                    break;
+                    m_congestion_control->on_ack(bytes_acked, now, m_smoothed_round_trip_time.value_or(Duration::zero()));
                 }
+            } else if (payload_size == 0 && !packet.has_syn() && !packet.has_fin() && !unacked_packets.packets.is_empty()
+                && ack_number == unacked_packets.packets.first().sequence_number) {
+                ++m_duplicate_acks_received;
+                // RFC 5681, section 3.2: The third duplicate ACK is taken as an indication that a segment has been lost.
+                if (!m_in_recovery && m_duplicate_acks_received == duplicate_ack_threshold && sequence_number_less_than_or_equal(m_recovery_point, ack_number))
+                    enter_fast_recovery(unacked_packets, now);
             }
 
+            if (m_in_recovery && m_sack_permitted)
+                mark_lost_packets(unacked_packets);
+            retransmit_lost_packets(unacked_packets);
+
             if (unacked_packets.packets.is_empty()) {
                 m_retransmit_attempts = 0;
                 dequeue_for_retransmit();
@@ -380,12 +495,233 @@ void TCPSocket::receive_tcp_packet(TCPPacket const& packet, u16 size)
 
             dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
         });
+
+        // Either the send window opened up, or the congestion window changed, so writers may be able to make progress.
+        evaluate_block_conditions();
     }
 
     m_packets_in++;
     m_bytes_in += packet.header_size() + size;
 }
 
+void TCPSocket::update_round_trip_time(Duration sample)
+{
+    // RFC 6298, section 2
+    auto sample_us = sample.to_microseconds();
+    if (!m_smoothed_round_trip_time.has_value()) {
+        m_smoothed_round_trip_time = sample;
+        m_round_trip_time_variance = Duration::from_microseconds(sample_us / 2);
+    } else {
+        auto smoothed_us = m_smoothed_round_trip_time->to_microseconds();
+        auto variance_us = m_round_trip_time_variance.to_microseconds();
+        auto deviation_us = smoothed_us > sample_us ? smoothed_us - sample_us : sample_us - smoothed_us;
+        m_round_trip_time_variance = Duration::from_microseconds((3 * variance_us + deviation_us) / 4);
+        m_smoothed_round_trip_time = Duration::from_microseconds((7 * smoothed_us + sample_us) / 8);
+    }
+
+    constexpr auto clock_granularity = Duration::from_milliseconds(1);
+    auto variance_term = max(clock_granularity, Duration::from_microseconds(4 * m_round_trip_time_variance.to_microseconds()));
+    m_retransmit_timeout = clamp(*m_smoothed_round_trip_time + variance_term, minimum_retransmit_timeout, maximum_retransmit_timeout);
+}
+
+void TCPSocket::process_sack_blocks(TCPPacket const& packet, UnackedPackets& unacked_packets)
+{
+    auto const* options_end = static_cast<u8 const*>(packet.payload());
+    packet.for_each_option([&](auto const& option) {
+        if (option.kind() != TCPOptionKind::SACK)
+            return;
+        if ((option.length() - sizeof(TCPOption)) % sizeof(TCPSACKBlock) != 0)
+            return;
+        if (reinterpret_cast<u8 const*>(&option) + option.length() > options_end)
+            return;
+
+        auto const& sack_option = static_cast<TCPOptionSACK const&>(option);
+        for (size_t i = 0; i < sack_option.block_count(); ++i) {
+            auto block = sack_option.block(i);
+            u32 left_edge = block.left_edge;
+            u32 right_edge = block.right_edge;
+            for (auto& unacked_packet : unacked_packets.packets) {
+                if (unacked_packet.is_sacked)
+                    continue;
+                if (sequence_number_less_than_or_equal(left_edge, unacked_packet.sequence_number) && sequence_number_less_than_or_equal(unacked_packet.ack_number, right_edge)) {
+                    unacked_packet.is_sacked = true;
+                    unacked_packet.is_lost = false;
+                }
+            }
+        }
+    });
+}
+
+void TCPSocket::mark_lost_packets(UnackedPackets& unacked_packets)
+{
+    // RFC 6675, section 4: A segment is considered lost once enough segments after it have been SACKed.
+    size_t sacked_after = 0;
+    for (auto const& unacked_packet : unacked_packets.packets) {
+        if (unacked_packet.is_sacked)
+            ++sacked_after;
+    }
+
+    for (auto& unacked_packet : unacked_packets.packets) {
+        if (unacked_packet.is_sacked) {
+            --sacked_after;
+            continue;
+        }
+        if (sacked_after < duplicate_ack_threshold)
+            break;
+        if (!unacked_packet.is_retransmitted_in_recovery)
+            unacked_packet.is_lost = true;
+    }
+}
+
+void TCPSocket::enter_fast_recovery(UnackedPackets& unacked_packets, MonotonicTime now)
+{
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}) entering fast recovery", this);
+
+    m_congestion_control->on_congestion_event(bytes_in_flight(unacked_packets), now);
+    m_in_recovery = true;
+    m_recovery_point = m_sequence_number;
+    for (auto& unacked_packet : unacked_packets.packets)
+        unacked_packet.is_retransmitted_in_recovery = false;
+
+    ++m_fast_retransmits;
+    retransmit_first_unacked_packet(unacked_packets);
+}
+
+void TCPSocket::retransmit_first_unacked_packet(UnackedPackets& unacked_packets)
+{
+    for (auto& unacked_packet : unacked_packets.packets) {
+        if (unacked_packet.is_sacked)
+            continue;
+        retransmit_packet(unacked_packet);
+        return;
+    }
+}
+
+void TCPSocket::retransmit_lost_packets(UnackedPackets& unacked_packets)
+{
+    auto in_flight = bytes_in_flight(unacked_packets);
+    for (auto& unacked_packet : unacked_packets.packets) {
+        if (!unacked_packet.is_lost)
+            continue;
+        if (in_flight > 0 && in_flight + unacked_packet.payload_size > m_congestion_control->congestion_window())
+            break;
+        retransmit_packet(unacked_packet);
+        in_flight += unacked_packet.payload_size;
+    }
+}
+
+u32 TCPSocket::bytes_in_flight(UnackedPackets const& unacked_packets) const
+{
+    // This is the "pipe" of RFC 6675: Everything that has been sent, and hasn't been SACKed or presumed lost since.
+    u32 in_flight = 0;
+    for (auto const& unacked_packet : unacked_packets.packets) {
+        if (!unacked_packet.is_sacked && !unacked_packet.is_lost)
+            in_flight += unacked_packet.payload_size;
+    }
+
+    // Without SACK, each duplicate ACK at least tells us that another segment has left the network (RFC 5681, section 3.2).
+    if (m_in_recovery && !m_sack_permitted)
+        in_flight -= min(in_flight, m_duplicate_acks_received * m_maximum_segment_size);
+    return in_flight;
+}
+
+size_t TCPSocket::maximum_segment_size_for(NetworkAdapter const& adapter) const
+{
+    return min<size_t>(m_maximum_segment_size, adapter.mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket));
+}
+
+size_t TCPSocket::usable_send_window(UnackedPackets const& unacked_packets) const
+{
+    size_t receive_window_space = m_send_window_size > unacked_packets.size ? m_send_window_size - unacked_packets.size : 0;
+    auto in_flight = bytes_in_flight(unacked_packets);
+    auto congestion_window = m_congestion_control->congestion_window();
+    size_t congestion_window_space = congestion_window > in_flight ? congestion_window - in_flight : 0;
+    return min(receive_window_space, congestion_window_space);
+}
+
+bool TCPSocket::queue_out_of_order_segment(TCPPacket const& packet, ReadonlyBytes raw_ipv4_packet, size_t payload_size, UnixDateTime const& packet_timestamp)
+{
+    auto sequence_number = packet.sequence_number();
+
+    // Only hold on to data that lies ahead of what we've received so far, and that we'll have room for once the gap is filled.
+    if (payload_size == 0 || !sequence_number_less_than(m_ack_number, sequence_number))
+        return false;
+    if (m_out_of_order_segments.size() >= maximum_out_of_order_segments)
+        return false;
+    if (m_out_of_order_bytes + payload_size > available_space_in_receive_buffer())
+        return false;
+
+    size_t index = 0;
+    for (; index < m_out_of_order_segments.size(); ++index) {
+        auto const& segment = m_out_of_order_segments[index];
+        if (segment.sequence_number == sequence_number)
+            return false;
+        if (sequence_number_less_than(sequence_number, segment.sequence_number))
+            break;
+    }
+
+    auto buffer_or_error = KBuffer::try_create_with_bytes("TCPSocket: Out of order segment"sv, raw_ipv4_packet);
+    if (buffer_or_error.is_error())
+        return false;
+    OutOfOrderSegment segment { sequence_number, payload_size, buffer_or_error.release_value(), packet_timestamp };
+    if (m_out_of_order_segments.try_insert(index, move(segment)).is_error())
+        return false;
+
+    m_out_of_order_bytes += payload_size;
+    m_last_out_of_order_sequence_number = sequence_number;
+    return true;
+}
+
+bool TCPSocket::deliver_out_of_order_segments()
+{
+    bool delivered_any = false;
+    while (!m_out_of_order_segments.is_empty()) {
+        if (sequence_number_less_than(m_ack_number, m_out_of_order_segments.first().sequence_number))
+            break;
+
+        auto segment = m_out_of_order_segments.take_first();
+        m_out_of_order_bytes -= segment.payload_size;
+
+        // NOTE: Segments that only partially overlap with what we already have are dropped, the peer will send them again.
+        if (segment.sequence_number != m_ack_number)
+            continue;
+        if (!did_receive(peer_address(), peer_port(), segment.raw_ipv4_packet->bytes(), segment.packet_timestamp))
+            break;
+        m_ack_number = segment.sequence_number + segment.payload_size;
+        delivered_any = true;
+    }
+    return delivered_any;
+}
+
+Vector<TCPSocket::SequenceRange, TCPOptionSACK::maximum_block_count> TCPSocket::sack_ranges() const
+{
+    Vector<SequenceRange, maximum_out_of_order_segments> ranges;
+    for (auto const& segment : m_out_of_order_segments) {
+        u32 segment_end = segment.sequence_number + segment.payload_size;
+        if (!ranges.is_empty() && ranges.last().end == segment.sequence_number)
+            ranges.last().end = segment_end;
+        else
+            ranges.unchecked_append({ segment.sequence_number, segment_end });
+    }
+
+    // RFC 2018, section 4: The first block has to be the one containing the most recently received segment.
+    Vector<SequenceRange, TCPOptionSACK::maximum_block_count> result;
+    for (auto const& range : ranges) {
+        if (sequence_number_less_than_or_equal(range.start, m_last_out_of_order_sequence_number) && sequence_number_less_than(m_last_out_of_order_sequence_number, range.end)) {
+            result.unchecked_append(range);
+            break;
+        }
+    }
+    for (auto const& range : ranges) {
+        if (result.size() == TCPOptionSACK::maximum_block_count)
+            break;
+        if (!result.is_empty() && result.first().start == range.start)
+            continue;
+        result.unchecked_append(range);
+    }
+    return result;
+}
+
 bool TCPSocket::should_delay_next_ack() const
 {
     // FIXME: We don't know the MSS here so make a reasonable guess.
@@ -459,6 +795,16 @@ ErrorOr<void> TCPSocket::setsockopt(int level, int option, Userspace<void const*
     MutexLocker locker(mutex());
 
     switch (option) {
+    case TCP_CONGESTION: {
+        auto name = TRY(Process::get_syscall_name_string_fixed_buffer<congestion_control_name_max_length>(static_ptr_cast<char const*>(user_value), user_value_size));
+        auto algorithm = TCPCongestionControl::algorithm_from_name(name.representable_view());
+        if (!algorithm.has_value())
+            return ENOENT;
+        if (algorithm == m_congestion_control->algorithm())
+            return {};
+        m_congestion_control = TRY(TCPCongestionControl::try_create(*algorithm, m_maximum_segment_size));
+        return {};
+    }
     default:
         dbgln("setsockopt({}) at IPPROTO_TCP not implemented.", option);
         return ENOPROTOOPT;
@@ -476,6 +822,16 @@ ErrorOr<void> TCPSocket::getsockopt(OpenFileDescription& description, int level,
     TRY(copy_from_user(&size, value_size.unsafe_userspace_ptr()));
 
     switch (option) {
+    case TCP_CONGESTION: {
+        auto name = m_congestion_control->name();
+        if (size < name.length() + 1)
+            return EINVAL;
+        char buffer[congestion_control_name_max_length] {};
+        name.copy_characters_to_buffer(buffer, sizeof(buffer));
+        TRY(copy_to_user(static_ptr_cast<char*>(value), buffer, name.length() + 1));
+        size = name.length() + 1;
+        return copy_to_user(value_size, &size);
+    }
     default:
         dbgln("getsockopt({}) at IPPROTO_TCP not implemented.", option);
         return ENOPROTOOPT;
@@ -507,11 +863,10 @@ ErrorOr<void> TCPSocket::protocol_bind()
             while (true) {
                 IPv4SocketTuple proposed_tuple(local_address(), port, peer_address(), peer_port());
 
-                auto it = table.find(proposed_tuple);
-                if (it == table.end()) {
+                if (!table.contains(proposed_tuple)) {
                     set_local_port(port);
                     m_registered_socket_tuple = proposed_tuple;
-                    table.set(proposed_tuple, this);
+                    table.add(proposed_tuple, *this);
                     dbgln_if(TCP_SOCKET_DEBUG, "...allocated port {}, tuple {}", port, proposed_tuple.to_string());
                     return {};
                 }
@@ -530,7 +885,7 @@ ErrorOr<void> TCPSocket::protocol_bind()
                 return false;
             auto socket_tuple = tuple();
             m_registered_socket_tuple = socket_tuple;
-            table.set(socket_tuple, this);
+            table.add(socket_tuple, *this);
             return true;
         });
         if (!ok)
@@ -564,11 +919,11 @@ ErrorOr<void> TCPSocket::protocol_connect(OpenFileDescription& description)
         // socket tuple. We replace the entry in the table to ensure it is also properly removed on
         // socket deletion, to prevent a dangling reference.
         TRY(sockets_by_tuple().with_exclusive([this](auto& table) -> ErrorOr<void> {
-            auto removed = table.remove(*m_registered_socket_tuple);
+            auto removed = table.remove(*this);
             VERIFY(removed);
             if (table.contains(tuple()))
                 return set_so_error(EADDRINUSE);
-            table.set(tuple(), this);
+            table.add(tuple(), *this);
             return {};
         }));
         m_registered_socket_tuple = tuple();
@@ -674,18 +1029,12 @@ void TCPSocket::retransmit_packets()
 {
     auto now = TimeManagement::the().monotonic_time();
 
-    // RFC6298 says we should have at least one second between retransmits. According to
-    // RFC1122 we must do exponential backoff - even for SYN packets.
-    i64 retransmit_interval = 1;
-    for (decltype(m_retransmit_attempts) i = 0; i < m_retransmit_attempts; i++)
-        retransmit_interval *= 2;
-
-    if (m_last_retransmit_time > now - Duration::from_seconds(retransmit_interval))
+    if (now < m_retransmit_timer_start + m_retransmit_timeout)
         return;
 
     dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}) handling retransmit", this);
 
-    m_last_retransmit_time = now;
+    m_retransmit_timer_start = now;
     ++m_retransmit_attempts;
 
     if (m_retransmit_attempts > maximum_retransmits) {
@@ -695,47 +1044,75 @@ void TCPSocket::retransmit_packets()
         return;
     }
 
+    // RFC 6298, section 5.5: Back off the timer. It only comes back down with the next round trip time measurement,
+    // which according to RFC 1122 we must do even for SYN packets.
+    m_retransmit_timeout = min(m_retransmit_timeout + m_retransmit_timeout, maximum_retransmit_timeout);
+
+    m_unacked_packets.with_exclusive([&](auto& unacked_packets) {
+        if (unacked_packets.packets.is_empty())
+            return;
+
+        m_congestion_control->on_retransmit_timeout(bytes_in_flight(unacked_packets), now);
+        m_in_recovery = false;
+        m_duplicate_acks_received = 0;
+        m_recovery_point = m_sequence_number;
+
+        // RFC 6675, section 5.1: The peer may have discarded data it SACKed earlier, so we presume that everything is lost.
+        for (auto& unacked_packet : unacked_packets.packets) {
+            unacked_packet.is_sacked = false;
+            unacked_packet.is_lost = true;
+        }
+
+        // RFC 5681, section 3.1: Only the earliest segment is sent right away, the others follow as the congestion window opens up again.
+        retransmit_first_unacked_packet(unacked_packets);
+    });
+}
+
+void TCPSocket::retransmit_packet(OutgoingPacket& packet)
+{
     auto adapter = bound_interface().with([](auto& bound_device) -> RefPtr<NetworkAdapter> { return bound_device; });
     auto routing_decision = route_to(peer_address(), local_address(), adapter);
     if (routing_decision.is_zero())
         return;
 
-    m_unacked_packets.with_exclusive([&](auto& unacked_packets) {
-        for (auto& packet : unacked_packets.packets) {
-            packet.tx_counter++;
-
-            if constexpr (TCP_SOCKET_DEBUG) {
-                auto& tcp_packet = *(TCPPacket const*)(packet.buffer->buffer->data() + packet.ipv4_payload_offset);
-                dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
-                    local_address(), local_port(),
-                    peer_address(), peer_port(),
-                    (tcp_packet.has_syn() ? "SYN " : ""),
-                    (tcp_packet.has_ack() ? "ACK " : ""),
-                    (tcp_packet.has_fin() ? "FIN " : ""),
-                    (tcp_packet.has_rst() ? "RST " : ""),
-                    tcp_packet.sequence_number(),
-                    tcp_packet.ack_number(),
-                    packet.tx_counter);
-            }
+    packet.tx_counter++;
+
+    if constexpr (TCP_SOCKET_DEBUG) {
+        auto& tcp_packet = *(TCPPacket const*)(packet.buffer->buffer->data() + packet.ipv4_payload_offset);
+        dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
+            local_address(), local_port(),
+            peer_address(), peer_port(),
+            (tcp_packet.has_syn() ? "SYN " : ""),
+            (tcp_packet.has_ack() ? "ACK " : ""),
+            (tcp_packet.has_fin() ? "FIN " : ""),
+            (tcp_packet.has_rst() ? "RST " : ""),
+            tcp_packet.sequence_number(),
+            tcp_packet.ack_number(),
+            packet.tx_counter);
+    }
 
-            size_t ipv4_payload_offset = routing_decision.adapter->ipv4_payload_offset();
-            if (ipv4_payload_offset != packet.ipv4_payload_offset) {
-                // FIXME: Add support for this. This can happen if after a route change
-                // we ended up on another adapter which doesn't have the same layer 2 type
-                // like the previous adapter.
-                VERIFY_NOT_REACHED();
-            }
+    size_t ipv4_payload_offset = routing_decision.adapter->ipv4_payload_offset();
+    if (ipv4_payload_offset != packet.ipv4_payload_offset) {
+        // FIXME: Add support for this. This can happen if after a route change
+        // we ended up on another adapter which doesn't have the same layer 2 type
+        // like the previous adapter.
+        VERIFY_NOT_REACHED();
+    }
 
-            auto packet_buffer = packet.buffer->bytes();
+    auto packet_buffer = packet.buffer->bytes();
 
-            routing_decision.adapter->fill_in_ipv4_header(*packet.buffer,
-                local_address(), routing_decision.next_hop, peer_address(),
-                TransportProtocol::TCP, packet_buffer.size() - ipv4_payload_offset, type_of_service(), ttl());
-            routing_decision.adapter->send_packet(packet_buffer);
-            m_packets_out++;
-            m_bytes_out += packet_buffer.size();
-        }
-    });
+    routing_decision.adapter->fill_in_ipv4_header(*packet.buffer,
+        local_address(), routing_decision.next_hop, peer_address(),
+        TransportProtocol::TCP, packet_buffer.size() - ipv4_payload_offset, type_of_service(), ttl());
+    routing_decision.adapter->send_packet(packet_buffer, packet.buffer->offload);
+    m_packets_out++;
+    m_bytes_out += packet_buffer.size();
+
+    packet.last_transmit_time = TimeManagement::the().monotonic_time();
+    packet.is_lost = false;
+    if (m_in_recovery)
+        packet.is_retransmitted_in_recovery = true;
+    ++m_retransmits;
 }
 
 bool TCPSocket::can_write(OpenFileDescription const& file_description, u64 size) const
@@ -746,11 +1123,10 @@ bool TCPSocket::can_write(OpenFileDescription const& file_description, u64 size)
     if (m_state == State::SynSent || m_state == State::SynReceived)
         return false;
 
-    if (!file_description.is_blocking())
-        return true;
-
+    // Wait until at least a full segment fits into both the peer's receive window and our congestion window,
+    // so that we don't end up sending lots of tiny segments.
     return m_unacked_packets.with_shared([&](auto& unacked_packets) {
-        return unacked_packets.size + size <= m_send_window_size;
+        return unacked_packets.packets.is_empty() || usable_send_window(unacked_packets) >= m_maximum_segment_size;
     });
 }
 }
@@ -12,9 +12,13 @@
 #include <AK/IntegralMath.h>
 #include <AK/SinglyLinkedList.h>
 #include <AK/Time.h>
+#include <AK/Vector.h>
 #include <Kernel/Library/LockWeakPtr.h>
 #include <Kernel/Locking/MutexProtected.h>
 #include <Kernel/Net/IP/Socket.h>
+#include <Kernel/Net/SocketTable.h>
+#include <Kernel/Net/TCP.h>
+#include <Kernel/Net/TCPCongestionControl.h>
 #include <Kernel/Time/TimerQueue.h>
 
 namespace Kernel {
@@ -23,7 +27,7 @@ class TCPSocket final : public IPv4Socket {
 public:
     static void for_each(Function<void(TCPSocket const&)>);
     static ErrorOr<void> try_for_each(Function<ErrorOr<void>(TCPSocket const&)>);
-    static ErrorOr<NonnullRefPtr<TCPSocket>> try_create(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer);
+    static ErrorOr<NonnullRefPtr<TCPSocket>> try_create(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer, TCPCongestionControl::Algorithm = TCPCongestionControl::default_algorithm);
     virtual ~TCPSocket() override;
 
     virtual bool unref() const override;
@@ -143,6 +147,22 @@ public:
         m_send_window_scale = scale;
     }
 
+    // RFC 9293 says to assume 536 bytes if the peer doesn't tell us otherwise.
+    static constexpr u16 default_maximum_segment_size = 536;
+    void set_peer_maximum_segment_size(u16);
+    u32 maximum_segment_size() const { return m_maximum_segment_size; }
+
+    void set_sack_permitted() { m_sack_permitted = true; }
+    bool is_sack_permitted() const { return m_sack_permitted; }
+
+    StringView congestion_control_name() const { return m_congestion_control->name(); }
+    u32 congestion_window() const { return m_congestion_control->congestion_window(); }
+    u32 slow_start_threshold() const { return m_congestion_control->slow_start_threshold(); }
+    Optional<Duration> smoothed_round_trip_time() const { return m_smoothed_round_trip_time; }
+    Duration retransmit_timeout() const { return m_retransmit_timeout; }
+    u32 retransmits() const { return m_retransmits; }
+    u32 fast_retransmits() const { return m_fast_retransmits; }
+
     // FIXME: Make this configurable?
     static constexpr u32 maximum_duplicate_acks = 5;
     void set_duplicate_acks(u32 acks) { m_duplicate_acks = acks; }
@@ -152,9 +172,13 @@ public:
     ErrorOr<void> send_tcp_packet(u16 flags, UserOrKernelBuffer const* = nullptr, size_t = 0, RoutingDecision* = nullptr);
     void receive_tcp_packet(TCPPacket const&, u16 size);
 
+    // Out of order data is held back until the gap before it is filled, and reported back to the peer with SACK.
+    bool queue_out_of_order_segment(TCPPacket const&, ReadonlyBytes raw_ipv4_packet, size_t payload_size, UnixDateTime const& packet_timestamp);
+    bool deliver_out_of_order_segments();
+    bool has_out_of_order_segments() const { return !m_out_of_order_segments.is_empty(); }
+
     bool should_delay_next_ack() const;
 
-    static MutexProtected<HashMap<IPv4SocketTuple, TCPSocket*>>& sockets_by_tuple();
     static RefPtr<TCPSocket> from_tuple(IPv4SocketTuple const& tuple);
 
     static MutexProtected<HashMap<IPv4SocketTuple, RefPtr<TCPSocket>>>& closing_sockets();
@@ -180,7 +204,7 @@ protected:
     void set_direction(Direction direction) { m_direction = direction; }
 
 private:
-    explicit TCPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer, NonnullOwnPtr<KBuffer> scratch_buffer, NonnullRefPtr<Timer> timer);
+    explicit TCPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer, NonnullOwnPtr<KBuffer> scratch_buffer, NonnullRefPtr<Timer> timer, NonnullOwnPtr<TCPCongestionControl>);
     virtual StringView class_name() const override { return "TCPSocket"sv; }
 
     virtual void shut_down_for_writing() override;
@@ -198,6 +222,27 @@ private:
     void enqueue_for_retransmit();
     void dequeue_for_retransmit();
 
+    struct UnackedPackets;
+    struct OutgoingPacket;
+    void update_round_trip_time(Duration sample);
+    void process_sack_blocks(TCPPacket const&, UnackedPackets&);
+    void mark_lost_packets(UnackedPackets&);
+    void enter_fast_recovery(UnackedPackets&, MonotonicTime now);
+    void retransmit_first_unacked_packet(UnackedPackets&);
+    void retransmit_lost_packets(UnackedPackets&);
+    void retransmit_packet(OutgoingPacket&);
+    u32 bytes_in_flight(UnackedPackets const&) const;
+    size_t usable_send_window(UnackedPackets const&) const;
+    size_t maximum_segment_size_for(NetworkAdapter const&) const;
+
+    struct SequenceRange {
+        u32 start { 0 };
+        u32 end { 0 };
+    };
+    Vector<SequenceRange, TCPOptionSACK::maximum_block_count> sack_ranges() const;
+
+    static constexpr size_t congestion_control_name_max_length = 16;
+
     static constexpr size_t receive_window_scale()
     {
         auto buffer_size_bit_length = AK::log2(receive_buffer_size) + 1;
@@ -220,11 +265,17 @@ private:
     u32 m_bytes_out { 0 };
 
     struct OutgoingPacket {
+        u32 sequence_number { 0 };
         u32 ack_number { 0 };
         RefPtr<PacketWithTimestamp> buffer;
         size_t ipv4_payload_offset;
+        size_t payload_size { 0 };
         LockWeakPtr<NetworkAdapter> adapter;
         int tx_counter { 0 };
+        MonotonicTime last_transmit_time;
+        bool is_sacked { false };
+        bool is_lost { false };
+        bool is_retransmitted_in_recovery { false };
     };
 
     struct UnackedPackets {
@@ -234,8 +285,40 @@ private:
 
     MutexProtected<UnackedPackets> m_unacked_packets;
 
+    struct OutOfOrderSegment {
+        u32 sequence_number { 0 };
+        size_t payload_size { 0 };
+        NonnullOwnPtr<KBuffer> raw_ipv4_packet;
+        UnixDateTime packet_timestamp;
+    };
+
+    static constexpr size_t maximum_out_of_order_segments = 64;
+    Vector<OutOfOrderSegment> m_out_of_order_segments;
+    size_t m_out_of_order_bytes { 0 };
+    u32 m_last_out_of_order_sequence_number { 0 };
+
     u32 m_duplicate_acks { 0 };
 
+    NonnullOwnPtr<TCPCongestionControl> m_congestion_control;
+    u32 m_maximum_segment_size { default_maximum_segment_size };
+    bool m_sack_permitted { false };
+
+    // Fast retransmit and recovery, see RFC 5681, RFC 6582 and RFC 6675.
+    static constexpr u32 duplicate_ack_threshold = 3;
+    u32 m_duplicate_acks_received { 0 };
+    bool m_in_recovery { false };
+    u32 m_recovery_point { 0 };
+    u32 m_retransmits { 0 };
+    u32 m_fast_retransmits { 0 };
+
+    // Retransmission timer, see RFC 6298.
+    static constexpr Duration initial_retransmit_timeout = Duration::from_seconds(1);
+    static constexpr Duration minimum_retransmit_timeout = Duration::from_milliseconds(200);
+    static constexpr Duration maximum_retransmit_timeout = Duration::from_seconds(60);
+    Optional<Duration> m_smoothed_round_trip_time;
+    Duration m_round_trip_time_variance;
+    Duration m_retransmit_timeout { initial_retransmit_timeout };
+
     u32 m_last_ack_number_sent { 0 };
     MonotonicTime m_last_ack_sent_time;
 
@@ -243,7 +326,7 @@ private:
 
     // FIXME: Make this configurable (sysctl)
     static constexpr u32 maximum_retransmits = 5;
-    MonotonicTime m_last_retransmit_time;
+    MonotonicTime m_retransmit_timer_start;
     u32 m_retransmit_attempts { 0 };
 
     // Default to maximum window size. receive_tcp_packet() will update from the
@@ -255,12 +338,16 @@ private:
     IntrusiveListNode<TCPSocket> m_retransmit_list_node;
 
     Optional<IPv4SocketTuple> m_registered_socket_tuple;
+    SocketTableNode<IPv4SocketTuple, TCPSocket> m_socket_table_node;
 
     NonnullRefPtr<Timer> m_timer;
 
 public:
     using RetransmitList = IntrusiveList<&TCPSocket::m_retransmit_list_node>;
     static MutexProtected<TCPSocket::RetransmitList>& sockets_for_retransmit();
+
+    using TupleTable = SocketTable<IPv4SocketTuple, TCPSocket, &TCPSocket::m_socket_table_node>;
+    static TupleTable& sockets_by_tuple();
 };
 
 }
@@ -18,35 +18,28 @@ namespace Kernel {
 
 void UDPSocket::for_each(Function<void(UDPSocket const&)> callback)
 {
-    sockets_by_port().for_each_shared([&](auto const& socket) {
-        callback(*socket.value);
+    sockets_by_port().for_each([&](auto const& socket) {
+        callback(socket);
     });
 }
 
 ErrorOr<void> UDPSocket::try_for_each(Function<ErrorOr<void>(UDPSocket const&)> callback)
 {
-    return sockets_by_port().with_shared([&](auto const& sockets) -> ErrorOr<void> {
-        for (auto& socket : sockets)
-            TRY(callback(*socket.value));
-        return {};
+    return sockets_by_port().try_for_each([&](auto const& socket) -> ErrorOr<void> {
+        return callback(socket);
     });
 }
 
-static Singleton<MutexProtected<HashMap<u16, UDPSocket*>>> s_map;
+static Singleton<UDPSocket::PortTable> s_map;
 
-MutexProtected<HashMap<u16, UDPSocket*>>& UDPSocket::sockets_by_port()
+UDPSocket::PortTable& UDPSocket::sockets_by_port()
 {
     return *s_map;
 }
 
 RefPtr<UDPSocket> UDPSocket::from_port(u16 port)
 {
-    return sockets_by_port().with_shared([&](auto const& table) -> RefPtr<UDPSocket> {
-        auto it = table.find(port);
-        if (it == table.end())
-            return {};
-        return (*it).value;
-    });
+    return sockets_by_port().get(port);
 }
 
 UDPSocket::UDPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer)
@@ -57,7 +50,7 @@ UDPSocket::UDPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer)
 UDPSocket::~UDPSocket()
 {
     sockets_by_port().with_exclusive([&](auto& table) {
-        table.remove(local_port());
+        table.remove(*this);
     });
 }
 
@@ -128,10 +121,9 @@ ErrorOr<void> UDPSocket::protocol_bind()
         return sockets_by_port().with_exclusive([&](auto& table) -> ErrorOr<void> {
             u16 port = first_scan_port;
             while (true) {
-                auto it = table.find(port);
-                if (it == table.end()) {
+                if (!table.contains(port)) {
                     set_local_port(port);
-                    table.set(port, this);
+                    table.add(port, *this);
                     return {};
                 }
                 ++port;
@@ -147,7 +139,7 @@ ErrorOr<void> UDPSocket::protocol_bind()
         return sockets_by_port().with_exclusive([&](auto& table) -> ErrorOr<void> {
             if (table.contains(local_port()))
                 return set_so_error(EADDRINUSE);
-            table.set(local_port(), this);
+            table.add(local_port(), *this);
             return {};
         });
     }
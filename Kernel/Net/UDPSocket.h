@@ -7,8 +7,8 @@
 #pragma once
 
 #include <AK/Error.h>
-#include <Kernel/Locking/MutexProtected.h>
 #include <Kernel/Net/IP/Socket.h>
+#include <Kernel/Net/SocketTable.h>
 
 namespace Kernel {
 
@@ -24,13 +24,20 @@ public:
 private:
     explicit UDPSocket(int protocol, NonnullOwnPtr<DoubleBuffer> receive_buffer);
     virtual StringView class_name() const override { return "UDPSocket"sv; }
-    static MutexProtected<HashMap<u16, UDPSocket*>>& sockets_by_port();
 
     virtual ErrorOr<size_t> protocol_receive(ReadonlyBytes raw_ipv4_packet, UserOrKernelBuffer& buffer, size_t buffer_size, int flags) override;
     virtual ErrorOr<size_t> protocol_send(UserOrKernelBuffer const&, size_t) override;
     virtual ErrorOr<size_t> protocol_size(ReadonlyBytes raw_ipv4_packet) override;
     virtual ErrorOr<void> protocol_connect(OpenFileDescription&) override;
     virtual ErrorOr<void> protocol_bind() override;
+
+    SocketTableNode<u16, UDPSocket> m_socket_table_node;
+
+public:
+    using PortTable = SocketTable<u16, UDPSocket, &UDPSocket::m_socket_table_node>;
+
+private:
+    static PortTable& sockets_by_port();
 };
 
 }
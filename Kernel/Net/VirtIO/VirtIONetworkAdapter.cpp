@@ -137,9 +137,22 @@ UNMAP_AFTER_INIT ErrorOr<void> VirtIONetworkAdapter::initialize_virtio_resources
             negotiated |= VIRTIO_NET_F_SPEED_DUPLEX;
         if (is_feature_set(supported_features, VIRTIO_NET_F_MTU))
             negotiated |= VIRTIO_NET_F_MTU;
+        if (is_feature_set(supported_features, VIRTIO_NET_F_CSUM)) {
+            negotiated |= VIRTIO_NET_F_CSUM;
+            // TSO depends on the device completing the checksums of the segments.
+            if (is_feature_set(supported_features, VIRTIO_NET_F_HOST_TSO4))
+                negotiated |= VIRTIO_NET_F_HOST_TSO4;
+        }
         return negotiated;
     }));
 
+    auto offloads = NetworkOffload::None;
+    if (is_feature_accepted(VIRTIO_NET_F_CSUM))
+        offloads |= NetworkOffload::TCPChecksum;
+    if (is_feature_accepted(VIRTIO_NET_F_HOST_TSO4))
+        offloads |= NetworkOffload::TCPSegmentation;
+    set_offloads(offloads);
+
     TRY(handle_device_config_change());
     TRY(setup_queues(2)); // receive & transmit
 
@@ -256,7 +269,29 @@ static bool copy_data_to_chain(VirtIO::QueueChain& chain, Memory::RingBuffer& ri
 void VirtIONetworkAdapter::send_raw(ReadonlyBytes payload)
 {
     dbgln_if(VIRTIO_DEBUG, "VirtIONetworkAdapter: send_raw length={}", payload.size());
+    send_with_header(payload, {});
+}
+
+void VirtIONetworkAdapter::send_raw_with_offload(ReadonlyBytes payload, PacketOffload const& offload)
+{
+    dbgln_if(VIRTIO_DEBUG, "VirtIONetworkAdapter: send_raw_with_offload length={} segment_size={}", payload.size(), offload.segment_size);
+
+    VirtIONetHdr hdr {};
+    if (offload.needs_checksum) {
+        hdr.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        hdr.csum_start = offload.checksum_start;
+        hdr.csum_offset = offload.checksum_offset;
+    }
+    if (offload.segment_size != 0) {
+        hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+        hdr.gso_size = offload.segment_size;
+        hdr.hdr_len = offload.header_size;
+    }
+    send_with_header(payload, hdr);
+}
 
+void VirtIONetworkAdapter::send_with_header(ReadonlyBytes payload, VirtIONetHdr const& hdr)
+{
     auto& queue = get_queue(TRANSMITQ);
     SpinlockLocker queue_lock(queue.lock());
     VirtIO::QueueChain chain(queue);
@@ -269,8 +304,7 @@ void VirtIONetworkAdapter::send_raw(ReadonlyBytes payload)
     }
 
     // FIXME: Handle errors from pushing to the chain and rewind the RingBuffer.
-    VirtIONetHdr hdr {};
-    VERIFY(copy_data_to_chain(chain, *m_tx_buffers, reinterpret_cast<u8*>(&hdr), sizeof(hdr)));
+    VERIFY(copy_data_to_chain(chain, *m_tx_buffers, reinterpret_cast<u8 const*>(&hdr), sizeof(hdr)));
     VERIFY(copy_data_to_chain(chain, *m_tx_buffers, payload.data(), payload.size()));
 
     supply_chain_and_notify(TRANSMITQ, chain);
@@ -563,8 +563,21 @@ ErrorOr<void> Process::do_exec(NonnullRefPtr<OpenFileDescription> main_program_d
         property = {};
     });
 
+    // NOTE: We might be building a new process on behalf of another one (see sys$posix_spawn), in which case
+    //       the current thread doesn't belong to us.
     auto* current_thread = Thread::current();
-    current_thread->reset_signals_for_exec();
+    new_main_thread = nullptr;
+    if (&current_thread->process() == this) {
+        new_main_thread = current_thread;
+    } else {
+        for_each_thread([&](auto& thread) {
+            new_main_thread = &thread;
+            return IterationDecision::Break;
+        });
+    }
+    VERIFY(new_main_thread);
+
+    new_main_thread->reset_signals_for_exec();
 
     clear_signal_handlers_for_exec();
 
@@ -582,17 +595,6 @@ ErrorOr<void> Process::do_exec(NonnullRefPtr<OpenFileDescription> main_program_d
         m_fds.with_exclusive([&](auto& fds) { fds[main_program_fd_allocation->fd].set(move(main_program_description), FD_CLOEXEC); });
     }
 
-    new_main_thread = nullptr;
-    if (&current_thread->process() == this) {
-        new_main_thread = current_thread;
-    } else {
-        for_each_thread([&](auto& thread) {
-            new_main_thread = &thread;
-            return IterationDecision::Break;
-        });
-    }
-    VERIFY(new_main_thread);
-
     auto credentials = this->credentials();
     auto auxv = generate_auxiliary_vector(load_result.load_base, load_result.entry_eip, credentials->uid(), credentials->euid(), credentials->gid(), credentials->egid(), path->view(), main_program_fd_allocation);
 
@@ -608,10 +610,10 @@ ErrorOr<void> Process::do_exec(NonnullRefPtr<OpenFileDescription> main_program_d
     set_name(last_part);
     new_main_thread->set_name(last_part);
 
-    if (wait_for_tracer_at_next_execve()) {
+    if (wait_for_tracer_at_next_execve() && new_main_thread == current_thread) {
         // Make sure we release the ptrace lock here or the tracer will block forever.
         ptrace_locker.unlock();
-        Thread::current()->send_urgent_signal_to_self(SIGSTOP);
+        current_thread->send_urgent_signal_to_self(SIGSTOP);
     } else {
         // Unlock regardless before disabling interrupts.
         // Ensure we always unlock after checking ptrace status to avoid TOCTOU ptrace issues
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Checked.h>
+#include <AK/NumericLimits.h>
+#include <Kernel/API/POSIX/fcntl.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/FileSystem/InodeFile.h>
+#include <Kernel/FileSystem/OpenFileDescription.h>
+#include <Kernel/Tasks/Process.h>
+
+namespace Kernel {
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_fadvise.html
+ErrorOr<FlatPtr> Process::sys$posix_fadvise(int fd, off_t offset, off_t length, int advice)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::stdio));
+
+    // [EINVAL] The value of advice is invalid, or the value of len is less than zero.
+    if (offset < 0 || length < 0)
+        return EINVAL;
+
+    auto description = TRY(open_file_description(fd));
+
+    // [ESPIPE] The fd argument is associated with a pipe or FIFO.
+    if (description->is_fifo())
+        return ESPIPE;
+
+    // NOTE: The advice only ever affects performance, so anything that isn't backed by an inode simply ignores it.
+    switch (advice) {
+    case POSIX_FADV_NORMAL:
+        description->set_access_pattern(OpenFileDescription::AccessPattern::Normal);
+        description->set_data_is_read_once(false);
+        return 0;
+    case POSIX_FADV_SEQUENTIAL:
+        description->set_access_pattern(OpenFileDescription::AccessPattern::Sequential);
+        return 0;
+    case POSIX_FADV_RANDOM:
+        description->set_access_pattern(OpenFileDescription::AccessPattern::Random);
+        return 0;
+    case POSIX_FADV_WILLNEED: {
+        if (!description->file().is_inode())
+            return 0;
+        auto& file = static_cast<InodeFile&>(description->file());
+        auto size = file.inode().size();
+        if (static_cast<u64>(offset) >= size)
+            return 0;
+        // A length of zero means "until the end of the file".
+        u64 end = size;
+        if (length != 0 && !Checked<u64>::addition_would_overflow(offset, length))
+            end = min(end, static_cast<u64>(offset) + length);
+        file.schedule_read_ahead(offset, end - offset);
+        return 0;
+    }
+    case POSIX_FADV_DONTNEED: {
+        if (!description->file().is_inode())
+            return 0;
+        auto& inode = static_cast<InodeFile&>(description->file()).inode();
+        // Only pages that are entirely within the range are dropped, the ones at its edges may still be needed.
+        u64 first_page_index = ceil_div(static_cast<u64>(offset), static_cast<u64>(PAGE_SIZE));
+        // A length of zero means "until the end of the file", and so does a range that reaches past it.
+        u64 end_page_index = NumericLimits<u64>::max();
+        if (length != 0 && !Checked<u64>::addition_would_overflow(offset, length) && static_cast<u64>(offset) + length < inode.size())
+            end_page_index = (static_cast<u64>(offset) + length) / PAGE_SIZE;
+        // NOTE: Writes go to the file system and the page cache alike, so there's nothing to write back before dropping
+        //       pages. Pages that are mapped or otherwise in use stay where they are.
+        inode.drop_cached_pages(first_page_index, end_page_index);
+        return 0;
+    }
+    case POSIX_FADV_NOREUSE:
+        description->set_data_is_read_once(true);
+        return 0;
+    default:
+        return EINVAL;
+    }
+}
+
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/IntegralMath.h>
+#include <Kernel/FileSystem/IORing.h>
+#include <Kernel/FileSystem/OpenFileDescription.h>
+#include <Kernel/Tasks/Process.h>
+
+namespace Kernel {
+
+ErrorOr<FlatPtr> Process::sys$io_ring_setup(u32 entries, int options)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::stdio));
+
+    if (entries == 0 || entries > IO_RING_MAX_ENTRIES)
+        return EINVAL;
+    if (options & ~O_CLOEXEC)
+        return EINVAL;
+
+    auto ring = TRY(IORing::try_create(1u << AK::ceil_log2(entries)));
+    auto description = TRY(OpenFileDescription::try_create(move(ring)));
+
+    // NOTE: mmap() requires these to map the ring shared and writable.
+    description->set_readable(true);
+    description->set_writable(true);
+
+    u32 fd_flags = 0;
+    if (options & O_CLOEXEC)
+        fd_flags |= FD_CLOEXEC;
+
+    return m_fds.with_exclusive([&](auto& fds) -> ErrorOr<FlatPtr> {
+        auto new_fd = TRY(fds.allocate());
+        fds[new_fd.fd].set(description, fd_flags);
+        return new_fd.fd;
+    });
+}
+
+ErrorOr<FlatPtr> Process::sys$io_ring_enter(int fd, u32 to_submit)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::stdio));
+
+    auto description = TRY(open_file_description(fd));
+    if (!description->file().is_io_ring())
+        return EINVAL;
+    auto& ring = static_cast<IORing&>(description->file());
+
+    // NOTE: Submissions are carried out one after another by the calling thread, as their buffers live in the address
+    //       space of this process. None of them waits for a file to become ready though (see execute_io_ring_submission()),
+    //       so one slow file descriptor can't hold up the rest of the batch.
+    return TRY(ring.submit(to_submit, [&](IORingSubmission const& submission) {
+        return execute_io_ring_submission(submission);
+    }));
+}
+
+// NOTE: io_ring_enter() already required the stdio promise, operations that need more check for it themselves.
+// Operations never wait for a file to become ready, no matter whether it's blocking or not. Instead, they complete with
+// EAGAIN, so the process can wait for readiness with poll() and submit them again.
+ErrorOr<FlatPtr> Process::execute_io_ring_submission(IORingSubmission const& submission)
+{
+    switch (submission.operation) {
+    case IORingOperation::Nop:
+        return 0;
+    case IORingOperation::Read: {
+        auto description = TRY(open_file_description(submission.fd));
+        if (!description->is_readable())
+            return EBADF;
+        if (description->is_directory())
+            return EISDIR;
+        if (submission.offset != -1 && (submission.offset < 0 || !description->file().is_seekable()))
+            return EINVAL;
+        if (submission.length == 0)
+            return 0;
+
+        auto buffer = TRY(UserOrKernelBuffer::for_user_buffer(Userspace<u8*>(submission.address), submission.length));
+        if (!description->can_read())
+            return EAGAIN;
+
+        // NOTE: Just like sys$read(), this has to hold the big lock, as not all files are safe to read without it.
+        MutexLocker big_lock_locker(big_lock());
+        if (submission.offset == -1)
+            return TRY(description->read(buffer, submission.length));
+        return TRY(description->read(buffer, submission.offset, submission.length));
+    }
+    case IORingOperation::Write: {
+        auto description = TRY(open_file_description(submission.fd));
+        if (!description->is_writable())
+            return EBADF;
+        if (submission.offset != -1 && (submission.offset < 0 || !description->file().is_seekable()))
+            return EINVAL;
+        if (submission.length == 0)
+            return 0;
+
+        auto buffer = TRY(UserOrKernelBuffer::for_user_buffer(Userspace<u8 const*>(submission.address), submission.length));
+        // NOTE: Just like sys$write(), this has to hold the big lock, as not all files are safe to write to without it.
+        MutexLocker big_lock_locker(big_lock());
+        if (submission.offset == -1)
+            return do_write(*description, buffer, submission.length, {}, ShouldBlock::No);
+        return do_write(*description, buffer, submission.length, submission.offset, ShouldBlock::No);
+    }
+    case IORingOperation::Accept:
+        return accept_impl(submission.fd, Userspace<sockaddr*>(submission.address), Userspace<socklen_t*>(submission.address2), submission.flags, ShouldBlock::No);
+    case IORingOperation::Connect: {
+        // NOTE: Blocking sockets wait for the connection to be established, and there's no way to keep them from doing so.
+        auto description = TRY(open_file_description(submission.fd));
+        if (description->is_socket() && description->is_blocking())
+            return EAGAIN;
+        return sys$connect(submission.fd, Userspace<sockaddr const*>(submission.address), submission.length);
+    }
+    case IORingOperation::Fsync:
+        return sys$fsync(submission.fd);
+    }
+    return EINVAL;
+}
+
+}
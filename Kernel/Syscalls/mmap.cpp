@@ -97,6 +97,17 @@ ErrorOr<FlatPtr> Process::sys$mmap(Userspace<Syscall::SC_mmap_params const*> use
         return EINVAL;
 
     size_t rounded_size = TRY(Memory::page_round_up(size));
+
+    bool map_huge = flags & MAP_HUGE;
+    if (map_huge) {
+        // Huge pages can only be mapped at huge page aligned addresses, and always cover a whole huge page.
+        if ((flags & MAP_FIXED || flags & MAP_FIXED_NOREPLACE) && addr % Memory::HUGE_PAGE_SIZE)
+            return EINVAL;
+        if (rounded_size > NumericLimits<size_t>::max() - (Memory::HUGE_PAGE_SIZE - 1))
+            return ENOMEM;
+        rounded_size = align_up_to(rounded_size, Memory::HUGE_PAGE_SIZE);
+        alignment = max(alignment, Memory::HUGE_PAGE_SIZE);
+    }
     if (!Memory::is_user_range(VirtualAddress(addr), rounded_size))
         return EFAULT;
 
@@ -120,6 +131,7 @@ ErrorOr<FlatPtr> Process::sys$mmap(Userspace<Syscall::SC_mmap_params const*> use
     bool map_noreserve = flags & MAP_NORESERVE;
     bool map_randomized = flags & MAP_RANDOMIZED;
     bool map_fixed_noreplace = flags & MAP_FIXED_NOREPLACE;
+    bool map_populate = flags & MAP_POPULATE;
 
     if (map_shared && map_private)
         return EINVAL;
@@ -135,6 +147,9 @@ ErrorOr<FlatPtr> Process::sys$mmap(Userspace<Syscall::SC_mmap_params const*> use
     if (map_stack && (!map_private || !map_anonymous))
         return EINVAL;
 
+    if (map_huge && (!map_anonymous || map_noreserve || flags & MAP_PURGEABLE))
+        return EINVAL;
+
     Memory::VirtualRange requested_range { VirtualAddress { addr }, rounded_size };
     if (addr && !(map_fixed || map_fixed_noreplace)) {
         // If there's an address but MAP_FIXED wasn't specified, the address is just a hint.
@@ -150,9 +165,17 @@ ErrorOr<FlatPtr> Process::sys$mmap(Userspace<Syscall::SC_mmap_params const*> use
 
     if (map_anonymous) {
         auto strategy = map_noreserve ? AllocationStrategy::None : AllocationStrategy::Reserve;
+        // NOTE: Populated anonymous memory is allocated along with the VMObject, and gets mapped right away with the region.
+        //       Without a reservation, it's populated after mapping instead, as far as there's memory for it. Memory that
+        //       can't be written to can't be anything but zeroes, so there's nothing to populate.
+        if (map_populate && !map_noreserve && (prot & PROT_WRITE))
+            strategy = AllocationStrategy::AllocateNow;
 
         if (flags & MAP_PURGEABLE) {
             vmobject = TRY(Memory::AnonymousVMObject::try_create_purgeable_with_size(rounded_size, strategy));
+        } else if (map_huge) {
+            // NOTE: Huge pages are allocated up front. Should physical memory be too fragmented, we quietly fall back to regular pages.
+            vmobject = TRY(Memory::AnonymousVMObject::try_create_with_size(rounded_size, AllocationStrategy::AllocateNow));
         } else {
             vmobject = TRY(Memory::AnonymousVMObject::try_create_with_size(rounded_size, strategy));
         }
@@ -180,10 +203,11 @@ ErrorOr<FlatPtr> Process::sys$mmap(Userspace<Syscall::SC_mmap_params const*> use
         memory_type = vmobject_and_memory_type.memory_type;
     }
 
-    return address_space().with([&](auto& space) -> ErrorOr<FlatPtr> {
+    Memory::VirtualRange mapped_range { {}, 0 };
+    auto mapped_address = TRY(address_space().with([&](auto& space) -> ErrorOr<FlatPtr> {
         // If MAP_FIXED is specified, existing mappings that intersect the requested range are removed.
         if (map_fixed)
-            TRY(space->unmap_mmap_range(VirtualAddress(addr), size));
+            TRY(space->unmap_mmap_range(VirtualAddress(addr), rounded_size));
 
         region = TRY(space->allocate_region_with_vmobject(
             map_randomized ? Memory::RandomizeVirtualAddress::Yes : Memory::RandomizeVirtualAddress::No,
@@ -214,8 +238,16 @@ ErrorOr<FlatPtr> Process::sys$mmap(Userspace<Syscall::SC_mmap_params const*> use
 
         PerformanceManager::add_mmap_perf_event(*this, *region);
 
+        mapped_range = region->range();
         return region->vaddr().get();
-    });
+    }));
+
+    // Reading in file contents may block, so this has to happen after we've let go of the address space.
+    // Populating is only an optimization, if it fails the remaining pages will simply be faulted in on access.
+    if (map_populate && (description || map_noreserve))
+        (void)MM.prefault_user_range(*this, mapped_range);
+
+    return mapped_address;
 }
 
 ErrorOr<FlatPtr> Process::sys$mprotect(Userspace<void*> addr, size_t size, int prot)
@@ -369,6 +401,12 @@ ErrorOr<FlatPtr> Process::sys$madvise(Userspace<void*> address, size_t size, int
     if (!is_user_range(range_to_madvise))
         return EFAULT;
 
+    if (advice == MADV_WILLNEED) {
+        // Unlike the other advice, this may span several regions, and has to block on reading in file contents.
+        TRY(MM.prefault_user_range(*this, range_to_madvise));
+        return 0;
+    }
+
     return address_space().with([&](auto& space) -> ErrorOr<FlatPtr> {
         auto* region = space->find_region_from_range(range_to_madvise);
         if (!region)
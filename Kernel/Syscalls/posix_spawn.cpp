@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/ScopeGuard.h>
+#include <Kernel/API/POSIX/signal_numbers.h>
+#include <Kernel/Debug.h>
+#include <Kernel/Devices/TTY/TTY.h>
+#include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/OpenFileDescription.h>
+#include <Kernel/FileSystem/VirtualFileSystem.h>
+#include <Kernel/Memory/MemoryManager.h>
+#include <Kernel/Tasks/PerformanceManager.h>
+#include <Kernel/Tasks/Process.h>
+#include <Kernel/Tasks/Scheduler.h>
+#include <Kernel/Tasks/ScopedProcessList.h>
+
+namespace Kernel {
+
+static constexpr size_t max_spawn_file_action_count = 1024;
+
+struct SpawnFileAction {
+    Syscall::PosixSpawnFileActionType type;
+    int fd { -1 };
+    int new_fd { -1 };
+    int options { 0 };
+    mode_t mode { 0 };
+    OwnPtr<KString> path;
+};
+
+// Unlike fork() followed by execve(), this never copies (or even looks at) the address space of the parent:
+// The child starts out with the parent's file descriptors, credentials and signal mask, and everything else
+// is built from scratch by exec().
+ErrorOr<FlatPtr> Process::sys$posix_spawn(Userspace<Syscall::SC_posix_spawn_params const*> user_params)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::proc));
+    TRY(require_promise(Pledge::exec));
+
+    // NOTE: Everything has to be copied out of userspace up front, as exec() switches to the address space of the child.
+    auto params = TRY(copy_typed_from_user(user_params));
+
+    if (params.arguments.length > ARG_MAX || params.environment.length > ARG_MAX)
+        return E2BIG;
+
+    // NOTE: The caller is expected to always pass at least one argument by convention,
+    //       the program path that was passed as params.path.
+    if (params.arguments.length == 0)
+        return EINVAL;
+
+    if (params.file_action_count > max_spawn_file_action_count)
+        return EINVAL;
+
+    auto path = TRY(get_syscall_path_argument(params.path));
+
+    auto copy_user_strings = [](auto const& list, auto& output) -> ErrorOr<void> {
+        if (!list.length)
+            return {};
+        Checked<size_t> size = sizeof(*list.strings);
+        size *= list.length;
+        if (size.has_overflow())
+            return EOVERFLOW;
+        Vector<Syscall::StringArgument, 32> strings;
+        TRY(strings.try_resize(list.length));
+        TRY(copy_from_user(strings.data(), list.strings, size.value()));
+        for (size_t i = 0; i < list.length; ++i) {
+            auto string = TRY(try_copy_kstring_from_user(strings[i]));
+            TRY(output.try_append(move(string)));
+        }
+        return {};
+    };
+
+    Vector<NonnullOwnPtr<KString>> arguments;
+    TRY(copy_user_strings(params.arguments, arguments));
+
+    Vector<NonnullOwnPtr<KString>> environment;
+    TRY(copy_user_strings(params.environment, environment));
+
+    Vector<SpawnFileAction> file_actions;
+    if (params.file_action_count > 0) {
+        Vector<Syscall::SC_posix_spawn_file_action> user_file_actions;
+        TRY(user_file_actions.try_resize(params.file_action_count));
+        TRY(copy_n_from_user(user_file_actions.data(), params.file_actions, params.file_action_count));
+        TRY(file_actions.try_ensure_capacity(params.file_action_count));
+
+        for (auto const& user_action : user_file_actions) {
+            SpawnFileAction action { user_action.type, user_action.fd, user_action.new_fd, user_action.options, user_action.mode & 0777, {} };
+            switch (action.type) {
+            case Syscall::PosixSpawnFileActionType::Open:
+                if (action.options & (O_NOFOLLOW_NOERROR | O_UNLINK_INTERNAL))
+                    return EINVAL;
+                if (action.options & O_WRONLY)
+                    TRY(require_promise(Pledge::wpath));
+                else if (action.options & O_RDONLY)
+                    TRY(require_promise(Pledge::rpath));
+                if (action.options & O_CREAT)
+                    TRY(require_promise(Pledge::cpath));
+                action.path = TRY(get_syscall_path_argument(user_action.path));
+                break;
+            case Syscall::PosixSpawnFileActionType::Chdir:
+                TRY(require_promise(Pledge::rpath));
+                action.path = TRY(get_syscall_path_argument(user_action.path));
+                break;
+            case Syscall::PosixSpawnFileActionType::Close:
+            case Syscall::PosixSpawnFileActionType::Dup2:
+            case Syscall::PosixSpawnFileActionType::Fchdir:
+                break;
+            default:
+                return EINVAL;
+            }
+            file_actions.unchecked_append(move(action));
+        }
+    }
+
+    auto credentials = this->credentials();
+    auto child_and_first_thread = TRY(Process::create_with_forked_name(credentials->uid(), credentials->gid(), pid(), m_is_kernel_process, vfs_root_context(), hostname_context(), current_directory(), executable(), tty(), this));
+    auto& child = child_and_first_thread.process;
+    auto& child_first_thread = child_and_first_thread.first_thread;
+
+    ArmedScopeGuard thread_finalizer_guard = [&child_first_thread]() {
+        SpinlockLocker lock(g_scheduler_lock);
+        child_first_thread->detach();
+        child_first_thread->set_state(Thread::State::Dying);
+    };
+
+    // NOTE: All user processes have a leaked ref on them. It's balanced by Thread::WaitBlockerSet::finalize().
+    child->ref();
+
+    TRY(m_unveil_data.with([&](auto& parent_unveil_data) -> ErrorOr<void> {
+        return child->m_unveil_data.with([&](auto& child_unveil_data) -> ErrorOr<void> {
+            child_unveil_data.state = parent_unveil_data.state;
+            child_unveil_data.paths = TRY(parent_unveil_data.paths.deep_copy());
+            return {};
+        });
+    }));
+
+    TRY(m_exec_unveil_data.with([&](auto& parent_exec_unveil_data) -> ErrorOr<void> {
+        return child->m_exec_unveil_data.with([&](auto& child_exec_unveil_data) -> ErrorOr<void> {
+            child_exec_unveil_data.state = parent_exec_unveil_data.state;
+            child_exec_unveil_data.paths = TRY(parent_exec_unveil_data.paths.deep_copy());
+            return {};
+        });
+    }));
+
+    TRY(child->m_fds.with_exclusive([&](auto& child_fds) {
+        return m_fds.with_exclusive([&](auto& parent_fds) {
+            return child_fds.try_clone(parent_fds);
+        });
+    }));
+
+    auto child_credentials = credentials;
+    if (params.reset_ids && (credentials->euid() != credentials->uid() || credentials->egid() != credentials->gid())) {
+        child_credentials = TRY(Credentials::create(
+            credentials->uid(),
+            credentials->gid(),
+            credentials->uid(),
+            credentials->gid(),
+            credentials->suid(),
+            credentials->sgid(),
+            credentials->extra_gids(),
+            credentials->sid(),
+            credentials->pgid()));
+    }
+
+    with_protected_data([&](auto& my_protected_data) {
+        child->with_mutable_protected_data([&](auto& child_protected_data) {
+            child_protected_data.promises = my_protected_data.promises;
+            child_protected_data.execpromises = my_protected_data.execpromises;
+            child_protected_data.has_promises = my_protected_data.has_promises;
+            child_protected_data.has_execpromises = my_protected_data.has_execpromises;
+            child_protected_data.credentials = child_credentials;
+            child_protected_data.umask = my_protected_data.umask;
+            child_protected_data.dumpable = my_protected_data.dumpable;
+            child_protected_data.process_group = my_protected_data.process_group;
+            if (my_protected_data.jailed_until_exit.was_set())
+                child_protected_data.jailed_until_exit.set();
+            child_protected_data.jailed_until_exec = my_protected_data.jailed_until_exec;
+        });
+    });
+
+    if (params.set_signal_defaults) {
+        for (size_t signal = 1; signal < NSIG; ++signal) {
+            if (params.signal_defaults & (1 << (signal - 1)))
+                child->m_signal_action_data[signal] = {};
+        }
+    }
+
+    child_first_thread->update_signal_mask(params.set_signal_mask ? params.signal_mask : Thread::current()->signal_mask());
+
+    auto apply_file_action = [&child](SpawnFileAction const& action) -> ErrorOr<void> {
+        switch (action.type) {
+        case Syscall::PosixSpawnFileActionType::Open: {
+            if (action.fd < 0 || static_cast<size_t>(action.fd) >= OpenFileDescriptions::max_open())
+                return EBADF;
+            auto description = TRY(VirtualFileSystem::open(child->vfs_root_context(), child->credentials(), action.path->view(), action.options, action.mode & ~child->umask(), child->current_directory()));
+            if (description->inode() && description->inode()->bound_socket())
+                return ENXIO;
+            child->m_fds.with_exclusive([&](auto& fds) {
+                if (!fds.m_fds_metadatas[action.fd].is_allocated())
+                    fds.m_fds_metadatas[action.fd].allocate();
+                fds[action.fd].set(move(description), (action.options & O_CLOEXEC) ? FD_CLOEXEC : 0);
+            });
+            return {};
+        }
+        case Syscall::PosixSpawnFileActionType::Close: {
+            auto description = TRY(child->open_file_description(action.fd));
+            child->m_fds.with_exclusive([&](auto& fds) { fds[action.fd] = {}; });
+            return description->close();
+        }
+        case Syscall::PosixSpawnFileActionType::Dup2:
+            return child->m_fds.with_exclusive([&](auto& fds) -> ErrorOr<void> {
+                auto description = TRY(fds.open_file_description(action.fd));
+                if (action.new_fd < 0 || static_cast<size_t>(action.new_fd) >= OpenFileDescriptions::max_open())
+                    return EBADF;
+                // POSIX says that the close-on-exec flag is cleared if both are the same.
+                if (action.fd == action.new_fd) {
+                    fds[action.new_fd].set_flags(fds[action.new_fd].flags() & ~FD_CLOEXEC);
+                    return {};
+                }
+                if (!fds.m_fds_metadatas[action.new_fd].is_allocated())
+                    fds.m_fds_metadatas[action.new_fd].allocate();
+                fds[action.new_fd].set(move(description));
+                return {};
+            });
+        case Syscall::PosixSpawnFileActionType::Chdir: {
+            RefPtr<Custody> new_directory = TRY(VirtualFileSystem::open_directory(child->vfs_root_context(), child->credentials(), action.path->view(), child->current_directory()));
+            child->m_current_directory.with([&](auto& current_directory) {
+                swap(current_directory, new_directory);
+            });
+            return {};
+        }
+        case Syscall::PosixSpawnFileActionType::Fchdir: {
+            auto description = TRY(child->open_file_description(action.fd));
+            if (!description->is_directory())
+                return ENOTDIR;
+            if (!description->metadata().may_execute(child->credentials()))
+                return EACCES;
+            child->m_current_directory.with([&](auto& current_directory) {
+                current_directory = description->custody();
+            });
+            return {};
+        }
+        }
+        VERIFY_NOT_REACHED();
+    };
+
+    for (auto const& action : file_actions)
+        TRY(apply_file_action(action));
+
+    dbgln_if(FORK_DEBUG, "posix_spawn: child={}, path={}", child, path);
+
+    PerformanceManager::add_process_created_event(*child);
+
+    Thread* new_main_thread = nullptr;
+    InterruptsState previous_interrupts_state = InterruptsState::Enabled;
+    auto exec_result = child->exec(move(path), move(arguments), move(environment), new_main_thread, previous_interrupts_state);
+
+    // NOTE: exec() loads the program while the address space of the child is active, so we have to come back to ours.
+    Memory::MemoryManager::enter_process_address_space(*this);
+    if (exec_result.is_error())
+        return exec_result.release_error();
+
+    // NOTE: exec() leaves us in a critical section with interrupts disabled, as it normally doesn't return.
+    Processor::restore_interrupts_state(previous_interrupts_state);
+    Processor::leave_critical();
+
+    VERIFY(new_main_thread == child_first_thread.ptr());
+    thread_finalizer_guard.disarm();
+
+    m_scoped_process_list.with([&](auto& list_ptr) {
+        if (list_ptr) {
+            child->m_scoped_process_list.with([&](auto& child_list_ptr) {
+                child_list_ptr = list_ptr;
+            });
+            list_ptr->attach(*child);
+        }
+    });
+
+    Process::register_new(*child);
+
+    SpinlockLocker lock(g_scheduler_lock);
+    new_main_thread->set_affinity(Thread::current()->affinity());
+    new_main_thread->set_state(Thread::State::Runnable);
+
+    return child->pid().value();
+}
+
+}
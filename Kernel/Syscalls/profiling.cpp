@@ -38,7 +38,7 @@ ErrorOr<FlatPtr> Process::profiling_enable(pid_t pid, u64 event_mask)
         if (g_global_perf_events) {
             g_global_perf_events->clear();
         } else {
-            g_global_perf_events = PerformanceEventBuffer::try_create_with_size(32 * MiB).leak_ptr();
+            g_global_perf_events = PerformanceEventBuffer::try_create_per_processor(8 * MiB).leak_ptr();
             if (!g_global_perf_events) {
                 g_profiling_event_mask = 0;
                 return ENOMEM;
@@ -128,6 +128,8 @@ ErrorOr<FlatPtr> Process::sys$profiling_free_buffer(pid_t pid)
         OwnPtr<PerformanceEventBuffer> perf_events;
 
         {
+            // NOTE: This keeps the buffer alive while /dev/perfcore is draining it.
+            SpinlockLocker lock(g_profiling_lock);
             ScopedCritical critical;
 
             perf_events = adopt_own_if_nonnull(g_global_perf_events);
@@ -5,6 +5,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/NumericLimits.h>
 #include <Kernel/API/Syscall.h>
 #include <Kernel/Tasks/Process.h>
 #include <Kernel/Tasks/Scheduler.h>
@@ -114,4 +115,67 @@ ErrorOr<FlatPtr> Process::sys$scheduler_get_parameters(Userspace<Syscall::SC_sch
     return 0;
 }
 
+static u64 online_processors_mask()
+{
+    auto processor_count = Processor::count();
+    if (processor_count >= 64)
+        return NumericLimits<u64>::max();
+    return (1ull << processor_count) - 1;
+}
+
+ErrorOr<FlatPtr> Process::sys$scheduler_set_affinity(Userspace<Syscall::SC_scheduler_affinity_params const*> user_param)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::proc));
+    auto parameters = TRY(copy_typed_from_user(user_param));
+
+    // Like on Linux, processors that don't exist are silently ignored, as long as there's at least one that does.
+    auto affinity = parameters.affinity & online_processors_mask();
+    if (affinity == 0)
+        return EINVAL;
+
+    bool must_leave_processor = false;
+    {
+        SpinlockLocker lock(g_scheduler_lock);
+        auto peer = TRY(get_thread_from_pid_or_tid(parameters.pid_or_tid, parameters.mode));
+
+        auto credentials = this->credentials();
+        auto peer_credentials = peer->process().credentials();
+        if (!credentials->is_superuser() && credentials->euid() != peer_credentials->uid() && credentials->uid() != peer_credentials->uid())
+            return EPERM;
+
+        peer->set_affinity(affinity);
+        must_leave_processor = peer.ptr() == Thread::current() && !(affinity & (1ull << Processor::current_id()));
+    }
+
+    // Don't keep running on a processor we just told ourselves not to run on.
+    if (must_leave_processor)
+        Thread::current()->yield_without_releasing_big_lock();
+    return 0;
+}
+
+ErrorOr<FlatPtr> Process::sys$scheduler_get_affinity(Userspace<Syscall::SC_scheduler_affinity_params*> user_param)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::proc));
+
+    Syscall::SC_scheduler_affinity_params parameters;
+    TRY(copy_from_user(&parameters, user_param));
+
+    {
+        SpinlockLocker lock(g_scheduler_lock);
+        auto peer = TRY(get_thread_from_pid_or_tid(parameters.pid_or_tid, parameters.mode));
+
+        auto credentials = this->credentials();
+        auto peer_credentials = peer->process().credentials();
+        if (!credentials->is_superuser() && credentials->euid() != peer_credentials->uid() && credentials->uid() != peer_credentials->uid())
+            return EPERM;
+
+        parameters.affinity = peer->affinity() & online_processors_mask();
+    }
+
+    TRY(copy_to_user(user_param, &parameters));
+    return 0;
+}
+
 }
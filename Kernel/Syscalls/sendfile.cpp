@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/NumericLimits.h>
+#include <AK/ScopeGuard.h>
+#include <AK/Singleton.h>
+#include <Kernel/API/POSIX/fcntl.h>
+#include <Kernel/FileSystem/FIFO.h>
+#include <Kernel/FileSystem/InodeFile.h>
+#include <Kernel/FileSystem/OpenFileDescription.h>
+#include <Kernel/Library/KBuffer.h>
+#include <Kernel/Locking/SpinlockProtected.h>
+#include <Kernel/Tasks/Process.h>
+
+namespace Kernel {
+
+using BlockFlags = Thread::FileBlocker::BlockFlags;
+
+// At most this much data is moved at once. When it has to go through a kernel buffer, this is the size of that buffer.
+static constexpr size_t splice_chunk_size = 64 * KiB;
+
+// Splice buffers are kept around once they're no longer needed, so that splicing doesn't have to allocate anything.
+static constexpr size_t max_unused_splice_buffers = 4;
+static Singleton<SpinlockProtected<Vector<NonnullOwnPtr<KBuffer>, max_unused_splice_buffers>, LockRank::None>> s_unused_splice_buffers;
+
+static ErrorOr<NonnullOwnPtr<KBuffer>> take_splice_buffer()
+{
+    auto buffer = s_unused_splice_buffers->with([](auto& buffers) -> OwnPtr<KBuffer> {
+        if (buffers.is_empty())
+            return nullptr;
+        return buffers.take_last();
+    });
+    if (buffer)
+        return buffer.release_nonnull();
+    return KBuffer::try_create_with_size("Splice buffer"sv, splice_chunk_size, Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow);
+}
+
+static void give_back_splice_buffer(NonnullOwnPtr<KBuffer> buffer)
+{
+    // NOTE: If there are enough unused buffers already, this one is freed after we've let go of the lock.
+    OwnPtr<KBuffer> buffer_to_free = s_unused_splice_buffers->with([&](auto& buffers) -> OwnPtr<KBuffer> {
+        if (buffers.size() >= max_unused_splice_buffers)
+            return move(buffer);
+        buffers.unchecked_append(move(buffer));
+        return nullptr;
+    });
+}
+
+// Data that was taken out of a pipe, socket or device can't be put back. Reads from those are sized to what the output pipe
+// can take, so this only has to wait if another writer filled up the pipe in the meantime. Like write(), it doesn't wait
+// for non-blocking outputs, and then whatever didn't fit is lost.
+static ErrorOr<size_t> write_fully(OpenFileDescription& description, UserOrKernelBuffer const& data, size_t size, Optional<off_t> offset, ShouldBlock should_block)
+{
+    size_t total_nwritten = 0;
+    while (total_nwritten < size) {
+        if (!description.can_write()) {
+            if (!description.is_blocking() || should_block == ShouldBlock::No) {
+                if (total_nwritten > 0)
+                    return total_nwritten;
+                return EAGAIN;
+            }
+            auto unblock_flags = BlockFlags::None;
+            if (Thread::current()->block<Thread::WriteBlocker>({}, description, unblock_flags).was_interrupted()) {
+                if (total_nwritten > 0)
+                    return total_nwritten;
+                return EINTR;
+            }
+            continue;
+        }
+        auto nwritten_or_error = offset.has_value()
+            ? description.write(offset.value() + total_nwritten, data.offset(total_nwritten), size - total_nwritten)
+            : description.write(data.offset(total_nwritten), size - total_nwritten);
+        if (nwritten_or_error.is_error()) {
+            // Someone else got to the output first. Just like write(), we wait for it again if we may.
+            if (nwritten_or_error.error().code() == EAGAIN && description.is_blocking() && should_block == ShouldBlock::Yes)
+                continue;
+            if (nwritten_or_error.error().code() == EPIPE)
+                Thread::current()->send_signal(SIGPIPE, &Process::current());
+            if (total_nwritten > 0)
+                return total_nwritten;
+            return nwritten_or_error.release_error();
+        }
+        total_nwritten += nwritten_or_error.value();
+    }
+    return total_nwritten;
+}
+
+ErrorOr<FlatPtr> Process::do_splice(OpenFileDescription& from, Optional<off_t> from_offset, OpenFileDescription& to, Optional<off_t> to_offset, size_t count, bool nonblocking)
+{
+    if (count == 0)
+        return 0;
+
+    // NOTE: Neither sockets nor pipes can hold on to the pages we hand them, so the data is always copied into their
+    //       buffers. What we avoid is copying it anywhere else on the way:
+    //       - File data is written straight out of the page cache pages that hold it.
+    //       - Pipe data is written straight out of the pipe's buffer, and only what the output took is removed from it.
+    //       - Everything else goes through a splice buffer, and is only read as far as the output can take it.
+    bool from_page_cache = from.file().is_inode() && static_cast<InodeFile&>(from.file()).can_read_through_page_cache(from);
+    // We can't hold on to the lock of one pipe while writing into another, as someone might be splicing the other way.
+    bool from_pipe_buffer = from.is_fifo() && !to.is_fifo();
+    // Reads from a seekable file can be undone if the output doesn't take all of the data.
+    bool can_put_back_input = from.file().is_seekable();
+
+    OwnPtr<KBuffer> chunk;
+    ScopeGuard give_back_chunk = [&] {
+        if (chunk)
+            give_back_splice_buffer(chunk.release_nonnull());
+    };
+    if (!from_page_cache && !from_pipe_buffer)
+        chunk = TRY(take_splice_buffer());
+
+    auto should_block = nonblocking ? ShouldBlock::No : ShouldBlock::Yes;
+    size_t total_transferred = 0;
+    while (total_transferred < count) {
+        // Only wait for input and output before anything was transferred, just like read() and write().
+        if (!from.can_read()) {
+            if (total_transferred > 0)
+                break;
+            if (nonblocking || !from.is_blocking())
+                return EAGAIN;
+            auto unblock_flags = BlockFlags::None;
+            if (Thread::current()->block<Thread::ReadBlocker>({}, from, unblock_flags).was_interrupted())
+                return EINTR;
+            continue;
+        }
+        if (!to.can_write()) {
+            if (total_transferred > 0)
+                break;
+            if (nonblocking || !to.is_blocking())
+                return EAGAIN;
+            auto unblock_flags = BlockFlags::None;
+            if (Thread::current()->block<Thread::WriteBlocker>({}, to, unblock_flags).was_interrupted())
+                return EINTR;
+            continue;
+        }
+
+        auto chunk_size = min(count - total_transferred, splice_chunk_size);
+        auto input_offset = from_offset.has_value() ? from_offset.value() + total_transferred : Optional<off_t> {};
+        auto output_offset = to_offset.has_value() ? to_offset.value() + total_transferred : Optional<off_t> {};
+        auto transfer_chunk = [&]() -> ErrorOr<size_t> {
+            if (from_page_cache) {
+                auto ntransferred = TRY(static_cast<InodeFile&>(from.file()).read_through_page_cache(from, input_offset.value_or(from.offset()), chunk_size, [&](UserOrKernelBuffer const& data, size_t size) -> ErrorOr<size_t> {
+                    return TRY(do_write(to, data, size, output_offset, should_block));
+                }));
+                if (!input_offset.has_value())
+                    TRY(from.seek(ntransferred, SEEK_CUR));
+                return ntransferred;
+            }
+
+            if (from_pipe_buffer) {
+                // NOTE: We're holding on to the pipe while writing, so we must not wait for the output here.
+                return static_cast<FIFO&>(from.file()).read_with(from, chunk_size, [&](UserOrKernelBuffer const& data, size_t size) -> ErrorOr<size_t> {
+                    return TRY(do_write(to, data, size, output_offset, ShouldBlock::No));
+                });
+            }
+
+            if (!can_put_back_input && to.is_fifo()) {
+                if (auto space = static_cast<FIFO&>(to.file()).space_for_writing(); space > 0)
+                    chunk_size = min(chunk_size, space);
+            }
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(chunk->data());
+            auto nread = TRY(input_offset.has_value()
+                    ? from.read(buffer, input_offset.value(), chunk_size)
+                    : from.read(buffer, chunk_size));
+            if (nread == 0)
+                return 0;
+            ErrorOr<size_t> nwritten_or_error = can_put_back_input
+                ? do_write(to, buffer, nread, output_offset, should_block)
+                : write_fully(to, buffer, nread, output_offset, should_block);
+            auto nwritten = nwritten_or_error.is_error() ? 0 : nwritten_or_error.value();
+            if (can_put_back_input && !input_offset.has_value() && nwritten < nread)
+                TRY(from.seek(-static_cast<off_t>(nread - nwritten), SEEK_CUR));
+            return nwritten_or_error;
+        };
+        auto ntransferred_or_error = transfer_chunk();
+
+        if (ntransferred_or_error.is_error()) {
+            // Someone else got to the output before us, so we have to wait for it again.
+            if (ntransferred_or_error.error().code() == EAGAIN && !nonblocking && to.is_blocking() && total_transferred == 0)
+                continue;
+            if (total_transferred > 0)
+                break;
+            return ntransferred_or_error.release_error();
+        }
+
+        auto ntransferred = ntransferred_or_error.release_value();
+        total_transferred += ntransferred;
+        if (ntransferred < chunk_size)
+            break;
+    }
+    return total_transferred;
+}
+
+ErrorOr<FlatPtr> Process::sys$sendfile(int out_fd, int in_fd, Userspace<off_t*> user_in_offset, size_t count)
+{
+    VERIFY_PROCESS_BIG_LOCK_ACQUIRED(this);
+    TRY(require_promise(Pledge::stdio));
+
+    if (count > NumericLimits<ssize_t>::max())
+        return EINVAL;
+
+    auto in_description = TRY(open_file_description(in_fd));
+    if (!in_description->is_readable())
+        return EBADF;
+    if (in_description->is_directory())
+        return EISDIR;
+    // The input has to be a file, use splice() to move data out of pipes and sockets.
+    if (!in_description->file().is_seekable())
+        return EINVAL;
+
+    auto out_description = TRY(open_file_description(out_fd));
+    if (!out_description->is_writable())
+        return EBADF;
+
+    // With an explicit offset, the file offset of the input stays where it is.
+    Optional<off_t> in_offset;
+    if (user_in_offset) {
+        in_offset = TRY(copy_typed_from_user(user_in_offset));
+        if (in_offset.value() < 0)
+            return EINVAL;
+    }
+
+    auto ntransferred = TRY(do_splice(*in_description, in_offset, *out_description, {}, count, false));
+    if (in_offset.has_value()) {
+        off_t new_offset = in_offset.value() + ntransferred;
+        TRY(copy_to_user(user_in_offset, &new_offset));
+    }
+    return ntransferred;
+}
+
+ErrorOr<FlatPtr> Process::sys$splice(Userspace<Syscall::SC_splice_params const*> user_params)
+{
+    VERIFY_PROCESS_BIG_LOCK_ACQUIRED(this);
+    TRY(require_promise(Pledge::stdio));
+
+    auto params = TRY(copy_typed_from_user(user_params));
+    if (params.flags & ~(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE))
+        return EINVAL;
+    if (params.length > NumericLimits<ssize_t>::max())
+        return EINVAL;
+
+    auto in_description = TRY(open_file_description(params.in_fd));
+    if (!in_description->is_readable())
+        return EBADF;
+    if (in_description->is_directory())
+        return EISDIR;
+    auto out_description = TRY(open_file_description(params.out_fd));
+    if (!out_description->is_writable())
+        return EBADF;
+
+    // At least one end has to be a pipe, sendfile() covers the file to socket case.
+    if (!in_description->is_fifo() && !out_description->is_fifo())
+        return EINVAL;
+    if (in_description.ptr() == out_description.ptr())
+        return EINVAL;
+
+    auto copy_offset_from_user = [](OpenFileDescription& description, off_t* user_offset) -> ErrorOr<Optional<off_t>> {
+        if (!user_offset)
+            return Optional<off_t> {};
+        if (!description.file().is_seekable())
+            return ESPIPE;
+        off_t offset;
+        TRY(copy_from_user(&offset, user_offset));
+        if (offset < 0)
+            return EINVAL;
+        return offset;
+    };
+    auto in_offset = TRY(copy_offset_from_user(*in_description, params.in_offset));
+    auto out_offset = TRY(copy_offset_from_user(*out_description, params.out_offset));
+
+    // NOTE: SPLICE_F_MOVE and SPLICE_F_MORE are only hints, so they are accepted and ignored.
+    auto ntransferred = TRY(do_splice(*in_description, in_offset, *out_description, out_offset, params.length, params.flags & SPLICE_F_NONBLOCK));
+
+    if (in_offset.has_value()) {
+        off_t new_offset = in_offset.value() + ntransferred;
+        TRY(copy_to_user(params.in_offset, &new_offset));
+    }
+    if (out_offset.has_value()) {
+        off_t new_offset = out_offset.value() + ntransferred;
+        TRY(copy_to_user(params.out_offset, &new_offset));
+    }
+    return ntransferred;
+}
+
+}
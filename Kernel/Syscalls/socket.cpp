@@ -8,6 +8,7 @@
 #include <Kernel/FileSystem/OpenFileDescription.h>
 #include <Kernel/Net/LocalSocket.h>
 #include <Kernel/Tasks/Process.h>
+#include <Kernel/Time/TimeManagement.h>
 #include <Kernel/UnixTypes.h>
 
 namespace Kernel {
@@ -89,13 +90,14 @@ ErrorOr<FlatPtr> Process::sys$listen(int sockfd, int backlog)
 ErrorOr<FlatPtr> Process::sys$accept4(Userspace<Syscall::SC_accept4_params const*> user_params)
 {
     VERIFY_NO_PROCESS_BIG_LOCK(this);
-    TRY(require_promise(Pledge::accept));
     auto params = TRY(copy_typed_from_user(user_params));
+    return accept_impl(params.sockfd, Userspace<sockaddr*>((FlatPtr)params.addr), Userspace<socklen_t*>((FlatPtr)params.addrlen), params.flags);
+}
 
-    int accepting_socket_fd = params.sockfd;
-    Userspace<sockaddr*> user_address((FlatPtr)params.addr);
-    Userspace<socklen_t*> user_address_size((FlatPtr)params.addrlen);
-    int flags = params.flags;
+ErrorOr<FlatPtr> Process::accept_impl(int accepting_socket_fd, Userspace<sockaddr*> user_address, Userspace<socklen_t*> user_address_size, int flags, ShouldBlock should_block)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::accept));
 
     socklen_t address_size = 0;
     if (user_address)
@@ -118,7 +120,7 @@ ErrorOr<FlatPtr> Process::sys$accept4(Userspace<Syscall::SC_accept4_params const
         accepted_socket = socket.accept();
         if (accepted_socket)
             break;
-        if (!accepting_socket_description->is_blocking())
+        if (!accepting_socket_description->is_blocking() || should_block == ShouldBlock::No)
             return EAGAIN;
         auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
         if (Thread::current()->block<Thread::AcceptBlocker>({}, *accepting_socket_description, unblock_flags).was_interrupted())
@@ -334,6 +336,187 @@ ErrorOr<FlatPtr> Process::sys$recvmsg(int sockfd, Userspace<struct msghdr*> user
     return result.value();
 }
 
+// Like Linux, we handle at most as many messages per sendmmsg() or recvmmsg() call as there may be iovecs.
+static constexpr unsigned max_messages_per_call = IOV_MAX;
+
+static ErrorOr<iovec> copy_single_iovec_from_user(struct msghdr const& msg)
+{
+    if (msg.msg_iovlen != 1)
+        return ENOTSUP; // FIXME: Support this :)
+    iovec iov;
+    TRY(copy_from_user(&iov, msg.msg_iov));
+    if (iov.iov_len > NumericLimits<ssize_t>::max())
+        return EINVAL;
+    return iov;
+}
+
+ErrorOr<FlatPtr> Process::sys$sendmmsg(int sockfd, Userspace<struct mmsghdr*> user_msgvec, unsigned vlen, int flags)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::stdio));
+
+    vlen = min(vlen, max_messages_per_call);
+    if (vlen == 0)
+        return 0;
+
+    auto description = TRY(open_file_description(sockfd));
+    if (!description->is_socket())
+        return ENOTSOCK;
+
+    auto& socket = *description->socket();
+    if (socket.is_shut_down_for_writing()) {
+        if ((flags & MSG_NOSIGNAL) == 0)
+            Thread::current()->send_signal(SIGPIPE, &Process::current());
+        return EPIPE;
+    }
+
+    Vector<struct mmsghdr> messages;
+    TRY(messages.try_resize(vlen));
+    TRY(copy_n_from_user(messages.data(), user_msgvec.unsafe_userspace_ptr(), vlen));
+
+    Vector<Socket::BatchedSend> sends;
+    TRY(sends.try_ensure_capacity(vlen));
+    for (auto const& message : messages) {
+        // Control messages, and with them passing file descriptors, are only supported by sendmsg().
+        if (message.msg_hdr.msg_controllen > 0)
+            return ENOTSUP;
+        auto iov = TRY(copy_single_iovec_from_user(message.msg_hdr));
+        sends.unchecked_append({
+            .data = TRY(UserOrKernelBuffer::for_user_buffer((u8*)iov.iov_base, iov.iov_len)),
+            .data_length = iov.iov_len,
+            .address = Userspace<sockaddr const*>((FlatPtr)message.msg_hdr.msg_name),
+            .address_length = message.msg_hdr.msg_namelen,
+        });
+    }
+
+    while (!description->can_write()) {
+        if (!description->is_blocking())
+            return EAGAIN;
+
+        auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+        if (Thread::current()->block<Thread::WriteBlocker>({}, *description, unblock_flags).was_interrupted())
+            return EINTR;
+    }
+
+    auto count_or_error = socket.sendto_batch(*description, sends, flags);
+    if (count_or_error.is_error()) {
+        if ((flags & MSG_NOSIGNAL) == 0 && count_or_error.error().code() == EPIPE)
+            Thread::current()->send_signal(SIGPIPE, &Process::current());
+        return count_or_error.release_error();
+    }
+
+    auto count = count_or_error.release_value();
+    for (size_t i = 0; i < count; ++i) {
+        unsigned msg_len = sends[i].nsent;
+        TRY(copy_to_user(&user_msgvec.unsafe_userspace_ptr()[i].msg_len, &msg_len));
+    }
+    return count;
+}
+
+ErrorOr<FlatPtr> Process::sys$recvmmsg(Userspace<Syscall::SC_recvmmsg_params const*> user_params)
+{
+    VERIFY_NO_PROCESS_BIG_LOCK(this);
+    TRY(require_promise(Pledge::stdio));
+    auto params = TRY(copy_typed_from_user(user_params));
+
+    auto vlen = min(params.vlen, max_messages_per_call);
+    if (vlen == 0)
+        return 0;
+    Userspace<struct mmsghdr*> user_msgvec((FlatPtr)params.msgvec);
+
+    Optional<MonotonicTime> deadline;
+    if (params.timeout) {
+        auto timeout = TRY(copy_time_from_user(params.timeout));
+        deadline = TimeManagement::the().monotonic_time() + timeout;
+    }
+
+    auto description = TRY(open_file_description(params.sockfd));
+    if (!description->is_socket())
+        return ENOTSOCK;
+    auto& socket = *description->socket();
+
+    if (socket.is_shut_down_for_reading())
+        return 0;
+
+    Vector<struct mmsghdr> messages;
+    TRY(messages.try_resize(vlen));
+    TRY(copy_n_from_user(messages.data(), user_msgvec.unsafe_userspace_ptr(), vlen));
+
+    Vector<Socket::BatchedReceive> receives;
+    TRY(receives.try_ensure_capacity(vlen));
+    for (size_t i = 0; i < vlen; ++i) {
+        auto const& msg = messages[i].msg_hdr;
+        auto iov = TRY(copy_single_iovec_from_user(msg));
+        receives.unchecked_append({
+            .buffer = TRY(UserOrKernelBuffer::for_user_buffer((u8*)iov.iov_base, iov.iov_len)),
+            .buffer_length = iov.iov_len,
+            .address = Userspace<sockaddr*>((FlatPtr)msg.msg_name),
+            .address_length = Userspace<socklen_t*>(msg.msg_name ? (FlatPtr)&user_msgvec.unsafe_userspace_ptr()[i].msg_hdr.msg_namelen : 0),
+        });
+    }
+
+    auto complete_message = [&](size_t index) -> ErrorOr<void> {
+        auto const& msg = messages[index].msg_hdr;
+        auto const& receive = receives[index];
+        auto* user_msg = &user_msgvec.unsafe_userspace_ptr()[index];
+
+        int msg_flags = 0;
+        if (receive.nreceived > receive.buffer_length) {
+            VERIFY(socket.type() != SOCK_STREAM);
+            msg_flags |= MSG_TRUNC;
+        }
+
+        socklen_t cmsg_len = 0;
+        if (socket.wants_timestamp()) {
+            if (msg.msg_controllen >= CMSG_SPACE(sizeof(timeval))) {
+                timeval time = receive.timestamp.to_timeval();
+                cmsghdr cmsg = { (socklen_t)CMSG_LEN(sizeof(time)), SOL_SOCKET, SCM_TIMESTAMP };
+                auto* target = (cmsghdr*)msg.msg_control;
+                TRY(copy_to_user(target, &cmsg));
+                TRY(copy_to_user(CMSG_DATA(target), &time, sizeof(time)));
+                cmsg_len = CMSG_ALIGN(cmsg.cmsg_len);
+            } else {
+                msg_flags |= MSG_CTRUNC;
+            }
+        }
+
+        unsigned msg_len = receive.nreceived;
+        TRY(copy_to_user(&user_msg->msg_hdr.msg_controllen, &cmsg_len));
+        TRY(copy_to_user(&user_msg->msg_hdr.msg_flags, &msg_flags));
+        TRY(copy_to_user(&user_msg->msg_len, &msg_len));
+        return {};
+    };
+
+    bool blocking = (params.flags & MSG_DONTWAIT) ? false : description->is_blocking();
+    size_t count = 0;
+    while (count < vlen) {
+        auto batch = receives.span().slice(count);
+        auto received_or_error = socket.recvfrom_batch(*description, batch, params.flags, blocking);
+        if (received_or_error.is_error()) {
+            if (count == 0)
+                return received_or_error.release_error();
+            break;
+        }
+
+        auto received = received_or_error.release_value();
+        for (size_t i = count; i < count + received; ++i)
+            TRY(complete_message(i));
+        count += received;
+        if (received == 0)
+            break;
+
+        if (params.flags & MSG_WAITFORONE)
+            blocking = false;
+        // NOTE: As on Linux, the timeout is only checked after something was received, it doesn't limit how long we wait.
+        if (deadline.has_value() && TimeManagement::the().monotonic_time() >= deadline.value())
+            break;
+        // Whatever was queued has been taken, and we don't want to wait for more.
+        if (!blocking && received < batch.size())
+            break;
+    }
+    return count;
+}
+
 template<Process::SockOrPeerName sock_or_peer_name, typename Params>
 ErrorOr<void> Process::get_sock_or_peer_name(Params const& params)
 {
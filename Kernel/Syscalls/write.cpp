@@ -55,7 +55,7 @@ ErrorOr<FlatPtr> Process::sys$pwritev(int fd, Userspace<const struct iovec*> iov
     return nwritten;
 }
 
-ErrorOr<FlatPtr> Process::do_write(OpenFileDescription& description, UserOrKernelBuffer const& data, size_t data_size, Optional<off_t> offset)
+ErrorOr<FlatPtr> Process::do_write(OpenFileDescription& description, UserOrKernelBuffer const& data, size_t data_size, Optional<off_t> offset, ShouldBlock should_block)
 {
     size_t total_nwritten = 0;
 
@@ -65,7 +65,7 @@ ErrorOr<FlatPtr> Process::do_write(OpenFileDescription& description, UserOrKerne
 
     while (total_nwritten < data_size) {
         while (!description.can_write()) {
-            if (!description.is_blocking()) {
+            if (!description.is_blocking() || should_block == ShouldBlock::No) {
                 if (total_nwritten > 0)
                     return total_nwritten;
                 return EAGAIN;
@@ -5,10 +5,9 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <AK/JsonArraySerializer.h>
-#include <AK/JsonObjectSerializer.h>
 #include <AK/ScopeGuard.h>
 #include <AK/StackUnwinder.h>
+#include <Kernel/API/Perfcore.h>
 #include <Kernel/Arch/RegisterState.h>
 #include <Kernel/Arch/SafeMem.h>
 #include <Kernel/FileSystem/Custody.h>
@@ -19,8 +18,8 @@
 
 namespace Kernel {
 
-PerformanceEventBuffer::PerformanceEventBuffer(NonnullOwnPtr<KBuffer> buffer)
-    : m_buffer(move(buffer))
+PerformanceEventBuffer::PerformanceEventBuffer(Vector<NonnullOwnPtr<Ring>> rings)
+    : m_rings(move(rings))
 {
 }
 
@@ -84,9 +83,6 @@ ErrorOr<void> PerformanceEventBuffer::append_with_ip_and_bp(ProcessID pid, Threa
 ErrorOr<void> PerformanceEventBuffer::append_with_ip_and_bp(ProcessID pid, ThreadID tid,
     FlatPtr ip, FlatPtr bp, int type, u32 lost_samples, FlatPtr arg1, FlatPtr arg2, StringView arg3, FilesystemEvent filesystem_event)
 {
-    if (count() >= capacity())
-        return ENOBUFS;
-
     if ((g_profiling_event_mask & type) == 0)
         return EINVAL;
 
@@ -181,196 +177,317 @@ ErrorOr<void> PerformanceEventBuffer::append_with_ip_and_bp(ProcessID pid, Threa
 
     event.pid = pid.value();
     event.tid = tid.value();
-    event.timestamp = TimeManagement::the().uptime_ms();
-    at(m_count++) = event;
-    return {};
+    event.timestamp = TimeManagement::the().monotonic_time(TimePrecision::Precise).nanoseconds();
+    return append_to_ring(event);
 }
 
-PerformanceEvent& PerformanceEventBuffer::at(size_t index)
+ErrorOr<void> PerformanceEventBuffer::append_to_ring(PerformanceEvent const& event)
 {
-    VERIFY(index < capacity());
-    auto* events = reinterpret_cast<PerformanceEvent*>(m_buffer->data());
-    return events[index];
+    // NOTE: We may be moved to another processor at any point, which is fine, as the rings are only an optimization.
+    auto& ring = *m_rings[m_rings.size() == 1 ? 0 : Processor::current_id() % m_rings.size()];
+    SpinlockLocker locker(ring.lock);
+    if (ring.tail - ring.head >= ring.capacity) {
+        ++ring.lost_event_count;
+        return ENOBUFS;
+    }
+    ring.at(ring.tail++) = event;
+    return {};
 }
 
-template<typename Serializer>
-ErrorOr<void> PerformanceEventBuffer::to_json_impl(Serializer& object) const
+void PerformanceEventBuffer::clear()
 {
-    {
-        auto strings_object = TRY(object.add_array("strings"sv));
-        Vector<KString*> strings_sorted_by_index;
-
-        TRY(m_strings.with([&](auto& strings) -> ErrorOr<void> {
-            TRY(strings_sorted_by_index.try_resize(strings.size()));
+    for (auto& ring : m_rings) {
+        SpinlockLocker locker(ring->lock);
+        ring->head = ring->tail;
+        ring->lost_event_count = 0;
+    }
+}
 
-            for (auto& entry : strings) {
-                strings_sorted_by_index[entry.value] = const_cast<Kernel::KString*>(entry.key.ptr());
-            }
+template<typename Callback>
+void PerformanceEventBuffer::for_each_event_in_order(Span<u64> positions, ReadonlySpan<u64> ends, Callback callback) const
+{
+    VERIFY(positions.size() == m_rings.size() && ends.size() == m_rings.size());
 
-            for (size_t i = 0; i < strings.size(); i++) {
-                TRY(strings_object.add(strings_sorted_by_index[i]->view()));
+    // NOTE: We copy each event out while holding the lock of its ring, as it might be taken out of the ring
+    //       (and overwritten by a new one) at any point after that.
+    PerformanceEvent event;
+    while (true) {
+        Optional<size_t> next_ring_index;
+        u64 next_timestamp = 0;
+        for (size_t i = 0; i < m_rings.size(); ++i) {
+            auto& ring = *m_rings[i];
+            SpinlockLocker locker(ring.lock);
+            // Someone else may have taken events out of the ring in the meantime.
+            positions[i] = max(positions[i], ring.head);
+            if (positions[i] >= min(ends[i], ring.tail))
+                continue;
+            auto timestamp = ring.at(positions[i]).timestamp;
+            if (!next_ring_index.has_value() || timestamp < next_timestamp) {
+                next_ring_index = i;
+                next_timestamp = timestamp;
             }
-
-            return {};
-        }));
-
-        TRY(strings_object.finish());
+        }
+        if (!next_ring_index.has_value())
+            return;
+
+        auto& ring = *m_rings[*next_ring_index];
+        auto& position = positions[*next_ring_index];
+        {
+            SpinlockLocker locker(ring.lock);
+            if (position < ring.head)
+                continue;
+            event = ring.at(position);
+        }
+        if (callback(event, *next_ring_index) == IterationDecision::Break)
+            return;
+        ++position;
     }
+}
 
-    auto current_process_credentials = Process::current().credentials();
-    bool show_kernel_addresses = current_process_credentials->is_superuser();
-    auto array = TRY(object.add_array("events"sv));
-    bool seen_first_sample = false;
-    for (size_t i = 0; i < m_count; ++i) {
-        auto const& event = at(i);
+template<typename T>
+static void append_record_data(Bytes record, size_t& offset, T const& data)
+{
+    memcpy(record.offset_pointer(offset), &data, sizeof(data));
+    offset += sizeof(data);
+}
 
-        if (!show_kernel_addresses) {
-            if (event.type == PERF_EVENT_KMALLOC || event.type == PERF_EVENT_KFREE)
-                continue;
-        }
+static void append_record_string(Bytes record, size_t& offset, char const* characters, size_t max_length)
+{
+    auto length = strnlen(characters, max_length);
+    memcpy(record.offset_pointer(offset), characters, length);
+    offset += length;
+}
 
-        auto event_object = TRY(array.add_object());
-        switch (event.type) {
-        case PERF_EVENT_SAMPLE:
-            TRY(event_object.add("type"sv, "sample"));
-            break;
-        case PERF_EVENT_MALLOC:
-            TRY(event_object.add("type"sv, "malloc"));
-            TRY(event_object.add("ptr"sv, static_cast<u64>(event.data.malloc.ptr)));
-            TRY(event_object.add("size"sv, static_cast<u64>(event.data.malloc.size)));
-            break;
-        case PERF_EVENT_FREE:
-            TRY(event_object.add("type"sv, "free"));
-            TRY(event_object.add("ptr"sv, static_cast<u64>(event.data.free.ptr)));
-            break;
-        case PERF_EVENT_MMAP:
-            TRY(event_object.add("type"sv, "mmap"));
-            TRY(event_object.add("ptr"sv, static_cast<u64>(event.data.mmap.ptr)));
-            TRY(event_object.add("size"sv, static_cast<u64>(event.data.mmap.size)));
-            TRY(event_object.add("name"sv, event.data.mmap.name));
-            break;
-        case PERF_EVENT_MUNMAP:
-            TRY(event_object.add("type"sv, "munmap"));
-            TRY(event_object.add("ptr"sv, static_cast<u64>(event.data.munmap.ptr)));
-            TRY(event_object.add("size"sv, static_cast<u64>(event.data.munmap.size)));
-            break;
-        case PERF_EVENT_PROCESS_CREATE:
-            TRY(event_object.add("type"sv, "process_create"));
-            TRY(event_object.add("parent_pid"sv, static_cast<u64>(event.data.process_create.parent_pid)));
-            TRY(event_object.add("executable"sv, event.data.process_create.executable));
-            break;
-        case PERF_EVENT_PROCESS_EXEC:
-            TRY(event_object.add("type"sv, "process_exec"));
-            TRY(event_object.add("executable"sv, event.data.process_exec.executable));
-            break;
-        case PERF_EVENT_PROCESS_EXIT:
-            TRY(event_object.add("type"sv, "process_exit"));
-            break;
-        case PERF_EVENT_THREAD_CREATE:
-            TRY(event_object.add("type"sv, "thread_create"));
-            TRY(event_object.add("parent_tid"sv, static_cast<u64>(event.data.thread_create.parent_tid)));
-            break;
-        case PERF_EVENT_THREAD_EXIT:
-            TRY(event_object.add("type"sv, "thread_exit"));
-            break;
-        case PERF_EVENT_CONTEXT_SWITCH:
-            TRY(event_object.add("type"sv, "context_switch"));
-            TRY(event_object.add("next_pid"sv, static_cast<u64>(event.data.context_switch.next_pid)));
-            TRY(event_object.add("next_tid"sv, static_cast<u64>(event.data.context_switch.next_tid)));
-            break;
-        case PERF_EVENT_KMALLOC:
-            TRY(event_object.add("type"sv, "kmalloc"));
-            TRY(event_object.add("ptr"sv, static_cast<u64>(event.data.kmalloc.ptr)));
-            TRY(event_object.add("size"sv, static_cast<u64>(event.data.kmalloc.size)));
-            break;
-        case PERF_EVENT_KFREE:
-            TRY(event_object.add("type"sv, "kfree"));
-            TRY(event_object.add("ptr"sv, static_cast<u64>(event.data.kfree.ptr)));
-            TRY(event_object.add("size"sv, static_cast<u64>(event.data.kfree.size)));
+static ReadonlyBytes encode_event(PerformanceEvent const& event, bool show_kernel_addresses, Bytes record)
+{
+    PerfcoreEventRecord header {};
+    header.header.type = PerfcoreRecordType::Event;
+    header.type = event.type;
+    header.pid = event.pid;
+    header.tid = event.tid;
+    header.lost_samples = event.lost_samples;
+    header.timestamp = event.timestamp;
+    header.stack_size = event.stack_size;
+
+    size_t offset = sizeof(header);
+    switch (event.type) {
+    case PERF_EVENT_MALLOC:
+        append_record_data(record, offset, PerfcoreMemoryEventData { event.data.malloc.ptr, event.data.malloc.size });
+        break;
+    case PERF_EVENT_FREE:
+        append_record_data(record, offset, PerfcoreMemoryEventData { event.data.free.ptr, 0 });
+        break;
+    case PERF_EVENT_MMAP:
+        append_record_data(record, offset, PerfcoreMemoryEventData { event.data.mmap.ptr, event.data.mmap.size });
+        append_record_string(record, offset, event.data.mmap.name, sizeof(event.data.mmap.name));
+        break;
+    case PERF_EVENT_MUNMAP:
+        append_record_data(record, offset, PerfcoreMemoryEventData { event.data.munmap.ptr, event.data.munmap.size });
+        break;
+    case PERF_EVENT_PROCESS_CREATE:
+        append_record_data(record, offset, PerfcoreProcessCreateEventData { static_cast<u32>(event.data.process_create.parent_pid) });
+        append_record_string(record, offset, event.data.process_create.executable, sizeof(event.data.process_create.executable));
+        break;
+    case PERF_EVENT_PROCESS_EXEC:
+        append_record_string(record, offset, event.data.process_exec.executable, sizeof(event.data.process_exec.executable));
+        break;
+    case PERF_EVENT_THREAD_CREATE:
+        append_record_data(record, offset, PerfcoreThreadCreateEventData { static_cast<u32>(event.data.thread_create.parent_tid) });
+        break;
+    case PERF_EVENT_CONTEXT_SWITCH:
+        append_record_data(record, offset, PerfcoreContextSwitchEventData { static_cast<u32>(event.data.context_switch.next_pid), event.data.context_switch.next_tid });
+        break;
+    case PERF_EVENT_KMALLOC:
+        append_record_data(record, offset, PerfcoreMemoryEventData { event.data.kmalloc.ptr, event.data.kmalloc.size });
+        break;
+    case PERF_EVENT_KFREE:
+        append_record_data(record, offset, PerfcoreMemoryEventData { event.data.kfree.ptr, event.data.kfree.size });
+        break;
+    case PERF_EVENT_SIGNPOST:
+        append_record_data(record, offset, PerfcoreSignpostEventData { event.data.signpost.arg1, event.data.signpost.arg2 });
+        break;
+    case PERF_EVENT_FILESYSTEM: {
+        auto const& filesystem = event.data.filesystem;
+        PerfcoreFilesystemEventData data {};
+        data.duration_ns = filesystem.durationNs;
+        data.type = static_cast<PerfcoreFilesystemEventType>(filesystem.type);
+        switch (filesystem.type) {
+        case FilesystemEventType::Open:
+            data.fd = filesystem.data.open.dirfd;
+            data.filename_index = filesystem.data.open.filename_index;
+            data.options = filesystem.data.open.options;
+            data.mode = filesystem.data.open.mode;
             break;
-        case PERF_EVENT_PAGE_FAULT:
-            TRY(event_object.add("type"sv, "page_fault"));
+        case FilesystemEventType::Close:
+            data.fd = filesystem.data.close.fd;
+            data.filename_index = filesystem.data.close.filename_index;
             break;
-        case PERF_EVENT_SYSCALL:
-            TRY(event_object.add("type"sv, "syscall"));
+        case FilesystemEventType::Readv:
+            data.fd = filesystem.data.readv.fd;
+            data.filename_index = filesystem.data.readv.filename_index;
             break;
-        case PERF_EVENT_SIGNPOST:
-            TRY(event_object.add("type"sv, "signpost"sv));
-            TRY(event_object.add("arg1"sv, event.data.signpost.arg1));
-            TRY(event_object.add("arg2"sv, event.data.signpost.arg2));
+        case FilesystemEventType::Read:
+            data.fd = filesystem.data.read.fd;
+            data.filename_index = filesystem.data.read.filename_index;
             break;
-        case PERF_EVENT_FILESYSTEM:
-            TRY(event_object.add("type"sv, "filesystem"sv));
-            TRY(event_object.add("durationNs"sv, event.data.filesystem.durationNs));
-            switch (event.data.filesystem.type) {
-            case FilesystemEventType::Open: {
-                auto const& open = event.data.filesystem.data.open;
-                TRY(event_object.add("fs_event_type"sv, "open"sv));
-                TRY(event_object.add("dirfd"sv, open.dirfd));
-                TRY(event_object.add("filename_index"sv, open.filename_index));
-                TRY(event_object.add("options"sv, open.options));
-                TRY(event_object.add("mode"sv, open.mode));
-                break;
-            }
-            case FilesystemEventType::Close: {
-                auto const& close = event.data.filesystem.data.close;
-                TRY(event_object.add("fs_event_type"sv, "close"sv));
-                TRY(event_object.add("fd"sv, close.fd));
-                TRY(event_object.add("filename_index"sv, close.filename_index));
-                break;
-            }
-            case FilesystemEventType::Readv: {
-                auto const& readv = event.data.filesystem.data.readv;
-                TRY(event_object.add("fs_event_type"sv, "readv"sv));
-                TRY(event_object.add("fd"sv, readv.fd));
-                TRY(event_object.add("filename_index"sv, readv.filename_index));
-                break;
-            }
-            case FilesystemEventType::Read: {
-                auto const& read = event.data.filesystem.data.read;
-                TRY(event_object.add("fs_event_type"sv, "read"sv));
-                TRY(event_object.add("fd"sv, read.fd));
-                TRY(event_object.add("filename_index"sv, read.filename_index));
-                break;
-            }
-            case FilesystemEventType::Pread: {
-                auto const& pread = event.data.filesystem.data.pread;
-                TRY(event_object.add("fs_event_type"sv, "pread"sv));
-                TRY(event_object.add("fd"sv, pread.fd));
-                TRY(event_object.add("filename_index"sv, pread.filename_index));
-                TRY(event_object.add("buffer_ptr"sv, pread.buffer_ptr));
-                TRY(event_object.add("size"sv, pread.size));
-                TRY(event_object.add("offset"sv, pread.offset));
-                break;
-            }
-            }
+        case FilesystemEventType::Pread:
+            data.fd = filesystem.data.pread.fd;
+            data.filename_index = filesystem.data.pread.filename_index;
+            data.buffer_ptr = filesystem.data.pread.buffer_ptr;
+            data.size = filesystem.data.pread.size;
+            data.offset = filesystem.data.pread.offset;
             break;
         }
-        TRY(event_object.add("pid"sv, event.pid));
-        TRY(event_object.add("tid"sv, event.tid));
-        TRY(event_object.add("timestamp"sv, event.timestamp));
-        TRY(event_object.add("lost_samples"sv, seen_first_sample ? event.lost_samples : 0));
-        if (event.type == PERF_EVENT_SAMPLE)
-            seen_first_sample = true;
-        auto stack_array = TRY(event_object.add_array("stack"sv));
-        for (size_t j = 0; j < event.stack_size; ++j) {
-            auto address = event.stack[j];
-            if (!show_kernel_addresses && !Memory::is_user_address(VirtualAddress { address }))
-                address = 0xdeadc0de;
-            TRY(stack_array.add(address));
-        }
-        TRY(stack_array.finish());
-        TRY(event_object.finish());
+        append_record_data(record, offset, data);
+        break;
     }
-    TRY(array.finish());
-    TRY(object.finish());
-    return {};
+    default:
+        break;
+    }
+    header.data_size = offset - sizeof(header);
+
+    for (size_t i = 0; i < event.stack_size; ++i) {
+        u64 address = event.stack[i];
+        if (!show_kernel_addresses && !Memory::is_user_address(VirtualAddress { address }))
+            address = 0xdeadc0de;
+        append_record_data(record, offset, address);
+    }
+
+    header.header.size = offset;
+    memcpy(record.data(), &header, sizeof(header));
+    return record.trim(offset);
+}
+
+static ReadonlyBytes encode_string(u32 index, StringView string, Bytes record)
+{
+    // Strings that don't fit into a record are cut off, which is fine for the paths and signpost names they're used for.
+    auto length = min(string.length(), record.size() - sizeof(PerfcoreStringRecord));
+    PerfcoreStringRecord header {};
+    header.header.type = PerfcoreRecordType::String;
+    header.header.size = sizeof(header) + length;
+    header.index = index;
+    memcpy(record.data(), &header, sizeof(header));
+    memcpy(record.offset_pointer(sizeof(header)), string.characters_without_null_termination(), length);
+    return record.trim(header.header.size);
+}
+
+static ReadonlyBytes encode_lost_events(u64 count, Bytes record)
+{
+    PerfcoreLostEventsRecord lost_events {};
+    lost_events.header.type = PerfcoreRecordType::LostEvents;
+    lost_events.header.size = sizeof(lost_events);
+    lost_events.count = count;
+    memcpy(record.data(), &lost_events, sizeof(lost_events));
+    return record.trim(sizeof(lost_events));
 }
 
-ErrorOr<void> PerformanceEventBuffer::to_json(KBufferBuilder& builder) const
+static ReadonlyBytes encode_header(Bytes record)
 {
-    auto object = TRY(JsonObjectSerializer<>::try_create(builder));
-    return to_json_impl(object);
+    PerfcoreHeader header {};
+    memcpy(header.magic, PERFCORE_MAGIC, sizeof(header.magic));
+    header.version = PERFCORE_VERSION;
+    memcpy(record.data(), &header, sizeof(header));
+    return record.trim(sizeof(header));
+}
+
+static bool should_skip_event(PerformanceEvent const& event, bool show_kernel_addresses)
+{
+    return !show_kernel_addresses && (event.type == PERF_EVENT_KMALLOC || event.type == PERF_EVENT_KFREE);
+}
+
+ErrorOr<void> PerformanceEventBuffer::write_perfcore(KBufferBuilder& builder) const
+{
+    bool show_kernel_addresses = Process::current().credentials()->is_superuser();
+    Array<u8, max_record_size> record;
+
+    TRY(builder.append_bytes(encode_header(record)));
+
+    TRY(m_strings.with([&](auto& strings) -> ErrorOr<void> {
+        for (size_t i = 0; i < strings.strings.size(); ++i)
+            TRY(builder.append_bytes(encode_string(i, strings.strings[i]->view(), record)));
+        return {};
+    }));
+
+    Vector<u64, 32> positions;
+    Vector<u64, 32> ends;
+    TRY(positions.try_ensure_capacity(m_rings.size()));
+    TRY(ends.try_ensure_capacity(m_rings.size()));
+    u64 lost_event_count = 0;
+    for (auto& ring : m_rings) {
+        SpinlockLocker locker(ring->lock);
+        positions.unchecked_append(ring->head);
+        ends.unchecked_append(ring->tail);
+        lost_event_count += ring->lost_event_count;
+    }
+
+    if (lost_event_count > 0)
+        TRY(builder.append_bytes(encode_lost_events(lost_event_count, record)));
+
+    ErrorOr<void> result;
+    for_each_event_in_order(positions, ends, [&](PerformanceEvent const& event, size_t) {
+        if (should_skip_event(event, show_kernel_addresses))
+            return IterationDecision::Continue;
+        result = builder.append_bytes(encode_event(event, show_kernel_addresses, record));
+        return result.is_error() ? IterationDecision::Break : IterationDecision::Continue;
+    });
+    return result;
+}
+
+ErrorOr<size_t> PerformanceEventBuffer::drain(DrainState& state, Bytes buffer)
+{
+    VERIFY(buffer.size() >= max_record_size);
+
+    bool show_kernel_addresses = Process::current().credentials()->is_superuser();
+    Array<u8, max_record_size> record;
+    size_t offset = 0;
+    auto try_append = [&](ReadonlyBytes bytes) {
+        if (offset + bytes.size() > buffer.size())
+            return false;
+        buffer.overwrite(offset, bytes.data(), bytes.size());
+        offset += bytes.size();
+        return true;
+    };
+
+    if (!state.has_sent_header) {
+        VERIFY(try_append(encode_header(record)));
+        state.has_sent_header = true;
+    }
+
+    // Strings are always registered before the events that refer to them, so we don't have to worry about those
+    // events arriving first.
+    bool has_sent_all_strings = m_strings.with([&](auto& strings) {
+        for (; state.sent_string_count < strings.strings.size(); ++state.sent_string_count) {
+            if (!try_append(encode_string(state.sent_string_count, strings.strings[state.sent_string_count]->view(), record)))
+                return false;
+        }
+        return true;
+    });
+    if (!has_sent_all_strings)
+        return offset;
+
+    Vector<u64, 32> positions;
+    Vector<u64, 32> ends;
+    TRY(positions.try_ensure_capacity(m_rings.size()));
+    TRY(ends.try_ensure_capacity(m_rings.size()));
+    for (auto& ring : m_rings) {
+        SpinlockLocker locker(ring->lock);
+        if (ring->lost_event_count > 0 && try_append(encode_lost_events(ring->lost_event_count, record)))
+            ring->lost_event_count = 0;
+        positions.unchecked_append(ring->head);
+        ends.unchecked_append(ring->tail);
+    }
+
+    for_each_event_in_order(positions, ends, [&](PerformanceEvent const& event, size_t ring_index) {
+        if (!should_skip_event(event, show_kernel_addresses)) {
+            if (!try_append(encode_event(event, show_kernel_addresses, record)))
+                return IterationDecision::Break;
+        }
+        auto& ring = *m_rings[ring_index];
+        SpinlockLocker locker(ring.lock);
+        ring.head = max(ring.head, positions[ring_index] + 1);
+        return IterationDecision::Continue;
+    });
+    return offset;
 }
 
 OwnPtr<PerformanceEventBuffer> PerformanceEventBuffer::try_create_with_size(size_t buffer_size)
@@ -378,7 +495,27 @@ OwnPtr<PerformanceEventBuffer> PerformanceEventBuffer::try_create_with_size(size
     auto buffer_or_error = KBuffer::try_create_with_size("Performance events"sv, buffer_size, Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow);
     if (buffer_or_error.is_error())
         return {};
-    return adopt_own_if_nonnull(new (nothrow) PerformanceEventBuffer(buffer_or_error.release_value()));
+    auto ring = adopt_own_if_nonnull(new (nothrow) Ring(buffer_or_error.release_value()));
+    if (!ring)
+        return {};
+    Vector<NonnullOwnPtr<Ring>> rings;
+    if (rings.try_append(ring.release_nonnull()).is_error())
+        return {};
+    return adopt_own_if_nonnull(new (nothrow) PerformanceEventBuffer(move(rings)));
+}
+
+OwnPtr<PerformanceEventBuffer> PerformanceEventBuffer::try_create_per_processor(size_t buffer_size_per_processor)
+{
+    Vector<NonnullOwnPtr<Ring>> rings;
+    for (u32 i = 0; i < Processor::count(); ++i) {
+        auto buffer_or_error = KBuffer::try_create_with_size("Performance events"sv, buffer_size_per_processor, Memory::Region::Access::ReadWrite, AllocationStrategy::AllocateNow);
+        if (buffer_or_error.is_error())
+            return {};
+        auto ring = adopt_own_if_nonnull(new (nothrow) Ring(buffer_or_error.release_value()));
+        if (!ring || rings.try_append(ring.release_nonnull()).is_error())
+            return {};
+    }
+    return adopt_own_if_nonnull(new (nothrow) PerformanceEventBuffer(move(rings)));
 }
 
 ErrorOr<void> PerformanceEventBuffer::add_process(Process const& process, ProcessEventType event_type)
@@ -415,14 +552,17 @@ ErrorOr<void> PerformanceEventBuffer::add_process(Process const& process, Proces
 
 ErrorOr<FlatPtr> PerformanceEventBuffer::register_string(NonnullOwnPtr<KString> string)
 {
-    return m_strings.with([&](auto& m_strings) -> ErrorOr<FlatPtr> {
-        auto it = m_strings.find(string);
-        if (it != m_strings.end()) {
+    return m_strings.with([&](auto& strings) -> ErrorOr<FlatPtr> {
+        auto it = strings.indices.find(string);
+        if (it != strings.indices.end()) {
             return it->value;
         }
 
-        auto new_index = m_strings.size();
-        TRY(m_strings.try_set(move(string), move(new_index)));
+        auto new_index = strings.strings.size();
+        TRY(strings.strings.try_ensure_capacity(new_index + 1));
+        auto const* string_pointer = string.ptr();
+        TRY(strings.indices.try_set(move(string), move(new_index)));
+        strings.strings.unchecked_append(string_pointer);
         return new_index;
     });
 }
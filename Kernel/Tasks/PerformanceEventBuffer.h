@@ -8,7 +8,11 @@
 #pragma once
 
 #include <AK/Error.h>
+#include <AK/HashMap.h>
+#include <AK/Vector.h>
 #include <Kernel/Library/KBuffer.h>
+#include <Kernel/Locking/Spinlock.h>
+#include <Kernel/Locking/SpinlockProtected.h>
 
 namespace Kernel {
 
@@ -142,7 +146,7 @@ struct [[gnu::packed]] PerformanceEvent {
     u8 stack_size { 0 };
     u32 pid { 0 };
     u32 tid { 0 };
-    u64 timestamp;
+    u64 timestamp; // In nanoseconds
     u32 lost_samples;
     union {
         MallocPerformanceEvent malloc;
@@ -167,9 +171,13 @@ enum class ProcessEventType {
     Exec
 };
 
+// Events are kept in ring buffers, one for each processor if the buffer is shared by all processes. They can either be
+// written out all at once as a perfcore, or drained continuously while they're being recorded. Events that don't fit
+// into a full ring are dropped, but they're counted, and the perfcore says how many were lost.
 class PerformanceEventBuffer {
 public:
     static OwnPtr<PerformanceEventBuffer> try_create_with_size(size_t buffer_size);
+    static OwnPtr<PerformanceEventBuffer> try_create_per_processor(size_t buffer_size_per_processor);
 
     ErrorOr<void> append(int type, FlatPtr arg1, FlatPtr arg2, StringView arg3, Thread* current_thread = Thread::current(), FilesystemEvent filesystem_event = {});
     ErrorOr<void> append_with_ip_and_bp(ProcessID pid, ThreadID tid, FlatPtr eip, FlatPtr ebp,
@@ -177,36 +185,62 @@ public:
     ErrorOr<void> append_with_ip_and_bp(ProcessID pid, ThreadID tid, RegisterState const& regs,
         int type, u32 lost_samples, FlatPtr arg1, FlatPtr arg2, StringView arg3, FilesystemEvent filesystem_event = {});
 
-    void clear()
-    {
-        m_count = 0;
-    }
+    void clear();
 
-    size_t capacity() const { return m_buffer->size() / sizeof(PerformanceEvent); }
-    size_t count() const { return m_count; }
-    PerformanceEvent const& at(size_t index) const
-    {
-        return const_cast<PerformanceEventBuffer&>(*this).at(index);
-    }
+    // Writes everything that's in the buffer as a perfcore, leaving the buffer as it is.
+    ErrorOr<void> write_perfcore(KBufferBuilder&) const;
 
-    ErrorOr<void> to_json(KBufferBuilder&) const;
+    // What a reader that's draining the buffer has seen so far.
+    struct DrainState {
+        bool has_sent_header { false };
+        size_t sent_string_count { 0 };
+    };
+
+    // Moves as many perfcore records out of the buffer as fit, oldest events first, and returns how many bytes that took.
+    // The buffer has to be at least max_record_size bytes large.
+    ErrorOr<size_t> drain(DrainState&, Bytes);
+
+    static constexpr size_t max_record_size = 1 * KiB;
 
     ErrorOr<void> add_process(Process const&, ProcessEventType event_type);
 
     ErrorOr<FlatPtr> register_string(NonnullOwnPtr<KString>);
 
 private:
-    explicit PerformanceEventBuffer(NonnullOwnPtr<KBuffer>);
+    struct Ring {
+        explicit Ring(NonnullOwnPtr<KBuffer> buffer)
+            : buffer(move(buffer))
+            , capacity(this->buffer->size() / sizeof(PerformanceEvent))
+        {
+        }
+
+        PerformanceEvent& at(u64 index) { return reinterpret_cast<PerformanceEvent*>(buffer->data())[index % capacity]; }
+
+        NonnullOwnPtr<KBuffer> buffer;
+        size_t const capacity { 0 };
+        // Events are added at the tail and taken from the head. Both only ever grow.
+        u64 head { 0 };
+        u64 tail { 0 };
+        u64 lost_event_count { 0 };
+        Spinlock<LockRank::None> lock {};
+    };
+
+    struct StringTable {
+        HashMap<NonnullOwnPtr<KString>, size_t> indices;
+        Vector<KString const*> strings;
+    };
+
+    explicit PerformanceEventBuffer(Vector<NonnullOwnPtr<Ring>>);
 
-    template<typename Serializer>
-    ErrorOr<void> to_json_impl(Serializer&) const;
+    ErrorOr<void> append_to_ring(PerformanceEvent const&);
 
-    PerformanceEvent& at(size_t index);
+    // Calls the callback for the events in [positions[i], ends[i]) of each ring, ordered by their timestamps.
+    template<typename Callback>
+    void for_each_event_in_order(Span<u64> positions, ReadonlySpan<u64> ends, Callback) const;
 
-    size_t m_count { 0 };
-    NonnullOwnPtr<KBuffer> m_buffer;
+    Vector<NonnullOwnPtr<Ring>> m_rings;
 
-    RecursiveSpinlockProtected<HashMap<NonnullOwnPtr<KString>, size_t>, LockRank::None> m_strings;
+    RecursiveSpinlockProtected<StringTable, LockRank::None> m_strings;
 };
 
 extern bool g_profiling_all_threads;
@@ -261,7 +261,7 @@ ErrorOr<Process::ProcessAndFirstThread> Process::create_user_process(StringView
     return ProcessAndFirstThread { move(process), move(first_thread) };
 }
 
-ErrorOr<Process::ProcessAndFirstThread> Process::create_kernel_process(StringView name, void (*entry)(void*), void* entry_data, u32 affinity, RegisterProcess do_register)
+ErrorOr<Process::ProcessAndFirstThread> Process::create_kernel_process(StringView name, void (*entry)(void*), void* entry_data, u64 affinity, RegisterProcess do_register)
 {
     VERIFY(s_empty_kernel_hostname_context);
     auto process_and_first_thread = TRY(Process::create(name, UserID(0), GroupID(0), ProcessID(0), true, VFSRootContext::empty_context_for_kernel_processes(), *s_empty_kernel_hostname_context));
@@ -834,15 +834,15 @@ ErrorOr<void> Process::dump_perfcore()
     }
 
     auto builder = TRY(KBufferBuilder::try_create());
-    TRY(m_perf_event_buffer->to_json(builder));
+    TRY(m_perf_event_buffer->write_perfcore(builder));
 
-    auto json = builder.build();
-    if (!json) {
+    auto perfcore = builder.build();
+    if (!perfcore) {
         dbgln("Failed to generate perfcore for pid {}: Could not allocate buffer.", pid().value());
         return ENOMEM;
     }
-    auto json_buffer = UserOrKernelBuffer::for_kernel_buffer(json->data());
-    TRY(description->write(json_buffer, json->size()));
+    auto perfcore_buffer = UserOrKernelBuffer::for_kernel_buffer(perfcore->data());
+    TRY(description->write(perfcore_buffer, perfcore->size()));
 
     dbgln("Wrote perfcore for pid {} to {}", pid().value(), perfcore_filename);
     return {};
@@ -1046,7 +1046,7 @@ ErrorOr<void> Process::send_signal(u8 signal, Process* sender)
     return ESRCH;
 }
 
-ErrorOr<NonnullRefPtr<Thread>> Process::create_kernel_thread(void (*entry)(void*), void* entry_data, u32 priority, StringView name, u32 affinity, bool joinable)
+ErrorOr<NonnullRefPtr<Thread>> Process::create_kernel_thread(void (*entry)(void*), void* entry_data, u32 priority, StringView name, u64 affinity, bool joinable)
 {
     VERIFY((priority >= THREAD_PRIORITY_MIN) && (priority <= THREAD_PRIORITY_MAX));
 
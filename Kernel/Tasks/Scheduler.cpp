@@ -5,6 +5,8 @@
  */
 
 #include <AK/BuiltinWrappers.h>
+#include <AK/NumericLimits.h>
+#include <AK/Optional.h>
 #include <AK/ScopeGuard.h>
 #include <AK/Singleton.h>
 #include <AK/Time.h>
@@ -42,11 +44,68 @@ struct ThreadReadyQueue {
 
 struct ThreadReadyQueues {
     u32 mask {};
+    u32 runnable_count {};
     static constexpr size_t count = sizeof(mask) * 8;
     Array<ThreadReadyQueue, count> queues;
+
+    Thread* peek_first_runnable(u64 affinity_mask);
+    Thread* take_first_runnable(u64 affinity_mask);
+    void append(Thread&, u32 priority);
+    void remove(Thread&);
+};
+
+// Every processor owns a set of ready queues, so that picking the next thread
+// only has to look at threads that were placed on this processor. Idle
+// processors steal work from the other processors' queues, and busy ones
+// pull work over from each other on the timer tick.
+struct ProcessorReadyQueues {
+    // Besides taking the lock, this publishes the state of the queues so that
+    // other processors can look at it without having to lock them.
+    template<typename Callback>
+    decltype(auto) with_ready_queues(Callback callback)
+    {
+        return ready_queues.with([&](auto& queues) -> decltype(auto) {
+            ScopeGuard publish_state = [&] {
+                runnable_count.store(queues.runnable_count, AK::MemoryOrder::memory_order_relaxed);
+                queued_priorities.store(queues.mask, AK::MemoryOrder::memory_order_relaxed);
+            };
+            return callback(queues);
+        });
+    }
+
+    // Returns the index of the highest priority bucket with a thread in it,
+    // or ThreadReadyQueues::count if there is none.
+    u32 highest_queued_priority() const
+    {
+        auto priorities = queued_priorities.load(AK::MemoryOrder::memory_order_relaxed);
+        if (priorities == 0)
+            return ThreadReadyQueues::count;
+        return bit_scan_forward(priorities) - 1;
+    }
+
+    // The number of threads that want to run on this processor, including
+    // the one that's running right now.
+    u32 load() const
+    {
+        auto load = runnable_count.load(AK::MemoryOrder::memory_order_relaxed);
+        if (!is_idle.load(AK::MemoryOrder::memory_order_relaxed))
+            ++load;
+        return load;
+    }
+
+    RecursiveSpinlockProtected<ThreadReadyQueues, LockRank::None> ready_queues {};
+    Atomic<u32> runnable_count { 0 };
+    Atomic<u32> queued_priorities { 0 };
+    Atomic<bool> is_idle { true };
+    Atomic<u64> steals { 0 };
+    Atomic<u64> migrations { 0 };
+};
+
+struct AllProcessorReadyQueues {
+    Array<ProcessorReadyQueues, MAX_CPU_COUNT> processors;
 };
 
-static Singleton<RecursiveSpinlockProtected<ThreadReadyQueues, LockRank::None>> g_ready_queues;
+static Singleton<AllProcessorReadyQueues> g_ready_queues;
 
 static RecursiveSpinlockProtected<TotalTimeScheduled, LockRank::None> g_total_time_scheduled {};
 
@@ -55,7 +114,7 @@ static void dump_thread_list(bool = false);
 static inline u32 thread_priority_to_priority_index(u32 thread_priority)
 {
     // Converts the priority in the range of THREAD_PRIORITY_MIN...THREAD_PRIORITY_MAX
-    // to a index into g_ready_queues where 0 is the highest priority bucket
+    // to a index into a processor's ready queues where 0 is the highest priority bucket
     VERIFY(thread_priority >= THREAD_PRIORITY_MIN && thread_priority <= THREAD_PRIORITY_MAX);
     constexpr u32 thread_priority_count = THREAD_PRIORITY_MAX - THREAD_PRIORITY_MIN + 1;
     static_assert(thread_priority_count > 0);
@@ -64,73 +123,245 @@ static inline u32 thread_priority_to_priority_index(u32 thread_priority)
     return priority_bucket;
 }
 
-Thread& Scheduler::pull_next_runnable_thread()
+static inline ProcessorReadyQueues& ready_queues_for(u32 processor_id)
+{
+    VERIFY(processor_id < MAX_CPU_COUNT);
+    return g_ready_queues->processors[processor_id];
+}
+
+static inline u32 scheduler_processor_count()
+{
+    return clamp(Processor::count(), 1u, static_cast<u32>(MAX_CPU_COUNT));
+}
+
+static constexpr u64 processor_mask(u32 processor_id)
 {
-    auto affinity_mask = 1u << Processor::current_id();
-
-    return g_ready_queues->with([&](auto& ready_queues) -> Thread& {
-        auto priority_mask = ready_queues.mask;
-        while (priority_mask != 0) {
-            auto priority = bit_scan_forward(priority_mask);
-            VERIFY(priority > 0);
-            auto& ready_queue = ready_queues.queues[--priority];
-            for (auto& thread : ready_queue.thread_list) {
-                VERIFY(thread.m_runnable_priority == (int)priority);
-                if (thread.is_active())
-                    continue;
-                if (!(thread.affinity() & affinity_mask))
-                    continue;
-                thread.m_runnable_priority = -1;
-                ready_queue.thread_list.remove(thread);
-                if (ready_queue.thread_list.is_empty())
-                    ready_queues.mask &= ~(1u << priority);
-                // Mark it as active because we are using this thread. This is similar
-                // to comparing it with Processor::current_thread, but when there are
-                // multiple processors there's no easy way to check whether the thread
-                // is actually still needed. This prevents accidental finalization when
-                // a thread is no longer in Running state, but running on another core.
-
-                // We need to mark it active here so that this thread won't be
-                // scheduled on another core if it were to be queued before actually
-                // switching to it.
-                // FIXME: Figure out a better way maybe?
-                thread.set_active(true);
-                return thread;
-            }
-            priority_mask &= ~(1u << priority);
+    return 1ull << processor_id;
+}
+
+Thread* ThreadReadyQueues::peek_first_runnable(u64 affinity_mask)
+{
+    auto priority_mask = mask;
+    while (priority_mask != 0) {
+        auto priority = bit_scan_forward(priority_mask);
+        VERIFY(priority > 0);
+        auto& ready_queue = queues[--priority];
+        for (auto& thread : ready_queue.thread_list) {
+            VERIFY(thread.m_runnable_priority == (int)priority);
+            if (thread.is_active())
+                continue;
+            if (!(thread.affinity() & affinity_mask))
+                continue;
+            return &thread;
         }
+        priority_mask &= ~(1u << priority);
+    }
+    return nullptr;
+}
+
+Thread* ThreadReadyQueues::take_first_runnable(u64 affinity_mask)
+{
+    auto* thread = peek_first_runnable(affinity_mask);
+    if (!thread)
+        return nullptr;
+    remove(*thread);
+    // Mark it as active because we are using this thread. This is similar
+    // to comparing it with Processor::current_thread, but when there are
+    // multiple processors there's no easy way to check whether the thread
+    // is actually still needed. This prevents accidental finalization when
+    // a thread is no longer in Running state, but running on another core.
+
+    // We need to mark it active here so that this thread won't be
+    // scheduled on another core if it were to be queued before actually
+    // switching to it.
+    // FIXME: Figure out a better way maybe?
+    thread->set_active(true);
+    return thread;
+}
+
+void ThreadReadyQueues::append(Thread& thread, u32 priority)
+{
+    VERIFY(thread.m_runnable_priority < 0);
+    thread.m_runnable_priority = (int)priority;
+    VERIFY(!thread.m_ready_queue_node.is_in_list());
+    auto& ready_queue = queues[priority];
+    bool was_empty = ready_queue.thread_list.is_empty();
+    ready_queue.thread_list.append(thread);
+    ++runnable_count;
+    if (was_empty)
+        mask |= (1u << priority);
+}
+
+void ThreadReadyQueues::remove(Thread& thread)
+{
+    auto priority = thread.m_runnable_priority;
+    VERIFY(priority >= 0);
+    VERIFY(mask & (1u << priority));
+    auto& ready_queue = queues[priority];
+    thread.m_runnable_priority = -1;
+    ready_queue.thread_list.remove(thread);
+    VERIFY(runnable_count > 0);
+    --runnable_count;
+    if (ready_queue.thread_list.is_empty())
+        mask &= ~(1u << priority);
+}
 
-        auto* idle_thread = Processor::idle_thread();
-        idle_thread->set_active(true);
-        return *idle_thread;
+static Thread* steal_runnable_thread(u32 thief_id)
+{
+    auto affinity_mask = processor_mask(thief_id);
+    auto processor_count = scheduler_processor_count();
+
+    // Start with the next processor rather than always the first one, so that
+    // multiple idle processors don't all go after the same victim.
+    for (u32 i = 1; i < processor_count; ++i) {
+        auto victim_id = (thief_id + i) % processor_count;
+        auto& victim = ready_queues_for(victim_id);
+        if (victim.runnable_count.load(AK::MemoryOrder::memory_order_relaxed) == 0)
+            continue;
+
+        auto* thread = victim.with_ready_queues([&](auto& ready_queues) {
+            return ready_queues.take_first_runnable(affinity_mask);
+        });
+        if (!thread)
+            continue;
+
+        ready_queues_for(thief_id).steals.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+        dbgln_if(SCHEDULER_DEBUG, "Scheduler[{}]: Stole {} from processor {}", thief_id, *thread, victim_id);
+        return thread;
+    }
+    return nullptr;
+}
+
+// Idle processors steal work as soon as they run out of it, but a busy processor
+// only ever looks at its own queues. So whenever a time slice runs out, we check
+// whether another processor has a thread queued that should rather run here:
+// either because it's more important than anything we would run next, or because
+// that processor has noticeably more work to do than we do.
+void Scheduler::balance_ready_queues(u32 processor_id, Thread const& current_thread)
+{
+    VERIFY(g_scheduler_lock.is_locked_by_current_processor());
+    auto processor_count = scheduler_processor_count();
+    if (processor_count == 1)
+        return;
+
+    auto& local_queues = ready_queues_for(processor_id);
+    auto local_priority = local_queues.highest_queued_priority();
+    if (!current_thread.is_idle_thread())
+        local_priority = min(local_priority, thread_priority_to_priority_index(current_thread.priority()));
+    auto local_load = local_queues.load();
+
+    Optional<u32> victim_id;
+    bool victim_has_more_important_work = false;
+    u32 victim_load = 0;
+    for (u32 i = 1; i < processor_count; ++i) {
+        auto candidate_id = (processor_id + i) % processor_count;
+        auto& candidate = ready_queues_for(candidate_id);
+        if (candidate.highest_queued_priority() < local_priority) {
+            victim_id = candidate_id;
+            victim_has_more_important_work = true;
+            break;
+        }
+        // Only move work over if that actually makes things more even, rather than just swapping places.
+        auto load = candidate.load();
+        if (load > local_load + 1 && load > victim_load) {
+            victim_id = candidate_id;
+            victim_load = load;
+        }
+    }
+    if (!victim_id.has_value())
+        return;
+
+    auto& victim = ready_queues_for(*victim_id);
+    auto* thread = victim.with_ready_queues([&](auto& ready_queues) -> Thread* {
+        auto* thread = ready_queues.peek_first_runnable(processor_mask(processor_id));
+        if (!thread)
+            return nullptr;
+        if (victim_has_more_important_work && static_cast<u32>(thread->m_runnable_priority) >= local_priority)
+            return nullptr;
+        ready_queues.remove(*thread);
+        return thread;
+    });
+    if (!thread)
+        return;
+
+    auto priority = thread_priority_to_priority_index(thread->priority());
+    local_queues.with_ready_queues([&](auto& ready_queues) {
+        ready_queues.append(*thread, priority);
     });
+    thread->m_runnable_processor = processor_id;
+    local_queues.migrations.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+    dbgln_if(SCHEDULER_DEBUG, "Scheduler[{}]: Pulled {} over from processor {}", processor_id, *thread, *victim_id);
 }
 
-Thread* Scheduler::peek_next_runnable_thread()
+static u32 select_processor_for(Thread const& thread)
 {
-    auto affinity_mask = 1u << Processor::current_id();
-
-    return g_ready_queues->with([&](auto& ready_queues) -> Thread* {
-        auto priority_mask = ready_queues.mask;
-        while (priority_mask != 0) {
-            auto priority = bit_scan_forward(priority_mask);
-            VERIFY(priority > 0);
-            auto& ready_queue = ready_queues.queues[--priority];
-            for (auto& thread : ready_queue.thread_list) {
-                VERIFY(thread.m_runnable_priority == (int)priority);
-                if (thread.is_active())
-                    continue;
-                if (!(thread.affinity() & affinity_mask))
-                    continue;
-                return &thread;
-            }
-            priority_mask &= ~(1u << priority);
+    // Threads that don't fit any processor we know about (e.g. an AP that hasn't
+    // been brought up yet) go to the bootstrap processor and get stolen from there.
+    auto processor_count = scheduler_processor_count();
+    auto affinity = thread.affinity();
+
+    // Prefer the processor the thread last ran on to keep its caches warm, unless
+    // another allowed processor has noticeably less work to do.
+    constexpr u32 imbalance_threshold = 2;
+    Optional<u32> best_processor;
+    u32 best_load = NumericLimits<u32>::max();
+
+    auto last_processor = thread.cpu();
+    bool has_cache_affinity = thread.times_scheduled() > 0 && last_processor < processor_count && (affinity & processor_mask(last_processor));
+    if (has_cache_affinity) {
+        best_processor = last_processor;
+        best_load = ready_queues_for(last_processor).load();
+    }
+    auto required_improvement = has_cache_affinity ? imbalance_threshold : 1;
+
+    for (u32 processor_id = 0; processor_id < processor_count; ++processor_id) {
+        if (!(affinity & processor_mask(processor_id)))
+            continue;
+        auto load = ready_queues_for(processor_id).load();
+        if (!best_processor.has_value() || load + required_improvement <= best_load) {
+            best_processor = processor_id;
+            best_load = load;
         }
+    }
 
-        // Unlike in pull_next_runnable_thread() we don't want to fall back to
-        // the idle thread. We just want to see if we have any other thread ready
-        // to be scheduled.
-        return nullptr;
+    return best_processor.value_or(0);
+}
+
+Thread& Scheduler::pull_next_runnable_thread()
+{
+    auto current_id = Processor::current_id();
+    auto affinity_mask = processor_mask(current_id);
+
+    auto& local_queues = ready_queues_for(current_id);
+    auto* thread = local_queues.with_ready_queues([&](auto& ready_queues) {
+        return ready_queues.take_first_runnable(affinity_mask);
+    });
+
+    // Nothing to do locally, try to take over some work from another processor
+    // before falling back to the idle thread.
+    if (!thread)
+        thread = steal_runnable_thread(current_id);
+
+    local_queues.is_idle.store(!thread, AK::MemoryOrder::memory_order_relaxed);
+    if (thread)
+        return *thread;
+
+    auto* idle_thread = Processor::idle_thread();
+    idle_thread->set_active(true);
+    return *idle_thread;
+}
+
+Thread* Scheduler::peek_next_runnable_thread()
+{
+    auto current_id = Processor::current_id();
+    auto affinity_mask = processor_mask(current_id);
+
+    // Unlike in pull_next_runnable_thread() we don't want to fall back to
+    // the idle thread. We just want to see if we have any other thread ready
+    // to be scheduled on this processor. Threads queued on other processors
+    // are picked up by them, or pulled over by balance_ready_queues().
+    return ready_queues_for(current_id).ready_queues.with([&](auto& ready_queues) {
+        return ready_queues.peek_first_runnable(affinity_mask);
     });
 }
 
@@ -139,24 +370,18 @@ bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
     if (thread.is_idle_thread())
         return true;
 
-    return g_ready_queues->with([&](auto& ready_queues) {
-        auto priority = thread.m_runnable_priority;
-        if (priority < 0) {
-            VERIFY(!thread.m_ready_queue_node.is_in_list());
-            return false;
-        }
+    if (thread.m_runnable_priority < 0) {
+        VERIFY(!thread.m_ready_queue_node.is_in_list());
+        return false;
+    }
 
-        if (check_affinity && !(thread.affinity() & (1 << Processor::current_id())))
-            return false;
+    if (check_affinity && !(thread.affinity() & processor_mask(Processor::current_id())))
+        return false;
 
-        VERIFY(ready_queues.mask & (1u << priority));
-        auto& ready_queue = ready_queues.queues[priority];
-        thread.m_runnable_priority = -1;
-        ready_queue.thread_list.remove(thread);
-        if (ready_queue.thread_list.is_empty())
-            ready_queues.mask &= ~(1u << priority);
-        return true;
+    ready_queues_for(thread.m_runnable_processor).with_ready_queues([&](auto& ready_queues) {
+        ready_queues.remove(thread);
     });
+    return true;
 }
 
 void Scheduler::enqueue_runnable_thread(Thread& thread)
@@ -166,16 +391,21 @@ void Scheduler::enqueue_runnable_thread(Thread& thread)
         return;
     auto priority = thread_priority_to_priority_index(thread.priority());
 
-    g_ready_queues->with([&](auto& ready_queues) {
-        VERIFY(thread.m_runnable_priority < 0);
-        thread.m_runnable_priority = (int)priority;
-        VERIFY(!thread.m_ready_queue_node.is_in_list());
-        auto& ready_queue = ready_queues.queues[priority];
-        bool was_empty = ready_queue.thread_list.is_empty();
-        ready_queue.thread_list.append(thread);
-        if (was_empty)
-            ready_queues.mask |= (1u << priority);
+    auto processor_id = select_processor_for(thread);
+    auto& processor_queues = ready_queues_for(processor_id);
+    processor_queues.with_ready_queues([&](auto& ready_queues) {
+        ready_queues.append(thread, priority);
     });
+    thread.m_runnable_processor = processor_id;
+
+    if (thread.times_scheduled() > 0 && thread.cpu() != processor_id)
+        processor_queues.migrations.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+
+    // An idle processor would otherwise only notice the new thread on its next
+    // timer tick. If the thread was queued behind other work, give some other
+    // idle processor the chance to steal it instead.
+    if (!Processor::smp_wake_idle_processor(processor_id))
+        Processor::smp_wake_n_idle_processors(1);
 }
 
 UNMAP_AFTER_INIT void Scheduler::start()
@@ -195,7 +425,7 @@ UNMAP_AFTER_INIT void Scheduler::start()
     idle_thread.set_initialized(true);
     processor.init_context(idle_thread, false);
     idle_thread.set_state(Thread::State::Running);
-    VERIFY(idle_thread.affinity() == (1u << processor.id()));
+    VERIFY(idle_thread.affinity() == processor_mask(processor.id()));
     processor.initialize_context_switching(idle_thread);
     VERIFY_NOT_REACHED();
 }
@@ -399,7 +629,7 @@ UNMAP_AFTER_INIT Thread* Scheduler::create_ap_idle_thread(u32 cpu)
     VERIFY(Processor::is_bootstrap_processor());
 
     VERIFY(s_colonel_process);
-    Thread* idle_thread = MUST(s_colonel_process->create_kernel_thread(idle_loop, nullptr, THREAD_PRIORITY_MIN, MUST(KString::formatted("idle thread #{}", cpu))->view(), 1 << cpu, false));
+    Thread* idle_thread = MUST(s_colonel_process->create_kernel_thread(idle_loop, nullptr, THREAD_PRIORITY_MIN, MUST(KString::formatted("idle thread #{}", cpu))->view(), processor_mask(cpu), false));
     VERIFY(idle_thread);
     return idle_thread;
 }
@@ -440,10 +670,19 @@ void Scheduler::timer_tick()
         return;
     }
 
-    if (current_thread->tick())
+    // If the thread's affinity has changed so that it may no longer run here,
+    // it has to make room right away rather than at the end of its time slice.
+    auto current_id = Processor::current_id();
+    bool must_leave_processor = !current_thread->is_idle_thread() && !(current_thread->affinity() & processor_mask(current_id));
+    if (current_thread->tick() && !must_leave_processor)
         return;
 
-    if (!current_thread->is_idle_thread() && !peek_next_runnable_thread()) {
+    if (!current_thread->is_idle_thread()) {
+        SpinlockLocker scheduler_lock(g_scheduler_lock);
+        balance_ready_queues(current_id, *current_thread);
+    }
+
+    if (!must_leave_processor && !current_thread->is_idle_thread() && !peek_next_runnable_thread()) {
         // If no other thread is ready to be scheduled we don't need to
         // switch to the idle thread. Just give the current thread another
         // time slice and let it run!
@@ -507,6 +746,16 @@ TotalTimeScheduled Scheduler::get_total_time_scheduled()
     return g_total_time_scheduled.with([&](auto& total_time_scheduled) { return total_time_scheduled; });
 }
 
+SchedulerStatistics Scheduler::get_statistics()
+{
+    SchedulerStatistics statistics;
+    for (auto& processor_queues : g_ready_queues->processors) {
+        statistics.steals += processor_queues.steals.load(AK::MemoryOrder::memory_order_relaxed);
+        statistics.migrations += processor_queues.migrations.load(AK::MemoryOrder::memory_order_relaxed);
+    }
+    return statistics;
+}
+
 void dump_thread_list(bool with_stack_traces)
 {
     dbgln("Scheduler thread list for processor {}:", Processor::current_id());
@@ -29,6 +29,11 @@ struct TotalTimeScheduled {
     u64 total_kernel { 0 };
 };
 
+struct SchedulerStatistics {
+    u64 steals { 0 };
+    u64 migrations { 0 };
+};
+
 class Scheduler {
 public:
     static void initialize();
@@ -49,11 +54,13 @@ public:
     static void notify_finalizer();
     static Thread& pull_next_runnable_thread();
     static Thread* peek_next_runnable_thread();
+    static void balance_ready_queues(u32 processor_id, Thread const& current_thread);
     static bool dequeue_runnable_thread(Thread&, bool = false);
     static void enqueue_runnable_thread(Thread&);
     static void dump_scheduler_state(bool = false);
     static bool is_initialized();
     static TotalTimeScheduled get_total_time_scheduled();
+    static SchedulerStatistics get_statistics();
     static void add_time_scheduled(u64, bool);
 };
 
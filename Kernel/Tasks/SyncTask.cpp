@@ -8,21 +8,36 @@
 #include <Kernel/Sections.h>
 #include <Kernel/Tasks/Process.h>
 #include <Kernel/Tasks/SyncTask.h>
+#include <Kernel/Tasks/WaitQueue.h>
 #include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
+static constexpr Duration writeback_interval = Duration::from_seconds(1);
+
+static WaitQueue* s_sync_task_wait_queue;
+
 UNMAP_AFTER_INIT void SyncTask::spawn()
 {
+    s_sync_task_wait_queue = new WaitQueue;
     MUST(Process::create_kernel_process("VFS Sync Task"sv, [] {
         dbgln("VFS SyncTask is running");
         while (!Process::current().is_dying()) {
-            FileSystem::sync();
-            (void)Thread::current()->sleep(Duration::from_seconds(1));
+            // File systems decide on their own what is old enough to be written back, so that we don't
+            // write everything at once every time we come around.
+            FileSystem::write_back_dirty_data_of_all_file_systems();
+            auto timeout = Thread::BlockTimeout { false, &writeback_interval };
+            [[maybe_unused]] auto result = s_sync_task_wait_queue->wait_on(timeout, "VFS Sync Task"sv);
         }
         Process::current().sys$exit(0);
         VERIFY_NOT_REACHED();
     }));
 }
 
+void SyncTask::wake_up()
+{
+    if (s_sync_task_wait_queue)
+        s_sync_task_wait_queue->wake_all();
+}
+
 }
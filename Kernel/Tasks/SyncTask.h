@@ -10,5 +10,8 @@ namespace Kernel {
 class SyncTask {
 public:
     static void spawn();
+
+    // Makes the sync task write back dirty data right away, instead of waiting for its next round.
+    static void wake_up();
 };
 }
@@ -621,6 +621,19 @@ void Thread::update_time_scheduled(u64 current_scheduler_time, bool is_kernel, b
         m_last_time_scheduled = current_scheduler_time;
 }
 
+void Thread::set_affinity(u64 affinity)
+{
+    SpinlockLocker scheduler_lock(g_scheduler_lock);
+    m_cpu_affinity = affinity;
+
+    // If we're queued on a processor that we may no longer run on, nobody would ever pick us up.
+    if (m_runnable_priority >= 0 && !(affinity & (1ull << m_runnable_processor))) {
+        auto was_queued = Scheduler::dequeue_runnable_thread(*this);
+        VERIFY(was_queued);
+        Scheduler::enqueue_runnable_thread(*this);
+    }
+}
+
 bool Thread::tick()
 {
     if (previous_mode() == ExecutionMode::Kernel) {
@@ -1252,7 +1265,6 @@ void Thread::set_state(State new_state, u8 stop_signal)
 
     if (m_state == Thread::State::Runnable) {
         Scheduler::enqueue_runnable_thread(*this);
-        Processor::smp_wake_n_idle_processors(1);
     } else if (m_state == Thread::State::Stopped) {
         // We don't want to restore to Running state, only Runnable!
         m_stop_state = previous_state != Thread::State::Running ? previous_state : Thread::State::Runnable;
@@ -52,7 +52,7 @@ struct ThreadSpecificData {
     ThreadSpecificData* self;
 };
 
-#define THREAD_AFFINITY_DEFAULT 0xffffffff
+#define THREAD_AFFINITY_DEFAULT 0xffffffffffffffffull
 
 class Thread
     : public ListedRefCounted<Thread, LockType::Spinlock>
@@ -64,6 +64,7 @@ class Thread
     friend class Process;
     friend class Scheduler;
     friend struct ThreadReadyQueue;
+    friend struct ThreadReadyQueues;
 
 public:
     static Thread* current()
@@ -775,8 +776,8 @@ public:
 
     u32 cpu() const { return m_cpu.load(AK::MemoryOrder::memory_order_consume); }
     void set_cpu(u32 cpu) { m_cpu.store(cpu, AK::MemoryOrder::memory_order_release); }
-    u32 affinity() const { return m_cpu_affinity; }
-    void set_affinity(u32 affinity) { m_cpu_affinity = affinity; }
+    u64 affinity() const { return m_cpu_affinity; }
+    void set_affinity(u64 affinity);
 
     RegisterState& get_register_dump_from_stack();
     RegisterState const& get_register_dump_from_stack() const { return const_cast<Thread*>(this)->get_register_dump_from_stack(); }
@@ -1094,6 +1095,7 @@ private:
 
     IntrusiveListNode<Thread> m_process_thread_list_node;
     int m_runnable_priority { -1 };
+    u32 m_runnable_processor { 0 };
 
     friend class WaitQueue;
 
@@ -1167,7 +1169,7 @@ private:
     u32 m_saved_critical { 1 };
     IntrusiveListNode<Thread> m_ready_queue_node;
     Atomic<u32> m_cpu { 0 };
-    u32 m_cpu_affinity { THREAD_AFFINITY_DEFAULT };
+    u64 m_cpu_affinity { THREAD_AFFINITY_DEFAULT };
     Optional<u64> m_last_time_scheduled;
     Atomic<u64> m_total_time_scheduled_user { 0 };
     Atomic<u64> m_total_time_scheduled_kernel { 0 };
@@ -143,6 +143,7 @@ set(NVME_DEBUG ON)
 set(OCCLUSIONS_DEBUG ON)
 set(OFFD_DEBUG ON)
 set(OPENTYPE_GPOS_DEBUG ON)
+set(PAGE_CACHE_DEBUG ON)
 set(PAGE_FAULT_DEBUG ON)
 set(HTML_PARSER_DEBUG ON)
 set(PATA_DEBUG ON)
@@ -160,6 +161,7 @@ set(PS2MOUSE_DEBUG ON)
 set(PTHREAD_DEBUG ON)
 set(PTMX_DEBUG ON)
 set(REACHABLE_DEBUG ON)
+set(READ_AHEAD_DEBUG ON)
 set(REGEX_DEBUG ON)
 set(REQUESTSERVER_DEBUG ON)
 set(RESIZE_DEBUG ON)
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/ScopeGuard.h>
+#include <AK/Time.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+struct PipeAndEventPoll {
+    int epoll_fd { -1 };
+    int read_fd { -1 };
+    int write_fd { -1 };
+
+    ~PipeAndEventPoll()
+    {
+        close(epoll_fd);
+        if (read_fd >= 0)
+            close(read_fd);
+        if (write_fd >= 0)
+            close(write_fd);
+    }
+};
+
+static void create_pipe_and_event_poll(PipeAndEventPoll& result)
+{
+    result.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    VERIFY(result.epoll_fd >= 0);
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    result.read_fd = pipe_fds[0];
+    result.write_fd = pipe_fds[1];
+}
+
+static int add_interest(int epoll_fd, int fd, u32 events, u64 data)
+{
+    epoll_event event { .events = events, .data = { .u64 = data } };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static int wait_for_events(int epoll_fd, epoll_event* events, int max_events = 1)
+{
+    return epoll_wait(epoll_fd, events, max_events, 0);
+}
+
+TEST_CASE(level_triggered_readiness)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN, 42), 0);
+
+    epoll_event event {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+
+    EXPECT_EQ(write(p.write_fd, "ab", 2), 2);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(event.events, static_cast<u32>(EPOLLIN));
+    EXPECT_EQ(event.data.u64, 42u);
+
+    // As long as there's data left, the pipe stays ready.
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    char buffer[2];
+    EXPECT_EQ(read(p.read_fd, buffer, 1), 1);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(read(p.read_fd, buffer, 1), 1);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+}
+
+TEST_CASE(edge_triggered_readiness)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN | EPOLLET, 1), 0);
+
+    EXPECT_EQ(write(p.write_fd, "ab", 2), 2);
+    epoll_event event {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(event.events, static_cast<u32>(EPOLLIN));
+
+    // The data is still there, but we've already been told about it.
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+
+    // Once it's been drained, new data is a new edge.
+    char buffer[2];
+    EXPECT_EQ(read(p.read_fd, buffer, sizeof(buffer)), 2);
+    EXPECT_EQ(write(p.write_fd, "c", 1), 1);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+}
+
+TEST_CASE(edge_triggered_fd_that_is_not_drained)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN | EPOLLET, 1), 0);
+
+    EXPECT_EQ(write(p.write_fd, "a", 1), 1);
+    epoll_event event {};
+    EXPECT_EQ(epoll_wait(p.epoll_fd, &event, 1, 10000), 1);
+
+    // More data isn't a transition, the fd has been readable all along. So this has to wait for the whole timeout.
+    EXPECT_EQ(write(p.write_fd, "b", 1), 1);
+    timespec start {};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    EXPECT_EQ(epoll_wait(p.epoll_fd, &event, 1, 100), 0);
+    timespec end {};
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    auto elapsed = Duration::from_timespec(end) - Duration::from_timespec(start);
+    EXPECT(elapsed >= Duration::from_milliseconds(90));
+}
+
+TEST_CASE(one_shot_interest_is_disabled_until_modified)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN | EPOLLONESHOT, 1), 0);
+
+    EXPECT_EQ(write(p.write_fd, "a", 1), 1);
+    epoll_event event {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+
+    epoll_event modified_event { .events = EPOLLIN | EPOLLONESHOT, .data = { .u64 = 2 } };
+    EXPECT_EQ(epoll_ctl(p.epoll_fd, EPOLL_CTL_MOD, p.read_fd, &modified_event), 0);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(event.data.u64, 2u);
+}
+
+TEST_CASE(modify_and_delete_interest)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+
+    // Modifying or deleting something we don't watch is an error, and so is watching it twice.
+    epoll_event event { .events = EPOLLIN, .data = { .u64 = 1 } };
+    EXPECT_EQ(epoll_ctl(p.epoll_fd, EPOLL_CTL_MOD, p.write_fd, &event), -1);
+    EXPECT_EQ(errno, ENOENT);
+    EXPECT_EQ(epoll_ctl(p.epoll_fd, EPOLL_CTL_DEL, p.write_fd, nullptr), -1);
+    EXPECT_EQ(errno, ENOENT);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.write_fd, EPOLLIN, 1), 0);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.write_fd, EPOLLIN, 1), -1);
+    EXPECT_EQ(errno, EEXIST);
+
+    // The write end of an empty pipe is only ready for writing.
+    epoll_event ready_event {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &ready_event), 0);
+    event = { .events = EPOLLOUT, .data = { .u64 = 7 } };
+    EXPECT_EQ(epoll_ctl(p.epoll_fd, EPOLL_CTL_MOD, p.write_fd, &event), 0);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &ready_event), 1);
+    EXPECT_EQ(ready_event.events, static_cast<u32>(EPOLLOUT));
+    EXPECT_EQ(ready_event.data.u64, 7u);
+
+    EXPECT_EQ(epoll_ctl(p.epoll_fd, EPOLL_CTL_DEL, p.write_fd, nullptr), 0);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &ready_event), 0);
+}
+
+TEST_CASE(closing_a_watched_fd)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN, 1), 0);
+    EXPECT_EQ(write(p.write_fd, "a", 1), 1);
+
+    // Once the last reference to the description is gone, so is the interest in it.
+    close(p.read_fd);
+    p.read_fd = -1;
+    epoll_event event {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+
+    // The fd number can be watched again once it's reused.
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard close_new_pipe = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    };
+    EXPECT_EQ(add_interest(p.epoll_fd, pipe_fds[0], EPOLLIN, 2), 0);
+    EXPECT_EQ(write(pipe_fds[1], "b", 1), 1);
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT_EQ(event.data.u64, 2u);
+}
+
+TEST_CASE(interest_belongs_to_fd_and_description)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    int duplicated_fd = dup(p.read_fd);
+    VERIFY(duplicated_fd >= 0);
+    ScopeGuard close_duplicated_fd = [&] { close(duplicated_fd); };
+
+    // Another fd for the same description is a separate interest.
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN, 1), 0);
+    EXPECT_EQ(add_interest(p.epoll_fd, duplicated_fd, EPOLLIN, 2), 0);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN, 3), -1);
+    EXPECT_EQ(errno, EEXIST);
+
+    // Closing the fd doesn't end the interest while the description is still around.
+    close(p.read_fd);
+    p.read_fd = -1;
+    EXPECT_EQ(write(p.write_fd, "a", 1), 1);
+    epoll_event events[2] {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, events, 2), 2);
+    EXPECT_EQ(events[0].data.u64 + events[1].data.u64, 3u);
+}
+
+TEST_CASE(end_of_file_is_readable)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN | EPOLLET, 1), 0);
+
+    epoll_event event {};
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 0);
+
+    // Once all writers are gone, a read won't block anymore.
+    close(p.write_fd);
+    p.write_fd = -1;
+    EXPECT_EQ(wait_for_events(p.epoll_fd, &event), 1);
+    EXPECT(event.events & EPOLLIN);
+}
+
+TEST_CASE(wait_timeout)
+{
+    PipeAndEventPoll p;
+    create_pipe_and_event_poll(p);
+    EXPECT_EQ(add_interest(p.epoll_fd, p.read_fd, EPOLLIN, 1), 0);
+
+    timespec start {};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    epoll_event event {};
+    EXPECT_EQ(epoll_wait(p.epoll_fd, &event, 1, 100), 0);
+    timespec end {};
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    auto elapsed = Duration::from_timespec(end) - Duration::from_timespec(start);
+    EXPECT(elapsed >= Duration::from_milliseconds(90));
+
+    // Readiness ends the wait early.
+    EXPECT_EQ(write(p.write_fd, "a", 1), 1);
+    EXPECT_EQ(epoll_wait(p.epoll_fd, &event, 1, 10000), 1);
+
+    // Zero or negative numbers of events aren't allowed.
+    EXPECT_EQ(epoll_wait(p.epoll_fd, &event, 0, 0), -1);
+    EXPECT_EQ(errno, EINVAL);
+}
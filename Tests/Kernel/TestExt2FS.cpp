@@ -4,10 +4,21 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/AllOf.h>
+#include <AK/ByteBuffer.h>
+#include <AK/ByteString.h>
+#include <AK/Endian.h>
+#include <AK/Function.h>
+#include <AK/ScopeGuard.h>
+#include <Kernel/API/Ioctl.h>
 #include <LibTest/TestCase.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <unistd.h>
 
@@ -106,3 +117,504 @@ TEST_CASE(test_ext2_writes_and_reads_to_block_ranges)
     write_then_read_block(doubly_indirect_blocks_capacity);
     write_then_read_block(triply_indirect_blocks_capacity - 1);
 }
+
+TEST_CASE(test_large_directory)
+{
+    static constexpr auto TEST_DIRECTORY_PATH = "/home/anon/.ext2_large_directory_test";
+    // Enough entries to need many directory blocks, so that the directory gets an index and its leaves are split repeatedly.
+    static constexpr size_t entry_count = 5000;
+
+    auto entry_path = [](size_t i) { return ByteString::formatted("{}/entry-with-a-longer-name-{}", TEST_DIRECTORY_PATH, i); };
+
+    EXPECT_EQ(mkdir(TEST_DIRECTORY_PATH, 0755), 0);
+    auto cleanup_guard = ScopeGuard([&] {
+        for (size_t i = 0; i < entry_count; ++i)
+            unlink(entry_path(i).characters());
+        rmdir(TEST_DIRECTORY_PATH);
+    });
+
+    for (size_t i = 0; i < entry_count; ++i) {
+        auto fd = open(entry_path(i).characters(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+        EXPECT(fd >= 0);
+        close(fd);
+    }
+
+    // Creating an existing entry has to fail, no matter which leaf it ended up in.
+    EXPECT_EQ(open(entry_path(entry_count / 2).characters(), O_CREAT | O_EXCL | O_WRONLY, 0644), -1);
+    EXPECT_EQ(errno, EEXIST);
+
+    struct stat st;
+    for (size_t i = 0; i < entry_count; ++i)
+        EXPECT_EQ(stat(entry_path(i).characters(), &st), 0);
+
+    for (size_t i = 0; i < entry_count; i += 2)
+        EXPECT_EQ(unlink(entry_path(i).characters()), 0);
+
+    for (size_t i = 0; i < entry_count; ++i) {
+        bool was_removed = i % 2 == 0;
+        EXPECT_EQ(stat(entry_path(i).characters(), &st), was_removed ? -1 : 0);
+    }
+
+    size_t entries_seen = 0;
+    auto* directory = opendir(TEST_DIRECTORY_PATH);
+    VERIFY(directory);
+    while (auto* entry = readdir(directory)) {
+        auto name = StringView { entry->d_name, strlen(entry->d_name) };
+        if (name != "."sv && name != ".."sv)
+            ++entries_seen;
+    }
+    closedir(directory);
+    EXPECT_EQ(entries_seen, entry_count / 2);
+}
+
+static void write_and_truncate_sequentially(int fd)
+{
+    // Large enough to need more than the four extents that fit into the inode, should the file end up fragmented.
+    static constexpr size_t file_size = 8 * MiB;
+    static constexpr size_t chunk_size = 64 * KiB;
+
+    auto expected_byte_at = [](size_t offset) { return static_cast<u8>((offset / 4096) ^ (offset % 251)); };
+
+    auto chunk = ByteBuffer::create_uninitialized(chunk_size).release_value();
+    for (size_t offset = 0; offset < file_size; offset += chunk_size) {
+        for (size_t i = 0; i < chunk_size; ++i)
+            chunk[i] = expected_byte_at(offset + i);
+        EXPECT_EQ(write(fd, chunk.data(), chunk_size), static_cast<ssize_t>(chunk_size));
+    }
+
+    auto verify_contents = [&](size_t size, size_t zeroed_from) {
+        EXPECT_EQ(lseek(fd, 0, SEEK_SET), 0);
+        for (size_t offset = 0; offset < size; offset += chunk_size) {
+            auto length = min(chunk_size, size - offset);
+            EXPECT_EQ(read(fd, chunk.data(), length), static_cast<ssize_t>(length));
+            for (size_t i = 0; i < length; ++i) {
+                auto expected = offset + i < zeroed_from ? expected_byte_at(offset + i) : 0;
+                if (chunk[i] != expected) {
+                    FAIL(ByteString::formatted("Unexpected byte at offset {}", offset + i));
+                    return;
+                }
+            }
+        }
+    };
+    verify_contents(file_size, file_size);
+
+    struct stat st_before;
+    EXPECT_EQ(fstat(fd, &st_before), 0);
+
+    // Cut the file off, then grow it again. Everything past the cut has to read back as zeroes.
+    static constexpr size_t truncated_size = 3 * MiB + 64 * KiB;
+    EXPECT_EQ(ftruncate(fd, truncated_size), 0);
+
+    struct stat st_after;
+    EXPECT_EQ(fstat(fd, &st_after), 0);
+    EXPECT_EQ(st_after.st_size, static_cast<off_t>(truncated_size));
+    EXPECT(st_after.st_blocks < st_before.st_blocks);
+    verify_contents(truncated_size, truncated_size);
+
+    EXPECT_EQ(ftruncate(fd, file_size), 0);
+    verify_contents(file_size, truncated_size);
+}
+
+TEST_CASE(test_sequential_write_and_truncate)
+{
+    static constexpr auto TEST_FILE_PATH = "/home/anon/.ext2_truncate_test";
+
+    auto fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd != -1);
+    auto cleanup_guard = ScopeGuard([&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    });
+
+    write_and_truncate_sequentially(fd);
+}
+
+// The root file system may not have the extents feature, so we make our own: a single block group, an empty
+// root directory and just enough room for the file written by write_and_truncate_sequentially(). If asked
+// to, the image also gets a journal (with an empty superblock), which is mapped through an indirect block.
+static constexpr size_t extents_image_block_size = 4096;
+static constexpr u32 extents_image_block_count = 8192;
+static constexpr u32 extents_image_inode_count = 128;
+static constexpr u32 extents_image_inode_size = 128;
+static constexpr u32 extents_image_block_bitmap = 2;
+static constexpr u32 extents_image_inode_bitmap = 3;
+static constexpr u32 extents_image_inode_table = 4;
+static constexpr u32 extents_image_root_directory_block = extents_image_inode_table + extents_image_inode_count * extents_image_inode_size / extents_image_block_size;
+static constexpr u32 extents_image_first_free_block = extents_image_root_directory_block + 1;
+static constexpr u32 extents_image_first_free_inode = 11;
+static constexpr u32 extents_image_root_inode = 2;
+static constexpr u32 extents_image_journal_inode = 8;
+static constexpr u32 extents_image_journal_indirect_block = extents_image_first_free_block;
+static constexpr u32 extents_image_journal_first_block = extents_image_journal_indirect_block + 1;
+
+static constexpr u32 ext3_compat_has_journal = 0x0004;
+static constexpr u32 ext3_incompat_recover = 0x0004;
+
+static constexpr u32 ext2_incompat_filetype = 0x0002;
+static constexpr u32 ext2_incompat_extents = 0x0040;
+static constexpr u32 ext2_extents_flag = 0x00080000;
+static constexpr u16 ext2_extent_header_magic = 0xf30a;
+
+template<typename T>
+static void put(ByteBuffer& buffer, size_t offset, T value)
+{
+    buffer.overwrite(offset, &value, sizeof(value));
+}
+
+template<typename T>
+static T get(ByteBuffer const& buffer, size_t offset)
+{
+    T value;
+    memcpy(&value, buffer.data() + offset, sizeof(value));
+    return value;
+}
+
+static void create_image_with_extents(int fd, u32 journal_block_count = 0)
+{
+    VERIFY(journal_block_count == 0 || (journal_block_count > 12 && journal_block_count <= 12 + extents_image_block_size / sizeof(u32)));
+    VERIFY(ftruncate(fd, extents_image_block_count * extents_image_block_size) == 0);
+
+    auto block = ByteBuffer::create_zeroed(extents_image_block_size).release_value();
+    auto write_block = [&](u32 index) {
+        VERIFY(pwrite(fd, block.data(), block.size(), index * extents_image_block_size) == static_cast<ssize_t>(block.size()));
+        block.zero_fill();
+    };
+
+    u32 first_free_block = journal_block_count == 0 ? extents_image_first_free_block : extents_image_journal_first_block + journal_block_count;
+    u32 free_block_count = extents_image_block_count - first_free_block;
+    static constexpr u32 free_inode_count = extents_image_inode_count - (extents_image_first_free_inode - 1);
+
+    // The super block lives at byte 1024 of the first block.
+    static constexpr size_t super_block = 1024;
+    put<u32>(block, super_block + 0, extents_image_inode_count);                       // s_inodes_count
+    put<u32>(block, super_block + 4, extents_image_block_count);                       // s_blocks_count
+    put<u32>(block, super_block + 12, free_block_count);                               // s_free_blocks_count
+    put<u32>(block, super_block + 16, free_inode_count);                               // s_free_inodes_count
+    put<u32>(block, super_block + 24, 2);                                              // s_log_block_size, i.e. 1024 << 2
+    put<u32>(block, super_block + 28, 2);                                              // s_log_frag_size
+    put<u32>(block, super_block + 32, extents_image_block_count);                      // s_blocks_per_group
+    put<u32>(block, super_block + 36, extents_image_block_count);                      // s_frags_per_group
+    put<u32>(block, super_block + 40, extents_image_inode_count);                      // s_inodes_per_group
+    put<u16>(block, super_block + 56, 0xef53);                                         // s_magic
+    put<u16>(block, super_block + 58, 1);                                              // s_state, i.e. EXT2_VALID_FS
+    put<u16>(block, super_block + 60, 1);                                              // s_errors, i.e. EXT2_ERRORS_CONTINUE
+    put<u32>(block, super_block + 76, 1);                                              // s_rev_level, i.e. EXT2_DYNAMIC_REV
+    put<u32>(block, super_block + 84, extents_image_first_free_inode);                 // s_first_ino
+    put<u16>(block, super_block + 88, extents_image_inode_size);                       // s_inode_size
+    put<u32>(block, super_block + 96, ext2_incompat_filetype | ext2_incompat_extents); // s_feature_incompat
+    if (journal_block_count != 0) {
+        put<u32>(block, super_block + 92, ext3_compat_has_journal);      // s_feature_compat
+        put<u32>(block, super_block + 224, extents_image_journal_inode); // s_journal_inum
+    }
+    write_block(0);
+
+    put<u32>(block, 0, extents_image_block_bitmap); // bg_block_bitmap
+    put<u32>(block, 4, extents_image_inode_bitmap); // bg_inode_bitmap
+    put<u32>(block, 8, extents_image_inode_table);  // bg_inode_table
+    put<u16>(block, 12, free_block_count);          // bg_free_blocks_count
+    put<u16>(block, 14, free_inode_count);          // bg_free_inodes_count
+    put<u16>(block, 16, 1);                         // bg_used_dirs_count
+    write_block(1);
+
+    for (u32 i = 0; i < first_free_block; ++i)
+        block[i / 8] |= 1 << (i % 8);
+    write_block(extents_image_block_bitmap);
+
+    for (u32 i = 0; i < extents_image_first_free_inode - 1; ++i)
+        block[i / 8] |= 1 << (i % 8);
+    write_block(extents_image_inode_bitmap);
+
+    // The root directory itself uses a block pointer, only new files get an extent tree.
+    static constexpr size_t root_inode = (extents_image_root_inode - 1) * extents_image_inode_size;
+    put<u16>(block, root_inode + 0, S_IFDIR | 0755);                      // i_mode
+    put<u32>(block, root_inode + 4, extents_image_block_size);            // i_size
+    put<u16>(block, root_inode + 26, 2);                                  // i_links_count
+    put<u32>(block, root_inode + 28, extents_image_block_size / 512);     // i_blocks
+    put<u32>(block, root_inode + 40, extents_image_root_directory_block); // i_block[0]
+    if (journal_block_count != 0) {
+        static constexpr size_t journal_inode = (extents_image_journal_inode - 1) * extents_image_inode_size;
+        put<u16>(block, journal_inode + 0, S_IFREG | 0600);                                                // i_mode
+        put<u32>(block, journal_inode + 4, journal_block_count * extents_image_block_size);                // i_size
+        put<u16>(block, journal_inode + 26, 1);                                                            // i_links_count
+        put<u32>(block, journal_inode + 28, (journal_block_count + 1) * (extents_image_block_size / 512)); // i_blocks
+        // The first twelve blocks go into i_block[0..11], the rest into the indirect block in i_block[12].
+        for (u32 i = 0; i < 12; ++i)
+            put<u32>(block, journal_inode + 40 + i * sizeof(u32), extents_image_journal_first_block + i);
+        put<u32>(block, journal_inode + 40 + 12 * sizeof(u32), extents_image_journal_indirect_block);
+    }
+    write_block(extents_image_inode_table);
+
+    if (journal_block_count != 0) {
+        for (u32 i = 12; i < journal_block_count; ++i)
+            put<u32>(block, (i - 12) * sizeof(u32), extents_image_journal_first_block + i);
+        write_block(extents_image_journal_indirect_block);
+
+        // The superblock of an empty journal, which is all there is to it until a transaction is logged.
+        put<BigEndian<u32>>(block, 0, 0xc03b3998);                // h_magic
+        put<BigEndian<u32>>(block, 4, 4);                         // h_blocktype, i.e. superblock v2
+        put<BigEndian<u32>>(block, 12, extents_image_block_size); // s_blocksize
+        put<BigEndian<u32>>(block, 16, journal_block_count);      // s_maxlen
+        put<BigEndian<u32>>(block, 20, 1);                        // s_first
+        put<BigEndian<u32>>(block, 24, 1);                        // s_sequence
+        write_block(extents_image_journal_first_block);
+    }
+
+    put<u32>(block, 0, extents_image_root_inode); // inode
+    put<u16>(block, 4, 12);                       // rec_len
+    block[6] = 1;                                 // name_len
+    block[7] = 2;                                 // file_type, i.e. EXT2_FT_DIR
+    block[8] = '.';
+    put<u32>(block, 12, extents_image_root_inode);
+    put<u16>(block, 16, extents_image_block_size - 12);
+    block[18] = 2;
+    block[19] = 2;
+    block[20] = '.';
+    block[21] = '.';
+    write_block(extents_image_root_directory_block);
+}
+
+// Mounts the image through a loop device while the callback runs. Once it's unmounted again, the image file
+// can be looked at to see what made it to the disk.
+static void with_image_mounted(int image_fd, char const* mount_path, Function<void()> callback)
+{
+    auto devctl_fd = open("/dev/devctl", O_RDONLY);
+    VERIFY(devctl_fd != -1);
+    EXPECT_EQ(mkdir(mount_path, 0755), 0);
+    int loop_device_index = -1;
+    int loop_device_fd = -1;
+    bool is_mounted = false;
+    auto cleanup_guard = ScopeGuard([&] {
+        if (is_mounted)
+            umount(mount_path);
+        if (loop_device_fd != -1)
+            close(loop_device_fd);
+        if (loop_device_index != -1)
+            ioctl(devctl_fd, DEVCTL_DESTROY_LOOP_DEVICE, &loop_device_index);
+        rmdir(mount_path);
+        close(devctl_fd);
+    });
+
+    int value = image_fd;
+    EXPECT_EQ(ioctl(devctl_fd, DEVCTL_CREATE_LOOP_DEVICE, &value), 0);
+    loop_device_index = value;
+    loop_device_fd = open(ByteString::formatted("/dev/loop/{}", loop_device_index).characters(), O_RDWR);
+    VERIFY(loop_device_fd != -1);
+    EXPECT_EQ(mount(loop_device_fd, mount_path, "ext2", 0), 0);
+    is_mounted = true;
+
+    callback();
+
+    EXPECT_EQ(umount(mount_path), 0);
+    is_mounted = false;
+}
+
+TEST_CASE(test_sequential_write_and_truncate_with_extents)
+{
+    static constexpr auto IMAGE_PATH = "/tmp/.ext2_extents_image";
+    static constexpr auto MOUNT_PATH = "/tmp/.ext2_extents_mount";
+    static constexpr auto TEST_FILE_PATH = "/tmp/.ext2_extents_mount/truncate_test";
+
+    auto image_fd = open(IMAGE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(image_fd != -1);
+    auto cleanup_guard = ScopeGuard([&] {
+        close(image_fd);
+        unlink(IMAGE_PATH);
+    });
+
+    create_image_with_extents(image_fd);
+
+    struct stat st;
+    with_image_mounted(image_fd, MOUNT_PATH, [&] {
+        auto fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        VERIFY(fd != -1);
+        write_and_truncate_sequentially(fd);
+        EXPECT_EQ(fstat(fd, &st), 0);
+        close(fd);
+    });
+
+    // Once everything is written back, the inode on disk has to map its blocks through a non-empty extent tree.
+    VERIFY(st.st_ino >= extents_image_first_free_inode && st.st_ino <= extents_image_inode_count);
+    auto inode = ByteBuffer::create_uninitialized(extents_image_inode_size).release_value();
+    auto inode_offset = extents_image_inode_table * extents_image_block_size + (st.st_ino - 1) * extents_image_inode_size;
+    EXPECT_EQ(pread(image_fd, inode.data(), inode.size(), inode_offset), static_cast<ssize_t>(inode.size()));
+    EXPECT(get<u32>(inode, 32) & ext2_extents_flag);          // i_flags
+    EXPECT_EQ(get<u16>(inode, 40), ext2_extent_header_magic); // eh_magic
+    EXPECT_NE(get<u16>(inode, 42), 0);                        // eh_entries
+}
+
+TEST_CASE(test_journal_replays_only_committed_and_unrevoked_blocks)
+{
+    static constexpr auto IMAGE_PATH = "/tmp/.ext2_journal_image";
+    static constexpr auto MOUNT_PATH = "/tmp/.ext2_journal_mount";
+    static constexpr u32 journal_block_count = 64;
+    static constexpr u32 first_sequence = 10;
+
+    // Blocks of the file system that the log refers to, right after the journal.
+    static constexpr u32 committed_block = extents_image_journal_first_block + journal_block_count;
+    static constexpr u32 revoked_block = committed_block + 1;
+    static constexpr u32 uncommitted_block = committed_block + 2;
+
+    auto image_fd = open(IMAGE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(image_fd != -1);
+    auto cleanup_guard = ScopeGuard([&] {
+        close(image_fd);
+        unlink(IMAGE_PATH);
+    });
+
+    create_image_with_extents(image_fd, journal_block_count);
+
+    auto block = ByteBuffer::create_zeroed(extents_image_block_size).release_value();
+    auto read_block = [&](u32 index) {
+        VERIFY(pread(image_fd, block.data(), block.size(), index * extents_image_block_size) == static_cast<ssize_t>(block.size()));
+    };
+    auto write_block = [&](u32 index) {
+        VERIFY(pwrite(image_fd, block.data(), block.size(), index * extents_image_block_size) == static_cast<ssize_t>(block.size()));
+        block.zero_fill();
+    };
+    auto write_log_block = [&](u32 position) { write_block(extents_image_journal_first_block + position); };
+    auto put_header = [&](u32 block_type, u32 sequence) {
+        put<BigEndian<u32>>(block, 0, 0xc03b3998); // h_magic
+        put<BigEndian<u32>>(block, 4, block_type); // h_blocktype
+        put<BigEndian<u32>>(block, 8, sequence);   // h_sequence
+    };
+    auto is_filled_with = [&](u32 index, u8 value) {
+        read_block(index);
+        return all_of(block.bytes(), [&](u8 byte) { return byte == value; });
+    };
+
+    for (auto index : { committed_block, revoked_block, uncommitted_block }) {
+        block.bytes().fill(0xaa);
+        write_block(index);
+    }
+
+    // The first transaction logs two blocks and is committed. Its first tag is followed by the UUID
+    // of the journal, which is all zeroes here.
+    put_header(1, first_sequence);
+    put<BigEndian<u32>>(block, 12, committed_block); // t_blocknr
+    put<BigEndian<u32>>(block, 36, revoked_block);   // t_blocknr
+    put<BigEndian<u16>>(block, 42, 2 | 8);           // t_flags, i.e. SAME_UUID | LAST_TAG
+    write_log_block(1);
+    block.bytes().fill(0x11);
+    write_log_block(2);
+    block.bytes().fill(0x22);
+    write_log_block(3);
+    put_header(2, first_sequence);
+    write_log_block(4);
+
+    // The second one revokes the second block, so its copy in the first transaction must not be replayed.
+    put_header(5, first_sequence + 1);
+    put<BigEndian<u32>>(block, 12, 16 + sizeof(u32)); // r_count
+    put<BigEndian<u32>>(block, 16, revoked_block);
+    write_log_block(5);
+    put_header(2, first_sequence + 1);
+    write_log_block(6);
+
+    // The last one never got its commit block, so as far as the file system is concerned, it never happened.
+    put_header(1, first_sequence + 2);
+    put<BigEndian<u32>>(block, 12, uncommitted_block); // t_blocknr
+    put<BigEndian<u16>>(block, 18, 8);                 // t_flags, i.e. LAST_TAG
+    write_log_block(7);
+    block.bytes().fill(0x33);
+    write_log_block(8);
+
+    read_block(extents_image_journal_first_block);
+    put<BigEndian<u32>>(block, 24, first_sequence); // s_sequence
+    put<BigEndian<u32>>(block, 28, 1);              // s_start
+    write_log_block(0);
+
+    read_block(0);
+    put<u32>(block, 1024 + 96, get<u32>(block, 1024 + 96) | ext3_incompat_recover); // s_feature_incompat
+    write_block(0);
+
+    // Mounting the image replays the log.
+    with_image_mounted(image_fd, MOUNT_PATH, [] {});
+
+    EXPECT(is_filled_with(committed_block, 0x11));
+    EXPECT(is_filled_with(revoked_block, 0xaa));
+    EXPECT(is_filled_with(uncommitted_block, 0xaa));
+
+    // Nothing is left to be replayed, and the file system knows that it doesn't need to be recovered anymore.
+    read_block(extents_image_journal_first_block);
+    EXPECT_EQ(get<BigEndian<u32>>(block, 28), 0u); // s_start
+    read_block(0);
+    EXPECT_EQ(get<u32>(block, 1024 + 96) & ext3_incompat_recover, 0u); // s_feature_incompat
+}
+
+TEST_CASE(test_journaled_write_and_truncate_survives_remount)
+{
+    static constexpr auto IMAGE_PATH = "/tmp/.ext2_journaled_image";
+    static constexpr auto MOUNT_PATH = "/tmp/.ext2_journaled_mount";
+    static constexpr auto TEST_FILE_PATH = "/tmp/.ext2_journaled_mount/truncate_test";
+
+    auto image_fd = open(IMAGE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(image_fd != -1);
+    auto cleanup_guard = ScopeGuard([&] {
+        close(image_fd);
+        unlink(IMAGE_PATH);
+    });
+
+    // With a journal this small, the log fills up and has to be checkpointed over and over again.
+    create_image_with_extents(image_fd, 16);
+
+    with_image_mounted(image_fd, MOUNT_PATH, [&] {
+        auto fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        VERIFY(fd != -1);
+        write_and_truncate_sequentially(fd);
+        close(fd);
+    });
+
+    with_image_mounted(image_fd, MOUNT_PATH, [&] {
+        struct stat st;
+        EXPECT_EQ(stat(TEST_FILE_PATH, &st), 0);
+        EXPECT_EQ(st.st_size, static_cast<off_t>(8 * MiB));
+    });
+}
+
+TEST_CASE(test_sequential_write_is_contiguous)
+{
+    static constexpr auto TEST_FILE_PATH = "/home/anon/.ext2_contiguous_test";
+    static constexpr size_t file_size = 2 * MiB;
+    static constexpr size_t chunk_size = 4 * KiB;
+
+    auto fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd != -1);
+    auto cleanup_guard = ScopeGuard([&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    });
+
+    auto chunk = ByteBuffer::create_uninitialized(chunk_size).release_value();
+    for (size_t offset = 0; offset < file_size; offset += chunk_size) {
+        chunk.bytes().fill(static_cast<u8>(offset / chunk_size));
+        EXPECT_EQ(write(fd, chunk.data(), chunk_size), static_cast<ssize_t>(chunk_size));
+    }
+
+    // The blocks may not be allocated yet, but they have to be accounted for regardless.
+    struct stat st;
+    EXPECT_EQ(fstat(fd, &st), 0);
+    EXPECT(static_cast<size_t>(st.st_blocks) * 512 >= file_size);
+
+    EXPECT_EQ(fsync(fd), 0);
+
+    size_t block_count = file_size / st.st_blksize;
+    size_t extent_count = 0;
+    int previous_block = 0;
+    for (size_t i = 0; i < block_count; ++i) {
+        int block = static_cast<int>(i);
+        EXPECT_EQ(ioctl(fd, FIBMAP, &block), 0);
+        EXPECT_NE(block, 0);
+        if (block != previous_block + 1)
+            ++extent_count;
+        previous_block = block;
+    }
+
+    // Written in many small pieces, the file should still end up in a few long runs.
+    EXPECT(extent_count < 16);
+
+    EXPECT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    for (size_t offset = 0; offset < file_size; offset += chunk_size) {
+        EXPECT_EQ(read(fd, chunk.data(), chunk_size), static_cast<ssize_t>(chunk_size));
+        EXPECT_EQ(chunk[0], static_cast<u8>(offset / chunk_size));
+        EXPECT_EQ(chunk[chunk_size - 1], static_cast<u8>(offset / chunk_size));
+    }
+}
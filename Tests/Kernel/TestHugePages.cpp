@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/ScopeGuard.h>
+#include <LibCore/File.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr size_t huge_page_size = 2 * MiB;
+
+struct HugePageCounters {
+    u64 mapped { 0 };
+    u64 allocations { 0 };
+};
+
+static HugePageCounters read_huge_page_counters()
+{
+    auto file = MUST(Core::File::open("/sys/kernel/memstat"sv, Core::File::OpenMode::Read));
+    auto contents = MUST(file->read_until_eof());
+    auto json = MUST(JsonValue::from_string(contents));
+    auto const& object = json.as_object();
+    return {
+        .mapped = object.get_u64("huge_pages_mapped"sv).value_or(0),
+        .allocations = object.get_u64("huge_page_allocations"sv).value_or(0),
+    };
+}
+
+static u8* map_huge(size_t size)
+{
+    auto* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGE, -1, 0);
+    VERIFY(ptr != MAP_FAILED);
+    return static_cast<u8*>(ptr);
+}
+
+// Huge pages are allocated when they're mapped, but if physical memory is too fragmented, the mapping quietly
+// falls back to regular pages. There's no huge page to look at then.
+static bool got_huge_page(HugePageCounters const& before)
+{
+    return read_huge_page_counters().allocations > before.allocations;
+}
+
+static void fill_pages(u8* ptr, size_t size, u8 value)
+{
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+        ptr[offset] = value;
+}
+
+static bool pages_are_filled_with(u8 const* ptr, size_t size, u8 value)
+{
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        if (ptr[offset] != value)
+            return false;
+    }
+    return true;
+}
+
+TEST_CASE(huge_mapping_is_aligned_and_rounded_up)
+{
+    // Something that's neither a multiple of the huge page size nor of the regular one.
+    static constexpr size_t requested_size = huge_page_size + 3 * MiB + 123;
+    static constexpr size_t rounded_size = 3 * huge_page_size;
+
+    auto* ptr = map_huge(requested_size);
+    EXPECT_EQ(reinterpret_cast<FlatPtr>(ptr) % huge_page_size, 0u);
+
+    // All of the rounded up size belongs to the mapping, so none of this faults.
+    fill_pages(ptr, rounded_size, 0x42);
+    ptr[rounded_size - 1] = 0x42;
+    EXPECT(pages_are_filled_with(ptr, rounded_size, 0x42));
+
+    EXPECT_EQ(munmap(ptr, rounded_size), 0);
+}
+
+TEST_CASE(huge_mapping_rejects_what_it_cannot_provide)
+{
+    // A fixed address has to be huge page aligned.
+    auto* aligned = map_huge(huge_page_size);
+    EXPECT_EQ(munmap(aligned, huge_page_size), 0);
+    auto* misaligned = aligned + PAGE_SIZE;
+    EXPECT_EQ(mmap(misaligned, huge_page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_HUGE, -1, 0), MAP_FAILED);
+    EXPECT_EQ(errno, EINVAL);
+
+    // Huge pages are allocated up front, so they can't be lazily committed.
+    EXPECT_EQ(mmap(nullptr, huge_page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_HUGE, -1, 0), MAP_FAILED);
+    EXPECT_EQ(errno, EINVAL);
+
+    int fd = open("/bin/SystemServer", O_RDONLY);
+    VERIFY(fd >= 0);
+    ScopeGuard close_fd = [&] { close(fd); };
+    EXPECT_EQ(mmap(nullptr, huge_page_size, PROT_READ, MAP_PRIVATE | MAP_HUGE, fd, 0), MAP_FAILED);
+    EXPECT_EQ(errno, EINVAL);
+}
+
+TEST_CASE(huge_page_counters_follow_the_mapping)
+{
+    auto before = read_huge_page_counters();
+    auto* ptr = map_huge(huge_page_size);
+    ScopeGuard unmap = [&] { munmap(ptr, huge_page_size); };
+    if (!got_huge_page(before)) {
+        SKIP("Physical memory is too fragmented for a huge page");
+        return;
+    }
+
+    fill_pages(ptr, huge_page_size, 0x42);
+    auto while_mapped = read_huge_page_counters();
+    EXPECT(while_mapped.mapped > before.mapped);
+
+    EXPECT_EQ(munmap(ptr, huge_page_size), 0);
+    auto after_unmap = read_huge_page_counters();
+    EXPECT(after_unmap.mapped < while_mapped.mapped);
+}
+
+TEST_CASE(huge_page_is_private_after_fork)
+{
+    auto before = read_huge_page_counters();
+    auto* ptr = map_huge(huge_page_size);
+    ScopeGuard unmap = [&] { munmap(ptr, huge_page_size); };
+    if (!got_huge_page(before)) {
+        SKIP("Physical memory is too fragmented for a huge page");
+        return;
+    }
+    fill_pages(ptr, huge_page_size, 'p');
+
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+
+    // Both sides write into the shared huge page, which has to be split up on the copy-on-write fault.
+    pid_t pid = fork();
+    VERIFY(pid >= 0);
+    if (pid == 0) {
+        close(pipe_fds[1]);
+        char c;
+        VERIFY(read(pipe_fds[0], &c, 1) == 1);
+        // The parent has written to the first page by now, which we mustn't see.
+        bool ok = pages_are_filled_with(ptr, huge_page_size, 'p');
+        ptr[PAGE_SIZE] = 'c';
+        ok = ok && ptr[PAGE_SIZE] == 'c' && ptr[0] == 'p';
+        _exit(ok ? 0 : 1);
+    }
+
+    close(pipe_fds[0]);
+    ptr[0] = 'P';
+    VERIFY(write(pipe_fds[1], "x", 1) == 1);
+    close(pipe_fds[1]);
+
+    int status = 0;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    EXPECT_EQ(ptr[0], 'P');
+    EXPECT(pages_are_filled_with(ptr + PAGE_SIZE, huge_page_size - PAGE_SIZE, 'p'));
+}
+
+TEST_CASE(mprotect_and_munmap_single_page_inside_huge_page)
+{
+    auto before = read_huge_page_counters();
+    auto* ptr = map_huge(huge_page_size);
+    ScopeGuard unmap = [&] { munmap(ptr, huge_page_size); };
+    if (!got_huge_page(before)) {
+        SKIP("Physical memory is too fragmented for a huge page");
+        return;
+    }
+    fill_pages(ptr, huge_page_size, 0x42);
+    auto while_whole = read_huge_page_counters();
+
+    // A single page can't have permissions of its own in a huge page, so the huge page has to be split up.
+    auto* read_only_page = ptr + 10 * PAGE_SIZE;
+    EXPECT_EQ(mprotect(read_only_page, PAGE_SIZE, PROT_READ), 0);
+    EXPECT(read_huge_page_counters().mapped < while_whole.mapped);
+
+    EXPECT_EQ(read_only_page[0], 0x42);
+    EXPECT_CRASH_WITH_SIGNAL("Writing to the read-only page", SIGSEGV, [&] {
+        read_only_page[0] = 0;
+        return Test::Crash::Failure::DidNotCrash;
+    });
+    auto* page_before = read_only_page - PAGE_SIZE;
+    auto* page_after = read_only_page + PAGE_SIZE;
+    page_before[0] = 0x43;
+    page_after[0] = 0x43;
+
+    auto* unmapped_page = ptr + 20 * PAGE_SIZE;
+    EXPECT_EQ(munmap(unmapped_page, PAGE_SIZE), 0);
+    EXPECT_CRASH_WITH_SIGNAL("Reading from the unmapped page", SIGSEGV, [&] {
+        (void)*static_cast<u8 volatile*>(unmapped_page);
+        return Test::Crash::Failure::DidNotCrash;
+    });
+
+    // Everything around them is still there, and untouched.
+    EXPECT_EQ(page_before[0], 0x43);
+    EXPECT_EQ(page_after[0], 0x43);
+    EXPECT(pages_are_filled_with(ptr, 9 * PAGE_SIZE, 0x42));
+    EXPECT(pages_are_filled_with(ptr + 12 * PAGE_SIZE, 8 * PAGE_SIZE, 0x42));
+    EXPECT(pages_are_filled_with(unmapped_page + PAGE_SIZE, huge_page_size - 21 * PAGE_SIZE, 0x42));
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Array.h>
+#include <AK/ScopeGuard.h>
+#include <LibCore/IORing.h>
+#include <LibCore/System.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr size_t benchmark_operation_count = 100'000;
+static constexpr size_t benchmark_read_size = 64;
+
+TEST_CASE(nop_round_trip)
+{
+    auto ring = MUST(Core::IORing::create(8));
+    EXPECT_EQ(ring->submission_entries(), 8u);
+
+    for (u64 i = 0; i < 5; ++i)
+        EXPECT(ring->queue_nop(i));
+    EXPECT_EQ(ring->pending_submission_count(), 5u);
+    EXPECT(!ring->next_completion().has_value());
+
+    EXPECT_EQ(MUST(ring->submit()), 5u);
+    EXPECT_EQ(ring->pending_submission_count(), 0u);
+
+    for (u64 i = 0; i < 5; ++i) {
+        auto completion = ring->next_completion();
+        EXPECT(completion.has_value());
+        EXPECT_EQ(completion->user_data, i);
+        EXPECT_EQ(completion->result, 0);
+    }
+    EXPECT(!ring->next_completion().has_value());
+}
+
+TEST_CASE(entries_are_rounded_up)
+{
+    auto ring = MUST(Core::IORing::create(5));
+    EXPECT_EQ(ring->submission_entries(), 8u);
+
+    EXPECT(Core::System::io_ring_setup(0, 0).is_error());
+    EXPECT(Core::System::io_ring_setup(IO_RING_MAX_ENTRIES + 1, 0).is_error());
+}
+
+TEST_CASE(full_submission_queue)
+{
+    auto ring = MUST(Core::IORing::create(4));
+    for (u64 i = 0; i < 4; ++i)
+        EXPECT(ring->queue_nop(i));
+    EXPECT(!ring->queue_nop(4));
+
+    EXPECT_EQ(MUST(ring->submit()), 4u);
+    EXPECT(ring->queue_nop(4));
+}
+
+TEST_CASE(full_completion_queue)
+{
+    auto ring = MUST(Core::IORing::create(4));
+
+    // The completion queue has room for two full submission queues.
+    for (size_t round = 0; round < 2; ++round) {
+        for (u64 i = 0; i < 4; ++i)
+            EXPECT(ring->queue_nop(i));
+        EXPECT_EQ(MUST(ring->submit()), 4u);
+    }
+
+    for (u64 i = 0; i < 4; ++i)
+        EXPECT(ring->queue_nop(i));
+    auto result = ring->submit();
+    EXPECT(result.is_error());
+    EXPECT_EQ(result.error().code(), EBUSY);
+
+    // Once there's room again, the queued submissions go through.
+    EXPECT(ring->next_completion().has_value());
+    EXPECT(ring->next_completion().has_value());
+    EXPECT_EQ(MUST(ring->submit()), 2u);
+}
+
+TEST_CASE(write_and_read_file)
+{
+    static constexpr auto TEST_FILE_PATH = "/tmp/io-ring-test";
+
+    int fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd >= 0);
+    auto cleanup_guard = ScopeGuard([&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    });
+
+    auto ring = MUST(Core::IORing::create(16));
+
+    // Write the chunks back to front, each at its own offset.
+    Array<Array<u8, 512>, 8> chunks;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].fill(static_cast<u8>('a' + i));
+        EXPECT(ring->queue_write(fd, chunks[i], static_cast<off_t>((chunks.size() - 1 - i) * chunks[i].size()), i));
+    }
+    EXPECT(ring->queue_fsync(fd, chunks.size()));
+    EXPECT_EQ(MUST(ring->submit()), chunks.size() + 1);
+
+    for (size_t i = 0; i < chunks.size() + 1; ++i) {
+        auto completion = ring->next_completion();
+        EXPECT(completion.has_value());
+        EXPECT_EQ(completion->user_data, i);
+        EXPECT_EQ(completion->result, i < chunks.size() ? 512 : 0);
+    }
+
+    // Without an offset, reads continue where the previous one left off.
+    Array<Array<u8, 512>, 8> read_chunks;
+    for (size_t i = 0; i < read_chunks.size(); ++i)
+        EXPECT(ring->queue_read(fd, read_chunks[i], {}, i));
+    EXPECT_EQ(MUST(ring->submit()), read_chunks.size());
+
+    for (size_t i = 0; i < read_chunks.size(); ++i) {
+        auto completion = ring->next_completion();
+        EXPECT(completion.has_value());
+        EXPECT_EQ(completion->result, 512);
+        EXPECT_EQ(read_chunks[i][0], static_cast<u8>('a' + chunks.size() - 1 - i));
+        EXPECT_EQ(read_chunks[i][511], static_cast<u8>('a' + chunks.size() - 1 - i));
+    }
+
+    EXPECT(ring->queue_read(fd, read_chunks[0], {}, 0));
+    EXPECT_EQ(MUST(ring->submit()), 1u);
+    EXPECT_EQ(ring->next_completion()->result, 0);
+}
+
+TEST_CASE(errors_are_reported_in_completions)
+{
+    auto ring = MUST(Core::IORing::create(8));
+    Array<u8, 16> buffer;
+
+    EXPECT(ring->queue_read(-1, buffer, {}, 1));
+    EXPECT(ring->queue_nop(2));
+    EXPECT(ring->queue_read(STDIN_FILENO, { reinterpret_cast<u8*>(0xc0000000'00000000), 16 }, {}, 3));
+
+    int listening_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    VERIFY(listening_fd >= 0);
+    ScopeGuard close_socket = [&] { close(listening_fd); };
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(bind(listening_fd, (sockaddr*)&address, sizeof(address)), 0);
+    EXPECT_EQ(listen(listening_fd, 1), 0);
+    EXPECT(ring->queue_accept(listening_fd, nullptr, nullptr, 0, 4));
+
+    EXPECT_EQ(MUST(ring->submit()), 4u);
+    EXPECT_EQ(ring->next_completion()->result, -EBADF);
+    // A failing operation doesn't hold up the ones after it.
+    EXPECT_EQ(ring->next_completion()->result, 0);
+    EXPECT_EQ(ring->next_completion()->result, -EFAULT);
+    EXPECT_EQ(ring->next_completion()->result, -EAGAIN);
+}
+
+TEST_CASE(blocking_file_descriptors_dont_hold_up_the_ring)
+{
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard close_pipe = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    };
+
+    auto ring = MUST(Core::IORing::create(8));
+    Array<u8, 16> buffer;
+
+    // The pipe is blocking and empty, but the read must not wait for it.
+    EXPECT(ring->queue_read(pipe_fds[0], buffer, {}, 1));
+    EXPECT(ring->queue_nop(2));
+    EXPECT_EQ(MUST(ring->submit()), 2u);
+    EXPECT_EQ(ring->next_completion()->result, -EAGAIN);
+    EXPECT_EQ(ring->next_completion()->result, 0);
+
+    EXPECT_EQ(write(pipe_fds[1], "hello", 5), 5);
+    EXPECT(ring->queue_read(pipe_fds[0], buffer, {}, 3));
+    EXPECT_EQ(MUST(ring->submit()), 1u);
+    EXPECT_EQ(ring->next_completion()->result, 5);
+}
+
+BENCHMARK_CASE(small_reads_with_read)
+{
+    int fd = open("/dev/zero", O_RDONLY);
+    VERIFY(fd >= 0);
+    ScopeGuard close_fd = [&] { close(fd); };
+
+    Array<u8, benchmark_read_size> buffer;
+    for (size_t i = 0; i < benchmark_operation_count; ++i)
+        EXPECT_EQ(read(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(buffer.size()));
+}
+
+BENCHMARK_CASE(small_reads_with_io_ring)
+{
+    int fd = open("/dev/zero", O_RDONLY);
+    VERIFY(fd >= 0);
+    ScopeGuard close_fd = [&] { close(fd); };
+
+    auto ring = MUST(Core::IORing::create(256));
+    Array<u8, benchmark_read_size> buffer;
+    size_t completed = 0;
+    size_t queued = 0;
+    while (completed < benchmark_operation_count) {
+        while (queued < benchmark_operation_count && ring->queue_read(fd, buffer, {}, queued))
+            ++queued;
+        MUST(ring->submit());
+        for (auto completion = ring->next_completion(); completion.has_value(); completion = ring->next_completion()) {
+            EXPECT_EQ(completion->result, static_cast<i64>(buffer.size()));
+            ++completed;
+        }
+    }
+}
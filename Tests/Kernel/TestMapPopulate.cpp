@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/ScopeGuard.h>
+#include <LibCore/File.h>
+#include <LibCore/ProcessStatisticsReader.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr size_t page_count = 64;
+static constexpr size_t mapping_size = page_count * PAGE_SIZE;
+
+// How much of the region at the given address is backed by actual pages, rather than by nothing or the shared zero page.
+static size_t resident_bytes_of_region(void const* address)
+{
+    auto file = MUST(Core::File::open("/proc/self/vm"sv, Core::File::OpenMode::Read));
+    auto contents = MUST(file->read_until_eof());
+    auto json = MUST(JsonValue::from_string(contents));
+    Optional<size_t> resident_bytes;
+    json.as_array().for_each([&](JsonValue const& value) {
+        auto const& region = value.as_object();
+        if (region.get_u64("address"sv).value_or(0) == reinterpret_cast<FlatPtr>(address))
+            resident_bytes = region.get_u64("amount_resident"sv).value_or(0);
+    });
+    VERIFY(resident_bytes.has_value());
+    return resident_bytes.value();
+}
+
+struct FaultCounts {
+    unsigned inode_faults { 0 };
+    unsigned zero_faults { 0 };
+};
+
+static FaultCounts fault_counts_of_current_thread()
+{
+    auto statistics = MUST(Core::ProcessStatisticsReader::get_all(false));
+    for (auto& process : statistics.processes) {
+        if (process.pid != getpid())
+            continue;
+        for (auto& thread : process.threads) {
+            if (thread.tid == gettid())
+                return { thread.inode_faults, thread.zero_faults };
+        }
+    }
+    VERIFY_NOT_REACHED();
+}
+
+// Reading the statistics may fault in a few pages of its own, but nowhere near one per page of the mapping.
+static constexpr unsigned tolerated_fault_count = 4;
+
+static u8 byte_at(size_t offset)
+{
+    return static_cast<u8>(offset / PAGE_SIZE + 1);
+}
+
+static int create_test_file(char const* path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd >= 0);
+    u8 page[PAGE_SIZE];
+    for (size_t offset = 0; offset < mapping_size; offset += PAGE_SIZE) {
+        memset(page, byte_at(offset), sizeof(page));
+        VERIFY(write(fd, page, sizeof(page)) == sizeof(page));
+    }
+    return fd;
+}
+
+TEST_CASE(populate_anonymous_memory)
+{
+    auto* ptr = static_cast<u8*>(mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_POPULATE, -1, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ScopeGuard unmap = [&] { munmap(ptr, mapping_size); };
+    EXPECT_EQ(resident_bytes_of_region(ptr), mapping_size);
+
+    auto before = fault_counts_of_current_thread();
+    for (size_t offset = 0; offset < mapping_size; offset += PAGE_SIZE) {
+        EXPECT_EQ(ptr[offset], 0);
+        ptr[offset] = byte_at(offset);
+    }
+    auto after = fault_counts_of_current_thread();
+    EXPECT(after.zero_faults - before.zero_faults < tolerated_fault_count);
+}
+
+TEST_CASE(populate_anonymous_memory_without_reservation)
+{
+    // Without a reservation, the memory is populated after it's mapped instead of being committed up front.
+    auto* ptr = static_cast<u8*>(mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_POPULATE, -1, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ScopeGuard unmap = [&] { munmap(ptr, mapping_size); };
+    EXPECT_EQ(resident_bytes_of_region(ptr), mapping_size);
+
+    for (size_t offset = 0; offset < mapping_size; offset += PAGE_SIZE)
+        EXPECT_EQ(ptr[offset], 0);
+}
+
+TEST_CASE(populate_file_mapping)
+{
+    static constexpr auto TEST_FILE_PATH = "/tmp/.map_populate_test";
+    int fd = create_test_file(TEST_FILE_PATH);
+    ScopeGuard remove_file = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    auto* ptr = static_cast<u8 const*>(mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ScopeGuard unmap = [&] { munmap(const_cast<u8*>(ptr), mapping_size); };
+
+    // All of the file has been read in before we've looked at any of it.
+    EXPECT_EQ(resident_bytes_of_region(ptr), mapping_size);
+
+    auto before = fault_counts_of_current_thread();
+    for (size_t offset = 0; offset < mapping_size; offset += PAGE_SIZE)
+        EXPECT_EQ(ptr[offset], byte_at(offset));
+    auto after = fault_counts_of_current_thread();
+    EXPECT(after.inode_faults - before.inode_faults < tolerated_fault_count);
+}
+
+TEST_CASE(willneed_spans_several_regions_and_skips_inaccessible_ones)
+{
+    static constexpr auto TEST_FILE_PATH = "/tmp/.madv_willneed_test";
+    int fd = create_test_file(TEST_FILE_PATH);
+    ScopeGuard remove_file = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    auto* ptr = static_cast<u8*>(mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ScopeGuard unmap = [&] { munmap(ptr, mapping_size); };
+    EXPECT_EQ(resident_bytes_of_region(ptr), 0u);
+
+    // Taking away access to the middle part splits the mapping into three regions.
+    static constexpr size_t part_size = mapping_size / 4;
+    auto* first_part = ptr;
+    auto* inaccessible_part = ptr + part_size;
+    auto* last_part = ptr + 2 * part_size;
+    EXPECT_EQ(mprotect(inaccessible_part, part_size, PROT_NONE), 0);
+
+    EXPECT_EQ(madvise(ptr, mapping_size, MADV_WILLNEED), 0);
+    EXPECT_EQ(resident_bytes_of_region(first_part), part_size);
+    EXPECT_EQ(resident_bytes_of_region(inaccessible_part), 0u);
+    EXPECT_EQ(resident_bytes_of_region(last_part), mapping_size - 2 * part_size);
+
+    auto before = fault_counts_of_current_thread();
+    for (size_t offset = 0; offset < mapping_size; offset += PAGE_SIZE) {
+        if (offset < part_size || offset >= 2 * part_size)
+            EXPECT_EQ(ptr[offset], byte_at(offset));
+    }
+    auto after = fault_counts_of_current_thread();
+    EXPECT(after.inode_faults - before.inode_faults < tolerated_fault_count);
+
+    EXPECT_CRASH_WITH_SIGNAL("Reading from the inaccessible part", SIGSEGV, [&] {
+        (void)*static_cast<u8 volatile*>(inaccessible_part);
+        return Test::Crash::Failure::DidNotCrash;
+    });
+}
+
+TEST_CASE(populate_inaccessible_file_mapping)
+{
+    static constexpr auto TEST_FILE_PATH = "/tmp/.map_populate_prot_none_test";
+    int fd = create_test_file(TEST_FILE_PATH);
+    ScopeGuard remove_file = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    auto* ptr = static_cast<u8*>(mmap(nullptr, mapping_size, PROT_NONE, MAP_PRIVATE | MAP_POPULATE, fd, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ScopeGuard unmap = [&] { munmap(ptr, mapping_size); };
+
+    // Nothing could ever be faulted in here, so nothing is read in either.
+    EXPECT_EQ(resident_bytes_of_region(ptr), 0u);
+    EXPECT_CRASH_WITH_SIGNAL("Reading from the inaccessible mapping", SIGSEGV, [&] {
+        (void)*static_cast<u8 volatile*>(ptr);
+        return Test::Crash::Failure::DidNotCrash;
+    });
+}
+
+TEST_CASE(willneed_over_unmapped_hole)
+{
+    auto* ptr = static_cast<u8*>(mmap(nullptr, 3 * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ScopeGuard unmap = [&] { munmap(ptr, 3 * PAGE_SIZE); };
+    EXPECT_EQ(munmap(ptr + PAGE_SIZE, PAGE_SIZE), 0);
+
+    EXPECT_EQ(madvise(ptr, 3 * PAGE_SIZE, MADV_WILLNEED), -1);
+    EXPECT_EQ(errno, ENOMEM);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/ScopeGuard.h>
+#include <LibCore/File.h>
+#include <LibTest/TestCase.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// NOTE: /tmp isn't on Ext2FS, which is the file system that uses the page cache.
+static constexpr auto TEST_FILE_PATH = "/home/anon/.page_cache_test";
+static constexpr size_t test_file_size = 4 * PAGE_SIZE;
+
+static int create_test_file(char fill)
+{
+    int fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd >= 0);
+    u8 buffer[test_file_size];
+    memset(buffer, fill, sizeof(buffer));
+    VERIFY(write(fd, buffer, sizeof(buffer)) == static_cast<ssize_t>(sizeof(buffer)));
+    return fd;
+}
+
+static size_t cached_page_count()
+{
+    auto file = MUST(Core::File::open("/sys/kernel/memstat"sv, Core::File::OpenMode::Read));
+    auto json = MUST(JsonValue::from_string(MUST(file->read_until_eof())));
+    return json.as_object().get_u64("page_cache_cached"sv).value();
+}
+
+static u8 read_byte_at(int fd, off_t offset)
+{
+    u8 byte = 0;
+    VERIFY(pread(fd, &byte, 1, offset) == 1);
+    return byte;
+}
+
+TEST_CASE(write_is_visible_through_shared_mapping)
+{
+    int fd = create_test_file('A');
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    auto* ptr = static_cast<u8*>(mmap(nullptr, test_file_size, PROT_READ, MAP_SHARED, fd, 0));
+    VERIFY(ptr != MAP_FAILED);
+    EXPECT_EQ(ptr[PAGE_SIZE + 10], 'A');
+
+    EXPECT_EQ(pwrite(fd, "B", 1, PAGE_SIZE + 10), 1);
+    EXPECT_EQ(ptr[PAGE_SIZE + 10], 'B');
+
+    EXPECT_EQ(munmap(ptr, test_file_size), 0);
+}
+
+TEST_CASE(shared_mapping_writes_are_visible_to_read)
+{
+    int fd = create_test_file('A');
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    auto* ptr = static_cast<u8*>(mmap(nullptr, test_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    VERIFY(ptr != MAP_FAILED);
+
+    // Both go through the same page, so there's no need for msync() in between.
+    ptr[2 * PAGE_SIZE + 5] = 'X';
+    EXPECT_EQ(read_byte_at(fd, 2 * PAGE_SIZE + 5), 'X');
+
+    EXPECT_EQ(munmap(ptr, test_file_size), 0);
+    EXPECT_EQ(read_byte_at(fd, 2 * PAGE_SIZE + 5), 'X');
+}
+
+TEST_CASE(private_mapping_writes_stay_private)
+{
+    int fd = create_test_file('A');
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    // Make sure the page is cached before the private mapping gets to it.
+    EXPECT_EQ(read_byte_at(fd, 7), 'A');
+
+    auto* private_ptr = static_cast<u8*>(mmap(nullptr, test_file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0));
+    VERIFY(private_ptr != MAP_FAILED);
+    auto* shared_ptr = static_cast<u8*>(mmap(nullptr, test_file_size, PROT_READ, MAP_SHARED, fd, 0));
+    VERIFY(shared_ptr != MAP_FAILED);
+
+    EXPECT_EQ(private_ptr[7], 'A');
+    private_ptr[7] = 'P';
+    EXPECT_EQ(private_ptr[7], 'P');
+    EXPECT_EQ(shared_ptr[7], 'A');
+    EXPECT_EQ(read_byte_at(fd, 7), 'A');
+
+    EXPECT_EQ(munmap(private_ptr, test_file_size), 0);
+    EXPECT_EQ(munmap(shared_ptr, test_file_size), 0);
+}
+
+TEST_CASE(truncate_drops_stale_data)
+{
+    int fd = create_test_file('A');
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    EXPECT_EQ(read_byte_at(fd, 200), 'A');
+    EXPECT_EQ(ftruncate(fd, 100), 0);
+    EXPECT_EQ(ftruncate(fd, test_file_size), 0);
+
+    // What used to be there must not come back once the file grows again.
+    EXPECT_EQ(read_byte_at(fd, 99), 'A');
+    EXPECT_EQ(read_byte_at(fd, 200), 0);
+    EXPECT_EQ(read_byte_at(fd, 3 * PAGE_SIZE), 0);
+}
+
+// Large enough that whatever else happens on the system can't make up for the pages we expect to come and go.
+static constexpr size_t large_test_file_page_count = 256;
+
+static int create_large_test_file()
+{
+    int fd = open(TEST_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd >= 0);
+    // Read-ahead would fill the page cache in the background, which would throw off the counts.
+    VERIFY(posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM) == 0);
+    u8 buffer[PAGE_SIZE];
+    for (size_t i = 0; i < large_test_file_page_count; ++i) {
+        memset(buffer, 'A' + i % 26, sizeof(buffer));
+        VERIFY(write(fd, buffer, sizeof(buffer)) == static_cast<ssize_t>(sizeof(buffer)));
+    }
+    return fd;
+}
+
+static void read_whole_file(int fd)
+{
+    u8 buffer[PAGE_SIZE];
+    for (size_t i = 0; i < large_test_file_page_count; ++i) {
+        VERIFY(pread(fd, buffer, sizeof(buffer), i * PAGE_SIZE) == static_cast<ssize_t>(sizeof(buffer)));
+        EXPECT_EQ(buffer[0], 'A' + i % 26);
+    }
+}
+
+TEST_CASE(dont_need_drops_cached_pages)
+{
+    int fd = create_large_test_file();
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+    read_whole_file(fd);
+
+    auto cached_before = cached_page_count();
+    EXPECT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+    auto cached_after = cached_page_count();
+    EXPECT(cached_after + large_test_file_page_count / 2 <= cached_before);
+
+    // Dropping pages only costs us a trip to the disk, the data is still all there.
+    read_whole_file(fd);
+}
+
+TEST_CASE(dont_need_keeps_mapped_pages)
+{
+    int fd = create_test_file('A');
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+
+    auto* ptr = static_cast<u8*>(mmap(nullptr, test_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    VERIFY(ptr != MAP_FAILED);
+    ptr[PAGE_SIZE + 1] = 'M';
+
+    // The mapping still uses the page, so read() has to keep seeing what was written through it.
+    EXPECT_EQ(posix_fadvise(fd, 0, test_file_size, POSIX_FADV_DONTNEED), 0);
+    EXPECT_EQ(read_byte_at(fd, PAGE_SIZE + 1), 'M');
+    EXPECT_EQ(ptr[PAGE_SIZE + 1], 'M');
+
+    EXPECT_EQ(munmap(ptr, test_file_size), 0);
+}
+
+TEST_CASE(no_reuse_doesnt_fill_the_page_cache)
+{
+    int fd = create_large_test_file();
+    ScopeGuard cleanup = [&] {
+        close(fd);
+        unlink(TEST_FILE_PATH);
+    };
+    EXPECT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+
+    EXPECT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE), 0);
+    auto cached_before = cached_page_count();
+    read_whole_file(fd);
+    auto cached_after = cached_page_count();
+    EXPECT(cached_after < cached_before + large_test_file_page_count / 2);
+}
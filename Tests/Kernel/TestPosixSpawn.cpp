@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/ByteString.h>
+#include <AK/ScopeGuard.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr size_t benchmark_spawn_count = 200;
+
+static int wait_for_exit_status(pid_t pid)
+{
+    int status = 0;
+    VERIFY(waitpid(pid, &status, 0) == pid);
+    VERIFY(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+static ByteString read_file(char const* path)
+{
+    int fd = open(path, O_RDONLY);
+    VERIFY(fd >= 0);
+    ScopeGuard close_fd = [&] { close(fd); };
+
+    char buffer[256];
+    auto nread = read(fd, buffer, sizeof(buffer));
+    VERIFY(nread >= 0);
+    return ByteString(buffer, nread);
+}
+
+TEST_CASE(spawn_and_wait)
+{
+    char const* argv[] = { "/bin/true", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawn(&pid, "/bin/true", nullptr, nullptr, const_cast<char**>(argv), environ), 0);
+    EXPECT(pid > 0);
+    EXPECT_EQ(wait_for_exit_status(pid), 0);
+}
+
+TEST_CASE(exec_errors_are_returned_to_the_parent)
+{
+    char const* argv[] = { "/bin/does-not-exist", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawn(&pid, "/bin/does-not-exist", nullptr, nullptr, const_cast<char**>(argv), environ), ENOENT);
+    EXPECT_EQ(pid, 0);
+
+    char const* argvp[] = { "does-not-exist", nullptr };
+    EXPECT_EQ(posix_spawnp(&pid, "does-not-exist", nullptr, nullptr, const_cast<char**>(argvp), environ), ENOENT);
+    EXPECT_EQ(pid, 0);
+}
+
+TEST_CASE(spawnp_searches_path)
+{
+    char const* argv[] = { "true", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawnp(&pid, "true", nullptr, nullptr, const_cast<char**>(argv), environ), 0);
+    EXPECT_EQ(wait_for_exit_status(pid), 0);
+}
+
+TEST_CASE(file_actions_open_and_chdir)
+{
+    char const* output_path = "/tmp/posix-spawn-test-output";
+    ScopeGuard remove_output = [&] { unlink(output_path); };
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    ScopeGuard destroy_file_actions = [&] { posix_spawn_file_actions_destroy(&file_actions); };
+    posix_spawn_file_actions_addopen(&file_actions, STDOUT_FILENO, output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_addchdir(&file_actions, "/usr");
+
+    char const* argv[] = { "/bin/pwd", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawn(&pid, "/bin/pwd", &file_actions, nullptr, const_cast<char**>(argv), environ), 0);
+    EXPECT_EQ(wait_for_exit_status(pid), 0);
+    EXPECT_EQ(read_file(output_path), "/usr\n"sv);
+}
+
+TEST_CASE(file_actions_dup2_and_close)
+{
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard close_read_end = [&] { close(pipe_fds[0]); };
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    ScopeGuard destroy_file_actions = [&] { posix_spawn_file_actions_destroy(&file_actions); };
+    posix_spawn_file_actions_adddup2(&file_actions, pipe_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&file_actions, pipe_fds[1]);
+    posix_spawn_file_actions_addclose(&file_actions, pipe_fds[0]);
+
+    char const* argv[] = { "/bin/echo", "hello", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawn(&pid, "/bin/echo", &file_actions, nullptr, const_cast<char**>(argv), environ), 0);
+    close(pipe_fds[1]);
+    EXPECT_EQ(wait_for_exit_status(pid), 0);
+
+    char buffer[16];
+    auto nread = read(pipe_fds[0], buffer, sizeof(buffer));
+    EXPECT_EQ(nread, 6);
+    EXPECT_EQ(StringView(buffer, 6), "hello\n"sv);
+    // The child didn't keep a second copy of the write end around, so this is the end of the pipe.
+    EXPECT_EQ(read(pipe_fds[0], buffer, sizeof(buffer)), 0);
+}
+
+TEST_CASE(failing_file_action_fails_the_spawn)
+{
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    ScopeGuard destroy_file_actions = [&] { posix_spawn_file_actions_destroy(&file_actions); };
+    posix_spawn_file_actions_addclose(&file_actions, 1000);
+
+    char const* argv[] = { "/bin/true", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawn(&pid, "/bin/true", &file_actions, nullptr, const_cast<char**>(argv), environ), EBADF);
+    EXPECT_EQ(pid, 0);
+}
+
+TEST_CASE(signal_mask_attribute)
+{
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard close_write_end = [&] { close(pipe_fds[1]); };
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    ScopeGuard destroy_file_actions = [&] { posix_spawn_file_actions_destroy(&file_actions); };
+    posix_spawn_file_actions_adddup2(&file_actions, pipe_fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&file_actions, pipe_fds[0]);
+    posix_spawn_file_actions_addclose(&file_actions, pipe_fds[1]);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    ScopeGuard destroy_attr = [&] { posix_spawnattr_destroy(&attr); };
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    char const* argv[] = { "/bin/cat", nullptr };
+    pid_t pid = 0;
+    EXPECT_EQ(posix_spawn(&pid, "/bin/cat", &file_actions, &attr, const_cast<char**>(argv), environ), 0);
+    close(pipe_fds[0]);
+
+    // The signal stays pending, so cat only exits once its input ends.
+    EXPECT_EQ(kill(pid, SIGTERM), 0);
+    close(pipe_fds[1]);
+    pipe_fds[1] = -1;
+
+    int status = 0;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+}
+
+BENCHMARK_CASE(spawn_with_fork_and_exec)
+{
+    char const* argv[] = { "/bin/true", nullptr };
+    for (size_t i = 0; i < benchmark_spawn_count; ++i) {
+        pid_t pid = fork();
+        VERIFY(pid >= 0);
+        if (pid == 0) {
+            execve("/bin/true", const_cast<char**>(argv), environ);
+            _exit(127);
+        }
+        EXPECT_EQ(wait_for_exit_status(pid), 0);
+    }
+}
+
+BENCHMARK_CASE(spawn_with_posix_spawn)
+{
+    char const* argv[] = { "/bin/true", nullptr };
+    for (size_t i = 0; i < benchmark_spawn_count; ++i) {
+        pid_t pid = 0;
+        EXPECT_EQ(posix_spawn(&pid, "/bin/true", nullptr, nullptr, const_cast<char**>(argv), environ), 0);
+        EXPECT_EQ(wait_for_exit_status(pid), 0);
+    }
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Optional.h>
+#include <AK/ScopeGuard.h>
+#include <AK/Vector.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/ProcessStatisticsReader.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+static u32 processor_count()
+{
+    auto count = sysconf(_SC_NPROCESSORS_ONLN);
+    VERIFY(count > 0);
+    return min(static_cast<u32>(count), static_cast<u32>(CPU_SETSIZE));
+}
+
+static cpu_set_t only_processor(u32 processor)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(processor, &set);
+    return set;
+}
+
+static ErrorOr<u32> processor_of_thread(pid_t tid)
+{
+    auto statistics = TRY(Core::ProcessStatisticsReader::get_all(false));
+    for (auto& process : statistics.processes) {
+        if (process.pid != getpid())
+            continue;
+        for (auto& thread : process.threads) {
+            if (thread.tid == tid)
+                return thread.cpu;
+        }
+    }
+    return Error::from_errno(ESRCH);
+}
+
+// A thread that does nothing but count, optionally pinned to a single processor.
+struct BusyThread {
+    static NonnullOwnPtr<BusyThread> start(Optional<u32> processor = {})
+    {
+        auto busy_thread = make<BusyThread>();
+        busy_thread->processor = processor;
+        VERIFY(pthread_create(&busy_thread->thread, nullptr, spin, busy_thread.ptr()) == 0);
+        while (busy_thread->tid.load() == 0)
+            sched_yield();
+        return busy_thread;
+    }
+
+    ~BusyThread()
+    {
+        should_stop.store(true);
+        VERIFY(pthread_join(thread, nullptr) == 0);
+    }
+
+    static void* spin(void* argument)
+    {
+        auto& self = *static_cast<BusyThread*>(argument);
+        if (self.processor.has_value()) {
+            auto affinity = only_processor(*self.processor);
+            VERIFY(sched_setaffinity(0, sizeof(affinity), &affinity) == 0);
+        }
+        self.tid.store(gettid());
+        while (!self.should_stop.load(AK::MemoryOrder::memory_order_relaxed))
+            self.iterations.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Optional<u32> processor;
+    pthread_t thread {};
+    Atomic<pid_t> tid { 0 };
+    Atomic<u64> iterations { 0 };
+    Atomic<bool> should_stop { false };
+};
+
+// Returns how many iterations per millisecond each of the threads managed over a while.
+static Vector<u64> measure_progress(Vector<NonnullOwnPtr<BusyThread>> const& threads)
+{
+    Vector<u64> iterations_at_start;
+    for (auto& thread : threads)
+        iterations_at_start.append(thread->iterations.load());
+
+    auto timer = Core::ElapsedTimer::start_new(Core::TimerType::Precise);
+    usleep(300'000);
+    auto elapsed_ms = static_cast<u64>(max(timer.elapsed_milliseconds(), 1));
+
+    Vector<u64> progress;
+    for (size_t i = 0; i < threads.size(); ++i)
+        progress.append((threads[i]->iterations.load() - iterations_at_start[i]) / elapsed_ms);
+    return progress;
+}
+
+TEST_CASE(affinity_is_validated_and_reported)
+{
+    cpu_set_t original_affinity;
+    EXPECT_EQ(sched_getaffinity(0, sizeof(original_affinity), &original_affinity), 0);
+    EXPECT_EQ(static_cast<u32>(CPU_COUNT(&original_affinity)), processor_count());
+    ScopeGuard restore_affinity = [&] {
+        VERIFY(sched_setaffinity(0, sizeof(original_affinity), &original_affinity) == 0);
+    };
+
+    auto last_processor = processor_count() - 1;
+    auto affinity = only_processor(last_processor);
+    EXPECT_EQ(sched_setaffinity(0, sizeof(affinity), &affinity), 0);
+
+    cpu_set_t reported_affinity;
+    EXPECT_EQ(sched_getaffinity(0, sizeof(reported_affinity), &reported_affinity), 0);
+    EXPECT_EQ(CPU_COUNT(&reported_affinity), 1);
+    EXPECT(CPU_ISSET(last_processor, &reported_affinity));
+
+    // By the time we're back from the syscall, we've left the processors we may no longer run on.
+    EXPECT_EQ(MUST(processor_of_thread(gettid())), last_processor);
+
+    cpu_set_t no_processors;
+    CPU_ZERO(&no_processors);
+    EXPECT_EQ(sched_setaffinity(0, sizeof(no_processors), &no_processors), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    if (processor_count() < CPU_SETSIZE) {
+        auto missing_processor = only_processor(processor_count());
+        EXPECT_EQ(sched_setaffinity(0, sizeof(missing_processor), &missing_processor), -1);
+        EXPECT_EQ(errno, EINVAL);
+    }
+}
+
+TEST_CASE(pinned_threads_run_on_their_processor)
+{
+    Vector<NonnullOwnPtr<BusyThread>> threads;
+    for (u32 processor = 0; processor < processor_count(); ++processor)
+        threads.append(BusyThread::start(processor));
+
+    usleep(100'000);
+    for (auto& thread : threads)
+        EXPECT_EQ(MUST(processor_of_thread(thread->tid.load())), *thread->processor);
+
+    // None of them may be starved by the others.
+    for (auto progress : measure_progress(threads))
+        EXPECT(progress > 0);
+}
+
+TEST_CASE(changing_affinity_moves_queued_and_running_threads)
+{
+    if (processor_count() < 2) {
+        SKIP("Can't move threads between processors with only one processor");
+        return;
+    }
+
+    // Only one of these can run on the first processor at a time, so when we
+    // move two of them, at least one was sitting in the queue rather than running.
+    Vector<NonnullOwnPtr<BusyThread>> threads;
+    for (size_t i = 0; i < 3; ++i)
+        threads.append(BusyThread::start(0));
+    usleep(50'000);
+
+    auto second_processor = only_processor(1);
+    for (size_t i = 0; i < 2; ++i)
+        EXPECT_EQ(sched_setaffinity(threads[i]->tid.load(), sizeof(second_processor), &second_processor), 0);
+
+    auto progress = measure_progress(threads);
+    for (size_t i = 0; i < threads.size(); ++i) {
+        EXPECT_EQ(MUST(processor_of_thread(threads[i]->tid.load())), i < 2 ? 1u : 0u);
+        EXPECT(progress[i] > 0);
+    }
+}
+
+TEST_CASE(busy_threads_spread_over_all_processors)
+{
+    // See how far a thread gets when it has a processor all to itself...
+    u64 progress_on_its_own;
+    {
+        Vector<NonnullOwnPtr<BusyThread>> threads;
+        threads.append(BusyThread::start());
+        progress_on_its_own = measure_progress(threads)[0];
+    }
+    EXPECT(progress_on_its_own > 0);
+
+    // ...then start one thread per processor. If they all end up on different
+    // processors they should each get about as far, while two threads sharing
+    // a processor would only get half as far.
+    Vector<NonnullOwnPtr<BusyThread>> threads;
+    for (u32 i = 0; i < min(processor_count(), 8u); ++i)
+        threads.append(BusyThread::start());
+    usleep(100'000);
+
+    auto progress = measure_progress(threads);
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (progress[i] * 10 < progress_on_its_own * 6)
+            warnln("Thread {} only got {} iterations/ms, on its own one got {}", i, progress[i], progress_on_its_own);
+        EXPECT(progress[i] * 10 >= progress_on_its_own * 6);
+    }
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/ByteBuffer.h>
+#include <AK/ByteString.h>
+#include <AK/ScopeGuard.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// NOTE: Files on Ext2FS are spliced straight out of the page cache, files in /tmp go through a splice buffer.
+static constexpr auto PAGE_CACHE_FILE_PATH = "/home/anon/.sendfile_test";
+static constexpr auto TMPFS_FILE_PATH = "/tmp/.sendfile_test";
+static constexpr size_t test_file_size = 3 * PAGE_SIZE + 100;
+// This is larger than what fits into a pipe.
+static constexpr size_t large_test_file_size = 128 * KiB;
+
+static u8 expected_byte_at(size_t offset)
+{
+    return static_cast<u8>(offset * 7 + offset / 251);
+}
+
+static int create_test_file(char const* path, size_t size)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(fd >= 0);
+    auto buffer = MUST(ByteBuffer::create_uninitialized(size));
+    for (size_t i = 0; i < size; ++i)
+        buffer[i] = expected_byte_at(i);
+    VERIFY(write(fd, buffer.data(), size) == static_cast<ssize_t>(size));
+    VERIFY(lseek(fd, 0, SEEK_SET) == 0);
+    return fd;
+}
+
+static void expect_data_from(int fd, size_t offset, size_t size)
+{
+    auto buffer = MUST(ByteBuffer::create_uninitialized(size));
+    size_t nread = 0;
+    while (nread < size) {
+        auto rc = read(fd, buffer.data() + nread, size - nread);
+        VERIFY(rc > 0);
+        nread += rc;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (buffer[i] != expected_byte_at(offset + i)) {
+            FAIL(ByteString::formatted("Byte {} is {}, expected {}", offset + i, buffer[i], expected_byte_at(offset + i)));
+            return;
+        }
+    }
+}
+
+static void test_file_to_socket(char const* path)
+{
+    int file_fd = create_test_file(path, test_file_size);
+    int fds[2];
+    VERIFY(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == 0);
+    ScopeGuard cleanup = [&] {
+        close(fds[0]);
+        close(fds[1]);
+        close(file_fd);
+        unlink(path);
+    };
+
+    EXPECT_EQ(sendfile(fds[0], file_fd, nullptr, test_file_size), static_cast<ssize_t>(test_file_size));
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(test_file_size));
+    expect_data_from(fds[1], 0, test_file_size);
+
+    // With an offset, that's what is advanced instead of the file offset.
+    off_t offset = 1000;
+    EXPECT_EQ(sendfile(fds[0], file_fd, &offset, 5000), 5000);
+    EXPECT_EQ(offset, 6000);
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(test_file_size));
+    expect_data_from(fds[1], 1000, 5000);
+
+    // At the end of the file, we only get what's there, and after that nothing at all.
+    offset = test_file_size - 10;
+    EXPECT_EQ(sendfile(fds[0], file_fd, &offset, 100), 10);
+    EXPECT_EQ(offset, static_cast<off_t>(test_file_size));
+    expect_data_from(fds[1], test_file_size - 10, 10);
+    EXPECT_EQ(sendfile(fds[0], file_fd, &offset, 100), 0);
+    EXPECT_EQ(sendfile(fds[0], file_fd, nullptr, 100), 0);
+}
+
+TEST_CASE(sendfile_file_to_socket)
+{
+    test_file_to_socket(PAGE_CACHE_FILE_PATH);
+    test_file_to_socket(TMPFS_FILE_PATH);
+}
+
+TEST_CASE(sendfile_rejects_unseekable_input)
+{
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    int fds[2];
+    VERIFY(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == 0);
+    ScopeGuard cleanup = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        close(fds[0]);
+        close(fds[1]);
+    };
+
+    EXPECT_EQ(sendfile(fds[0], pipe_fds[0], nullptr, 1), -1);
+    EXPECT_EQ(errno, EINVAL);
+}
+
+static void test_file_to_pipe(char const* path)
+{
+    int file_fd = create_test_file(path, test_file_size);
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard cleanup = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        close(file_fd);
+        unlink(path);
+    };
+
+    EXPECT_EQ(splice(file_fd, nullptr, pipe_fds[1], nullptr, test_file_size, 0), static_cast<ssize_t>(test_file_size));
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(test_file_size));
+    expect_data_from(pipe_fds[0], 0, test_file_size);
+
+    off_t offset = PAGE_SIZE - 10;
+    EXPECT_EQ(splice(file_fd, &offset, pipe_fds[1], nullptr, 20, 0), 20);
+    EXPECT_EQ(offset, static_cast<off_t>(PAGE_SIZE + 10));
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(test_file_size));
+    expect_data_from(pipe_fds[0], PAGE_SIZE - 10, 20);
+
+    EXPECT_EQ(splice(file_fd, nullptr, pipe_fds[1], nullptr, 100, 0), 0);
+}
+
+TEST_CASE(splice_file_to_pipe)
+{
+    test_file_to_pipe(PAGE_CACHE_FILE_PATH);
+    test_file_to_pipe(TMPFS_FILE_PATH);
+}
+
+TEST_CASE(splice_file_to_full_pipe_is_partial)
+{
+    int file_fd = create_test_file(PAGE_CACHE_FILE_PATH, large_test_file_size);
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard cleanup = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        close(file_fd);
+        unlink(PAGE_CACHE_FILE_PATH);
+    };
+
+    // The pipe fills up before all of the file is in there, so we get back what fit and the file offset says so.
+    auto ntransferred = splice(file_fd, nullptr, pipe_fds[1], nullptr, large_test_file_size, SPLICE_F_NONBLOCK);
+    EXPECT(ntransferred > 0);
+    EXPECT(ntransferred < static_cast<ssize_t>(large_test_file_size));
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(ntransferred));
+
+    // Now that nothing fits anymore, we don't wait for the pipe to drain.
+    EXPECT_EQ(splice(file_fd, nullptr, pipe_fds[1], nullptr, large_test_file_size, SPLICE_F_NONBLOCK), -1);
+    EXPECT_EQ(errno, EAGAIN);
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), static_cast<off_t>(ntransferred));
+
+    // The same goes for a non-blocking pipe.
+    EXPECT_EQ(fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK), 0);
+    EXPECT_EQ(splice(file_fd, nullptr, pipe_fds[1], nullptr, large_test_file_size, 0), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    expect_data_from(pipe_fds[0], 0, ntransferred);
+}
+
+TEST_CASE(splice_pipe_to_file)
+{
+    int source_fd = create_test_file(TMPFS_FILE_PATH, test_file_size);
+    int file_fd = open(PAGE_CACHE_FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    VERIFY(file_fd >= 0);
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard cleanup = [&] {
+        close(pipe_fds[0]);
+        if (pipe_fds[1] >= 0)
+            close(pipe_fds[1]);
+        close(source_fd);
+        close(file_fd);
+        unlink(TMPFS_FILE_PATH);
+        unlink(PAGE_CACHE_FILE_PATH);
+    };
+    EXPECT_EQ(splice(source_fd, nullptr, pipe_fds[1], nullptr, test_file_size, 0), static_cast<ssize_t>(test_file_size));
+
+    // Only what we asked for is taken out of the pipe, the rest stays in there.
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, file_fd, nullptr, 1000, 0), 1000);
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), 1000);
+
+    // With an offset, the file offset stays where it is.
+    off_t offset = 1000;
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, file_fd, &offset, test_file_size, 0), static_cast<ssize_t>(test_file_size - 1000));
+    EXPECT_EQ(offset, static_cast<off_t>(test_file_size));
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_CUR), 1000);
+
+    EXPECT_EQ(lseek(file_fd, 0, SEEK_SET), 0);
+    expect_data_from(file_fd, 0, test_file_size);
+
+    // An empty pipe doesn't make us wait if we don't want to.
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, file_fd, nullptr, 100, SPLICE_F_NONBLOCK), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    // Once all writers are gone, we're at the end of the pipe.
+    close(pipe_fds[1]);
+    pipe_fds[1] = -1;
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, file_fd, nullptr, 100, 0), 0);
+}
+
+TEST_CASE(splice_pipe_to_socket_keeps_unsent_data)
+{
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    int fds[2];
+    VERIFY(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == 0);
+    ScopeGuard cleanup = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        close(fds[0]);
+        close(fds[1]);
+    };
+    EXPECT_EQ(fcntl(fds[0], F_SETFL, O_NONBLOCK), 0);
+
+    // Fill up the socket, so that nothing else fits into it.
+    u8 filler[4096] {};
+    size_t nfilled = 0;
+    while (true) {
+        auto rc = write(fds[0], filler, sizeof(filler));
+        if (rc < 0) {
+            EXPECT_EQ(errno, EAGAIN);
+            break;
+        }
+        nfilled += rc;
+    }
+
+    EXPECT_EQ(write(pipe_fds[1], "hello", 5), 5);
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, fds[0], nullptr, 5, 0), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    // Make room again, the data should still be in the pipe.
+    auto drain_buffer = MUST(ByteBuffer::create_uninitialized(nfilled));
+    size_t ndrained = 0;
+    while (ndrained < nfilled) {
+        auto rc = read(fds[1], drain_buffer.data() + ndrained, nfilled - ndrained);
+        VERIFY(rc > 0);
+        ndrained += rc;
+    }
+    EXPECT_EQ(splice(pipe_fds[0], nullptr, fds[0], nullptr, 5, 0), 5);
+    char received[5];
+    EXPECT_EQ(read(fds[1], received, sizeof(received)), 5);
+    EXPECT_EQ(StringView(received, sizeof(received)), "hello"sv);
+}
@@ -4,13 +4,20 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Atomic.h>
 #include <AK/JsonArray.h>
+#include <AK/ScopeGuard.h>
+#include <AK/Time.h>
 #include <LibCore/File.h>
 #include <LibTest/TestCase.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 static constexpr u16 port = 1337;
 
@@ -141,6 +148,182 @@ TEST_CASE(tcp_bind_connect)
     }
 }
 
+static constexpr size_t lossy_transfer_size = 256 * KiB;
+
+static u8 lossy_transfer_byte(size_t offset)
+{
+    return static_cast<u8>(offset * 31 + (offset >> 8));
+}
+
+struct LossyServerContext {
+    sem_t accept_semaphore;
+    u16 port { 0 };
+    size_t bytes_received { 0 };
+    bool data_matches { true };
+};
+
+static void* lossy_server_handler(void* context_pointer)
+{
+    auto& context = *reinterpret_cast<LossyServerContext*>(context_pointer);
+
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT(server_fd >= 0);
+
+    sockaddr_in sin {};
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(context.port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rc = bind(server_fd, (sockaddr*)(&sin), sizeof(sin));
+    EXPECT_EQ(rc, 0);
+
+    rc = listen(server_fd, 1);
+    EXPECT_EQ(rc, 0);
+
+    rc = sem_post(&context.accept_semaphore);
+    VERIFY(rc == 0);
+
+    int client_fd = accept(server_fd, nullptr, nullptr);
+    EXPECT(client_fd >= 0);
+
+    u8 buffer[4096];
+    while (true) {
+        ssize_t nread = recv(client_fd, buffer, sizeof(buffer), 0);
+        EXPECT(nread >= 0);
+        if (nread <= 0)
+            break;
+        for (ssize_t i = 0; i < nread; ++i) {
+            if (buffer[i] != lossy_transfer_byte(context.bytes_received + i))
+                context.data_matches = false;
+        }
+        context.bytes_received += nread;
+    }
+
+    rc = close(client_fd);
+    EXPECT_EQ(rc, 0);
+
+    rc = close(server_fd);
+    EXPECT_EQ(rc, 0);
+
+    pthread_exit(nullptr);
+    VERIFY_NOT_REACHED();
+}
+
+// Returns how long it took from connecting until the server got everything.
+static Duration transfer_with_packet_loss(StringView congestion_control, u16 server_port)
+{
+    LossyServerContext context;
+    context.port = server_port;
+
+    pthread_t thread;
+    int rc = sem_init(&context.accept_semaphore, 0, 0);
+    VERIFY(rc == 0);
+    rc = pthread_create(&thread, nullptr, lossy_server_handler, &context);
+    VERIFY(rc == 0);
+    rc = sem_wait(&context.accept_semaphore);
+    VERIFY(rc == 0);
+    rc = sem_destroy(&context.accept_semaphore);
+    VERIFY(rc == 0);
+
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT(client_fd >= 0);
+
+    rc = setsockopt(client_fd, IPPROTO_TCP, TCP_CONGESTION, congestion_control.characters_without_null_termination(), congestion_control.length());
+    EXPECT_EQ(rc, 0);
+
+    char name[16] {};
+    socklen_t name_length = sizeof(name);
+    rc = getsockopt(client_fd, IPPROTO_TCP, TCP_CONGESTION, name, &name_length);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(StringView { name, strlen(name) }, congestion_control);
+
+    sockaddr_in sin {};
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(server_port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rc = connect(client_fd, (sockaddr*)(&sin), sizeof(sin));
+    EXPECT_EQ(rc, 0);
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    u8 buffer[4096];
+    size_t offset = 0;
+    while (offset < lossy_transfer_size) {
+        size_t chunk_size = min(sizeof(buffer), lossy_transfer_size - offset);
+        for (size_t i = 0; i < chunk_size; ++i)
+            buffer[i] = lossy_transfer_byte(offset + i);
+        size_t chunk_offset = 0;
+        while (chunk_offset < chunk_size) {
+            ssize_t nwritten = send(client_fd, buffer + chunk_offset, chunk_size - chunk_offset, 0);
+            EXPECT(nwritten > 0);
+            if (nwritten <= 0)
+                break;
+            chunk_offset += nwritten;
+        }
+        offset += chunk_size;
+    }
+
+    rc = close(client_fd);
+    EXPECT_EQ(rc, 0);
+
+    rc = pthread_join(thread, nullptr);
+    EXPECT_EQ(rc, 0);
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    EXPECT_EQ(context.bytes_received, lossy_transfer_size);
+    EXPECT(context.data_matches);
+    return Duration::from_timespec(end) - Duration::from_timespec(start);
+}
+
+static ErrorOr<void> set_loopback_packet_loss(u8 percentage)
+{
+    auto file = TRY(Core::File::open("/sys/kernel/conf/loopback_packet_loss"sv, Core::File::OpenMode::Write));
+    TRY(file->write_formatted("{}", percentage));
+    return {};
+}
+
+TEST_CASE(tcp_transfer_with_packet_loss)
+{
+    // Only root may make the loopback interface drop packets.
+    if (auto result = set_loopback_packet_loss(2); result.is_error()) {
+        SKIP(ByteString::formatted("Can't make the loopback interface drop packets: {}", result.error()));
+        return;
+    }
+    ScopeGuard reset_packet_loss = [] {
+        MUST(set_loopback_packet_loss(0));
+    };
+
+    transfer_with_packet_loss("newreno"sv, port + 10);
+    transfer_with_packet_loss("cubic"sv, port + 11);
+}
+
+BENCHMARK_CASE(tcp_goodput_with_packet_loss)
+{
+    static constexpr u8 packet_loss_percentage = 2;
+    static constexpr size_t runs_per_algorithm = 4;
+
+    if (auto result = set_loopback_packet_loss(packet_loss_percentage); result.is_error()) {
+        SKIP(ByteString::formatted("Can't make the loopback interface drop packets: {}", result.error()));
+        return;
+    }
+    ScopeGuard reset_packet_loss = [] {
+        MUST(set_loopback_packet_loss(0));
+    };
+
+    u16 server_port = port + 20;
+    for (auto congestion_control : { "newreno"sv, "cubic"sv }) {
+        Duration elapsed;
+        for (size_t i = 0; i < runs_per_algorithm; ++i)
+            elapsed += transfer_with_packet_loss(congestion_control, server_port++);
+
+        auto transferred_kib = runs_per_algorithm * lossy_transfer_size / KiB;
+        auto elapsed_ms = max<i64>(elapsed.to_milliseconds(), 1);
+        outln("{} with {}% packet loss: {} KiB in {} ms ({} KiB/s)", congestion_control, packet_loss_percentage, transferred_kib, elapsed_ms, transferred_kib * 1000 / elapsed_ms);
+    }
+}
+
 TEST_CASE(socket_connect_after_bind)
 {
     unlink("/tmp/tmp-client.test");
@@ -170,3 +353,189 @@ TEST_CASE(socket_connect_after_bind)
     unlink("/tmp/tmp-client.test");
     unlink("/tmp/tmp.test");
 }
+
+static Atomic<bool> s_stop_churning;
+
+static void* churn_handler(void* churn_count_pointer)
+{
+    auto& churn_count = *reinterpret_cast<size_t*>(churn_count_pointer);
+    while (!s_stop_churning.load()) {
+        // Binding and closing sockets adds them to and removes them from the lookup tables.
+        for (int type : { SOCK_STREAM, SOCK_DGRAM }) {
+            int fd = socket(AF_INET, type, 0);
+            VERIFY(fd >= 0);
+            sockaddr_in sin {};
+            sin.sin_family = AF_INET;
+            sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            int rc = bind(fd, (sockaddr*)(&sin), sizeof(sin));
+            EXPECT_EQ(rc, 0);
+            rc = close(fd);
+            EXPECT_EQ(rc, 0);
+        }
+        ++churn_count;
+    }
+    pthread_exit(nullptr);
+    VERIFY_NOT_REACHED();
+}
+
+BENCHMARK_CASE(socket_lookup_with_churn)
+{
+    static constexpr size_t receiver_count = 64;
+    static constexpr size_t datagram_count = 20000;
+
+    Vector<int> receivers;
+    Vector<sockaddr_in> receiver_addresses;
+    for (size_t i = 0; i < receiver_count; ++i) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        VERIFY(fd >= 0);
+        sockaddr_in sin {};
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int rc = bind(fd, (sockaddr*)(&sin), sizeof(sin));
+        EXPECT_EQ(rc, 0);
+        socklen_t sin_length = sizeof(sin);
+        rc = getsockname(fd, (sockaddr*)(&sin), &sin_length);
+        EXPECT_EQ(rc, 0);
+        receivers.append(fd);
+        receiver_addresses.append(sin);
+    }
+
+    int sender_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    VERIFY(sender_fd >= 0);
+
+    s_stop_churning.store(false);
+    size_t churn_count = 0;
+    pthread_t churn_thread;
+    int rc = pthread_create(&churn_thread, nullptr, churn_handler, &churn_count);
+    VERIFY(rc == 0);
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < datagram_count; ++i) {
+        auto index = i % receiver_count;
+        u8 data = static_cast<u8>(i);
+        ssize_t nwritten = sendto(sender_fd, &data, sizeof(data), 0, (sockaddr*)(&receiver_addresses[index]), sizeof(sockaddr_in));
+        EXPECT_EQ(nwritten, 1);
+        u8 received_data = 0;
+        ssize_t nread = recv(receivers[index], &received_data, sizeof(received_data), 0);
+        EXPECT_EQ(nread, 1);
+        EXPECT_EQ(received_data, data);
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    s_stop_churning.store(true);
+    rc = pthread_join(churn_thread, nullptr);
+    EXPECT_EQ(rc, 0);
+
+    auto elapsed_ms = max<i64>((Duration::from_timespec(end) - Duration::from_timespec(start)).to_milliseconds(), 1);
+    outln("{} datagrams in {} ms ({} per second), while {} sockets were created and closed", datagram_count, elapsed_ms, datagram_count * 1000 / elapsed_ms, churn_count * 2);
+
+    EXPECT_EQ(close(sender_fd), 0);
+    for (auto fd : receivers)
+        EXPECT_EQ(close(fd), 0);
+}
+
+struct ConnectionChurnContext {
+    int listen_fd { -1 };
+    sockaddr_in address {};
+    size_t connection_count { 0 };
+    Atomic<bool> is_done { false };
+};
+
+static void connect_and_accept(int listen_fd, sockaddr_in const& address, int& client_fd, int& accepted_fd)
+{
+    client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    VERIFY(client_fd >= 0);
+    int rc = connect(client_fd, (sockaddr const*)(&address), sizeof(address));
+    EXPECT_EQ(rc, 0);
+    accepted_fd = accept(listen_fd, nullptr, nullptr);
+    VERIFY(accepted_fd >= 0);
+}
+
+static void* connection_churn_handler(void* context_pointer)
+{
+    auto& context = *reinterpret_cast<ConnectionChurnContext*>(context_pointer);
+    // Every connection adds two sockets to the lookup table, which are removed again once they've been closed.
+    for (size_t i = 0; i < context.connection_count; ++i) {
+        int client_fd;
+        int accepted_fd;
+        connect_and_accept(context.listen_fd, context.address, client_fd, accepted_fd);
+        int rc = close(client_fd);
+        EXPECT_EQ(rc, 0);
+        rc = close(accepted_fd);
+        EXPECT_EQ(rc, 0);
+    }
+    context.is_done.store(true);
+    pthread_exit(nullptr);
+    VERIFY_NOT_REACHED();
+}
+
+BENCHMARK_CASE(tcp_lookup_with_connection_churn)
+{
+    static constexpr size_t established_count = 128;
+    static constexpr size_t churned_connection_count = 1024;
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    VERIFY(listen_fd >= 0);
+    sockaddr_in sin {};
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port + 30);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rc = bind(listen_fd, (sockaddr*)(&sin), sizeof(sin));
+    EXPECT_EQ(rc, 0);
+    rc = listen(listen_fd, 16);
+    EXPECT_EQ(rc, 0);
+
+    // Every segment on these connections has to be matched to its socket by its tuple.
+    Vector<int> client_fds;
+    Vector<int> accepted_fds;
+    for (size_t i = 0; i < established_count; ++i) {
+        int client_fd;
+        int accepted_fd;
+        connect_and_accept(listen_fd, sin, client_fd, accepted_fd);
+        client_fds.append(client_fd);
+        accepted_fds.append(accepted_fd);
+    }
+
+    ConnectionChurnContext context;
+    context.listen_fd = listen_fd;
+    context.address = sin;
+    context.connection_count = churned_connection_count;
+    pthread_t churn_thread;
+    rc = pthread_create(&churn_thread, nullptr, connection_churn_handler, &context);
+    VERIFY(rc == 0);
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t exchange_count = 0;
+    while (!context.is_done.load()) {
+        auto index = exchange_count % established_count;
+        u8 data = static_cast<u8>(exchange_count);
+        ssize_t nwritten = send(client_fds[index], &data, sizeof(data), 0);
+        EXPECT_EQ(nwritten, 1);
+        u8 received_data = 0;
+        ssize_t nread = recv(accepted_fds[index], &received_data, sizeof(received_data), 0);
+        EXPECT_EQ(nread, 1);
+        EXPECT_EQ(received_data, data);
+        ++exchange_count;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    rc = pthread_join(churn_thread, nullptr);
+    EXPECT_EQ(rc, 0);
+
+    auto elapsed_ms = max<i64>((Duration::from_timespec(end) - Duration::from_timespec(start)).to_milliseconds(), 1);
+    outln("{} segments over {} connections in {} ms ({} per second), while {} connections were set up and torn down", exchange_count, established_count, elapsed_ms, exchange_count * 1000 / elapsed_ms, churned_connection_count);
+
+    for (size_t i = 0; i < established_count; ++i) {
+        EXPECT_EQ(close(client_fds[i]), 0);
+        EXPECT_EQ(close(accepted_fds[i]), 0);
+    }
+    EXPECT_EQ(close(listen_fd), 0);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Array.h>
+#include <AK/ByteString.h>
+#include <LibTest/TestCase.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int bound_udp_socket(sockaddr_in& address)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    VERIFY(fd >= 0);
+
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = 0;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(bind(fd, (sockaddr*)&address, sizeof(address)), 0);
+
+    socklen_t address_length = sizeof(address);
+    EXPECT_EQ(getsockname(fd, (sockaddr*)&address, &address_length), 0);
+    return fd;
+}
+
+TEST_CASE(sendmmsg_and_recvmmsg)
+{
+    static constexpr size_t message_count = 8;
+
+    sockaddr_in receiver_address;
+    int receiver_fd = bound_udp_socket(receiver_address);
+    sockaddr_in sender_address;
+    int sender_fd = bound_udp_socket(sender_address);
+
+    Array<ByteString, message_count> payloads;
+    Array<iovec, message_count> send_iovs;
+    Array<mmsghdr, message_count> send_messages {};
+    for (size_t i = 0; i < message_count; ++i) {
+        payloads[i] = ByteString::formatted("Datagram number {}", i);
+        send_iovs[i] = { const_cast<char*>(payloads[i].characters()), payloads[i].length() };
+        send_messages[i].msg_hdr.msg_name = &receiver_address;
+        send_messages[i].msg_hdr.msg_namelen = sizeof(receiver_address);
+        send_messages[i].msg_hdr.msg_iov = &send_iovs[i];
+        send_messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    EXPECT_EQ(sendmmsg(sender_fd, send_messages.data(), message_count, 0), static_cast<int>(message_count));
+    for (size_t i = 0; i < message_count; ++i)
+        EXPECT_EQ(send_messages[i].msg_len, payloads[i].length());
+
+    Array<Array<char, 64>, message_count> buffers;
+    Array<sockaddr_in, message_count> sources;
+    Array<iovec, message_count> receive_iovs;
+    Array<mmsghdr, message_count> receive_messages {};
+    for (size_t i = 0; i < message_count; ++i) {
+        receive_iovs[i] = { buffers[i].data(), buffers[i].size() };
+        receive_messages[i].msg_hdr.msg_name = &sources[i];
+        receive_messages[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+        receive_messages[i].msg_hdr.msg_iov = &receive_iovs[i];
+        receive_messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    EXPECT_EQ(recvmmsg(receiver_fd, receive_messages.data(), message_count, MSG_DONTWAIT, nullptr), static_cast<int>(message_count));
+    for (size_t i = 0; i < message_count; ++i) {
+        EXPECT_EQ(receive_messages[i].msg_len, payloads[i].length());
+        EXPECT_EQ(StringView(buffers[i].data(), receive_messages[i].msg_len), payloads[i].view());
+        EXPECT_EQ(sources[i].sin_port, sender_address.sin_port);
+    }
+
+    // Nothing's left, so a nonblocking call has to fail rather than return an empty batch.
+    EXPECT_EQ(recvmmsg(receiver_fd, receive_messages.data(), message_count, MSG_DONTWAIT, nullptr), -1);
+    EXPECT_EQ(errno, EAGAIN);
+
+    close(sender_fd);
+    close(receiver_fd);
+}
+
+TEST_CASE(recvmmsg_wait_for_one)
+{
+    sockaddr_in receiver_address;
+    int receiver_fd = bound_udp_socket(receiver_address);
+    sockaddr_in sender_address;
+    int sender_fd = bound_udp_socket(sender_address);
+
+    auto message = "Only one"sv;
+    EXPECT_EQ(sendto(sender_fd, message.characters_without_null_termination(), message.length(), 0, (sockaddr*)&receiver_address, sizeof(receiver_address)), static_cast<ssize_t>(message.length()));
+
+    // After the first datagram, MSG_WAITFORONE stops waiting for more.
+    Array<Array<char, 64>, 4> buffers;
+    Array<iovec, 4> iovs;
+    Array<mmsghdr, 4> messages {};
+    for (size_t i = 0; i < messages.size(); ++i) {
+        iovs[i] = { buffers[i].data(), buffers[i].size() };
+        messages[i].msg_hdr.msg_iov = &iovs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    EXPECT_EQ(recvmmsg(receiver_fd, messages.data(), messages.size(), MSG_WAITFORONE, nullptr), 1);
+    EXPECT_EQ(StringView(buffers[0].data(), messages[0].msg_len), message);
+
+    close(sender_fd);
+    close(receiver_fd);
+}
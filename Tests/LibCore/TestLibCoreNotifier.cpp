@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/ScopeGuard.h>
+#include <LibCore/EventLoop.h>
+#include <LibCore/Notifier.h>
+#include <LibCore/Timer.h>
+#include <LibTest/TestCase.h>
+#include <unistd.h>
+
+TEST_CASE(notifier_fires_while_fd_is_readable)
+{
+    IGNORE_USE_IN_ESCAPING_LAMBDA Core::EventLoop event_loop;
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard close_pipe = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    };
+
+    auto notifier = Core::Notifier::construct(pipe_fds[0], Core::Notifier::Type::Read);
+    IGNORE_USE_IN_ESCAPING_LAMBDA int activation_count = 0;
+    notifier->on_activation = [&] {
+        // We don't read anything, so the notifier has to keep firing.
+        if (++activation_count == 3)
+            event_loop.quit(0);
+    };
+    auto reaper = Core::Timer::create_single_shot(1000, [] {
+        warnln("The notifier should have fired by now, but it didn't!");
+        VERIFY_NOT_REACHED();
+    });
+    reaper->start();
+
+    EXPECT_EQ(write(pipe_fds[1], "a", 1), 1);
+    event_loop.exec();
+    EXPECT_EQ(activation_count, 3);
+}
+
+TEST_CASE(notifier_changes_take_effect)
+{
+    IGNORE_USE_IN_ESCAPING_LAMBDA Core::EventLoop event_loop;
+    int pipe_fds[2];
+    VERIFY(pipe(pipe_fds) == 0);
+    ScopeGuard close_pipe = [&] {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    };
+    EXPECT_EQ(write(pipe_fds[1], "a", 1), 1);
+
+    auto read_notifier = Core::Notifier::construct(pipe_fds[0], Core::Notifier::Type::Read);
+    read_notifier->on_activation = [] {
+        warnln("A disabled notifier fired!");
+        VERIFY_NOT_REACHED();
+    };
+    read_notifier->set_enabled(false);
+
+    // The write end of an empty pipe never becomes readable, but it's writable right away.
+    IGNORE_USE_IN_ESCAPING_LAMBDA auto write_notifier = Core::Notifier::construct(pipe_fds[1], Core::Notifier::Type::Read);
+    IGNORE_USE_IN_ESCAPING_LAMBDA bool write_notifier_fired = false;
+    write_notifier->on_activation = [&] {
+        write_notifier_fired = true;
+        event_loop.quit(0);
+    };
+
+    auto switch_type = Core::Timer::create_single_shot(100, [&] {
+        EXPECT(!write_notifier_fired);
+        write_notifier->set_type(Core::Notifier::Type::Write);
+    });
+    switch_type->start();
+    auto reaper = Core::Timer::create_single_shot(1000, [] {
+        warnln("The write notifier should have fired by now, but it didn't!");
+        VERIFY_NOT_REACHED();
+    });
+    reaper->start();
+
+    event_loop.exec();
+    EXPECT(write_notifier_fired);
+}
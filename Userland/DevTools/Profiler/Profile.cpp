@@ -11,13 +11,16 @@
 #include "SamplesModel.h"
 #include "SourceModel.h"
 #include <AK/HashTable.h>
+#include <AK/InsertionSort.h>
 #include <AK/LexicalPath.h>
 #include <AK/QuickSort.h>
 #include <AK/RefPtr.h>
 #include <AK/Try.h>
+#include <Kernel/API/Perfcore.h>
 #include <LibCore/MappedFile.h>
 #include <LibELF/Image.h>
 #include <LibSymbolication/Symbolication.h>
+#include <serenity.h>
 #include <sys/stat.h>
 
 namespace Profiler {
@@ -265,25 +268,30 @@ void Profile::rebuild_tree()
 Optional<MappedObject> g_kernel_debuginfo_object;
 OwnPtr<Debug::DebugInfo> g_kernel_debug_info;
 
-ErrorOr<NonnullOwnPtr<Profile>> Profile::load_from_perfcore_file(StringView path)
-{
-    auto file = TRY(Core::File::open(path, Core::File::OpenMode::Read));
+namespace {
 
-    auto json = JsonValue::from_string(TRY(file->read_until_eof()));
+// An event as it's stored in the perfcore, before it's been tied to its process and its stack has been symbolicated.
+struct PerfcoreEvent {
+    int type { 0 };
+    Profile::Event event;
+    Vector<u64> stack;
+};
+
+struct Perfcore {
+    Vector<PerfcoreEvent> events;
+    u64 lost_event_count { 0 };
+};
+
+}
+
+static ErrorOr<Perfcore> parse_json_perfcore(ReadonlyBytes bytes)
+{
+    auto json = JsonValue::from_string(bytes);
     if (json.is_error() || !json.value().is_object())
         return Error::from_string_literal("Invalid perfcore format (not a JSON object)");
 
     auto const& object = json.value().as_object();
 
-    if (!g_kernel_debuginfo_object.has_value()) {
-        auto debuginfo_file_or_error = Core::MappedFile::map("/boot/Kernel.debug"sv);
-        if (!debuginfo_file_or_error.is_error()) {
-            auto debuginfo_file = debuginfo_file_or_error.release_value();
-            auto debuginfo_image = ELF::Image(debuginfo_file->bytes());
-            g_kernel_debuginfo_object = { { move(debuginfo_file), move(debuginfo_image) } };
-        }
-    }
-
     auto strings_value = object.get_array("strings"sv);
     if (!strings_value.has_value())
         return Error::from_string_literal("Malformed profile (strings is not an array)");
@@ -300,18 +308,12 @@ ErrorOr<NonnullOwnPtr<Profile>> Profile::load_from_perfcore_file(StringView path
         return Error::from_string_literal("Malformed profile (events is not an array)");
     auto const& perf_events = events_value.value();
 
-    Vector<NonnullOwnPtr<Process>> all_processes;
-    HashMap<pid_t, Process*> current_processes;
-    Vector<Event> events;
-    EventSerialNumber next_serial;
-
+    Perfcore perfcore;
     for (auto const& perf_event_value : perf_events.values()) {
         auto const& perf_event = perf_event_value.as_object();
 
-        Event event;
-
-        event.serial = next_serial;
-        next_serial.increment();
+        PerfcoreEvent perfcore_event;
+        auto& event = perfcore_event.event;
         event.timestamp = perf_event.get_u64("timestamp"sv).value_or(0);
         event.lost_samples = perf_event.get_u32("lost_samples"sv).value_or(0);
         event.pid = perf_event.get_i32("pid"sv).value_or(0);
@@ -320,144 +322,92 @@ ErrorOr<NonnullOwnPtr<Profile>> Profile::load_from_perfcore_file(StringView path
         auto type_string = perf_event.get_byte_string("type"sv).value_or({});
 
         if (type_string == "sample"sv) {
-            event.data = Event::SampleData {};
+            perfcore_event.type = PERF_EVENT_SAMPLE;
+            event.data = Profile::Event::SampleData {};
         } else if (type_string == "kmalloc"sv) {
-            event.data = Event::MallocData {
+            perfcore_event.type = PERF_EVENT_KMALLOC;
+            event.data = Profile::Event::MallocData {
                 .ptr = perf_event.get_addr("ptr"sv).value_or(0),
                 .size = perf_event.get_integer<size_t>("size"sv).value_or(0),
             };
         } else if (type_string == "kfree"sv) {
-            event.data = Event::FreeData {
+            perfcore_event.type = PERF_EVENT_KFREE;
+            event.data = Profile::Event::FreeData {
                 .ptr = perf_event.get_addr("ptr"sv).value_or(0),
             };
         } else if (type_string == "signpost"sv) {
+            perfcore_event.type = PERF_EVENT_SIGNPOST;
             auto string_id = perf_event.get_addr("arg1"sv).value_or(0);
-            event.data = Event::SignpostData {
+            event.data = Profile::Event::SignpostData {
                 .string = profile_strings.get(string_id).value_or(ByteString::formatted("Signpost #{}", string_id)),
                 .arg = perf_event.get_addr("arg2"sv).value_or(0),
             };
         } else if (type_string == "mmap"sv) {
-            auto ptr = perf_event.get_addr("ptr"sv).value_or(0);
-            auto size = perf_event.get_integer<size_t>("size"sv).value_or(0);
-            auto name = perf_event.get_byte_string("name"sv).value_or({});
-
-            event.data = Event::MmapData {
-                .ptr = ptr,
-                .size = size,
-                .name = name,
+            perfcore_event.type = PERF_EVENT_MMAP;
+            event.data = Profile::Event::MmapData {
+                .ptr = perf_event.get_addr("ptr"sv).value_or(0),
+                .size = perf_event.get_integer<size_t>("size"sv).value_or(0),
+                .name = perf_event.get_byte_string("name"sv).value_or({}),
             };
-
-            auto it = current_processes.find(event.pid);
-            if (it != current_processes.end())
-                it->value->library_metadata.handle_mmap(ptr, size, name);
-            continue;
         } else if (type_string == "munmap"sv) {
-            event.data = Event::MunmapData {
+            perfcore_event.type = PERF_EVENT_MUNMAP;
+            event.data = Profile::Event::MunmapData {
                 .ptr = perf_event.get_addr("ptr"sv).value_or(0),
                 .size = perf_event.get_integer<size_t>("size"sv).value_or(0),
             };
-            continue;
         } else if (type_string == "process_create"sv) {
-            auto parent_pid = perf_event.get_integer<pid_t>("parent_pid"sv).value_or(0);
-            auto executable = perf_event.get_byte_string("executable"sv).value_or({});
-            event.data = Event::ProcessCreateData {
-                .parent_pid = parent_pid,
-                .executable = executable,
+            perfcore_event.type = PERF_EVENT_PROCESS_CREATE;
+            event.data = Profile::Event::ProcessCreateData {
+                .parent_pid = perf_event.get_integer<pid_t>("parent_pid"sv).value_or(0),
+                .executable = perf_event.get_byte_string("executable"sv).value_or({}),
             };
-
-            auto sampled_process = TRY(adopt_nonnull_own_or_enomem(new (nothrow) Process {
-                .pid = event.pid,
-                .executable = executable,
-                .basename = LexicalPath::basename(executable),
-                .start_valid = event.serial,
-                .end_valid = {},
-            }));
-
-            current_processes.set(sampled_process->pid, sampled_process);
-            all_processes.append(move(sampled_process));
-            continue;
         } else if (type_string == "process_exec"sv) {
-            auto executable = perf_event.get_byte_string("executable"sv).value_or({});
-            event.data = Event::ProcessExecData {
-                .executable = executable,
+            perfcore_event.type = PERF_EVENT_PROCESS_EXEC;
+            event.data = Profile::Event::ProcessExecData {
+                .executable = perf_event.get_byte_string("executable"sv).value_or({}),
             };
-
-            auto* old_process = current_processes.get(event.pid).value();
-            old_process->end_valid = event.serial;
-
-            current_processes.remove(event.pid);
-
-            auto sampled_process = TRY(adopt_nonnull_own_or_enomem(new (nothrow) Process {
-                .pid = event.pid,
-                .executable = executable,
-                .basename = LexicalPath::basename(executable),
-                .start_valid = event.serial,
-                .end_valid = {},
-            }));
-
-            current_processes.set(sampled_process->pid, sampled_process);
-            all_processes.append(move(sampled_process));
-            continue;
         } else if (type_string == "process_exit"sv) {
-            auto* old_process = current_processes.get(event.pid).value();
-            old_process->end_valid = event.serial;
-
-            current_processes.remove(event.pid);
-            continue;
+            perfcore_event.type = PERF_EVENT_PROCESS_EXIT;
         } else if (type_string == "thread_create"sv) {
-            auto parent_tid = perf_event.get_integer<pid_t>("parent_tid"sv).value_or(0);
-            event.data = Event::ThreadCreateData {
-                .parent_tid = parent_tid,
+            perfcore_event.type = PERF_EVENT_THREAD_CREATE;
+            event.data = Profile::Event::ThreadCreateData {
+                .parent_tid = perf_event.get_integer<pid_t>("parent_tid"sv).value_or(0),
             };
-            auto it = current_processes.find(event.pid);
-            if (it != current_processes.end())
-                it->value->handle_thread_create(event.tid, event.serial);
-            continue;
         } else if (type_string == "thread_exit"sv) {
-            auto it = current_processes.find(event.pid);
-            if (it != current_processes.end())
-                it->value->handle_thread_exit(event.tid, event.serial);
-            continue;
+            perfcore_event.type = PERF_EVENT_THREAD_EXIT;
         } else if (type_string == "filesystem"sv) {
-            Event::FilesystemEventData fsdata {
+            perfcore_event.type = PERF_EVENT_FILESYSTEM;
+            Profile::Event::FilesystemEventData fsdata {
                 .duration = Duration::from_nanoseconds(perf_event.get_integer<u64>("durationNs"sv).value_or(0)),
-                .data = Event::OpenEventData {},
+                .data = Profile::Event::OpenEventData {},
             };
             auto const filesystem_event_type = perf_event.get("fs_event_type"sv).value_or("").as_string();
+            auto const string_index = perf_event.get_addr("filename_index"sv).value_or(0);
+            auto const filename = profile_strings.get(string_index).value_or("");
             if (filesystem_event_type == "open"sv) {
-                auto const string_index = perf_event.get_addr("filename_index"sv).value_or(0);
-                auto const filename = profile_strings.get(string_index).value_or("");
-                fsdata.data = Event::OpenEventData {
+                fsdata.data = Profile::Event::OpenEventData {
                     .dirfd = perf_event.get_integer<int>("dirfd"sv).value_or(0),
                     .path = filename,
                     .options = perf_event.get_integer<int>("options"sv).value_or(0),
                     .mode = perf_event.get_integer<u64>("mode"sv).value_or(0),
                 };
             } else if (filesystem_event_type == "close"sv) {
-                auto const string_index = perf_event.get_addr("filename_index"sv).value_or(0);
-                auto const filename = profile_strings.get(string_index).value_or("");
-                fsdata.data = Event::CloseEventData {
+                fsdata.data = Profile::Event::CloseEventData {
                     .fd = perf_event.get_integer<int>("fd"sv).value_or(0),
                     .path = filename,
                 };
             } else if (filesystem_event_type == "readv"sv) {
-                auto const string_index = perf_event.get_addr("filename_index"sv).value_or(0);
-                auto const filename = profile_strings.get(string_index).value();
-                fsdata.data = Event::ReadvEventData {
+                fsdata.data = Profile::Event::ReadvEventData {
                     .fd = perf_event.get_integer<int>("fd"sv).value_or(0),
                     .path = filename,
                 };
             } else if (filesystem_event_type == "read"sv) {
-                auto const string_index = perf_event.get_addr("filename_index"sv).value_or(0);
-                auto const filename = profile_strings.get(string_index).value();
-                fsdata.data = Event::ReadEventData {
+                fsdata.data = Profile::Event::ReadEventData {
                     .fd = perf_event.get_integer<int>("fd"sv).value_or(0),
                     .path = filename,
                 };
             } else if (filesystem_event_type == "pread"sv) {
-                auto const string_index = perf_event.get_addr("filename_index"sv).value_or(0);
-                auto const filename = profile_strings.get(string_index).value();
-                fsdata.data = Event::PreadEventData {
+                fsdata.data = Profile::Event::PreadEventData {
                     .fd = perf_event.get_integer<int>("fd"sv).value_or(0),
                     .path = filename,
                     .buffer_ptr = perf_event.get_integer<FlatPtr>("buffer_ptr"sv).value_or(0),
@@ -468,18 +418,281 @@ ErrorOr<NonnullOwnPtr<Profile>> Profile::load_from_perfcore_file(StringView path
 
             event.data = fsdata;
         } else {
-            dbgln("Unknown event type '{}'", type_string);
-            VERIFY_NOT_REACHED();
+            dbgln("Skipping event of unsupported type '{}'", type_string);
+            continue;
         }
 
-        auto maybe_kernel_base = Symbolication::kernel_base();
+        if (auto stack = perf_event.get_array("stack"sv); stack.has_value()) {
+            for (auto const& frame : stack->values())
+                TRY(perfcore_event.stack.try_append(frame.as_integer<u64>()));
+        }
+
+        TRY(perfcore.events.try_append(move(perfcore_event)));
+    }
+    return perfcore;
+}
+
+template<typename T>
+static ErrorOr<T> read_perfcore_data(ReadonlyBytes bytes, size_t& offset)
+{
+    if (offset + sizeof(T) > bytes.size())
+        return Error::from_string_literal("Malformed profile (record is truncated)");
+    T value;
+    memcpy(&value, bytes.offset_pointer(offset), sizeof(T));
+    offset += sizeof(T);
+    return value;
+}
+
+static ErrorOr<bool> parse_binary_event(ReadonlyBytes record, HashMap<FlatPtr, ByteString> const& profile_strings, PerfcoreEvent& perfcore_event)
+{
+    size_t offset = 0;
+    auto header = TRY(read_perfcore_data<PerfcoreEventRecord>(record, offset));
+    if (offset + header.data_size + header.stack_size * sizeof(u64) > record.size())
+        return Error::from_string_literal("Malformed profile (event is truncated)");
+    auto data = record.slice(offset, header.data_size);
+    auto stack = record.slice(offset + header.data_size, header.stack_size * sizeof(u64));
+
+    perfcore_event.type = header.type;
+    auto& event = perfcore_event.event;
+    // The kernel records nanoseconds, but milliseconds are plenty for us.
+    event.timestamp = header.timestamp / 1'000'000;
+    event.lost_samples = header.lost_samples;
+    event.pid = header.pid;
+    event.tid = header.tid;
+
+    size_t data_offset = 0;
+    auto data_string = [&] {
+        return ByteString(StringView(data.slice(min(data_offset, data.size()))));
+    };
+
+    switch (header.type) {
+    case PERF_EVENT_SAMPLE:
+        event.data = Profile::Event::SampleData {};
+        break;
+    case PERF_EVENT_KMALLOC: {
+        auto memory = TRY(read_perfcore_data<PerfcoreMemoryEventData>(data, data_offset));
+        event.data = Profile::Event::MallocData { .ptr = static_cast<FlatPtr>(memory.ptr), .size = static_cast<size_t>(memory.size) };
+        break;
+    }
+    case PERF_EVENT_KFREE: {
+        auto memory = TRY(read_perfcore_data<PerfcoreMemoryEventData>(data, data_offset));
+        event.data = Profile::Event::FreeData { .ptr = static_cast<FlatPtr>(memory.ptr) };
+        break;
+    }
+    case PERF_EVENT_SIGNPOST: {
+        auto signpost = TRY(read_perfcore_data<PerfcoreSignpostEventData>(data, data_offset));
+        event.data = Profile::Event::SignpostData {
+            .string = profile_strings.get(signpost.arg1).value_or(ByteString::formatted("Signpost #{}", signpost.arg1)),
+            .arg = static_cast<FlatPtr>(signpost.arg2),
+        };
+        break;
+    }
+    case PERF_EVENT_MMAP: {
+        auto memory = TRY(read_perfcore_data<PerfcoreMemoryEventData>(data, data_offset));
+        event.data = Profile::Event::MmapData { .ptr = static_cast<FlatPtr>(memory.ptr), .size = static_cast<size_t>(memory.size), .name = data_string() };
+        break;
+    }
+    case PERF_EVENT_MUNMAP: {
+        auto memory = TRY(read_perfcore_data<PerfcoreMemoryEventData>(data, data_offset));
+        event.data = Profile::Event::MunmapData { .ptr = static_cast<FlatPtr>(memory.ptr), .size = static_cast<size_t>(memory.size) };
+        break;
+    }
+    case PERF_EVENT_PROCESS_CREATE: {
+        auto process_create = TRY(read_perfcore_data<PerfcoreProcessCreateEventData>(data, data_offset));
+        event.data = Profile::Event::ProcessCreateData { .parent_pid = static_cast<pid_t>(process_create.parent_pid), .executable = data_string() };
+        break;
+    }
+    case PERF_EVENT_PROCESS_EXEC:
+        event.data = Profile::Event::ProcessExecData { .executable = data_string() };
+        break;
+    case PERF_EVENT_PROCESS_EXIT:
+    case PERF_EVENT_THREAD_EXIT:
+        break;
+    case PERF_EVENT_THREAD_CREATE: {
+        auto thread_create = TRY(read_perfcore_data<PerfcoreThreadCreateEventData>(data, data_offset));
+        event.data = Profile::Event::ThreadCreateData { .parent_tid = static_cast<pid_t>(thread_create.parent_tid) };
+        break;
+    }
+    case PERF_EVENT_FILESYSTEM: {
+        auto filesystem = TRY(read_perfcore_data<PerfcoreFilesystemEventData>(data, data_offset));
+        auto path = profile_strings.get(filesystem.filename_index).value_or({});
+        Profile::Event::FilesystemEventData fsdata {
+            .duration = Duration::from_nanoseconds(filesystem.duration_ns),
+            .data = Profile::Event::OpenEventData {},
+        };
+        switch (filesystem.type) {
+        case PerfcoreFilesystemEventType::Open:
+            fsdata.data = Profile::Event::OpenEventData { .dirfd = filesystem.fd, .path = path, .options = filesystem.options, .mode = filesystem.mode };
+            break;
+        case PerfcoreFilesystemEventType::Close:
+            fsdata.data = Profile::Event::CloseEventData { .fd = filesystem.fd, .path = path };
+            break;
+        case PerfcoreFilesystemEventType::Readv:
+            fsdata.data = Profile::Event::ReadvEventData { .fd = filesystem.fd, .path = path };
+            break;
+        case PerfcoreFilesystemEventType::Read:
+            fsdata.data = Profile::Event::ReadEventData { .fd = filesystem.fd, .path = path };
+            break;
+        case PerfcoreFilesystemEventType::Pread:
+            fsdata.data = Profile::Event::PreadEventData {
+                .fd = filesystem.fd,
+                .path = path,
+                .buffer_ptr = static_cast<FlatPtr>(filesystem.buffer_ptr),
+                .size = static_cast<size_t>(filesystem.size),
+                .offset = static_cast<off_t>(filesystem.offset),
+            };
+            break;
+        }
+        event.data = fsdata;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    TRY(perfcore_event.stack.try_resize(header.stack_size));
+    memcpy(perfcore_event.stack.data(), stack.data(), stack.size());
+    return true;
+}
+
+static ErrorOr<Perfcore> parse_binary_perfcore(ReadonlyBytes bytes)
+{
+    size_t offset = 0;
+    auto header = TRY(read_perfcore_data<PerfcoreHeader>(bytes, offset));
+    if (memcmp(header.magic, PERFCORE_MAGIC, sizeof(header.magic)) != 0)
+        return Error::from_string_literal("Invalid perfcore format (bad magic)");
+    if (header.version != PERFCORE_VERSION)
+        return Error::from_string_literal("Unsupported perfcore version");
+
+    Perfcore perfcore;
+    HashMap<FlatPtr, ByteString> profile_strings;
+    HashTable<u32> skipped_event_types;
+    while (offset < bytes.size()) {
+        auto record_header = TRY(read_perfcore_data<PerfcoreRecordHeader>(bytes, offset));
+        offset -= sizeof(record_header);
+        if (record_header.size < sizeof(record_header) || offset + record_header.size > bytes.size())
+            return Error::from_string_literal("Malformed profile (bad record size)");
+        auto record = bytes.slice(offset, record_header.size);
+        offset += record_header.size;
+
+        switch (record_header.type) {
+        case PerfcoreRecordType::String: {
+            size_t record_offset = 0;
+            auto string = TRY(read_perfcore_data<PerfcoreStringRecord>(record, record_offset));
+            profile_strings.set(string.index, ByteString(StringView(record.slice(record_offset))));
+            break;
+        }
+        case PerfcoreRecordType::Event: {
+            PerfcoreEvent perfcore_event;
+            if (TRY(parse_binary_event(record, profile_strings, perfcore_event)))
+                TRY(perfcore.events.try_append(move(perfcore_event)));
+            else if (skipped_event_types.set(perfcore_event.type) == HashSetResult::InsertedNewEntry)
+                dbgln("Skipping events of unsupported type {}", perfcore_event.type);
+            break;
+        }
+        case PerfcoreRecordType::LostEvents: {
+            size_t record_offset = 0;
+            auto lost_events = TRY(read_perfcore_data<PerfcoreLostEventsRecord>(record, record_offset));
+            perfcore.lost_event_count += lost_events.count;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Events from different processors may be slightly out of order where the kernel's buffer was drained.
+    insertion_sort(perfcore.events, [](auto const& a, auto const& b) { return a.event.timestamp < b.event.timestamp; });
+    return perfcore;
+}
+
+ErrorOr<NonnullOwnPtr<Profile>> Profile::load_from_perfcore_file(StringView path)
+{
+    auto file = TRY(Core::File::open(path, Core::File::OpenMode::Read));
+    auto contents = TRY(file->read_until_eof());
+
+    bool is_binary = contents.size() >= sizeof(PERFCORE_MAGIC) && memcmp(contents.data(), PERFCORE_MAGIC, sizeof(PERFCORE_MAGIC)) == 0;
+    auto perfcore = is_binary ? TRY(parse_binary_perfcore(contents)) : TRY(parse_json_perfcore(contents));
+
+    if (!g_kernel_debuginfo_object.has_value()) {
+        auto debuginfo_file_or_error = Core::MappedFile::map("/boot/Kernel.debug"sv);
+        if (!debuginfo_file_or_error.is_error()) {
+            auto debuginfo_file = debuginfo_file_or_error.release_value();
+            auto debuginfo_image = ELF::Image(debuginfo_file->bytes());
+            g_kernel_debuginfo_object = { { move(debuginfo_file), move(debuginfo_image) } };
+        }
+    }
+
+    Vector<NonnullOwnPtr<Process>> all_processes;
+    HashMap<pid_t, Process*> current_processes;
+    Vector<Event> events;
+    EventSerialNumber next_serial;
+
+    auto maybe_kernel_base = Symbolication::kernel_base();
+
+    for (auto& perfcore_event : perfcore.events) {
+        auto& event = perfcore_event.event;
+
+        event.serial = next_serial;
+        next_serial.increment();
+
+        switch (perfcore_event.type) {
+        case PERF_EVENT_MMAP: {
+            auto const& mmap = event.data.get<Event::MmapData>();
+            auto it = current_processes.find(event.pid);
+            if (it != current_processes.end())
+                it->value->library_metadata.handle_mmap(mmap.ptr, mmap.size, mmap.name);
+            continue;
+        }
+        case PERF_EVENT_MUNMAP:
+            continue;
+        case PERF_EVENT_PROCESS_CREATE:
+        case PERF_EVENT_PROCESS_EXEC: {
+            auto executable = perfcore_event.type == PERF_EVENT_PROCESS_CREATE
+                ? event.data.get<Event::ProcessCreateData>().executable
+                : event.data.get<Event::ProcessExecData>().executable;
+
+            if (perfcore_event.type == PERF_EVENT_PROCESS_EXEC) {
+                if (auto* old_process = current_processes.get(event.pid).value_or(nullptr))
+                    old_process->end_valid = event.serial;
+                current_processes.remove(event.pid);
+            }
+
+            auto sampled_process = TRY(adopt_nonnull_own_or_enomem(new (nothrow) Process {
+                .pid = event.pid,
+                .executable = executable,
+                .basename = LexicalPath::basename(executable),
+                .start_valid = event.serial,
+                .end_valid = {},
+            }));
+
+            current_processes.set(sampled_process->pid, sampled_process);
+            all_processes.append(move(sampled_process));
+            continue;
+        }
+        case PERF_EVENT_PROCESS_EXIT:
+            if (auto* old_process = current_processes.get(event.pid).value_or(nullptr))
+                old_process->end_valid = event.serial;
+            current_processes.remove(event.pid);
+            continue;
+        case PERF_EVENT_THREAD_CREATE: {
+            auto it = current_processes.find(event.pid);
+            if (it != current_processes.end())
+                it->value->handle_thread_create(event.tid, event.serial);
+            continue;
+        }
+        case PERF_EVENT_THREAD_EXIT: {
+            auto it = current_processes.find(event.pid);
+            if (it != current_processes.end())
+                it->value->handle_thread_exit(event.tid, event.serial);
+            continue;
+        }
+        default:
+            break;
+        }
 
-        auto stack = perf_event.get_array("stack"sv);
-        VERIFY(stack.has_value());
-        auto const& stack_array = stack.value();
-        for (ssize_t i = stack_array.values().size() - 1; i >= 0; --i) {
-            auto const& frame = stack_array.at(i);
-            auto ptr = frame.as_integer<u64>();
+        for (ssize_t i = perfcore_event.stack.size() - 1; i >= 0; --i) {
+            auto ptr = perfcore_event.stack[i];
             u32 offset = 0;
             DeprecatedFlyString object_name;
             ByteString symbol;
@@ -530,7 +743,9 @@ ErrorOr<NonnullOwnPtr<Profile>> Profile::load_from_perfcore_file(StringView path
     for (auto& it : all_processes)
         processes.append(move(*it));
 
-    return adopt_nonnull_own_or_enomem(new (nothrow) Profile(move(processes), move(events)));
+    auto profile = TRY(adopt_nonnull_own_or_enomem(new (nothrow) Profile(move(processes), move(events))));
+    profile->m_lost_event_count = perfcore.lost_event_count;
+    return profile;
 }
 
 void ProfileNode::sort_children()
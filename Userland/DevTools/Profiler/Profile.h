@@ -294,6 +294,9 @@ public:
 
     Vector<Process> const& processes() const { return m_processes; }
 
+    // How many events the kernel had to drop while recording the profile.
+    u64 lost_event_count() const { return m_lost_event_count; }
+
     template<typename Callback>
     void for_each_event_in_filter_range(Callback callback)
     {
@@ -336,6 +339,7 @@ private:
     Vector<size_t> m_filtered_event_indices;
     u64 m_first_timestamp { 0 };
     u64 m_last_timestamp { 0 };
+    u64 m_lost_event_count { 0 };
 
     Vector<Process> m_processes;
     Vector<Event> m_events;
@@ -252,6 +252,8 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
                 builder.appendff(", Selection: {} - {} ms", start, end);
                 builder.appendff(", Duration: {} ms", end - start);
             }
+            if (profile->lost_event_count() > 0)
+                builder.appendff(", {} events lost", profile->lost_event_count());
         }
         statusbar.set_text(builder.to_string().release_value_but_fixme_should_propagate_errors());
     };
@@ -54,4 +54,38 @@ int sched_getparam(pid_t pid, struct sched_param* param)
         *param = parameters.parameters;
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
+
+// https://man7.org/linux/man-pages/man2/sched_setaffinity.2.html
+int sched_setaffinity(pid_t tid, size_t cpusetsize, cpu_set_t const* mask)
+{
+    if (cpusetsize < sizeof(cpu_set_t)) {
+        errno = EINVAL;
+        return -1;
+    }
+    Syscall::SC_scheduler_affinity_params parameters {
+        .pid_or_tid = tid,
+        .mode = Syscall::SchedulerParametersMode::Thread,
+        .affinity = mask->__bits,
+    };
+    int rc = syscall(SC_scheduler_set_affinity, &parameters);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
+// https://man7.org/linux/man-pages/man2/sched_getaffinity.2.html
+int sched_getaffinity(pid_t tid, size_t cpusetsize, cpu_set_t* mask)
+{
+    if (cpusetsize < sizeof(cpu_set_t)) {
+        errno = EINVAL;
+        return -1;
+    }
+    Syscall::SC_scheduler_affinity_params parameters {
+        .pid_or_tid = tid,
+        .mode = Syscall::SchedulerParametersMode::Thread,
+        .affinity = 0,
+    };
+    int rc = syscall(SC_scheduler_get_affinity, &parameters);
+    if (rc == 0)
+        mask->__bits = parameters.affinity;
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
 }
@@ -28,4 +28,19 @@ int sched_get_priority_max(int policy);
 int sched_setparam(pid_t pid, const struct sched_param* param);
 int sched_getparam(pid_t pid, struct sched_param* param);
 
+#define CPU_SETSIZE 64
+
+typedef struct {
+    unsigned long long __bits;
+} cpu_set_t;
+
+#define CPU_ZERO(set) ((set)->__bits = 0)
+#define CPU_SET(cpu, set) ((cpu) < CPU_SETSIZE ? (void)((set)->__bits |= 1ull << (cpu)) : (void)0)
+#define CPU_CLR(cpu, set) ((cpu) < CPU_SETSIZE ? (void)((set)->__bits &= ~(1ull << (cpu))) : (void)0)
+#define CPU_ISSET(cpu, set) ((cpu) < CPU_SETSIZE ? (int)(((set)->__bits >> (cpu)) & 1) : 0)
+#define CPU_COUNT(set) __builtin_popcountll((set)->__bits)
+
+int sched_setaffinity(pid_t tid, size_t cpusetsize, cpu_set_t const* mask);
+int sched_getaffinity(pid_t tid, size_t cpusetsize, cpu_set_t* mask);
+
 __END_DECLS
@@ -13,21 +13,49 @@
 
 #include <spawn.h>
 
-#include <AK/Function.h>
+#include <AK/ByteString.h>
+#include <AK/ScopedValueRollback.h>
 #include <AK/Vector.h>
+#include <alloca.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <syscall.h>
 #include <unistd.h>
 
 struct posix_spawn_file_actions_state {
-    Vector<Function<int()>, 4> actions;
+    Vector<Syscall::SC_posix_spawn_file_action, 4> actions;
 };
 
 extern "C" {
 
+static int run_file_action(Syscall::SC_posix_spawn_file_action const& action)
+{
+    switch (action.type) {
+    case Syscall::PosixSpawnFileActionType::Open: {
+        int opened_fd = open(action.path.characters, action.options, action.mode);
+        if (opened_fd < 0 || opened_fd == action.fd)
+            return opened_fd;
+        if (int rc = dup2(opened_fd, action.fd); rc < 0)
+            return rc;
+        return close(opened_fd);
+    }
+    case Syscall::PosixSpawnFileActionType::Close:
+        return close(action.fd);
+    case Syscall::PosixSpawnFileActionType::Dup2:
+        return dup2(action.fd, action.new_fd);
+    case Syscall::PosixSpawnFileActionType::Chdir:
+        return chdir(action.path.characters);
+    case Syscall::PosixSpawnFileActionType::Fchdir:
+        return fchdir(action.fd);
+    }
+    VERIFY_NOT_REACHED();
+}
+
 [[noreturn]] static void posix_spawn_child(char const* path, posix_spawn_file_actions_t const* file_actions, posix_spawnattr_t const* attr, char* const argv[], char* const envp[], int (*exec)(char const*, char* const[], char* const[]))
 {
     if (attr) {
@@ -86,7 +114,7 @@ extern "C" {
 
     if (file_actions) {
         for (auto const& action : file_actions->state->actions) {
-            if (action() < 0) {
+            if (run_file_action(action) < 0) {
                 perror("posix_spawn file action");
                 _exit(127);
             }
@@ -98,9 +126,94 @@ extern "C" {
     _exit(127);
 }
 
+// The kernel can set up everything but the process group, session and scheduling parameters of the child by itself.
+static constexpr short flags_handled_by_kernel = POSIX_SPAWN_RESETIDS | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+
+static bool can_spawn_in_kernel(posix_spawnattr_t const* attr)
+{
+    return !attr || !(attr->flags & ~flags_handled_by_kernel);
+}
+
+static int spawn_in_kernel(pid_t* out_pid, char const* path, posix_spawn_file_actions_t const* file_actions, posix_spawnattr_t const* attr, char* const argv[], char* const envp[])
+{
+    size_t arg_count = 0;
+    for (size_t i = 0; argv[i]; ++i)
+        ++arg_count;
+
+    size_t env_count = 0;
+    for (size_t i = 0; envp[i]; ++i)
+        ++env_count;
+
+    auto copy_strings = [&](auto& vec, size_t count, auto& output) {
+        output.length = count;
+        for (size_t i = 0; vec[i]; ++i) {
+            output.strings[i].characters = vec[i];
+            output.strings[i].length = strlen(vec[i]);
+        }
+    };
+
+    Syscall::SC_posix_spawn_params params {};
+    params.arguments.strings = (Syscall::StringArgument*)alloca(arg_count * sizeof(Syscall::StringArgument));
+    params.environment.strings = (Syscall::StringArgument*)alloca(env_count * sizeof(Syscall::StringArgument));
+
+    params.path = { path, strlen(path) };
+    copy_strings(argv, arg_count, params.arguments);
+    copy_strings(envp, env_count, params.environment);
+
+    if (file_actions) {
+        params.file_actions = file_actions->state->actions.data();
+        params.file_action_count = file_actions->state->actions.size();
+    }
+
+    if (attr) {
+        params.reset_ids = attr->flags & POSIX_SPAWN_RESETIDS;
+        params.set_signal_defaults = attr->flags & POSIX_SPAWN_SETSIGDEF;
+        params.set_signal_mask = attr->flags & POSIX_SPAWN_SETSIGMASK;
+        params.signal_defaults = attr->sigdefault;
+        params.signal_mask = attr->sigmask;
+    }
+
+    int rc = syscall(SC_posix_spawn, &params);
+    if (rc < 0)
+        return -rc;
+    *out_pid = rc;
+    return 0;
+}
+
+// Looks up the file that execvpe() would end up running, so that the child only has to be spawned once.
+// Candidates that we may not execute are skipped, but if nothing else turns up, that is reported as EACCES instead of ENOENT.
+static int find_executable_in_path(char const* file, ByteString& out_path)
+{
+    ScopedValueRollback errno_rollback(errno);
+
+    ByteString path = getenv("PATH");
+    if (path.is_empty())
+        path = DEFAULT_PATH;
+    bool found_inaccessible_candidate = false;
+    for (auto& part : path.split(':')) {
+        auto candidate = ByteString::formatted("{}/{}", part, file);
+        struct stat st;
+        if (stat(candidate.characters(), &st) < 0) {
+            if (errno == EACCES)
+                found_inaccessible_candidate = true;
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || access(candidate.characters(), X_OK) < 0) {
+            found_inaccessible_candidate = true;
+            continue;
+        }
+        out_path = move(candidate);
+        return 0;
+    }
+    return found_inaccessible_candidate ? EACCES : ENOENT;
+}
+
 // https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_spawn.html
 int posix_spawn(pid_t* out_pid, char const* path, posix_spawn_file_actions_t const* file_actions, posix_spawnattr_t const* attr, char* const argv[], char* const envp[])
 {
+    if (can_spawn_in_kernel(attr))
+        return spawn_in_kernel(out_pid, path, file_actions, attr, argv, envp);
+
     pid_t child_pid = fork();
     if (child_pid < 0)
         return errno;
@@ -116,6 +229,18 @@ int posix_spawn(pid_t* out_pid, char const* path, posix_spawn_file_actions_t con
 // https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_spawnp.html
 int posix_spawnp(pid_t* out_pid, char const* file, posix_spawn_file_actions_t const* file_actions, posix_spawnattr_t const* attr, char* const argv[], char* const envp[])
 {
+    if (can_spawn_in_kernel(attr)) {
+        if (strchr(file, '/'))
+            return spawn_in_kernel(out_pid, file, file_actions, attr, argv, envp);
+
+        // NOTE: The file actions run before the program is loaded, so trying one directory after another in the
+        //       kernel would repeat them (and their side effects) for every miss.
+        ByteString executable_path;
+        if (int rc = find_executable_in_path(file, executable_path); rc != 0)
+            return rc;
+        return spawn_in_kernel(out_pid, executable_path.characters(), file_actions, attr, argv, envp);
+    }
+
     pid_t child_pid = fork();
     if (child_pid < 0)
         return errno;
@@ -131,41 +256,34 @@ int posix_spawnp(pid_t* out_pid, char const* file, posix_spawn_file_actions_t co
 // https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_spawn_file_actions_addchdir.html
 int posix_spawn_file_actions_addchdir(posix_spawn_file_actions_t* actions, char const* path)
 {
-    actions->state->actions.append([path]() { return chdir(path); });
+    actions->state->actions.append({ Syscall::PosixSpawnFileActionType::Chdir, -1, -1, 0, 0, { path, strlen(path) } });
     return 0;
 }
 
 int posix_spawn_file_actions_addfchdir(posix_spawn_file_actions_t* actions, int fd)
 {
-    actions->state->actions.append([fd]() { return fchdir(fd); });
+    actions->state->actions.append({ Syscall::PosixSpawnFileActionType::Fchdir, fd, -1, 0, 0, {} });
     return 0;
 }
 
 // https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_spawn_file_actions_addclose.html
 int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* actions, int fd)
 {
-    actions->state->actions.append([fd]() { return close(fd); });
+    actions->state->actions.append({ Syscall::PosixSpawnFileActionType::Close, fd, -1, 0, 0, {} });
     return 0;
 }
 
 // https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_spawn_file_actions_adddup2.html
 int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* actions, int old_fd, int new_fd)
 {
-    actions->state->actions.append([old_fd, new_fd]() { return dup2(old_fd, new_fd); });
+    actions->state->actions.append({ Syscall::PosixSpawnFileActionType::Dup2, old_fd, new_fd, 0, 0, {} });
     return 0;
 }
 
 // https://pubs.opengroup.org/onlinepubs/9699919799/functions/posix_spawn_file_actions_addopen.html
 int posix_spawn_file_actions_addopen(posix_spawn_file_actions_t* actions, int want_fd, char const* path, int flags, mode_t mode)
 {
-    actions->state->actions.append([want_fd, path, flags, mode]() {
-        int opened_fd = open(path, flags, mode);
-        if (opened_fd < 0 || opened_fd == want_fd)
-            return opened_fd;
-        if (int rc = dup2(opened_fd, want_fd); rc < 0)
-            return rc;
-        return close(opened_fd);
-    });
+    actions->state->actions.append({ Syscall::PosixSpawnFileActionType::Open, want_fd, -1, flags, mode, { path, strlen(path) } });
     return 0;
 }
 
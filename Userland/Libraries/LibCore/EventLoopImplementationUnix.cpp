@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/AnyOf.h>
 #include <AK/BinaryHeap.h>
 #include <AK/Singleton.h>
 #include <AK/TemporaryChange.h>
@@ -48,6 +49,20 @@ bool has_flag(int value, int flag)
     return (value & flag) == flag;
 }
 
+NotificationType poll_events_to_notification_type(int revents)
+{
+    NotificationType type = NotificationType::None;
+    if (has_flag(revents, POLLIN))
+        type |= NotificationType::Read;
+    if (has_flag(revents, POLLOUT))
+        type |= NotificationType::Write;
+    if (has_flag(revents, POLLHUP))
+        type |= NotificationType::Read | NotificationType::HangUp;
+    if (has_flag(revents, POLLERR))
+        type |= NotificationType::Error;
+    return type;
+}
+
 class EventLoopTimeout {
 public:
     static constexpr ssize_t INVALID_INDEX = NumericLimits<ssize_t>::max();
@@ -281,17 +296,71 @@ struct ThreadData {
         wake_pipe_fds = result.release_value();
 
         // The wake pipe informs us of POSIX signals as well as manual calls to wake()
+#ifdef AK_OS_SERENITY
+        initialize_event_poll();
+        epoll_event event { .events = EPOLLIN, .data = { .fd = wake_pipe_fds[0] } };
+        MUST(Core::System::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_pipe_fds[0], &event));
+#else
         VERIFY(poll_fds.size() == 0);
         poll_fds.append({ .fd = wake_pipe_fds[0], .events = POLLIN, .revents = 0 });
         notifier_by_index.append(nullptr);
+#endif
+    }
+
+#ifdef AK_OS_SERENITY
+    void initialize_event_poll()
+    {
+        // NOTE: After a fork, the event poll is still shared with the parent, so the child needs one of its own.
+        if (epoll_fd != -1)
+            close(epoll_fd);
+
+        auto result = Core::System::epoll_create(EPOLL_CLOEXEC);
+        if (result.is_error()) {
+            warnln("\033[31;1mFailed to create event loop event poll:\033[0m {}", result.error());
+            VERIFY_NOT_REACHED();
+        }
+
+        epoll_fd = result.release_value();
+        VERIFY(notifiers_by_fd.is_empty());
+    }
+
+    void update_event_poll_interest(int fd, bool is_new)
+    {
+        auto it = notifiers_by_fd.find(fd);
+        if (it == notifiers_by_fd.end()) {
+            // The fd might have been closed already, which takes the interest with it.
+            (void)Core::System::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            return;
+        }
+
+        u32 events = 0;
+        for (auto* notifier : it->value)
+            events |= notification_type_to_poll_events(notifier->type());
+        epoll_event event { .events = events, .data = { .fd = fd } };
+
+        // If the fd was closed and reused behind our back, the kernel has dropped (or replaced) our interest.
+        auto result = Core::System::epoll_ctl(epoll_fd, is_new ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event);
+        if (result.is_error() && result.error().code() == (is_new ? EEXIST : ENOENT))
+            result = Core::System::epoll_ctl(epoll_fd, is_new ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+        if (result.is_error())
+            dbgln("EventLoopImplementationUnix: Failed to update interest in fd {}: {}", fd, result.error());
     }
+#endif
 
     // Each thread has its own timers, notifiers and a wake pipe.
     TimeoutSet timeouts;
 
+#ifdef AK_OS_SERENITY
+    // Notifiers are watched through an event poll, so waiting doesn't have to pass every fd to the kernel.
+    // More than one notifier can watch the same fd, the interest is the union of their types.
+    int epoll_fd { -1 };
+    HashMap<int, Vector<Notifier*, 1>> notifiers_by_fd;
+    Vector<epoll_event> epoll_events;
+#else
     Vector<pollfd> poll_fds;
     HashMap<Notifier*, size_t> notifier_by_ptr;
     Vector<Notifier*> notifier_by_index;
+#endif
 
     // The wake pipe is used to notify another event loop that someone has called wake(), or a signal has been received.
     // wake() writes 0i32 into the pipe, signals write the signal number (guaranteed non-zero).
@@ -383,7 +452,13 @@ retry:
 
 try_select_again:
     // select() and wait for file system events, calls to wake(), POSIX signals, or timer expirations.
+#ifdef AK_OS_SERENITY
+    // Make room for every registered fd and the wake pipe, so a single wait reports all of them.
+    thread_data.epoll_events.resize(thread_data.notifiers_by_fd.size() + 1);
+    ErrorOr<int> error_or_marked_fd_count = System::epoll_wait(thread_data.epoll_fd, thread_data.epoll_events, should_wait_forever ? -1 : timeout);
+#else
     ErrorOr<int> error_or_marked_fd_count = System::poll(thread_data.poll_fds, should_wait_forever ? -1 : timeout);
+#endif
     auto time_after_poll = MonotonicTime::now_coarse();
     // Because POSIX, we might spuriously return from select() with EINTR; just select again.
     if (error_or_marked_fd_count.is_error()) {
@@ -393,9 +468,18 @@ try_select_again:
         VERIFY_NOT_REACHED();
     }
 
+#ifdef AK_OS_SERENITY
+    auto ready_events = thread_data.epoll_events.span().trim(error_or_marked_fd_count.value());
+    bool wake_pipe_is_readable = any_of(ready_events, [&](auto& event) {
+        return event.data.fd == thread_data.wake_pipe_fds[0] && has_flag(event.events, POLLIN);
+    });
+#else
+    bool wake_pipe_is_readable = has_flag(thread_data.poll_fds[0].revents, POLLIN);
+#endif
+
     // We woke up due to a call to wake() or a POSIX signal.
     // Handle signals and see whether we need to handle events as well.
-    if (has_flag(thread_data.poll_fds[0].revents, POLLIN)) {
+    if (wake_pipe_is_readable) {
         int wake_events[8];
         ssize_t nread;
         // We might receive another signal while read()ing here. The signal will go to the handle_signal properly,
@@ -426,25 +510,27 @@ try_select_again:
 
     if (error_or_marked_fd_count.value() != 0) {
         // Handle file system notifiers by making them normal events.
+#ifdef AK_OS_SERENITY
+        for (auto& event : ready_events) {
+            auto it = thread_data.notifiers_by_fd.find(event.data.fd);
+            if (it == thread_data.notifiers_by_fd.end())
+                continue;
+
+            auto ready_type = poll_events_to_notification_type(event.events);
+            for (auto* notifier : it->value) {
+                auto type = ready_type & notifier->type();
+                if (type != NotificationType::None)
+                    ThreadEventQueue::current().post_event(*notifier, make<NotifierActivationEvent>(notifier->fd(), type));
+            }
+        }
+#else
         for (size_t i = 1; i < thread_data.poll_fds.size(); ++i) {
-            auto& revents = thread_data.poll_fds[i].revents;
             auto& notifier = *thread_data.notifier_by_index[i];
-
-            NotificationType type = NotificationType::None;
-            if (has_flag(revents, POLLIN))
-                type |= NotificationType::Read;
-            if (has_flag(revents, POLLOUT))
-                type |= NotificationType::Write;
-            if (has_flag(revents, POLLHUP))
-                type |= NotificationType::Read | NotificationType::HangUp;
-            if (has_flag(revents, POLLERR))
-                type |= NotificationType::Error;
-
-            type &= notifier.type();
-
+            auto type = poll_events_to_notification_type(thread_data.poll_fds[i].revents) & notifier.type();
             if (type != NotificationType::None)
                 ThreadEventQueue::current().post_event(notifier, make<NotifierActivationEvent>(notifier.fd(), type));
         }
+#endif
     }
 
     // Handle expired timers.
@@ -522,9 +608,13 @@ void EventLoopImplementationUnix::notify_forked_and_in_child()
 {
     auto& thread_data = ThreadData::the();
     thread_data.timeouts.clear();
+#ifdef AK_OS_SERENITY
+    thread_data.notifiers_by_fd.clear();
+#else
     thread_data.poll_fds.clear();
     thread_data.notifier_by_ptr.clear();
     thread_data.notifier_by_index.clear();
+#endif
     thread_data.initialize_wake_pipe();
     if (auto* info = signals_info<false>()) {
         info->signal_handlers.clear();
@@ -680,6 +770,11 @@ void EventLoopManagerUnix::register_notifier(Notifier& notifier)
 {
     auto& thread_data = ThreadData::the();
 
+#ifdef AK_OS_SERENITY
+    auto& notifiers = thread_data.notifiers_by_fd.ensure(notifier.fd());
+    notifiers.append(&notifier);
+    thread_data.update_event_poll_interest(notifier.fd(), notifiers.size() == 1);
+#else
     thread_data.notifier_by_ptr.set(&notifier, thread_data.poll_fds.size());
     thread_data.notifier_by_index.append(&notifier);
     thread_data.poll_fds.append({
@@ -687,6 +782,7 @@ void EventLoopManagerUnix::register_notifier(Notifier& notifier)
         .events = notification_type_to_poll_events(notifier.type()),
         .revents = 0,
     });
+#endif
 
     notifier.set_owner_thread(s_thread_id);
 }
@@ -698,6 +794,15 @@ void EventLoopManagerUnix::unregister_notifier(Notifier& notifier)
         return;
 
     auto& thread_data = *thread_data_ptr;
+#ifdef AK_OS_SERENITY
+    auto it = thread_data.notifiers_by_fd.find(notifier.fd());
+    VERIFY(it != thread_data.notifiers_by_fd.end());
+    auto did_remove = it->value.remove_first_matching([&](auto* entry) { return entry == &notifier; });
+    VERIFY(did_remove);
+    if (it->value.is_empty())
+        thread_data.notifiers_by_fd.remove(it);
+    thread_data.update_event_poll_interest(notifier.fd(), false);
+#else
     auto it = thread_data.notifier_by_ptr.find(&notifier);
     VERIFY(it != thread_data.notifier_by_ptr.end());
 
@@ -711,6 +816,7 @@ void EventLoopManagerUnix::unregister_notifier(Notifier& notifier)
     }
     thread_data.poll_fds.take_last();
     thread_data.notifier_by_index.take_last();
+#endif
 }
 
 void EventLoopManagerUnix::did_post_event()
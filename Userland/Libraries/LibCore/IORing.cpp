@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/Atomic.h>
+#include <AK/OwnPtr.h>
+#include <AK/ScopeGuard.h>
+#include <LibCore/IORing.h>
+#include <LibCore/System.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+namespace Core {
+
+ErrorOr<NonnullOwnPtr<IORing>> IORing::create(u32 entries)
+{
+    auto fd = TRY(System::io_ring_setup(entries, O_CLOEXEC));
+    ArmedScopeGuard close_fd = [&] { (void)System::close(fd); };
+
+    // The header tells us how large the whole ring is.
+    auto* header_mapping = TRY(System::mmap(nullptr, PAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0));
+    size_t size = static_cast<IORingHeader const*>(header_mapping)->size;
+    TRY(System::munmap(header_mapping, PAGE_SIZE));
+
+    auto* mapping = TRY(System::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0, 0, "IORing"sv));
+    auto ring = adopt_own_if_nonnull(new (nothrow) IORing(fd, static_cast<u8*>(mapping), size));
+    if (!ring) {
+        (void)System::munmap(mapping, size);
+        return Error::from_errno(ENOMEM);
+    }
+    close_fd.disarm();
+    return ring.release_nonnull();
+}
+
+IORing::IORing(int fd, u8* mapping, size_t size)
+    : m_fd(fd)
+    , m_mapping(mapping)
+    , m_size(size)
+    , m_submission_entries(header().submission_entries)
+    , m_completion_entries(header().completion_entries)
+    , m_submissions(reinterpret_cast<IORingSubmission*>(mapping + header().submissions_offset))
+    , m_completions(reinterpret_cast<IORingCompletion*>(mapping + header().completions_offset))
+    , m_submission_tail(header().submission_tail)
+    , m_completion_head(header().completion_head)
+{
+}
+
+IORing::~IORing()
+{
+    MUST(System::munmap(m_mapping, m_size));
+    MUST(System::close(m_fd));
+}
+
+bool IORing::queue(IORingSubmission const& submission)
+{
+    u32 head = AK::atomic_load(&header().submission_head, AK::MemoryOrder::memory_order_acquire);
+    if (m_submission_tail - head >= m_submission_entries)
+        return false;
+    m_submissions[m_submission_tail & (m_submission_entries - 1)] = submission;
+    // NOTE: The kernel only gets to see the submission once it's published by submit().
+    ++m_submission_tail;
+    return true;
+}
+
+bool IORing::queue_nop(u64 user_data)
+{
+    return queue({ .operation = IORingOperation::Nop, .user_data = user_data });
+}
+
+bool IORing::queue_read(int fd, Bytes buffer, Optional<off_t> offset, u64 user_data)
+{
+    return queue({
+        .operation = IORingOperation::Read,
+        .fd = fd,
+        .offset = offset.value_or(-1),
+        .address = reinterpret_cast<FlatPtr>(buffer.data()),
+        .length = static_cast<u32>(buffer.size()),
+        .user_data = user_data,
+    });
+}
+
+bool IORing::queue_write(int fd, ReadonlyBytes buffer, Optional<off_t> offset, u64 user_data)
+{
+    return queue({
+        .operation = IORingOperation::Write,
+        .fd = fd,
+        .offset = offset.value_or(-1),
+        .address = reinterpret_cast<FlatPtr>(buffer.data()),
+        .length = static_cast<u32>(buffer.size()),
+        .user_data = user_data,
+    });
+}
+
+bool IORing::queue_accept(int fd, sockaddr* address, socklen_t* address_size, int flags, u64 user_data)
+{
+    return queue({
+        .operation = IORingOperation::Accept,
+        .fd = fd,
+        .address = reinterpret_cast<FlatPtr>(address),
+        .address2 = reinterpret_cast<FlatPtr>(address_size),
+        .flags = static_cast<u32>(flags),
+        .user_data = user_data,
+    });
+}
+
+bool IORing::queue_connect(int fd, sockaddr const* address, socklen_t address_size, u64 user_data)
+{
+    return queue({
+        .operation = IORingOperation::Connect,
+        .fd = fd,
+        .address = reinterpret_cast<FlatPtr>(address),
+        .length = address_size,
+        .user_data = user_data,
+    });
+}
+
+bool IORing::queue_fsync(int fd, u64 user_data)
+{
+    return queue({ .operation = IORingOperation::Fsync, .fd = fd, .user_data = user_data });
+}
+
+u32 IORing::pending_submission_count() const
+{
+    return m_submission_tail - AK::atomic_load(&header().submission_head, AK::MemoryOrder::memory_order_acquire);
+}
+
+ErrorOr<size_t> IORing::submit()
+{
+    AK::atomic_store(&header().submission_tail, m_submission_tail, AK::MemoryOrder::memory_order_release);
+    auto count = pending_submission_count();
+    if (count == 0)
+        return 0;
+    return System::io_ring_enter(m_fd, count);
+}
+
+Optional<IORingCompletion> IORing::next_completion()
+{
+    u32 tail = AK::atomic_load(&header().completion_tail, AK::MemoryOrder::memory_order_acquire);
+    if (m_completion_head == tail)
+        return {};
+    auto completion = m_completions[m_completion_head & (m_completion_entries - 1)];
+    ++m_completion_head;
+    AK::atomic_store(&header().completion_head, m_completion_head, AK::MemoryOrder::memory_order_release);
+    return completion;
+}
+
+}
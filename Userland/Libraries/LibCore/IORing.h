@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <AK/Error.h>
+#include <AK/Noncopyable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Optional.h>
+#include <AK/Span.h>
+#include <Kernel/API/IORing.h>
+#include <sys/socket.h>
+
+namespace Core {
+
+// Batches I/O operations through an I/O ring (see Kernel/API/IORing.h), so that many of them only cost a single syscall.
+//
+// Operations are queued with the queue_*() functions, handed to the kernel with submit(), and their results are picked
+// up with next_completion(). The user_data of an operation is passed through to its completion. Buffers and addresses
+// have to stay alive until the operation has completed.
+class IORing {
+    AK_MAKE_NONCOPYABLE(IORing);
+    AK_MAKE_NONMOVABLE(IORing);
+
+public:
+    static ErrorOr<NonnullOwnPtr<IORing>> create(u32 entries);
+    ~IORing();
+
+    // These return false if the submission queue is full.
+    [[nodiscard]] bool queue(IORingSubmission const&);
+    [[nodiscard]] bool queue_nop(u64 user_data);
+    // Without an offset, the file's position is used and advanced, like read() and write() do.
+    [[nodiscard]] bool queue_read(int fd, Bytes, Optional<off_t>, u64 user_data);
+    [[nodiscard]] bool queue_write(int fd, ReadonlyBytes, Optional<off_t>, u64 user_data);
+    [[nodiscard]] bool queue_accept(int fd, sockaddr*, socklen_t*, int flags, u64 user_data);
+    [[nodiscard]] bool queue_connect(int fd, sockaddr const*, socklen_t, u64 user_data);
+    [[nodiscard]] bool queue_fsync(int fd, u64 user_data);
+
+    // Operations that have been queued, but not taken by the kernel yet.
+    u32 pending_submission_count() const;
+
+    // Carries out the queued operations. Returns how many were taken, which may be fewer than were queued if there isn't
+    // enough room for their completions. Fails with EBUSY if there's no room at all.
+    ErrorOr<size_t> submit();
+
+    // The result is what the corresponding syscall would have returned, or a negated errno.
+    Optional<IORingCompletion> next_completion();
+
+    u32 submission_entries() const { return m_submission_entries; }
+
+private:
+    IORing(int fd, u8* mapping, size_t size);
+
+    IORingHeader& header() { return *reinterpret_cast<IORingHeader*>(m_mapping); }
+    IORingHeader const& header() const { return *reinterpret_cast<IORingHeader const*>(m_mapping); }
+
+    int m_fd { -1 };
+    u8* m_mapping { nullptr };
+    size_t m_size { 0 };
+
+    u32 m_submission_entries { 0 };
+    u32 m_completion_entries { 0 };
+    IORingSubmission* m_submissions { nullptr };
+    IORingCompletion* m_completions { nullptr };
+
+    // We're the only ones to advance these, so we don't have to read them back from the ring.
+    u32 m_submission_tail { 0 };
+    u32 m_completion_head { 0 };
+};
+
+}
@@ -35,6 +35,7 @@
 #    include <serenity.h>
 #    include <sys/prctl.h>
 #    include <sys/ptrace.h>
+#    include <sys/sendfile.h>
 #    include <sys/sysmacros.h>
 #endif
 
@@ -412,6 +413,53 @@ ErrorOr<void> profiling_free_buffer(pid_t pid)
     int rc = ::profiling_free_buffer(pid);
     HANDLE_SYSCALL_RETURN_VALUE("profiling_free_buffer", rc, {});
 }
+
+ErrorOr<int> epoll_create(int flags)
+{
+    int rc = ::epoll_create1(flags);
+    if (rc < 0)
+        return Error::from_syscall("epoll_create1"sv, -errno);
+    return rc;
+}
+
+ErrorOr<void> epoll_ctl(int epoll_fd, int op, int fd, struct epoll_event* event)
+{
+    if (::epoll_ctl(epoll_fd, op, fd, event) < 0)
+        return Error::from_syscall("epoll_ctl"sv, -errno);
+    return {};
+}
+
+ErrorOr<int> epoll_wait(int epoll_fd, Span<struct epoll_event> events, int timeout)
+{
+    int rc = ::epoll_wait(epoll_fd, events.data(), events.size(), timeout);
+    if (rc < 0)
+        return Error::from_syscall("epoll_wait"sv, -errno);
+    return rc;
+}
+
+ErrorOr<size_t> sendfile(int out_fd, int in_fd, off_t* offset, size_t count)
+{
+    auto rc = ::sendfile(out_fd, in_fd, offset, count);
+    if (rc < 0)
+        return Error::from_syscall("sendfile"sv, -errno);
+    return static_cast<size_t>(rc);
+}
+
+ErrorOr<int> io_ring_setup(u32 entries, int options)
+{
+    int rc = ::io_ring_setup(entries, options);
+    if (rc < 0)
+        return Error::from_syscall("io_ring_setup"sv, -errno);
+    return rc;
+}
+
+ErrorOr<size_t> io_ring_enter(int fd, u32 to_submit)
+{
+    int rc = ::io_ring_enter(fd, to_submit);
+    if (rc < 0)
+        return Error::from_syscall("io_ring_enter"sv, -errno);
+    return static_cast<size_t>(rc);
+}
 #endif
 
 #if !defined(AK_OS_BSD_GENERIC)
@@ -1548,6 +1596,24 @@ ErrorOr<ssize_t> recvfrom(int sockfd, void* buffer, size_t buffer_length, int fl
     return received;
 }
 
+#if defined(AK_OS_SERENITY) || defined(AK_OS_LINUX)
+ErrorOr<size_t> sendmmsg(int sockfd, struct mmsghdr* messages, unsigned message_count, int flags)
+{
+    auto sent = ::sendmmsg(sockfd, messages, message_count, flags);
+    if (sent < 0)
+        return Error::from_syscall("sendmmsg"sv, -errno);
+    return static_cast<size_t>(sent);
+}
+
+ErrorOr<size_t> recvmmsg(int sockfd, struct mmsghdr* messages, unsigned message_count, int flags, struct timespec* timeout)
+{
+    auto received = ::recvmmsg(sockfd, messages, message_count, flags, timeout);
+    if (received < 0)
+        return Error::from_syscall("recvmmsg"sv, -errno);
+    return static_cast<size_t>(received);
+}
+#endif
+
 ErrorOr<AddressInfoVector> getaddrinfo(char const* nodename, char const* servname, struct addrinfo const& hints)
 {
     struct addrinfo* results = nullptr;
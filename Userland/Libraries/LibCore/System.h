@@ -47,6 +47,7 @@
 
 #ifdef AK_OS_SERENITY
 #    include <Kernel/API/Unshare.h>
+#    include <sys/epoll.h>
 #endif
 
 namespace Core::System {
@@ -73,6 +74,12 @@ ErrorOr<void> disown(pid_t pid);
 ErrorOr<void> profiling_enable(pid_t, u64 event_mask);
 ErrorOr<void> profiling_disable(pid_t);
 ErrorOr<void> profiling_free_buffer(pid_t);
+ErrorOr<int> epoll_create(int flags);
+ErrorOr<void> epoll_ctl(int epoll_fd, int op, int fd, struct epoll_event* event);
+ErrorOr<int> epoll_wait(int epoll_fd, Span<struct epoll_event>, int timeout);
+ErrorOr<size_t> sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+ErrorOr<int> io_ring_setup(u32 entries, int options);
+ErrorOr<size_t> io_ring_enter(int fd, u32 to_submit);
 #else
 inline ErrorOr<void> unveil(StringView, StringView)
 {
@@ -227,6 +234,10 @@ ErrorOr<ssize_t> sendto(int sockfd, void const*, size_t, int flags, struct socka
 ErrorOr<ssize_t> recv(int sockfd, void*, size_t, int flags);
 ErrorOr<ssize_t> recvmsg(int sockfd, struct msghdr*, int flags);
 ErrorOr<ssize_t> recvfrom(int sockfd, void*, size_t, int flags, struct sockaddr*, socklen_t*);
+#if defined(AK_OS_SERENITY) || defined(AK_OS_LINUX)
+ErrorOr<size_t> sendmmsg(int sockfd, struct mmsghdr*, unsigned vlen, int flags);
+ErrorOr<size_t> recvmmsg(int sockfd, struct mmsghdr*, unsigned vlen, int flags, struct timespec* timeout);
+#endif
 ErrorOr<void> getsockopt(int sockfd, int level, int option, void* value, socklen_t* value_size);
 ErrorOr<void> setsockopt(int sockfd, int level, int option, void const* value, socklen_t value_size);
 ErrorOr<void> getsockname(int sockfd, struct sockaddr*, socklen_t*);
@@ -72,6 +72,55 @@ ErrorOr<ByteBuffer> UDPServer::receive(size_t size, sockaddr_in& in)
     return buf;
 }
 
+ErrorOr<Vector<UDPServer::Datagram>> UDPServer::receive_batch(size_t max_count, size_t size)
+{
+    Vector<Datagram> datagrams;
+    TRY(datagrams.try_ensure_capacity(max_count));
+    for (size_t i = 0; i < max_count; ++i)
+        datagrams.unchecked_append({ TRY(ByteBuffer::create_uninitialized(size)), {} });
+
+#if defined(AK_OS_SERENITY) || defined(AK_OS_LINUX)
+    Vector<iovec> iovs;
+    Vector<mmsghdr> messages;
+    TRY(iovs.try_resize(max_count));
+    TRY(messages.try_resize(max_count));
+    for (size_t i = 0; i < max_count; ++i) {
+        iovs[i] = { datagrams[i].data.data(), size };
+        auto& header = messages[i].msg_hdr;
+        header = {};
+        header.msg_name = &datagrams[i].from;
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_iov = &iovs[i];
+        header.msg_iovlen = 1;
+    }
+
+    auto result = Core::System::recvmmsg(m_fd, messages.data(), max_count, 0, nullptr);
+    if (result.is_error()) {
+        if (result.error().code() == EAGAIN)
+            return Vector<Datagram> {};
+        return result.release_error();
+    }
+    auto count = result.release_value();
+    for (size_t i = 0; i < count; ++i)
+        datagrams[i].data.resize(messages[i].msg_len);
+#else
+    size_t count = 0;
+    for (; count < max_count; ++count) {
+        socklen_t from_length = sizeof(sockaddr_in);
+        auto result = Core::System::recvfrom(m_fd, datagrams[count].data.data(), size, 0, (sockaddr*)&datagrams[count].from, &from_length);
+        if (result.is_error()) {
+            if (result.error().code() == EAGAIN)
+                break;
+            return result.release_error();
+        }
+        datagrams[count].data.resize(result.value());
+    }
+#endif
+
+    datagrams.shrink(count);
+    return datagrams;
+}
+
 Optional<IPv4Address> UDPServer::local_address() const
 {
     if (m_fd == -1)
@@ -112,4 +161,49 @@ ErrorOr<size_t> UDPServer::send(ReadonlyBytes buffer, sockaddr_in const& to)
     return result;
 }
 
+ErrorOr<size_t> UDPServer::send_batch(ReadonlySpan<OutgoingDatagram> datagrams)
+{
+    if (m_fd < 0)
+        return Error::from_errno(EBADF);
+
+#if defined(AK_OS_SERENITY) || defined(AK_OS_LINUX)
+    Vector<iovec> iovs;
+    Vector<mmsghdr> messages;
+    TRY(iovs.try_resize(datagrams.size()));
+    TRY(messages.try_resize(datagrams.size()));
+    for (size_t i = 0; i < datagrams.size(); ++i) {
+        iovs[i] = { const_cast<u8*>(datagrams[i].data.data()), datagrams[i].data.size() };
+        auto& header = messages[i].msg_hdr;
+        header = {};
+        header.msg_name = const_cast<sockaddr_in*>(&datagrams[i].to);
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_iov = &iovs[i];
+        header.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    while (sent < datagrams.size()) {
+        auto result = Core::System::sendmmsg(m_fd, messages.data() + sent, datagrams.size() - sent, 0);
+        if (result.is_error()) {
+            if (result.error().code() == EAGAIN && sent > 0)
+                break;
+            return result.release_error();
+        }
+        sent += result.value();
+    }
+    return sent;
+#else
+    size_t sent = 0;
+    for (; sent < datagrams.size(); ++sent) {
+        auto result = Core::System::sendto(m_fd, datagrams[sent].data.data(), datagrams[sent].data.size(), 0, (sockaddr const*)&datagrams[sent].to, sizeof(sockaddr_in));
+        if (result.is_error()) {
+            if (result.error().code() == EAGAIN && sent > 0)
+                break;
+            return result.release_error();
+        }
+    }
+    return sent;
+#endif
+}
+
 }
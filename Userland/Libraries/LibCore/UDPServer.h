@@ -10,6 +10,7 @@
 #include <AK/ByteBuffer.h>
 #include <AK/Forward.h>
 #include <AK/Function.h>
+#include <AK/Vector.h>
 #include <LibCore/EventReceiver.h>
 #include <LibCore/Forward.h>
 #include <LibCore/SocketAddress.h>
@@ -19,6 +20,16 @@ namespace Core {
 class UDPServer : public EventReceiver {
     C_OBJECT(UDPServer)
 public:
+    struct Datagram {
+        ByteBuffer data;
+        sockaddr_in from;
+    };
+
+    struct OutgoingDatagram {
+        ReadonlyBytes data;
+        sockaddr_in to;
+    };
+
     virtual ~UDPServer() override;
 
     bool is_bound() const { return m_bound; }
@@ -31,8 +42,15 @@ public:
         return receive(size, saddr);
     }
 
+    // Receives up to max_count datagrams that are already waiting, using a single syscall where possible.
+    // Returns an empty vector if there aren't any.
+    ErrorOr<Vector<Datagram>> receive_batch(size_t max_count, size_t size);
+
     ErrorOr<size_t> send(ReadonlyBytes, sockaddr_in const& to);
 
+    // Returns how many of the datagrams were sent, which is less than all of them only if the socket would block.
+    ErrorOr<size_t> send_batch(ReadonlySpan<OutgoingDatagram>);
+
     Optional<IPv4Address> local_address() const;
     Optional<u16> local_port() const;
 
@@ -137,6 +137,13 @@ u64 randomized_runs();
         ::Test::set_current_test_result(::Test::TestResult::Failed);                       \
     } while (false)
 
+#define SKIP(message)                                                                      \
+    do {                                                                                   \
+        if (::Test::is_reporting_enabled())                                                \
+            ::AK::warnln("\033[33;1mSKIP\033[0m: {}:{}: {}", __FILE__, __LINE__, message); \
+        ::Test::set_current_test_result(::Test::TestResult::Skipped);                      \
+    } while (false)
+
 // To use, specify the lambda to execute in a sub process and verify it exits:
 //  EXPECT_CRASH("This should fail", []{
 //      return Test::Crash::Failure::DidNotCrash;
@@ -26,6 +26,9 @@ enum class TestResult {
     // Ran out of RandomRun data (in a randomized test, when shrinking).
     // This is fine, we'll just try some other shrink.
     Overrun,
+
+    // User used SKIP(...) because the test can't run in the current environment.
+    Skipped,
 };
 
 // Used eg. to signal we've ran out of prerecorded random bits.
@@ -112,6 +112,8 @@ static ByteString test_result_to_string(TestResult result)
         return "Rejected";
     case TestResult::Overrun:
         return "Ran out of randomness";
+    case TestResult::Skipped:
+        return "Skipped";
     default:
         return "Unknown TestResult";
     }
@@ -179,9 +181,11 @@ int TestSuite::run(Vector<NonnullRefPtr<TestCase>> const& tests)
     size_t test_count = 0;
     size_t test_passed_count = 0;
     size_t test_failed_count = 0;
+    size_t test_skipped_count = 0;
     size_t benchmark_count = 0;
     size_t benchmark_passed_count = 0;
     size_t benchmark_failed_count = 0;
+    size_t benchmark_skipped_count = 0;
     TestElapsedTimer global_timer;
 
     for (auto const& t : tests) {
@@ -234,6 +238,9 @@ int TestSuite::run(Vector<NonnullRefPtr<TestCase>> const& tests)
             case TestResult::Failed:
                 benchmark_failed_count++;
                 break;
+            case TestResult::Skipped:
+                benchmark_skipped_count++;
+                break;
             default:
                 break;
             }
@@ -248,6 +255,9 @@ int TestSuite::run(Vector<NonnullRefPtr<TestCase>> const& tests)
             case TestResult::Failed:
                 test_failed_count++;
                 break;
+            case TestResult::Skipped:
+                test_skipped_count++;
+                break;
             default:
                 break;
             }
@@ -265,6 +275,8 @@ int TestSuite::run(Vector<NonnullRefPtr<TestCase>> const& tests)
     if (test_count != 0) {
         if (test_passed_count == test_count) {
             dbgln("All {} tests passed.", test_count);
+        } else if (test_skipped_count != 0 && test_passed_count + test_skipped_count == test_count) {
+            dbgln("Out of {} tests, {} passed and {} were skipped.", test_count, test_passed_count, test_skipped_count);
         } else if (test_passed_count + test_failed_count == test_count) {
             dbgln("Out of {} tests, {} passed and {} failed.", test_count, test_passed_count, test_failed_count);
         } else {
@@ -275,6 +287,8 @@ int TestSuite::run(Vector<NonnullRefPtr<TestCase>> const& tests)
     if (benchmark_count != 0) {
         if (benchmark_passed_count == benchmark_count) {
             dbgln("All {} benchmarks passed.", benchmark_count);
+        } else if (benchmark_skipped_count != 0 && benchmark_passed_count + benchmark_skipped_count == benchmark_count) {
+            dbgln("Out of {} benchmarks, {} passed and {} were skipped.", benchmark_count, benchmark_passed_count, benchmark_skipped_count);
         } else if (benchmark_passed_count + benchmark_failed_count == benchmark_count) {
             dbgln("Out of {} benchmarks, {} passed and {} failed.", benchmark_count, benchmark_passed_count, benchmark_failed_count);
         } else {
@@ -282,9 +296,9 @@ int TestSuite::run(Vector<NonnullRefPtr<TestCase>> const& tests)
         }
     }
 
-    // We have multiple TestResults, all except for Passed being "bad".
+    // We have multiple TestResults, all except for Passed and Skipped being "bad".
     // Let's get a count of them:
-    return (int)(test_count - test_passed_count + benchmark_count - benchmark_passed_count);
+    return (int)(test_count - test_passed_count - test_skipped_count + benchmark_count - benchmark_passed_count - benchmark_skipped_count);
 }
 
 } // namespace Test
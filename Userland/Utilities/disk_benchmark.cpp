@@ -5,8 +5,10 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/Atomic.h>
 #include <AK/ByteBuffer.h>
 #include <AK/ByteString.h>
+#include <AK/Random.h>
 #include <AK/ScopeGuard.h>
 #include <AK/Types.h>
 #include <AK/Vector.h>
@@ -15,7 +17,9 @@
 #include <LibCore/System.h>
 #include <LibMain/Main.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -39,7 +43,16 @@ static Result average_result(Vector<Result> const& results)
     return average;
 }
 
+struct RandomIOResult {
+    u64 operations {};
+    u64 bytes {};
+    Duration elapsed;
+};
+
 static ErrorOr<Result> benchmark(ByteString const& filename, int file_size, ByteBuffer& buffer, bool allow_cache);
+static ErrorOr<RandomIOResult> random_io_benchmark(ByteString const& filename, size_t file_size, size_t block_size, size_t thread_count, Duration duration, bool allow_cache);
+static ErrorOr<void> run_random_io_benchmarks(ByteString const& filename, Vector<size_t> const& file_sizes, Vector<size_t> const& block_sizes, Vector<size_t> const& thread_counts, Duration time_per_benchmark, bool allow_cache);
+static ErrorOr<void> run_directory_benchmark(ByteString const& path, size_t entry_count);
 
 ErrorOr<int> serenity_main(Main::Arguments arguments)
 {
@@ -49,7 +62,10 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
     i64 time_per_benchmark_sec = 10;
     Vector<size_t> file_sizes;
     Vector<size_t> block_sizes;
+    Vector<size_t> thread_counts;
     bool allow_cache = false;
+    bool random_io = false;
+    size_t entry_count = 0;
 
     Core::ArgsParser args_parser;
     args_parser.add_option(allow_cache, "Allow using disk cache", "cache", 'c');
@@ -57,6 +73,9 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
     args_parser.add_option(time_per_benchmark_sec, "Time elapsed per benchmark (seconds)", "time-per-benchmark", 't', "time-per-benchmark");
     args_parser.add_option(file_sizes, "A comma-separated list of file sizes", "file-size", 'f', "file-size");
     args_parser.add_option(block_sizes, "A comma-separated list of block sizes", "block-size", 'b', "block-size");
+    args_parser.add_option(random_io, "Measure random reads from concurrent threads instead", "random", 'r');
+    args_parser.add_option(thread_counts, "A comma-separated list of thread counts for random reads", "threads", 'j', "threads");
+    args_parser.add_option(entry_count, "Measure creating, looking up and removing this many files in a single directory instead", "entries", 'e', "entries");
     args_parser.parse(arguments);
 
     Duration const time_per_benchmark = Duration::from_seconds(time_per_benchmark_sec);
@@ -68,8 +87,21 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
         block_sizes = { 8192, 32768, 65536 };
     }
 
+    if (entry_count > 0) {
+        TRY(run_directory_benchmark(ByteString::formatted("{}/disk_benchmark.dir", directory), entry_count));
+        return 0;
+    }
+
     auto filename = ByteString::formatted("{}/disk_benchmark.tmp", directory);
 
+    if (random_io) {
+        if (thread_counts.size() == 0) {
+            thread_counts = { 1, 2, 4, 8 };
+        }
+        TRY(run_random_io_benchmarks(filename, file_sizes, block_sizes, thread_counts, time_per_benchmark, allow_cache));
+        return 0;
+    }
+
     for (auto file_size : file_sizes) {
         for (auto block_size : block_sizes) {
             if (block_size > file_size)
@@ -143,3 +175,182 @@ ErrorOr<Result> benchmark(ByteString const& filename, int file_size, ByteBuffer&
     result.read_bps = (u64)(timer.elapsed_milliseconds() ? (file_size / timer.elapsed_milliseconds()) : file_size) * 1000;
     return result;
 }
+
+ErrorOr<void> run_random_io_benchmarks(ByteString const& filename, Vector<size_t> const& file_sizes, Vector<size_t> const& block_sizes, Vector<size_t> const& thread_counts, Duration time_per_benchmark, bool allow_cache)
+{
+    for (auto file_size : file_sizes) {
+        // Fill the file once, all threads then read from it at random block-aligned offsets.
+        {
+            int fd = TRY(Core::System::open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0644));
+            auto close_fd = ScopeGuard([fd] { (void)Core::System::close(fd); });
+            auto buffer = TRY(ByteBuffer::create_zeroed(min(file_size, 65536uz)));
+            size_t total_written = 0;
+            while (total_written < file_size)
+                total_written += TRY(Core::System::write(fd, buffer.bytes().trim(file_size - total_written)));
+            TRY(Core::System::fsync(fd));
+        }
+        auto unlink_file = ScopeGuard([&filename] {
+            if (auto result = Core::System::unlink(filename); result.is_error())
+                warnln("{}", result.release_error());
+        });
+
+        for (auto block_size : block_sizes) {
+            if (block_size > file_size)
+                continue;
+
+            u64 single_thread_iops = 0;
+            for (auto thread_count : thread_counts) {
+                if (thread_count == 0)
+                    continue;
+
+                outln("Running: file_size={} block_size={} threads={}", file_size, block_size, thread_count);
+                auto result = TRY(random_io_benchmark(filename, file_size, block_size, thread_count, time_per_benchmark, allow_cache));
+                auto elapsed_ms = max(result.elapsed.to_milliseconds(), 1);
+                u64 iops = result.operations * 1000 / elapsed_ms;
+                u64 read_bps = result.bytes * 1000 / elapsed_ms;
+                if (thread_count == thread_counts.first())
+                    single_thread_iops = iops;
+
+                out("Finished: operations={} iops={} read_bps={}", result.operations, iops, read_bps);
+                if (single_thread_iops && thread_count != thread_counts.first())
+                    out(" scaling={:.2}x", static_cast<double>(iops) / single_thread_iops);
+                outln();
+                sleep(1);
+            }
+        }
+    }
+    return {};
+}
+
+struct RandomIOThread {
+    pthread_t thread {};
+    ByteString const* filename { nullptr };
+    int flags { 0 };
+    size_t block_size { 0 };
+    size_t block_count { 0 };
+    Duration duration;
+    Atomic<bool>* failed { nullptr };
+    RandomIOResult result;
+};
+
+static void* random_io_thread(void* argument)
+{
+    auto& context = *static_cast<RandomIOThread*>(argument);
+    auto fd_or_error = Core::System::open(*context.filename, context.flags);
+    auto buffer_or_error = ByteBuffer::create_uninitialized(context.block_size);
+    if (fd_or_error.is_error() || buffer_or_error.is_error()) {
+        *context.failed = true;
+        return nullptr;
+    }
+    int fd = fd_or_error.value();
+    auto buffer = buffer_or_error.release_value();
+
+    auto timer = Core::ElapsedTimer::start_new();
+    while (timer.elapsed_time() < context.duration) {
+        off_t offset = static_cast<off_t>(AK::get_random_uniform_64(context.block_count)) * context.block_size;
+        auto nread = pread(fd, buffer.data(), context.block_size, offset);
+        if (nread < 0) {
+            perror("pread");
+            *context.failed = true;
+            break;
+        }
+        ++context.result.operations;
+        context.result.bytes += nread;
+    }
+
+    (void)Core::System::close(fd);
+    return nullptr;
+}
+
+ErrorOr<RandomIOResult> random_io_benchmark(ByteString const& filename, size_t file_size, size_t block_size, size_t thread_count, Duration duration, bool allow_cache)
+{
+    int flags = O_RDONLY;
+    if (!allow_cache)
+        flags |= O_DIRECT;
+
+    Atomic<bool> failed { false };
+    Vector<RandomIOThread> threads;
+    TRY(threads.try_resize(thread_count));
+    for (auto& thread : threads) {
+        thread.filename = &filename;
+        thread.flags = flags;
+        thread.block_size = block_size;
+        thread.block_count = file_size / block_size;
+        thread.duration = duration;
+        thread.failed = &failed;
+    }
+
+    // The threads don't stop on the dot, so the rates are based on how long it actually took them to finish.
+    auto timer = Core::ElapsedTimer::start_new();
+    size_t started_threads = 0;
+    for (; started_threads < thread_count; ++started_threads) {
+        auto& thread = threads[started_threads];
+        if (int rc = pthread_create(&thread.thread, nullptr, random_io_thread, &thread); rc != 0) {
+            warnln("pthread_create: {}", strerror(rc));
+            failed = true;
+            break;
+        }
+    }
+    for (size_t i = 0; i < started_threads; ++i)
+        pthread_join(threads[i].thread, nullptr);
+    auto elapsed = timer.elapsed_time();
+
+    if (failed)
+        return Error::from_string_literal("Random read benchmark failed");
+
+    RandomIOResult total;
+    total.elapsed = elapsed;
+    for (auto& thread : threads) {
+        total.operations += thread.result.operations;
+        total.bytes += thread.result.bytes;
+    }
+    return total;
+}
+
+ErrorOr<void> run_directory_benchmark(ByteString const& path, size_t entry_count)
+{
+    TRY(Core::System::mkdir(path, 0755));
+    auto remove_directory = ScopeGuard([&path] {
+        if (auto result = Core::System::rmdir(path); result.is_error())
+            warnln("{}", result.release_error());
+    });
+
+    auto entry_path = [&path](size_t i) { return ByteString::formatted("{}/entry-{:08}", path, i); };
+
+    // If any of the phases fails, whatever entries are left have to go before the directory can be removed.
+    size_t first_remaining_entry = 0;
+    size_t created_entry_count = 0;
+    ArmedScopeGuard remove_entries = [&] {
+        for (size_t i = first_remaining_entry; i < created_entry_count; ++i)
+            (void)Core::System::unlink(entry_path(i));
+    };
+
+    auto report = [entry_count](StringView phase, Core::ElapsedTimer const& timer) {
+        auto elapsed_ms = max(timer.elapsed_milliseconds(), 1);
+        outln("Finished: {} entries={} time={}ms ops_per_second={}", phase, entry_count, elapsed_ms, entry_count * 1000 / elapsed_ms);
+    };
+
+    outln("Running: entries={}", entry_count);
+
+    auto timer = Core::ElapsedTimer::start_new();
+    for (size_t i = 0; i < entry_count; ++i) {
+        int fd = TRY(Core::System::open(entry_path(i), O_CREAT | O_EXCL | O_WRONLY, 0644));
+        ++created_entry_count;
+        TRY(Core::System::close(fd));
+    }
+    report("create"sv, timer);
+
+    // Look the entries up in random order, so that we don't just measure how well the directory's blocks are cached.
+    timer.start();
+    for (size_t i = 0; i < entry_count; ++i)
+        (void)TRY(Core::System::stat(entry_path(AK::get_random_uniform_64(entry_count))));
+    report("stat"sv, timer);
+
+    timer.start();
+    for (; first_remaining_entry < entry_count; ++first_remaining_entry)
+        TRY(Core::System::unlink(entry_path(first_remaining_entry)));
+    report("unlink"sv, timer);
+    remove_entries.disarm();
+
+    return {};
+}
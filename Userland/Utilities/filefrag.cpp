@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024, the SerenityOS developers.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <AK/ByteString.h>
+#include <AK/ScopeGuard.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/DirIterator.h>
+#include <LibCore/System.h>
+#include <LibMain/Main.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+struct Extent {
+    u64 logical_block { 0 };
+    u64 physical_block { 0 };
+    u64 length { 0 };
+};
+
+struct Totals {
+    size_t file_count { 0 };
+    size_t fragmented_file_count { 0 };
+    u64 extent_count { 0 };
+    u64 block_count { 0 };
+};
+
+static bool s_verbose = false;
+static bool s_recursive = false;
+static Totals s_totals;
+
+static ErrorOr<Vector<Extent>> extents_of(int fd, u64 block_count)
+{
+    Vector<Extent> extents;
+    for (u64 logical_block = 0; logical_block < block_count; ++logical_block) {
+        int physical_block = static_cast<int>(logical_block);
+        TRY(Core::System::ioctl(fd, FIBMAP, &physical_block));
+        // Holes don't belong to any extent.
+        if (physical_block == 0)
+            continue;
+
+        if (!extents.is_empty()) {
+            auto& last = extents.last();
+            if (last.logical_block + last.length == logical_block && last.physical_block + last.length == static_cast<u64>(physical_block)) {
+                ++last.length;
+                continue;
+            }
+        }
+        TRY(extents.try_append({ logical_block, static_cast<u64>(physical_block), 1 }));
+    }
+    return extents;
+}
+
+static ErrorOr<void> report_file(ByteString const& path, struct stat const& st)
+{
+    auto fd = TRY(Core::System::open(path, O_RDONLY));
+    ScopeGuard close_fd = [&] { MUST(Core::System::close(fd)); };
+
+    u64 block_count = st.st_blksize ? ceil_div(static_cast<u64>(st.st_size), static_cast<u64>(st.st_blksize)) : 0;
+    auto extents = TRY(extents_of(fd, block_count));
+
+    outln("{}: {} extent{} found", path, extents.size(), extents.size() == 1 ? "" : "s");
+    if (s_verbose) {
+        outln("{:>5} {:>12} {:>12} {:>10}", "ext", "logical", "physical", "length");
+        for (size_t i = 0; i < extents.size(); ++i)
+            outln("{:>5} {:>12} {:>12} {:>10}", i, extents[i].logical_block, extents[i].physical_block, extents[i].length);
+    }
+
+    ++s_totals.file_count;
+    if (extents.size() > 1)
+        ++s_totals.fragmented_file_count;
+    s_totals.extent_count += extents.size();
+    for (auto const& extent : extents)
+        s_totals.block_count += extent.length;
+    return {};
+}
+
+static ErrorOr<void> report(ByteString const& path)
+{
+    auto st = TRY(Core::System::lstat(path));
+    if (S_ISREG(st.st_mode))
+        return report_file(path, st);
+
+    if (!S_ISDIR(st.st_mode) || !s_recursive)
+        return {};
+
+    Core::DirIterator iterator(path, Core::DirIterator::SkipParentAndBaseDir);
+    while (iterator.has_next()) {
+        auto child_path = iterator.next_full_path();
+        if (auto result = report(child_path); result.is_error())
+            warnln("filefrag: {}: {}", child_path, result.error());
+    }
+    return {};
+}
+
+ErrorOr<int> serenity_main(Main::Arguments arguments)
+{
+    TRY(Core::System::pledge("stdio rpath"));
+
+    Vector<ByteString> paths;
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Report how fragmented files are on the disk.");
+    args_parser.add_option(s_verbose, "Print the extents of each file", "verbose", 'v');
+    args_parser.add_option(s_recursive, "Report on all files within directories", "recursive", 'r');
+    args_parser.add_positional_argument(paths, "Files to report on", "files");
+    args_parser.parse(arguments);
+
+    int exit_code = 0;
+    for (auto const& path : paths) {
+        if (auto result = report(path); result.is_error()) {
+            warnln("filefrag: {}: {}", path, result.error());
+            exit_code = 1;
+        }
+    }
+
+    if (s_totals.file_count > 1) {
+        auto average = static_cast<double>(s_totals.extent_count) / s_totals.file_count;
+        outln("{} files, {} fragmented, {} extents in {} blocks, {:.2} extents per file on average",
+            s_totals.file_count, s_totals.fragmented_file_count, s_totals.extent_count, s_totals.block_count, average);
+    }
+
+    return exit_code;
+}
@@ -28,8 +28,10 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
     TRY(Core::System::pledge("stdio rpath"));
 
     bool flag_human_readable = false;
+    bool flag_slab_caches = false;
     Core::ArgsParser args_parser;
     args_parser.add_option(flag_human_readable, "Print human-readable sizes", "human-readable", 'h');
+    args_parser.add_option(flag_slab_caches, "Print kmalloc slab cache statistics", "slab-caches", 's');
     args_parser.parse(arguments);
 
     auto proc_memstat = TRY(Core::File::open("/sys/kernel/memstat"sv, Core::File::OpenMode::Read));
@@ -43,6 +45,13 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
     u64 physical_available = json.get_u64("physical_available"sv).value_or(0);
     u64 physical_committed = json.get_u64("physical_committed"sv).value_or(0);
     u64 physical_uncommitted = json.get_u64("physical_uncommitted"sv).value_or(0);
+    u64 huge_pages_mapped = json.get_u64("huge_pages_mapped"sv).value_or(0);
+    u64 huge_page_allocations = json.get_u64("huge_page_allocations"sv).value_or(0);
+    u64 page_cache_cached = json.get_u64("page_cache_cached"sv).value_or(0);
+    u64 page_cache_mapped = json.get_u64("page_cache_mapped"sv).value_or(0);
+    u64 dirty_bytes = json.get_u64("dirty_bytes"sv).value_or(0);
+    u64 writeback_bytes = json.get_u64("writeback_bytes"sv).value_or(0);
+    u64 throttled_write_count = json.get_u64("throttled_write_count"sv).value_or(0);
     u32 kmalloc_call_count = json.get_u32("kmalloc_call_count"sv).value_or(0);
     u32 kfree_call_count = json.get_u32("kfree_call_count"sv).value_or(0);
 
@@ -56,15 +65,44 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
         outln("Physical pages (committed) count: {}", TRY(String::formatted("{}", human_readable_size_long(page_count_to_bytes(physical_committed), UseThousandsSeparator::Yes))));
         outln("Physical pages (uncommitted) count: {}", TRY(String::formatted("{}", human_readable_size_long(page_count_to_bytes(physical_uncommitted), UseThousandsSeparator::Yes))));
         outln("Physical pages (total) count: {:'}", physical_pages_total);
+        outln("Huge pages (mapped): {}", human_readable_size_long(huge_pages_mapped * 2 * MiB, UseThousandsSeparator::Yes));
+        outln("Page cache (cached): {}", human_readable_size_long(page_count_to_bytes(page_cache_cached), UseThousandsSeparator::Yes));
+        outln("Page cache (mapped): {}", human_readable_size_long(page_count_to_bytes(page_cache_mapped), UseThousandsSeparator::Yes));
+        outln("Dirty: {}", human_readable_size_long(dirty_bytes, UseThousandsSeparator::Yes));
+        outln("Writeback: {}", human_readable_size_long(writeback_bytes, UseThousandsSeparator::Yes));
     } else {
         outln("Kmalloc allocated: {}", TRY(String::formatted("{}/{}", kmalloc_allocated, kmalloc_bytes_total)));
         outln("Physical pages (in use) count: {}", TRY(String::formatted("{}/{}", page_count_to_bytes(physical_pages_in_use), page_count_to_bytes(physical_pages_total))));
         outln("Physical pages (committed) count: {}", TRY(String::formatted("{}", page_count_to_bytes(physical_committed))));
         outln("Physical pages (uncommitted) count: {}", TRY(String::formatted("{}", page_count_to_bytes(physical_uncommitted))));
         outln("Physical pages (total) count: {}", physical_pages_total);
+        outln("Huge pages (mapped): {}", huge_pages_mapped);
+        outln("Page cache (cached): {}", page_count_to_bytes(page_cache_cached));
+        outln("Page cache (mapped): {}", page_count_to_bytes(page_cache_mapped));
+        outln("Dirty: {}", dirty_bytes);
+        outln("Writeback: {}", writeback_bytes);
     }
+    outln("Huge page allocations: {}", huge_page_allocations);
+    outln("Throttled writes: {}", throttled_write_count);
     outln("Kmalloc call count: {}", kmalloc_call_count);
     outln("Kfree call count: {}", kfree_call_count);
     outln("Kmalloc/Kfree delta: {}", TRY(String::formatted("{:+}", kmalloc_call_count - kfree_call_count)));
+
+    if (flag_slab_caches) {
+        outln();
+        outln("{:>9} {:>8} {:>12} {:>12} {:>12} {:>12}", "Slab size", "Cached", "Alloc hits", "Alloc misses", "Free hits", "Free misses");
+        if (auto slab_caches = json.get_array("kmalloc_slab_caches"sv); slab_caches.has_value()) {
+            slab_caches->for_each([](JsonValue const& value) {
+                auto const& cache = value.as_object();
+                outln("{:>9} {:>8} {:>12} {:>12} {:>12} {:>12}",
+                    cache.get_u64("slab_size"sv).value_or(0),
+                    cache.get_u64("cached_slabs"sv).value_or(0),
+                    cache.get_u64("allocation_hits"sv).value_or(0),
+                    cache.get_u64("allocation_misses"sv).value_or(0),
+                    cache.get_u64("free_hits"sv).value_or(0),
+                    cache.get_u64("free_misses"sv).value_or(0));
+            });
+        }
+    }
     return 0;
 }
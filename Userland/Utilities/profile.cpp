@@ -4,7 +4,9 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <AK/ByteBuffer.h>
 #include <LibCore/ArgsParser.h>
+#include <LibCore/File.h>
 #include <LibCore/System.h>
 #include <LibMain/Main.h>
 #include <serenity.h>
@@ -12,12 +14,14 @@
 #include <stdlib.h>
 
 static Optional<pid_t> determine_pid_to_profile(StringView pid_argument, bool all_processes);
+static ErrorOr<bool> copy_perfcore_events(int perfcore_fd, Core::File& output, ByteBuffer& buffer);
 
 ErrorOr<int> serenity_main(Main::Arguments arguments)
 {
     Core::ArgsParser args_parser;
 
     StringView pid_argument {};
+    StringView output_path {};
     Vector<StringView> command;
     bool wait = false;
     bool free = false;
@@ -35,6 +39,7 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
     args_parser.add_option(disable, "Disable", nullptr, 'd');
     args_parser.add_option(free, "Free the profiling buffer for the associated process(es).", nullptr, 'f');
     args_parser.add_option(wait, "Enable profiling and wait for user input to disable.", nullptr, 'w');
+    args_parser.add_option(output_path, "With -a -w, write the profile to this file while it's being recorded.", nullptr, 'o', "FILE");
     args_parser.add_option(Core::ArgsParser::Option {
         Core::ArgsParser::OptionArgumentMode::Required,
         "Enable tracking specific event type", nullptr, 't', "event_type",
@@ -88,6 +93,11 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
             return 1;
         }
 
+        if (!output_path.is_empty() && !(all_processes && wait)) {
+            warnln("-o <FILE> requires -a and -w.");
+            return 1;
+        }
+
         auto pid_opt = determine_pid_to_profile(pid_argument, all_processes);
         if (!pid_opt.has_value()) {
             warnln("-p <PID> requires an integer value.");
@@ -95,6 +105,38 @@ ErrorOr<int> serenity_main(Main::Arguments arguments)
         }
 
         pid_t pid = pid_opt.value();
+        if (wait && !output_path.is_empty()) {
+            auto output = TRY(Core::File::open(output_path, Core::File::OpenMode::Write | Core::File::OpenMode::Truncate));
+            // /dev/perfcore hands out the events as they're recorded, so the kernel's buffer doesn't fill up no matter how long we profile.
+            auto perfcore_fd = TRY(Core::System::open("/dev/perfcore"sv, O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+            auto buffer = TRY(ByteBuffer::create_uninitialized(64 * KiB));
+
+            TRY(Core::System::profiling_enable(pid, event_mask));
+            outln("Profiling enabled, writing to {} until user input...", output_path);
+
+            Array<struct pollfd, 1> poll_fds { { { STDIN_FILENO, POLLIN, 0 } } };
+            auto result = [&]() -> ErrorOr<void> {
+                while (TRY(copy_perfcore_events(perfcore_fd, *output, buffer))) {
+                    if (TRY(Core::System::poll(poll_fds, 100)) > 0)
+                        break;
+                }
+                return {};
+            }();
+
+            TRY(Core::System::profiling_disable(pid));
+            // Now that profiling is disabled, the events that are still buffered are followed by the end of the file.
+            while (!result.is_error()) {
+                auto more_or_error = copy_perfcore_events(perfcore_fd, *output, buffer);
+                if (more_or_error.is_error())
+                    result = more_or_error.release_error();
+                else if (!more_or_error.value())
+                    break;
+            }
+            TRY(Core::System::profiling_free_buffer(pid));
+            TRY(result);
+            return 0;
+        }
+
         if (wait || enable) {
             TRY(Core::System::profiling_enable(pid, event_mask));
 
@@ -132,3 +174,20 @@ static Optional<pid_t> determine_pid_to_profile(StringView pid_argument, bool al
     // pid_argument is guaranteed to have a value
     return pid_argument.to_number<pid_t>();
 }
+
+// Copies whatever events are available right now. Returns false once the end of the perfcore has been reached.
+static ErrorOr<bool> copy_perfcore_events(int perfcore_fd, Core::File& output, ByteBuffer& buffer)
+{
+    while (true) {
+        auto nread_or_error = Core::System::read(perfcore_fd, buffer);
+        if (nread_or_error.is_error()) {
+            if (nread_or_error.error().code() == EAGAIN)
+                return true;
+            return nread_or_error.release_error();
+        }
+        auto nread = nread_or_error.release_value();
+        if (nread == 0)
+            return false;
+        TRY(output.write_until_depleted(buffer.bytes().trim(nread)));
+    }
+}